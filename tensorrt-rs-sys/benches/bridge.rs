@@ -0,0 +1,169 @@
+use criterion::{black_box, criterion_group, criterion_main, Criterion};
+use cuda_rs::{device::CuDevice, memory::DeviceMemory, stream::CuStream};
+use std::{
+    alloc::{GlobalAlloc, Layout, System},
+    sync::atomic::{AtomicUsize, Ordering},
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::runtime::{get_infer_lib_version, OptProfileSelector, Runtime, TensorBinding, TensorDims};
+
+// Counts Rust-side heap allocations, which include the rust::Vec/rust::String values the
+// bridge returns. Allocations inside TensorRT or std::string copies on the C++ side are not
+// seen here.
+struct CountingAllocator;
+
+static ALLOCATIONS: AtomicUsize = AtomicUsize::new(0);
+
+unsafe impl GlobalAlloc for CountingAllocator {
+    unsafe fn alloc(&self, layout: Layout) -> *mut u8 {
+        ALLOCATIONS.fetch_add(1, Ordering::Relaxed);
+        System.alloc(layout)
+    }
+
+    unsafe fn dealloc(&self, ptr: *mut u8, layout: Layout) {
+        System.dealloc(ptr, layout)
+    }
+}
+
+#[global_allocator]
+static GLOBAL: CountingAllocator = CountingAllocator;
+
+const ALLOCATION_SAMPLES: usize = 10_000;
+
+// Printed next to criterion's ns/call, so a binding that starts copying shows up at once.
+fn report_allocations<F: FnMut()>(name: &str, mut f: F) {
+    let before = ALLOCATIONS.load(Ordering::Relaxed);
+    for _ in 0..ALLOCATION_SAMPLES {
+        f();
+    }
+    let allocations = ALLOCATIONS.load(Ordering::Relaxed) - before;
+    println!("{}: {:.2} allocations/call", name, allocations as f64 / ALLOCATION_SAMPLES as f64);
+}
+
+fn bench_call<F: FnMut()>(c: &mut Criterion, name: &str, mut f: F) {
+    report_allocations(name, &mut f);
+    c.bench_function(name, |b| b.iter(&mut f));
+}
+
+// The per-request call sequence of TRTEngine, by name and by handle. Needs a plan:
+// TRT_BENCH_PLAN=model.plan cargo bench -p tensorrt-rs-sys. Inputs use the opt shapes of
+// profile 0.
+fn bridge_benches(c: &mut Criterion) {
+    bench_call(c, "baseline/get_infer_lib_version", || {
+        black_box(get_infer_lib_version());
+    });
+    // An inline accessor returning a constant, i.e. the cost of the bridge call itself. Run the
+    // benches once as is and once with --features cross-language-lto (and the RUSTFLAGS in
+    // build.rs) for the per-call difference; with LTO this one inlines to nothing.
+    bench_call(c, "baseline/inline_accessor", || {
+        black_box(tensorrt_rs_sys::nvtx::is_enabled());
+    });
+
+    let plan = match std::env::var("TRT_BENCH_PLAN") {
+        Ok(plan) => std::fs::read(plan).unwrap(),
+        Err(_) => {
+            eprintln!("TRT_BENCH_PLAN is not set, skipping the engine call benchmarks");
+            return;
+        }
+    };
+
+    cuda_rs::init().unwrap();
+    let ctx = CuDevice::new(0).unwrap().retain_primary_context().unwrap();
+    let _guard = ctx.guard().unwrap();
+    let stream = CuStream::new().unwrap();
+
+    let mut runtime = Runtime::new().unwrap();
+    let engine = runtime.deserialize(&plan).unwrap();
+    let mut context = engine.create_execution_context().unwrap();
+
+    let names: Vec<String> = (0..engine.get_num_io_tensors())
+        .map(|i| engine.get_io_tensor_name(i).to_string())
+        .collect();
+    let input = names.iter().find(|name| engine.get_tensor_io_mode(name).is_input()).unwrap().clone();
+    let input_handle = engine.get_tensor_handle(&input).unwrap();
+
+    for name in names.iter().filter(|name| engine.get_tensor_io_mode(name).is_input()) {
+        let opt = engine.get_profile_shape(name, 0, OptProfileSelector::OPT);
+        assert!(context.set_input_shape(name, opt.as_slice()));
+    }
+    let shape = engine.get_profile_shape(&input, 0, OptProfileSelector::OPT);
+    let dims = TensorDims::new(shape.as_slice());
+
+    let mut buffers = Vec::with_capacity(names.len());
+    for name in &names {
+        let dims = context.get_tensor_dims(name);
+        let elems: usize = match dims.as_slice().iter().any(|&dim| dim < 0) {
+            true => 1 << 20,
+            false => dims.as_slice().iter().map(|&dim| dim as usize).product(),
+        };
+        let size = elems.max(1) * engine.get_tensor_dtype(name).get_elem_size();
+        let mem = DeviceMemory::new(size, &stream).unwrap();
+        assert!(context.set_tensor_address(name, unsafe { mem.get_raw() } as usize));
+        buffers.push(mem);
+    }
+    let address = unsafe { buffers[0].get_raw() } as usize;
+    let address_handle = engine.get_tensor_handle(&names[0]).unwrap();
+
+    bench_call(c, "set_input_shape/name", || {
+        black_box(context.set_input_shape(&input, shape.as_slice()));
+    });
+    bench_call(c, "set_input_shape/handle", || {
+        black_box(context.set_input_shape_by_handle(input_handle, shape.as_slice()));
+    });
+    bench_call(c, "set_input_shape/dims", || {
+        black_box(context.set_input_dims_by_handle(input_handle, &dims));
+    });
+
+    bench_call(c, "set_tensor_address/name", || {
+        black_box(context.set_tensor_address(&names[0], address));
+    });
+    bench_call(c, "set_tensor_address/handle", || {
+        black_box(context.set_tensor_address_by_handle(address_handle, address));
+    });
+
+    // every IO tensor in one crossing, as TRTEngine binds a request
+    let bindings: Vec<TensorBinding> = names
+        .iter()
+        .zip(&buffers)
+        .map(|(name, mem)| TensorBinding::address(engine.get_tensor_handle(name).unwrap(), unsafe { mem.get_raw() } as usize))
+        .collect();
+    bench_call(c, "set_tensor_address/all_by_name", || {
+        for (name, binding) in names.iter().zip(&bindings) {
+            black_box(context.set_tensor_address(name, binding.address));
+        }
+    });
+    bench_call(c, "set_tensor_address/all_batched", || {
+        black_box(context.apply_bindings(&bindings));
+    });
+
+    bench_call(c, "get_tensor_shape/name", || {
+        black_box(context.get_tensor_shape(&input));
+    });
+    bench_call(c, "get_tensor_shape/handle", || {
+        black_box(context.get_tensor_shape_by_handle(input_handle));
+    });
+    bench_call(c, "get_tensor_shape/dims", || {
+        black_box(context.get_tensor_dims_by_handle(input_handle));
+    });
+
+    // host-side cost of the launch only; the GPU work is drained outside the timed region
+    report_allocations("enqueue_v3", || {
+        context.enqueue_v3(&stream);
+        stream.synchronize().unwrap();
+    });
+    c.bench_function("enqueue_v3", |b| {
+        b.iter_custom(|iters| {
+            let mut elapsed = Duration::ZERO;
+            for _ in 0..iters {
+                let start = Instant::now();
+                black_box(context.enqueue_v3(&stream));
+                elapsed += start.elapsed();
+                stream.synchronize().unwrap();
+            }
+            elapsed
+        })
+    });
+}
+
+criterion_group!(benches, bridge_benches);
+criterion_main!(benches);
@@ -29,46 +29,221 @@ fn main() {
         "cuda.h",
     ).expect("Could not find CUDA include path");
 
+    let cuda_library_dir = find_dir(
+        "CUDA_LIB_PATH",
+        vec!["/opt/cuda/lib64", "/usr/local/cuda/lib64"],
+        "libcudart.so",
+    ).expect("Could not find CUDA library path");
+
     let tensorrt_include_dir = find_dir(
         "TENSORRT_INCLUDE_PATH",
         vec!["/usr/local/include", "/usr/include/x86_64-linux-gnu"],
         "NvInfer.h",
     ).expect("Could not find TensorRT include path");
 
+    let builder = env::var_os("CARGO_FEATURE_BUILDER").is_some();
+    let plugins = env::var_os("CARGO_FEATURE_PLUGINS").is_some();
+    let lean = env::var_os("CARGO_FEATURE_LEAN").is_some();
+    if lean && builder {
+        panic!("The lean runtime cannot build engines: disable the builder feature (default-features = false)");
+    }
+
     let tensorrt_library_dir = find_dir(
         "TENSORRT_LIB_PATH",
         vec!["/usr/local/lib", "/usr/lib/x86_64-linux-gnu"],
-        "libnvinfer.so",
+        if lean { "libnvinfer_lean.so" } else { "libnvinfer.so" },
     ).expect("Could not find TensorRT library path");
 
     let include_files = vec![
+        "cxx/include/allocator.h",
+        "cxx/include/builder.h",
+        "cxx/include/cuda_device.h",
+        "cxx/include/cuda_gds.h",
+        "cxx/include/cuda_graph.h",
+        "cxx/include/cuda_ipc.h",
+        "cxx/include/cuda_memory.h",
+        "cxx/include/cuda_stream.h",
+        "cxx/include/cuda_vmm.h",
+        "cxx/include/error_recorder.h",
+        "cxx/include/kernels.h",
         "cxx/include/logger.h",
+        "cxx/include/numa.h",
+        "cxx/include/nvtx.h",
+        "cxx/include/plugin.h",
+        "cxx/include/profiler.h",
+        "cxx/include/refitter.h",
         "cxx/include/runtime.h"
     ];
     let cpp_files = vec![
+        "cxx/src/allocator.cpp",
+        "cxx/src/builder.cpp",
+        "cxx/src/cuda_stream.cpp",
+        "cxx/src/cuda_vmm.cpp",
+        "cxx/src/error_recorder.cpp",
         "cxx/src/logger.cpp",
+        "cxx/src/plugin.cpp",
+        "cxx/src/profiler.cpp",
+        "cxx/src/refitter.cpp",
         "cxx/src/runtime.cpp"
     ];
+    let cuda_files = vec![
+        "cxx/src/kernels/cast.cu",
+        "cxx/src/kernels/crop_resize.cu",
+        "cxx/src/kernels/db_postprocess.cu",
+        "cxx/src/kernels/gather.cu",
+        "cxx/src/kernels/layout.cu",
+        "cxx/src/kernels/preprocess.cu",
+        "cxx/src/kernels/reduce.cu",
+        "cxx/src/kernels/sequence.cu",
+    ];
     let rust_files = vec![
         "src/lib.rs",
     ];
+    let spdlog_files = vec![
+        "cxx/src/spdlog/async.cpp",
+        "cxx/src/spdlog/bundled_fmtlib_format.cpp",
+        "cxx/src/spdlog/color_sinks.cpp",
+        "cxx/src/spdlog/spdlog.cpp",
+    ];
 
-    cxx_build::bridges(&rust_files)
-        .include(cuda_include_dir)
+    let nvtx = env::var_os("CARGO_FEATURE_NVTX").is_some();
+    let gds = env::var_os("CARGO_FEATURE_GDS").is_some();
+    let cross_language_lto = env::var_os("CARGO_FEATURE_CROSS_LANGUAGE_LTO").is_some();
+    // cargo's opt-level of the profile being built; "s" and "z" are left to cc
+    let optimized = matches!(env::var("OPT_LEVEL").as_deref(), Ok("2") | Ok("3"));
+    // How spdlog and its fmt are built: "header-only" instantiates them in the logger TU,
+    // "compiled" builds the vendored sources once as a static library, "system" takes an
+    // installed spdlog from pkg-config.
+    let spdlog_mode = env::var("TRT_RS_SPDLOG").unwrap_or_else(|_| "header-only".to_string());
+
+    let mut bridge = cxx_build::bridges(&rust_files);
+    bridge
+        .include(&cuda_include_dir)
         .include(tensorrt_include_dir)
         .include("cxx/include")
         .files(&cpp_files)
-        .define("FMT_HEADER_ONLY", None)
-        .flag_if_supported("-std=c++17")
-        .compile("tensorrt-rs-sys-cxxbridge");
+        .flag_if_supported("-std=c++17");
+    match spdlog_mode.as_str() {
+        "header-only" => {
+            bridge.include("cxx/vendor").define("FMT_HEADER_ONLY", None);
+        }
+        "compiled" => {
+            bridge.include("cxx/vendor").define("SPDLOG_COMPILED_LIB", None);
+        }
+        "system" => {
+            let spdlog = pkg_config::Config::new()
+                .probe("spdlog")
+                .expect("Could not find spdlog through pkg-config");
+            for path in &spdlog.include_paths {
+                bridge.include(path);
+            }
+            for (key, value) in &spdlog.defines {
+                bridge.define(key, value.as_deref());
+            }
+        }
+        mode => panic!("Unknown TRT_RS_SPDLOG mode: {}", mode),
+    }
+    if optimized {
+        bridge.opt_level(3).flag_if_supported("-fno-plt");
+    }
+    // Emits LLVM bitcode, so that rustc's linker-plugin-lto can inline the shims into the
+    // Rust callers. Needs a clang built on the LLVM of rustc, and
+    // RUSTFLAGS="-Clinker-plugin-lto -Clinker=clang -Clink-arg=-fuse-ld=lld".
+    if cross_language_lto {
+        if env::var_os("CXX").is_none() {
+            bridge.compiler("clang++");
+        }
+        bridge.flag("-flto=thin");
+    }
+    // NVTX 3 is header-only and ships with the toolkit; it loads the tool through dlopen
+    if nvtx {
+        bridge.define("TRT_RS_NVTX", None);
+    }
+    // cuFile ships with the toolkit (gds/), its kernel driver nvidia-fs separately
+    if gds {
+        bridge.define("TRT_RS_GDS", None);
+    }
+    // without them the builder and the standard plugins fail to create, and their libraries
+    // are not linked; the headers are still needed
+    if builder {
+        bridge.define("TRT_RS_BUILDER", None);
+    }
+    if plugins {
+        bridge.define("TRT_RS_PLUGINS", None);
+    }
+    bridge.compile("tensorrt-rs-sys-cxxbridge");
+
+    if spdlog_mode == "compiled" {
+        let mut spdlog = cc::Build::new();
+        spdlog
+            .cpp(true)
+            .include("cxx/vendor")
+            .files(&spdlog_files)
+            .define("SPDLOG_COMPILED_LIB", None)
+            .flag_if_supported("-std=c++17");
+        if optimized {
+            spdlog.opt_level(3);
+        }
+        if cross_language_lto {
+            if env::var_os("CXX").is_none() {
+                spdlog.compiler("clang++");
+            }
+            spdlog.flag("-flto=thin");
+        }
+        spdlog.compile("tensorrt-rs-sys-spdlog");
+    }
+
+    // nvcc from the same toolkit as the headers, unless NVCC is set
+    let nvcc = env::var_os("NVCC").map(PathBuf::from).unwrap_or_else(|| {
+        let candidate = cuda_include_dir.join("../bin/nvcc");
+        if candidate.exists() { candidate } else { PathBuf::from("nvcc") }
+    });
+    let mut kernels = cc::Build::new();
+    kernels
+        .cuda(true)
+        .cudart("shared")
+        .compiler(nvcc)
+        .include(&cuda_include_dir)
+        .include("cxx/include")
+        .files(&cuda_files)
+        .flag("-std=c++17")
+        .flag("-O3");
+    if let Ok(arch) = env::var("CUDA_ARCH") {
+        kernels.flag(&format!("-arch={}", arch));
+    }
+    kernels.compile("tensorrt-rs-sys-kernels");
 
+    println!("cargo:rustc-link-search={}", cuda_library_dir.to_string_lossy());
+    // libcuda ships with the driver; the toolkit's stub stands in on build machines without one
+    println!("cargo:rustc-link-search={}", cuda_library_dir.join("stubs").to_string_lossy());
     println!("cargo:rustc-link-search={}", tensorrt_library_dir.to_string_lossy());
 
-    let libraries = vec![
-        "nvinfer",
-        "nvinfer_plugin",
-        "nvparsers",
+    let mut libraries = vec![
+        // the driver API, for virtual memory management
+        "cuda",
+        "cudart",
+        // the lean runtime only deserializes and runs version-compatible plans
+        if lean { "nvinfer_lean" } else { "nvinfer" },
     ];
+    if builder {
+        libraries.push("nvonnxparser");
+    }
+    if plugins {
+        libraries.push("nvinfer_plugin");
+    }
+
+    println!("cargo:rerun-if-env-changed=NVCC");
+    println!("cargo:rerun-if-env-changed=CXX");
+    println!("cargo:rerun-if-env-changed=CUDA_ARCH");
+    println!("cargo:rerun-if-env-changed=TRT_RS_SPDLOG");
+
+    if nvtx {
+        println!("cargo:rustc-link-lib=dl");
+    }
+
+    if gds {
+        println!("cargo:rustc-link-lib=cufile");
+    }
 
     for library in libraries {
         println!("cargo:rustc-link-lib={}", library);
@@ -82,6 +257,14 @@ fn main() {
         println!("cargo:rerun-if-changed={}", file);
     }
 
+    for file in cuda_files {
+        println!("cargo:rerun-if-changed={}", file);
+    }
+
+    for file in spdlog_files {
+        println!("cargo:rerun-if-changed={}", file);
+    }
+
     for file in rust_files {
         println!("cargo:rerun-if-changed={}", file);
     }
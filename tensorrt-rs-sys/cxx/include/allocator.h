@@ -0,0 +1,29 @@
+#pragma once
+
+#include <memory>
+#include <NvInferRuntime.h>
+#include <cuda_runtime_api.h>
+#include "rust/cxx.h"
+
+namespace trt_rs::allocator {
+
+struct RustGpuAllocator;
+
+// Shared so that Runtime and ExecutionContext can keep the allocator alive for as long as
+// TensorRT may call into it, independent of the Rust-side handle.
+class GpuAllocator {
+public:
+    GpuAllocator(std::shared_ptr<nvinfer1::IGpuAllocator> allocator) : allocator_(std::move(allocator)) {}
+
+    const std::shared_ptr<nvinfer1::IGpuAllocator>& get() const noexcept {
+        return allocator_;
+    }
+private:
+    std::shared_ptr<nvinfer1::IGpuAllocator> allocator_;
+};
+
+std::unique_ptr<GpuAllocator> create_rust_gpu_allocator(rust::Box<RustGpuAllocator> allocator) noexcept;
+
+std::unique_ptr<GpuAllocator> create_mem_pool_allocator(int32_t device, uint64_t release_threshold) noexcept;
+
+} // namespace trt_rs::allocator
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <memory>
+#include <NvInfer.h>
+#include <NvOnnxParser.h>
+#include "rust/cxx.h"
+#include "logger.h"
+
+namespace trt_rs::runtime {
+struct TensorDims;
+} // namespace trt_rs::runtime
+
+namespace trt_rs::builder {
+
+using logger::Logger;
+using runtime::TensorDims;
+
+struct RustCalibrator;
+
+// Serialized plan or timing cache produced by TensorRT.
+class HostMemory {
+public:
+    explicit HostMemory(std::unique_ptr<nvinfer1::IHostMemory> memory) : memory_(std::move(memory)) {}
+
+    rust::Slice<const std::uint8_t> data() const noexcept {
+        return rust::Slice<const std::uint8_t>(
+            static_cast<const std::uint8_t*>(memory_->data()), memory_->size());
+    }
+private:
+    std::unique_ptr<nvinfer1::IHostMemory> memory_;
+};
+
+// Kernel timings recorded by the builder; configs using it add new entries in place.
+class TimingCache {
+public:
+    explicit TimingCache(std::shared_ptr<nvinfer1::ITimingCache> cache) : cache_(std::move(cache)) {}
+
+    std::unique_ptr<HostMemory> serialize() const noexcept;
+
+    bool combine(const TimingCache& other, bool ignore_mismatch) noexcept {
+        return cache_->combine(*other.cache_, ignore_mismatch);
+    }
+
+    bool reset() noexcept {
+        return cache_->reset();
+    }
+
+    const std::shared_ptr<nvinfer1::ITimingCache>& get() const noexcept {
+        return cache_;
+    }
+private:
+    std::shared_ptr<nvinfer1::ITimingCache> cache_;
+};
+
+// Owned by the builder that created it.
+class OptimizationProfile {
+public:
+    explicit OptimizationProfile(nvinfer1::IOptimizationProfile* profile) : profile_(profile) {}
+
+    bool set_dimensions(rust::Str input, int32_t select, const TensorDims& dims) noexcept;
+
+    bool set_shape_values(rust::Str input, int32_t select, rust::Slice<const int32_t> values) noexcept;
+
+    bool is_valid() const noexcept {
+        return profile_->isValid();
+    }
+
+    nvinfer1::IOptimizationProfile* get() const noexcept {
+        return profile_;
+    }
+private:
+    nvinfer1::IOptimizationProfile* profile_;
+};
+
+// Entropy (IInt8EntropyCalibrator2) calibrator that pulls batches from Rust.
+class Int8Calibrator {
+public:
+    explicit Int8Calibrator(std::unique_ptr<nvinfer1::IInt8Calibrator> calibrator)
+        : calibrator_(std::move(calibrator)) {}
+
+    nvinfer1::IInt8Calibrator* get() const noexcept {
+        return calibrator_.get();
+    }
+private:
+    std::unique_ptr<nvinfer1::IInt8Calibrator> calibrator_;
+};
+
+std::unique_ptr<Int8Calibrator> create_int8_calibrator(rust::Box<RustCalibrator> calibrator) noexcept;
+
+class BuilderConfig {
+public:
+    explicit BuilderConfig(std::unique_ptr<nvinfer1::IBuilderConfig> config) : config_(std::move(config)) {}
+
+    // False if this TensorRT has no such flag to set; clearing one always succeeds.
+    bool set_flag(int32_t flag, bool enabled) noexcept;
+
+    bool get_flag(int32_t flag) const noexcept;
+
+    void set_memory_pool_limit(int32_t pool, std::size_t size) noexcept {
+        config_->setMemoryPoolLimit(static_cast<nvinfer1::MemoryPoolType>(pool), size);
+    }
+
+    void set_builder_optimization_level(int32_t level) noexcept {
+        config_->setBuilderOptimizationLevel(level);
+    }
+
+    void set_profiling_verbosity(int32_t verbosity) noexcept {
+        config_->setProfilingVerbosity(static_cast<nvinfer1::ProfilingVerbosity>(verbosity));
+    }
+
+    void set_hardware_compatibility_level(int32_t level) noexcept {
+        config_->setHardwareCompatibilityLevel(static_cast<nvinfer1::HardwareCompatibilityLevel>(level));
+    }
+
+    void set_avg_timing_iterations(int32_t iterations) noexcept {
+        config_->setAvgTimingIterations(iterations);
+    }
+
+    void set_default_device_type(int32_t device_type) noexcept {
+        config_->setDefaultDeviceType(static_cast<nvinfer1::DeviceType>(device_type));
+    }
+
+    void set_dla_core(int32_t core) noexcept {
+        config_->setDLACore(core);
+    }
+
+    int32_t add_optimization_profile(const OptimizationProfile& profile) noexcept {
+        return config_->addOptimizationProfile(profile.get());
+    }
+
+    std::unique_ptr<TimingCache> create_timing_cache(rust::Slice<const std::uint8_t> blob) const noexcept;
+
+    bool set_timing_cache(const TimingCache& cache, bool ignore_mismatch) noexcept;
+
+    void set_int8_calibrator(std::unique_ptr<Int8Calibrator> calibrator) noexcept {
+        config_->setInt8Calibrator(calibrator ? calibrator->get() : nullptr);
+        calibrator_ = std::move(calibrator);
+    }
+
+    nvinfer1::IBuilderConfig& get() noexcept {
+        return *config_;
+    }
+private:
+    // declared first so that they outlive the config
+    std::shared_ptr<nvinfer1::ITimingCache> timing_cache_;
+    std::unique_ptr<Int8Calibrator> calibrator_;
+    std::unique_ptr<nvinfer1::IBuilderConfig> config_;
+};
+
+// An explicit-batch network populated by its ONNX parser.
+class NetworkDefinition {
+public:
+    NetworkDefinition(
+        std::unique_ptr<nvinfer1::INetworkDefinition> network,
+        std::unique_ptr<nvonnxparser::IParser> parser)
+        : network_(std::move(network)), parser_(std::move(parser)) {}
+
+    bool parse(rust::Slice<const std::uint8_t> model) noexcept {
+        return parser_->parse(model.data(), model.size());
+    }
+
+    bool parse_from_file(rust::Str path, int32_t verbosity) noexcept;
+
+    rust::Vec<rust::String> get_parser_errors() const noexcept;
+
+    int32_t get_nb_inputs() const noexcept {
+        return network_->getNbInputs();
+    }
+
+    int32_t get_nb_outputs() const noexcept {
+        return network_->getNbOutputs();
+    }
+
+    rust::String get_input_name(int32_t index) const noexcept;
+
+    rust::String get_output_name(int32_t index) const noexcept;
+
+    TensorDims get_input_dims(int32_t index) const noexcept;
+
+    nvinfer1::INetworkDefinition& get() noexcept {
+        return *network_;
+    }
+private:
+    std::unique_ptr<nvinfer1::INetworkDefinition> network_;
+    // declared last: the parser refers to the network and owns the weights it imported
+    std::unique_ptr<nvonnxparser::IParser> parser_;
+};
+
+class Builder {
+public:
+    Builder(std::unique_ptr<nvinfer1::IBuilder> builder, Logger& logger)
+        : builder_(std::move(builder)), logger_(logger) {}
+
+    std::unique_ptr<NetworkDefinition> create_onnx_network() const noexcept;
+
+    std::unique_ptr<BuilderConfig> create_builder_config() const noexcept;
+
+    std::unique_ptr<OptimizationProfile> create_optimization_profile() const noexcept;
+
+    std::unique_ptr<HostMemory> build_serialized_network(
+        NetworkDefinition& network, BuilderConfig& config) const noexcept;
+
+    bool platform_has_fast_fp16() const noexcept {
+        return builder_->platformHasFastFp16();
+    }
+
+    bool platform_has_fast_int8() const noexcept {
+        return builder_->platformHasFastInt8();
+    }
+
+    bool set_max_threads(int32_t threads) noexcept {
+        return builder_->setMaxThreads(threads);
+    }
+
+    int32_t get_nb_dla_cores() const noexcept {
+        return builder_->getNbDLACores();
+    }
+private:
+    std::unique_ptr<nvinfer1::IBuilder> builder_;
+    // also handed to the ONNX parsers; must outlive the builder
+    Logger& logger_;
+};
+
+std::unique_ptr<Builder> create_builder(Logger& logger) noexcept;
+
+} // namespace trt_rs::builder
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cuda.h>
+#include <cuda_runtime_api.h>
+#include "rust/cxx.h"
+
+namespace trt_rs::device {
+
+// Current device of the calling thread, or -1 on error.
+inline int32_t get_device() noexcept {
+    int device = -1;
+    if (cudaGetDevice(&device) != cudaSuccess) {
+        return -1;
+    }
+    return device;
+}
+
+// Makes the device's primary context current on the calling thread.
+inline bool set_device(int32_t device) noexcept {
+    return cudaSetDevice(device) == cudaSuccess;
+}
+
+inline int32_t get_device_count() noexcept {
+    int count = 0;
+    if (cudaGetDeviceCount(&count) != cudaSuccess) {
+        return 0;
+    }
+    return count;
+}
+
+// major * 10 + minor, e.g. 86 for sm_86, or -1 on error.
+inline int32_t get_compute_capability(int32_t device) noexcept {
+    int major = 0;
+    int minor = 0;
+    if (cudaDeviceGetAttribute(&major, cudaDevAttrComputeCapabilityMajor, device) != cudaSuccess
+        || cudaDeviceGetAttribute(&minor, cudaDevAttrComputeCapabilityMinor, device) != cudaSuccess) {
+        return -1;
+    }
+    return major * 10 + minor;
+}
+
+inline rust::String get_device_name(int32_t device) noexcept {
+    cudaDeviceProp prop = {};
+    if (cudaGetDeviceProperties(&prop, device) != cudaSuccess) {
+        return rust::String();
+    }
+    return rust::String(prop.name);
+}
+
+inline int32_t get_device_attribute(int32_t attribute, int32_t device) noexcept {
+    int value = 0;
+    if (cudaDeviceGetAttribute(&value, static_cast<cudaDeviceAttr>(attribute), device) != cudaSuccess) {
+        return -1;
+    }
+    return value;
+}
+
+// True for GPUs sharing DRAM with the host, e.g. Jetson.
+inline bool is_integrated(int32_t device) noexcept {
+    return get_device_attribute(cudaDevAttrIntegrated, device) == 1;
+}
+
+inline int32_t get_max_persisting_l2_cache_size(int32_t device) noexcept {
+    return get_device_attribute(cudaDevAttrMaxPersistingL2CacheSize, device);
+}
+
+inline int32_t get_max_access_policy_window_size(int32_t device) noexcept {
+    return get_device_attribute(cudaDevAttrMaxAccessPolicyWindowSize, device);
+}
+
+inline int32_t get_l2_cache_size(int32_t device) noexcept {
+    return get_device_attribute(cudaDevAttrL2CacheSize, device);
+}
+
+// The L2 set-aside for persisting accesses on the current device (cudaLimitPersistingL2CacheSize).
+inline bool set_persisting_l2_cache_limit(std::size_t size) noexcept {
+    return cudaDeviceSetLimit(cudaLimitPersistingL2CacheSize, size) == cudaSuccess;
+}
+
+// Demotes every persisting line in L2 to normal.
+inline bool reset_persisting_l2_cache() noexcept {
+    return cudaCtxResetPersistingL2Cache() == cudaSuccess;
+}
+
+// PCI address as domain:bus:device.function, e.g. "0000:3B:00.0".
+inline rust::String get_pci_bus_id(int32_t device) noexcept {
+    char bus_id[32] = {};
+    if (cudaDeviceGetPCIBusId(bus_id, sizeof(bus_id), device) != cudaSuccess) {
+        return rust::String();
+    }
+    return rust::String(bus_id);
+}
+
+// Free and total memory of the current device.
+inline bool get_mem_info(std::size_t& free, std::size_t& total) noexcept {
+    return cudaMemGetInfo(&free, &total) == cudaSuccess;
+}
+
+// Retains the primary context of `device`, as the runtime uses it, and returns it; 0 on error.
+// Balanced by release_primary_context.
+inline std::size_t retain_primary_context(int32_t device) noexcept {
+    CUdevice handle = 0;
+    CUcontext ctx = nullptr;
+    if (cuDeviceGet(&handle, device) != CUDA_SUCCESS || cuDevicePrimaryCtxRetain(&ctx, handle) != CUDA_SUCCESS) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(ctx);
+}
+
+inline void release_primary_context(int32_t device) noexcept {
+    CUdevice handle = 0;
+    if (cuDeviceGet(&handle, device) == CUDA_SUCCESS) {
+        cuDevicePrimaryCtxRelease(handle);
+    }
+}
+
+// Binds `ctx` to the calling thread unless it is current already. The check is a read of
+// the driver's thread-local state; the context is set in place of the current one, without
+// a push that would have to be popped again.
+inline bool make_context_current(std::size_t ctx) noexcept {
+    CUcontext current = nullptr;
+    if (cuCtxGetCurrent(&current) != CUDA_SUCCESS) {
+        return false;
+    }
+    const auto target = reinterpret_cast<CUcontext>(ctx);
+    return current == target || cuCtxSetCurrent(target) == CUDA_SUCCESS;
+}
+
+} // namespace trt_rs::device
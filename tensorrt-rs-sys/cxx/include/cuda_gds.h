@@ -0,0 +1,140 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "rust/cxx.h"
+
+#ifdef TRT_RS_GDS
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <mutex>
+#include <string>
+#include <cufile.h>
+#endif
+
+namespace trt_rs::gds {
+
+#ifdef TRT_RS_GDS
+// cuFileDriverOpen once per process; the driver stays open until exit.
+inline bool open_driver() noexcept {
+    static std::once_flag once;
+    static bool opened = false;
+    std::call_once(once, [] { opened = cuFileDriverOpen().err == CU_FILE_SUCCESS; });
+    return opened;
+}
+#endif
+
+// True when built with the gds feature and the cuFile driver (nvidia-fs) is usable.
+inline bool gds_available() noexcept {
+#ifdef TRT_RS_GDS
+    return open_driver();
+#else
+    return false;
+#endif
+}
+
+// A file opened with O_DIRECT and registered with cuFile, read by DMA from storage straight
+// into device memory (GPUDirect Storage), without a bounce buffer in host memory.
+class GdsFile {
+public:
+#ifdef TRT_RS_GDS
+    GdsFile(int fd, CUfileHandle_t handle, std::size_t size) : fd_(fd), handle_(handle), size_(size) {}
+
+    ~GdsFile() {
+        cuFileHandleDeregister(handle_);
+        close(fd_);
+    }
+#endif
+
+    // Reads `size` bytes at `offset` of the file into device memory at `ptr`. Returns the
+    // bytes read, short at the end of the file, or -1.
+    std::int64_t read(std::size_t ptr, std::size_t size, std::size_t offset) const noexcept {
+#ifdef TRT_RS_GDS
+        std::size_t done = 0;
+        while (done < size) {
+            const auto n = cuFileRead(handle_, reinterpret_cast<void*>(ptr), size - done, offset + done, done);
+            if (n < 0) {
+                return -1;
+            }
+            if (n == 0) {
+                break;
+            }
+            done += static_cast<std::size_t>(n);
+        }
+        return static_cast<std::int64_t>(done);
+#else
+        (void)ptr;
+        (void)size;
+        (void)offset;
+        return -1;
+#endif
+    }
+
+    std::size_t size() const noexcept {
+#ifdef TRT_RS_GDS
+        return size_;
+#else
+        return 0;
+#endif
+    }
+
+#ifdef TRT_RS_GDS
+private:
+    int fd_;
+    CUfileHandle_t handle_;
+    std::size_t size_;
+#endif
+};
+
+// Null without GDS, or when the file cannot be opened for direct IO.
+inline std::unique_ptr<GdsFile> open_gds_file(rust::Str path) noexcept {
+#ifdef TRT_RS_GDS
+    if (!open_driver()) {
+        return nullptr;
+    }
+    const std::string name(path.data(), path.size());
+    const int fd = open(name.c_str(), O_RDONLY | O_DIRECT);
+    if (fd < 0) {
+        return nullptr;
+    }
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return nullptr;
+    }
+    CUfileDescr_t descr = {};
+    descr.handle.fd = fd;
+    descr.type = CU_FILE_HANDLE_TYPE_OPAQUE_FD;
+    CUfileHandle_t handle = nullptr;
+    if (cuFileHandleRegister(&handle, &descr).err != CU_FILE_SUCCESS) {
+        close(fd);
+        return nullptr;
+    }
+    return std::make_unique<GdsFile>(fd, handle, static_cast<std::size_t>(st.st_size));
+#else
+    (void)path;
+    return nullptr;
+#endif
+}
+
+// cuFileBufRegister: pins the device buffer for DMA once, instead of on every read.
+inline bool register_gds_buffer(std::size_t ptr, std::size_t size) noexcept {
+#ifdef TRT_RS_GDS
+    return cuFileBufRegister(reinterpret_cast<void*>(ptr), size, 0).err == CU_FILE_SUCCESS;
+#else
+    (void)ptr;
+    (void)size;
+    return false;
+#endif
+}
+
+inline void deregister_gds_buffer(std::size_t ptr) noexcept {
+#ifdef TRT_RS_GDS
+    cuFileBufDeregister(reinterpret_cast<void*>(ptr));
+#else
+    (void)ptr;
+#endif
+}
+
+} // namespace trt_rs::gds
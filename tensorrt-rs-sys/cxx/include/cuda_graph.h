@@ -0,0 +1,65 @@
+#pragma once
+
+#include <memory>
+#include <cuda_runtime_api.h>
+#include "rust/cxx.h"
+
+namespace trt_rs::graph {
+
+inline bool begin_capture(std::size_t stream) noexcept {
+    // Thread-local mode: unrelated CUDA calls made by other threads while this stream is
+    // being captured are neither captured nor invalidate the capture.
+    return cudaStreamBeginCapture(
+        reinterpret_cast<cudaStream_t>(stream), cudaStreamCaptureModeThreadLocal) == cudaSuccess;
+}
+
+inline std::size_t end_capture(std::size_t stream) noexcept {
+    cudaGraph_t graph = nullptr;
+    if (cudaStreamEndCapture(reinterpret_cast<cudaStream_t>(stream), &graph) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(graph);
+}
+
+inline void destroy_graph(std::size_t graph) noexcept {
+    cudaGraphDestroy(reinterpret_cast<cudaGraph_t>(graph));
+}
+
+inline std::size_t instantiate_graph(std::size_t graph) noexcept {
+    cudaGraphExec_t exec = nullptr;
+    if (cudaGraphInstantiateWithFlags(&exec, reinterpret_cast<cudaGraph_t>(graph), 0) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(exec);
+}
+
+// Swaps the node parameters of `graph`, captured from the same work with other addresses or
+// sizes, into `exec`; false when their topologies differ. A rejected update is expected, so
+// its error is cleared rather than left for the next cudaGetLastError to report.
+inline bool update_graph_exec(std::size_t exec, std::size_t graph) noexcept {
+    const auto exec_handle = reinterpret_cast<cudaGraphExec_t>(exec);
+    const auto graph_handle = reinterpret_cast<cudaGraph_t>(graph);
+#if CUDART_VERSION >= 12000
+    cudaGraphExecUpdateResultInfo info;
+    const bool updated = cudaGraphExecUpdate(exec_handle, graph_handle, &info) == cudaSuccess;
+#else
+    cudaGraphNode_t error_node = nullptr;
+    cudaGraphExecUpdateResult result;
+    const bool updated = cudaGraphExecUpdate(exec_handle, graph_handle, &error_node, &result) == cudaSuccess;
+#endif
+    if (!updated) {
+        cudaGetLastError();
+    }
+    return updated;
+}
+
+inline bool launch_graph(std::size_t exec, std::size_t stream) noexcept {
+    return cudaGraphLaunch(
+        reinterpret_cast<cudaGraphExec_t>(exec), reinterpret_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+inline void destroy_graph_exec(std::size_t exec) noexcept {
+    cudaGraphExecDestroy(reinterpret_cast<cudaGraphExec_t>(exec));
+}
+
+} // namespace trt_rs::graph
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cuda.h>
+#include <cstdint>
+#include <memory>
+#include "rust/cxx.h"
+
+// Green contexts came with the CUDA 12.4 driver API
+#if CUDA_VERSION >= 12040
+#define TRT_RS_GREEN_CONTEXTS
+#endif
+
+namespace trt_rs::green {
+
+// True when built against CUDA 12.4 or later and the driver is as recent.
+inline bool green_contexts_supported() noexcept {
+#ifdef TRT_RS_GREEN_CONTEXTS
+    int version = 0;
+    return cuDriverGetVersion(&version) == CUDA_SUCCESS && version >= 12040;
+#else
+    return false;
+#endif
+}
+
+// A context limited to a group of the device's SMs. Kernels launched on its streams run on
+// those SMs only, while memory is shared with the device's primary context, so buffers
+// allocated there are used as they are.
+class GreenContext {
+public:
+#ifdef TRT_RS_GREEN_CONTEXTS
+    GreenContext(CUgreenCtx ctx, std::uint32_t sm_count) : ctx_(ctx), sm_count_(sm_count) {}
+
+    ~GreenContext() {
+        cuGreenCtxDestroy(ctx_);
+    }
+#endif
+
+    // A non-blocking stream of the green context, as create_stream; 0 on error.
+    std::size_t create_stream(std::int32_t priority) const noexcept {
+#ifdef TRT_RS_GREEN_CONTEXTS
+        CUstream stream = nullptr;
+        if (cuGreenCtxStreamCreate(&stream, ctx_, CU_STREAM_NON_BLOCKING, priority) != CUDA_SUCCESS) {
+            return 0;
+        }
+        return reinterpret_cast<std::size_t>(stream);
+#else
+        (void)priority;
+        return 0;
+#endif
+    }
+
+    std::uint32_t sm_count() const noexcept {
+#ifdef TRT_RS_GREEN_CONTEXTS
+        return sm_count_;
+#else
+        return 0;
+#endif
+    }
+
+#ifdef TRT_RS_GREEN_CONTEXTS
+private:
+    CUgreenCtx ctx_;
+    std::uint32_t sm_count_;
+#endif
+};
+
+// The SMs of a device not given to a green context yet. Each take splits a disjoint group
+// off the rest, so the green contexts of one partitioner never share SMs.
+class SmPartitioner {
+public:
+#ifdef TRT_RS_GREEN_CONTEXTS
+    SmPartitioner(CUdevice device, CUdevResource remaining) : device_(device), remaining_(remaining) {}
+#endif
+
+    // A green context of at least `sm_count` SMs, rounded up to the device's SM granularity,
+    // or null if fewer remain.
+    std::unique_ptr<GreenContext> take(std::uint32_t sm_count) noexcept {
+#ifdef TRT_RS_GREEN_CONTEXTS
+        CUdevResource group = {};
+        CUdevResource rest = {};
+        unsigned int groups = 1;
+        if (cuDevSmResourceSplitByCount(&group, &groups, &remaining_, &rest, 0, sm_count) != CUDA_SUCCESS
+            || groups != 1) {
+            return nullptr;
+        }
+        CUdevResourceDesc desc = nullptr;
+        CUgreenCtx ctx = nullptr;
+        if (cuDevResourceGenerateDesc(&desc, &group, 1) != CUDA_SUCCESS
+            || cuGreenCtxCreate(&ctx, desc, device_, CU_GREEN_CTX_DEFAULT_STREAM) != CUDA_SUCCESS) {
+            return nullptr;
+        }
+        remaining_ = rest;
+        return std::make_unique<GreenContext>(ctx, group.sm.smCount);
+#else
+        (void)sm_count;
+        return nullptr;
+#endif
+    }
+
+    std::uint32_t remaining() const noexcept {
+#ifdef TRT_RS_GREEN_CONTEXTS
+        return remaining_.sm.smCount;
+#else
+        return 0;
+#endif
+    }
+
+#ifdef TRT_RS_GREEN_CONTEXTS
+private:
+    CUdevice device_;
+    CUdevResource remaining_;
+#endif
+};
+
+// Every SM of `device`, or null without green contexts.
+inline std::unique_ptr<SmPartitioner> create_sm_partitioner(std::int32_t device) noexcept {
+#ifdef TRT_RS_GREEN_CONTEXTS
+    if (!green_contexts_supported()) {
+        return nullptr;
+    }
+    CUdevice handle = 0;
+    CUdevResource resource = {};
+    if (cuDeviceGet(&handle, device) != CUDA_SUCCESS
+        || cuDeviceGetDevResource(handle, &resource, CU_DEV_RESOURCE_TYPE_SM) != CUDA_SUCCESS) {
+        return nullptr;
+    }
+    return std::make_unique<SmPartitioner>(handle, resource);
+#else
+    (void)device;
+    return nullptr;
+#endif
+}
+
+} // namespace trt_rs::green
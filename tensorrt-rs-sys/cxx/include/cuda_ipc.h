@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstring>
+#include <cuda_runtime_api.h>
+#include "rust/cxx.h"
+
+namespace trt_rs::ipc {
+
+static_assert(sizeof(cudaIpcMemHandle_t) == 64 && sizeof(cudaIpcEventHandle_t) == 64);
+
+// cudaMalloc'd memory of its own, so that its IPC handle maps exactly this buffer (handles
+// of sub-allocations map the whole enclosing allocation). Freed with free_shareable.
+inline std::size_t alloc_shareable(std::size_t size) noexcept {
+    void* ptr = nullptr;
+    if (cudaMalloc(&ptr, size) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(ptr);
+}
+
+inline void free_shareable(std::size_t ptr) noexcept {
+    cudaFree(reinterpret_cast<void*>(ptr));
+}
+
+inline bool get_mem_handle(std::size_t ptr, rust::Slice<std::uint8_t> handle) noexcept {
+    cudaIpcMemHandle_t ipc = {};
+    if (handle.size() != sizeof(ipc) || cudaIpcGetMemHandle(&ipc, reinterpret_cast<void*>(ptr)) != cudaSuccess) {
+        return false;
+    }
+    std::memcpy(handle.data(), &ipc, sizeof(ipc));
+    return true;
+}
+
+// Maps memory exported by another process into this one, or returns 0.
+inline std::size_t open_mem_handle(rust::Slice<const std::uint8_t> handle) noexcept {
+    cudaIpcMemHandle_t ipc = {};
+    if (handle.size() != sizeof(ipc)) {
+        return 0;
+    }
+    std::memcpy(&ipc, handle.data(), sizeof(ipc));
+    void* ptr = nullptr;
+    if (cudaIpcOpenMemHandle(&ptr, ipc, cudaIpcMemLazyEnablePeerAccess) != cudaSuccess) {
+        cudaGetLastError();
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(ptr);
+}
+
+inline void close_mem_handle(std::size_t ptr) noexcept {
+    cudaIpcCloseMemHandle(reinterpret_cast<void*>(ptr));
+}
+
+// Interprocess events cannot be timing-enabled; destroyed with destroy_event.
+inline std::size_t create_ipc_event() noexcept {
+    cudaEvent_t event = nullptr;
+    if (cudaEventCreateWithFlags(&event, cudaEventInterprocess | cudaEventDisableTiming) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(event);
+}
+
+inline bool get_event_handle(std::size_t event, rust::Slice<std::uint8_t> handle) noexcept {
+    cudaIpcEventHandle_t ipc = {};
+    if (handle.size() != sizeof(ipc)
+        || cudaIpcGetEventHandle(&ipc, reinterpret_cast<cudaEvent_t>(event)) != cudaSuccess) {
+        return false;
+    }
+    std::memcpy(handle.data(), &ipc, sizeof(ipc));
+    return true;
+}
+
+inline std::size_t open_event_handle(rust::Slice<const std::uint8_t> handle) noexcept {
+    cudaIpcEventHandle_t ipc = {};
+    if (handle.size() != sizeof(ipc)) {
+        return 0;
+    }
+    std::memcpy(&ipc, handle.data(), sizeof(ipc));
+    cudaEvent_t event = nullptr;
+    if (cudaIpcOpenEventHandle(&event, ipc) != cudaSuccess) {
+        cudaGetLastError();
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(event);
+}
+
+} // namespace trt_rs::ipc
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <memory>
+#include <cuda_runtime_api.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "rust/cxx.h"
+
+namespace trt_rs::memory {
+
+inline bool memcpy_async(std::size_t dst, std::size_t src, std::size_t size, int32_t kind, std::size_t stream) noexcept {
+    return cudaMemcpyAsync(
+        reinterpret_cast<void*>(dst),
+        reinterpret_cast<const void*>(src),
+        size,
+        static_cast<cudaMemcpyKind>(kind),
+        reinterpret_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+inline bool memcpy_2d_async(
+    std::size_t dst, std::size_t dst_pitch, std::size_t src, std::size_t src_pitch,
+    std::size_t width, std::size_t height, int32_t kind, std::size_t stream) noexcept {
+    return cudaMemcpy2DAsync(
+        reinterpret_cast<void*>(dst), dst_pitch,
+        reinterpret_cast<const void*>(src), src_pitch,
+        width, height,
+        static_cast<cudaMemcpyKind>(kind),
+        reinterpret_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+// `depth` slices of `height` rows of `width` bytes; each buffer's slice pitch is its row
+// pitch times its slice height.
+inline bool memcpy_3d_async(
+    std::size_t dst, std::size_t dst_pitch, std::size_t dst_height,
+    std::size_t src, std::size_t src_pitch, std::size_t src_height,
+    std::size_t width, std::size_t height, std::size_t depth,
+    int32_t kind, std::size_t stream) noexcept {
+    cudaMemcpy3DParms params = {};
+    params.dstPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(dst), dst_pitch, width, dst_height);
+    params.srcPtr = make_cudaPitchedPtr(reinterpret_cast<void*>(src), src_pitch, width, src_height);
+    params.extent = make_cudaExtent(width, height, depth);
+    params.kind = static_cast<cudaMemcpyKind>(kind);
+    return cudaMemcpy3DAsync(&params, reinterpret_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+inline bool memset_async(std::size_t dst, int32_t value, std::size_t size, std::size_t stream) noexcept {
+    return cudaMemsetAsync(
+        reinterpret_cast<void*>(dst), value, size, reinterpret_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+// Ordinal of the device owning `ptr`, or -1 if it is not a CUDA allocation.
+inline int32_t get_pointer_device(std::size_t ptr) noexcept {
+    cudaPointerAttributes attributes = {};
+    if (cudaPointerGetAttributes(&attributes, reinterpret_cast<const void*>(ptr)) != cudaSuccess) {
+        cudaGetLastError();
+        return -1;
+    }
+    return attributes.type == cudaMemoryTypeUnregistered ? -1 : attributes.device;
+}
+
+// Page-locked host memory, so async copies from it are truly asynchronous instead of being
+// staged through a driver bounce buffer.
+inline std::size_t host_alloc(std::size_t size) noexcept {
+    void* ptr = nullptr;
+    if (cudaHostAlloc(&ptr, size, cudaHostAllocDefault) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(ptr);
+}
+
+inline void free_host(std::size_t ptr) noexcept {
+    cudaFreeHost(reinterpret_cast<void*>(ptr));
+}
+
+// Page-locked host memory mapped into the device address space, freed with free_host. On
+// integrated GPUs it is the same DRAM the device reads, so kernels use it without copies.
+inline std::size_t host_alloc_mapped(std::size_t size) noexcept {
+    void* ptr = nullptr;
+    if (cudaHostAlloc(&ptr, size, cudaHostAllocMapped) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(ptr);
+}
+
+// Device address of mapped host memory, or 0 if `ptr` is not mapped.
+inline std::size_t get_mapped_device_pointer(std::size_t ptr) noexcept {
+    void* device = nullptr;
+    if (cudaHostGetDevicePointer(&device, reinterpret_cast<void*>(ptr), 0) != cudaSuccess) {
+        cudaGetLastError();
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(device);
+}
+
+// Unified memory, addressable from the host and every device under the same pointer.
+inline std::size_t managed_alloc(std::size_t size) noexcept {
+    void* ptr = nullptr;
+    if (cudaMallocManaged(&ptr, size, cudaMemAttachGlobal) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(ptr);
+}
+
+inline void free_managed(std::size_t ptr) noexcept {
+    cudaFree(reinterpret_cast<void*>(ptr));
+}
+
+// Page-locked host memory whose pages are bound (mbind MPOL_BIND) to NUMA `node`, e.g. the
+// node closest to the GPU it is copied to. Returns 0 if the memory cannot be placed there.
+inline std::size_t host_alloc_on_node(std::size_t size, int32_t node) noexcept {
+#ifdef __linux__
+    constexpr int mpol_bind = 2;
+    constexpr int max_nodes = 1024;
+    constexpr int bits = 8 * sizeof(unsigned long);
+    if (node < 0 || node >= max_nodes - 1) {
+        return 0;
+    }
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ptr == MAP_FAILED) {
+        return 0;
+    }
+    unsigned long node_mask[max_nodes / bits] = {};
+    node_mask[node / bits] = 1UL << (node % bits);
+    // pages are faulted in on the bound node when cudaHostRegister pins them
+    if (syscall(SYS_mbind, ptr, size, mpol_bind, node_mask, max_nodes, 0) != 0
+        || cudaHostRegister(ptr, size, cudaHostRegisterDefault) != cudaSuccess) {
+        cudaGetLastError();
+        munmap(ptr, size);
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(ptr);
+#else
+    return 0;
+#endif
+}
+
+inline void free_host_on_node(std::size_t ptr, std::size_t size) noexcept {
+#ifdef __linux__
+    cudaHostUnregister(reinterpret_cast<void*>(ptr));
+    munmap(reinterpret_cast<void*>(ptr), size);
+#endif
+}
+
+} // namespace trt_rs::memory
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <memory>
+#include <cuda_runtime_api.h>
+#include "rust/cxx.h"
+
+namespace trt_rs::stream {
+
+struct HostCallback;
+
+// Runs the callback on a CUDA driver thread once all work queued on the stream before it
+// has completed. The callback must not make CUDA calls.
+bool launch_host_func(std::size_t stream, rust::Box<HostCallback> callback) noexcept;
+
+// Non-blocking stream; lower `priority` values are scheduled first (see
+// get_stream_priority_range).
+inline std::size_t create_stream(int32_t priority) noexcept {
+    cudaStream_t stream = nullptr;
+    if (cudaStreamCreateWithPriority(&stream, cudaStreamNonBlocking, priority) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(stream);
+}
+
+inline void destroy_stream(std::size_t stream) noexcept {
+    cudaStreamDestroy(reinterpret_cast<cudaStream_t>(stream));
+}
+
+inline bool synchronize_stream(std::size_t stream) noexcept {
+    return cudaStreamSynchronize(reinterpret_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+// Least (lowest urgency, the default) and greatest stream priority of the current device.
+inline int32_t get_least_stream_priority() noexcept {
+    int least = 0;
+    int greatest = 0;
+    cudaDeviceGetStreamPriorityRange(&least, &greatest);
+    return least;
+}
+
+inline int32_t get_greatest_stream_priority() noexcept {
+    int least = 0;
+    int greatest = 0;
+    cudaDeviceGetStreamPriorityRange(&least, &greatest);
+    return greatest;
+}
+
+inline std::size_t create_event(bool disable_timing) noexcept {
+    cudaEvent_t event = nullptr;
+    const auto flags = disable_timing ? cudaEventDisableTiming : cudaEventDefault;
+    if (cudaEventCreateWithFlags(&event, flags) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(event);
+}
+
+// Synchronizing on it puts the calling thread to sleep instead of spinning, whatever the
+// context's scheduling flags.
+inline std::size_t create_blocking_event() noexcept {
+    cudaEvent_t event = nullptr;
+    if (cudaEventCreateWithFlags(&event, cudaEventBlockingSync | cudaEventDisableTiming) != cudaSuccess) {
+        return 0;
+    }
+    return reinterpret_cast<std::size_t>(event);
+}
+
+inline void destroy_event(std::size_t event) noexcept {
+    cudaEventDestroy(reinterpret_cast<cudaEvent_t>(event));
+}
+
+inline bool record_event(std::size_t event, std::size_t stream) noexcept {
+    return cudaEventRecord(
+        reinterpret_cast<cudaEvent_t>(event), reinterpret_cast<cudaStream_t>(stream)) == cudaSuccess;
+}
+
+inline bool stream_wait_event(std::size_t stream, std::size_t event) noexcept {
+    return cudaStreamWaitEvent(
+        reinterpret_cast<cudaStream_t>(stream), reinterpret_cast<cudaEvent_t>(event), 0) == cudaSuccess;
+}
+
+inline bool synchronize_event(std::size_t event) noexcept {
+    return cudaEventSynchronize(reinterpret_cast<cudaEvent_t>(event)) == cudaSuccess;
+}
+
+// Milliseconds between the last records of two timing-enabled events, or -1.
+inline float event_elapsed_time(std::size_t start, std::size_t end) noexcept {
+    float ms = 0.0f;
+    if (cudaEventElapsedTime(&ms, reinterpret_cast<cudaEvent_t>(start), reinterpret_cast<cudaEvent_t>(end)) != cudaSuccess) {
+        return -1.0f;
+    }
+    return ms;
+}
+
+// True once all work captured by the last record has completed.
+inline bool query_event(std::size_t event) noexcept {
+    return cudaEventQuery(reinterpret_cast<cudaEvent_t>(event)) == cudaSuccess;
+}
+
+// cudaError_t of the work captured by the last record: 0 once it completed, 600
+// (cudaErrorNotReady) while it runs, or the asynchronous error it raised.
+inline int32_t query_event_status(std::size_t event) noexcept {
+    return static_cast<int32_t>(cudaEventQuery(reinterpret_cast<cudaEvent_t>(event)));
+}
+
+inline int32_t synchronize_event_status(std::size_t event) noexcept {
+    return static_cast<int32_t>(cudaEventSynchronize(reinterpret_cast<cudaEvent_t>(event)));
+}
+
+// Returns and resets the last error of the calling thread; sticky errors are not reset.
+inline int32_t get_last_error() noexcept {
+    return static_cast<int32_t>(cudaGetLastError());
+}
+
+inline rust::String get_error_name(int32_t error) noexcept {
+    return rust::String(cudaGetErrorName(static_cast<cudaError_t>(error)));
+}
+
+// Marks accesses by kernels on `stream` to [base, base + num_bytes) as L2-persisting for a
+// `hit_ratio` fraction of the window, the rest as streaming. num_bytes == 0 clears it.
+inline bool set_access_policy_window(
+    std::size_t stream, std::size_t base, std::size_t num_bytes, float hit_ratio) noexcept {
+    cudaStreamAttrValue attr = {};
+    attr.accessPolicyWindow.base_ptr = reinterpret_cast<void*>(base);
+    attr.accessPolicyWindow.num_bytes = num_bytes;
+    attr.accessPolicyWindow.hitRatio = num_bytes == 0 ? 0.0f : hit_ratio;
+    attr.accessPolicyWindow.hitProp = num_bytes == 0 ? cudaAccessPropertyNormal : cudaAccessPropertyPersisting;
+    attr.accessPolicyWindow.missProp = cudaAccessPropertyStreaming;
+    return cudaStreamSetAttribute(
+        reinterpret_cast<cudaStream_t>(stream), cudaStreamAttributeAccessPolicyWindow, &attr) == cudaSuccess;
+}
+
+} // namespace trt_rs::stream
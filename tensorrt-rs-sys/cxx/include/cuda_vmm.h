@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cuda.h>
+#include <memory>
+#include <vector>
+#include "rust/cxx.h"
+
+namespace trt_rs::vmm {
+
+// A reserved virtual address range whose pages are mapped on demand (cuMemAddressReserve,
+// cuMemCreate, cuMemMap), so the buffer grows without its address changing. Physical
+// memory is added in chunks of the device's allocation granularity. The destructor unmaps
+// and releases everything; no work may still be using the range.
+class VirtualMemory {
+public:
+    VirtualMemory(CUdeviceptr base, std::size_t reserved, std::size_t granularity, CUdevice device)
+        : base_(base), reserved_(reserved), granularity_(granularity), device_(device) {}
+
+    ~VirtualMemory();
+
+    // Maps physical memory until at least `size` bytes from the base are backed. False if
+    // that exceeds the reservation or the device is out of memory, leaving the size as is.
+    bool grow(std::size_t size) noexcept;
+
+    std::size_t get_raw() const noexcept {
+        return static_cast<std::size_t>(base_);
+    }
+
+    // Bytes backed by physical memory.
+    std::size_t size() const noexcept {
+        return mapped_;
+    }
+
+    std::size_t reserved() const noexcept {
+        return reserved_;
+    }
+
+    std::size_t granularity() const noexcept {
+        return granularity_;
+    }
+private:
+    struct Chunk {
+        CUmemGenericAllocationHandle handle;
+        std::size_t offset;
+        std::size_t size;
+    };
+
+    CUdeviceptr base_;
+    std::size_t reserved_;
+    std::size_t granularity_;
+    CUdevice device_;
+    std::size_t mapped_ = 0;
+    std::vector<Chunk> chunks_;
+};
+
+// Reserves `reserve` bytes (rounded up to the granularity) of address space on `device`,
+// or returns null if the device does not support virtual memory management.
+std::unique_ptr<VirtualMemory> create_virtual_memory(std::size_t reserve, int32_t device) noexcept;
+
+} // namespace trt_rs::vmm
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <NvInferRuntime.h>
+#include "rust/cxx.h"
+
+namespace trt_rs::error_recorder {
+
+struct RecordedError;
+
+// IErrorRecorder keeping the last `capacity` errors TensorRT reports in a fixed ring, so a
+// failed call can be attributed to the object it came from instead of only the shared
+// logger. Reporting never locks or allocates: a writer claims a slot with one fetch_add and
+// publishes it through the slot's sequence number, which readers check (seqlock style) to
+// skip entries overwritten while they read them.
+class ErrorTable : public nvinfer1::IErrorRecorder {
+public:
+    explicit ErrorTable(std::size_t capacity)
+        : capacity_(capacity == 0 ? 1 : capacity), slots_(new Slot[capacity_]) {}
+
+    int32_t getNbErrors() const noexcept override;
+
+    nvinfer1::ErrorCode getErrorCode(int32_t errorIdx) const noexcept override;
+
+    ErrorDesc getErrorDesc(int32_t errorIdx) const noexcept override;
+
+    bool hasOverflowed() const noexcept override;
+
+    void clear() noexcept override;
+
+    bool reportError(nvinfer1::ErrorCode val, ErrorDesc desc) noexcept override;
+
+    // lifetime is managed by the shared_ptr of ErrorRecorder, not by TensorRT
+    RefCount incRefCount() noexcept override {
+        return ++ref_count_;
+    }
+
+    RefCount decRefCount() noexcept override {
+        return --ref_count_;
+    }
+
+    // The recorded errors, oldest first, clearing them.
+    rust::Vec<RecordedError> take() noexcept;
+private:
+    struct Slot {
+        // 2 * ticket + 1 while ticket is written, 2 * ticket + 2 once it is complete
+        std::atomic<uint64_t> sequence{0};
+        std::atomic<int32_t> code{0};
+        char desc[kMAX_DESC_LENGTH + 1] = {};
+    };
+
+    // Entry `ticket` if it is still in its slot.
+    bool read(uint64_t ticket, int32_t& code, std::string* desc) const noexcept;
+
+    // first ticket not cleared
+    uint64_t first() const noexcept;
+
+    std::size_t capacity_;
+    std::unique_ptr<Slot[]> slots_;
+    // next ticket to hand out
+    std::atomic<uint64_t> head_{0};
+    std::atomic<uint64_t> tail_{0};
+    std::atomic<RefCount> ref_count_{0};
+};
+
+// Shared so that execution contexts keep the recorder alive while it is attached.
+class ErrorRecorder {
+public:
+    explicit ErrorRecorder(std::size_t capacity) : table_(std::make_shared<ErrorTable>(capacity)) {}
+
+    const std::shared_ptr<ErrorTable>& get() const noexcept {
+        return table_;
+    }
+
+    int32_t num_errors() const noexcept {
+        return table_->getNbErrors();
+    }
+
+    bool has_overflowed() const noexcept {
+        return table_->hasOverflowed();
+    }
+
+    rust::Vec<RecordedError> take_errors() const noexcept {
+        return table_->take();
+    }
+
+    void clear() const noexcept {
+        table_->clear();
+    }
+private:
+    std::shared_ptr<ErrorTable> table_;
+};
+
+std::unique_ptr<ErrorRecorder> create_error_recorder(std::size_t capacity) noexcept;
+
+} // namespace trt_rs::error_recorder
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Host entry points of the CUDA kernels in cxx/src/kernels. Kept free of cxx and CUDA
+// headers so it can be included from both the bridge and nvcc translation units.
+namespace trt_rs::kernels {
+
+// Bilinear resize of a uint8 HWC image into one planar CHW slot of `dst` (FLOAT or HALF),
+// applying out = pixel * scale[c] + bias[c] on the way, in a single pass.
+bool preprocess_image(
+    std::size_t src, int32_t src_width, int32_t src_height, int32_t src_pitch, int32_t channels,
+    std::size_t dst, int32_t dst_width, int32_t dst_height, bool dst_half, bool swap_rb,
+    const float* scale, const float* bias, std::size_t stream) noexcept;
+
+// Per-component statistics of a DB-style (differentiable binarization) probability map.
+struct DbBoxStats {
+    int32_t min_x;
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+    int32_t area;
+    float score_sum;
+};
+
+// Thresholds `prob` (FLOAT or HALF, `width * height`), labels its 8-connected components with
+// union-find and accumulates bounds and mean score of up to `max_boxes` components into
+// `boxes`. `*count` receives the number of components found. `labels` and `roots` are
+// int32 scratch buffers of `width * height` elements.
+bool db_postprocess(
+    std::size_t prob, int32_t width, int32_t height, bool prob_half, float thresh,
+    std::size_t labels, std::size_t roots, std::size_t boxes, int32_t max_boxes,
+    std::size_t count, std::size_t stream) noexcept;
+
+// Batched bilinear crop and resize of a planar [C, H, W] image (FLOAT or HALF) into
+// [count, C, dst_height, dst_width] of the same type. `rects` holds `count` device-side
+// (x0, y0, x1, y1) float rectangles in source pixels, so crops can come from an upstream
+// kernel without a host round trip.
+bool crop_resize(
+    std::size_t src, int32_t channels, int32_t src_height, int32_t src_width, bool half,
+    std::size_t rects, int32_t count, std::size_t dst, int32_t dst_height, int32_t dst_width,
+    std::size_t stream) noexcept;
+
+// Converts between a linear [outer, channels, inner] tensor and a TensorRT vectorized layout
+// with the channel axis padded to a multiple of `components`: channel-blocked
+// [outer][channels / components][inner][components] (CHW4, CHW32, ...), or channel-last
+// [outer][inner][padded channels] (HWC, HWC8, ...). Padding is zeroed when converting to
+// the vectorized layout. `elem_size` is 1, 2 or 4 bytes.
+bool convert_layout(
+    std::size_t src, std::size_t dst, int32_t elem_size, int64_t outer, int64_t channels,
+    int64_t inner, int32_t components, bool channel_last, bool to_vectorized,
+    std::size_t stream) noexcept;
+
+// Converts between a linear [outer, channels, height, width] tensor and the DLA image
+// format [outer][height][padded_width][4] (or [..][1] for one channel). At most 4 channels,
+// of 1 or 2 bytes; padding is zeroed when converting to the DLA format.
+bool convert_dla_hwc4(
+    std::size_t src, std::size_t dst, int32_t elem_size, int64_t outer, int64_t channels, int64_t height,
+    int64_t width, int64_t padded_width, bool to_vectorized, std::size_t stream) noexcept;
+
+// Converts `count` elements between TensorRT data types (nvinfer1::DataType values).
+// Quantized types (INT8, UINT8, FP8) hold real = q * scale; values are rounded to nearest
+// and saturated on the way in.
+bool cast_tensor(
+    std::size_t src, int32_t src_dtype, std::size_t dst, int32_t dst_dtype, int64_t count,
+    float scale, std::size_t stream) noexcept;
+
+// Device-to-device copies of `count` regions in as few launches as possible (one per 128),
+// e.g. the requests of a batch into its input buffer. `copies` holds (src, dst, size in
+// bytes) triples in host memory; the regions must not overlap.
+bool batched_copy(const std::size_t* copies, int32_t count, std::size_t stream) noexcept;
+
+// Sets `count` elements of `dtype` to `value`, stored as cast_tensor stores FLOAT with a
+// scale of 1 (rounded and saturated for the integer types).
+bool fill_tensor(std::size_t dst, int32_t dtype, int64_t count, float value, std::size_t stream) noexcept;
+
+// Sets `count` elements of `dtype` to uniform random values in [low, high): floats with 24
+// random bits, integer types to integers. Values depend on `seed` and the element index
+// only, so a seed always gives the same data.
+bool random_tensor(
+    std::size_t dst, int32_t dtype, int64_t count, float low, float high, uint64_t seed,
+    std::size_t stream) noexcept;
+
+// Attention mask of `rows` sequences of `length` tokens padded to `max_length`: a
+// [rows, max_length] tensor of `dtype` (FLOAT, HALF, INT8, INT32, BOOL, UINT8 or INT64)
+// holding 1 over the tokens and 0 over the padding.
+bool sequence_mask(
+    std::size_t dst, int32_t dtype, int32_t rows, int32_t max_length, int32_t length,
+    std::size_t stream) noexcept;
+
+// Per-row reductions over the last axis of a [rows, cols] FLOAT or HALF tensor, for reading
+// back only what post-processing keeps. normalize_rows writes the L2-normalized rows, or
+// their softmax, as FLOAT [rows, cols]; mean_rows the FLOAT [rows] means.
+bool normalize_rows(
+    std::size_t src, bool half, int64_t rows, int32_t cols, bool softmax, std::size_t dst,
+    std::size_t stream) noexcept;
+
+bool mean_rows(
+    std::size_t src, bool half, int64_t rows, int32_t cols, std::size_t dst, std::size_t stream) noexcept;
+
+// The `k` largest elements of each row, in descending order (the lower index first among
+// equal values): their INT32 [rows, k] indices, and FLOAT [rows, k] values unless `values`
+// is 0. k = 1 is argmax.
+bool topk_rows(
+    std::size_t src, bool half, int64_t rows, int32_t cols, int32_t k, std::size_t values,
+    std::size_t indices, std::size_t stream) noexcept;
+
+// Greedy CTC decoding of the [rows, steps, classes] FLOAT or HALF probabilities (or logits)
+// of a text recognizer: per row, the argmax class of every step with repeats merged and
+// `blank` dropped, as INT32 [rows, steps] labels of which the INT32 [rows] lengths are
+// valid, and the FLOAT [rows] mean of the kept labels' values (0 for an empty row).
+bool ctc_greedy_decode(
+    std::size_t src, bool half, int64_t rows, int32_t steps, int32_t classes, int32_t blank, std::size_t labels,
+    std::size_t lengths, std::size_t scores, std::size_t stream) noexcept;
+
+// Inner products of `num_queries` FLOAT or HALF query rows with the `rows` HALF rows of
+// `index`, all `dim` wide, as FLOAT [num_queries, rows] scores at `dst`; cosine similarities
+// for normalized rows.
+bool similarity(
+    std::size_t queries, bool queries_half, int32_t num_queries, std::size_t index, int32_t rows, int32_t dim,
+    std::size_t dst, std::size_t stream) noexcept;
+
+} // namespace trt_rs::kernels
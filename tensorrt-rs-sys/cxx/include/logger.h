@@ -1,24 +1,110 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <NvInferRuntime.h>
 #include "rust/cxx.h"
 
+namespace spdlog {
+class logger;
+namespace details {
+class thread_pool;
+} // namespace details
+namespace sinks {
+template<typename Mutex>
+class ringbuffer_sink;
+template<typename Mutex>
+class dup_filter_sink;
+} // namespace sinks
+} // namespace spdlog
+
 namespace trt_rs::logger {
 
 using nvinfer1::ILogger;
 
+class RateLimiter;
+struct LogCallback;
+
 class Logger : public ILogger {
 public:
+    // Every logger owns its spdlog logger and console sink, so levels, sinks and sink locks
+    // are not shared between runtimes.
+    explicit Logger(const std::string& name);
+
     void log(Severity severity, const char* msg) noexcept override;
 
     void log(int32_t severity, rust::Str msg) noexcept;
 
     void set_level(int32_t severity) noexcept;
+
+    // Shown in every message, e.g. the engine name.
+    void set_name(rust::Str name) noexcept;
+
+    rust::String get_name() const noexcept;
+
+    // Moves sink I/O off the calling thread: TensorRT's callback only enqueues into a bounded
+    // queue drained by a background thread. `overflow_policy` follows
+    // spdlog::async_overflow_policy (0 block, 1 overrun oldest, 2 discard new).
+    bool set_async(std::size_t queue_size, int32_t overflow_policy) noexcept;
+
+    bool is_async() const noexcept;
+
+    void flush() noexcept;
+
+    // Keeps every message up to `capture_severity` in an in-memory ring of `capacity`
+    // entries, without any I/O; only messages within set_level reach the real sinks.
+    bool enable_capture(std::size_t capacity, int32_t capture_severity) noexcept;
+
+    void disable_capture() noexcept;
+
+    // The last `lines` captured messages, oldest first (0 for all of them).
+    rust::Vec<rust::String> dump_captured(std::size_t lines) const noexcept;
+
+    // Writes the captured messages to the real sinks with their original timestamps and
+    // levels, then clears the ring.
+    void replay_captured() noexcept;
+
+    // For engines that repeat the same warning on every request: identical consecutive
+    // messages within `dedup_window_ms` are dropped by spdlog's dup_filter_sink, and every
+    // distinct message is limited by its own token bucket (`burst` messages, refilled at
+    // `rate_per_sec`). How many were dropped is appended once the message gets through again.
+    bool enable_rate_limit(double rate_per_sec, uint32_t burst, uint32_t dedup_window_ms) noexcept;
+
+    void disable_rate_limit() noexcept;
+
+    // Hands (severity, message) to Rust instead of the spdlog sinks, without any formatting.
+    void set_callback(rust::Box<LogCallback> callback) noexcept;
+
+    void clear_callback() noexcept;
+private:
+    using RingSink = spdlog::sinks::ringbuffer_sink<std::mutex>;
+
+    std::shared_ptr<spdlog::logger> get_logger() const noexcept;
+
+    void write(int32_t severity, const char* msg, std::size_t len) noexcept;
+
+    // checked before anything else, so filtered messages cost one load and one compare
+    std::atomic<int32_t> threshold_;
+    // severity reaching the sinks, and severity kept in the ring (-1 when not capturing)
+    std::atomic<int32_t> level_;
+    std::atomic<int32_t> capture_level_;
+    std::shared_ptr<RingSink> ring_;
+    std::size_t capture_capacity_ = 0;
+    std::shared_ptr<RateLimiter> limiter_;
+    std::shared_ptr<spdlog::sinks::dup_filter_sink<std::mutex>> dedup_;
+    std::shared_ptr<rust::Box<LogCallback>> callback_;
+
+    // declared first so that it outlives the async logger that only holds a weak reference;
+    // swapped atomically too, since is_async may run on another thread than set_async
+    std::shared_ptr<spdlog::details::thread_pool> thread_pool_;
+    // swapped atomically, since TensorRT may log from any thread while the mode changes
+    std::shared_ptr<spdlog::logger> logger_;
 };
 
 std::unique_ptr<Logger> create_logger();
 
-} // namespace trt_rs::logger
+std::unique_ptr<Logger> create_named_logger(rust::Str name);
 
+} // namespace trt_rs::logger
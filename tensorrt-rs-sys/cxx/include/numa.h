@@ -0,0 +1,27 @@
+#pragma once
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+#include "rust/cxx.h"
+
+namespace trt_rs::numa {
+
+// Restricts the calling thread to `cpus`.
+inline bool set_thread_affinity(rust::Slice<const uint32_t> cpus) noexcept {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (const auto cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            return false;
+        }
+        CPU_SET(cpu, &set);
+    }
+    return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+} // namespace trt_rs::numa
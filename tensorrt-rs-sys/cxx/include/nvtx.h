@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include "rust/cxx.h"
+#ifdef TRT_RS_NVTX
+#include <nvtx3/nvToolsExt.h>
+#endif
+
+// Without TRT_RS_NVTX (the `nvtx` cargo feature) every function is a no-op.
+namespace trt_rs::nvtx {
+
+inline bool nvtx_enabled() noexcept {
+#ifdef TRT_RS_NVTX
+    return true;
+#else
+    return false;
+#endif
+}
+
+#ifdef TRT_RS_NVTX
+inline nvtxDomainHandle_t domain() noexcept {
+    static nvtxDomainHandle_t handle = nvtxDomainCreateA("tensorrt-rs");
+    return handle;
+}
+#endif
+
+inline void nvtx_name_category([[maybe_unused]] uint32_t category, [[maybe_unused]] rust::Str name) noexcept {
+#ifdef TRT_RS_NVTX
+    const std::string terminated(name.data(), name.size());
+    nvtxDomainNameCategoryA(domain(), category, terminated.c_str());
+#endif
+}
+
+// `message` ends with a NUL, so it is passed to NVTX without a copy.
+inline void nvtx_range_push([[maybe_unused]] uint32_t category, [[maybe_unused]] rust::Str message) noexcept {
+#ifdef TRT_RS_NVTX
+    nvtxEventAttributes_t attributes = {};
+    attributes.version = NVTX_VERSION;
+    attributes.size = NVTX_EVENT_ATTRIB_STRUCT_SIZE;
+    attributes.category = category;
+    attributes.messageType = NVTX_MESSAGE_TYPE_ASCII;
+    attributes.message.ascii = message.data();
+    nvtxDomainRangePushEx(domain(), &attributes);
+#endif
+}
+
+inline void nvtx_range_pop() noexcept {
+#ifdef TRT_RS_NVTX
+    nvtxDomainRangePop(domain());
+#endif
+}
+
+} // namespace trt_rs::nvtx
@@ -1,11 +1,15 @@
 #pragma once
 
 #include <memory>
+#include <string>
 #include <NvInferRuntime.h>
 #include "rust/cxx.h"
 
 namespace trt_rs::plugin {
 
+struct PluginCreatorInfo;
+struct RustPluginCreator;
+
 using nvinfer1::IPluginRegistry;
 
 inline size_t load_library(rust::Str plugin_path) noexcept {
@@ -19,4 +23,19 @@ inline void unload_library(size_t handle) noexcept {
         reinterpret_cast<IPluginRegistry::PluginLibraryHandle>(handle));
 }
 
+// Registers the plugins of libnvinfer_plugin once per process, under the namespace of the
+// first call.
+bool init_lib_nvinfer_plugins(rust::Str plugin_namespace) noexcept;
+
+// Every creator in the registry, V1 and (TensorRT 10+) V3 alike.
+rust::Vec<PluginCreatorInfo> get_plugin_creators() noexcept;
+
+// Registers a Rust-implemented IPluginCreatorV3One for the rest of the process; false
+// before TensorRT 10, which has no V3 plugins.
+bool register_plugin_creator(
+    rust::Str name,
+    rust::Str version,
+    rust::Str plugin_namespace,
+    rust::Box<RustPluginCreator> creator) noexcept;
+
 } // namespace trt_rs::plugin
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <NvInferRuntime.h>
+#include "rust/cxx.h"
+
+namespace trt_rs::profiler {
+
+struct LayerTiming;
+
+// Per-layer timing aggregation fed by IProfiler::reportLayerTime. Layers are reported in
+// the same order on every enqueue, so the reporting thread finds its slot through a cursor
+// and only updates atomics; the mutex is only taken the first time a layer name is seen.
+class LayerTimingTable : public nvinfer1::IProfiler {
+public:
+    static constexpr std::size_t kMaxLayers = 8192;
+    // log2-spaced histogram buckets, four per octave starting at 1us
+    static constexpr std::size_t kNumBuckets = 128;
+
+    LayerTimingTable() : layers_(new LayerStats[kMaxLayers]) {}
+
+    void reportLayerTime(char const* layerName, float ms) noexcept override;
+
+    rust::Vec<LayerTiming> get_layer_timings() const noexcept;
+
+    void reset() noexcept;
+private:
+    struct LayerStats {
+        std::string name;
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_ns{0};
+        std::atomic<uint64_t> min_ns{UINT64_MAX};
+        std::atomic<uint64_t> max_ns{0};
+        std::array<std::atomic<uint32_t>, kNumBuckets> buckets{};
+    };
+
+    LayerStats* find_or_insert(char const* name) noexcept;
+
+    std::unique_ptr<LayerStats[]> layers_;
+    std::atomic<std::size_t> num_layers_{0};
+    std::atomic<std::size_t> cursor_{0};
+    std::mutex insert_mutex_;
+    std::unordered_map<std::string, std::size_t> index_;
+};
+
+// Shared so that execution contexts keep the profiler alive while it is attached.
+class Profiler {
+public:
+    Profiler() : table_(std::make_shared<LayerTimingTable>()) {}
+
+    const std::shared_ptr<LayerTimingTable>& get() const noexcept {
+        return table_;
+    }
+
+    rust::Vec<LayerTiming> get_layer_timings() const noexcept;
+
+    void reset() const noexcept {
+        table_->reset();
+    }
+private:
+    std::shared_ptr<LayerTimingTable> table_;
+};
+
+std::unique_ptr<Profiler> create_profiler() noexcept;
+
+} // namespace trt_rs::profiler
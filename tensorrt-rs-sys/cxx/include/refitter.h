@@ -0,0 +1,41 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <NvInferRuntime.h>
+#include "rust/cxx.h"
+#include "logger.h"
+#include "runtime.h"
+
+namespace trt_rs::refitter {
+
+using logger::Logger;
+using runtime::CudaEngine;
+
+// Updates the weights of a refittable engine in place. Weight memory is borrowed, not
+// copied, and must stay valid until refit_async has completed on its stream.
+class Refitter {
+public:
+    explicit Refitter(std::unique_ptr<nvinfer1::IRefitter> refitter) : refitter_(std::move(refitter)) {}
+
+    bool set_named_weights(rust::Str name, int32_t dtype, std::size_t values, int64_t count, bool on_device) noexcept;
+
+    rust::Vec<rust::String> get_missing_weights() const noexcept;
+
+    rust::Vec<rust::String> get_all_weights() const noexcept;
+
+    bool refit_async(std::size_t stream) noexcept;
+
+    bool set_max_threads(int32_t threads) noexcept {
+        return refitter_->setMaxThreads(threads);
+    }
+private:
+    // weight names handed to TensorRT, kept alive for the refitter's lifetime
+    std::deque<std::string> names_;
+    std::unique_ptr<nvinfer1::IRefitter> refitter_;
+};
+
+std::unique_ptr<Refitter> create_refitter(CudaEngine& engine, Logger& logger) noexcept;
+
+} // namespace trt_rs::refitter
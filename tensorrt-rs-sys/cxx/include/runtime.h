@@ -1,10 +1,17 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include <NvInferRuntime.h>
 #include "rust/cxx.h"
+#include "allocator.h"
+#include "builder.h"
 #include "logger.h"
 #include "plugin.h"
+#include "error_recorder.h"
+#include "profiler.h"
 
 namespace trt_rs::runtime {
 
@@ -13,15 +20,30 @@ using nvinfer1::ICudaEngine;
 using nvinfer1::IExecutionContext;
 using nvinfer1::Dims;
 using logger::Logger;
+using allocator::GpuAllocator;
+using profiler::Profiler;
+using error_recorder::ErrorRecorder;
 
 class CudaEngine;
 
+struct StreamReader;
+
+struct RustOutputAllocator;
+
+struct TensorDims;
+
+struct TensorBinding;
+
+struct BindingStatus;
+
 class Runtime {
 public:
     Runtime(std::unique_ptr<IRuntime> runtime) : runtime_(std::move(runtime)) {}
 
     std::unique_ptr<CudaEngine> deserialize(rust::Slice<const std::uint8_t> data) noexcept;
 
+    std::unique_ptr<CudaEngine> deserialize_from_stream(StreamReader& reader) noexcept;
+
     bool set_max_threads(int32_t threads) noexcept {
         return runtime_->setMaxThreads(threads);
     }
@@ -37,15 +59,113 @@ public:
     bool get_engine_host_code_allowed() const noexcept {
         return runtime_->getEngineHostCodeAllowed();
     }
+
+    // Replaces this runtime by the one of the lean runtime library at `path`, for plans built
+    // version compatible without their lean runtime. The runtime it was loaded from is kept
+    // alive; settings made before are not carried over.
+    bool load_lean_runtime(rust::Str path) noexcept {
+        const std::string lib(path);
+        IRuntime* lean = runtime_->loadRuntime(lib.c_str());
+        if (lean == nullptr) {
+            return false;
+        }
+        parent_ = std::move(runtime_);
+        runtime_.reset(lean);
+        return true;
+    }
+
+    // Where the lean runtime embedded in a version-compatible plan is written to be loaded.
+    void set_temporary_directory(rust::Str path) noexcept {
+        temporary_directory_ = std::string(path);
+        runtime_->setTemporaryDirectory(temporary_directory_.c_str());
+    }
+
+    void set_tempfile_control_flags(uint32_t flags) noexcept {
+        runtime_->setTempfileControlFlags(static_cast<nvinfer1::TempfileControlFlags>(flags));
+    }
+
+    // DLA core that engines built for DLA are deserialized onto; set before deserialize.
+    void set_dla_core(int32_t core) noexcept {
+        runtime_->setDLACore(core);
+    }
+
+    int32_t get_dla_core() const noexcept {
+        return runtime_->getDLACore();
+    }
+
+    int32_t get_nb_dla_cores() const noexcept {
+        return runtime_->getNbDLACores();
+    }
+
+    void set_gpu_allocator(const GpuAllocator& allocator) noexcept {
+        runtime_->setGpuAllocator(allocator.get().get());
+        allocator_ = allocator.get();
+    }
+
+    // Engines deserialized afterwards report to it too.
+    void set_error_recorder(const ErrorRecorder& recorder) noexcept {
+        runtime_->setErrorRecorder(recorder.get().get());
+        error_recorder_ = recorder.get();
+    }
 private:
+    // declared first so that they outlive the runtime
+    std::shared_ptr<nvinfer1::IGpuAllocator> allocator_;
+    std::shared_ptr<nvinfer1::IErrorRecorder> error_recorder_;
+    std::string temporary_directory_;
+    // the runtime a lean runtime was loaded from
+    std::unique_ptr<IRuntime> parent_;
     std::unique_ptr<IRuntime> runtime_;
 };
 
 class ExecutionContext;
 
+// Layer/tactic introspection of a built engine. Per-layer details (tactics, formats, fused
+// layers) require the engine to be built with ProfilingVerbosity::kDETAILED.
+class EngineInspector {
+public:
+    EngineInspector(std::unique_ptr<nvinfer1::IEngineInspector> inspector)
+        : inspector_(std::move(inspector)) {}
+
+    bool set_execution_context(const ExecutionContext& context) noexcept;
+
+    rust::String get_layer_information(int32_t layer_index, int32_t format) const noexcept {
+        const auto info = inspector_->getLayerInformation(
+            layer_index, static_cast<nvinfer1::LayerInformationFormat>(format));
+        return info ? rust::String(info) : rust::String();
+    }
+
+    rust::String get_engine_information(int32_t format) const noexcept {
+        const auto info = inspector_->getEngineInformation(
+            static_cast<nvinfer1::LayerInformationFormat>(format));
+        return info ? rust::String(info) : rust::String();
+    }
+private:
+    std::unique_ptr<nvinfer1::IEngineInspector> inspector_;
+};
+
+// IO tensor names are owned by the engine and stay valid for its lifetime, so a tensor can be
+// addressed by its IO index ("handle") without building a NUL-terminated copy of its name.
+inline std::vector<const char*> get_io_tensor_names(const ICudaEngine& engine) noexcept {
+    const auto num_io_tensors = engine.getNbIOTensors();
+    auto names = std::vector<const char*>();
+    names.reserve(num_io_tensors);
+    for (int32_t i = 0; i < num_io_tensors; ++i) {
+        names.push_back(engine.getIOTensorName(i));
+    }
+    return names;
+}
+
+inline const char* get_tensor_name(const std::vector<const char*>& names, int32_t handle) noexcept {
+    if (handle < 0 || static_cast<std::size_t>(handle) >= names.size()) {
+        return nullptr;
+    }
+    return names[handle];
+}
+
 class CudaEngine {
 public:
-    CudaEngine(std::unique_ptr<ICudaEngine> engine) : engine_(std::move(engine)) {}
+    CudaEngine(std::unique_ptr<ICudaEngine> engine)
+        : engine_(std::move(engine)), tensor_names_(get_io_tensor_names(*engine_)) {}
 
     rust::Vec<int32_t> get_tensor_shape(rust::Str name) const noexcept;
 
@@ -58,7 +178,7 @@ public:
         return engine_->getNbLayers();
     }
 
-    std::unique_ptr<ExecutionContext> create_execution_context() noexcept;
+    std::unique_ptr<ExecutionContext> create_execution_context() const noexcept;
 
     bool is_shape_inference_io(rust::Str name) const noexcept {
         const auto name_str = std::string(name);
@@ -70,16 +190,98 @@ public:
         return static_cast<int32_t>(engine_->getTensorIOMode(name_str.c_str()));
     }
 
-    std::unique_ptr<ExecutionContext> create_execution_context_without_device_memory() noexcept;
+    int32_t get_tensor_location(rust::Str name) const noexcept {
+        const auto name_str = std::string(name);
+        return static_cast<int32_t>(engine_->getTensorLocation(name_str.c_str()));
+    }
+
+    std::unique_ptr<ExecutionContext> create_execution_context_without_device_memory() const noexcept;
+
+    std::unique_ptr<EngineInspector> create_engine_inspector() const noexcept {
+        auto inspector = engine_->createEngineInspector();
+        if (!inspector) {
+            return nullptr;
+        }
+        return std::make_unique<EngineInspector>(std::unique_ptr<nvinfer1::IEngineInspector>(inspector));
+    }
 
     size_t get_device_memory_size() const noexcept {
         return engine_->getDeviceMemorySize();
     }
 
+    // The scratch a context needs while bound to `profile`; negative on failure. Before
+    // TensorRT 10.1, that of the largest profile, which every context needs there.
+#if NV_TENSORRT_MAJOR * 100 + NV_TENSORRT_MINOR >= 1001
+    int64_t get_device_memory_size_for_profile(int32_t profile) const noexcept {
+        return engine_->getDeviceMemorySizeForProfile(profile);
+    }
+#else
+    int64_t get_device_memory_size_for_profile(int32_t profile) const noexcept {
+        if (profile < 0 || profile >= engine_->getNbOptimizationProfiles()) {
+            return -1;
+        }
+        return static_cast<int64_t>(engine_->getDeviceMemorySize());
+    }
+#endif
+
     bool is_refittable() const noexcept {
         return engine_->isRefittable();
     }
 
+    // The plan of the engine as it is now, e.g. after a refit; null on failure.
+    std::unique_ptr<builder::HostMemory> serialize() const noexcept {
+        auto memory = std::unique_ptr<nvinfer1::IHostMemory>(engine_->serialize());
+        if (!memory) {
+            return nullptr;
+        }
+        return std::make_unique<builder::HostMemory>(std::move(memory));
+    }
+
+    // Weight streaming (TensorRT 10.1+). Engines built with kWEIGHT_STREAMING keep only
+    // `budget` bytes of their streamable weights resident and stream the rest over PCIe.
+    // Older versions report no streamable weights and reject every budget.
+#if NV_TENSORRT_MAJOR * 100 + NV_TENSORRT_MINOR >= 1001
+    int64_t get_streamable_weights_size() const noexcept {
+        return engine_->getStreamableWeightsSize();
+    }
+
+    bool set_weight_streaming_budget(int64_t budget) noexcept {
+        return engine_->setWeightStreamingBudgetV2(budget);
+    }
+
+    int64_t get_weight_streaming_budget() const noexcept {
+        return engine_->getWeightStreamingBudgetV2();
+    }
+
+    int64_t get_weight_streaming_automatic_budget() const noexcept {
+        return engine_->getWeightStreamingAutomaticBudget();
+    }
+
+    int64_t get_weight_streaming_scratch_memory_size() const noexcept {
+        return engine_->getWeightStreamingScratchMemorySize();
+    }
+#else
+    int64_t get_streamable_weights_size() const noexcept {
+        return 0;
+    }
+
+    bool set_weight_streaming_budget(int64_t) noexcept {
+        return false;
+    }
+
+    int64_t get_weight_streaming_budget() const noexcept {
+        return 0;
+    }
+
+    int64_t get_weight_streaming_automatic_budget() const noexcept {
+        return 0;
+    }
+
+    int64_t get_weight_streaming_scratch_memory_size() const noexcept {
+        return 0;
+    }
+#endif
+
     int32_t get_tensor_bytes_per_component(rust::Str name) const noexcept {
         const auto name_str = std::string(name);
         return engine_->getTensorBytesPerComponent(name_str.c_str());
@@ -131,13 +333,57 @@ public:
     int32_t get_num_aux_streams() const noexcept {
         return engine_->getNbAuxStreams();
     }
+
+    int32_t get_profiling_verbosity() const noexcept {
+        return static_cast<int32_t>(engine_->getProfilingVerbosity());
+    }
+
+    int32_t get_tensor_handle(rust::Str name) const noexcept;
+
+    rust::Vec<int32_t> get_tensor_shape_by_handle(int32_t handle) const noexcept;
+
+    int32_t get_tensor_dtype_by_handle(int32_t handle) const noexcept {
+        const auto name = get_tensor_name(tensor_names_, handle);
+        if (!name) {
+            return -1;
+        }
+        return static_cast<int32_t>(engine_->getTensorDataType(name));
+    }
+
+    TensorDims get_tensor_dims(rust::Str name) const noexcept;
+
+    TensorDims get_tensor_dims_by_handle(int32_t handle) const noexcept;
+
+    TensorDims get_profile_dims(rust::Str name, int32_t profile, int32_t select) const noexcept;
+
+    rust::Vec<int32_t> get_profile_tensor_values(rust::Str name, int32_t profile, int32_t select) const noexcept;
+
+    int32_t get_tensor_io_mode_by_handle(int32_t handle) const noexcept {
+        const auto name = get_tensor_name(tensor_names_, handle);
+        if (!name) {
+            return static_cast<int32_t>(nvinfer1::TensorIOMode::kNONE);
+        }
+        return static_cast<int32_t>(engine_->getTensorIOMode(name));
+    }
+
+    ICudaEngine* get_mut() noexcept {
+        return engine_.get();
+    }
+    // Contexts created afterwards report to it too, unless given their own.
+    void set_error_recorder(const ErrorRecorder& recorder) noexcept {
+        engine_->setErrorRecorder(recorder.get().get());
+        error_recorder_ = recorder.get();
+    }
 private:
+    std::shared_ptr<nvinfer1::IErrorRecorder> error_recorder_;
     std::unique_ptr<ICudaEngine> engine_;
+    std::vector<const char*> tensor_names_;
 };
 
 class ExecutionContext {
 public:
-    ExecutionContext(std::unique_ptr<IExecutionContext> context) : context_(std::move(context)) {}
+    ExecutionContext(std::unique_ptr<IExecutionContext> context)
+        : context_(std::move(context)), tensor_names_(get_io_tensor_names(context_->getEngine())) {}
 
     void set_debug_sync(bool sync) noexcept {
         context_->setDebugSync(sync);
@@ -160,6 +406,19 @@ public:
         context_->setDeviceMemory(reinterpret_cast<void*>(memory));
     }
 
+    // `size` need only cover the scratch of the context's profile. Before TensorRT 10.1 the
+    // memory must hold that of the largest profile, which get_device_memory_size_for_profile
+    // reports there, and `size` is not passed on.
+#if NV_TENSORRT_MAJOR * 100 + NV_TENSORRT_MINOR >= 1001
+    void set_device_memory_v2(std::size_t memory, int64_t size) noexcept {
+        context_->setDeviceMemoryV2(reinterpret_cast<void*>(memory), size);
+    }
+#else
+    void set_device_memory_v2(std::size_t memory, [[maybe_unused]] int64_t size) noexcept {
+        context_->setDeviceMemory(reinterpret_cast<void*>(memory));
+    }
+#endif
+
     rust::Vec<int32_t> get_tensor_strides(rust::Str name) const noexcept;
 
     int32_t get_optimization_profile() const noexcept {
@@ -194,6 +453,26 @@ public:
         context_->reportToProfiler();
     }
 
+    void set_profiler(const Profiler& profiler) noexcept {
+        context_->setProfiler(profiler.get().get());
+        profiler_ = profiler.get();
+    }
+
+    void unset_profiler() noexcept {
+        context_->setProfiler(nullptr);
+        profiler_.reset();
+    }
+
+    void set_error_recorder(const ErrorRecorder& recorder) noexcept {
+        context_->setErrorRecorder(recorder.get().get());
+        error_recorder_ = recorder.get();
+    }
+
+    void unset_error_recorder() noexcept {
+        context_->setErrorRecorder(nullptr);
+        error_recorder_.reset();
+    }
+
     bool set_tensor_address(rust::Str name, std::size_t address) noexcept {
         const auto name_str = std::string(name);
         return context_->setTensorAddress(name_str.c_str(), reinterpret_cast<void*>(address));
@@ -214,7 +493,12 @@ public:
         return reinterpret_cast<std::size_t>(context_->getOutputTensorAddress(name_str.c_str()));
     }
 
-    // TODO: inferShapes
+    // 0 once every output shape follows from the input shapes (and shape-tensor values) set
+    // so far, else the number of inputs still unspecified; -1 on an invalid shape.
+    int32_t infer_shapes() noexcept {
+        char const* missing[1];
+        return context_->inferShapes(1, missing);
+    }
 
     bool set_input_consumed_event(std::size_t event) noexcept {
         return context_->setInputConsumedEvent(reinterpret_cast<cudaEvent_t>(event));
@@ -224,17 +508,33 @@ public:
         return reinterpret_cast<std::size_t>(context_->getInputConsumedEvent());
     }
 
-    // TODO: setOutputAllocator
+    bool set_output_allocator(rust::Str name, rust::Box<RustOutputAllocator> allocator) noexcept;
 
     std::size_t get_max_output_size(rust::Str name) const noexcept {
         const auto name_str = std::string(name);
         return context_->getMaxOutputSize(name_str.c_str());
     }
 
-    // TODO: setTemporaryStorageAllocator
+    bool set_temporary_storage_allocator(const GpuAllocator& allocator) noexcept {
+        if (!context_->setTemporaryStorageAllocator(allocator.get().get())) {
+            return false;
+        }
+        temporary_storage_allocator_ = allocator.get();
+        return true;
+    }
 
     bool enqueue_v3(std::size_t stream) noexcept;
 
+    // Applies the bindings in order, stopping at the first that fails, so a request binds all
+    // of its IO tensors in one call.
+    BindingStatus apply_bindings(rust::Slice<const TensorBinding> bindings) noexcept;
+
+    BindingStatus apply_bindings_and_enqueue(
+        rust::Slice<const TensorBinding> bindings, std::size_t stream) noexcept;
+
+    // Resolved shapes of `handles` into `dims`, which must be at least as long.
+    void get_tensor_dims_many(rust::Slice<const int32_t> handles, rust::Slice<TensorDims> dims) const noexcept;
+
     void set_persistent_cache_limit(std::size_t limit) noexcept {
         context_->setPersistentCacheLimit(limit);
     }
@@ -247,15 +547,62 @@ public:
         context_->setNvtxVerbosity(static_cast<nvinfer1::ProfilingVerbosity>(verbosity));
     }
 
+    bool set_input_shape_by_handle(int32_t handle, rust::Slice<const int32_t> dims) noexcept;
+
+    bool set_input_dims_by_handle(int32_t handle, const TensorDims& dims) noexcept;
+
+    TensorDims get_tensor_dims(rust::Str name) const noexcept;
+
+    TensorDims get_tensor_dims_by_handle(int32_t handle) const noexcept;
+
+    TensorDims get_tensor_stride_dims(rust::Str name) const noexcept;
+
+    rust::Vec<int32_t> get_tensor_shape_by_handle(int32_t handle) const noexcept;
+
+    bool set_tensor_address_by_handle(int32_t handle, std::size_t address) noexcept {
+        const auto name = get_tensor_name(tensor_names_, handle);
+        return name && context_->setTensorAddress(name, reinterpret_cast<void*>(address));
+    }
+
+    std::size_t get_tensor_address_by_handle(int32_t handle) const noexcept {
+        const auto name = get_tensor_name(tensor_names_, handle);
+        if (!name) {
+            return 0;
+        }
+        return reinterpret_cast<std::size_t>(context_->getTensorAddress(name));
+    }
+
+    bool set_input_tensor_address_by_handle(int32_t handle, std::size_t address) noexcept {
+        const auto name = get_tensor_name(tensor_names_, handle);
+        return name && context_->setInputTensorAddress(name, reinterpret_cast<void*>(address));
+    }
+
+    const IExecutionContext* get() const noexcept {
+        return context_.get();
+    }
+
     void set_aux_streams(rust::Slice<const std::size_t> streams) noexcept {
         auto streams_ptr = const_cast<cudaStream_t*>(
             reinterpret_cast<cudaStream_t const*>(streams.data()));
         context_->setAuxStreams(streams_ptr, streams.size());
     }
 private:
+    // TensorRT does not take ownership of allocators; they are declared before context_
+    // so that they outlive it
+    std::unordered_map<std::string, std::unique_ptr<nvinfer1::IOutputAllocator>> output_allocators_;
+    std::shared_ptr<nvinfer1::IGpuAllocator> temporary_storage_allocator_;
+    std::shared_ptr<nvinfer1::IProfiler> profiler_;
+    std::shared_ptr<nvinfer1::IErrorRecorder> error_recorder_;
     std::unique_ptr<IExecutionContext> context_;
+    std::vector<const char*> tensor_names_;
 };
 
+// Version of the loaded libnvinfer, major * 1000 + minor * 100 + patch (8.x) or
+// major * 10000 + minor * 100 + patch (10.x).
+inline int32_t get_infer_lib_version() noexcept {
+    return getInferLibVersion();
+}
+
 std::unique_ptr<Runtime> create_runtime(Logger& logger);
 
 } // namespace trt_rs::runtime
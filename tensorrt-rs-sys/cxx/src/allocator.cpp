@@ -0,0 +1,116 @@
+#include "allocator.h"
+#include "tensorrt-rs-sys/src/lib.rs.h"
+
+namespace trt_rs::allocator {
+
+namespace {
+
+class RustGpuAllocatorAdapter : public nvinfer1::IGpuAllocator {
+public:
+    explicit RustGpuAllocatorAdapter(rust::Box<RustGpuAllocator> allocator)
+        : allocator_(std::move(allocator)) {}
+
+    void* allocate(uint64_t size, uint64_t alignment, nvinfer1::AllocatorFlags flags) noexcept override {
+        return reinterpret_cast<void*>(allocator_->allocate(size, alignment, flags));
+    }
+
+#if NV_TENSORRT_MAJOR < 10
+    void free(void* memory) noexcept override {
+        deallocate(memory);
+    }
+#endif
+
+    bool deallocate(void* memory) noexcept override {
+        return allocator_->deallocate(reinterpret_cast<std::size_t>(memory));
+    }
+
+    void* allocateAsync(
+        uint64_t size, uint64_t alignment, nvinfer1::AllocatorFlags flags, cudaStream_t stream) noexcept override {
+        return reinterpret_cast<void*>(allocator_->allocate_async(
+            size, alignment, flags, reinterpret_cast<std::size_t>(stream)));
+    }
+
+    bool deallocateAsync(void* memory, cudaStream_t stream) noexcept override {
+        return allocator_->deallocate_async(
+            reinterpret_cast<std::size_t>(memory), reinterpret_cast<std::size_t>(stream));
+    }
+private:
+    rust::Box<RustGpuAllocator> allocator_;
+};
+
+// Stream-ordered allocator on a dedicated cudaMallocAsync memory pool. With a high release
+// threshold, freed blocks stay in the pool, so steady-state enqueues never reach the
+// driver's (synchronizing) cudaMalloc/cudaFree.
+class MemPoolAllocator : public nvinfer1::IGpuAllocator {
+public:
+    explicit MemPoolAllocator(cudaMemPool_t pool) : pool_(pool) {}
+
+    ~MemPoolAllocator() override {
+        cudaMemPoolDestroy(pool_);
+    }
+
+    void* allocate(uint64_t size, uint64_t alignment, nvinfer1::AllocatorFlags flags) noexcept override {
+        auto memory = allocateAsync(size, alignment, flags, nullptr);
+        if (memory && cudaStreamSynchronize(nullptr) != cudaSuccess) {
+            cudaFreeAsync(memory, nullptr);
+            return nullptr;
+        }
+        return memory;
+    }
+
+#if NV_TENSORRT_MAJOR < 10
+    void free(void* memory) noexcept override {
+        deallocate(memory);
+    }
+#endif
+
+    bool deallocate(void* memory) noexcept override {
+        return deallocateAsync(memory, nullptr);
+    }
+
+    void* allocateAsync(
+        uint64_t size, uint64_t alignment, nvinfer1::AllocatorFlags, cudaStream_t stream) noexcept override {
+        // pool allocations are 256-byte aligned
+        if (alignment == 0 || (alignment & (alignment - 1)) != 0 || alignment > 256) {
+            return nullptr;
+        }
+        void* memory = nullptr;
+        if (cudaMallocFromPoolAsync(&memory, size, pool_, stream) != cudaSuccess) {
+            return nullptr;
+        }
+        return memory;
+    }
+
+    bool deallocateAsync(void* memory, cudaStream_t stream) noexcept override {
+        return cudaFreeAsync(memory, stream) == cudaSuccess;
+    }
+private:
+    cudaMemPool_t pool_;
+};
+
+} // namespace
+
+std::unique_ptr<GpuAllocator> create_rust_gpu_allocator(rust::Box<RustGpuAllocator> allocator) noexcept {
+    return std::make_unique<GpuAllocator>(
+        std::make_shared<RustGpuAllocatorAdapter>(std::move(allocator)));
+}
+
+std::unique_ptr<GpuAllocator> create_mem_pool_allocator(int32_t device, uint64_t release_threshold) noexcept {
+    cudaMemPoolProps props = {};
+    props.allocType = cudaMemAllocationTypePinned;
+    props.handleTypes = cudaMemHandleTypeNone;
+    props.location.type = cudaMemLocationTypeDevice;
+    props.location.id = device;
+
+    cudaMemPool_t pool = nullptr;
+    if (cudaMemPoolCreate(&pool, &props) != cudaSuccess) {
+        return nullptr;
+    }
+    if (cudaMemPoolSetAttribute(pool, cudaMemPoolAttrReleaseThreshold, &release_threshold) != cudaSuccess) {
+        cudaMemPoolDestroy(pool);
+        return nullptr;
+    }
+    return std::make_unique<GpuAllocator>(std::make_shared<MemPoolAllocator>(pool));
+}
+
+} // namespace trt_rs::allocator
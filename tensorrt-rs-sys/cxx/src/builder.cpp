@@ -0,0 +1,260 @@
+#include "builder.h"
+#include <string>
+#include "tensorrt-rs-sys/src/lib.rs.h"
+
+namespace trt_rs::builder {
+
+namespace {
+
+nvinfer1::Dims from_tensor_dims(const TensorDims& tensor_dims) noexcept {
+    nvinfer1::Dims dims;
+    if (tensor_dims.nb_dims < 0 || tensor_dims.nb_dims > nvinfer1::Dims::MAX_DIMS) {
+        dims.nbDims = -1;
+        return dims;
+    }
+    dims.nbDims = tensor_dims.nb_dims;
+    for (int32_t i = 0; i < tensor_dims.nb_dims; ++i) {
+        dims.d[i] = tensor_dims.d[i];
+    }
+    return dims;
+}
+
+// BuilderFlag in builder.rs numbers the flags itself: TensorRT 10 removed kSTRICT_TYPES and
+// shifted every later flag down by one, so they are mapped by name. False for flags this
+// TensorRT does not have.
+bool to_builder_flag(int32_t flag, nvinfer1::BuilderFlag& builder_flag) noexcept {
+    using nvinfer1::BuilderFlag;
+    switch (flag) {
+        case 0: builder_flag = BuilderFlag::kFP16; return true;
+        case 1: builder_flag = BuilderFlag::kINT8; return true;
+        case 2: builder_flag = BuilderFlag::kDEBUG; return true;
+        case 3: builder_flag = BuilderFlag::kGPU_FALLBACK; return true;
+        case 5: builder_flag = BuilderFlag::kREFIT; return true;
+        case 6: builder_flag = BuilderFlag::kDISABLE_TIMING_CACHE; return true;
+        case 7: builder_flag = BuilderFlag::kTF32; return true;
+        case 8: builder_flag = BuilderFlag::kSPARSE_WEIGHTS; return true;
+        case 10: builder_flag = BuilderFlag::kOBEY_PRECISION_CONSTRAINTS; return true;
+        case 11: builder_flag = BuilderFlag::kPREFER_PRECISION_CONSTRAINTS; return true;
+        case 12: builder_flag = BuilderFlag::kDIRECT_IO; return true;
+#if NV_TENSORRT_MAJOR > 8 || (NV_TENSORRT_MAJOR == 8 && NV_TENSORRT_MINOR >= 6)
+        case 14: builder_flag = BuilderFlag::kVERSION_COMPATIBLE; return true;
+        case 15: builder_flag = BuilderFlag::kEXCLUDE_LEAN_RUNTIME; return true;
+        case 16: builder_flag = BuilderFlag::kFP8; return true;
+#endif
+#if NV_TENSORRT_MAJOR >= 10
+        case 17: builder_flag = BuilderFlag::kERROR_ON_TIMING_CACHE_MISS; return true;
+        case 20: builder_flag = BuilderFlag::kSTRIP_PLAN; return true;
+        case 21: builder_flag = BuilderFlag::kREFIT_IDENTICAL; return true;
+        case 22: builder_flag = BuilderFlag::kWEIGHT_STREAMING; return true;
+#endif
+        default: return false;
+    }
+}
+
+class RustEntropyCalibrator : public nvinfer1::IInt8EntropyCalibrator2 {
+public:
+    explicit RustEntropyCalibrator(rust::Box<RustCalibrator> calibrator) : calibrator_(std::move(calibrator)) {}
+
+    int32_t getBatchSize() const noexcept override {
+        return calibrator_->batch_size();
+    }
+
+    bool getBatch(void* bindings[], char const* names[], int32_t nbBindings) noexcept override {
+        if (!calibrator_->next_batch()) {
+            return false;
+        }
+        for (int32_t i = 0; i < nbBindings; ++i) {
+            const auto binding = calibrator_->get_binding(names[i]);
+            if (binding == 0) {
+                return false;
+            }
+            bindings[i] = reinterpret_cast<void*>(binding);
+        }
+        return true;
+    }
+
+    void const* readCalibrationCache(std::size_t& length) noexcept override {
+        cache_ = calibrator_->read_cache();
+        length = cache_.size();
+        return cache_.empty() ? nullptr : cache_.data();
+    }
+
+    void writeCalibrationCache(void const* ptr, std::size_t length) noexcept override {
+        calibrator_->write_cache(rust::Slice<const std::uint8_t>(static_cast<const std::uint8_t*>(ptr), length));
+    }
+private:
+    rust::Box<RustCalibrator> calibrator_;
+    // returned by readCalibrationCache, which must stay valid until the next call
+    rust::Vec<std::uint8_t> cache_;
+};
+
+rust::String tensor_name(const nvinfer1::ITensor* tensor) noexcept {
+    return tensor && tensor->getName() ? rust::String(tensor->getName()) : rust::String();
+}
+
+} // namespace
+
+std::unique_ptr<Int8Calibrator> create_int8_calibrator(rust::Box<RustCalibrator> calibrator) noexcept {
+    return std::make_unique<Int8Calibrator>(std::make_unique<RustEntropyCalibrator>(std::move(calibrator)));
+}
+
+std::unique_ptr<HostMemory> TimingCache::serialize() const noexcept {
+    auto memory = cache_->serialize();
+    if (!memory) {
+        return nullptr;
+    }
+    return std::make_unique<HostMemory>(std::unique_ptr<nvinfer1::IHostMemory>(memory));
+}
+
+bool OptimizationProfile::set_dimensions(rust::Str input, int32_t select, const TensorDims& dims) noexcept {
+    const auto name = std::string(input);
+    return profile_->setDimensions(
+        name.c_str(), static_cast<nvinfer1::OptProfileSelector>(select), from_tensor_dims(dims));
+}
+
+bool OptimizationProfile::set_shape_values(
+    rust::Str input, int32_t select, rust::Slice<const int32_t> values) noexcept {
+    const auto name = std::string(input);
+    return profile_->setShapeValues(
+        name.c_str(), static_cast<nvinfer1::OptProfileSelector>(select), values.data(),
+        static_cast<int32_t>(values.size()));
+}
+
+bool BuilderConfig::set_flag(int32_t flag, bool enabled) noexcept {
+    nvinfer1::BuilderFlag builder_flag;
+    if (!to_builder_flag(flag, builder_flag)) {
+        return !enabled;
+    }
+    if (enabled) {
+        config_->setFlag(builder_flag);
+    } else {
+        config_->clearFlag(builder_flag);
+    }
+    return true;
+}
+
+bool BuilderConfig::get_flag(int32_t flag) const noexcept {
+    nvinfer1::BuilderFlag builder_flag;
+    return to_builder_flag(flag, builder_flag) && config_->getFlag(builder_flag);
+}
+
+std::unique_ptr<TimingCache> BuilderConfig::create_timing_cache(
+    rust::Slice<const std::uint8_t> blob) const noexcept {
+    // an empty blob creates an empty cache
+    auto cache = config_->createTimingCache(blob.empty() ? nullptr : blob.data(), blob.size());
+    if (!cache) {
+        return nullptr;
+    }
+    return std::make_unique<TimingCache>(std::shared_ptr<nvinfer1::ITimingCache>(cache));
+}
+
+bool BuilderConfig::set_timing_cache(const TimingCache& cache, bool ignore_mismatch) noexcept {
+    if (!config_->setTimingCache(*cache.get(), ignore_mismatch)) {
+        return false;
+    }
+    timing_cache_ = cache.get();
+    return true;
+}
+
+bool NetworkDefinition::parse_from_file(rust::Str path, int32_t verbosity) noexcept {
+    const auto file = std::string(path);
+    return parser_->parseFromFile(file.c_str(), verbosity);
+}
+
+rust::Vec<rust::String> NetworkDefinition::get_parser_errors() const noexcept {
+    auto errors = rust::Vec<rust::String>();
+    const auto count = parser_->getNbErrors();
+    errors.reserve(count);
+    for (int32_t i = 0; i < count; ++i) {
+        const auto error = parser_->getError(i);
+        auto message = std::string("node ") + std::to_string(error->node()) + ": " + error->desc();
+        errors.push_back(rust::String(message));
+    }
+    return errors;
+}
+
+rust::String NetworkDefinition::get_input_name(int32_t index) const noexcept {
+    return tensor_name(network_->getInput(index));
+}
+
+rust::String NetworkDefinition::get_output_name(int32_t index) const noexcept {
+    return tensor_name(network_->getOutput(index));
+}
+
+TensorDims NetworkDefinition::get_input_dims(int32_t index) const noexcept {
+    auto tensor_dims = TensorDims();
+    const auto input = network_->getInput(index);
+    if (!input) {
+        tensor_dims.nb_dims = -1;
+        return tensor_dims;
+    }
+    const auto dims = input->getDimensions();
+    tensor_dims.nb_dims = dims.nbDims;
+    for (int32_t i = 0; i < dims.nbDims && i < static_cast<int32_t>(tensor_dims.d.size()); ++i) {
+        tensor_dims.d[i] = dims.d[i];
+    }
+    return tensor_dims;
+}
+
+std::unique_ptr<NetworkDefinition> Builder::create_onnx_network() const noexcept {
+#if NV_TENSORRT_MAJOR >= 10
+    // networks are always explicit-batch
+    const auto flags = 0U;
+#else
+    const auto flags = 1U << static_cast<uint32_t>(nvinfer1::NetworkDefinitionCreationFlag::kEXPLICIT_BATCH);
+#endif
+    auto network = std::unique_ptr<nvinfer1::INetworkDefinition>(builder_->createNetworkV2(flags));
+    if (!network) {
+        return nullptr;
+    }
+#ifdef TRT_RS_BUILDER
+    auto parser = std::unique_ptr<nvonnxparser::IParser>(nvonnxparser::createParser(*network, logger_));
+    if (!parser) {
+        return nullptr;
+    }
+    return std::make_unique<NetworkDefinition>(std::move(network), std::move(parser));
+#else
+    // not reached: no builder is created without the feature
+    return nullptr;
+#endif
+}
+
+std::unique_ptr<BuilderConfig> Builder::create_builder_config() const noexcept {
+    auto config = builder_->createBuilderConfig();
+    if (!config) {
+        return nullptr;
+    }
+    return std::make_unique<BuilderConfig>(std::unique_ptr<nvinfer1::IBuilderConfig>(config));
+}
+
+std::unique_ptr<OptimizationProfile> Builder::create_optimization_profile() const noexcept {
+    auto profile = builder_->createOptimizationProfile();
+    if (!profile) {
+        return nullptr;
+    }
+    return std::make_unique<OptimizationProfile>(profile);
+}
+
+std::unique_ptr<HostMemory> Builder::build_serialized_network(
+    NetworkDefinition& network, BuilderConfig& config) const noexcept {
+    auto plan = builder_->buildSerializedNetwork(network.get(), config.get());
+    if (!plan) {
+        return nullptr;
+    }
+    return std::make_unique<HostMemory>(std::unique_ptr<nvinfer1::IHostMemory>(plan));
+}
+
+std::unique_ptr<Builder> create_builder(Logger& logger) noexcept {
+#ifdef TRT_RS_BUILDER
+    auto builder = nvinfer1::createInferBuilder(logger);
+    if (!builder) {
+        return nullptr;
+    }
+    return std::make_unique<Builder>(std::unique_ptr<nvinfer1::IBuilder>(builder), logger);
+#else
+    (void)logger;
+    return nullptr;
+#endif
+}
+
+} // namespace trt_rs::builder
@@ -0,0 +1,24 @@
+#include "cuda_stream.h"
+#include "tensorrt-rs-sys/src/lib.rs.h"
+
+namespace trt_rs::stream {
+
+namespace {
+
+void CUDART_CB host_func_trampoline(void* user_data) {
+    run_host_callback(rust::Box<HostCallback>::from_raw(static_cast<HostCallback*>(user_data)));
+}
+
+} // namespace
+
+bool launch_host_func(std::size_t stream, rust::Box<HostCallback> callback) noexcept {
+    auto raw = callback.into_raw();
+    if (cudaLaunchHostFunc(reinterpret_cast<cudaStream_t>(stream), host_func_trampoline, raw) != cudaSuccess) {
+        // never scheduled, so ownership comes back here
+        rust::Box<HostCallback>::from_raw(raw);
+        return false;
+    }
+    return true;
+}
+
+} // namespace trt_rs::stream
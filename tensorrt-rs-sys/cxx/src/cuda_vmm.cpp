@@ -0,0 +1,85 @@
+#include "cuda_vmm.h"
+
+namespace trt_rs::vmm {
+
+namespace {
+
+CUmemAllocationProp allocation_prop(CUdevice device) {
+    CUmemAllocationProp prop = {};
+    prop.type = CU_MEM_ALLOCATION_TYPE_PINNED;
+    prop.location.type = CU_MEM_LOCATION_TYPE_DEVICE;
+    prop.location.id = device;
+    return prop;
+}
+
+std::size_t round_up(std::size_t value, std::size_t multiple) {
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+} // namespace
+
+VirtualMemory::~VirtualMemory() {
+    if (mapped_ > 0) {
+        cuMemUnmap(base_, mapped_);
+    }
+    for (const auto& chunk : chunks_) {
+        cuMemRelease(chunk.handle);
+    }
+    cuMemAddressFree(base_, reserved_);
+}
+
+bool VirtualMemory::grow(std::size_t size) noexcept {
+    if (size <= mapped_) {
+        return true;
+    }
+    const std::size_t target = round_up(size, granularity_);
+    if (target > reserved_) {
+        return false;
+    }
+    const std::size_t chunk_size = target - mapped_;
+    const auto prop = allocation_prop(device_);
+    CUmemGenericAllocationHandle handle = 0;
+    if (cuMemCreate(&handle, chunk_size, &prop, 0) != CUDA_SUCCESS) {
+        return false;
+    }
+    if (cuMemMap(base_ + mapped_, chunk_size, 0, handle, 0) != CUDA_SUCCESS) {
+        cuMemRelease(handle);
+        return false;
+    }
+    CUmemAccessDesc access = {};
+    access.location = prop.location;
+    access.flags = CU_MEM_ACCESS_FLAGS_PROT_READWRITE;
+    if (cuMemSetAccess(base_ + mapped_, chunk_size, &access, 1) != CUDA_SUCCESS) {
+        cuMemUnmap(base_ + mapped_, chunk_size);
+        cuMemRelease(handle);
+        return false;
+    }
+    chunks_.push_back({handle, mapped_, chunk_size});
+    mapped_ = target;
+    return true;
+}
+
+std::unique_ptr<VirtualMemory> create_virtual_memory(std::size_t reserve, int32_t device) noexcept {
+    CUdevice cu_device = 0;
+    int supported = 0;
+    if (cuDeviceGet(&cu_device, device) != CUDA_SUCCESS
+        || cuDeviceGetAttribute(&supported, CU_DEVICE_ATTRIBUTE_VIRTUAL_MEMORY_MANAGEMENT_SUPPORTED, cu_device)
+            != CUDA_SUCCESS
+        || !supported) {
+        return nullptr;
+    }
+    const auto prop = allocation_prop(cu_device);
+    std::size_t granularity = 0;
+    if (cuMemGetAllocationGranularity(&granularity, &prop, CU_MEM_ALLOC_GRANULARITY_MINIMUM) != CUDA_SUCCESS
+        || granularity == 0) {
+        return nullptr;
+    }
+    const std::size_t reserved = round_up(reserve > 0 ? reserve : 1, granularity);
+    CUdeviceptr base = 0;
+    if (cuMemAddressReserve(&base, reserved, granularity, 0, 0) != CUDA_SUCCESS) {
+        return nullptr;
+    }
+    return std::make_unique<VirtualMemory>(base, reserved, granularity, cu_device);
+}
+
+} // namespace trt_rs::vmm
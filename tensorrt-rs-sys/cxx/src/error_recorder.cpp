@@ -0,0 +1,92 @@
+#include <cstring>
+#include "error_recorder.h"
+#include "tensorrt-rs-sys/src/lib.rs.h"
+
+namespace trt_rs::error_recorder {
+
+uint64_t ErrorTable::first() const noexcept {
+    const auto head = head_.load(std::memory_order_acquire);
+    const auto tail = tail_.load(std::memory_order_acquire);
+    return head - tail > capacity_ ? head - capacity_ : tail;
+}
+
+bool ErrorTable::read(uint64_t ticket, int32_t& code, std::string* desc) const noexcept {
+    const auto& slot = slots_[ticket % capacity_];
+    const auto complete = 2 * ticket + 2;
+    if (slot.sequence.load(std::memory_order_acquire) != complete) {
+        return false;
+    }
+    code = slot.code.load(std::memory_order_relaxed);
+    if (desc != nullptr) {
+        desc->assign(slot.desc, strnlen(slot.desc, kMAX_DESC_LENGTH));
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == complete;
+}
+
+int32_t ErrorTable::getNbErrors() const noexcept {
+    const auto head = head_.load(std::memory_order_acquire);
+    return static_cast<int32_t>(head - first());
+}
+
+nvinfer1::ErrorCode ErrorTable::getErrorCode(int32_t errorIdx) const noexcept {
+    int32_t code = static_cast<int32_t>(nvinfer1::ErrorCode::kINVALID_ARGUMENT);
+    if (errorIdx >= 0 && errorIdx < getNbErrors()) {
+        read(first() + errorIdx, code, nullptr);
+    }
+    return static_cast<nvinfer1::ErrorCode>(code);
+}
+
+// Points into the ring: valid until `capacity` more errors are reported.
+ErrorTable::ErrorDesc ErrorTable::getErrorDesc(int32_t errorIdx) const noexcept {
+    if (errorIdx < 0 || errorIdx >= getNbErrors()) {
+        return "";
+    }
+    return slots_[(first() + errorIdx) % capacity_].desc;
+}
+
+bool ErrorTable::hasOverflowed() const noexcept {
+    return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire) > capacity_;
+}
+
+void ErrorTable::clear() noexcept {
+    tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release);
+}
+
+// Returning false lets TensorRT carry on; the caller sees the failure through its API
+// call and reads the details from here.
+bool ErrorTable::reportError(nvinfer1::ErrorCode val, ErrorDesc desc) noexcept {
+    const auto ticket = head_.fetch_add(1, std::memory_order_acq_rel);
+    auto& slot = slots_[ticket % capacity_];
+    slot.sequence.store(2 * ticket + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.code.store(static_cast<int32_t>(val), std::memory_order_relaxed);
+    const auto length = desc ? strnlen(desc, kMAX_DESC_LENGTH) : 0;
+    std::memcpy(slot.desc, desc ? desc : "", length);
+    slot.desc[length] = '\0';
+    slot.sequence.store(2 * ticket + 2, std::memory_order_release);
+    return false;
+}
+
+rust::Vec<RecordedError> ErrorTable::take() noexcept {
+    auto taken = rust::Vec<RecordedError>();
+    const auto head = head_.load(std::memory_order_acquire);
+    auto desc = std::string();
+    for (auto ticket = first(); ticket < head; ++ticket) {
+        int32_t code = 0;
+        // entries still being written, or already overwritten, are skipped
+        if (read(ticket, code, &desc)) {
+            taken.push_back(RecordedError{code, rust::String(desc)});
+        }
+    }
+    // entries reported meanwhile are kept for the next take
+    auto tail = tail_.load(std::memory_order_acquire);
+    while (tail < head && !tail_.compare_exchange_weak(tail, head, std::memory_order_acq_rel)) {}
+    return taken;
+}
+
+std::unique_ptr<ErrorRecorder> create_error_recorder(std::size_t capacity) noexcept {
+    return std::make_unique<ErrorRecorder>(capacity);
+}
+
+} // namespace trt_rs::error_recorder
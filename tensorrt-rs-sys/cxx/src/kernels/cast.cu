@@ -0,0 +1,189 @@
+#include "kernels.h"
+
+#include <cmath>
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+#if CUDART_VERSION >= 11080
+#include <cuda_fp8.h>
+#endif
+
+namespace trt_rs::kernels {
+
+namespace {
+
+constexpr int kThreads = 256;
+// consecutive elements per thread
+constexpr int kItems = 4;
+
+// nvinfer1::DataType
+enum DType : int32_t {
+    kFLOAT = 0,
+    kHALF = 1,
+    kINT8 = 2,
+    kINT32 = 3,
+    kBOOL = 4,
+    kUINT8 = 5,
+    kFP8 = 6,
+};
+
+__device__ __forceinline__ float load(const void* src, int32_t dtype, int64_t i, float scale) {
+    switch (dtype) {
+        case kFLOAT:
+            return static_cast<const float*>(src)[i];
+        case kHALF:
+            return __half2float(static_cast<const __half*>(src)[i]);
+        case kINT8:
+            return static_cast<const int8_t*>(src)[i] * scale;
+        case kINT32:
+            return static_cast<float>(static_cast<const int32_t*>(src)[i]);
+        case kBOOL:
+            return static_cast<const uint8_t*>(src)[i] ? 1.0f : 0.0f;
+        case kUINT8:
+            return static_cast<const uint8_t*>(src)[i] * scale;
+#if CUDART_VERSION >= 11080
+        case kFP8:
+            return static_cast<float>(static_cast<const __nv_fp8_e4m3*>(src)[i]) * scale;
+#endif
+        default:
+            return 0.0f;
+    }
+}
+
+__device__ __forceinline__ void store(void* dst, int32_t dtype, int64_t i, float value, float inv_scale) {
+    switch (dtype) {
+        case kFLOAT:
+            static_cast<float*>(dst)[i] = value;
+            break;
+        case kHALF:
+            static_cast<__half*>(dst)[i] = __float2half_rn(value);
+            break;
+        case kINT8:
+            static_cast<int8_t*>(dst)[i] = static_cast<int8_t>(fminf(fmaxf(rintf(value * inv_scale), -128.0f), 127.0f));
+            break;
+        case kINT32:
+            static_cast<int32_t*>(dst)[i] = static_cast<int32_t>(rintf(value));
+            break;
+        case kBOOL:
+            static_cast<uint8_t*>(dst)[i] = value != 0.0f;
+            break;
+        case kUINT8:
+            static_cast<uint8_t*>(dst)[i] = static_cast<uint8_t>(fminf(fmaxf(rintf(value * inv_scale), 0.0f), 255.0f));
+            break;
+#if CUDART_VERSION >= 11080
+        case kFP8:
+            // the constructor saturates to the finite e4m3 range
+            static_cast<__nv_fp8_e4m3*>(dst)[i] = __nv_fp8_e4m3(value * inv_scale);
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+// The dtype switches are uniform across the grid, so they do not diverge.
+__global__ void cast_kernel(
+    const void* __restrict__ src, int32_t src_dtype, void* __restrict__ dst, int32_t dst_dtype,
+    int64_t count, float scale, float inv_scale) {
+    const int64_t base = (static_cast<int64_t>(blockIdx.x) * blockDim.x + threadIdx.x) * kItems;
+#pragma unroll
+    for (int k = 0; k < kItems; ++k) {
+        const int64_t i = base + k;
+        if (i < count) {
+            store(dst, dst_dtype, i, load(src, src_dtype, i, scale), inv_scale);
+        }
+    }
+}
+
+__global__ void fill_kernel(void* __restrict__ dst, int32_t dtype, int64_t count, float value) {
+    const int64_t base = (static_cast<int64_t>(blockIdx.x) * blockDim.x + threadIdx.x) * kItems;
+#pragma unroll
+    for (int k = 0; k < kItems; ++k) {
+        const int64_t i = base + k;
+        if (i < count) {
+            store(dst, dtype, i, value, 1.0f);
+        }
+    }
+}
+
+// splitmix64 of the element index, so the values depend on the seed and index only.
+__device__ __forceinline__ uint64_t mix(uint64_t seed, int64_t i) {
+    uint64_t z = seed + (static_cast<uint64_t>(i) + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+__global__ void random_kernel(
+    void* __restrict__ dst, int32_t dtype, int64_t count, float low, float range, bool integral, uint64_t seed) {
+    const int64_t base = (static_cast<int64_t>(blockIdx.x) * blockDim.x + threadIdx.x) * kItems;
+#pragma unroll
+    for (int k = 0; k < kItems; ++k) {
+        const int64_t i = base + k;
+        if (i < count) {
+            // 24 bits, exact in a float
+            const float u = static_cast<float>(mix(seed, i) >> 40) * (1.0f / 16777216.0f);
+            const float value = low + u * range;
+            store(dst, dtype, i, integral ? fminf(floorf(value), low + range - 1.0f) : value, 1.0f);
+        }
+    }
+}
+
+unsigned int blocks_for(int64_t count) {
+    const int64_t threads = (count + kItems - 1) / kItems;
+    return static_cast<unsigned int>((threads + kThreads - 1) / kThreads);
+}
+
+bool supported(int32_t dtype) {
+#if CUDART_VERSION >= 11080
+    return dtype >= kFLOAT && dtype <= kFP8;
+#else
+    return dtype >= kFLOAT && dtype <= kUINT8;
+#endif
+}
+
+} // namespace
+
+bool cast_tensor(
+    std::size_t src, int32_t src_dtype, std::size_t dst, int32_t dst_dtype, int64_t count,
+    float scale, std::size_t stream) noexcept {
+    if (!supported(src_dtype) || !supported(dst_dtype) || count < 0 || scale == 0.0f) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+    cast_kernel<<<blocks_for(count), kThreads, 0, reinterpret_cast<cudaStream_t>(stream)>>>(
+        reinterpret_cast<const void*>(src), src_dtype, reinterpret_cast<void*>(dst), dst_dtype,
+        count, scale, 1.0f / scale);
+    return cudaGetLastError() == cudaSuccess;
+}
+
+bool fill_tensor(std::size_t dst, int32_t dtype, int64_t count, float value, std::size_t stream) noexcept {
+    if (!supported(dtype) || count < 0) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+    fill_kernel<<<blocks_for(count), kThreads, 0, reinterpret_cast<cudaStream_t>(stream)>>>(
+        reinterpret_cast<void*>(dst), dtype, count, value);
+    return cudaGetLastError() == cudaSuccess;
+}
+
+bool random_tensor(
+    std::size_t dst, int32_t dtype, int64_t count, float low, float high, uint64_t seed,
+    std::size_t stream) noexcept {
+    if (!supported(dtype) || count < 0 || !(low < high)) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+    const bool integral = dtype == kINT8 || dtype == kINT32 || dtype == kBOOL || dtype == kUINT8;
+    random_kernel<<<blocks_for(count), kThreads, 0, reinterpret_cast<cudaStream_t>(stream)>>>(
+        reinterpret_cast<void*>(dst), dtype, count, integral ? floorf(low) : low,
+        integral ? ceilf(high) - floorf(low) : high - low, integral, seed);
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace trt_rs::kernels
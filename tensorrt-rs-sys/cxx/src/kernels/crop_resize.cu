@@ -0,0 +1,90 @@
+#include "kernels.h"
+
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+
+namespace trt_rs::kernels {
+
+namespace {
+
+__device__ __forceinline__ float load(const float* src, std::size_t i) {
+    return src[i];
+}
+
+__device__ __forceinline__ float load(const __half* src, std::size_t i) {
+    return __half2float(src[i]);
+}
+
+__device__ __forceinline__ void store(float* dst, std::size_t i, float value) {
+    dst[i] = value;
+}
+
+__device__ __forceinline__ void store(__half* dst, std::size_t i, float value) {
+    dst[i] = __float2half_rn(value);
+}
+
+// grid.z indexes the crop; one thread per output pixel handles all channels.
+template <typename T>
+__global__ void crop_resize_kernel(
+    const T* __restrict__ src, int channels, int src_height, int src_width,
+    const float4* __restrict__ rects, T* __restrict__ dst, int dst_height, int dst_width) {
+    const int x = blockIdx.x * blockDim.x + threadIdx.x;
+    const int y = blockIdx.y * blockDim.y + threadIdx.y;
+    const int n = blockIdx.z;
+    if (x >= dst_width || y >= dst_height) {
+        return;
+    }
+
+    const float4 rect = rects[n];
+    const float scale_x = (rect.z - rect.x) / dst_width;
+    const float scale_y = (rect.w - rect.y) / dst_height;
+    const float sx = fminf(fmaxf(rect.x + (x + 0.5f) * scale_x - 0.5f, 0.0f), src_width - 1.0f);
+    const float sy = fminf(fmaxf(rect.y + (y + 0.5f) * scale_y - 0.5f, 0.0f), src_height - 1.0f);
+    const int x0 = static_cast<int>(sx);
+    const int y0 = static_cast<int>(sy);
+    const int x1 = min(x0 + 1, src_width - 1);
+    const int y1 = min(y0 + 1, src_height - 1);
+    const float ax = sx - x0;
+    const float ay = sy - y0;
+
+    const std::size_t src_plane = static_cast<std::size_t>(src_height) * src_width;
+    const std::size_t dst_plane = static_cast<std::size_t>(dst_height) * dst_width;
+    const std::size_t out = n * channels * dst_plane + static_cast<std::size_t>(y) * dst_width + x;
+    for (int c = 0; c < channels; ++c) {
+        const T* plane = src + c * src_plane;
+        const float top = load(plane, y0 * src_width + x0) * (1.0f - ax) + load(plane, y0 * src_width + x1) * ax;
+        const float bottom = load(plane, y1 * src_width + x0) * (1.0f - ax) + load(plane, y1 * src_width + x1) * ax;
+        store(dst, out + c * dst_plane, top * (1.0f - ay) + bottom * ay);
+    }
+}
+
+} // namespace
+
+bool crop_resize(
+    std::size_t src, int32_t channels, int32_t src_height, int32_t src_width, bool half,
+    std::size_t rects, int32_t count, std::size_t dst, int32_t dst_height, int32_t dst_width,
+    std::size_t stream) noexcept {
+    if (channels <= 0 || src_height <= 0 || src_width <= 0 || dst_height <= 0 || dst_width <= 0 || count < 0) {
+        return false;
+    }
+    if (count == 0) {
+        return true;
+    }
+
+    const dim3 block(32, 8);
+    const dim3 grid((dst_width + block.x - 1) / block.x, (dst_height + block.y - 1) / block.y, count);
+    auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    auto boxes = reinterpret_cast<const float4*>(rects);
+    if (half) {
+        crop_resize_kernel<__half><<<grid, block, 0, cuda_stream>>>(
+            reinterpret_cast<const __half*>(src), channels, src_height, src_width, boxes,
+            reinterpret_cast<__half*>(dst), dst_height, dst_width);
+    } else {
+        crop_resize_kernel<float><<<grid, block, 0, cuda_stream>>>(
+            reinterpret_cast<const float*>(src), channels, src_height, src_width, boxes,
+            reinterpret_cast<float*>(dst), dst_height, dst_width);
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace trt_rs::kernels
@@ -0,0 +1,171 @@
+#include "kernels.h"
+
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+
+namespace trt_rs::kernels {
+
+namespace {
+
+constexpr int kThreads = 256;
+
+__device__ __forceinline__ float load_prob(const float* prob, int i) {
+    return prob[i];
+}
+
+__device__ __forceinline__ float load_prob(const __half* prob, int i) {
+    return __half2float(prob[i]);
+}
+
+__device__ int find_root(const int* labels, int x) {
+    int parent = labels[x];
+    while (parent != x) {
+        x = parent;
+        parent = labels[x];
+    }
+    return x;
+}
+
+// Union by atomicMin, as in Playne and Hawick's block-free union-find labelling: retries
+// until the larger root has been attached to the smaller one.
+__device__ void unite(int* labels, int a, int b) {
+    bool done = false;
+    while (!done) {
+        a = find_root(labels, a);
+        b = find_root(labels, b);
+        if (a < b) {
+            const int old = atomicMin(&labels[b], a);
+            done = old == b;
+            b = old;
+        } else if (b < a) {
+            const int old = atomicMin(&labels[a], b);
+            done = old == a;
+            a = old;
+        } else {
+            done = true;
+        }
+    }
+}
+
+template <typename T>
+__global__ void init_labels(const T* __restrict__ prob, int size, float thresh, int* labels) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < size) {
+        labels[i] = load_prob(prob, i) > thresh ? i : -1;
+    }
+}
+
+__global__ void merge_labels(int* labels, int width, int height) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= width * height || labels[i] < 0) {
+        return;
+    }
+    const int x = i % width;
+    const int y = i / width;
+    // left and the three upper neighbours cover all 8-connected pairs once
+    if (x > 0 && labels[i - 1] >= 0) {
+        unite(labels, i, i - 1);
+    }
+    if (y > 0) {
+        const int up = i - width;
+        if (labels[up] >= 0) {
+            unite(labels, i, up);
+        }
+        if (x > 0 && labels[up - 1] >= 0) {
+            unite(labels, i, up - 1);
+        }
+        if (x + 1 < width && labels[up + 1] >= 0) {
+            unite(labels, i, up + 1);
+        }
+    }
+}
+
+__global__ void compress_labels(int* labels, int size) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i < size && labels[i] >= 0) {
+        labels[i] = find_root(labels, i);
+    }
+}
+
+__global__ void number_roots(
+    const int* labels, int width, int height, int* roots, DbBoxStats* boxes, int max_boxes, int* count) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= width * height || labels[i] != i) {
+        return;
+    }
+    const int id = atomicAdd(count, 1);
+    if (id < max_boxes) {
+        const int x = i % width;
+        const int y = i / width;
+        boxes[id] = DbBoxStats{x, y, x, y, 0, 0.0f};
+        roots[i] = id;
+    } else {
+        roots[i] = -1;
+    }
+}
+
+template <typename T>
+__global__ void accumulate_boxes(
+    const T* __restrict__ prob, const int* labels, const int* roots, int width, int height,
+    DbBoxStats* boxes) {
+    const int i = blockIdx.x * blockDim.x + threadIdx.x;
+    if (i >= width * height || labels[i] < 0) {
+        return;
+    }
+    const int id = roots[labels[i]];
+    if (id < 0) {
+        return;
+    }
+    const int x = i % width;
+    const int y = i / width;
+    DbBoxStats* box = &boxes[id];
+    atomicMin(&box->min_x, x);
+    atomicMin(&box->min_y, y);
+    atomicMax(&box->max_x, x);
+    atomicMax(&box->max_y, y);
+    atomicAdd(&box->area, 1);
+    atomicAdd(&box->score_sum, load_prob(prob, i));
+}
+
+template <typename T>
+bool launch_db(
+    const T* prob, int width, int height, float thresh, int* labels, int* roots,
+    DbBoxStats* boxes, int max_boxes, int* count, cudaStream_t stream) {
+    const int size = width * height;
+    const int blocks = (size + kThreads - 1) / kThreads;
+    if (cudaMemsetAsync(count, 0, sizeof(int), stream) != cudaSuccess) {
+        return false;
+    }
+    init_labels<<<blocks, kThreads, 0, stream>>>(prob, size, thresh, labels);
+    merge_labels<<<blocks, kThreads, 0, stream>>>(labels, width, height);
+    compress_labels<<<blocks, kThreads, 0, stream>>>(labels, size);
+    number_roots<<<blocks, kThreads, 0, stream>>>(labels, width, height, roots, boxes, max_boxes, count);
+    accumulate_boxes<<<blocks, kThreads, 0, stream>>>(prob, labels, roots, width, height, boxes);
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace
+
+bool db_postprocess(
+    std::size_t prob, int32_t width, int32_t height, bool prob_half, float thresh,
+    std::size_t labels, std::size_t roots, std::size_t boxes, int32_t max_boxes,
+    std::size_t count, std::size_t stream) noexcept {
+    if (width <= 0 || height <= 0 || max_boxes < 0) {
+        return false;
+    }
+    auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    auto label_buf = reinterpret_cast<int*>(labels);
+    auto root_buf = reinterpret_cast<int*>(roots);
+    auto box_buf = reinterpret_cast<DbBoxStats*>(boxes);
+    auto count_buf = reinterpret_cast<int*>(count);
+    if (prob_half) {
+        return launch_db(
+            reinterpret_cast<const __half*>(prob), width, height, thresh, label_buf, root_buf,
+            box_buf, max_boxes, count_buf, cuda_stream);
+    }
+    return launch_db(
+        reinterpret_cast<const float*>(prob), width, height, thresh, label_buf, root_buf,
+        box_buf, max_boxes, count_buf, cuda_stream);
+}
+
+} // namespace trt_rs::kernels
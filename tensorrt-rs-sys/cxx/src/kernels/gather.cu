@@ -0,0 +1,75 @@
+#include "kernels.h"
+
+#include <algorithm>
+#include <cuda_runtime_api.h>
+
+namespace trt_rs::kernels {
+
+namespace {
+
+constexpr int kThreads = 256;
+// copies per launch: 128 x 24 bytes of the 4 KB of kernel parameters
+constexpr int kMaxCopies = 128;
+// bytes a block moves per pass
+constexpr uint64_t kBlockBytes = kThreads * 16;
+constexpr unsigned int kMaxBlocksPerCopy = 32;
+
+// Passed by value, so the descriptors need no upload of their own.
+struct Copies {
+    const uint8_t* src[kMaxCopies];
+    uint8_t* dst[kMaxCopies];
+    uint64_t size[kMaxCopies];
+};
+
+// blockIdx.y picks the copy; the blocks along x stride over it, 16 bytes per thread where
+// both ends and the size allow it.
+__global__ void batched_copy_kernel(const Copies copies) {
+    const int c = blockIdx.y;
+    const uint8_t* src = copies.src[c];
+    uint8_t* dst = copies.dst[c];
+    const uint64_t size = copies.size[c];
+    const uint64_t stride = static_cast<uint64_t>(gridDim.x) * blockDim.x;
+    const uint64_t first = static_cast<uint64_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+    const bool aligned = ((reinterpret_cast<uintptr_t>(src) | reinterpret_cast<uintptr_t>(dst) | size) & 15) == 0;
+    if (aligned) {
+        const uint4* src16 = reinterpret_cast<const uint4*>(src);
+        uint4* dst16 = reinterpret_cast<uint4*>(dst);
+        for (uint64_t i = first; i < size / 16; i += stride) {
+            dst16[i] = src16[i];
+        }
+    } else {
+        for (uint64_t i = first; i < size; i += stride) {
+            dst[i] = src[i];
+        }
+    }
+}
+
+} // namespace
+
+bool batched_copy(const std::size_t* copies, int32_t count, std::size_t stream) noexcept {
+    if (count < 0 || (count > 0 && copies == nullptr)) {
+        return false;
+    }
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    for (int32_t base = 0; base < count; base += kMaxCopies) {
+        Copies chunk;
+        const int32_t n = std::min(kMaxCopies, count - base);
+        uint64_t largest = 0;
+        for (int32_t i = 0; i < n; ++i) {
+            const std::size_t* copy = copies + 3 * static_cast<int64_t>(base + i);
+            chunk.src[i] = reinterpret_cast<const uint8_t*>(copy[0]);
+            chunk.dst[i] = reinterpret_cast<uint8_t*>(copy[1]);
+            chunk.size[i] = copy[2];
+            largest = std::max<uint64_t>(largest, copy[2]);
+        }
+        if (largest == 0) {
+            continue;
+        }
+        const auto blocks = static_cast<unsigned int>(
+            std::min<uint64_t>((largest + kBlockBytes - 1) / kBlockBytes, kMaxBlocksPerCopy));
+        batched_copy_kernel<<<dim3(blocks, n), kThreads, 0, cuda_stream>>>(chunk);
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace trt_rs::kernels
@@ -0,0 +1,169 @@
+#include "kernels.h"
+
+#include <cuda_runtime_api.h>
+
+namespace trt_rs::kernels {
+
+namespace {
+
+constexpr int kThreads = 256;
+
+struct Geometry {
+    int64_t outer;
+    int64_t channels;
+    int64_t inner;
+    int64_t components;
+    // channels rounded up to a multiple of components
+    int64_t padded;
+};
+
+// One thread per element of the vectorized (padded) tensor, which it maps back to its
+// linear position; padding lanes have no linear counterpart.
+template <typename T, bool ChannelLast, bool ToVectorized>
+__global__ void convert_layout_kernel(const T* __restrict__ src, T* __restrict__ dst, Geometry g, int64_t volume) {
+    const int64_t i = static_cast<int64_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i >= volume) {
+        return;
+    }
+
+    int64_t o, c, s;
+    if (ChannelLast) {
+        c = i % g.padded;
+        const int64_t j = i / g.padded;
+        s = j % g.inner;
+        o = j / g.inner;
+    } else {
+        const int64_t lane = i % g.components;
+        int64_t j = i / g.components;
+        s = j % g.inner;
+        j /= g.inner;
+        const int64_t blocks = g.padded / g.components;
+        c = (j % blocks) * g.components + lane;
+        o = j / blocks;
+    }
+
+    const bool valid = c < g.channels;
+    const int64_t linear = (o * g.channels + c) * g.inner + s;
+    if (ToVectorized) {
+        dst[i] = valid ? src[linear] : T(0);
+    } else if (valid) {
+        dst[linear] = src[i];
+    }
+}
+
+template <typename T>
+void launch_convert(
+    std::size_t src, std::size_t dst, const Geometry& g, bool channel_last, bool to_vectorized,
+    cudaStream_t stream) {
+    const int64_t volume = g.outer * g.padded * g.inner;
+    const unsigned int blocks = static_cast<unsigned int>((volume + kThreads - 1) / kThreads);
+    auto input = reinterpret_cast<const T*>(src);
+    auto output = reinterpret_cast<T*>(dst);
+    if (channel_last && to_vectorized) {
+        convert_layout_kernel<T, true, true><<<blocks, kThreads, 0, stream>>>(input, output, g, volume);
+    } else if (channel_last) {
+        convert_layout_kernel<T, true, false><<<blocks, kThreads, 0, stream>>>(input, output, g, volume);
+    } else if (to_vectorized) {
+        convert_layout_kernel<T, false, true><<<blocks, kThreads, 0, stream>>>(input, output, g, volume);
+    } else {
+        convert_layout_kernel<T, false, false><<<blocks, kThreads, 0, stream>>>(input, output, g, volume);
+    }
+}
+
+// One thread per element of the DLA image tensor [outer][height][padded_width][components].
+template <typename T, bool ToVectorized>
+__global__ void convert_dla_hwc4_kernel(
+    const T* __restrict__ src, T* __restrict__ dst, int64_t channels, int64_t height, int64_t width,
+    int64_t padded_width, int64_t components, int64_t volume) {
+    const int64_t i = static_cast<int64_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i >= volume) {
+        return;
+    }
+    const int64_t c = i % components;
+    int64_t j = i / components;
+    const int64_t w = j % padded_width;
+    j /= padded_width;
+    const int64_t h = j % height;
+    const int64_t o = j / height;
+
+    const bool valid = c < channels && w < width;
+    const int64_t linear = ((o * channels + c) * height + h) * width + w;
+    if (ToVectorized) {
+        dst[i] = valid ? src[linear] : T(0);
+    } else if (valid) {
+        dst[linear] = src[i];
+    }
+}
+
+template <typename T>
+void launch_dla_hwc4(
+    std::size_t src, std::size_t dst, int64_t outer, int64_t channels, int64_t height, int64_t width,
+    int64_t padded_width, int64_t components, bool to_vectorized, cudaStream_t stream) {
+    const int64_t volume = outer * height * padded_width * components;
+    const unsigned int blocks = static_cast<unsigned int>((volume + kThreads - 1) / kThreads);
+    auto input = reinterpret_cast<const T*>(src);
+    auto output = reinterpret_cast<T*>(dst);
+    if (to_vectorized) {
+        convert_dla_hwc4_kernel<T, true><<<blocks, kThreads, 0, stream>>>(
+            input, output, channels, height, width, padded_width, components, volume);
+    } else {
+        convert_dla_hwc4_kernel<T, false><<<blocks, kThreads, 0, stream>>>(
+            input, output, channels, height, width, padded_width, components, volume);
+    }
+}
+
+} // namespace
+
+bool convert_layout(
+    std::size_t src, std::size_t dst, int32_t elem_size, int64_t outer, int64_t channels,
+    int64_t inner, int32_t components, bool channel_last, bool to_vectorized,
+    std::size_t stream) noexcept {
+    if (outer <= 0 || channels <= 0 || inner <= 0 || components <= 0) {
+        return outer == 0 || inner == 0;
+    }
+    const int64_t padded = (channels + components - 1) / components * components;
+    const Geometry g{outer, channels, inner, components, padded};
+    auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    switch (elem_size) {
+        case 1:
+            launch_convert<uint8_t>(src, dst, g, channel_last, to_vectorized, cuda_stream);
+            break;
+        case 2:
+            launch_convert<uint16_t>(src, dst, g, channel_last, to_vectorized, cuda_stream);
+            break;
+        case 4:
+            launch_convert<uint32_t>(src, dst, g, channel_last, to_vectorized, cuda_stream);
+            break;
+        default:
+            return false;
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+bool convert_dla_hwc4(
+    std::size_t src, std::size_t dst, int32_t elem_size, int64_t outer, int64_t channels, int64_t height,
+    int64_t width, int64_t padded_width, bool to_vectorized, std::size_t stream) noexcept {
+    if (outer <= 0 || channels <= 0 || height <= 0 || width <= 0) {
+        return outer == 0 || height == 0 || width == 0;
+    }
+    if (channels > 4 || padded_width < width) {
+        return false;
+    }
+    const int64_t components = channels == 1 ? 1 : 4;
+    auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    switch (elem_size) {
+        case 1:
+            launch_dla_hwc4<uint8_t>(
+                src, dst, outer, channels, height, width, padded_width, components, to_vectorized, cuda_stream);
+            break;
+        case 2:
+            launch_dla_hwc4<uint16_t>(
+                src, dst, outer, channels, height, width, padded_width, components, to_vectorized, cuda_stream);
+            break;
+        default:
+            return false;
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace trt_rs::kernels
@@ -0,0 +1,102 @@
+#include "kernels.h"
+
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+
+namespace trt_rs::kernels {
+
+namespace {
+
+constexpr int kMaxChannels = 4;
+
+struct Affine {
+    float scale[kMaxChannels];
+    float bias[kMaxChannels];
+};
+
+template <typename T>
+__device__ __forceinline__ T cast_to(float value);
+
+template <>
+__device__ __forceinline__ float cast_to<float>(float value) {
+    return value;
+}
+
+template <>
+__device__ __forceinline__ __half cast_to<__half>(float value) {
+    return __float2half_rn(value);
+}
+
+// One thread per output pixel; all channels of a pixel come from the same four taps.
+template <typename T>
+__global__ void preprocess_kernel(
+    const uint8_t* __restrict__ src, int src_width, int src_height, int src_pitch, int channels,
+    T* __restrict__ dst, int dst_width, int dst_height, float scale_x, float scale_y,
+    bool swap_rb, Affine affine) {
+    const int x = blockIdx.x * blockDim.x + threadIdx.x;
+    const int y = blockIdx.y * blockDim.y + threadIdx.y;
+    if (x >= dst_width || y >= dst_height) {
+        return;
+    }
+
+    // half-pixel centers, matching cv::resize INTER_LINEAR
+    const float sx = fmaxf((x + 0.5f) * scale_x - 0.5f, 0.0f);
+    const float sy = fmaxf((y + 0.5f) * scale_y - 0.5f, 0.0f);
+    const int x0 = min(static_cast<int>(sx), src_width - 1);
+    const int y0 = min(static_cast<int>(sy), src_height - 1);
+    const int x1 = min(x0 + 1, src_width - 1);
+    const int y1 = min(y0 + 1, src_height - 1);
+    const float ax = sx - x0;
+    const float ay = sy - y0;
+
+    const uint8_t* row0 = src + static_cast<std::size_t>(y0) * src_pitch;
+    const uint8_t* row1 = src + static_cast<std::size_t>(y1) * src_pitch;
+    const std::size_t plane = static_cast<std::size_t>(dst_width) * dst_height;
+    T* out = dst + static_cast<std::size_t>(y) * dst_width + x;
+
+    for (int c = 0; c < channels; ++c) {
+        const int sc = (swap_rb && c < 3 && channels >= 3) ? 2 - c : c;
+        const float top = row0[x0 * channels + sc] * (1.0f - ax) + row0[x1 * channels + sc] * ax;
+        const float bottom = row1[x0 * channels + sc] * (1.0f - ax) + row1[x1 * channels + sc] * ax;
+        const float value = top * (1.0f - ay) + bottom * ay;
+        out[c * plane] = cast_to<T>(value * affine.scale[c] + affine.bias[c]);
+    }
+}
+
+} // namespace
+
+bool preprocess_image(
+    std::size_t src, int32_t src_width, int32_t src_height, int32_t src_pitch, int32_t channels,
+    std::size_t dst, int32_t dst_width, int32_t dst_height, bool dst_half, bool swap_rb,
+    const float* scale, const float* bias, std::size_t stream) noexcept {
+    if (channels < 1 || channels > kMaxChannels || src_width <= 0 || src_height <= 0 ||
+        dst_width <= 0 || dst_height <= 0) {
+        return false;
+    }
+
+    Affine affine = {};
+    for (int c = 0; c < channels; ++c) {
+        affine.scale[c] = scale[c];
+        affine.bias[c] = bias[c];
+    }
+
+    const dim3 block(32, 8);
+    const dim3 grid((dst_width + block.x - 1) / block.x, (dst_height + block.y - 1) / block.y);
+    const float scale_x = static_cast<float>(src_width) / dst_width;
+    const float scale_y = static_cast<float>(src_height) / dst_height;
+    auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    auto input = reinterpret_cast<const uint8_t*>(src);
+
+    if (dst_half) {
+        preprocess_kernel<__half><<<grid, block, 0, cuda_stream>>>(
+            input, src_width, src_height, src_pitch, channels, reinterpret_cast<__half*>(dst),
+            dst_width, dst_height, scale_x, scale_y, swap_rb, affine);
+    } else {
+        preprocess_kernel<float><<<grid, block, 0, cuda_stream>>>(
+            input, src_width, src_height, src_pitch, channels, reinterpret_cast<float*>(dst),
+            dst_width, dst_height, scale_x, scale_y, swap_rb, affine);
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace trt_rs::kernels
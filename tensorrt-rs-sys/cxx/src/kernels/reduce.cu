@@ -0,0 +1,361 @@
+#include "kernels.h"
+
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+
+namespace trt_rs::kernels {
+
+namespace {
+
+// one block per row
+constexpr int kThreads = 256;
+constexpr int kWarps = kThreads / 32;
+
+__device__ __forceinline__ float load(const float* src, int64_t i) {
+    return src[i];
+}
+
+__device__ __forceinline__ float load(const __half* src, int64_t i) {
+    return __half2float(src[i]);
+}
+
+struct Sum {
+    __device__ float operator()(float a, float b) const { return a + b; }
+};
+
+struct Max {
+    __device__ float operator()(float a, float b) const { return fmaxf(a, b); }
+};
+
+// Reduces one value per thread over the block; every thread gets the result.
+template <typename Op>
+__device__ float block_reduce(float value, Op op, float identity, float* scratch) {
+    for (int offset = 16; offset > 0; offset /= 2) {
+        value = op(value, __shfl_xor_sync(0xffffffff, value, offset));
+    }
+    const int lane = threadIdx.x % 32;
+    if (lane == 0) {
+        scratch[threadIdx.x / 32] = value;
+    }
+    __syncthreads();
+    value = lane < kWarps ? scratch[lane] : identity;
+    for (int offset = 16; offset > 0; offset /= 2) {
+        value = op(value, __shfl_xor_sync(0xffffffff, value, offset));
+    }
+    // scratch is reused by the next reduction
+    __syncthreads();
+    return value;
+}
+
+// Larger value first, the lower index among equal values.
+__device__ __forceinline__ bool ranks_before(float value, int32_t index, float other, int32_t other_index) {
+    return value > other || (value == other && index < other_index);
+}
+
+__device__ void block_argmax(float& value, int32_t& index, float* values, int32_t* indices) {
+    for (int offset = 16; offset > 0; offset /= 2) {
+        const float other = __shfl_xor_sync(0xffffffff, value, offset);
+        const int32_t other_index = __shfl_xor_sync(0xffffffff, index, offset);
+        if (ranks_before(other, other_index, value, index)) {
+            value = other;
+            index = other_index;
+        }
+    }
+    const int lane = threadIdx.x % 32;
+    if (lane == 0) {
+        values[threadIdx.x / 32] = value;
+        indices[threadIdx.x / 32] = index;
+    }
+    __syncthreads();
+    value = lane < kWarps ? values[lane] : -INFINITY;
+    index = lane < kWarps ? indices[lane] : INT_MAX;
+    for (int offset = 16; offset > 0; offset /= 2) {
+        const float other = __shfl_xor_sync(0xffffffff, value, offset);
+        const int32_t other_index = __shfl_xor_sync(0xffffffff, index, offset);
+        if (ranks_before(other, other_index, value, index)) {
+            value = other;
+            index = other_index;
+        }
+    }
+    __syncthreads();
+}
+
+template <typename T>
+__global__ void normalize_kernel(const T* __restrict__ src, int32_t cols, bool softmax, float* __restrict__ dst) {
+    __shared__ float scratch[kWarps];
+    const T* row = src + static_cast<int64_t>(blockIdx.x) * cols;
+    float* out = dst + static_cast<int64_t>(blockIdx.x) * cols;
+    if (softmax) {
+        float max = -FLT_MAX;
+        for (int32_t i = threadIdx.x; i < cols; i += blockDim.x) {
+            max = fmaxf(max, load(row, i));
+        }
+        max = block_reduce(max, Max{}, -FLT_MAX, scratch);
+        float sum = 0.0f;
+        for (int32_t i = threadIdx.x; i < cols; i += blockDim.x) {
+            sum += __expf(load(row, i) - max);
+        }
+        const float inv = 1.0f / block_reduce(sum, Sum{}, 0.0f, scratch);
+        for (int32_t i = threadIdx.x; i < cols; i += blockDim.x) {
+            out[i] = __expf(load(row, i) - max) * inv;
+        }
+    } else {
+        float squares = 0.0f;
+        for (int32_t i = threadIdx.x; i < cols; i += blockDim.x) {
+            const float value = load(row, i);
+            squares += value * value;
+        }
+        // a norm of at least 1e-12, as torch.nn.functional.normalize
+        const float inv = rsqrtf(fmaxf(block_reduce(squares, Sum{}, 0.0f, scratch), 1e-24f));
+        for (int32_t i = threadIdx.x; i < cols; i += blockDim.x) {
+            out[i] = load(row, i) * inv;
+        }
+    }
+}
+
+template <typename T>
+__global__ void mean_kernel(const T* __restrict__ src, int32_t cols, float* __restrict__ dst) {
+    __shared__ float scratch[kWarps];
+    const T* row = src + static_cast<int64_t>(blockIdx.x) * cols;
+    float sum = 0.0f;
+    for (int32_t i = threadIdx.x; i < cols; i += blockDim.x) {
+        sum += load(row, i);
+    }
+    sum = block_reduce(sum, Sum{}, 0.0f, scratch);
+    if (threadIdx.x == 0) {
+        dst[blockIdx.x] = sum / cols;
+    }
+}
+
+// k passes over the row, each taking the best element ranked after the previous pick, so no
+// per-row scratch is needed; k is small next to the row.
+template <typename T>
+__global__ void topk_kernel(
+    const T* __restrict__ src, int32_t cols, int32_t k, float* __restrict__ values, int32_t* __restrict__ indices) {
+    __shared__ float scratch_values[kWarps];
+    __shared__ int32_t scratch_indices[kWarps];
+    const T* row = src + static_cast<int64_t>(blockIdx.x) * cols;
+    float last = INFINITY;
+    int32_t last_index = -1;
+    for (int32_t j = 0; j < k; ++j) {
+        float best = -INFINITY;
+        int32_t best_index = INT_MAX;
+        for (int32_t i = threadIdx.x; i < cols; i += blockDim.x) {
+            const float value = load(row, i);
+            if (ranks_before(last, last_index, value, i) && ranks_before(value, i, best, best_index)) {
+                best = value;
+                best_index = i;
+            }
+        }
+        block_argmax(best, best_index, scratch_values, scratch_indices);
+        if (threadIdx.x == 0) {
+            const int64_t out = static_cast<int64_t>(blockIdx.x) * k + j;
+            // fewer than k ranked elements (NaNs) leave -1
+            indices[out] = best_index == INT_MAX ? -1 : best_index;
+            if (values != nullptr) {
+                values[out] = best;
+            }
+        }
+        last = best;
+        last_index = best_index;
+    }
+}
+
+// Greedy CTC decoding of one [steps, classes] sequence per block: the argmax class of every
+// step, with repeats merged and blanks dropped, and the mean probability of the labels kept.
+template <typename T>
+__global__ void ctc_greedy_kernel(
+    const T* __restrict__ src, int32_t steps, int32_t classes, int32_t blank, int32_t* __restrict__ labels,
+    int32_t* __restrict__ lengths, float* __restrict__ scores) {
+    __shared__ float scratch_values[kWarps];
+    __shared__ int32_t scratch_indices[kWarps];
+    const T* sequence = src + static_cast<int64_t>(blockIdx.x) * steps * classes;
+    int32_t* out = labels + static_cast<int64_t>(blockIdx.x) * steps;
+    int32_t length = 0;
+    int32_t previous = blank;
+    float sum = 0.0f;
+    for (int32_t t = 0; t < steps; ++t) {
+        const T* row = sequence + static_cast<int64_t>(t) * classes;
+        float best = -INFINITY;
+        int32_t best_index = INT_MAX;
+        for (int32_t i = threadIdx.x; i < classes; i += blockDim.x) {
+            const float value = load(row, i);
+            if (ranks_before(value, i, best, best_index)) {
+                best = value;
+                best_index = i;
+            }
+        }
+        block_argmax(best, best_index, scratch_values, scratch_indices);
+        // every thread holds the same winner, only thread 0 writes
+        if (best_index != blank && best_index != previous && best_index != INT_MAX) {
+            if (threadIdx.x == 0) {
+                out[length] = best_index;
+            }
+            ++length;
+            sum += best;
+        }
+        previous = best_index;
+    }
+    if (threadIdx.x == 0) {
+        lengths[blockIdx.x] = length;
+        scores[blockIdx.x] = length > 0 ? sum / length : 0.0f;
+    }
+}
+
+constexpr int kTile = 16;
+
+// dst[q, r] = dot(queries[q], index[r]) over `dim`, one kTile x kTile tile of dst per block,
+// staging kTile-wide slices of both operands through shared memory.
+template <typename T>
+__global__ void similarity_kernel(
+    const T* __restrict__ queries, const __half* __restrict__ index, int32_t num_queries, int32_t rows,
+    int32_t dim, float* __restrict__ dst) {
+    __shared__ float query_tile[kTile][kTile];
+    // padded against bank conflicts on the transposed read
+    __shared__ float index_tile[kTile][kTile + 1];
+    const int32_t q = blockIdx.y * kTile + threadIdx.y;
+    const int32_t r = blockIdx.x * kTile + threadIdx.x;
+    const int32_t index_row = blockIdx.x * kTile + threadIdx.y;
+    float sum = 0.0f;
+    for (int32_t base = 0; base < dim; base += kTile) {
+        const int32_t d = base + threadIdx.x;
+        query_tile[threadIdx.y][threadIdx.x] =
+            q < num_queries && d < dim ? load(queries, static_cast<int64_t>(q) * dim + d) : 0.0f;
+        index_tile[threadIdx.y][threadIdx.x] =
+            index_row < rows && d < dim ? __half2float(index[static_cast<int64_t>(index_row) * dim + d]) : 0.0f;
+        __syncthreads();
+#pragma unroll
+        for (int k = 0; k < kTile; ++k) {
+            sum += query_tile[threadIdx.y][k] * index_tile[threadIdx.x][k];
+        }
+        __syncthreads();
+    }
+    if (q < num_queries && r < rows) {
+        dst[static_cast<int64_t>(q) * rows + r] = sum;
+    }
+}
+
+bool valid(int64_t rows, int32_t cols) {
+    return rows >= 0 && rows <= INT_MAX && cols > 0;
+}
+
+} // namespace
+
+bool normalize_rows(
+    std::size_t src, bool half, int64_t rows, int32_t cols, bool softmax, std::size_t dst,
+    std::size_t stream) noexcept {
+    if (!valid(rows, cols)) {
+        return false;
+    }
+    if (rows == 0) {
+        return true;
+    }
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    const auto blocks = static_cast<unsigned int>(rows);
+    if (half) {
+        normalize_kernel<__half><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const __half*>(src), cols, softmax, reinterpret_cast<float*>(dst));
+    } else {
+        normalize_kernel<float><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const float*>(src), cols, softmax, reinterpret_cast<float*>(dst));
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+bool mean_rows(
+    std::size_t src, bool half, int64_t rows, int32_t cols, std::size_t dst, std::size_t stream) noexcept {
+    if (!valid(rows, cols)) {
+        return false;
+    }
+    if (rows == 0) {
+        return true;
+    }
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    const auto blocks = static_cast<unsigned int>(rows);
+    if (half) {
+        mean_kernel<__half><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const __half*>(src), cols, reinterpret_cast<float*>(dst));
+    } else {
+        mean_kernel<float><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const float*>(src), cols, reinterpret_cast<float*>(dst));
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+bool similarity(
+    std::size_t queries, bool queries_half, int32_t num_queries, std::size_t index, int32_t rows, int32_t dim,
+    std::size_t dst, std::size_t stream) noexcept {
+    if (num_queries < 0 || rows < 0 || dim <= 0) {
+        return false;
+    }
+    if (num_queries == 0 || rows == 0) {
+        return true;
+    }
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    const dim3 threads(kTile, kTile);
+    const dim3 blocks((rows + kTile - 1) / kTile, (num_queries + kTile - 1) / kTile);
+    if (blocks.y > 65535) {
+        return false;
+    }
+    const auto index_ptr = reinterpret_cast<const __half*>(index);
+    if (queries_half) {
+        similarity_kernel<__half><<<blocks, threads, 0, cuda_stream>>>(
+            reinterpret_cast<const __half*>(queries), index_ptr, num_queries, rows, dim, reinterpret_cast<float*>(dst));
+    } else {
+        similarity_kernel<float><<<blocks, threads, 0, cuda_stream>>>(
+            reinterpret_cast<const float*>(queries), index_ptr, num_queries, rows, dim, reinterpret_cast<float*>(dst));
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+bool topk_rows(
+    std::size_t src, bool half, int64_t rows, int32_t cols, int32_t k, std::size_t values,
+    std::size_t indices, std::size_t stream) noexcept {
+    if (!valid(rows, cols) || k <= 0 || k > cols || indices == 0) {
+        return false;
+    }
+    if (rows == 0) {
+        return true;
+    }
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    const auto blocks = static_cast<unsigned int>(rows);
+    if (half) {
+        topk_kernel<__half><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const __half*>(src), cols, k, reinterpret_cast<float*>(values),
+            reinterpret_cast<int32_t*>(indices));
+    } else {
+        topk_kernel<float><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const float*>(src), cols, k, reinterpret_cast<float*>(values),
+            reinterpret_cast<int32_t*>(indices));
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+bool ctc_greedy_decode(
+    std::size_t src, bool half, int64_t rows, int32_t steps, int32_t classes, int32_t blank, std::size_t labels,
+    std::size_t lengths, std::size_t scores, std::size_t stream) noexcept {
+    if (!valid(rows, classes) || steps <= 0 || blank < 0 || blank >= classes) {
+        return false;
+    }
+    if (rows == 0) {
+        return true;
+    }
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    const auto blocks = static_cast<unsigned int>(rows);
+    const auto labels_ptr = reinterpret_cast<int32_t*>(labels);
+    const auto lengths_ptr = reinterpret_cast<int32_t*>(lengths);
+    const auto scores_ptr = reinterpret_cast<float*>(scores);
+    if (half) {
+        ctc_greedy_kernel<__half><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const __half*>(src), steps, classes, blank, labels_ptr, lengths_ptr, scores_ptr);
+    } else {
+        ctc_greedy_kernel<float><<<blocks, kThreads, 0, cuda_stream>>>(
+            reinterpret_cast<const float*>(src), steps, classes, blank, labels_ptr, lengths_ptr, scores_ptr);
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace trt_rs::kernels
@@ -0,0 +1,78 @@
+#include "kernels.h"
+
+#include <cuda_fp16.h>
+#include <cuda_runtime_api.h>
+
+namespace trt_rs::kernels {
+
+namespace {
+
+constexpr int kThreads = 256;
+
+// nvinfer1::DataType
+enum DType : int32_t {
+    kFLOAT = 0,
+    kHALF = 1,
+    kINT8 = 2,
+    kINT32 = 3,
+    kBOOL = 4,
+    kUINT8 = 5,
+    kINT64 = 8,
+};
+
+template <typename T>
+__global__ void sequence_mask_kernel(
+    T* __restrict__ dst, int64_t count, int32_t max_length, int32_t length, T one, T zero) {
+    const int64_t i = static_cast<int64_t>(blockIdx.x) * blockDim.x + threadIdx.x;
+    if (i < count) {
+        dst[i] = i % max_length < length ? one : zero;
+    }
+}
+
+template <typename T>
+void launch(
+    std::size_t dst, int64_t count, int32_t max_length, int32_t length, T one, T zero,
+    cudaStream_t stream) {
+    const unsigned int blocks = static_cast<unsigned int>((count + kThreads - 1) / kThreads);
+    sequence_mask_kernel<T><<<blocks, kThreads, 0, stream>>>(
+        reinterpret_cast<T*>(dst), count, max_length, length, one, zero);
+}
+
+} // namespace
+
+bool sequence_mask(
+    std::size_t dst, int32_t dtype, int32_t rows, int32_t max_length, int32_t length,
+    std::size_t stream) noexcept {
+    if (rows < 0 || max_length <= 0 || length < 0 || length > max_length) {
+        return false;
+    }
+    const int64_t count = static_cast<int64_t>(rows) * max_length;
+    if (count == 0) {
+        return true;
+    }
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+    switch (dtype) {
+        case kFLOAT:
+            launch<float>(dst, count, max_length, length, 1.0f, 0.0f, cuda_stream);
+            break;
+        case kHALF:
+            launch<__half>(dst, count, max_length, length, __float2half(1.0f), __float2half(0.0f), cuda_stream);
+            break;
+        case kINT8:
+        case kBOOL:
+        case kUINT8:
+            launch<uint8_t>(dst, count, max_length, length, 1, 0, cuda_stream);
+            break;
+        case kINT32:
+            launch<int32_t>(dst, count, max_length, length, 1, 0, cuda_stream);
+            break;
+        case kINT64:
+            launch<int64_t>(dst, count, max_length, length, 1, 0, cuda_stream);
+            break;
+        default:
+            return false;
+    }
+    return cudaGetLastError() == cudaSuccess;
+}
+
+} // namespace trt_rs::kernels
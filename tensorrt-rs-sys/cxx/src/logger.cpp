@@ -1,64 +1,326 @@
-#include <iostream>
-#include "spdlog/spdlog.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <functional>
+#include <string_view>
+#include <spdlog/spdlog.h>
+#include <spdlog/async.h>
+#include <spdlog/async_logger.h>
+#include <spdlog/sinks/dup_filter_sink.h>
+#include <spdlog/sinks/ringbuffer_sink.h>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include "logger.h"
+#include "tensorrt-rs-sys/src/lib.rs.h"
 
 namespace trt_rs::logger {
 
-void Logger::log(Severity severity, const char *msg) noexcept {
-    switch (severity) {
-        case Severity::kINTERNAL_ERROR:
-            spdlog::critical(msg);
-            break;
-        case Severity::kERROR:
-            spdlog::error(msg);
-            break;
-        case Severity::kWARNING:
-            spdlog::warn(msg);
-            break;
-        case Severity::kINFO:
-            spdlog::info(msg);
-            break;
-        case Severity::kVERBOSE:
-            spdlog::debug(msg);
-            break;
+namespace {
+
+spdlog::level::level_enum to_spdlog_level(int32_t severity) noexcept {
+    switch (static_cast<ILogger::Severity>(severity)) {
+        case ILogger::Severity::kINTERNAL_ERROR:
+            return spdlog::level::critical;
+        case ILogger::Severity::kERROR:
+            return spdlog::level::err;
+        case ILogger::Severity::kWARNING:
+            return spdlog::level::warn;
+        case ILogger::Severity::kINFO:
+            return spdlog::level::info;
+        case ILogger::Severity::kVERBOSE:
         default:
-            spdlog::debug(msg);
-            break;
+            return spdlog::level::debug;
     }
 }
 
+} // namespace
+
+// Token bucket per message hash, in a fixed table so the hot path never allocates. Messages
+// whose hashes collide on a slot share it; a slot taken over by a new message forgets the
+// previous one's suppressed count.
+class RateLimiter {
+public:
+    RateLimiter(double rate_per_sec, double burst) : rate_(rate_per_sec), burst_(burst) {}
+
+    // Whether the message may be written; `suppressed` is how many copies were dropped since
+    // it was last written.
+    bool acquire(std::string_view msg, uint64_t& suppressed) noexcept {
+        const auto hash = std::hash<std::string_view>{}(msg);
+        auto& slot = slots_[hash % kNumSlots];
+        const auto now = Clock::now();
+
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if (slot.hash != hash || slot.last == Clock::time_point{}) {
+            slot.hash = hash;
+            slot.tokens = burst_;
+            slot.suppressed = 0;
+        } else {
+            const std::chrono::duration<double> elapsed = now - slot.last;
+            slot.tokens = std::min(burst_, slot.tokens + elapsed.count() * rate_);
+        }
+        slot.last = now;
+
+        if (slot.tokens < 1.0) {
+            ++slot.suppressed;
+            return false;
+        }
+        slot.tokens -= 1.0;
+        suppressed = slot.suppressed;
+        slot.suppressed = 0;
+        return true;
+    }
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Slot {
+        std::mutex mutex;
+        std::size_t hash = 0;
+        double tokens = 0.0;
+        Clock::time_point last{};
+        uint64_t suppressed = 0;
+    };
+
+    static constexpr std::size_t kNumSlots = 256;
+
+    double rate_;
+    double burst_;
+    std::array<Slot, kNumSlots> slots_;
+};
+
+Logger::Logger(const std::string& name)
+    : threshold_(static_cast<int32_t>(Severity::kINFO)),
+      level_(static_cast<int32_t>(Severity::kINFO)),
+      capture_level_(-1),
+      // deliberately not registered with spdlog, so names may repeat across runtimes
+      logger_(std::make_shared<spdlog::logger>(name, std::make_shared<spdlog::sinks::stdout_color_sink_mt>())) {
+    logger_->set_level(to_spdlog_level(level_.load()));
+}
+
+std::shared_ptr<spdlog::logger> Logger::get_logger() const noexcept {
+    return std::atomic_load(&logger_);
+}
+
+void Logger::write(int32_t severity, const char* msg, std::size_t len) noexcept {
+    const auto logger = get_logger();
+    const auto level = to_spdlog_level(severity);
+    // passed as a literal string_view, never as a format string, so '{' in TensorRT's
+    // messages is neither parsed nor able to throw
+    const spdlog::string_view_t view(msg, len);
+    if (severity <= capture_level_.load(std::memory_order_relaxed)) {
+        if (const auto ring = std::atomic_load(&ring_)) {
+            try {
+                ring->log(spdlog::details::log_msg(logger->name(), level, view));
+            } catch (...) {}
+        }
+    }
+    if (severity > level_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    uint64_t suppressed = 0;
+    if (const auto limiter = std::atomic_load(&limiter_)) {
+        if (!limiter->acquire(std::string_view(msg, len), suppressed)) {
+            return;
+        }
+    }
+    if (const auto callback = std::atomic_load(&callback_)) {
+        try {
+            if (suppressed == 0) {
+                (*callback)->on_log(severity, rust::Slice<const uint8_t>(reinterpret_cast<const uint8_t*>(msg), len));
+            } else {
+                const auto annotated = fmt::format("{} (suppressed {} times)", view, suppressed);
+                (*callback)->on_log(severity, rust::Slice<const uint8_t>(
+                    reinterpret_cast<const uint8_t*>(annotated.data()), annotated.size()));
+            }
+        } catch (...) {}
+        return;
+    }
+    if (suppressed == 0) {
+        logger->log(level, view);
+    } else {
+        logger->log(level, "{} (suppressed {} times)", view, suppressed);
+    }
+}
+
+void Logger::log(Severity severity, const char *msg) noexcept {
+    const auto level = static_cast<int32_t>(severity);
+    if (level > threshold_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    write(level, msg, std::char_traits<char>::length(msg));
+}
+
 void Logger::log(int32_t severity, rust::Str msg) noexcept {
-    const auto msg_str = std::string(msg);
-    log(static_cast<Severity>(severity), msg_str.c_str());
+    if (severity > threshold_.load(std::memory_order_relaxed)) {
+        return;
+    }
+    write(severity, msg.data(), msg.size());
 }
 
 void Logger::set_level(int32_t severity) noexcept {
-    const auto level = static_cast<Severity>(severity);
-    switch (level)
-    {
-    case Severity::kINTERNAL_ERROR:
-        spdlog::set_level(spdlog::level::critical);
-        break;
-    case Severity::kERROR:
-        spdlog::set_level(spdlog::level::err);
-        break;
-    case Severity::kWARNING:
-        spdlog::set_level(spdlog::level::warn);
-        break;
-    case Severity::kINFO:
-        spdlog::set_level(spdlog::level::info);
-        break;
-    case Severity::kVERBOSE:
-        spdlog::set_level(spdlog::level::debug);
-        break;
-    default:
-        break;
+    if (severity < static_cast<int32_t>(Severity::kINTERNAL_ERROR)
+        || severity > static_cast<int32_t>(Severity::kVERBOSE)) {
+        return;
     }
+    get_logger()->set_level(to_spdlog_level(severity));
+    level_.store(severity, std::memory_order_relaxed);
+    threshold_.store(std::max(severity, capture_level_.load()), std::memory_order_relaxed);
+}
+
+void Logger::set_name(rust::Str name) noexcept {
+    try {
+        const auto current = get_logger();
+        auto renamed = current->clone(std::string(name));
+        current->flush();
+        std::atomic_store(&logger_, renamed);
+    } catch (...) {}
+}
+
+rust::String Logger::get_name() const noexcept {
+    return rust::String(get_logger()->name());
+}
+
+bool Logger::set_async(std::size_t queue_size, int32_t overflow_policy) noexcept {
+    if (overflow_policy < 0 || overflow_policy > static_cast<int32_t>(spdlog::async_overflow_policy::discard_new)) {
+        return false;
+    }
+    try {
+        const auto current = get_logger();
+        const auto& sinks = current->sinks();
+        auto thread_pool = std::make_shared<spdlog::details::thread_pool>(queue_size, 1);
+        auto async_logger = std::make_shared<spdlog::async_logger>(
+            current->name(), sinks.begin(), sinks.end(), thread_pool,
+            static_cast<spdlog::async_overflow_policy>(overflow_policy));
+        async_logger->set_level(current->level());
+        // the previous pool (if any) is kept alive by the previous logger's in-flight messages
+        // only through this member, so drain it before dropping it
+        current->flush();
+        std::atomic_store(&logger_, std::shared_ptr<spdlog::logger>(async_logger));
+        std::atomic_store(&thread_pool_, std::move(thread_pool));
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+bool Logger::is_async() const noexcept {
+    return std::atomic_load(&thread_pool_) != nullptr;
+}
+
+void Logger::flush() noexcept {
+    get_logger()->flush();
+}
+
+bool Logger::enable_capture(std::size_t capacity, int32_t capture_severity) noexcept {
+    if (capacity == 0 || capture_severity < static_cast<int32_t>(Severity::kINTERNAL_ERROR)
+        || capture_severity > static_cast<int32_t>(Severity::kVERBOSE)) {
+        return false;
+    }
+    try {
+        std::atomic_store(&ring_, std::make_shared<RingSink>(capacity));
+    } catch (...) {
+        return false;
+    }
+    capture_capacity_ = capacity;
+    capture_level_.store(capture_severity, std::memory_order_relaxed);
+    threshold_.store(std::max(level_.load(), capture_severity), std::memory_order_relaxed);
+    return true;
+}
+
+void Logger::disable_capture() noexcept {
+    capture_level_.store(-1, std::memory_order_relaxed);
+    threshold_.store(level_.load(), std::memory_order_relaxed);
+    std::atomic_store(&ring_, std::shared_ptr<RingSink>());
+}
+
+rust::Vec<rust::String> Logger::dump_captured(std::size_t lines) const noexcept {
+    rust::Vec<rust::String> dump;
+    const auto ring = std::atomic_load(&ring_);
+    if (!ring) {
+        return dump;
+    }
+    try {
+        for (auto& line : ring->last_formatted(lines)) {
+            while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+                line.pop_back();
+            }
+            dump.push_back(rust::String(line));
+        }
+    } catch (...) {}
+    return dump;
+}
+
+void Logger::replay_captured() noexcept {
+    const auto ring = std::atomic_load(&ring_);
+    if (!ring) {
+        return;
+    }
+    try {
+        const auto logger = get_logger();
+        // straight into the sinks, so the messages keep their own level and timestamp
+        for (const auto& msg : ring->last_raw()) {
+            for (const auto& sink : logger->sinks()) {
+                sink->log(msg);
+            }
+        }
+        logger->flush();
+        std::atomic_store(&ring_, std::make_shared<RingSink>(capture_capacity_));
+    } catch (...) {}
+}
+
+bool Logger::enable_rate_limit(double rate_per_sec, uint32_t burst, uint32_t dedup_window_ms) noexcept {
+    if (!(rate_per_sec > 0.0) || burst == 0) {
+        return false;
+    }
+    try {
+        if (!dedup_) {
+            // a clone keeps the async backend, if any; its sinks move under the dedup filter
+            const auto current = get_logger();
+            auto limited = current->clone(current->name());
+            auto dedup = std::make_shared<spdlog::sinks::dup_filter_sink<std::mutex>>(
+                std::chrono::milliseconds(dedup_window_ms));
+            dedup->set_sinks(limited->sinks());
+            limited->sinks() = {dedup};
+            current->flush();
+            std::atomic_store(&logger_, limited);
+            dedup_ = std::move(dedup);
+        }
+        std::atomic_store(&limiter_, std::make_shared<RateLimiter>(rate_per_sec, burst));
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+void Logger::disable_rate_limit() noexcept {
+    std::atomic_store(&limiter_, std::shared_ptr<RateLimiter>());
+    if (!dedup_) {
+        return;
+    }
+    try {
+        const auto current = get_logger();
+        auto unlimited = current->clone(current->name());
+        unlimited->sinks() = dedup_->sinks();
+        current->flush();
+        std::atomic_store(&logger_, unlimited);
+        dedup_.reset();
+    } catch (...) {}
+}
+
+void Logger::set_callback(rust::Box<LogCallback> callback) noexcept {
+    try {
+        std::atomic_store(&callback_, std::make_shared<rust::Box<LogCallback>>(std::move(callback)));
+    } catch (...) {}
+}
+
+void Logger::clear_callback() noexcept {
+    std::atomic_store(&callback_, std::shared_ptr<rust::Box<LogCallback>>());
 }
 
 std::unique_ptr<Logger> create_logger() {
-    return std::make_unique<Logger>();
+    return std::make_unique<Logger>("tensorrt");
 }
 
-} // namespace trt_rs::logger
+std::unique_ptr<Logger> create_named_logger(rust::Str name) {
+    return std::make_unique<Logger>(std::string(name));
+}
 
+} // namespace trt_rs::logger
@@ -1 +1,421 @@
+#include <algorithm>
+#include <vector>
+#include <NvInferPlugin.h>
+#include "logger.h"
 #include "plugin.h"
+#include "tensorrt-rs-sys/src/lib.rs.h"
+
+namespace trt_rs::plugin {
+
+namespace {
+
+rust::String to_string(const char* value) {
+    return rust::String(value == nullptr ? "" : value);
+}
+
+template <typename Creator>
+PluginCreatorInfo creator_info(const Creator* creator) {
+    return PluginCreatorInfo{
+        to_string(creator->getPluginName()),
+        to_string(creator->getPluginVersion()),
+        to_string(creator->getPluginNamespace()),
+    };
+}
+
+// IPluginV3 and IPluginCreatorV3One are TensorRT 10 interfaces; earlier versions cannot
+// register Rust plugins.
+#if NV_TENSORRT_MAJOR >= 10
+using nvinfer1::DataType;
+using nvinfer1::DimsExprs;
+using nvinfer1::DynamicPluginTensorDesc;
+using nvinfer1::IExprBuilder;
+using nvinfer1::IPluginCapability;
+using nvinfer1::IPluginV3;
+using nvinfer1::IPluginResourceContext;
+using nvinfer1::PluginCapabilityType;
+using nvinfer1::PluginFieldCollection;
+using nvinfer1::PluginFieldType;
+using nvinfer1::TensorRTPhase;
+using trt_rs::runtime::TensorDims;
+
+TensorDims to_tensor_dims(const nvinfer1::Dims& dims) noexcept {
+    auto tensor_dims = TensorDims();
+    tensor_dims.nb_dims = dims.nbDims;
+    for (int32_t i = 0; i < dims.nbDims && i < static_cast<int32_t>(tensor_dims.d.size()); ++i) {
+        tensor_dims.d[i] = dims.d[i];
+    }
+    return tensor_dims;
+}
+
+// Bytes of a field of `length` elements, or -1 for types that do not cross the bridge.
+int64_t field_size(PluginFieldType type, int32_t length) noexcept {
+    switch (type) {
+    case PluginFieldType::kINT8:
+    case PluginFieldType::kCHAR:
+    case PluginFieldType::kUNKNOWN:
+        return length;
+    case PluginFieldType::kFLOAT16:
+    case PluginFieldType::kINT16:
+        return int64_t(length) * 2;
+    case PluginFieldType::kFLOAT32:
+    case PluginFieldType::kINT32:
+        return int64_t(length) * 4;
+    case PluginFieldType::kFLOAT64:
+    case PluginFieldType::kINT64:
+        return int64_t(length) * 8;
+    case PluginFieldType::kDIMS:
+        return int64_t(length) * sizeof(nvinfer1::Dims);
+    default:
+        return -1;
+    }
+}
+
+// Dispatches every call to a Rust Plugin. The builder and each execution context hold
+// their own clone, so the mutable calls never race on one instance.
+class RustPluginV3 : public IPluginV3,
+                     public nvinfer1::IPluginV3OneCore,
+                     public nvinfer1::IPluginV3OneBuild,
+                     public nvinfer1::IPluginV3OneRuntime {
+public:
+    RustPluginV3(std::shared_ptr<const PluginCreatorInfo> info, rust::Box<RustPlugin> plugin)
+        : info_(std::move(info)), plugin_(std::move(plugin)) {}
+
+    IPluginCapability* getCapabilityInterface(PluginCapabilityType type) noexcept override {
+        switch (type) {
+        case PluginCapabilityType::kCORE:
+            return static_cast<nvinfer1::IPluginV3OneCore*>(this);
+        case PluginCapabilityType::kBUILD:
+            return static_cast<nvinfer1::IPluginV3OneBuild*>(this);
+        case PluginCapabilityType::kRUNTIME:
+            return static_cast<nvinfer1::IPluginV3OneRuntime*>(this);
+        }
+        return nullptr;
+    }
+
+    IPluginV3* clone() noexcept override {
+        auto plugin = plugin_->clone_plugin();
+        if (!plugin->is_valid()) {
+            return nullptr;
+        }
+        return new RustPluginV3(info_, std::move(plugin));
+    }
+
+    const char* getPluginName() const noexcept override {
+        return name_.c_str();
+    }
+
+    const char* getPluginVersion() const noexcept override {
+        return version_.c_str();
+    }
+
+    const char* getPluginNamespace() const noexcept override {
+        return namespace_.c_str();
+    }
+
+    int32_t getNbOutputs() const noexcept override {
+        return plugin_->num_outputs();
+    }
+
+    int32_t configurePlugin(
+        const DynamicPluginTensorDesc*, int32_t, const DynamicPluginTensorDesc*, int32_t) noexcept override {
+        return 0;
+    }
+
+    int32_t getOutputDataTypes(
+        DataType* output_types, int32_t nb_outputs, const DataType* input_types, int32_t nb_inputs) const noexcept override {
+        std::vector<int32_t> inputs(nb_inputs);
+        for (int32_t i = 0; i < nb_inputs; ++i) {
+            inputs[i] = static_cast<int32_t>(input_types[i]);
+        }
+        std::vector<int32_t> outputs(nb_outputs, -1);
+        if (!plugin_->output_types(
+                rust::Slice<const int32_t>(inputs.data(), inputs.size()),
+                rust::Slice<int32_t>(outputs.data(), outputs.size()))) {
+            return -1;
+        }
+        for (int32_t i = 0; i < nb_outputs; ++i) {
+            output_types[i] = static_cast<DataType>(outputs[i]);
+        }
+        return 0;
+    }
+
+    int32_t getOutputShapes(
+        const DimsExprs* inputs,
+        int32_t nb_inputs,
+        const DimsExprs*,
+        int32_t,
+        DimsExprs* outputs,
+        int32_t nb_outputs,
+        IExprBuilder& builder) noexcept override {
+        std::vector<int32_t> ranks(nb_inputs);
+        for (int32_t i = 0; i < nb_inputs; ++i) {
+            ranks[i] = inputs[i].nbDims;
+        }
+        for (int32_t i = 0; i < nb_outputs; ++i) {
+            outputs[i].nbDims = 0;
+        }
+        for (const auto& expr : plugin_->output_shapes(rust::Slice<const int32_t>(ranks.data(), ranks.size()))) {
+            if (expr.output < 0 || expr.output >= nb_outputs || expr.dim < 0 || expr.dim >= nvinfer1::Dims::MAX_DIMS) {
+                return -1;
+            }
+            auto& output = outputs[expr.output];
+            if (expr.input < 0) {
+                output.d[expr.dim] = builder.constant(expr.value);
+            } else if (expr.input < nb_inputs && expr.value >= 0 && expr.value < inputs[expr.input].nbDims) {
+                output.d[expr.dim] = inputs[expr.input].d[expr.value];
+            } else {
+                return -1;
+            }
+            output.nbDims = std::max(output.nbDims, expr.dim + 1);
+        }
+        return 0;
+    }
+
+    bool supportsFormatCombination(
+        int32_t pos, const DynamicPluginTensorDesc* in_out, int32_t, int32_t) noexcept override {
+        if (in_out[pos].desc.format != nvinfer1::TensorFormat::kLINEAR) {
+            return false;
+        }
+        std::vector<int32_t> types(pos + 1);
+        for (int32_t i = 0; i <= pos; ++i) {
+            types[i] = static_cast<int32_t>(in_out[i].desc.type);
+        }
+        return plugin_->supports_type(pos, rust::Slice<const int32_t>(types.data(), types.size()));
+    }
+
+    size_t getWorkspaceSize(
+        const DynamicPluginTensorDesc* inputs,
+        int32_t nb_inputs,
+        const DynamicPluginTensorDesc* outputs,
+        int32_t nb_outputs) const noexcept override {
+        std::vector<TensorDims> input_dims(nb_inputs);
+        for (int32_t i = 0; i < nb_inputs; ++i) {
+            input_dims[i] = to_tensor_dims(inputs[i].max);
+        }
+        std::vector<TensorDims> output_dims(nb_outputs);
+        for (int32_t i = 0; i < nb_outputs; ++i) {
+            output_dims[i] = to_tensor_dims(outputs[i].max);
+        }
+        return plugin_->workspace_size(
+            rust::Slice<const TensorDims>(input_dims.data(), input_dims.size()),
+            rust::Slice<const TensorDims>(output_dims.data(), output_dims.size()));
+    }
+
+    int32_t onShapeChange(
+        const nvinfer1::PluginTensorDesc* in,
+        int32_t nb_inputs,
+        const nvinfer1::PluginTensorDesc* out,
+        int32_t nb_outputs) noexcept override {
+        describe(inputs_, in, nb_inputs, nullptr);
+        describe(outputs_, out, nb_outputs, nullptr);
+        return plugin_->on_shape_change(slice(inputs_), slice(outputs_)) ? 0 : -1;
+    }
+
+    int32_t enqueue(
+        const nvinfer1::PluginTensorDesc* input_desc,
+        const nvinfer1::PluginTensorDesc* output_desc,
+        const void* const* inputs,
+        void* const* outputs,
+        void* workspace,
+        cudaStream_t stream) noexcept override {
+        const auto nb_inputs = static_cast<int32_t>(inputs_.size());
+        const auto nb_outputs = static_cast<int32_t>(outputs_.size());
+        describe(inputs_, input_desc, nb_inputs, inputs);
+        describe(outputs_, output_desc, nb_outputs, outputs);
+        const auto enqueued = plugin_->enqueue(
+            slice(inputs_),
+            slice(outputs_),
+            reinterpret_cast<std::size_t>(workspace),
+            reinterpret_cast<std::size_t>(stream));
+        return enqueued ? 0 : -1;
+    }
+
+    IPluginV3* attachToContext(IPluginResourceContext*) noexcept override {
+        return clone();
+    }
+
+    const PluginFieldCollection* getFieldsToSerialize() noexcept override {
+        serialized_ = plugin_->serialize();
+        names_.clear();
+        fields_.clear();
+        for (const auto& field : serialized_) {
+            names_.emplace_back(std::string(field.name));
+        }
+        for (std::size_t i = 0; i < serialized_.size(); ++i) {
+            const auto& field = serialized_[i];
+            fields_.emplace_back(
+                names_[i].c_str(), field.data.data(), static_cast<PluginFieldType>(field.field_type), field.length);
+        }
+        collection_.nbFields = static_cast<int32_t>(fields_.size());
+        collection_.fields = fields_.data();
+        return &collection_;
+    }
+private:
+    static void describe(
+        std::vector<PluginTensor>& tensors,
+        const nvinfer1::PluginTensorDesc* descs,
+        int32_t count,
+        const void* const* addresses) {
+        tensors.resize(count);
+        for (int32_t i = 0; i < count; ++i) {
+            tensors[i].dims = to_tensor_dims(descs[i].dims);
+            tensors[i].dtype = static_cast<int32_t>(descs[i].type);
+            tensors[i].address = addresses == nullptr ? 0 : reinterpret_cast<std::size_t>(addresses[i]);
+        }
+    }
+
+    static rust::Slice<const PluginTensor> slice(const std::vector<PluginTensor>& tensors) {
+        return rust::Slice<const PluginTensor>(tensors.data(), tensors.size());
+    }
+
+    std::shared_ptr<const PluginCreatorInfo> info_;
+    const std::string name_ = std::string(info_->name);
+    const std::string version_ = std::string(info_->version);
+    const std::string namespace_ = std::string(info_->plugin_namespace);
+    rust::Box<RustPlugin> plugin_;
+    // reused by every enqueue, so the hot path does not allocate
+    std::vector<PluginTensor> inputs_;
+    std::vector<PluginTensor> outputs_;
+    rust::Vec<PluginField> serialized_;
+    std::vector<std::string> names_;
+    std::vector<nvinfer1::PluginField> fields_;
+    PluginFieldCollection collection_ = {};
+};
+
+class RustPluginCreatorAdapter : public nvinfer1::IPluginCreatorV3One {
+public:
+    RustPluginCreatorAdapter(std::shared_ptr<const PluginCreatorInfo> info, rust::Box<RustPluginCreator> creator)
+        : info_(std::move(info)), creator_(std::move(creator)) {}
+
+    const char* getPluginName() const noexcept override {
+        return name_.c_str();
+    }
+
+    const char* getPluginVersion() const noexcept override {
+        return version_.c_str();
+    }
+
+    const char* getPluginNamespace() const noexcept override {
+        return namespace_.c_str();
+    }
+
+    // the fields are checked by the Rust creator, so none are advertised
+    const PluginFieldCollection* getFieldNames() noexcept override {
+        return &field_names_;
+    }
+
+    IPluginV3* createPlugin(const char* name, const PluginFieldCollection* fc, TensorRTPhase) noexcept override {
+        rust::Vec<PluginField> fields;
+        for (int32_t i = 0; fc != nullptr && i < fc->nbFields; ++i) {
+            const auto& field = fc->fields[i];
+            const auto size = field_size(field.type, field.length);
+            if (size < 0 || (size > 0 && field.data == nullptr)) {
+                return nullptr;
+            }
+            PluginField copy;
+            copy.name = rust::String(field.name == nullptr ? "" : field.name);
+            copy.field_type = static_cast<int32_t>(field.type);
+            copy.length = field.length;
+            const auto bytes = static_cast<const std::uint8_t*>(field.data);
+            copy.data.reserve(size);
+            for (int64_t j = 0; j < size; ++j) {
+                copy.data.push_back(bytes[j]);
+            }
+            fields.push_back(std::move(copy));
+        }
+        auto plugin = creator_->create(
+            rust::Str(name == nullptr ? "" : name),
+            rust::Slice<const PluginField>(fields.data(), fields.size()));
+        if (!plugin->is_valid()) {
+            return nullptr;
+        }
+        return new RustPluginV3(info_, std::move(plugin));
+    }
+private:
+    std::shared_ptr<const PluginCreatorInfo> info_;
+    const std::string name_ = std::string(info_->name);
+    const std::string version_ = std::string(info_->version);
+    const std::string namespace_ = std::string(info_->plugin_namespace);
+    rust::Box<RustPluginCreator> creator_;
+    PluginFieldCollection field_names_ = {};
+};
+#endif
+
+} // namespace
+
+bool init_lib_nvinfer_plugins(rust::Str plugin_namespace) noexcept {
+#ifdef TRT_RS_PLUGINS
+    // the plugin library keeps the logger, so it lives as long as the process
+    static const bool initialized = [&] {
+        static auto* logger = trt_rs::logger::create_named_logger("plugins").release();
+        const auto ns = std::string(plugin_namespace);
+        return initLibNvInferPlugins(logger, ns.c_str());
+    }();
+    return initialized;
+#else
+    // built without libnvinfer_plugin
+    (void)plugin_namespace;
+    return false;
+#endif
+}
+
+rust::Vec<PluginCreatorInfo> get_plugin_creators() noexcept {
+    rust::Vec<PluginCreatorInfo> infos;
+    int32_t count = 0;
+#if NV_TENSORRT_MAJOR >= 10
+    const auto creators = getPluginRegistry()->getAllCreators(&count);
+#else
+    // before TensorRT 10 every creator is an IPluginCreator
+    const auto creators = getPluginRegistry()->getPluginCreatorList(&count);
+#endif
+    if (creators == nullptr) {
+        return infos;
+    }
+    for (int32_t i = 0; i < count; ++i) {
+        const auto creator = creators[i];
+        if (creator == nullptr) {
+            continue;
+        }
+#if NV_TENSORRT_MAJOR >= 10
+        const auto kind = std::string(creator->getInterfaceInfo().kind);
+        if (kind == "PLUGIN CREATOR_V1") {
+            infos.push_back(creator_info(static_cast<const nvinfer1::IPluginCreator*>(creator)));
+        } else if (kind == "PLUGIN CREATOR_V3ONE") {
+            infos.push_back(creator_info(static_cast<const nvinfer1::IPluginCreatorV3One*>(creator)));
+        }
+#else
+        infos.push_back(creator_info(creator));
+#endif
+    }
+    return infos;
+}
+
+bool register_plugin_creator(
+    rust::Str name,
+    rust::Str version,
+    rust::Str plugin_namespace,
+    rust::Box<RustPluginCreator> creator) noexcept {
+#if NV_TENSORRT_MAJOR >= 10
+    auto info = std::make_shared<const PluginCreatorInfo>(PluginCreatorInfo{
+        rust::String(std::string(name)),
+        rust::String(std::string(version)),
+        rust::String(std::string(plugin_namespace)),
+    });
+    // the registry keeps a reference for the rest of the process
+    auto adapter = new RustPluginCreatorAdapter(info, std::move(creator));
+    const auto ns = std::string(plugin_namespace);
+    if (!getPluginRegistry()->registerCreator(*adapter, ns.c_str())) {
+        delete adapter;
+        return false;
+    }
+    return true;
+#else
+    (void)name;
+    (void)version;
+    (void)plugin_namespace;
+    (void)creator;
+    return false;
+#endif
+}
+
+} // namespace trt_rs::plugin
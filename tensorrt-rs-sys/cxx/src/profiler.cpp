@@ -0,0 +1,139 @@
+#include <cmath>
+#include <cstring>
+#include "profiler.h"
+#include "tensorrt-rs-sys/src/lib.rs.h"
+
+namespace trt_rs::profiler {
+
+namespace {
+
+std::size_t bucket_index(uint64_t ns) noexcept {
+    const double us = static_cast<double>(ns) / 1000.0;
+    if (us <= 1.0) {
+        return 0;
+    }
+    const auto index = static_cast<std::size_t>(std::log2(us) * 4.0);
+    return std::min(index, LayerTimingTable::kNumBuckets - 1);
+}
+
+// upper edge of a bucket, so reported percentiles never understate
+float bucket_upper_ms(std::size_t index) noexcept {
+    return static_cast<float>(std::exp2(static_cast<double>(index + 1) / 4.0) / 1000.0);
+}
+
+void update_min(std::atomic<uint64_t>& target, uint64_t value) noexcept {
+    auto current = target.load(std::memory_order_relaxed);
+    while (value < current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+void update_max(std::atomic<uint64_t>& target, uint64_t value) noexcept {
+    auto current = target.load(std::memory_order_relaxed);
+    while (value > current && !target.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+} // namespace
+
+LayerTimingTable::LayerStats* LayerTimingTable::find_or_insert(char const* name) noexcept {
+    const auto num_layers = num_layers_.load(std::memory_order_acquire);
+    if (num_layers > 0) {
+        const auto cursor = cursor_.load(std::memory_order_relaxed) % num_layers;
+        if (layers_[cursor].name == name) {
+            cursor_.store(cursor + 1, std::memory_order_relaxed);
+            return &layers_[cursor];
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(insert_mutex_);
+    auto it = index_.find(name);
+    std::size_t index = 0;
+    if (it != index_.end()) {
+        index = it->second;
+    } else {
+        index = num_layers_.load(std::memory_order_relaxed);
+        if (index >= kMaxLayers) {
+            return nullptr;
+        }
+        layers_[index].name = name;
+        index_.emplace(name, index);
+        num_layers_.store(index + 1, std::memory_order_release);
+    }
+    cursor_.store(index + 1, std::memory_order_relaxed);
+    return &layers_[index];
+}
+
+void LayerTimingTable::reportLayerTime(char const* layerName, float ms) noexcept {
+    auto stats = find_or_insert(layerName);
+    if (!stats) {
+        return;
+    }
+    const auto ns = static_cast<uint64_t>(std::max(ms, 0.0f) * 1e6f);
+    stats->count.fetch_add(1, std::memory_order_relaxed);
+    stats->total_ns.fetch_add(ns, std::memory_order_relaxed);
+    update_min(stats->min_ns, ns);
+    update_max(stats->max_ns, ns);
+    stats->buckets[bucket_index(ns)].fetch_add(1, std::memory_order_relaxed);
+}
+
+rust::Vec<LayerTiming> LayerTimingTable::get_layer_timings() const noexcept {
+    auto timings = rust::Vec<LayerTiming>();
+    const auto num_layers = num_layers_.load(std::memory_order_acquire);
+    timings.reserve(num_layers);
+    for (std::size_t i = 0; i < num_layers; ++i) {
+        const auto& stats = layers_[i];
+        std::array<uint32_t, kNumBuckets> buckets;
+        uint64_t total = 0;
+        for (std::size_t b = 0; b < kNumBuckets; ++b) {
+            buckets[b] = stats.buckets[b].load(std::memory_order_relaxed);
+            total += buckets[b];
+        }
+        const auto percentile = [&](double q) {
+            const auto rank = static_cast<uint64_t>(std::ceil(q * static_cast<double>(total)));
+            uint64_t seen = 0;
+            for (std::size_t b = 0; b < kNumBuckets; ++b) {
+                seen += buckets[b];
+                if (seen >= rank && seen > 0) {
+                    return bucket_upper_ms(b);
+                }
+            }
+            return 0.0f;
+        };
+
+        auto timing = LayerTiming();
+        timing.name = rust::String(stats.name);
+        timing.count = stats.count.load(std::memory_order_relaxed);
+        timing.total_ms = static_cast<double>(stats.total_ns.load(std::memory_order_relaxed)) / 1e6;
+        timing.min_ms = timing.count > 0
+            ? static_cast<float>(stats.min_ns.load(std::memory_order_relaxed)) / 1e6f
+            : 0.0f;
+        timing.max_ms = static_cast<float>(stats.max_ns.load(std::memory_order_relaxed)) / 1e6f;
+        timing.p50_ms = percentile(0.5);
+        timing.p90_ms = percentile(0.9);
+        timing.p99_ms = percentile(0.99);
+        timings.push_back(std::move(timing));
+    }
+    return timings;
+}
+
+void LayerTimingTable::reset() noexcept {
+    const auto num_layers = num_layers_.load(std::memory_order_acquire);
+    for (std::size_t i = 0; i < num_layers; ++i) {
+        auto& stats = layers_[i];
+        stats.count.store(0, std::memory_order_relaxed);
+        stats.total_ns.store(0, std::memory_order_relaxed);
+        stats.min_ns.store(UINT64_MAX, std::memory_order_relaxed);
+        stats.max_ns.store(0, std::memory_order_relaxed);
+        for (auto& bucket : stats.buckets) {
+            bucket.store(0, std::memory_order_relaxed);
+        }
+    }
+}
+
+rust::Vec<LayerTiming> Profiler::get_layer_timings() const noexcept {
+    return table_->get_layer_timings();
+}
+
+std::unique_ptr<Profiler> create_profiler() noexcept {
+    return std::make_unique<Profiler>();
+}
+
+} // namespace trt_rs::profiler
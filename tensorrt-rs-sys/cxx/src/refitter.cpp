@@ -0,0 +1,72 @@
+#include "refitter.h"
+#include <cuda_runtime_api.h>
+#include "tensorrt-rs-sys/src/lib.rs.h"
+
+namespace trt_rs::refitter {
+
+namespace {
+
+template <typename F>
+rust::Vec<rust::String> collect_names(F get_names) noexcept {
+    auto names = rust::Vec<rust::String>();
+    const auto count = get_names(0, nullptr);
+    if (count <= 0) {
+        return names;
+    }
+    auto raw_names = std::vector<const char*>(count);
+    const auto written = get_names(count, raw_names.data());
+    names.reserve(written);
+    for (int32_t i = 0; i < written; ++i) {
+        names.push_back(rust::String(raw_names[i]));
+    }
+    return names;
+}
+
+} // namespace
+
+bool Refitter::set_named_weights(
+    rust::Str name, int32_t dtype, std::size_t values, int64_t count, bool on_device) noexcept {
+    const auto weights = nvinfer1::Weights{
+        static_cast<nvinfer1::DataType>(dtype), reinterpret_cast<const void*>(values), count};
+    names_.emplace_back(name);
+    const auto name_ptr = names_.back().c_str();
+#if NV_TENSORRT_MAJOR >= 10
+    const auto location = on_device ? nvinfer1::TensorLocation::kDEVICE : nvinfer1::TensorLocation::kHOST;
+    return refitter_->setNamedWeights(name_ptr, weights, location);
+#else
+    // device-resident weights need TensorRT 10
+    return !on_device && refitter_->setNamedWeights(name_ptr, weights);
+#endif
+}
+
+rust::Vec<rust::String> Refitter::get_missing_weights() const noexcept {
+    return collect_names([this](int32_t size, const char** names) {
+        return refitter_->getMissingWeights(size, names);
+    });
+}
+
+rust::Vec<rust::String> Refitter::get_all_weights() const noexcept {
+    return collect_names([this](int32_t size, const char** names) {
+        return refitter_->getAllWeights(size, names);
+    });
+}
+
+bool Refitter::refit_async(std::size_t stream) noexcept {
+    const auto cuda_stream = reinterpret_cast<cudaStream_t>(stream);
+#if NV_TENSORRT_MAJOR >= 10
+    return refitter_->refitCudaEngineAsync(cuda_stream);
+#else
+    // the synchronous refit has to be ordered after work already queued on the stream
+    return cudaStreamSynchronize(cuda_stream) == cudaSuccess && refitter_->refitCudaEngine();
+#endif
+}
+
+std::unique_ptr<Refitter> create_refitter(CudaEngine& engine, Logger& logger) noexcept {
+    auto refitter = nvinfer1::createInferRefitter(*engine.get_mut(), logger);
+    if (!refitter) {
+        return nullptr;
+    }
+    return std::make_unique<Refitter>(std::unique_ptr<nvinfer1::IRefitter>(refitter));
+}
+
+} // namespace trt_rs::refitter
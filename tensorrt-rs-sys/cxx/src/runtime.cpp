@@ -1,7 +1,113 @@
+#include <string_view>
 #include "runtime.h"
+#include "tensorrt-rs-sys/src/lib.rs.h"
 
 namespace trt_rs::runtime {
 
+namespace {
+
+class RustStreamReader : public nvinfer1::IStreamReader {
+public:
+    explicit RustStreamReader(StreamReader& reader) : reader_(reader) {}
+
+    int64_t read(void* destination, int64_t nbBytes) noexcept override {
+        auto buffer = rust::Slice<std::uint8_t>(
+            static_cast<std::uint8_t*>(destination), static_cast<std::size_t>(nbBytes));
+        return static_cast<int64_t>(reader_.read(buffer));
+    }
+private:
+    StreamReader& reader_;
+};
+
+class OutputAllocatorAdapter : public nvinfer1::IOutputAllocator {
+public:
+    explicit OutputAllocatorAdapter(rust::Box<RustOutputAllocator> allocator)
+        : allocator_(std::move(allocator)) {}
+
+#if NV_TENSORRT_MAJOR >= 10
+    // reallocateOutput is deprecated from TensorRT 10, which calls this one instead
+    void* reallocateOutputAsync(
+        char const* tensorName, void* currentMemory, uint64_t size, uint64_t alignment,
+        cudaStream_t stream) noexcept override {
+        const auto memory = allocator_->reallocate_output(
+            tensorName, reinterpret_cast<std::size_t>(currentMemory), size, alignment,
+            reinterpret_cast<std::size_t>(stream));
+        return reinterpret_cast<void*>(memory);
+    }
+#else
+    void* reallocateOutput(
+        char const* tensorName, void* currentMemory, uint64_t size, uint64_t alignment) noexcept override {
+        const auto memory = allocator_->reallocate_output(
+            tensorName, reinterpret_cast<std::size_t>(currentMemory), size, alignment, 0);
+        return reinterpret_cast<void*>(memory);
+    }
+#endif
+
+    void notifyShape(char const* tensorName, Dims const& dims) noexcept override {
+        allocator_->notify_shape(
+            tensorName, rust::Slice<const int32_t>(dims.d, static_cast<std::size_t>(dims.nbDims)));
+    }
+private:
+    rust::Box<RustOutputAllocator> allocator_;
+};
+
+rust::Vec<int32_t> dims_to_vec(const Dims& dims) noexcept {
+    auto dims_vec = rust::Vec<int32_t>();
+    dims_vec.reserve(dims.nbDims);
+    for (int32_t i = 0; i < dims.nbDims; ++i) {
+        dims_vec.push_back(dims.d[i]);
+    }
+    return dims_vec;
+}
+
+// Ranks beyond Dims::MAX_DIMS give invalid dims (nbDims = -1), which TensorRT rejects.
+Dims slice_to_dims(rust::Slice<const int32_t> dims) noexcept {
+    Dims dims_trt;
+    if (dims.size() > static_cast<std::size_t>(Dims::MAX_DIMS)) {
+        dims_trt.nbDims = -1;
+        return dims_trt;
+    }
+    const int32_t nb_dims = dims.size();
+    dims_trt.nbDims = nb_dims;
+    for (int32_t i = 0; i < nb_dims; ++i) {
+        dims_trt.d[i] = dims[i];
+    }
+    return dims_trt;
+}
+
+TensorDims to_tensor_dims(const Dims& dims) noexcept {
+    auto tensor_dims = TensorDims();
+    tensor_dims.nb_dims = dims.nbDims;
+    for (int32_t i = 0; i < dims.nbDims && i < static_cast<int32_t>(tensor_dims.d.size()); ++i) {
+        tensor_dims.d[i] = dims.d[i];
+    }
+    return tensor_dims;
+}
+
+// nb_dims is set from Rust; out-of-range ranks give invalid dims instead of reading past d.
+Dims from_tensor_dims(const TensorDims& tensor_dims) noexcept {
+    Dims dims;
+    if (tensor_dims.nb_dims < 0 || tensor_dims.nb_dims > Dims::MAX_DIMS) {
+        dims.nbDims = -1;
+        return dims;
+    }
+    dims.nbDims = tensor_dims.nb_dims;
+    for (int32_t i = 0; i < tensor_dims.nb_dims; ++i) {
+        dims.d[i] = tensor_dims.d[i];
+    }
+    return dims;
+}
+
+// Returned with nb_dims = -1 when a handle does not name an IO tensor, like nvinfer1's
+// invalid Dims.
+TensorDims invalid_tensor_dims() noexcept {
+    auto tensor_dims = TensorDims();
+    tensor_dims.nb_dims = -1;
+    return tensor_dims;
+}
+
+} // namespace
+
 std::unique_ptr<CudaEngine>
 Runtime::deserialize(rust::Slice<const std::uint8_t> data) noexcept {
     auto engine = runtime_->deserializeCudaEngine(data.data(), data.size());
@@ -12,6 +118,17 @@ Runtime::deserialize(rust::Slice<const std::uint8_t> data) noexcept {
     }
 }
 
+std::unique_ptr<CudaEngine>
+Runtime::deserialize_from_stream(StreamReader& reader) noexcept {
+    auto stream_reader = RustStreamReader(reader);
+    auto engine = runtime_->deserializeCudaEngine(stream_reader);
+    if (!engine) {
+        return nullptr;
+    } else {
+        return std::make_unique<CudaEngine>(std::unique_ptr<ICudaEngine>(engine));
+    }
+}
+
 rust::Vec<int32_t> CudaEngine::get_tensor_shape(rust::Str name) const noexcept {
     const auto name_str = std::string(name);
     const auto dims = engine_->getTensorShape(name_str.c_str());
@@ -23,8 +140,67 @@ rust::Vec<int32_t> CudaEngine::get_tensor_shape(rust::Str name) const noexcept {
     return dims_vec;
 }
 
+int32_t CudaEngine::get_tensor_handle(rust::Str name) const noexcept {
+    for (std::size_t i = 0; i < tensor_names_.size(); ++i) {
+        if (std::string_view(tensor_names_[i]) == std::string_view(name.data(), name.size())) {
+            return static_cast<int32_t>(i);
+        }
+    }
+    return -1;
+}
+
+rust::Vec<int32_t> CudaEngine::get_tensor_shape_by_handle(int32_t handle) const noexcept {
+    const auto name = get_tensor_name(tensor_names_, handle);
+    if (!name) {
+        return rust::Vec<int32_t>();
+    }
+    return dims_to_vec(engine_->getTensorShape(name));
+}
+
+TensorDims CudaEngine::get_tensor_dims(rust::Str name) const noexcept {
+    const auto name_str = std::string(name);
+    return to_tensor_dims(engine_->getTensorShape(name_str.c_str()));
+}
+
+TensorDims CudaEngine::get_tensor_dims_by_handle(int32_t handle) const noexcept {
+    const auto name = get_tensor_name(tensor_names_, handle);
+    if (!name) {
+        return invalid_tensor_dims();
+    }
+    return to_tensor_dims(engine_->getTensorShape(name));
+}
+
+TensorDims CudaEngine::get_profile_dims(rust::Str name, int32_t profile, int32_t select) const noexcept {
+    const auto name_str = std::string(name);
+    return to_tensor_dims(engine_->getProfileShape(
+        name_str.c_str(), profile, static_cast<nvinfer1::OptProfileSelector>(select)));
+}
+
+rust::Vec<int32_t> CudaEngine::get_profile_tensor_values(rust::Str name, int32_t profile, int32_t select) const noexcept {
+    rust::Vec<int32_t> values;
+    const auto name_str = std::string(name);
+    if (!engine_->isShapeInferenceIO(name_str.c_str())) {
+        return values;
+    }
+    const auto values_ptr = engine_->getProfileTensorValues(
+        name_str.c_str(), profile, static_cast<nvinfer1::OptProfileSelector>(select));
+    if (!values_ptr) {
+        return values;
+    }
+    // shape tensors are 0-D or 1-D with a build-time length
+    const auto dims = engine_->getTensorShape(name_str.c_str());
+    int64_t count = 1;
+    for (int32_t i = 0; i < dims.nbDims; ++i) {
+        count *= dims.d[i];
+    }
+    for (int64_t i = 0; i < count; ++i) {
+        values.push_back(values_ptr[i]);
+    }
+    return values;
+}
+
 std::unique_ptr<ExecutionContext>
-CudaEngine::create_execution_context() noexcept {
+CudaEngine::create_execution_context() const noexcept {
     auto context = engine_->createExecutionContext();
     if (!context) {
         return nullptr;
@@ -34,7 +210,7 @@ CudaEngine::create_execution_context() noexcept {
 }
 
 std::unique_ptr<ExecutionContext>
-CudaEngine::create_execution_context_without_device_memory() noexcept {
+CudaEngine::create_execution_context_without_device_memory() const noexcept {
     auto context = engine_->createExecutionContextWithoutDeviceMemory();
     if (!context) {
         return nullptr;
@@ -56,13 +232,7 @@ rust::Vec<int32_t> ExecutionContext::get_tensor_strides(rust::Str name) const no
 
 bool ExecutionContext::set_input_shape(rust::Str name, rust::Slice<const int32_t> dims) noexcept {
     const auto name_str = std::string(name);
-    const int32_t nb_dims = dims.size();
-    Dims dims_trt;
-    dims_trt.nbDims = nb_dims;
-    for (int32_t i = 0; i < nb_dims; ++i) {
-        dims_trt.d[i] = dims[i];
-    }
-    return context_->setInputShape(name_str.c_str(), dims_trt);
+    return context_->setInputShape(name_str.c_str(), slice_to_dims(dims));
 }
 
 rust::Vec<int32_t> ExecutionContext::get_tensor_shape(rust::Str name) const noexcept {
@@ -76,10 +246,112 @@ rust::Vec<int32_t> ExecutionContext::get_tensor_shape(rust::Str name) const noex
     return dims_vec;
 }
 
+bool ExecutionContext::set_input_shape_by_handle(
+    int32_t handle, rust::Slice<const int32_t> dims) noexcept {
+    const auto name = get_tensor_name(tensor_names_, handle);
+    return name && context_->setInputShape(name, slice_to_dims(dims));
+}
+
+rust::Vec<int32_t> ExecutionContext::get_tensor_shape_by_handle(int32_t handle) const noexcept {
+    const auto name = get_tensor_name(tensor_names_, handle);
+    if (!name) {
+        return rust::Vec<int32_t>();
+    }
+    return dims_to_vec(context_->getTensorShape(name));
+}
+
+bool ExecutionContext::set_input_dims_by_handle(int32_t handle, const TensorDims& dims) noexcept {
+    const auto name = get_tensor_name(tensor_names_, handle);
+    return name && context_->setInputShape(name, from_tensor_dims(dims));
+}
+
+TensorDims ExecutionContext::get_tensor_dims(rust::Str name) const noexcept {
+    const auto name_str = std::string(name);
+    return to_tensor_dims(context_->getTensorShape(name_str.c_str()));
+}
+
+TensorDims ExecutionContext::get_tensor_dims_by_handle(int32_t handle) const noexcept {
+    const auto name = get_tensor_name(tensor_names_, handle);
+    if (!name) {
+        return invalid_tensor_dims();
+    }
+    return to_tensor_dims(context_->getTensorShape(name));
+}
+
+TensorDims ExecutionContext::get_tensor_stride_dims(rust::Str name) const noexcept {
+    const auto name_str = std::string(name);
+    return to_tensor_dims(context_->getTensorStrides(name_str.c_str()));
+}
+
+bool ExecutionContext::set_output_allocator(
+    rust::Str name, rust::Box<RustOutputAllocator> allocator) noexcept {
+    auto name_str = std::string(name);
+    auto adapter = std::make_unique<OutputAllocatorAdapter>(std::move(allocator));
+    if (!context_->setOutputAllocator(name_str.c_str(), adapter.get())) {
+        return false;
+    }
+    output_allocators_[std::move(name_str)] = std::move(adapter);
+    return true;
+}
+
 bool ExecutionContext::enqueue_v3(std::size_t stream) noexcept {
     return context_->enqueueV3(reinterpret_cast<cudaStream_t>(stream));
 }
 
+BindingStatus ExecutionContext::apply_bindings(rust::Slice<const TensorBinding> bindings) noexcept {
+    for (std::size_t i = 0; i < bindings.size(); ++i) {
+        const auto& binding = bindings[i];
+        const auto index = static_cast<int32_t>(i);
+        const auto name = get_tensor_name(tensor_names_, binding.handle);
+        if (!name) {
+            return BindingStatus{index, BindingError::ADDRESS};
+        }
+        if (binding.dims.nb_dims >= 0 && !context_->setInputShape(name, from_tensor_dims(binding.dims))) {
+            return BindingStatus{index, BindingError::SHAPE};
+        }
+        if (binding.capacity >= 0) {
+            const auto dims = context_->getTensorShape(name);
+            int64_t volume = 1;
+            for (int32_t d = 0; d < dims.nbDims; ++d) {
+                volume = dims.d[d] < 0 ? -1 : volume * dims.d[d];
+                if (volume < 0) {
+                    break;
+                }
+            }
+            if (dims.nbDims < 0 || volume < 0 || volume > binding.capacity) {
+                return BindingStatus{index, BindingError::CAPACITY};
+            }
+        }
+        if (binding.address != 0 && !context_->setTensorAddress(name, reinterpret_cast<void*>(binding.address))) {
+            return BindingStatus{index, BindingError::ADDRESS};
+        }
+    }
+    return BindingStatus{-1, BindingError::NONE};
+}
+
+BindingStatus ExecutionContext::apply_bindings_and_enqueue(
+    rust::Slice<const TensorBinding> bindings, std::size_t stream) noexcept {
+    const auto status = apply_bindings(bindings);
+    if (status.error != BindingError::NONE) {
+        return status;
+    }
+    if (!context_->enqueueV3(reinterpret_cast<cudaStream_t>(stream))) {
+        return BindingStatus{-1, BindingError::ENQUEUE};
+    }
+    return status;
+}
+
+void ExecutionContext::get_tensor_dims_many(
+    rust::Slice<const int32_t> handles, rust::Slice<TensorDims> dims) const noexcept {
+    for (std::size_t i = 0; i < handles.size() && i < dims.size(); ++i) {
+        dims[i] = get_tensor_dims_by_handle(handles[i]);
+    }
+}
+
+bool EngineInspector::set_execution_context(const ExecutionContext& context) noexcept {
+    return inspector_->setExecutionContext(context.get());
+}
+
 std::unique_ptr<Runtime> create_runtime(Logger& logger) {
     auto runtime = nvinfer1::createInferRuntime(logger);
     if (!runtime) {
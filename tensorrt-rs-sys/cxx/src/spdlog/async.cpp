@@ -0,0 +1,8 @@
+#ifndef SPDLOG_COMPILED_LIB
+#error Please define SPDLOG_COMPILED_LIB to compile this file.
+#endif
+
+#include <spdlog/async.h>
+#include <spdlog/async_logger-inl.h>
+#include <spdlog/details/periodic_worker-inl.h>
+#include <spdlog/details/thread_pool-inl.h>
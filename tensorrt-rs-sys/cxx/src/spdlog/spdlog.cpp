@@ -0,0 +1,23 @@
+// Everything of spdlog the logger uses, compiled once for TRT_RS_SPDLOG=compiled; see build.rs.
+#ifndef SPDLOG_COMPILED_LIB
+#error Please define SPDLOG_COMPILED_LIB to compile this file.
+#endif
+
+#include <mutex>
+#include <spdlog/spdlog-inl.h>
+#include <spdlog/common-inl.h>
+#include <spdlog/details/backtracer-inl.h>
+#include <spdlog/details/registry-inl.h>
+#include <spdlog/details/os-inl.h>
+#include <spdlog/pattern_formatter-inl.h>
+#include <spdlog/details/log_msg-inl.h>
+#include <spdlog/details/log_msg_buffer-inl.h>
+#include <spdlog/logger-inl.h>
+#include <spdlog/sinks/sink-inl.h>
+#include <spdlog/sinks/base_sink-inl.h>
+#include <spdlog/details/null_mutex.h>
+
+template SPDLOG_API spdlog::logger::logger(
+    std::string name, sinks_init_list::iterator begin, sinks_init_list::iterator end);
+template class SPDLOG_API spdlog::sinks::base_sink<std::mutex>;
+template class SPDLOG_API spdlog::sinks::base_sink<spdlog::details::null_mutex>;
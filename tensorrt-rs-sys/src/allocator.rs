@@ -0,0 +1,63 @@
+use crate::ffi;
+use cxx::UniquePtr;
+
+// Rust-implementable IGpuAllocator. TensorRT may call it from several threads at once.
+// Addresses are device pointers; 0 signals an allocation failure.
+pub trait GpuAllocator: Send + Sync {
+    fn allocate(&self, size: u64, alignment: u64, flags: u32) -> usize;
+
+    fn deallocate(&self, memory: usize) -> bool;
+
+    fn allocate_async(&self, size: u64, alignment: u64, flags: u32, _stream: usize) -> usize {
+        self.allocate(size, alignment, flags)
+    }
+
+    fn deallocate_async(&self, memory: usize, _stream: usize) -> bool {
+        self.deallocate(memory)
+    }
+}
+
+pub struct RustGpuAllocator(Box<dyn GpuAllocator>);
+
+impl RustGpuAllocator {
+    pub(crate) fn allocate(&self, size: u64, alignment: u64, flags: u32) -> usize {
+        self.0.allocate(size, alignment, flags)
+    }
+
+    pub(crate) fn deallocate(&self, memory: usize) -> bool {
+        self.0.deallocate(memory)
+    }
+
+    pub(crate) fn allocate_async(&self, size: u64, alignment: u64, flags: u32, stream: usize) -> usize {
+        self.0.allocate_async(size, alignment, flags, stream)
+    }
+
+    pub(crate) fn deallocate_async(&self, memory: usize, stream: usize) -> bool {
+        self.0.deallocate_async(memory, stream)
+    }
+}
+
+// An allocator that can be installed on a Runtime (all engine allocations) and on any
+// number of execution contexts (temporary storage during enqueue).
+pub struct DeviceAllocator(pub(crate) UniquePtr<ffi::GpuAllocator>);
+
+unsafe impl Send for DeviceAllocator {}
+unsafe impl Sync for DeviceAllocator {}
+
+impl DeviceAllocator {
+    pub fn new<A: GpuAllocator + 'static>(allocator: A) -> Self {
+        let allocator = Box::new(RustGpuAllocator(Box::new(allocator)));
+        Self(ffi::create_rust_gpu_allocator(allocator))
+    }
+
+    // Stream-ordered pool (cudaMallocFromPoolAsync) on `device`. Freed memory is kept in
+    // the pool until it exceeds `release_threshold` bytes.
+    pub fn mem_pool(device: i32, release_threshold: u64) -> Option<Self> {
+        let allocator = ffi::create_mem_pool_allocator(device, release_threshold);
+        if allocator.is_null() {
+            None
+        } else {
+            Some(Self(allocator))
+        }
+    }
+}
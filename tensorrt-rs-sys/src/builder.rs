@@ -0,0 +1,382 @@
+use crate::{
+    ffi,
+    logger::Logger,
+    runtime::{HardwareCompatibilityLevel, OptProfileSelector, ProfilingVerbosity, TensorDims},
+};
+use cxx::UniquePtr;
+use std::{marker::PhantomData, ops::Deref};
+
+// The values are this crate's own: TensorRT 10 renumbered its flags, so builder.cpp maps
+// them to TensorRT's by name.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum BuilderFlag {
+    // Enable FP16 layer selection, with FP32 fallback.
+    FP16 = 0,
+    // Enable INT8 layer selection, with FP32 fallback (FP16 too if FP16 is set).
+    INT8 = 1,
+    // Enable debug output after every layer.
+    DEBUG = 2,
+    // Enable layers marked to execute on GPU if the layer cannot execute on DLA.
+    GPUFALLBACK = 3,
+    // Enable building a refittable engine.
+    REFIT = 5,
+    // Disable reuse of timing information across identical layers.
+    DISABLETIMINGCACHE = 6,
+    // Allow TF32 for FP32 convolutions and matmuls (on by default).
+    TF32 = 7,
+    // Allow the builder to examine weights and use optimized functions when weights have
+    // suitable sparsity.
+    SPARSEWEIGHTS = 8,
+    // Require that layers execute in specified precisions. Build fails otherwise.
+    OBEYPRECISIONCONSTRAINTS = 10,
+    // Prefer that layers execute in specified precisions. Fall back (with warning) otherwise.
+    PREFERPRECISIONCONSTRAINTS = 11,
+    // Require that no reformats be inserted between a layer and a network I/O tensor.
+    DIRECTIO = 12,
+    // Restrict to lean runtime operators to provide version forward compatibility.
+    VERSIONCOMPATIBLE = 14,
+    // With VERSIONCOMPATIBLE, leave the lean runtime out of the plan; it is loaded with
+    // Runtime::load_lean_runtime instead.
+    EXCLUDELEANRUNTIME = 15,
+    // Enable FP8 layer selection, with FP32 fallback.
+    FP8 = 16,
+    // Emit an error when a tactic being timed is not in the timing cache.
+    ERRORONTIMINGCACHEMISS = 17,
+    // Leave the refittable weights out of the plan; they are refit after deserialization.
+    STRIPPLAN = 20,
+    // With STRIPPLAN, the weights refit are the ones built with, so the builder may still
+    // optimize for their values.
+    REFITIDENTICAL = 21,
+    // Build an engine whose weights can be streamed from host memory at run time.
+    WEIGHTSTREAMING = 22,
+}
+
+// Where layers execute unless set per layer.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum DeviceType {
+    GPU = 0,
+    DLA = 1,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum MemoryPoolType {
+    // Workspace memory available to tactics; defaults to the device's global memory size.
+    WORKSPACE = 0,
+    // Fast software managed RAM used by DLA to communicate within a layer.
+    DLAMANAGEDSRAM = 1,
+    // Host RAM used by DLA to share intermediate tensor data across operations.
+    DLALOCALDRAM = 2,
+    // Host RAM used by DLA to store weights and metadata for execution.
+    DLAGLOBALDRAM = 3,
+    // Host RAM used by the builder to store weights during the build.
+    TACTICDRAM = 4,
+}
+
+// Rust-implementable INT8 entropy calibrator (IInt8EntropyCalibrator2), driven by the
+// builder from its own thread during the build.
+pub trait Int8Calibrator: Send {
+    fn batch_size(&self) -> i32;
+
+    // Uploads the next batch to the device; false once the calibration data is exhausted.
+    // TensorRT reads the batch as soon as this returns, so the upload must be complete.
+    fn next_batch(&mut self) -> bool;
+
+    // Device address of input `name` in the current batch, 0 if unknown.
+    fn get_binding(&self, name: &str) -> usize;
+
+    // A cache written by write_cache in an earlier build; when non-empty, calibration is
+    // skipped and next_batch is never called.
+    fn read_cache(&mut self) -> Vec<u8> {
+        Vec::new()
+    }
+
+    fn write_cache(&mut self, _cache: &[u8]) {}
+}
+
+pub struct RustCalibrator(Box<dyn Int8Calibrator>);
+
+impl RustCalibrator {
+    pub(crate) fn batch_size(&self) -> i32 {
+        self.0.batch_size()
+    }
+
+    pub(crate) fn next_batch(&mut self) -> bool {
+        self.0.next_batch()
+    }
+
+    pub(crate) fn get_binding(&self, name: &str) -> usize {
+        self.0.get_binding(name)
+    }
+
+    pub(crate) fn read_cache(&mut self) -> Vec<u8> {
+        self.0.read_cache()
+    }
+
+    pub(crate) fn write_cache(&mut self, cache: &[u8]) {
+        self.0.write_cache(cache)
+    }
+}
+
+// Serialized engine or timing cache owned by TensorRT.
+pub struct HostMemory(pub(crate) UniquePtr<ffi::HostMemory>);
+
+unsafe impl Send for HostMemory {}
+
+impl HostMemory {
+    pub fn as_slice(&self) -> &[u8] {
+        self.0.data()
+    }
+}
+
+impl Deref for HostMemory {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        self.as_slice()
+    }
+}
+
+// Kernel timings measured by the builder. Configs it is set on record new timings into it
+// during the build, so one cache serialized after each build accumulates across builds.
+pub struct TimingCache(UniquePtr<ffi::TimingCache>);
+
+unsafe impl Send for TimingCache {}
+
+impl TimingCache {
+    pub fn serialize(&self) -> Option<HostMemory> {
+        let memory = self.0.serialize();
+        if memory.is_null() {
+            None
+        } else {
+            Some(HostMemory(memory))
+        }
+    }
+
+    // Merges entries of `other`, e.g. a cache produced by another build host.
+    pub fn combine(&mut self, other: &TimingCache, ignore_mismatch: bool) -> bool {
+        self.0.pin_mut().combine(&other.0, ignore_mismatch)
+    }
+
+    pub fn reset(&mut self) -> bool {
+        self.0.pin_mut().reset()
+    }
+}
+
+pub struct OptimizationProfile<'a> {
+    profile: UniquePtr<ffi::OptimizationProfile>,
+    _builder: PhantomData<&'a Builder>,
+}
+
+impl OptimizationProfile<'_> {
+    pub fn set_dimensions(&mut self, input: &str, select: OptProfileSelector, dims: &[i32]) -> bool {
+        self.profile.pin_mut().set_dimensions(input, select as i32, &TensorDims::new(dims))
+    }
+
+    // Values for shape-tensor inputs.
+    pub fn set_shape_values(&mut self, input: &str, select: OptProfileSelector, values: &[i32]) -> bool {
+        self.profile.pin_mut().set_shape_values(input, select as i32, values)
+    }
+
+    pub fn is_valid(&self) -> bool {
+        self.profile.is_valid()
+    }
+}
+
+pub struct BuilderConfig<'a> {
+    config: UniquePtr<ffi::BuilderConfig>,
+    _builder: PhantomData<&'a Builder>,
+}
+
+impl BuilderConfig<'_> {
+    // False if the linked TensorRT has no such flag to set; clearing one always succeeds.
+    pub fn set_flag(&mut self, flag: BuilderFlag, enabled: bool) -> bool {
+        self.config.pin_mut().set_flag(flag as i32, enabled)
+    }
+
+    pub fn get_flag(&self, flag: BuilderFlag) -> bool {
+        self.config.get_flag(flag as i32)
+    }
+
+    pub fn set_memory_pool_limit(&mut self, pool: MemoryPoolType, size: usize) {
+        self.config.pin_mut().set_memory_pool_limit(pool as i32, size)
+    }
+
+    // 0 (fastest build) to 5 (most tactics tried); 3 by default.
+    pub fn set_builder_optimization_level(&mut self, level: i32) {
+        self.config.pin_mut().set_builder_optimization_level(level)
+    }
+
+    pub fn set_profiling_verbosity(&mut self, verbosity: ProfilingVerbosity) {
+        self.config.pin_mut().set_profiling_verbosity(verbosity as i32)
+    }
+
+    // GPU architectures other than the builder's that the engine must run on.
+    pub fn set_hardware_compatibility_level(&mut self, level: HardwareCompatibilityLevel) {
+        self.config.pin_mut().set_hardware_compatibility_level(level as i32)
+    }
+
+    pub fn set_avg_timing_iterations(&mut self, iterations: i32) {
+        self.config.pin_mut().set_avg_timing_iterations(iterations)
+    }
+
+    pub fn set_default_device_type(&mut self, device_type: DeviceType) {
+        self.config.pin_mut().set_default_device_type(device_type as i32)
+    }
+
+    // DLA core the layers placed on DLA run on; the runtime may load the engine onto another.
+    pub fn set_dla_core(&mut self, core: i32) {
+        self.config.pin_mut().set_dla_core(core)
+    }
+
+    // Index of the profile in the built engine, or -1 if it is invalid.
+    pub fn add_optimization_profile(&mut self, profile: &OptimizationProfile) -> i32 {
+        self.config.pin_mut().add_optimization_profile(&profile.profile)
+    }
+
+    // A timing cache from a serialized blob, or empty when `blob` is empty.
+    pub fn create_timing_cache(&self, blob: &[u8]) -> Option<TimingCache> {
+        let cache = self.config.create_timing_cache(blob);
+        if cache.is_null() {
+            None
+        } else {
+            Some(TimingCache(cache))
+        }
+    }
+
+    // Used for INT8 builds without explicit quantization; the config owns the calibrator.
+    pub fn set_int8_calibrator(&mut self, calibrator: Box<dyn Int8Calibrator>) {
+        let calibrator = ffi::create_int8_calibrator(Box::new(RustCalibrator(calibrator)));
+        self.config.pin_mut().set_int8_calibrator(calibrator)
+    }
+
+    // The config keeps the cache alive; the builder adds new timings to it in place.
+    // With `ignore_mismatch`, a cache recorded on a different device or TensorRT version
+    // is accepted (its timings may not reflect this device).
+    pub fn set_timing_cache(&mut self, cache: &TimingCache, ignore_mismatch: bool) -> bool {
+        self.config.pin_mut().set_timing_cache(&cache.0, ignore_mismatch)
+    }
+}
+
+// An explicit-batch network definition and the ONNX parser that populates it.
+pub struct NetworkDefinition<'a> {
+    network: UniquePtr<ffi::NetworkDefinition>,
+    _builder: PhantomData<&'a Builder>,
+}
+
+impl NetworkDefinition<'_> {
+    pub fn parse(&mut self, model: &[u8]) -> bool {
+        self.network.pin_mut().parse(model)
+    }
+
+    // External weight files are resolved relative to `path`.
+    pub fn parse_from_file(&mut self, path: &str, verbosity: i32) -> bool {
+        self.network.pin_mut().parse_from_file(path, verbosity)
+    }
+
+    pub fn get_parser_errors(&self) -> Vec<String> {
+        self.network.get_parser_errors()
+    }
+
+    pub fn get_nb_inputs(&self) -> i32 {
+        self.network.get_nb_inputs()
+    }
+
+    pub fn get_nb_outputs(&self) -> i32 {
+        self.network.get_nb_outputs()
+    }
+
+    pub fn get_input_name(&self, index: i32) -> String {
+        self.network.get_input_name(index)
+    }
+
+    pub fn get_output_name(&self, index: i32) -> String {
+        self.network.get_output_name(index)
+    }
+
+    // -1 marks dynamic dimensions.
+    pub fn get_input_dims(&self, index: i32) -> TensorDims {
+        self.network.get_input_dims(index)
+    }
+}
+
+pub struct Builder {
+    // declared first so that it is dropped before the logger
+    builder: UniquePtr<ffi::Builder>,
+    logger: Logger,
+}
+
+unsafe impl Send for Builder {}
+
+impl Builder {
+    pub fn new() -> Option<Self> {
+        let mut logger = Logger::new();
+        let builder = ffi::create_builder(logger.0.pin_mut());
+        if builder.is_null() {
+            None
+        } else {
+            Some(Self { builder, logger })
+        }
+    }
+
+    pub fn logger(&mut self) -> &mut Logger {
+        &mut self.logger
+    }
+
+    pub fn create_onnx_network(&self) -> Option<NetworkDefinition<'_>> {
+        let network = self.builder.create_onnx_network();
+        if network.is_null() {
+            None
+        } else {
+            Some(NetworkDefinition { network, _builder: PhantomData })
+        }
+    }
+
+    pub fn create_builder_config(&self) -> Option<BuilderConfig<'_>> {
+        let config = self.builder.create_builder_config();
+        if config.is_null() {
+            None
+        } else {
+            Some(BuilderConfig { config, _builder: PhantomData })
+        }
+    }
+
+    pub fn create_optimization_profile(&self) -> Option<OptimizationProfile<'_>> {
+        let profile = self.builder.create_optimization_profile();
+        if profile.is_null() {
+            None
+        } else {
+            Some(OptimizationProfile { profile, _builder: PhantomData })
+        }
+    }
+
+    // Builds and serializes the network; deserialize the result with Runtime::deserialize.
+    pub fn build_serialized_network(
+        &self,
+        network: &mut NetworkDefinition,
+        config: &mut BuilderConfig,
+    ) -> Option<HostMemory> {
+        let plan = self.builder.build_serialized_network(network.network.pin_mut(), config.config.pin_mut());
+        if plan.is_null() {
+            None
+        } else {
+            Some(HostMemory(plan))
+        }
+    }
+
+    pub fn platform_has_fast_fp16(&self) -> bool {
+        self.builder.platform_has_fast_fp16()
+    }
+
+    pub fn platform_has_fast_int8(&self) -> bool {
+        self.builder.platform_has_fast_int8()
+    }
+
+    pub fn set_max_threads(&mut self, threads: i32) -> bool {
+        self.builder.pin_mut().set_max_threads(threads)
+    }
+
+    // 0 on devices without DLA, 2 on Orin AGX and Xavier.
+    pub fn get_nb_dla_cores(&self) -> i32 {
+        self.builder.get_nb_dla_cores()
+    }
+}
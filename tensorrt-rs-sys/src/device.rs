@@ -0,0 +1,112 @@
+use crate::ffi;
+
+// The calling thread's current CUDA device.
+pub fn get_device() -> Option<i32> {
+    match ffi::get_device() {
+        device if device >= 0 => Some(device),
+        _ => None,
+    }
+}
+
+// Binds the device's primary context to the calling thread, as cudaSetDevice.
+pub fn set_device(device: i32) -> bool {
+    ffi::set_device(device)
+}
+
+pub fn get_device_count() -> i32 {
+    ffi::get_device_count()
+}
+
+// major * 10 + minor, e.g. 86 for sm_86.
+pub fn get_compute_capability(device: i32) -> Option<i32> {
+    match ffi::get_compute_capability(device) {
+        capability if capability >= 0 => Some(capability),
+        _ => None,
+    }
+}
+
+pub fn get_device_name(device: i32) -> String {
+    ffi::get_device_name(device)
+}
+
+pub fn get_pci_bus_id(device: i32) -> String {
+    ffi::get_pci_bus_id(device)
+}
+
+// True for GPUs sharing DRAM with the host (Jetson), where host-mapped memory needs no copies.
+pub fn is_integrated(device: i32) -> bool {
+    ffi::is_integrated(device)
+}
+
+// Bytes of L2 that can be set aside for persisting accesses; 0 before Ampere.
+pub fn get_max_persisting_l2_cache_size(device: i32) -> usize {
+    ffi::get_max_persisting_l2_cache_size(device).max(0) as usize
+}
+
+// Largest num_bytes of a stream access policy window.
+pub fn get_max_access_policy_window_size(device: i32) -> usize {
+    ffi::get_max_access_policy_window_size(device).max(0) as usize
+}
+
+pub fn get_l2_cache_size(device: i32) -> usize {
+    ffi::get_l2_cache_size(device).max(0) as usize
+}
+
+// Sets the persisting L2 set-aside of the current device. Device-wide: it is shared by
+// every stream and context on the device.
+pub fn set_persisting_l2_cache_limit(size: usize) -> bool {
+    ffi::set_persisting_l2_cache_limit(size)
+}
+
+pub fn reset_persisting_l2_cache() -> bool {
+    ffi::reset_persisting_l2_cache()
+}
+
+// (free, total) bytes of the current device's memory.
+pub fn get_mem_info() -> Option<(usize, usize)> {
+    let (mut free, mut total) = (0, 0);
+    match ffi::get_mem_info(&mut free, &mut total) {
+        true => Some((free, total)),
+        false => None,
+    }
+}
+
+// A retained reference to a device's primary context, the one the runtime API and so
+// TensorRT use, released on drop.
+pub struct PrimaryContext {
+    device: i32,
+    ctx: usize,
+}
+
+unsafe impl Send for PrimaryContext {}
+unsafe impl Sync for PrimaryContext {}
+
+impl PrimaryContext {
+    pub fn retain(device: i32) -> Option<Self> {
+        match ffi::retain_primary_context(device) {
+            0 => None,
+            ctx => Some(Self { device, ctx }),
+        }
+    }
+
+    // The primary context of the calling thread's current device.
+    pub fn current() -> Option<Self> {
+        Self::retain(get_device()?)
+    }
+
+    pub fn device(&self) -> i32 {
+        self.device
+    }
+
+    // Makes the context current on the calling thread, unless it already is, and leaves it
+    // current.
+    pub fn make_current(&self) -> bool {
+        ffi::make_context_current(self.ctx)
+    }
+}
+
+impl Drop for PrimaryContext {
+    fn drop(&mut self) {
+        ffi::release_primary_context(self.device);
+    }
+}
@@ -0,0 +1,104 @@
+use crate::ffi;
+use cxx::UniquePtr;
+
+pub use crate::ffi::RecordedError;
+
+// nvinfer1::ErrorCode
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum ErrorCode {
+    Success = 0,
+    UnspecifiedError = 1,
+    InternalError = 2,
+    InvalidArgument = 3,
+    InvalidConfig = 4,
+    FailedAllocation = 5,
+    FailedInitialization = 6,
+    FailedExecution = 7,
+    FailedComputation = 8,
+    InvalidState = 9,
+    UnsupportedState = 10,
+}
+
+impl ErrorCode {
+    pub fn from_i32(code: i32) -> Self {
+        match code {
+            0 => Self::Success,
+            2 => Self::InternalError,
+            3 => Self::InvalidArgument,
+            4 => Self::InvalidConfig,
+            5 => Self::FailedAllocation,
+            6 => Self::FailedInitialization,
+            7 => Self::FailedExecution,
+            8 => Self::FailedComputation,
+            9 => Self::InvalidState,
+            10 => Self::UnsupportedState,
+            _ => Self::UnspecifiedError,
+        }
+    }
+
+    // Errors a later attempt with the same input may not hit: memory pressure, or a failed
+    // execution (after which the context should be recreated). Invalid arguments, configs
+    // and states fail again.
+    pub fn is_transient(&self) -> bool {
+        matches!(self, Self::FailedAllocation | Self::FailedExecution)
+    }
+}
+
+impl RecordedError {
+    pub fn error_code(&self) -> ErrorCode {
+        ErrorCode::from_i32(self.code)
+    }
+}
+
+// IErrorRecorder keeping the last errors TensorRT reports for the runtime, engine or
+// contexts it is attached to, e.g. why an enqueue failed, without parsing the log. Reports
+// go into a lock-free ring, so it costs nothing on the enqueue path while no error occurs.
+pub struct ErrorRecorder(pub(crate) UniquePtr<ffi::ErrorRecorder>);
+
+unsafe impl Send for ErrorRecorder {}
+unsafe impl Sync for ErrorRecorder {}
+
+impl ErrorRecorder {
+    // Keeps the last `capacity` errors; older ones are dropped and has_overflowed is set.
+    pub fn new(capacity: usize) -> Self {
+        Self(ffi::create_error_recorder(capacity))
+    }
+
+    pub fn num_errors(&self) -> usize {
+        self.0.num_errors().max(0) as usize
+    }
+
+    pub fn has_overflowed(&self) -> bool {
+        self.0.has_overflowed()
+    }
+
+    // The recorded errors, oldest first; the recorder is empty afterwards.
+    pub fn take_errors(&self) -> Vec<RecordedError> {
+        self.0.take_errors()
+    }
+
+    pub fn clear(&self) {
+        self.0.clear()
+    }
+}
+
+impl Default for ErrorRecorder {
+    fn default() -> Self {
+        Self::new(64)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn error_codes_round_trip() {
+        for code in 0..=10 {
+            assert_eq!(ErrorCode::from_i32(code) as i32, code);
+        }
+        assert_eq!(ErrorCode::from_i32(42), ErrorCode::UnspecifiedError);
+        assert!(ErrorCode::FailedAllocation.is_transient());
+        assert!(!ErrorCode::InvalidArgument.is_transient());
+    }
+}
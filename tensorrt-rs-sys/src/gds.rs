@@ -0,0 +1,65 @@
+use crate::ffi;
+use cxx::UniquePtr;
+use std::path::Path;
+
+// Whether reads can go from storage to device memory with cuFile: built with the gds
+// feature, and the nvidia-fs driver loaded.
+pub fn is_available() -> bool {
+    ffi::gds_available()
+}
+
+// A file registered with cuFile for GPUDirect Storage reads.
+pub struct GdsFile(UniquePtr<ffi::GdsFile>);
+
+unsafe impl Send for GdsFile {}
+unsafe impl Sync for GdsFile {}
+
+impl GdsFile {
+    // None without GDS, or when the file system does not take direct IO.
+    pub fn open<P: AsRef<Path>>(path: &P) -> Option<Self> {
+        let file = ffi::open_gds_file(path.as_ref().to_str()?);
+        if file.is_null() {
+            None
+        } else {
+            Some(Self(file))
+        }
+    }
+
+    // Reads `size` bytes at `offset` into device memory at `ptr`, synchronously. Returns the
+    // bytes read, fewer at the end of the file.
+    pub fn read(&self, ptr: usize, size: usize, offset: usize) -> Option<usize> {
+        match self.0.read(ptr, size, offset) {
+            n if n < 0 => None,
+            n => Some(n as usize),
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.0.size()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.0.size() == 0
+    }
+}
+
+// Registers device memory as a cuFile DMA target for as long as it lives, so the reads into
+// it skip cuFile's internal bounce buffers. Must be dropped before the memory is freed.
+pub struct GdsBuffer {
+    ptr: usize,
+}
+
+impl GdsBuffer {
+    pub fn register(ptr: usize, size: usize) -> Option<Self> {
+        match ffi::register_gds_buffer(ptr, size) {
+            true => Some(Self { ptr }),
+            false => None,
+        }
+    }
+}
+
+impl Drop for GdsBuffer {
+    fn drop(&mut self) {
+        ffi::deregister_gds_buffer(self.ptr);
+    }
+}
@@ -0,0 +1,62 @@
+use crate::ffi;
+use cuda_rs::stream::CuStream;
+
+pub fn begin_capture(stream: &CuStream) -> bool {
+    let stream_raw = unsafe { stream.get_raw() };
+    ffi::begin_capture(stream_raw as _)
+}
+
+pub fn end_capture(stream: &CuStream) -> Option<CudaGraph> {
+    let stream_raw = unsafe { stream.get_raw() };
+    match ffi::end_capture(stream_raw as _) {
+        0 => None,
+        graph => Some(CudaGraph(graph)),
+    }
+}
+
+pub struct CudaGraph(usize);
+
+impl CudaGraph {
+    pub fn instantiate(&self) -> Option<CudaGraphExec> {
+        match ffi::instantiate_graph(self.0) {
+            0 => None,
+            exec => Some(CudaGraphExec(exec)),
+        }
+    }
+
+    pub unsafe fn get_raw(&self) -> usize {
+        self.0
+    }
+}
+
+impl Drop for CudaGraph {
+    fn drop(&mut self) {
+        ffi::destroy_graph(self.0);
+    }
+}
+
+pub struct CudaGraphExec(usize);
+
+impl CudaGraphExec {
+    pub fn launch(&self, stream: &CuStream) -> bool {
+        let stream_raw = unsafe { stream.get_raw() };
+        ffi::launch_graph(self.0, stream_raw as _)
+    }
+
+    // Takes over the parameters of `graph`, recorded from the same work with other addresses,
+    // which is far cheaper than instantiating it; false if the work differs, e.g. in its
+    // kernels, and the executable needs instantiating again.
+    pub fn update(&self, graph: &CudaGraph) -> bool {
+        ffi::update_graph_exec(self.0, graph.0)
+    }
+
+    pub unsafe fn get_raw(&self) -> usize {
+        self.0
+    }
+}
+
+impl Drop for CudaGraphExec {
+    fn drop(&mut self) {
+        ffi::destroy_graph_exec(self.0);
+    }
+}
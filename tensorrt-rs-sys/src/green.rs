@@ -0,0 +1,59 @@
+use crate::{ffi, stream::CudaStream};
+use cxx::UniquePtr;
+
+// Whether SMs can be split between green contexts: built against CUDA 12.4 or later, on a
+// driver as recent.
+pub fn is_supported() -> bool {
+    ffi::green_contexts_supported()
+}
+
+// A context confined to a group of SMs. Work on its streams only runs on those SMs, and it
+// shares memory with the device's primary context.
+pub struct GreenContext(UniquePtr<ffi::GreenContext>);
+
+unsafe impl Send for GreenContext {}
+unsafe impl Sync for GreenContext {}
+
+impl GreenContext {
+    // A non-blocking stream whose kernels run on the green context's SMs.
+    pub fn create_stream(&self, priority: i32) -> Option<CudaStream> {
+        CudaStream::from_raw(self.0.create_stream(priority), priority)
+    }
+
+    pub fn sm_count(&self) -> u32 {
+        self.0.sm_count()
+    }
+}
+
+// Splits a device's SMs into disjoint green contexts.
+pub struct SmPartitioner(UniquePtr<ffi::SmPartitioner>);
+
+unsafe impl Send for SmPartitioner {}
+
+impl SmPartitioner {
+    // None without green contexts.
+    pub fn new(device: i32) -> Option<Self> {
+        let partitioner = ffi::create_sm_partitioner(device);
+        if partitioner.is_null() {
+            None
+        } else {
+            Some(Self(partitioner))
+        }
+    }
+
+    // A green context of at least `sm_count` SMs, rounded up to the device's granularity
+    // (e.g. 8 SMs on Hopper), taken from the ones still free. None once fewer remain.
+    pub fn take(&mut self, sm_count: u32) -> Option<GreenContext> {
+        let context = self.0.pin_mut().take(sm_count);
+        if context.is_null() {
+            None
+        } else {
+            Some(GreenContext(context))
+        }
+    }
+
+    // SMs not taken yet.
+    pub fn remaining(&self) -> u32 {
+        self.0.remaining()
+    }
+}
@@ -0,0 +1,84 @@
+use crate::ffi;
+
+pub const IPC_HANDLE_SIZE: usize = 64;
+
+// cudaIpcMemHandle_t: names device memory of one process to the others on the host.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub struct IpcMemHandle(pub [u8; IPC_HANDLE_SIZE]);
+
+// cudaIpcEventHandle_t of an interprocess CudaEvent.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub struct IpcEventHandle(pub [u8; IPC_HANDLE_SIZE]);
+
+// Device memory in an allocation of its own, which other processes can map through its
+// IpcMemHandle. It stays allocated while they have it open, until this process frees it.
+pub struct ShareableMemory {
+    ptr: usize,
+    size: usize,
+}
+
+unsafe impl Send for ShareableMemory {}
+unsafe impl Sync for ShareableMemory {}
+
+impl ShareableMemory {
+    pub fn new(size: usize) -> Option<Self> {
+        match ffi::alloc_shareable(size.max(1)) {
+            0 => None,
+            ptr => Some(Self { ptr, size }),
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.size
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.size == 0
+    }
+
+    pub fn get_raw(&self) -> usize {
+        self.ptr
+    }
+
+    pub fn ipc_handle(&self) -> Option<IpcMemHandle> {
+        let mut handle = [0u8; IPC_HANDLE_SIZE];
+        match ffi::get_mem_handle(self.ptr, &mut handle) {
+            true => Some(IpcMemHandle(handle)),
+            false => None,
+        }
+    }
+}
+
+impl Drop for ShareableMemory {
+    fn drop(&mut self) {
+        ffi::free_shareable(self.ptr);
+    }
+}
+
+// Device memory of another process, mapped into this one until dropped. A handle can be
+// opened once per process and device.
+pub struct IpcMemory {
+    ptr: usize,
+}
+
+unsafe impl Send for IpcMemory {}
+unsafe impl Sync for IpcMemory {}
+
+impl IpcMemory {
+    pub fn open(handle: &IpcMemHandle) -> Option<Self> {
+        match ffi::open_mem_handle(&handle.0) {
+            0 => None,
+            ptr => Some(Self { ptr }),
+        }
+    }
+
+    pub fn get_raw(&self) -> usize {
+        self.ptr
+    }
+}
+
+impl Drop for IpcMemory {
+    fn drop(&mut self) {
+        ffi::close_mem_handle(self.ptr);
+    }
+}
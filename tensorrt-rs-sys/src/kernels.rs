@@ -0,0 +1,359 @@
+use crate::{ffi, runtime::DataType};
+use cuda_rs::stream::CuStream;
+
+// Fused bilinear resize, per-channel `pixel * scale + bias`, HWC to CHW transpose and optional
+// FP16 cast. Reads a uint8 HWC image with rows `src_pitch` bytes apart and writes `channels`
+// planes of `dst_width * dst_height` elements starting at `dst`.
+// Safety: both buffers must be device memory of the given geometry until the kernel has run.
+pub unsafe fn preprocess_image(
+    src: usize,
+    src_width: u32,
+    src_height: u32,
+    src_pitch: usize,
+    channels: u32,
+    dst: usize,
+    dst_width: u32,
+    dst_height: u32,
+    dst_half: bool,
+    swap_rb: bool,
+    scale: &[f32; 4],
+    bias: &[f32; 4],
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::preprocess_image(
+        src,
+        src_width as _,
+        src_height as _,
+        src_pitch as _,
+        channels as _,
+        dst,
+        dst_width as _,
+        dst_height as _,
+        dst_half,
+        swap_rb,
+        scale.as_ptr(),
+        bias.as_ptr(),
+        stream_raw as _,
+    )
+}
+
+// Mirror of trt_rs::kernels::DbBoxStats: inclusive pixel bounds, pixel count and summed
+// probability of one connected component.
+#[repr(C)]
+#[derive(Debug, Default, Copy, Clone, PartialEq)]
+pub struct DbBoxStats {
+    pub min_x: i32,
+    pub min_y: i32,
+    pub max_x: i32,
+    pub max_y: i32,
+    pub area: i32,
+    pub score_sum: f32,
+}
+
+// DB-style text detection post-processing: threshold, 8-connected component labelling and
+// per-component bounds and scores, all on `stream`. `labels` and `roots` are i32 scratch
+// buffers of `width * height` elements, `boxes` holds `max_boxes` DbBoxStats and `count` one
+// i32 that receives the number of components (which may exceed `max_boxes`).
+// Safety: all buffers must be device memory of at least those sizes until the kernels have run.
+pub unsafe fn db_postprocess(
+    prob: usize,
+    width: u32,
+    height: u32,
+    prob_half: bool,
+    thresh: f32,
+    labels: usize,
+    roots: usize,
+    boxes: usize,
+    max_boxes: usize,
+    count: usize,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::db_postprocess(
+        prob,
+        width as _,
+        height as _,
+        prob_half,
+        thresh,
+        labels,
+        roots,
+        boxes,
+        max_boxes as _,
+        count,
+        stream_raw as _,
+    )
+}
+
+// Batched bilinear crop and resize: `count` device-side (x0, y0, x1, y1) f32 rectangles of
+// the planar [C, H, W] image `src` become [count, C, dst_height, dst_width] at `dst`, both
+// FLOAT or both HALF.
+// Safety: all buffers must be device memory of those sizes until the kernel has run.
+pub unsafe fn crop_resize(
+    src: usize,
+    channels: u32,
+    src_height: u32,
+    src_width: u32,
+    half: bool,
+    rects: usize,
+    count: usize,
+    dst: usize,
+    dst_height: u32,
+    dst_width: u32,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::crop_resize(
+        src,
+        channels as _,
+        src_height as _,
+        src_width as _,
+        half,
+        rects,
+        count as _,
+        dst,
+        dst_height as _,
+        dst_width as _,
+        stream_raw as _,
+    )
+}
+
+// Converts between a linear [outer, channels, inner] tensor and a vectorized layout whose
+// channel axis is padded to a multiple of `components`, either channel-blocked (CHW4, CHW32)
+// or channel-last (HWC, HWC8). Padding is zeroed when converting to the vectorized layout.
+// Safety: `src` and `dst` must be device memory of the linear and padded volumes until the
+// kernel has run.
+pub unsafe fn convert_layout(
+    src: usize,
+    dst: usize,
+    elem_size: usize,
+    outer: usize,
+    channels: usize,
+    inner: usize,
+    components: usize,
+    channel_last: bool,
+    to_vectorized: bool,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::convert_layout(
+        src,
+        dst,
+        elem_size as _,
+        outer as _,
+        channels as _,
+        inner as _,
+        components as _,
+        channel_last,
+        to_vectorized,
+        stream_raw as _,
+    )
+}
+
+// Converts between a linear [outer, channels, height, width] tensor and the DLA image
+// format (DLAHWC4): [outer][height][padded_width][4], or 1 channel for single-channel
+// inputs. At most 4 channels of FP16 or INT8; padding is zeroed on the way in.
+// Safety: `src` and `dst` must be device memory of the linear and padded volumes until the
+// kernel has run.
+pub unsafe fn convert_dla_hwc4(
+    src: usize,
+    dst: usize,
+    elem_size: usize,
+    outer: usize,
+    channels: usize,
+    height: usize,
+    width: usize,
+    padded_width: usize,
+    to_vectorized: bool,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::convert_dla_hwc4(
+        src,
+        dst,
+        elem_size as _,
+        outer as _,
+        channels as _,
+        height as _,
+        width as _,
+        padded_width as _,
+        to_vectorized,
+        stream_raw as _,
+    )
+}
+
+// Converts `count` elements from `src_dtype` to `dst_dtype` on `stream`. Quantized types
+// (INT8, UINT8, FP8) hold real = q * scale and saturate when written.
+// Safety: both buffers must be device memory of `count` elements until the kernel has run.
+pub unsafe fn cast_tensor(
+    src: usize,
+    src_dtype: DataType,
+    dst: usize,
+    dst_dtype: DataType,
+    count: usize,
+    scale: f32,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::cast_tensor(src, src_dtype as _, dst, dst_dtype as _, count as _, scale, stream_raw as _)
+}
+
+// One region of batched_copy, laid out as the (src, dst, size) triples it reads.
+#[repr(C)]
+#[derive(Debug, Default, Copy, Clone, PartialEq, Eq)]
+pub struct DeviceCopy {
+    pub src: usize,
+    pub dst: usize,
+    pub size: usize,
+}
+
+// Copies every region of `copies` on `stream` in one launch per 128 of them, instead of one
+// cudaMemcpyAsync each.
+// Safety: every region must be device memory, not overlapping another, until the kernels
+// have run.
+pub unsafe fn batched_copy(copies: &[DeviceCopy], stream: &CuStream) -> bool {
+    let stream_raw = stream.get_raw();
+    copies.len() <= i32::MAX as usize
+        && ffi::batched_copy(copies.as_ptr() as *const usize, copies.len() as _, stream_raw as _)
+}
+
+// Sets `count` elements of `dtype` to `value` on `stream`, rounded and saturated for the
+// integer types.
+// Safety: `dst` must be device memory of `count` elements until the kernel has run.
+pub unsafe fn fill_tensor(dst: usize, dtype: DataType, count: usize, value: f32, stream: &CuStream) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::fill_tensor(dst, dtype as _, count as _, value, stream_raw as _)
+}
+
+// Sets `count` elements of `dtype` to uniform random values in [low, high) on `stream`,
+// integers for the integer types; the same seed gives the same values.
+// Safety: `dst` must be device memory of `count` elements until the kernel has run.
+pub unsafe fn random_tensor(
+    dst: usize,
+    dtype: DataType,
+    count: usize,
+    low: f32,
+    high: f32,
+    seed: u64,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::random_tensor(dst, dtype as _, count as _, low, high, seed, stream_raw as _)
+}
+
+// Writes the attention mask of `rows` sequences of `length` tokens padded to `max_length`
+// tokens: 1 over the tokens, 0 over the padding.
+// Safety: `dst` must be device memory of `rows * max_length` elements of `dtype` until the
+// kernel has run.
+pub unsafe fn sequence_mask(
+    dst: usize,
+    dtype: DataType,
+    rows: usize,
+    max_length: usize,
+    length: usize,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::sequence_mask(dst, dtype as _, rows as _, max_length as _, length as _, stream_raw as _)
+}
+
+// The L2-normalized rows of the [rows, cols] tensor `src` (FLOAT or HALF), or their softmax
+// with `softmax`, as FLOAT [rows, cols] at `dst`.
+// Safety: both buffers must be device memory of `rows * cols` elements until the kernel has
+// run.
+pub unsafe fn normalize_rows(
+    src: usize,
+    half: bool,
+    rows: usize,
+    cols: usize,
+    softmax: bool,
+    dst: usize,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    cols <= i32::MAX as usize && ffi::normalize_rows(src, half, rows as _, cols as _, softmax, dst, stream_raw as _)
+}
+
+// The FLOAT [rows] means of the rows of `src`.
+// Safety: `src` must be device memory of `rows * cols` elements and `dst` of `rows` until the
+// kernel has run.
+pub unsafe fn mean_rows(src: usize, half: bool, rows: usize, cols: usize, dst: usize, stream: &CuStream) -> bool {
+    let stream_raw = stream.get_raw();
+    cols <= i32::MAX as usize && ffi::mean_rows(src, half, rows as _, cols as _, dst, stream_raw as _)
+}
+
+// The `k` largest elements of each row of `src` in descending order: INT32 [rows, k] indices
+// at `indices` and, unless `values` is 0, FLOAT [rows, k] values.
+// Safety: `src` must be device memory of `rows * cols` elements and the outputs of
+// `rows * k` until the kernel has run.
+pub unsafe fn topk_rows(
+    src: usize,
+    half: bool,
+    rows: usize,
+    cols: usize,
+    k: usize,
+    values: usize,
+    indices: usize,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    cols <= i32::MAX as usize
+        && ffi::topk_rows(src, half, rows as _, cols as _, k.min(cols) as _, values, indices, stream_raw as _)
+}
+
+// Greedy CTC decoding of the [rows, steps, classes] FLOAT or HALF `src`: INT32
+// [rows, steps] labels with repeats merged and `blank` dropped, the INT32 [rows] number of
+// valid labels of each row and the FLOAT [rows] mean value of those labels.
+// Safety: `src` must be device memory of `rows * steps * classes` elements, `labels` of
+// `rows * steps` and `lengths` and `scores` of `rows` until the kernel has run.
+pub unsafe fn ctc_greedy_decode(
+    src: usize,
+    half: bool,
+    rows: usize,
+    steps: usize,
+    classes: usize,
+    blank: usize,
+    labels: usize,
+    lengths: usize,
+    scores: usize,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    let fits = |n: usize| n <= i32::MAX as usize;
+    fits(steps)
+        && fits(classes)
+        && fits(blank)
+        && ffi::ctc_greedy_decode(
+            src,
+            half,
+            rows as _,
+            steps as _,
+            classes as _,
+            blank as _,
+            labels,
+            lengths,
+            scores,
+            stream_raw as _,
+        )
+}
+
+// Inner products of the [num_queries, dim] FLOAT or HALF `queries` with the HALF
+// [rows, dim] `index`, as FLOAT [num_queries, rows] at `dst`.
+// Safety: all buffers must be device memory of those sizes until the kernel has run.
+pub unsafe fn similarity(
+    queries: usize,
+    queries_half: bool,
+    num_queries: usize,
+    index: usize,
+    rows: usize,
+    dim: usize,
+    dst: usize,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    let fits = |n: usize| n <= i32::MAX as usize;
+    fits(num_queries)
+        && fits(rows)
+        && fits(dim)
+        && ffi::similarity(queries, queries_half, num_queries as _, index, rows as _, dim as _, dst, stream_raw as _)
+}
@@ -1,5 +1,147 @@
+use crate::{
+    allocator::RustGpuAllocator,
+    builder::RustCalibrator,
+    logger::LogCallback,
+    plugin::{RustPlugin, RustPluginCreator},
+    runtime::{RustOutputAllocator, StreamReader},
+    stream::{run_host_callback, HostCallback},
+};
+
 #[cxx::bridge]
 pub(crate) mod ffi {
+    // Inline, fixed-capacity mirror of nvinfer1::Dims; crosses the bridge by value so shape
+    // queries do not allocate.
+    #[namespace = "trt_rs::runtime"]
+    #[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+    struct TensorDims {
+        nb_dims: i32,
+        d: [i32; 8],
+    }
+
+    // One IO tensor of ExecutionContext::apply_bindings. `dims` is applied as the input shape
+    // unless nb_dims is -1, the shape the context then resolves is checked against
+    // `capacity` elements unless it is -1, and `address` is bound unless it is 0.
+    #[namespace = "trt_rs::runtime"]
+    #[derive(Debug, Copy, Clone, PartialEq, Eq)]
+    struct TensorBinding {
+        handle: i32,
+        address: usize,
+        dims: TensorDims,
+        capacity: i64,
+    }
+
+    #[namespace = "trt_rs::runtime"]
+    #[derive(Debug)]
+    enum BindingError {
+        NONE,
+        SHAPE,
+        CAPACITY,
+        ADDRESS,
+        ENQUEUE,
+    }
+
+    // Index of the binding that failed, or -1 (with error NONE, or ENQUEUE when the bindings
+    // applied but the enqueue did not).
+    #[namespace = "trt_rs::runtime"]
+    #[derive(Debug, Copy, Clone, PartialEq, Eq)]
+    struct BindingStatus {
+        index: i32,
+        error: BindingError,
+    }
+
+    // Aggregated IProfiler reports for one layer; percentiles come from a log-spaced
+    // histogram (four buckets per octave) and are rounded up to their bucket's upper edge.
+    #[namespace = "trt_rs::profiler"]
+    #[derive(Debug, Clone, PartialEq)]
+    struct LayerTiming {
+        name: String,
+        count: u64,
+        total_ms: f64,
+        min_ms: f32,
+        max_ms: f32,
+        p50_ms: f32,
+        p90_ms: f32,
+        p99_ms: f32,
+    }
+
+    // A creator of the plugin registry; `plugin_namespace` is empty for the default namespace.
+    #[namespace = "trt_rs::plugin"]
+    #[derive(Debug, Clone, PartialEq, Eq, Hash)]
+    struct PluginCreatorInfo {
+        name: String,
+        version: String,
+        plugin_namespace: String,
+    }
+
+    // One dim of a plugin output: dim `dim` of output `output` is dim `value` of input
+    // `input`, or the constant `value` when `input` is -1.
+    #[namespace = "trt_rs::plugin"]
+    #[derive(Debug, Copy, Clone, PartialEq, Eq)]
+    struct PluginDimExpr {
+        output: i32,
+        dim: i32,
+        input: i32,
+        value: i32,
+    }
+
+    // An IO tensor of a plugin as seen by enqueue; `address` is 0 outside of enqueue.
+    #[namespace = "trt_rs::plugin"]
+    #[derive(Debug, Copy, Clone, PartialEq, Eq)]
+    struct PluginTensor {
+        dims: TensorDims,
+        dtype: i32,
+        address: usize,
+    }
+
+    // A plugin attribute, as nvinfer1::PluginField with the data copied: `length` elements of
+    // type `field_type` (nvinfer1::PluginFieldType).
+    #[namespace = "trt_rs::plugin"]
+    #[derive(Debug, Clone, PartialEq, Eq)]
+    struct PluginField {
+        name: String,
+        field_type: i32,
+        length: i32,
+        data: Vec<u8>,
+    }
+
+    // One IErrorRecorder report: `code` is an nvinfer1::ErrorCode.
+    #[namespace = "trt_rs::error_recorder"]
+    #[derive(Debug, Clone, PartialEq, Eq)]
+    struct RecordedError {
+        code: i32,
+        desc: String,
+    }
+
+    #[namespace = "trt_rs::error_recorder"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/error_recorder.h");
+
+        type ErrorRecorder;
+
+        fn create_error_recorder(capacity: usize) -> UniquePtr<ErrorRecorder>;
+
+        fn num_errors(self: &ErrorRecorder) -> i32;
+
+        fn has_overflowed(self: &ErrorRecorder) -> bool;
+
+        fn take_errors(self: &ErrorRecorder) -> Vec<RecordedError>;
+
+        fn clear(self: &ErrorRecorder);
+    }
+
+    #[namespace = "trt_rs::profiler"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/profiler.h");
+
+        type Profiler;
+
+        fn create_profiler() -> UniquePtr<Profiler>;
+
+        fn get_layer_timings(self: &Profiler) -> Vec<LayerTiming>;
+
+        fn reset(self: &Profiler);
+    }
+
     #[namespace = "trt_rs::logger"]
     unsafe extern "C++" {
         include!("tensorrt-rs-sys/cxx/include/logger.h");
@@ -8,9 +150,73 @@ pub(crate) mod ffi {
 
         fn create_logger() -> UniquePtr<Logger>;
 
+        fn create_named_logger(name: &str) -> UniquePtr<Logger>;
+
         fn log(self: Pin<&mut Logger>, severity: i32, msg: &str);
 
         fn set_level(self: Pin<&mut Logger>, severity: i32);
+
+        fn set_name(self: Pin<&mut Logger>, name: &str);
+
+        fn get_name(self: &Logger) -> String;
+
+        fn set_async(self: Pin<&mut Logger>, queue_size: usize, overflow_policy: i32) -> bool;
+
+        fn is_async(self: &Logger) -> bool;
+
+        fn flush(self: Pin<&mut Logger>);
+
+        fn enable_capture(self: Pin<&mut Logger>, capacity: usize, capture_severity: i32) -> bool;
+
+        fn disable_capture(self: Pin<&mut Logger>);
+
+        fn dump_captured(self: &Logger, lines: usize) -> Vec<String>;
+
+        fn replay_captured(self: Pin<&mut Logger>);
+
+        fn enable_rate_limit(
+            self: Pin<&mut Logger>,
+            rate_per_sec: f64,
+            burst: u32,
+            dedup_window_ms: u32,
+        ) -> bool;
+
+        fn disable_rate_limit(self: Pin<&mut Logger>);
+
+        fn set_callback(self: Pin<&mut Logger>, callback: Box<LogCallback>);
+
+        fn clear_callback(self: Pin<&mut Logger>);
+    }
+
+    #[namespace = "trt_rs::logger"]
+    extern "Rust" {
+        type LogCallback;
+
+        fn on_log(self: &LogCallback, severity: i32, msg: &[u8]);
+    }
+
+    #[namespace = "trt_rs::allocator"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/allocator.h");
+
+        type GpuAllocator;
+
+        fn create_rust_gpu_allocator(allocator: Box<RustGpuAllocator>) -> UniquePtr<GpuAllocator>;
+
+        fn create_mem_pool_allocator(device: i32, release_threshold: u64) -> UniquePtr<GpuAllocator>;
+    }
+
+    #[namespace = "trt_rs::allocator"]
+    extern "Rust" {
+        type RustGpuAllocator;
+
+        fn allocate(self: &RustGpuAllocator, size: u64, alignment: u64, flags: u32) -> usize;
+
+        fn deallocate(self: &RustGpuAllocator, memory: usize) -> bool;
+
+        fn allocate_async(self: &RustGpuAllocator, size: u64, alignment: u64, flags: u32, stream: usize) -> usize;
+
+        fn deallocate_async(self: &RustGpuAllocator, memory: usize, stream: usize) -> bool;
     }
 
     #[namespace = "trt_rs::runtime"]
@@ -23,11 +229,15 @@ pub(crate) mod ffi {
 
         type ExecutionContext;
 
+        fn get_infer_lib_version() -> i32;
+
         // Runtime
         fn create_runtime(logger: Pin<&mut Logger>) -> UniquePtr<Runtime>;
 
         fn deserialize(self: Pin<&mut Runtime>, data: &[u8]) -> UniquePtr<CudaEngine>;
 
+        fn deserialize_from_stream(self: Pin<&mut Runtime>, reader: &mut StreamReader) -> UniquePtr<CudaEngine>;
+
         fn set_max_threads(self: Pin<&mut Runtime>, max_threads: i32) -> bool;
 
         fn get_max_threads(self: &Runtime) -> i32;
@@ -36,6 +246,22 @@ pub(crate) mod ffi {
 
         fn get_engine_host_code_allowed(self: &Runtime) -> bool;
 
+        fn load_lean_runtime(self: Pin<&mut Runtime>, path: &str) -> bool;
+
+        fn set_temporary_directory(self: Pin<&mut Runtime>, path: &str);
+
+        fn set_tempfile_control_flags(self: Pin<&mut Runtime>, flags: u32);
+
+        fn set_dla_core(self: Pin<&mut Runtime>, core: i32);
+
+        fn get_dla_core(self: &Runtime) -> i32;
+
+        fn get_nb_dla_cores(self: &Runtime) -> i32;
+
+        fn set_gpu_allocator(self: Pin<&mut Runtime>, allocator: &GpuAllocator);
+
+        fn set_error_recorder(self: Pin<&mut Runtime>, recorder: &ErrorRecorder);
+
         // CudaEngine
         fn get_tensor_shape(self: &CudaEngine, name: &str) -> Vec<i32>;
 
@@ -43,18 +269,36 @@ pub(crate) mod ffi {
 
         fn get_num_layers(self: &CudaEngine) -> i32;
 
-        fn create_execution_context(self: Pin<&mut CudaEngine>) -> UniquePtr<ExecutionContext>;
+        fn create_execution_context(self: &CudaEngine) -> UniquePtr<ExecutionContext>;
 
         fn is_shape_inference_io(self: &CudaEngine, name: &str) -> bool;
 
         fn get_tensor_io_mode(self: &CudaEngine, name: &str) -> i32;
 
-        fn create_execution_context_without_device_memory(self: Pin<&mut CudaEngine>) -> UniquePtr<ExecutionContext>;
+        fn get_tensor_location(self: &CudaEngine, name: &str) -> i32;
+
+        fn create_execution_context_without_device_memory(self: &CudaEngine) -> UniquePtr<ExecutionContext>;
+
+        fn create_engine_inspector(self: &CudaEngine) -> UniquePtr<EngineInspector>;
 
         fn get_device_memory_size(self: &CudaEngine) -> usize;
 
+        fn get_device_memory_size_for_profile(self: &CudaEngine, profile: i32) -> i64;
+
         fn is_refittable(self: &CudaEngine) -> bool;
 
+        fn serialize(self: &CudaEngine) -> UniquePtr<HostMemory>;
+
+        fn get_streamable_weights_size(self: &CudaEngine) -> i64;
+
+        fn set_weight_streaming_budget(self: Pin<&mut CudaEngine>, budget: i64) -> bool;
+
+        fn get_weight_streaming_budget(self: &CudaEngine) -> i64;
+
+        fn get_weight_streaming_automatic_budget(self: &CudaEngine) -> i64;
+
+        fn get_weight_streaming_scratch_memory_size(self: &CudaEngine) -> i64;
+
         fn get_tensor_bytes_per_component(self: &CudaEngine, name: &str) -> i32;
 
         fn get_tensor_components_per_element(self: &CudaEngine, name: &str) -> i32;
@@ -65,6 +309,8 @@ pub(crate) mod ffi {
 
         fn get_name(self: &CudaEngine) -> &str;
 
+        fn set_error_recorder(self: Pin<&mut CudaEngine>, recorder: &ErrorRecorder);
+
         fn get_num_optimization_profiles(self: &CudaEngine) -> i32;
 
         fn get_engine_capability(self: &CudaEngine) -> i32;
@@ -79,6 +325,33 @@ pub(crate) mod ffi {
 
         fn get_num_aux_streams(self: &CudaEngine) -> i32;
 
+        fn get_profiling_verbosity(self: &CudaEngine) -> i32;
+
+        fn get_tensor_handle(self: &CudaEngine, name: &str) -> i32;
+
+        fn get_tensor_shape_by_handle(self: &CudaEngine, handle: i32) -> Vec<i32>;
+
+        fn get_tensor_dtype_by_handle(self: &CudaEngine, handle: i32) -> i32;
+
+        fn get_tensor_io_mode_by_handle(self: &CudaEngine, handle: i32) -> i32;
+
+        fn get_tensor_dims(self: &CudaEngine, name: &str) -> TensorDims;
+
+        fn get_tensor_dims_by_handle(self: &CudaEngine, handle: i32) -> TensorDims;
+
+        fn get_profile_dims(self: &CudaEngine, name: &str, profile: i32, select: i32) -> TensorDims;
+
+        fn get_profile_tensor_values(self: &CudaEngine, name: &str, profile: i32, select: i32) -> Vec<i32>;
+
+        // EngineInspector
+        type EngineInspector;
+
+        fn set_execution_context(self: Pin<&mut EngineInspector>, context: &ExecutionContext) -> bool;
+
+        fn get_layer_information(self: &EngineInspector, layer_index: i32, format: i32) -> String;
+
+        fn get_engine_information(self: &EngineInspector, format: i32) -> String;
+
         // ExecutionContext
         fn set_debug_sync(self: Pin<&mut ExecutionContext>, sync: bool);
 
@@ -90,6 +363,8 @@ pub(crate) mod ffi {
 
         fn set_device_memory(self: Pin<&mut ExecutionContext>, memory: usize);
 
+        fn set_device_memory_v2(self: Pin<&mut ExecutionContext>, memory: usize, size: i64);
+
         fn get_tensor_strides(self: &ExecutionContext, name: &str) -> Vec<i32>;
 
         fn get_optimization_profile(self: &ExecutionContext) -> i32;
@@ -110,6 +385,14 @@ pub(crate) mod ffi {
 
         fn report_to_profiler(self: Pin<&mut ExecutionContext>);
 
+        fn set_profiler(self: Pin<&mut ExecutionContext>, profiler: &Profiler);
+
+        fn unset_profiler(self: Pin<&mut ExecutionContext>);
+
+        fn set_error_recorder(self: Pin<&mut ExecutionContext>, recorder: &ErrorRecorder);
+
+        fn unset_error_recorder(self: Pin<&mut ExecutionContext>);
+
         fn set_tensor_address(self: Pin<&mut ExecutionContext>, name: &str, address: usize) -> bool;
 
         fn get_tensor_address(self: &ExecutionContext, name: &str) -> usize;
@@ -122,10 +405,26 @@ pub(crate) mod ffi {
 
         fn get_input_consumed_event(self: &ExecutionContext) -> usize;
 
+        fn set_output_allocator(self: Pin<&mut ExecutionContext>, name: &str, allocator: Box<RustOutputAllocator>) -> bool;
+
+        fn infer_shapes(self: Pin<&mut ExecutionContext>) -> i32;
+
         fn get_max_output_size(self: &ExecutionContext, name: &str) -> usize;
 
+        fn set_temporary_storage_allocator(self: Pin<&mut ExecutionContext>, allocator: &GpuAllocator) -> bool;
+
         fn enqueue_v3(self: Pin<&mut ExecutionContext>, stream: usize) -> bool;
 
+        fn apply_bindings(self: Pin<&mut ExecutionContext>, bindings: &[TensorBinding]) -> BindingStatus;
+
+        fn apply_bindings_and_enqueue(
+            self: Pin<&mut ExecutionContext>,
+            bindings: &[TensorBinding],
+            stream: usize,
+        ) -> BindingStatus;
+
+        fn get_tensor_dims_many(self: &ExecutionContext, handles: &[i32], dims: &mut [TensorDims]);
+
         fn set_persistent_cache_limit(self: Pin<&mut ExecutionContext>, limit: usize);
 
         fn get_persistent_cache_limit(self: &ExecutionContext) -> usize;
@@ -133,6 +432,602 @@ pub(crate) mod ffi {
         fn set_nvtx_verbosity(self: Pin<&mut ExecutionContext>, verbosity: i32);
 
         fn set_aux_streams(self: Pin<&mut ExecutionContext>, streams: &[usize]);
+
+        fn set_input_shape_by_handle(self: Pin<&mut ExecutionContext>, handle: i32, shape: &[i32]) -> bool;
+
+        fn get_tensor_shape_by_handle(self: &ExecutionContext, handle: i32) -> Vec<i32>;
+
+        fn set_tensor_address_by_handle(self: Pin<&mut ExecutionContext>, handle: i32, address: usize) -> bool;
+
+        fn get_tensor_address_by_handle(self: &ExecutionContext, handle: i32) -> usize;
+
+        fn set_input_tensor_address_by_handle(self: Pin<&mut ExecutionContext>, handle: i32, address: usize) -> bool;
+
+        fn set_input_dims_by_handle(self: Pin<&mut ExecutionContext>, handle: i32, dims: &TensorDims) -> bool;
+
+        fn get_tensor_dims(self: &ExecutionContext, name: &str) -> TensorDims;
+
+        fn get_tensor_dims_by_handle(self: &ExecutionContext, handle: i32) -> TensorDims;
+
+        fn get_tensor_stride_dims(self: &ExecutionContext, name: &str) -> TensorDims;
+    }
+
+    #[namespace = "trt_rs::runtime"]
+    extern "Rust" {
+        type StreamReader;
+
+        fn read(self: &mut StreamReader, buf: &mut [u8]) -> usize;
+
+        type RustOutputAllocator;
+
+        fn reallocate_output(
+            self: &mut RustOutputAllocator,
+            tensor_name: &str,
+            current_memory: usize,
+            size: u64,
+            alignment: u64,
+            stream: usize,
+        ) -> usize;
+
+        fn notify_shape(self: &mut RustOutputAllocator, tensor_name: &str, dims: &[i32]);
+    }
+
+    #[namespace = "trt_rs::builder"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/builder.h");
+
+        type Builder;
+
+        type NetworkDefinition;
+
+        type BuilderConfig;
+
+        type OptimizationProfile;
+
+        type TimingCache;
+
+        type HostMemory;
+
+        type Int8Calibrator;
+
+        fn create_int8_calibrator(calibrator: Box<RustCalibrator>) -> UniquePtr<Int8Calibrator>;
+
+        // Builder; `logger` must outlive it
+        fn create_builder(logger: Pin<&mut Logger>) -> UniquePtr<Builder>;
+
+        fn create_onnx_network(self: &Builder) -> UniquePtr<NetworkDefinition>;
+
+        fn create_builder_config(self: &Builder) -> UniquePtr<BuilderConfig>;
+
+        fn create_optimization_profile(self: &Builder) -> UniquePtr<OptimizationProfile>;
+
+        fn build_serialized_network(
+            self: &Builder,
+            network: Pin<&mut NetworkDefinition>,
+            config: Pin<&mut BuilderConfig>,
+        ) -> UniquePtr<HostMemory>;
+
+        fn platform_has_fast_fp16(self: &Builder) -> bool;
+
+        fn platform_has_fast_int8(self: &Builder) -> bool;
+
+        fn set_max_threads(self: Pin<&mut Builder>, threads: i32) -> bool;
+
+        fn get_nb_dla_cores(self: &Builder) -> i32;
+
+        // NetworkDefinition
+        fn parse(self: Pin<&mut NetworkDefinition>, model: &[u8]) -> bool;
+
+        fn parse_from_file(self: Pin<&mut NetworkDefinition>, path: &str, verbosity: i32) -> bool;
+
+        fn get_parser_errors(self: &NetworkDefinition) -> Vec<String>;
+
+        fn get_nb_inputs(self: &NetworkDefinition) -> i32;
+
+        fn get_nb_outputs(self: &NetworkDefinition) -> i32;
+
+        fn get_input_name(self: &NetworkDefinition, index: i32) -> String;
+
+        fn get_output_name(self: &NetworkDefinition, index: i32) -> String;
+
+        fn get_input_dims(self: &NetworkDefinition, index: i32) -> TensorDims;
+
+        // BuilderConfig
+        fn set_flag(self: Pin<&mut BuilderConfig>, flag: i32, enabled: bool) -> bool;
+
+        fn get_flag(self: &BuilderConfig, flag: i32) -> bool;
+
+        fn set_memory_pool_limit(self: Pin<&mut BuilderConfig>, pool: i32, size: usize);
+
+        fn set_builder_optimization_level(self: Pin<&mut BuilderConfig>, level: i32);
+
+        fn set_profiling_verbosity(self: Pin<&mut BuilderConfig>, verbosity: i32);
+
+        fn set_hardware_compatibility_level(self: Pin<&mut BuilderConfig>, level: i32);
+
+        fn set_avg_timing_iterations(self: Pin<&mut BuilderConfig>, iterations: i32);
+
+        fn set_default_device_type(self: Pin<&mut BuilderConfig>, device_type: i32);
+
+        fn set_dla_core(self: Pin<&mut BuilderConfig>, core: i32);
+
+        fn add_optimization_profile(self: Pin<&mut BuilderConfig>, profile: &OptimizationProfile) -> i32;
+
+        fn create_timing_cache(self: &BuilderConfig, blob: &[u8]) -> UniquePtr<TimingCache>;
+
+        fn set_timing_cache(self: Pin<&mut BuilderConfig>, cache: &TimingCache, ignore_mismatch: bool) -> bool;
+
+        fn set_int8_calibrator(self: Pin<&mut BuilderConfig>, calibrator: UniquePtr<Int8Calibrator>);
+
+        // OptimizationProfile
+        fn set_dimensions(self: Pin<&mut OptimizationProfile>, input: &str, select: i32, dims: &TensorDims) -> bool;
+
+        fn set_shape_values(self: Pin<&mut OptimizationProfile>, input: &str, select: i32, values: &[i32]) -> bool;
+
+        fn is_valid(self: &OptimizationProfile) -> bool;
+
+        // TimingCache
+        fn serialize(self: &TimingCache) -> UniquePtr<HostMemory>;
+
+        fn combine(self: Pin<&mut TimingCache>, other: &TimingCache, ignore_mismatch: bool) -> bool;
+
+        fn reset(self: Pin<&mut TimingCache>) -> bool;
+
+        // HostMemory
+        fn data(self: &HostMemory) -> &[u8];
+    }
+
+    #[namespace = "trt_rs::builder"]
+    extern "Rust" {
+        type RustCalibrator;
+
+        fn batch_size(self: &RustCalibrator) -> i32;
+
+        fn next_batch(self: &mut RustCalibrator) -> bool;
+
+        fn get_binding(self: &RustCalibrator, name: &str) -> usize;
+
+        fn read_cache(self: &mut RustCalibrator) -> Vec<u8>;
+
+        fn write_cache(self: &mut RustCalibrator, cache: &[u8]);
+    }
+
+    #[namespace = "trt_rs::refitter"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/refitter.h");
+
+        type Refitter;
+
+        fn create_refitter(engine: Pin<&mut CudaEngine>, logger: Pin<&mut Logger>) -> UniquePtr<Refitter>;
+
+        fn set_named_weights(
+            self: Pin<&mut Refitter>,
+            name: &str,
+            dtype: i32,
+            values: usize,
+            count: i64,
+            on_device: bool,
+        ) -> bool;
+
+        fn get_missing_weights(self: &Refitter) -> Vec<String>;
+
+        fn get_all_weights(self: &Refitter) -> Vec<String>;
+
+        fn refit_async(self: Pin<&mut Refitter>, stream: usize) -> bool;
+
+        fn set_max_threads(self: Pin<&mut Refitter>, threads: i32) -> bool;
+    }
+
+    #[namespace = "trt_rs::graph"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_graph.h");
+
+        fn begin_capture(stream: usize) -> bool;
+
+        fn end_capture(stream: usize) -> usize;
+
+        fn destroy_graph(graph: usize);
+
+        fn instantiate_graph(graph: usize) -> usize;
+
+        fn update_graph_exec(exec: usize, graph: usize) -> bool;
+
+        fn launch_graph(exec: usize, stream: usize) -> bool;
+
+        fn destroy_graph_exec(exec: usize);
+    }
+
+    #[namespace = "trt_rs::memory"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_memory.h");
+
+        fn memcpy_async(dst: usize, src: usize, size: usize, kind: i32, stream: usize) -> bool;
+
+        fn memcpy_2d_async(
+            dst: usize,
+            dst_pitch: usize,
+            src: usize,
+            src_pitch: usize,
+            width: usize,
+            height: usize,
+            kind: i32,
+            stream: usize,
+        ) -> bool;
+
+        fn memcpy_3d_async(
+            dst: usize,
+            dst_pitch: usize,
+            dst_height: usize,
+            src: usize,
+            src_pitch: usize,
+            src_height: usize,
+            width: usize,
+            height: usize,
+            depth: usize,
+            kind: i32,
+            stream: usize,
+        ) -> bool;
+
+        fn memset_async(dst: usize, value: i32, size: usize, stream: usize) -> bool;
+
+        fn get_pointer_device(ptr: usize) -> i32;
+
+        fn host_alloc(size: usize) -> usize;
+
+        fn free_host(ptr: usize);
+
+        fn host_alloc_mapped(size: usize) -> usize;
+
+        fn get_mapped_device_pointer(ptr: usize) -> usize;
+
+        fn managed_alloc(size: usize) -> usize;
+
+        fn free_managed(ptr: usize);
+
+        fn host_alloc_on_node(size: usize, node: i32) -> usize;
+
+        fn free_host_on_node(ptr: usize, size: usize);
+    }
+
+    #[namespace = "trt_rs::kernels"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/kernels.h");
+
+        unsafe fn preprocess_image(
+            src: usize,
+            src_width: i32,
+            src_height: i32,
+            src_pitch: i32,
+            channels: i32,
+            dst: usize,
+            dst_width: i32,
+            dst_height: i32,
+            dst_half: bool,
+            swap_rb: bool,
+            scale: *const f32,
+            bias: *const f32,
+            stream: usize,
+        ) -> bool;
+
+        fn db_postprocess(
+            prob: usize,
+            width: i32,
+            height: i32,
+            prob_half: bool,
+            thresh: f32,
+            labels: usize,
+            roots: usize,
+            boxes: usize,
+            max_boxes: i32,
+            count: usize,
+            stream: usize,
+        ) -> bool;
+
+        fn crop_resize(
+            src: usize,
+            channels: i32,
+            src_height: i32,
+            src_width: i32,
+            half: bool,
+            rects: usize,
+            count: i32,
+            dst: usize,
+            dst_height: i32,
+            dst_width: i32,
+            stream: usize,
+        ) -> bool;
+
+        fn convert_layout(
+            src: usize,
+            dst: usize,
+            elem_size: i32,
+            outer: i64,
+            channels: i64,
+            inner: i64,
+            components: i32,
+            channel_last: bool,
+            to_vectorized: bool,
+            stream: usize,
+        ) -> bool;
+
+        unsafe fn convert_dla_hwc4(
+            src: usize,
+            dst: usize,
+            elem_size: i32,
+            outer: i64,
+            channels: i64,
+            height: i64,
+            width: i64,
+            padded_width: i64,
+            to_vectorized: bool,
+            stream: usize,
+        ) -> bool;
+
+        fn cast_tensor(
+            src: usize,
+            src_dtype: i32,
+            dst: usize,
+            dst_dtype: i32,
+            count: i64,
+            scale: f32,
+            stream: usize,
+        ) -> bool;
+
+        unsafe fn batched_copy(copies: *const usize, count: i32, stream: usize) -> bool;
+
+        fn fill_tensor(dst: usize, dtype: i32, count: i64, value: f32, stream: usize) -> bool;
+
+        fn random_tensor(
+            dst: usize,
+            dtype: i32,
+            count: i64,
+            low: f32,
+            high: f32,
+            seed: u64,
+            stream: usize,
+        ) -> bool;
+
+        fn sequence_mask(
+            dst: usize,
+            dtype: i32,
+            rows: i32,
+            max_length: i32,
+            length: i32,
+            stream: usize,
+        ) -> bool;
+
+        fn normalize_rows(
+            src: usize,
+            half: bool,
+            rows: i64,
+            cols: i32,
+            softmax: bool,
+            dst: usize,
+            stream: usize,
+        ) -> bool;
+
+        fn mean_rows(src: usize, half: bool, rows: i64, cols: i32, dst: usize, stream: usize) -> bool;
+
+        fn similarity(
+            queries: usize,
+            queries_half: bool,
+            num_queries: i32,
+            index: usize,
+            rows: i32,
+            dim: i32,
+            dst: usize,
+            stream: usize,
+        ) -> bool;
+
+        fn topk_rows(
+            src: usize,
+            half: bool,
+            rows: i64,
+            cols: i32,
+            k: i32,
+            values: usize,
+            indices: usize,
+            stream: usize,
+        ) -> bool;
+
+        fn ctc_greedy_decode(
+            src: usize,
+            half: bool,
+            rows: i64,
+            steps: i32,
+            classes: i32,
+            blank: i32,
+            labels: usize,
+            lengths: usize,
+            scores: usize,
+            stream: usize,
+        ) -> bool;
+    }
+
+    #[namespace = "trt_rs::stream"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_stream.h");
+
+        fn launch_host_func(stream: usize, callback: Box<HostCallback>) -> bool;
+
+        fn create_stream(priority: i32) -> usize;
+
+        fn destroy_stream(stream: usize);
+
+        fn synchronize_stream(stream: usize) -> bool;
+
+        fn get_least_stream_priority() -> i32;
+
+        fn get_greatest_stream_priority() -> i32;
+
+        fn create_event(disable_timing: bool) -> usize;
+
+        fn create_blocking_event() -> usize;
+
+        fn destroy_event(event: usize);
+
+        fn record_event(event: usize, stream: usize) -> bool;
+
+        fn stream_wait_event(stream: usize, event: usize) -> bool;
+
+        fn synchronize_event(event: usize) -> bool;
+
+        fn query_event(event: usize) -> bool;
+
+        fn query_event_status(event: usize) -> i32;
+
+        fn synchronize_event_status(event: usize) -> i32;
+
+        fn get_last_error() -> i32;
+
+        fn get_error_name(error: i32) -> String;
+
+        fn event_elapsed_time(start: usize, end: usize) -> f32;
+
+        fn set_access_policy_window(stream: usize, base: usize, num_bytes: usize, hit_ratio: f32) -> bool;
+    }
+
+    #[namespace = "trt_rs::vmm"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_vmm.h");
+
+        type VirtualMemory;
+
+        fn create_virtual_memory(reserve: usize, device: i32) -> UniquePtr<VirtualMemory>;
+
+        fn grow(self: Pin<&mut VirtualMemory>, size: usize) -> bool;
+
+        fn get_raw(self: &VirtualMemory) -> usize;
+
+        fn size(self: &VirtualMemory) -> usize;
+
+        fn reserved(self: &VirtualMemory) -> usize;
+
+        fn granularity(self: &VirtualMemory) -> usize;
+    }
+
+    #[namespace = "trt_rs::ipc"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_ipc.h");
+
+        fn alloc_shareable(size: usize) -> usize;
+
+        fn free_shareable(ptr: usize);
+
+        fn get_mem_handle(ptr: usize, handle: &mut [u8]) -> bool;
+
+        fn open_mem_handle(handle: &[u8]) -> usize;
+
+        fn close_mem_handle(ptr: usize);
+
+        fn create_ipc_event() -> usize;
+
+        fn get_event_handle(event: usize, handle: &mut [u8]) -> bool;
+
+        fn open_event_handle(handle: &[u8]) -> usize;
+    }
+
+    #[namespace = "trt_rs::gds"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_gds.h");
+
+        type GdsFile;
+
+        fn gds_available() -> bool;
+
+        fn open_gds_file(path: &str) -> UniquePtr<GdsFile>;
+
+        fn read(self: &GdsFile, ptr: usize, size: usize, offset: usize) -> i64;
+
+        fn size(self: &GdsFile) -> usize;
+
+        fn register_gds_buffer(ptr: usize, size: usize) -> bool;
+
+        fn deregister_gds_buffer(ptr: usize);
+    }
+
+    #[namespace = "trt_rs::green"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_green_ctx.h");
+
+        type GreenContext;
+        type SmPartitioner;
+
+        fn green_contexts_supported() -> bool;
+
+        fn create_stream(self: &GreenContext, priority: i32) -> usize;
+
+        fn sm_count(self: &GreenContext) -> u32;
+
+        fn create_sm_partitioner(device: i32) -> UniquePtr<SmPartitioner>;
+
+        fn take(self: Pin<&mut SmPartitioner>, sm_count: u32) -> UniquePtr<GreenContext>;
+
+        fn remaining(self: &SmPartitioner) -> u32;
+    }
+
+    #[namespace = "trt_rs::stream"]
+    extern "Rust" {
+        type HostCallback;
+
+        fn run_host_callback(callback: Box<HostCallback>);
+    }
+
+    #[namespace = "trt_rs::device"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/cuda_device.h");
+
+        fn get_device() -> i32;
+
+        fn set_device(device: i32) -> bool;
+
+        fn get_device_count() -> i32;
+
+        fn get_compute_capability(device: i32) -> i32;
+
+        fn get_device_name(device: i32) -> String;
+
+        fn get_pci_bus_id(device: i32) -> String;
+
+        fn is_integrated(device: i32) -> bool;
+
+        fn get_max_persisting_l2_cache_size(device: i32) -> i32;
+
+        fn get_max_access_policy_window_size(device: i32) -> i32;
+
+        fn get_l2_cache_size(device: i32) -> i32;
+
+        fn set_persisting_l2_cache_limit(size: usize) -> bool;
+
+        fn reset_persisting_l2_cache() -> bool;
+
+        fn get_mem_info(free: &mut usize, total: &mut usize) -> bool;
+
+        fn retain_primary_context(device: i32) -> usize;
+
+        fn release_primary_context(device: i32);
+
+        fn make_context_current(ctx: usize) -> bool;
+    }
+
+    #[namespace = "trt_rs::numa"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/numa.h");
+
+        fn set_thread_affinity(cpus: &[u32]) -> bool;
+    }
+
+    #[namespace = "trt_rs::nvtx"]
+    unsafe extern "C++" {
+        include!("tensorrt-rs-sys/cxx/include/nvtx.h");
+
+        fn nvtx_enabled() -> bool;
+
+        fn nvtx_name_category(category: u32, name: &str);
+
+        fn nvtx_range_push(category: u32, message: &str);
+
+        fn nvtx_range_pop();
     }
 
     #[namespace = "trt_rs::plugin"]
@@ -142,9 +1037,71 @@ pub(crate) mod ffi {
         fn load_library(plugin_path: &str) -> usize;
 
         fn unload_library(handle: usize);
+
+        fn init_lib_nvinfer_plugins(plugin_namespace: &str) -> bool;
+
+        fn get_plugin_creators() -> Vec<PluginCreatorInfo>;
+
+        fn register_plugin_creator(
+            name: &str,
+            version: &str,
+            plugin_namespace: &str,
+            creator: Box<RustPluginCreator>,
+        ) -> bool;
+    }
+
+    #[namespace = "trt_rs::plugin"]
+    extern "Rust" {
+        type RustPlugin;
+
+        fn is_valid(self: &RustPlugin) -> bool;
+
+        fn num_outputs(self: &RustPlugin) -> i32;
+
+        fn output_types(self: &RustPlugin, inputs: &[i32], outputs: &mut [i32]) -> bool;
+
+        fn output_shapes(self: &RustPlugin, input_ranks: &[i32]) -> Vec<PluginDimExpr>;
+
+        fn supports_type(self: &RustPlugin, pos: i32, types: &[i32]) -> bool;
+
+        fn workspace_size(self: &RustPlugin, inputs: &[TensorDims], outputs: &[TensorDims]) -> usize;
+
+        fn on_shape_change(self: &mut RustPlugin, inputs: &[PluginTensor], outputs: &[PluginTensor]) -> bool;
+
+        fn enqueue(
+            self: &mut RustPlugin,
+            inputs: &[PluginTensor],
+            outputs: &[PluginTensor],
+            workspace: usize,
+            stream: usize,
+        ) -> bool;
+
+        fn serialize(self: &RustPlugin) -> Vec<PluginField>;
+
+        fn clone_plugin(self: &RustPlugin) -> Box<RustPlugin>;
+
+        type RustPluginCreator;
+
+        fn create(self: &RustPluginCreator, name: &str, fields: &[PluginField]) -> Box<RustPlugin>;
     }
 }
 
+pub mod allocator;
+pub mod builder;
+pub mod device;
+pub mod error_recorder;
+pub mod gds;
+pub mod graph;
+pub mod green;
+pub mod ipc;
+pub mod kernels;
 pub mod logger;
+pub mod memory;
+pub mod numa;
+pub mod nvtx;
 pub mod plugin;
+pub mod profiler;
+pub mod refitter;
 pub mod runtime;
+pub mod stream;
+pub mod vmm;
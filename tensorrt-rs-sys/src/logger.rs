@@ -1,5 +1,6 @@
 use crate::ffi;
 use cxx::UniquePtr;
+use std::time::Duration;
 
 pub struct Logger(pub(crate) UniquePtr<ffi::Logger>);
 
@@ -12,11 +13,48 @@ pub enum Severity {
     Verbose = 4,
 }
 
+impl Severity {
+    fn from_raw(severity: i32) -> Self {
+        match severity {
+            0 => Self::InternalError,
+            1 => Self::Error,
+            2 => Self::Warning,
+            3 => Self::Info,
+            _ => Self::Verbose,
+        }
+    }
+}
+
+// Receives messages in place of the spdlog sinks; called on whichever thread TensorRT logs
+// from, so it should only hand the message off (e.g. to tracing or a channel).
+pub struct LogCallback(Box<dyn Fn(Severity, &str) + Send + Sync>);
+
+impl LogCallback {
+    fn on_log(&self, severity: i32, msg: &[u8]) {
+        (self.0)(Severity::from_raw(severity), &String::from_utf8_lossy(msg));
+    }
+}
+
+// What the async backend does when its queue is full.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum AsyncOverflowPolicy {
+    // the logging thread waits for room
+    Block = 0,
+    // the oldest queued message is dropped
+    OverrunOldest = 1,
+    // the new message is dropped
+    DiscardNew = 2,
+}
+
 impl Logger {
     pub fn new() -> Self {
         Self(ffi::create_logger())
     }
 
+    pub fn with_name(name: &str) -> Self {
+        Self(ffi::create_named_logger(name))
+    }
+
     pub fn log(&mut self, severity: Severity, msg: &str) {
         self.0.pin_mut().log(severity as _, msg);
     }
@@ -25,6 +63,73 @@ impl Logger {
         self.0.pin_mut().set_level(severity as _);
     }
 
+    pub fn set_name(&mut self, name: &str) {
+        self.0.pin_mut().set_name(name);
+    }
+
+    pub fn get_name(&self) -> String {
+        self.0.get_name()
+    }
+
+    // Hands messages to a background thread through a bounded queue of `queue_size` entries,
+    // so TensorRT never blocks on console or file I/O inside build or enqueue calls.
+    pub fn set_async(&mut self, queue_size: usize, policy: AsyncOverflowPolicy) -> bool {
+        self.0.pin_mut().set_async(queue_size, policy as _)
+    }
+
+    pub fn is_async(&self) -> bool {
+        self.0.is_async()
+    }
+
+    pub fn flush(&mut self) {
+        self.0.pin_mut().flush();
+    }
+
+    // Messages up to `severity` (typically Verbose) are kept in a ring of `capacity` entries
+    // with no I/O, while only those within set_level are written out.
+    pub fn enable_capture(&mut self, capacity: usize, severity: Severity) -> bool {
+        self.0.pin_mut().enable_capture(capacity, severity as _)
+    }
+
+    pub fn disable_capture(&mut self) {
+        self.0.pin_mut().disable_capture();
+    }
+
+    // The last `lines` captured messages, formatted and oldest first; 0 returns all of them.
+    pub fn dump_captured(&self, lines: usize) -> Vec<String> {
+        self.0.dump_captured(lines)
+    }
+
+    // Writes the captured messages out through the regular sinks and clears the ring.
+    pub fn replay_captured(&mut self) {
+        self.0.pin_mut().replay_captured();
+    }
+
+    // Drops identical consecutive messages within `dedup_window`, and lets every distinct
+    // message through at most `burst` times plus `rate_per_sec` per second. Dropped copies
+    // are reported as "(suppressed N times)" on the next one that gets through.
+    pub fn enable_rate_limit(&mut self, rate_per_sec: f64, burst: u32, dedup_window: Duration) -> bool {
+        let window = dedup_window.as_millis().min(u32::MAX as u128) as u32;
+        self.0.pin_mut().enable_rate_limit(rate_per_sec, burst, window)
+    }
+
+    pub fn disable_rate_limit(&mut self) {
+        self.0.pin_mut().disable_rate_limit();
+    }
+
+    // Forwards every message that passes the level (and rate limit, if any) to `callback`
+    // unformatted, instead of writing it to the spdlog sinks. Capture still applies.
+    pub fn set_callback<F>(&mut self, callback: F)
+    where
+        F: Fn(Severity, &str) + Send + Sync + 'static,
+    {
+        self.0.pin_mut().set_callback(Box::new(LogCallback(Box::new(callback))));
+    }
+
+    pub fn clear_callback(&mut self) {
+        self.0.pin_mut().clear_callback();
+    }
+
     pub fn error(&mut self, msg: &str) {
         self.log(Severity::Error, msg);
     }
@@ -62,4 +167,93 @@ mod tests {
         logger.error("Hello, world!");
         logger.log(Severity::InternalError, "Hello, world!");
     }
+
+    #[test]
+    fn test_logger_instances() {
+        let mut quiet = Logger::with_name("quiet");
+        let mut loud = Logger::new();
+        quiet.set_level(Severity::Error);
+        loud.set_level(Severity::Verbose);
+        loud.set_name("loud");
+        assert_eq!(quiet.get_name(), "quiet");
+        assert_eq!(loud.get_name(), "loud");
+
+        // levels and captures stay with their own instance
+        assert!(quiet.enable_capture(8, Severity::Error));
+        assert!(loud.enable_capture(8, Severity::Verbose));
+        let (sender, receiver) = std::sync::mpsc::channel();
+        quiet.set_callback(move |_, msg| {
+            sender.send(msg.to_string()).ok();
+        });
+        quiet.info("not shown");
+        quiet.error("quiet error");
+        loud.verbose("shown");
+        let received: Vec<_> = receiver.try_iter().collect();
+        assert_eq!(received, vec!["quiet error"]);
+        let quiet_dump = quiet.dump_captured(0);
+        assert_eq!(quiet_dump.len(), 1);
+        assert!(quiet_dump[0].ends_with("quiet error"));
+        let loud_dump = loud.dump_captured(0);
+        assert_eq!(loud_dump.len(), 1);
+        assert!(loud_dump[0].ends_with("shown"));
+        quiet.clear_callback();
+    }
+
+    #[test]
+    fn test_logger_capture() {
+        let mut logger = Logger::new();
+        logger.set_level(Severity::Warning);
+        assert!(logger.enable_capture(2, Severity::Verbose));
+        logger.verbose("first {}");
+        logger.verbose("second");
+        logger.info("third");
+        let dump = logger.dump_captured(0);
+        assert_eq!(dump.len(), 2);
+        assert!(dump[0].ends_with("second"));
+        assert!(dump[1].ends_with("third"));
+        logger.disable_capture();
+        assert!(logger.dump_captured(0).is_empty());
+    }
+
+    #[test]
+    fn test_logger_callback() {
+        let (sender, receiver) = std::sync::mpsc::channel();
+        let mut logger = Logger::new();
+        logger.set_level(Severity::Info);
+        logger.set_callback(move |severity, msg| {
+            sender.send((severity, msg.to_string())).ok();
+        });
+        logger.verbose("dropped");
+        logger.warning("kept {}");
+        logger.clear_callback();
+        logger.warning("to stdout");
+        let received: Vec<_> = receiver.try_iter().collect();
+        assert_eq!(received, vec![(Severity::Warning, "kept {}".to_string())]);
+    }
+
+    #[test]
+    fn test_logger_rate_limit() {
+        let (sender, receiver) = std::sync::mpsc::channel();
+        let mut logger = Logger::new();
+        logger.set_level(Severity::Warning);
+        // the ring keeps every message, limited or not
+        assert!(logger.enable_capture(16, Severity::Warning));
+        assert!(logger.enable_rate_limit(0.001, 2, Duration::ZERO));
+        logger.set_callback(move |_, msg| {
+            sender.send(msg.to_string()).ok();
+        });
+        for _ in 0..10 {
+            logger.warning("profile mismatch");
+        }
+        logger.warning("other warning");
+        let received: Vec<_> = receiver.try_iter().collect();
+        assert_eq!(received, vec!["profile mismatch", "profile mismatch", "other warning"]);
+        assert_eq!(logger.dump_captured(0).len(), 11);
+
+        logger.disable_rate_limit();
+        logger.warning("profile mismatch");
+        assert_eq!(receiver.try_iter().count(), 1);
+        logger.clear_callback();
+        logger.disable_capture();
+    }
 }
@@ -0,0 +1,227 @@
+use crate::ffi;
+use cuda_rs::stream::CuStream;
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum MemcpyKind {
+    HostToHost = 0,
+    HostToDevice = 1,
+    DeviceToHost = 2,
+    DeviceToDevice = 3,
+    // Direction inferred from the pointers (unified virtual addressing).
+    Default = 4,
+}
+
+// Stream-ordered copy between raw addresses, e.g. into row k of a batched device buffer.
+// Safety: both ranges must be valid for `size` bytes until the copy has completed on `stream`.
+pub unsafe fn memcpy_async(
+    dst: usize,
+    src: usize,
+    size: usize,
+    kind: MemcpyKind,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::memcpy_async(dst, src, size, kind as _, stream_raw as _)
+}
+
+// Copies `height` rows of `width` bytes between buffers with different row pitches, e.g.
+// into a zero-padded, larger image.
+// Safety: both ranges must be valid for `pitch * height` bytes until the copy has completed.
+pub unsafe fn memcpy_2d_async(
+    dst: usize,
+    dst_pitch: usize,
+    src: usize,
+    src_pitch: usize,
+    width: usize,
+    height: usize,
+    kind: MemcpyKind,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::memcpy_2d_async(dst, dst_pitch, src, src_pitch, width, height, kind as _, stream_raw as _)
+}
+
+// Copies `depth` slices of `height` rows of `width` bytes, e.g. a [C, H, W] box into a
+// larger [C', H', W'] tensor. Rows are `*_pitch` bytes apart and slices `*_pitch * *_height`.
+// Safety: both ranges must be valid until the copy has completed on `stream`.
+pub unsafe fn memcpy_3d_async(
+    dst: usize,
+    dst_pitch: usize,
+    dst_height: usize,
+    src: usize,
+    src_pitch: usize,
+    src_height: usize,
+    width: usize,
+    height: usize,
+    depth: usize,
+    kind: MemcpyKind,
+    stream: &CuStream,
+) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::memcpy_3d_async(
+        dst, dst_pitch, dst_height, src, src_pitch, src_height, width, height, depth, kind as _, stream_raw as _,
+    )
+}
+
+// Safety: `dst` must be valid for `size` bytes of device memory.
+pub unsafe fn memset_async(dst: usize, value: u8, size: usize, stream: &CuStream) -> bool {
+    let stream_raw = stream.get_raw();
+    ffi::memset_async(dst, value as _, size, stream_raw as _)
+}
+
+// The device that owns `ptr`, or None for host or non-CUDA memory.
+pub fn get_pointer_device(ptr: usize) -> Option<i32> {
+    match ffi::get_pointer_device(ptr) {
+        device if device >= 0 => Some(device),
+        _ => None,
+    }
+}
+
+// Page-locked host allocation used for staging host<->device copies.
+pub struct PinnedMemory {
+    ptr: usize,
+    size: usize,
+    // NUMA node the pages are bound to, for buffers from new_on_node
+    node: Option<i32>,
+}
+
+unsafe impl Send for PinnedMemory {}
+unsafe impl Sync for PinnedMemory {}
+
+impl PinnedMemory {
+    pub fn new(size: usize) -> Option<Self> {
+        let ptr = ffi::host_alloc(size.max(1));
+        if ptr == 0 {
+            None
+        } else {
+            Some(Self { ptr, size, node: None })
+        }
+    }
+
+    // Like new, with the pages placed on NUMA `node` (see numa::get_device_node).
+    pub fn new_on_node(size: usize, node: i32) -> Option<Self> {
+        let ptr = ffi::host_alloc_on_node(size.max(1), node);
+        if ptr == 0 {
+            None
+        } else {
+            Some(Self { ptr, size, node: Some(node) })
+        }
+    }
+
+    pub fn node(&self) -> Option<i32> {
+        self.node
+    }
+
+    pub fn len(&self) -> usize {
+        self.size
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.size == 0
+    }
+
+    pub fn get_raw(&self) -> usize {
+        self.ptr
+    }
+
+    // Safety: no async copy into this buffer may be in flight.
+    pub unsafe fn as_slice(&self) -> &[u8] {
+        std::slice::from_raw_parts(self.ptr as *const u8, self.size)
+    }
+
+    // Safety: no async copy from or into this buffer may be in flight.
+    pub unsafe fn as_mut_slice(&mut self) -> &mut [u8] {
+        std::slice::from_raw_parts_mut(self.ptr as *mut u8, self.size)
+    }
+}
+
+impl Drop for PinnedMemory {
+    fn drop(&mut self) {
+        match self.node {
+            Some(_) => ffi::free_host_on_node(self.ptr, self.size.max(1)),
+            None => ffi::free_host(self.ptr),
+        }
+    }
+}
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum HostMemoryKind {
+    // cudaHostAlloc(cudaHostAllocMapped): pinned, with a device alias of the same pages
+    Mapped,
+    // cudaMallocManaged: one pointer on host and device, migrated on demand on discrete GPUs
+    Managed,
+}
+
+// Host memory the device reads and writes in place: no copies on integrated GPUs, and
+// accesses over PCIe (mapped) or page migration (managed) on discrete ones.
+pub struct MappedMemory {
+    host: usize,
+    device: usize,
+    size: usize,
+    kind: HostMemoryKind,
+}
+
+unsafe impl Send for MappedMemory {}
+unsafe impl Sync for MappedMemory {}
+
+impl MappedMemory {
+    pub fn new(size: usize, kind: HostMemoryKind) -> Option<Self> {
+        let host = match kind {
+            HostMemoryKind::Mapped => ffi::host_alloc_mapped(size.max(1)),
+            HostMemoryKind::Managed => ffi::managed_alloc(size.max(1)),
+        };
+        if host == 0 {
+            return None;
+        }
+        let device = match kind {
+            HostMemoryKind::Mapped => ffi::get_mapped_device_pointer(host),
+            HostMemoryKind::Managed => host,
+        };
+        let mem = Self { host, device, size, kind };
+        // freed on the way out
+        if device == 0 {
+            return None;
+        }
+        Some(mem)
+    }
+
+    pub fn kind(&self) -> HostMemoryKind {
+        self.kind
+    }
+
+    pub fn len(&self) -> usize {
+        self.size
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.size == 0
+    }
+
+    pub fn get_raw(&self) -> usize {
+        self.host
+    }
+
+    // The address kernels and TensorRT bindings use; equal to get_raw under UVA.
+    pub fn get_device_ptr(&self) -> usize {
+        self.device
+    }
+
+    // Safety: no device work writing this buffer may be in flight.
+    pub unsafe fn as_slice(&self) -> &[u8] {
+        std::slice::from_raw_parts(self.host as *const u8, self.size)
+    }
+
+    // Safety: no device work reading or writing this buffer may be in flight.
+    pub unsafe fn as_mut_slice(&mut self) -> &mut [u8] {
+        std::slice::from_raw_parts_mut(self.host as *mut u8, self.size)
+    }
+}
+
+impl Drop for MappedMemory {
+    fn drop(&mut self) {
+        match self.kind {
+            HostMemoryKind::Mapped => ffi::free_host(self.host),
+            HostMemoryKind::Managed => ffi::free_managed(self.host),
+        }
+    }
+}
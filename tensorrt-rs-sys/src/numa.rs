@@ -0,0 +1,79 @@
+use crate::{device, ffi};
+use std::fs;
+
+// NUMA node of the CPU socket closest to `device`, from its PCI topology in sysfs. None on
+// single-node machines and where the topology is unknown.
+pub fn get_device_node(device: i32) -> Option<i32> {
+    let bus_id = device::get_pci_bus_id(device).to_lowercase();
+    if bus_id.is_empty() {
+        return None;
+    }
+    let node = fs::read_to_string(format!("/sys/bus/pci/devices/{}/numa_node", bus_id)).ok()?;
+    match node.trim().parse::<i32>() {
+        Ok(node) if node >= 0 => Some(node),
+        _ => None,
+    }
+}
+
+pub fn get_node_cpus(node: i32) -> Vec<u32> {
+    match fs::read_to_string(format!("/sys/devices/system/node/node{}/cpulist", node)) {
+        Ok(list) => parse_cpu_list(&list),
+        Err(_) => Vec::new(),
+    }
+}
+
+// CPUs attached to the PCI root of `device`, usually its NUMA node's; empty where unknown.
+pub fn get_device_cpus(device: i32) -> Vec<u32> {
+    let bus_id = device::get_pci_bus_id(device).to_lowercase();
+    if bus_id.is_empty() {
+        return Vec::new();
+    }
+    match fs::read_to_string(format!("/sys/bus/pci/devices/{}/local_cpulist", bus_id)) {
+        Ok(list) => parse_cpu_list(&list),
+        Err(_) => Vec::new(),
+    }
+}
+
+// CPUs removed from the scheduler with isolcpus=; empty if none are.
+pub fn get_isolated_cpus() -> Vec<u32> {
+    match fs::read_to_string("/sys/devices/system/cpu/isolated") {
+        Ok(list) => parse_cpu_list(&list),
+        Err(_) => Vec::new(),
+    }
+}
+
+// Restricts the calling thread to the CPUs of `node`.
+pub fn bind_thread_to_node(node: i32) -> bool {
+    bind_thread_to_cpus(&get_node_cpus(node))
+}
+
+pub fn bind_thread_to_cpus(cpus: &[u32]) -> bool {
+    !cpus.is_empty() && ffi::set_thread_affinity(cpus)
+}
+
+// Parses a kernel CPU list such as "0-15,32-47".
+pub fn parse_cpu_list(list: &str) -> Vec<u32> {
+    let mut cpus = Vec::new();
+    for range in list.trim().split(',').filter(|range| !range.is_empty()) {
+        let bounds = match range.split_once('-') {
+            Some((first, last)) => (first.parse::<u32>(), last.parse::<u32>()),
+            None => (range.parse::<u32>(), range.parse::<u32>()),
+        };
+        if let (Ok(first), Ok(last)) = bounds {
+            cpus.extend(first..=last);
+        }
+    }
+    cpus
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn parses_cpu_lists() {
+        assert_eq!(parse_cpu_list("0-3,8,10-11\n"), vec![0, 1, 2, 3, 8, 10, 11]);
+        assert_eq!(parse_cpu_list("5"), vec![5]);
+        assert!(parse_cpu_list("\n").is_empty());
+    }
+}
@@ -0,0 +1,22 @@
+use crate::ffi;
+
+// False unless the crate is built with the `nvtx` feature, when every call below is a no-op.
+pub fn is_enabled() -> bool {
+    ffi::nvtx_enabled()
+}
+
+// Names `category` in the "tensorrt-rs" domain, as shown by Nsight Systems.
+pub fn name_category(category: u32, name: &str) {
+    ffi::nvtx_name_category(category, name)
+}
+
+// Opens a range on the calling thread until the matching range_pop. `message` must end with
+// a NUL.
+pub fn range_push(category: u32, message: &'static str) {
+    assert!(message.ends_with('\0'));
+    ffi::nvtx_range_push(category, message)
+}
+
+pub fn range_pop() {
+    ffi::nvtx_range_pop()
+}
@@ -1,4 +1,9 @@
-use crate::ffi;
+use crate::{
+    ffi,
+    runtime::{DataType, TensorDims},
+};
+
+pub use crate::ffi::{PluginCreatorInfo, PluginDimExpr, PluginField, PluginTensor};
 
 pub type PluginLibraryHandle = usize;
 
@@ -9,3 +14,242 @@ pub fn load_library(plugin_path: &str) -> PluginLibraryHandle {
 pub fn unload_library(handle: PluginLibraryHandle) {
     ffi::unload_library(handle)
 }
+
+// initLibNvInferPlugins, once per process; later calls return the first result, whatever
+// their namespace.
+pub fn init_lib_nvinfer_plugins(plugin_namespace: &str) -> bool {
+    ffi::init_lib_nvinfer_plugins(plugin_namespace)
+}
+
+pub fn get_plugin_creators() -> Vec<PluginCreatorInfo> {
+    ffi::get_plugin_creators()
+}
+
+// One dim of a plugin output shape, in terms of the input shapes.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum OutputDim {
+    // dim (second) of input (first)
+    Input(i32, i32),
+    Constant(i32),
+}
+
+impl PluginTensor {
+    pub fn dtype(&self) -> Option<DataType> {
+        DataType::from_i32(self.dtype)
+    }
+}
+
+// nvinfer1::PluginFieldType values of the typed constructors below.
+pub const FIELD_FLOAT32: i32 = 1;
+pub const FIELD_INT32: i32 = 5;
+pub const FIELD_CHAR: i32 = 6;
+pub const FIELD_UNKNOWN: i32 = 8;
+
+impl PluginField {
+    pub fn bytes(name: &str, data: &[u8]) -> Self {
+        Self { name: name.to_string(), field_type: FIELD_UNKNOWN, length: data.len() as i32, data: data.to_vec() }
+    }
+
+    pub fn string(name: &str, value: &str) -> Self {
+        Self { field_type: FIELD_CHAR, ..Self::bytes(name, value.as_bytes()) }
+    }
+
+    pub fn i32s(name: &str, values: &[i32]) -> Self {
+        let data = values.iter().flat_map(|value| value.to_ne_bytes()).collect();
+        Self { name: name.to_string(), field_type: FIELD_INT32, length: values.len() as i32, data }
+    }
+
+    pub fn f32s(name: &str, values: &[f32]) -> Self {
+        let data = values.iter().flat_map(|value| value.to_ne_bytes()).collect();
+        Self { name: name.to_string(), field_type: FIELD_FLOAT32, length: values.len() as i32, data }
+    }
+
+    // None unless the field holds INT32 values.
+    pub fn as_i32s(&self) -> Option<Vec<i32>> {
+        match self.field_type {
+            FIELD_INT32 => Some(self.data.chunks_exact(4).map(|c| i32::from_ne_bytes([c[0], c[1], c[2], c[3]])).collect()),
+            _ => None,
+        }
+    }
+
+    pub fn as_f32s(&self) -> Option<Vec<f32>> {
+        match self.field_type {
+            FIELD_FLOAT32 => Some(self.data.chunks_exact(4).map(|c| f32::from_ne_bytes([c[0], c[1], c[2], c[3]])).collect()),
+            _ => None,
+        }
+    }
+}
+
+// Rust-implementable IPluginV3 (core, build and runtime capabilities). The builder runs the
+// type, shape and format queries; every execution context runs its own clone, so the
+// mutable calls never run concurrently on one instance. Addresses and the stream are raw
+// device pointers and cudaStream_t.
+pub trait Plugin: Send {
+    fn num_outputs(&self) -> i32;
+
+    // One type per output, from the input types; None rejects the inputs.
+    fn output_types(&self, inputs: &[DataType]) -> Option<Vec<DataType>>;
+
+    // The dims of every output, from the ranks of the inputs.
+    fn output_shapes(&self, input_ranks: &[i32]) -> Vec<Vec<OutputDim>>;
+
+    // Whether IO tensor `pos` (inputs first, then outputs) may be of type `types[pos]`, given
+    // the types already chosen for the tensors before it. Only linear formats are offered.
+    fn supports_type(&self, pos: i32, types: &[DataType]) -> bool;
+
+    // Scratch needed by enqueue, for the max shapes of the profile.
+    fn workspace_size(&self, _inputs: &[TensorDims], _outputs: &[TensorDims]) -> usize {
+        0
+    }
+
+    fn on_shape_change(&mut self, _inputs: &[PluginTensor], _outputs: &[PluginTensor]) -> bool {
+        true
+    }
+
+    fn enqueue(&mut self, inputs: &[PluginTensor], outputs: &[PluginTensor], workspace: usize, stream: usize) -> bool;
+
+    // Stored in the plan and handed to PluginCreator::create when it is deserialized.
+    fn serialize(&self) -> Vec<PluginField> {
+        Vec::new()
+    }
+
+    fn clone_plugin(&self) -> Box<dyn Plugin>;
+}
+
+pub trait PluginCreator: Send + Sync {
+    // From the attributes of the network layer, or the fields of Plugin::serialize when an
+    // engine is deserialized. None rejects them.
+    fn create(&self, name: &str, fields: &[PluginField]) -> Option<Box<dyn Plugin>>;
+}
+
+pub struct RustPlugin(Option<Box<dyn Plugin>>);
+
+// Types TensorRT asks about that DataType does not cover are treated as unsupported.
+fn to_dtypes(dtypes: &[i32]) -> Option<Vec<DataType>> {
+    dtypes.iter().map(|&dtype| DataType::from_i32(dtype)).collect()
+}
+
+impl RustPlugin {
+    fn plugin(&self) -> &dyn Plugin {
+        self.0.as_deref().unwrap()
+    }
+
+    fn plugin_mut(&mut self) -> &mut dyn Plugin {
+        self.0.as_deref_mut().unwrap()
+    }
+
+    pub(crate) fn is_valid(&self) -> bool {
+        self.0.is_some()
+    }
+
+    pub(crate) fn num_outputs(&self) -> i32 {
+        self.plugin().num_outputs()
+    }
+
+    pub(crate) fn output_types(&self, inputs: &[i32], outputs: &mut [i32]) -> bool {
+        let types = match to_dtypes(inputs).and_then(|inputs| self.plugin().output_types(&inputs)) {
+            Some(types) if types.len() == outputs.len() => types,
+            _ => return false,
+        };
+        for (output, dtype) in outputs.iter_mut().zip(types) {
+            *output = dtype as i32;
+        }
+        true
+    }
+
+    pub(crate) fn output_shapes(&self, input_ranks: &[i32]) -> Vec<PluginDimExpr> {
+        to_dim_exprs(self.plugin().output_shapes(input_ranks))
+    }
+
+    pub(crate) fn supports_type(&self, pos: i32, types: &[i32]) -> bool {
+        match to_dtypes(types) {
+            Some(types) => self.plugin().supports_type(pos, &types),
+            None => false,
+        }
+    }
+
+    pub(crate) fn workspace_size(&self, inputs: &[TensorDims], outputs: &[TensorDims]) -> usize {
+        self.plugin().workspace_size(inputs, outputs)
+    }
+
+    pub(crate) fn on_shape_change(&mut self, inputs: &[PluginTensor], outputs: &[PluginTensor]) -> bool {
+        self.plugin_mut().on_shape_change(inputs, outputs)
+    }
+
+    pub(crate) fn enqueue(
+        &mut self,
+        inputs: &[PluginTensor],
+        outputs: &[PluginTensor],
+        workspace: usize,
+        stream: usize,
+    ) -> bool {
+        self.plugin_mut().enqueue(inputs, outputs, workspace, stream)
+    }
+
+    pub(crate) fn serialize(&self) -> Vec<PluginField> {
+        self.plugin().serialize()
+    }
+
+    pub(crate) fn clone_plugin(&self) -> Box<RustPlugin> {
+        Box::new(RustPlugin(Some(self.plugin().clone_plugin())))
+    }
+}
+
+fn to_dim_exprs(shapes: Vec<Vec<OutputDim>>) -> Vec<PluginDimExpr> {
+    let mut exprs = Vec::new();
+    for (output, dims) in shapes.into_iter().enumerate() {
+        for (dim, expr) in dims.into_iter().enumerate() {
+            let (input, value) = match expr {
+                OutputDim::Input(input, dim) => (input, dim),
+                OutputDim::Constant(value) => (-1, value),
+            };
+            exprs.push(PluginDimExpr { output: output as i32, dim: dim as i32, input, value });
+        }
+    }
+    exprs
+}
+
+pub struct RustPluginCreator(Box<dyn PluginCreator>);
+
+impl RustPluginCreator {
+    pub(crate) fn create(&self, name: &str, fields: &[PluginField]) -> Box<RustPlugin> {
+        Box::new(RustPlugin(self.0.create(name, fields)))
+    }
+}
+
+// Registers `creator` with the plugin registry for the rest of the process, so that the ONNX
+// parser and plan deserialization find it by name and version.
+pub fn register_plugin_creator<C: PluginCreator + 'static>(
+    name: &str,
+    version: &str,
+    plugin_namespace: &str,
+    creator: C,
+) -> bool {
+    let creator = Box::new(RustPluginCreator(Box::new(creator)));
+    ffi::register_plugin_creator(name, version, plugin_namespace, creator)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn output_dims_flatten_per_output() {
+        let exprs = to_dim_exprs(vec![vec![OutputDim::Input(0, 0), OutputDim::Constant(4)], vec![OutputDim::Input(1, 2)]]);
+        assert_eq!(
+            exprs,
+            vec![
+                PluginDimExpr { output: 0, dim: 0, input: 0, value: 0 },
+                PluginDimExpr { output: 0, dim: 1, input: -1, value: 4 },
+                PluginDimExpr { output: 1, dim: 0, input: 1, value: 2 },
+            ]
+        );
+    }
+
+    #[test]
+    fn fields_round_trip() {
+        assert_eq!(PluginField::i32s("k", &[3, -1]).as_i32s(), Some(vec![3, -1]));
+        assert_eq!(PluginField::f32s("s", &[0.5]).as_f32s(), Some(vec![0.5]));
+        assert_eq!(PluginField::string("s", "x").as_i32s(), None);
+    }
+}
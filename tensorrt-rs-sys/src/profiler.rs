@@ -0,0 +1,42 @@
+use crate::ffi;
+use cxx::UniquePtr;
+
+pub use crate::ffi::LayerTiming;
+
+impl LayerTiming {
+    pub fn mean_ms(&self) -> f64 {
+        match self.count {
+            0 => 0.0,
+            count => self.total_ms / count as f64,
+        }
+    }
+}
+
+// IProfiler that aggregates per-layer timings (count, total, min, max, p50/p90/p99) across
+// every enqueue of the contexts it is attached to. Reporting is lock-free after the first
+// enqueue, so it can stay attached under production traffic.
+pub struct LayerProfiler(pub(crate) UniquePtr<ffi::Profiler>);
+
+unsafe impl Send for LayerProfiler {}
+unsafe impl Sync for LayerProfiler {}
+
+impl LayerProfiler {
+    pub fn new() -> Self {
+        Self(ffi::create_profiler())
+    }
+
+    // Layers in execution order.
+    pub fn get_layer_timings(&self) -> Vec<LayerTiming> {
+        self.0.get_layer_timings()
+    }
+
+    pub fn reset(&self) {
+        self.0.reset()
+    }
+}
+
+impl Default for LayerProfiler {
+    fn default() -> Self {
+        Self::new()
+    }
+}
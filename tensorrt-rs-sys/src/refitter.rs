@@ -0,0 +1,58 @@
+use crate::{
+    ffi,
+    logger::Logger,
+    runtime::{CudaEngine, DataType},
+};
+use cuda_rs::stream::CuStream;
+use cxx::UniquePtr;
+
+// IRefitter: updates the weights of a refittable engine in place, so every context and
+// device buffer created from it stays valid.
+pub struct Refitter(UniquePtr<ffi::Refitter>);
+
+unsafe impl Send for Refitter {}
+
+impl Refitter {
+    // `logger` must outlive the refitter.
+    pub fn new(engine: &mut CudaEngine, logger: &mut Logger) -> Option<Self> {
+        let refitter = ffi::create_refitter(engine.0.pin_mut(), logger.0.pin_mut());
+        if refitter.is_null() {
+            None
+        } else {
+            Some(Self(refitter))
+        }
+    }
+
+    // Stages new values for the weights called `name` (see get_all_weights). Device-resident
+    // weights need TensorRT 10.
+    // Safety: `values` must hold `count` elements of `dtype` until refit has completed.
+    pub unsafe fn set_named_weights(
+        &mut self,
+        name: &str,
+        dtype: DataType,
+        values: usize,
+        count: usize,
+        on_device: bool,
+    ) -> bool {
+        self.0.pin_mut().set_named_weights(name, dtype as _, values, count as _, on_device)
+    }
+
+    // Weights that still have to be set before refit can succeed.
+    pub fn get_missing_weights(&self) -> Vec<String> {
+        self.0.get_missing_weights()
+    }
+
+    pub fn get_all_weights(&self) -> Vec<String> {
+        self.0.get_all_weights()
+    }
+
+    // Applies the staged weights, ordered on `stream` (synchronously before TensorRT 10).
+    pub fn refit(&mut self, stream: &CuStream) -> bool {
+        let stream_raw = unsafe { stream.get_raw() };
+        self.0.pin_mut().refit_async(stream_raw as _)
+    }
+
+    pub fn set_max_threads(&mut self, threads: i32) -> bool {
+        self.0.pin_mut().set_max_threads(threads)
+    }
+}
@@ -1,6 +1,74 @@
-use crate::{ffi, logger::Logger};
+use crate::{
+    allocator::DeviceAllocator, builder::HostMemory, error_recorder::ErrorRecorder, ffi, logger::Logger,
+    profiler::LayerProfiler, stream::CudaEvent,
+};
 use cxx::UniquePtr;
 use cuda_rs::{event::CuEvent, stream::CuStream};
+use std::{
+    io::{ErrorKind, Read},
+    marker::PhantomData,
+};
+
+pub use crate::ffi::{BindingError, BindingStatus, TensorBinding, TensorDims};
+
+pub const MAX_DIMS: usize = 8;
+
+impl TensorDims {
+    pub fn new(dims: &[i32]) -> Self {
+        assert!(dims.len() <= MAX_DIMS, "Too many dimensions: {}", dims.len());
+        let mut d = [0; MAX_DIMS];
+        d[..dims.len()].copy_from_slice(dims);
+        Self { nb_dims: dims.len() as i32, d }
+    }
+
+    // Empty for invalid dims (nb_dims == -1).
+    pub fn as_slice(&self) -> &[i32] {
+        let nb_dims = self.nb_dims.clamp(0, MAX_DIMS as i32) as usize;
+        &self.d[..nb_dims]
+    }
+
+    pub fn is_valid(&self) -> bool {
+        self.nb_dims >= 0
+    }
+
+    pub fn invalid() -> Self {
+        Self { nb_dims: -1, d: [0; MAX_DIMS] }
+    }
+}
+
+impl TensorBinding {
+    pub fn address(handle: TensorHandle, address: usize) -> Self {
+        Self { handle, address, dims: TensorDims::invalid(), capacity: -1 }
+    }
+
+    pub fn input(handle: TensorHandle, address: usize, dims: &TensorDims) -> Self {
+        Self { handle, address, dims: *dims, capacity: -1 }
+    }
+
+    pub fn shape(handle: TensorHandle, dims: &TensorDims) -> Self {
+        Self { handle, address: 0, dims: *dims, capacity: -1 }
+    }
+
+    // An output whose memory at `address` holds `capacity` elements.
+    pub fn output(handle: TensorHandle, address: usize, capacity: usize) -> Self {
+        Self { handle, address, dims: TensorDims::invalid(), capacity: capacity as i64 }
+    }
+}
+
+impl BindingStatus {
+    pub fn is_ok(&self) -> bool {
+        self.error == BindingError::NONE
+    }
+
+    pub fn enqueue_failed() -> Self {
+        Self { index: -1, error: BindingError::ENQUEUE }
+    }
+
+    // The binding that failed, if any.
+    pub fn failed_index(&self) -> Option<usize> {
+        usize::try_from(self.index).ok()
+    }
+}
 
 #[derive(Debug, Copy, Clone, PartialEq)]
 pub enum DataType {
@@ -40,6 +108,20 @@ pub enum DataType {
 }
 
 impl DataType {
+    // None for nvinfer1::DataType values this enum does not cover.
+    pub fn from_i32(dtype: i32) -> Option<Self> {
+        match dtype {
+            0 => Some(DataType::FLOAT),
+            1 => Some(DataType::HALF),
+            2 => Some(DataType::INT8),
+            3 => Some(DataType::INT32),
+            4 => Some(DataType::BOOL),
+            5 => Some(DataType::UINT8),
+            6 => Some(DataType::FP8),
+            _ => None,
+        }
+    }
+
     pub fn get_elem_size(&self) -> usize {
         match self {
             DataType::FLOAT => 4,
@@ -73,6 +155,24 @@ impl TensorIOMode {
     }
 }
 
+// Where TensorRT reads or writes an IO tensor: bound addresses of HOST tensors are host
+// memory, and device memory there costs a synchronous copy.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum TensorLocation {
+    DEVICE = 0,
+    HOST = 1,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum OptProfileSelector {
+    // The minimum dimensions an optimization profile accepts.
+    MIN = 0,
+    // The dimensions the profile's kernels were tuned for.
+    OPT = 1,
+    // The maximum dimensions an optimization profile accepts.
+    MAX = 2,
+}
+
 #[derive(Debug, Copy, Clone, PartialEq)]
 pub enum TensorFormat {
     // Row major linear format.
@@ -198,6 +298,27 @@ pub enum TensorFormat {
     DHWC = 12
 }
 
+impl TensorFormat {
+    pub fn from_i32(format: i32) -> Option<Self> {
+        match format {
+            0 => Some(TensorFormat::LINEAR),
+            1 => Some(TensorFormat::CHW2),
+            2 => Some(TensorFormat::HWC8),
+            3 => Some(TensorFormat::CHW4),
+            4 => Some(TensorFormat::CHW16),
+            5 => Some(TensorFormat::CHW32),
+            6 => Some(TensorFormat::DHWC8),
+            7 => Some(TensorFormat::CDHW32),
+            8 => Some(TensorFormat::HWC),
+            9 => Some(TensorFormat::DLALINEAR),
+            10 => Some(TensorFormat::DLAHWC4),
+            11 => Some(TensorFormat::HWC16),
+            12 => Some(TensorFormat::DHWC),
+            _ => None,
+        }
+    }
+}
+
 pub enum EngineCapability {
     //
     // Standard: TensorRT flow without targeting the safety runtime.
@@ -221,6 +342,14 @@ pub enum EngineCapability {
     DLASTANDALONE = 2,
 }
 
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum TempfileControlFlag {
+    // Write to anonymous in-memory files (memfd on Linux).
+    ALLOWINMEMORYFILES = 0,
+    // Write to files in the temporary directory when in-memory files are not available.
+    ALLOWTEMPORARYFILES = 1,
+}
+
 #[derive(Debug, Copy, Clone, PartialEq)]
 pub enum HardwareCompatibilityLevel {
     // Do not require hardware compatibility with GPU architectures other than that of the GPU on which the engine was
@@ -232,6 +361,10 @@ pub enum HardwareCompatibilityLevel {
     // Thus this can decrease the performance, especially for tf32 models.
     // This option will disable cuDNN, cuBLAS, and cuBLAS LT as tactic sources.
     AMPEREPLUS = 1,
+
+    // Require that the engine is compatible with GPUs of the compute capability it was built
+    // on, e.g. every SKU of one architecture.
+    SAMECOMPUTECAPABILITY = 2,
 }
 
 #[derive(Debug, Copy, Clone, PartialEq)]
@@ -241,11 +374,81 @@ pub enum ProfilingVerbosity {
     DETAILED = 2,           //< Print detailed layer information including layer names and layer parameters.
 }
 
+// Feeds plan bytes to IStreamReader::read incrementally, so the plan never has to be
+// fully materialized in host memory.
+pub struct StreamReader(Box<dyn Read>);
+
+impl StreamReader {
+    pub fn new<R: Read + 'static>(reader: R) -> Self {
+        Self(Box::new(reader))
+    }
+
+    // TensorRT treats a short read as the end of the stream, so keep reading until the
+    // buffer is full, EOF is reached or the underlying reader fails.
+    pub(crate) fn read(&mut self, buf: &mut [u8]) -> usize {
+        let mut filled = 0;
+        while filled < buf.len() {
+            match self.0.read(&mut buf[filled..]) {
+                Ok(0) => break,
+                Ok(n) => filled += n,
+                Err(e) if e.kind() == ErrorKind::Interrupted => continue,
+                Err(_) => break,
+            }
+        }
+        filled
+    }
+}
+
+// Backs IOutputAllocator for outputs whose shape is only known during enqueue.
+// `reallocate_output` returns the device address to write to, or 0 on failure. `stream` is
+// the enqueue's stream (reallocateOutputAsync), 0 before TensorRT 10; memory replaced by a
+// new block may still be read by work queued on it.
+pub trait OutputAllocator {
+    fn reallocate_output(
+        &mut self,
+        tensor_name: &str,
+        current_memory: usize,
+        size: u64,
+        alignment: u64,
+        stream: usize,
+    ) -> usize;
+
+    fn notify_shape(&mut self, tensor_name: &str, dims: &[i32]);
+}
+
+pub struct RustOutputAllocator(Box<dyn OutputAllocator>);
+
+impl RustOutputAllocator {
+    pub(crate) fn reallocate_output(
+        &mut self,
+        tensor_name: &str,
+        current_memory: usize,
+        size: u64,
+        alignment: u64,
+        stream: usize,
+    ) -> usize {
+        self.0.reallocate_output(tensor_name, current_memory, size, alignment, stream)
+    }
+
+    pub(crate) fn notify_shape(&mut self, tensor_name: &str, dims: &[i32]) {
+        self.0.notify_shape(tensor_name, dims)
+    }
+}
+
+// Version of the loaded libnvinfer (not of the headers it was compiled against).
+pub fn get_infer_lib_version() -> i32 {
+    ffi::get_infer_lib_version()
+}
+
 pub struct Runtime {
     pub(crate) runtime: UniquePtr<ffi::Runtime>,
     logger: Logger,
 }
 
+// TensorRT runtimes, engines and contexts are not tied to the thread that created them;
+// callers synchronize access (one thread per context, engine behind a lock when shared).
+unsafe impl Send for Runtime {}
+
 impl Runtime {
     pub fn new() -> Option<Self> {
         let mut logger = Logger::new();
@@ -270,6 +473,16 @@ impl Runtime {
         }
     }
 
+    pub fn deserialize_from_reader<R: Read + 'static>(&mut self, reader: R) -> Option<CudaEngine> {
+        let mut reader = StreamReader::new(reader);
+        let engine = self.runtime.pin_mut().deserialize_from_stream(&mut reader);
+        if engine.is_null() {
+            None
+        } else {
+            Some(CudaEngine(engine))
+        }
+    }
+
     pub fn set_max_threads(&mut self, max_threads: i32) -> bool {
         self.runtime.pin_mut().set_max_threads(max_threads)
     }
@@ -285,34 +498,90 @@ impl Runtime {
     pub fn get_engine_host_code_allowed(&self) -> bool {
         self.runtime.get_engine_host_code_allowed()
     }
+
+    // Deserializes with the lean runtime library at `path` (libnvinfer_lean) from here on,
+    // for plans built with VERSIONCOMPATIBLE and EXCLUDELEANRUNTIME by that TensorRT
+    // version. Call before any other setting, which the lean runtime does not inherit.
+    pub fn load_lean_runtime(&mut self, path: &str) -> bool {
+        self.runtime.pin_mut().load_lean_runtime(path)
+    }
+
+    pub fn set_temporary_directory(&mut self, path: &str) {
+        self.runtime.pin_mut().set_temporary_directory(path)
+    }
+
+    // How the lean runtime of a version-compatible plan may be staged to be loaded.
+    pub fn set_tempfile_control_flags(&mut self, flags: &[TempfileControlFlag]) {
+        let flags = flags.iter().fold(0u32, |flags, flag| flags | 1 << *flag as u32);
+        self.runtime.pin_mut().set_tempfile_control_flags(flags)
+    }
+
+    // Engines with DLA layers are deserialized onto this DLA core; set before deserialize.
+    pub fn set_dla_core(&mut self, core: i32) {
+        self.runtime.pin_mut().set_dla_core(core)
+    }
+
+    pub fn get_dla_core(&self) -> i32 {
+        self.runtime.get_dla_core()
+    }
+
+    pub fn get_nb_dla_cores(&self) -> i32 {
+        self.runtime.get_nb_dla_cores()
+    }
+
+    // Must be installed before deserializing; the runtime keeps the allocator alive.
+    pub fn set_gpu_allocator(&mut self, allocator: &DeviceAllocator) {
+        self.runtime.pin_mut().set_gpu_allocator(&allocator.0)
+    }
+
+    // Also used by the engines deserialized afterwards; the runtime keeps it alive.
+    pub fn set_error_recorder(&mut self, recorder: &ErrorRecorder) {
+        self.runtime.pin_mut().set_error_recorder(&recorder.0)
+    }
+}
+
+// Index of an IO tensor, as returned by CudaEngine::get_tensor_handle. Handle-based calls
+// resolve names from a table built once per engine/context and never allocate.
+pub type TensorHandle = i32;
+
+fn to_dtype(dtype: i32) -> DataType {
+    match DataType::from_i32(dtype) {
+        Some(dtype) => dtype,
+        None => panic!("Invalid data type: {}", dtype),
+    }
+}
+
+fn to_io_mode(mode: i32) -> TensorIOMode {
+    match mode {
+        0 => TensorIOMode::NONE,
+        1 => TensorIOMode::INPUT,
+        2 => TensorIOMode::OUTPUT,
+        mode => panic!("Invalid tensor io mode: {}", mode),
+    }
 }
 
 pub struct CudaEngine(pub(crate) UniquePtr<ffi::CudaEngine>);
 
+unsafe impl Send for CudaEngine {}
+// TensorRT allows non-modifying calls on an engine, and creating execution contexts from
+// it, from several threads at once; the modifying calls take &mut self.
+unsafe impl Sync for CudaEngine {}
+
 impl CudaEngine {
     pub fn get_tensor_shape(&self, name: &str) -> Vec<i32> {
         self.0.get_tensor_shape(name)
     }
 
     pub fn get_tensor_dtype(&self, name: &str) -> DataType {
-        match self.0.get_tensor_dtype(name) {
-            0 => DataType::FLOAT as _,
-            1 => DataType::HALF as _,
-            2 => DataType::INT8 as _,
-            3 => DataType::INT32 as _,
-            4 => DataType::BOOL as _,
-            5 => DataType::UINT8 as _,
-            6 => DataType::FP8 as _,
-            dtype => panic!("Invalid data type: {}", dtype),
-        }
+        to_dtype(self.0.get_tensor_dtype(name))
     }
 
     pub fn get_num_layers(&self) -> i32 {
         self.0.get_num_layers()
     }
 
-    pub fn create_execution_context(&mut self) -> Option<ExecutionContext> {
-        let context = self.0.pin_mut().create_execution_context();
+    pub fn create_execution_context(&self) -> Option<ExecutionContext> {
+        let context = self.0.create_execution_context();
         if context.is_null() {
             None
         } else {
@@ -325,17 +594,27 @@ impl CudaEngine {
     }
 
     pub fn get_tensor_io_mode(&self, name: &str) -> TensorIOMode {
-        match self.0.get_tensor_io_mode(name) {
-            0 => TensorIOMode::NONE,
-            1 => TensorIOMode::INPUT,
-            2 => TensorIOMode::OUTPUT,
-            mode => panic!("Invalid tensor io mode: {}", mode),
+        to_io_mode(self.0.get_tensor_io_mode(name))
+    }
+
+    pub fn get_tensor_location(&self, name: &str) -> TensorLocation {
+        match self.0.get_tensor_location(name) {
+            1 => TensorLocation::HOST,
+            _ => TensorLocation::DEVICE,
+        }
+    }
+
+    pub fn create_engine_inspector(&self) -> Option<EngineInspector<'_>> {
+        let inspector = self.0.create_engine_inspector();
+        if inspector.is_null() {
+            None
+        } else {
+            Some(EngineInspector(inspector, PhantomData))
         }
     }
 
-    pub fn create_execution_context_without_device_memory(&mut self) -> Option<ExecutionContext> {
-        let context =
-            self.0.pin_mut().create_execution_context_without_device_memory();
+    pub fn create_execution_context_without_device_memory(&self) -> Option<ExecutionContext> {
+        let context = self.0.create_execution_context_without_device_memory();
         if context.is_null() {
             None
         } else {
@@ -347,10 +626,53 @@ impl CudaEngine {
         self.0.get_device_memory_size()
     }
 
+    // The scratch of a context bound to `profile`, at most get_device_memory_size, which it is
+    // before TensorRT 10.1.
+    pub fn get_device_memory_size_for_profile(&self, profile: i32) -> Option<usize> {
+        usize::try_from(self.0.get_device_memory_size_for_profile(profile)).ok()
+    }
+
     pub fn is_refittable(&self) -> bool {
         self.0.is_refittable()
     }
 
+    // The plan of the engine as it is now, refits included, e.g. to be saved and deserialized
+    // by a later process.
+    pub fn serialize(&self) -> Option<HostMemory> {
+        let memory = self.0.serialize();
+        if memory.is_null() {
+            None
+        } else {
+            Some(HostMemory(memory))
+        }
+    }
+
+    // Bytes of weights that can be streamed; 0 unless built with BuilderFlag::WEIGHTSTREAMING.
+    pub fn get_streamable_weights_size(&self) -> usize {
+        self.0.get_streamable_weights_size().max(0) as usize
+    }
+
+    // Bytes of streamable weights kept resident on the device. A budget of
+    // get_streamable_weights_size keeps all of them resident. Only takes effect for execution
+    // contexts created afterwards.
+    pub fn set_weight_streaming_budget(&mut self, budget: usize) -> bool {
+        self.0.pin_mut().set_weight_streaming_budget(budget.min(i64::MAX as usize) as i64)
+    }
+
+    pub fn get_weight_streaming_budget(&self) -> usize {
+        self.0.get_weight_streaming_budget().max(0) as usize
+    }
+
+    // TensorRT's budget estimate from the free device memory.
+    pub fn get_weight_streaming_automatic_budget(&self) -> usize {
+        self.0.get_weight_streaming_automatic_budget().max(0) as usize
+    }
+
+    // Scratch memory each context needs for streaming at the current budget.
+    pub fn get_weight_streaming_scratch_memory_size(&self) -> usize {
+        self.0.get_weight_streaming_scratch_memory_size().max(0) as usize
+    }
+
     pub fn get_tensor_bytes_per_component(&self, name: &str) -> i32 {
         self.0.get_tensor_bytes_per_component(name)
     }
@@ -360,21 +682,9 @@ impl CudaEngine {
     }
 
     pub fn get_tensor_format(&self, name: &str) -> TensorFormat {
-        match self.0.get_tensor_format(name) {
-            0 => TensorFormat::LINEAR,
-            1 => TensorFormat::CHW2,
-            2 => TensorFormat::HWC8,
-            3 => TensorFormat::CHW4,
-            4 => TensorFormat::CHW16,
-            5 => TensorFormat::CHW32,
-            6 => TensorFormat::DHWC8,
-            7 => TensorFormat::CDHW32,
-            8 => TensorFormat::HWC,
-            9 => TensorFormat::DLALINEAR,
-            10 => TensorFormat::DLAHWC4,
-            11 => TensorFormat::HWC16,
-            12 => TensorFormat::DHWC,
-            format => panic!("Invalid tensor format: {}", format),
+        match TensorFormat::from_i32(self.0.get_tensor_format(name)) {
+            Some(format) => format,
+            None => panic!("Invalid tensor format: {}", self.0.get_tensor_format(name)),
         }
     }
 
@@ -386,6 +696,11 @@ impl CudaEngine {
         self.0.get_name()
     }
 
+    // Also used by the contexts created afterwards; the engine keeps it alive.
+    pub fn set_error_recorder(&mut self, recorder: &ErrorRecorder) {
+        self.0.pin_mut().set_error_recorder(&recorder.0)
+    }
+
     pub fn get_num_optimization_profiles(&self) -> i32 {
         self.0.get_num_optimization_profiles()
     }
@@ -415,6 +730,7 @@ impl CudaEngine {
         match self.0.get_hardware_compatibility_level() {
             0 => HardwareCompatibilityLevel::NONE,
             1 => HardwareCompatibilityLevel::AMPEREPLUS,
+            2 => HardwareCompatibilityLevel::SAMECOMPUTECAPABILITY,
             level => panic!("Invalid hardware compatibility level: {}", level),
         }
     }
@@ -422,10 +738,86 @@ impl CudaEngine {
     pub fn get_num_aux_streams(&self) -> i32 {
         self.0.get_num_aux_streams()
     }
+
+    // How much layer information the engine was built to report (BuildOptions::profiling_verbosity).
+    pub fn get_profiling_verbosity(&self) -> ProfilingVerbosity {
+        match self.0.get_profiling_verbosity() {
+            0 => ProfilingVerbosity::LAYERNAMESONLY,
+            1 => ProfilingVerbosity::NONE,
+            2 => ProfilingVerbosity::DETAILED,
+            verbosity => panic!("Invalid profiling verbosity: {}", verbosity),
+        }
+    }
+
+    pub fn get_tensor_handle(&self, name: &str) -> Option<TensorHandle> {
+        match self.0.get_tensor_handle(name) {
+            -1 => None,
+            handle => Some(handle),
+        }
+    }
+
+    pub fn get_tensor_shape_by_handle(&self, handle: TensorHandle) -> Vec<i32> {
+        self.0.get_tensor_shape_by_handle(handle)
+    }
+
+    // None for a handle that names no IO tensor of the engine.
+    pub fn get_tensor_dtype_by_handle(&self, handle: TensorHandle) -> Option<DataType> {
+        DataType::from_i32(self.0.get_tensor_dtype_by_handle(handle))
+    }
+
+    pub fn get_tensor_io_mode_by_handle(&self, handle: TensorHandle) -> TensorIOMode {
+        to_io_mode(self.0.get_tensor_io_mode_by_handle(handle))
+    }
+
+    pub fn get_tensor_dims(&self, name: &str) -> TensorDims {
+        self.0.get_tensor_dims(name)
+    }
+
+    pub fn get_tensor_dims_by_handle(&self, handle: TensorHandle) -> TensorDims {
+        self.0.get_tensor_dims_by_handle(handle)
+    }
+
+    // Invalid (nb_dims = -1) if `name` is not an input or `profile` is out of range.
+    pub fn get_profile_shape(&self, name: &str, profile: i32, select: OptProfileSelector) -> TensorDims {
+        self.0.get_profile_dims(name, profile, select as _)
+    }
+
+    // Values of a shape-tensor input for `profile`; empty if `name` is not a shape tensor.
+    pub fn get_profile_tensor_values(&self, name: &str, profile: i32, select: OptProfileSelector) -> Vec<i32> {
+        self.0.get_profile_tensor_values(name, profile, select as _)
+    }
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum LayerInformationFormat {
+    // One line per layer, for logs.
+    ONELINE = 0,
+    // Full JSON, including tactics, formats and fused layers of detailed builds.
+    JSON = 1,
+}
+
+// Borrows the engine it inspects; TensorRT requires the engine to outlive the inspector.
+pub struct EngineInspector<'a>(UniquePtr<ffi::EngineInspector>, PhantomData<&'a CudaEngine>);
+
+impl EngineInspector<'_> {
+    // Lets the inspector report shape-dependent information for the context's input shapes.
+    pub fn set_execution_context(&mut self, context: &ExecutionContext) -> bool {
+        self.0.pin_mut().set_execution_context(&context.0)
+    }
+
+    pub fn get_layer_information(&self, layer_index: i32, format: LayerInformationFormat) -> String {
+        self.0.get_layer_information(layer_index, format as _)
+    }
+
+    pub fn get_engine_information(&self, format: LayerInformationFormat) -> String {
+        self.0.get_engine_information(format as _)
+    }
 }
 
 pub struct ExecutionContext(pub(crate) UniquePtr<ffi::ExecutionContext>);
 
+unsafe impl Send for ExecutionContext {}
+
 impl ExecutionContext {
     pub fn set_debug_sync(&mut self, sync: bool) {
         self.0.pin_mut().set_debug_sync(sync)
@@ -447,6 +839,12 @@ impl ExecutionContext {
         self.0.pin_mut().set_device_memory(memory)
     }
 
+    // `size` bytes at `memory`, enough for the current profile's scratch; set again before
+    // switching to a profile needing more.
+    pub fn set_device_memory_v2(&mut self, memory: usize, size: usize) {
+        self.0.pin_mut().set_device_memory_v2(memory, size as i64)
+    }
+
     pub fn get_tensor_strides(&self, name: &str) -> Vec<i32> {
         self.0.get_tensor_strides(name)
     }
@@ -494,6 +892,24 @@ impl ExecutionContext {
         self.0.pin_mut().report_to_profiler()
     }
 
+    // The context keeps the profiler alive while it is attached.
+    pub fn set_profiler(&mut self, profiler: &LayerProfiler) {
+        self.0.pin_mut().set_profiler(&profiler.0)
+    }
+
+    pub fn unset_profiler(&mut self) {
+        self.0.pin_mut().unset_profiler()
+    }
+
+    // The context keeps the recorder alive while it is attached.
+    pub fn set_error_recorder(&mut self, recorder: &ErrorRecorder) {
+        self.0.pin_mut().set_error_recorder(&recorder.0)
+    }
+
+    pub fn unset_error_recorder(&mut self) {
+        self.0.pin_mut().unset_error_recorder()
+    }
+
     pub fn set_tensor_address(&mut self, name: &str, address: usize) -> bool {
         self.0.pin_mut().set_tensor_address(name, address)
     }
@@ -515,20 +931,70 @@ impl ExecutionContext {
         self.0.pin_mut().set_input_consumed_event(event_raw as _)
     }
 
+    // Same as set_input_consumed_event for events owned by this crate; None unsets it.
+    pub fn set_input_consumed_cuda_event(&mut self, event: Option<&CudaEvent>) -> bool {
+        let event_raw = event.map_or(0, |event| event.get_raw());
+        self.0.pin_mut().set_input_consumed_event(event_raw)
+    }
+
     pub fn get_input_consumed_event(&self) -> CuEvent {
         let event_raw = self.0.get_input_consumed_event();
         unsafe { CuEvent::from_raw(event_raw as _) }
     }
 
+    pub fn set_output_allocator<A: OutputAllocator + 'static>(
+        &mut self,
+        name: &str,
+        allocator: A,
+    ) -> bool {
+        let allocator = Box::new(RustOutputAllocator(Box::new(allocator)));
+        self.0.pin_mut().set_output_allocator(name, allocator)
+    }
+
+    // 0 once all output shapes are known, else the number of inputs still unspecified, or -1
+    // if a shape is invalid.
+    pub fn infer_shapes(&mut self) -> i32 {
+        self.0.pin_mut().infer_shapes()
+    }
+
     pub fn get_max_output_size(&self, name: &str) -> usize {
         self.0.get_max_output_size(name)
     }
 
+    pub fn set_temporary_storage_allocator(&mut self, allocator: &DeviceAllocator) -> bool {
+        self.0.pin_mut().set_temporary_storage_allocator(&allocator.0)
+    }
+
     pub fn enqueue_v3(&mut self, stream: &CuStream) -> bool {
         let stream_raw = unsafe { stream.get_raw() };
         self.0.pin_mut().enqueue_v3(stream_raw as usize)
     }
 
+    // Enqueues on a stream the crate created itself, e.g. a stream::CudaStream with a priority.
+    pub fn enqueue_v3_raw(&mut self, stream: usize) -> bool {
+        self.0.pin_mut().enqueue_v3(stream)
+    }
+
+    pub fn apply_bindings(&mut self, bindings: &[TensorBinding]) -> BindingStatus {
+        self.0.pin_mut().apply_bindings(bindings)
+    }
+
+    // Binds and enqueues in a single call into the bridge.
+    pub fn apply_bindings_and_enqueue(&mut self, bindings: &[TensorBinding], stream: &CuStream) -> BindingStatus {
+        let stream_raw = unsafe { stream.get_raw() };
+        self.0.pin_mut().apply_bindings_and_enqueue(bindings, stream_raw as usize)
+    }
+
+    pub fn apply_bindings_and_enqueue_raw(&mut self, bindings: &[TensorBinding], stream: usize) -> BindingStatus {
+        self.0.pin_mut().apply_bindings_and_enqueue(bindings, stream)
+    }
+
+    // Resolved shapes of all `handles` in one call; `dims` must be at least as long.
+    pub fn get_tensor_dims_many(&self, handles: &[TensorHandle], dims: &mut [TensorDims]) {
+        assert!(dims.len() >= handles.len());
+        self.0.get_tensor_dims_many(handles, dims)
+    }
+
     pub fn set_persistent_cache_limit(&mut self, limit: usize) {
         self.0.pin_mut().set_persistent_cache_limit(limit)
     }
@@ -541,6 +1007,42 @@ impl ExecutionContext {
         self.0.pin_mut().set_nvtx_verbosity(verbosity as _)
     }
 
+    pub fn set_input_shape_by_handle(&mut self, handle: TensorHandle, shape: &[i32]) -> bool {
+        self.0.pin_mut().set_input_shape_by_handle(handle, shape)
+    }
+
+    pub fn get_tensor_shape_by_handle(&self, handle: TensorHandle) -> Vec<i32> {
+        self.0.get_tensor_shape_by_handle(handle)
+    }
+
+    pub fn set_tensor_address_by_handle(&mut self, handle: TensorHandle, address: usize) -> bool {
+        self.0.pin_mut().set_tensor_address_by_handle(handle, address)
+    }
+
+    pub fn get_tensor_address_by_handle(&self, handle: TensorHandle) -> usize {
+        self.0.get_tensor_address_by_handle(handle)
+    }
+
+    pub fn set_input_tensor_address_by_handle(&mut self, handle: TensorHandle, address: usize) -> bool {
+        self.0.pin_mut().set_input_tensor_address_by_handle(handle, address)
+    }
+
+    pub fn set_input_dims_by_handle(&mut self, handle: TensorHandle, dims: &TensorDims) -> bool {
+        self.0.pin_mut().set_input_dims_by_handle(handle, dims)
+    }
+
+    pub fn get_tensor_dims(&self, name: &str) -> TensorDims {
+        self.0.get_tensor_dims(name)
+    }
+
+    pub fn get_tensor_dims_by_handle(&self, handle: TensorHandle) -> TensorDims {
+        self.0.get_tensor_dims_by_handle(handle)
+    }
+
+    pub fn get_tensor_stride_dims(&self, name: &str) -> TensorDims {
+        self.0.get_tensor_stride_dims(name)
+    }
+
     pub fn set_aux_streams(&mut self, streams: &[&CuStream]) {
         let streams: Vec<_> = streams
             .iter()
@@ -548,6 +1050,11 @@ impl ExecutionContext {
             .collect();
         self.0.pin_mut().set_aux_streams(streams.as_slice())
     }
+
+    // Like set_aux_streams, for raw cudaStream_t handles (see stream::CudaStream).
+    pub fn set_aux_streams_raw(&mut self, streams: &[usize]) {
+        self.0.pin_mut().set_aux_streams(streams)
+    }
 }
 
 #[cfg(test)]
@@ -0,0 +1,228 @@
+use crate::{
+    ffi,
+    ipc::{IpcEventHandle, IPC_HANDLE_SIZE},
+};
+use cuda_rs::stream::CuStream;
+
+pub struct HostCallback(Box<dyn FnOnce() + Send>);
+
+pub(crate) fn run_host_callback(callback: Box<HostCallback>) {
+    (callback.0)()
+}
+
+// Schedules `callback` to run on a CUDA driver thread after all work already queued on
+// `stream` has completed. The callback must not make CUDA calls; waking a task or signalling
+// a channel is the intended use.
+pub fn launch_host_func<F: FnOnce() + Send + 'static>(stream: &CuStream, callback: F) -> bool {
+    let stream_raw = unsafe { stream.get_raw() };
+    ffi::launch_host_func(stream_raw as _, Box::new(HostCallback(Box::new(callback))))
+}
+
+// Marks `num_bytes` at `base` as L2-persisting for kernels launched on `stream` (and captured
+// from it into graphs), with `hit_ratio` of the window's accesses persisting. A stream has a
+// single window; setting one replaces the previous, num_bytes == 0 clears it.
+pub fn set_access_policy_window(stream: &CuStream, base: usize, num_bytes: usize, hit_ratio: f32) -> bool {
+    let stream_raw = unsafe { stream.get_raw() };
+    ffi::set_access_policy_window(stream_raw as _, base, num_bytes, hit_ratio)
+}
+
+// Least (lowest urgency, the default) and greatest priority streams can have on the current
+// device. Lower values are more urgent, e.g. (0, -5).
+pub fn get_stream_priority_range() -> (i32, i32) {
+    (ffi::get_least_stream_priority(), ffi::get_greatest_stream_priority())
+}
+
+// An owned non-blocking cudaStream_t with a priority, for streams TensorRT drives on its own
+// such as a context's auxiliary streams.
+pub struct CudaStream {
+    stream: usize,
+    priority: i32,
+}
+
+unsafe impl Send for CudaStream {}
+unsafe impl Sync for CudaStream {}
+
+impl CudaStream {
+    pub fn new(priority: i32) -> Option<Self> {
+        Self::from_raw(ffi::create_stream(priority), priority)
+    }
+
+    // Takes ownership of a stream created elsewhere, e.g. on a green context.
+    pub(crate) fn from_raw(stream: usize, priority: i32) -> Option<Self> {
+        if stream == 0 {
+            None
+        } else {
+            Some(Self { stream, priority })
+        }
+    }
+
+    pub fn priority(&self) -> i32 {
+        self.priority
+    }
+
+    pub fn synchronize(&self) -> bool {
+        ffi::synchronize_stream(self.stream)
+    }
+
+    pub fn get_raw(&self) -> usize {
+        self.stream
+    }
+}
+
+impl Drop for CudaStream {
+    fn drop(&mut self) {
+        ffi::destroy_stream(self.stream);
+    }
+}
+
+// A cudaError_t, as reported for asynchronous work.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct CudaStatus(pub i32);
+
+impl CudaStatus {
+    pub const SUCCESS: Self = Self(0);
+    pub const NOT_READY: Self = Self(600);
+
+    pub fn is_success(&self) -> bool {
+        *self == Self::SUCCESS
+    }
+
+    // Errors that corrupt the CUDA context: every later call of the process fails with the
+    // same error, so only restarting the process recovers.
+    pub fn is_sticky(&self) -> bool {
+        // ECCUncorrectable, IllegalAddress, LaunchTimeout, Assert, and HardwareStackError
+        // through LaunchFailure (IllegalInstruction, MisalignedAddress, InvalidAddressSpace,
+        // InvalidPc)
+        matches!(self.0, 214 | 700 | 702 | 710 | 714..=719)
+    }
+
+    pub fn name(&self) -> String {
+        ffi::get_error_name(self.0)
+    }
+
+    // Takes the last error of the calling thread, resetting it unless it is sticky.
+    pub fn take_last() -> Self {
+        Self(ffi::get_last_error())
+    }
+}
+
+// A CUDA event used to order work across streams, e.g. a copy stream and the compute
+// stream of a pipelined engine.
+pub struct CudaEvent(usize);
+
+unsafe impl Send for CudaEvent {}
+unsafe impl Sync for CudaEvent {}
+
+impl CudaEvent {
+    // Timing is disabled: these events are only used for synchronization, which makes
+    // record/wait cheaper.
+    pub fn new() -> Option<Self> {
+        let event = ffi::create_event(true);
+        if event == 0 {
+            None
+        } else {
+            Some(Self(event))
+        }
+    }
+
+    // For measuring device time with elapsed_ms_since, e.g. in benchmarks.
+    pub fn with_timing() -> Option<Self> {
+        let event = ffi::create_event(false);
+        if event == 0 {
+            None
+        } else {
+            Some(Self(event))
+        }
+    }
+
+    // synchronize sleeps instead of spinning, e.g. for waits of throughput work that
+    // should leave the cores to others.
+    pub fn blocking_sync() -> Option<Self> {
+        match ffi::create_blocking_event() {
+            0 => None,
+            event => Some(Self(event)),
+        }
+    }
+
+    // Shareable with other processes through ipc_handle, to order work across them.
+    pub fn interprocess() -> Option<Self> {
+        match ffi::create_ipc_event() {
+            0 => None,
+            event => Some(Self(event)),
+        }
+    }
+
+    // An interprocess event of another process. Waits on it are ordered after the record
+    // that process last issued before the wait was called, so records and waits still have
+    // to be sequenced between the processes, e.g. by passing a message after each record.
+    pub fn from_ipc_handle(handle: &IpcEventHandle) -> Option<Self> {
+        match ffi::open_event_handle(&handle.0) {
+            0 => None,
+            event => Some(Self(event)),
+        }
+    }
+
+    // None unless the event was created with interprocess.
+    pub fn ipc_handle(&self) -> Option<IpcEventHandle> {
+        let mut handle = [0u8; IPC_HANDLE_SIZE];
+        match ffi::get_event_handle(self.0, &mut handle) {
+            true => Some(IpcEventHandle(handle)),
+            false => None,
+        }
+    }
+
+    pub fn record(&self, stream: &CuStream) -> bool {
+        let stream_raw = unsafe { stream.get_raw() };
+        ffi::record_event(self.0, stream_raw as _)
+    }
+
+    // Makes all future work on `stream` wait for the last record of this event.
+    pub fn wait(&self, stream: &CuStream) -> bool {
+        let stream_raw = unsafe { stream.get_raw() };
+        ffi::stream_wait_event(stream_raw as _, self.0)
+    }
+
+    pub fn record_raw(&self, stream: usize) -> bool {
+        ffi::record_event(self.0, stream)
+    }
+
+    pub fn wait_raw(&self, stream: usize) -> bool {
+        ffi::stream_wait_event(stream, self.0)
+    }
+
+    pub fn synchronize(&self) -> bool {
+        ffi::synchronize_event(self.0)
+    }
+
+    pub fn is_complete(&self) -> bool {
+        ffi::query_event(self.0)
+    }
+
+    // NOT_READY while the recorded work runs, or the error it raised.
+    pub fn query_status(&self) -> CudaStatus {
+        CudaStatus(ffi::query_event_status(self.0))
+    }
+
+    pub fn synchronize_status(&self) -> CudaStatus {
+        CudaStatus(ffi::synchronize_event_status(self.0))
+    }
+
+    // Device time from the last record of `start` to the last record of this event. Both must
+    // be timing-enabled and completed.
+    pub fn elapsed_ms_since(&self, start: &CudaEvent) -> Option<f32> {
+        match ffi::event_elapsed_time(start.0, self.0) {
+            ms if ms >= 0.0 => Some(ms),
+            _ => None,
+        }
+    }
+
+    pub fn get_raw(&self) -> usize {
+        self.0
+    }
+}
+
+impl Drop for CudaEvent {
+    fn drop(&mut self) {
+        ffi::destroy_event(self.0);
+    }
+}
@@ -0,0 +1,50 @@
+use crate::ffi;
+use cxx::UniquePtr;
+
+// Device memory at a fixed address that grows by mapping more physical pages (CUDA virtual
+// memory management), so pointers bound into execution contexts and captured graphs stay
+// valid as it grows. Growth is in multiples of granularity, up to the reserved range.
+pub struct VirtualMemory(UniquePtr<ffi::VirtualMemory>);
+
+unsafe impl Send for VirtualMemory {}
+unsafe impl Sync for VirtualMemory {}
+
+impl VirtualMemory {
+    // Reserves `reserve` bytes of address space on `device` and maps nothing yet. None when
+    // the device or driver has no virtual memory management.
+    pub fn new(reserve: usize, device: i32) -> Option<Self> {
+        let memory = ffi::create_virtual_memory(reserve, device);
+        if memory.is_null() {
+            None
+        } else {
+            Some(Self(memory))
+        }
+    }
+
+    // Backs at least `size` bytes from the base; false beyond the reservation or when the
+    // device is out of memory.
+    pub fn grow(&mut self, size: usize) -> bool {
+        self.0.pin_mut().grow(size)
+    }
+
+    pub fn get_raw(&self) -> usize {
+        self.0.get_raw()
+    }
+
+    // Bytes backed by physical memory.
+    pub fn len(&self) -> usize {
+        self.0.size()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.0.size() == 0
+    }
+
+    pub fn reserved(&self) -> usize {
+        self.0.reserved()
+    }
+
+    pub fn granularity(&self) -> usize {
+        self.0.granularity()
+    }
+}
@@ -0,0 +1,130 @@
+use std::{
+    fs, io,
+    path::{Path, PathBuf},
+    str::FromStr,
+    time::Duration,
+};
+
+// Name of the file that makes a directory of the repository a model.
+pub const CONFIG_FILE: &str = "config";
+
+// One model of the repository, <repository>/<name>/config: `key = value` lines, `#` starting
+// a comment, every key optional.
+#[derive(Debug, Clone, PartialEq)]
+pub struct ModelConfig {
+    pub name: String,
+    // relative to the model's directory
+    pub plan: PathBuf,
+    pub device: i32,
+    // Execution contexts, each served by a batcher thread of its own.
+    pub contexts: usize,
+    // Optimization profile per context, round-robin; see EnginePoolOptions::profiles.
+    pub profiles: Vec<i32>,
+    pub max_batch_size: usize,
+    pub max_delay: Duration,
+    // Waiting requests per priority class beyond which new ones are rejected; 0 for no bound.
+    pub max_queued: usize,
+    // Device time of every batch in the metrics, at two timing events per batch.
+    pub gpu_timing: bool,
+    // Infer request bodies beyond this size are rejected before any of it is staged.
+    pub max_body_bytes: usize,
+}
+
+impl ModelConfig {
+    pub fn new(name: &str, dir: &Path) -> Self {
+        Self {
+            name: name.to_string(),
+            plan: dir.join("model.plan"),
+            device: 0,
+            contexts: 2,
+            profiles: Vec::new(),
+            max_batch_size: 8,
+            max_delay: Duration::from_millis(2),
+            max_queued: 0,
+            gpu_timing: false,
+            max_body_bytes: 64 << 20,
+        }
+    }
+
+    pub fn parse(name: &str, dir: &Path, text: &str) -> io::Result<Self> {
+        let mut config = Self::new(name, dir);
+        for (number, line) in text.lines().enumerate() {
+            let line = line.split('#').next().unwrap_or_default().trim();
+            if line.is_empty() {
+                continue;
+            }
+            let invalid = || io::Error::new(io::ErrorKind::InvalidData, format!("{}: line {}", name, number + 1));
+            let (key, value) = match line.split_once('=') {
+                Some((key, value)) => (key.trim(), value.trim()),
+                None => return Err(invalid()),
+            };
+            match key {
+                "plan" => config.plan = dir.join(value),
+                "device" => config.device = parse(value).ok_or_else(invalid)?,
+                "contexts" => config.contexts = parse(value).ok_or_else(invalid)?,
+                "profiles" => {
+                    config.profiles = value
+                        .split(',')
+                        .filter(|profile| !profile.trim().is_empty())
+                        .map(parse)
+                        .collect::<Option<_>>()
+                        .ok_or_else(invalid)?
+                }
+                "max_batch_size" => config.max_batch_size = parse(value).ok_or_else(invalid)?,
+                "max_delay_us" => config.max_delay = Duration::from_micros(parse(value).ok_or_else(invalid)?),
+                "max_queued" => config.max_queued = parse(value).ok_or_else(invalid)?,
+                "gpu_timing" => config.gpu_timing = parse(value).ok_or_else(invalid)?,
+                "max_body_bytes" => config.max_body_bytes = parse(value).ok_or_else(invalid)?,
+                _ => return Err(invalid()),
+            }
+        }
+        Ok(config)
+    }
+}
+
+fn parse<T: FromStr>(value: &str) -> Option<T> {
+    value.trim().parse().ok()
+}
+
+// The models of `repository`, its subdirectories holding a config file, by name.
+pub fn scan(repository: &Path) -> io::Result<Vec<ModelConfig>> {
+    let mut models = Vec::new();
+    for entry in fs::read_dir(repository)? {
+        let dir = entry?.path();
+        let path = dir.join(CONFIG_FILE);
+        if !path.is_file() {
+            continue;
+        }
+        let name = dir.file_name().unwrap_or_default().to_string_lossy().to_string();
+        models.push(ModelConfig::parse(&name, &dir, &fs::read_to_string(&path)?)?);
+    }
+    models.sort_by(|a, b| a.name.cmp(&b.name));
+    Ok(models)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn keys_override_the_defaults() {
+        let text = "# a detector\nplan = det.plan\ncontexts = 4\nprofiles = 0, 1\nmax_delay_us = 500 # tight\n\
+                    max_body_bytes = 1048576\n";
+        let config = ModelConfig::parse("det", Path::new("models/det"), text).unwrap();
+        assert_eq!(config.plan, Path::new("models/det/det.plan"));
+        assert_eq!(config.contexts, 4);
+        assert_eq!(config.profiles, [0, 1]);
+        assert_eq!(config.max_delay, Duration::from_micros(500));
+        assert_eq!(config.max_body_bytes, 1 << 20);
+        assert_eq!(config.max_batch_size, 8);
+    }
+
+    #[test]
+    fn unknown_keys_and_bad_values_are_rejected() {
+        let dir = Path::new("models/det");
+        assert!(ModelConfig::parse("det", dir, "batch = 8").is_err());
+        assert!(ModelConfig::parse("det", dir, "contexts = two").is_err());
+        assert!(ModelConfig::parse("det", dir, "contexts").is_err());
+        assert_eq!(ModelConfig::parse("det", dir, "").unwrap(), ModelConfig::new("det", dir));
+    }
+}
@@ -0,0 +1,226 @@
+use std::io::{self, BufRead, Write};
+
+// Bounds on what a client may send before its body; beyond them the connection is dropped.
+const MAX_HEADER_LINE: usize = 8 * 1024;
+const MAX_HEADERS: usize = 128;
+
+// A request up to its body, which the caller reads from the same stream: inference bodies
+// are read straight into pinned memory rather than buffered here.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Request {
+    pub method: String,
+    pub path: String,
+    // names lowercased, in the order sent
+    pub headers: Vec<(String, String)>,
+    pub content_length: usize,
+    pub keep_alive: bool,
+}
+
+impl Request {
+    pub fn header(&self, name: &str) -> Option<&str> {
+        self.headers.iter().find(|(key, _)| key == name).map(|(_, value)| value.as_str())
+    }
+
+    pub fn header_values<'a>(&'a self, name: &'a str) -> impl Iterator<Item = &'a str> {
+        self.headers.iter().filter(move |(key, _)| key == name).map(|(_, value)| value.as_str())
+    }
+}
+
+fn invalid(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message.to_string())
+}
+
+fn read_line<R: BufRead>(reader: &mut R, line: &mut String) -> io::Result<usize> {
+    line.clear();
+    let read = io::Read::take(&mut *reader, MAX_HEADER_LINE as u64).read_line(line)?;
+    if read == MAX_HEADER_LINE && !line.ends_with('\n') {
+        return Err(invalid("header line too long"));
+    }
+    Ok(read)
+}
+
+// The next request of a connection, None once the client closed it between requests.
+pub fn read_request<R: BufRead>(reader: &mut R) -> io::Result<Option<Request>> {
+    let mut line = String::new();
+    // tolerate blank lines ahead of a request line (RFC 9112 2.2)
+    loop {
+        if read_line(reader, &mut line)? == 0 {
+            return Ok(None);
+        }
+        if !line.trim().is_empty() {
+            break;
+        }
+    }
+    let mut parts = line.split_whitespace();
+    let (method, path, version) = match (parts.next(), parts.next(), parts.next()) {
+        (Some(method), Some(path), Some(version)) => (method.to_string(), path.to_string(), version.to_string()),
+        _ => return Err(invalid("malformed request line")),
+    };
+    let mut request =
+        Request { method, path, headers: Vec::new(), content_length: 0, keep_alive: version == "HTTP/1.1" };
+
+    loop {
+        if read_line(reader, &mut line)? == 0 {
+            return Err(io::ErrorKind::UnexpectedEof.into());
+        }
+        let header = line.trim_end_matches(['\r', '\n']);
+        if header.is_empty() {
+            break;
+        }
+        if request.headers.len() == MAX_HEADERS {
+            return Err(invalid("too many headers"));
+        }
+        let (name, value) = match header.split_once(':') {
+            Some((name, value)) => (name.trim().to_ascii_lowercase(), value.trim().to_string()),
+            None => return Err(invalid("malformed header")),
+        };
+        match name.as_str() {
+            "content-length" => request.content_length = value.parse().map_err(|_| invalid("bad content-length"))?,
+            "connection" if value.eq_ignore_ascii_case("close") => request.keep_alive = false,
+            "connection" if value.eq_ignore_ascii_case("keep-alive") => request.keep_alive = true,
+            // chunked bodies cannot be read in place; clients send the length
+            "transfer-encoding" => return Err(invalid("transfer-encoding is not supported")),
+            _ => {}
+        }
+        request.headers.push((name, value));
+    }
+    Ok(Some(request))
+}
+
+// A response whose body is written part by part, so output tensors go out without being
+// concatenated first.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct Response {
+    pub status: u16,
+    pub headers: Vec<(String, String)>,
+    pub body: Vec<Vec<u8>>,
+}
+
+impl Response {
+    pub fn new(status: u16) -> Self {
+        Self { status, headers: Vec::new(), body: Vec::new() }
+    }
+
+    pub fn text(status: u16, content_type: &str, body: String) -> Self {
+        Self::new(status).header("Content-Type", content_type).part(body.into_bytes())
+    }
+
+    pub fn json(status: u16, body: String) -> Self {
+        Self::text(status, "application/json", body)
+    }
+
+    pub fn error(status: u16, message: &str) -> Self {
+        Self::json(status, format!("{{\"error\":\"{}\"}}", escape_json(message)))
+    }
+
+    pub fn header(mut self, name: &str, value: &str) -> Self {
+        self.headers.push((name.to_string(), value.to_string()));
+        self
+    }
+
+    pub fn part(mut self, part: Vec<u8>) -> Self {
+        self.body.push(part);
+        self
+    }
+
+    pub fn write_to<W: Write>(&self, writer: &mut W, keep_alive: bool) -> io::Result<()> {
+        let length: usize = self.body.iter().map(Vec::len).sum();
+        let mut head = format!("HTTP/1.1 {} {}\r\n", self.status, reason(self.status));
+        for (name, value) in &self.headers {
+            head.push_str(&format!("{}: {}\r\n", name, value));
+        }
+        let connection = if keep_alive { "keep-alive" } else { "close" };
+        head.push_str(&format!("Content-Length: {}\r\nConnection: {}\r\n\r\n", length, connection));
+        writer.write_all(head.as_bytes())?;
+        for part in &self.body {
+            writer.write_all(part)?;
+        }
+        writer.flush()
+    }
+}
+
+pub fn reason(status: u16) -> &'static str {
+    match status {
+        200 => "OK",
+        400 => "Bad Request",
+        404 => "Not Found",
+        405 => "Method Not Allowed",
+        413 => "Payload Too Large",
+        429 => "Too Many Requests",
+        500 => "Internal Server Error",
+        503 => "Service Unavailable",
+        504 => "Gateway Timeout",
+        _ => "",
+    }
+}
+
+pub fn escape_json(text: &str) -> String {
+    let mut out = String::with_capacity(text.len());
+    for c in text.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            '\n' => out.push_str("\\n"),
+            c if (c as u32) < 0x20 => out.push_str(&format!("\\u{:04x}", c as u32)),
+            c => out.push(c),
+        }
+    }
+    out
+}
+
+// `Tensor-Input: <name> <d0>,<d1>,..`, one header per input in the order of their bytes in
+// the body.
+pub fn parse_tensor_header(value: &str) -> Option<(String, Vec<i32>)> {
+    let (name, dims) = value.trim().split_once(char::is_whitespace)?;
+    let dims: Option<Vec<i32>> =
+        dims.trim().split(',').map(|dim| dim.trim().parse().ok().filter(|&dim| dim >= 0)).collect();
+    Some((name.to_string(), dims?))
+}
+
+pub fn format_dims(dims: &[i32]) -> String {
+    dims.iter().map(i32::to_string).collect::<Vec<_>>().join(",")
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn requests_are_read_up_to_their_body() {
+        let wire = b"\r\nPOST /v2/models/det/infer HTTP/1.1\r\nContent-Length: 8\r\nTensor-Input: images 1,3\r\n\
+                     tensor-input: mask 1,1\r\n\r\nbodybody";
+        let mut reader = &wire[..];
+        let request = read_request(&mut reader).unwrap().unwrap();
+        assert_eq!(request.path, "/v2/models/det/infer");
+        assert_eq!(request.content_length, 8);
+        assert!(request.keep_alive);
+        assert_eq!(request.header_values("tensor-input").collect::<Vec<_>>(), ["images 1,3", "mask 1,1"]);
+        assert_eq!(reader, b"bodybody");
+        assert_eq!(read_request(&mut &b""[..]).unwrap(), None);
+    }
+
+    #[test]
+    fn unsupported_requests_are_rejected() {
+        let chunked = b"POST /infer HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n";
+        assert!(read_request(&mut &chunked[..]).is_err());
+        let long = format!("GET /{} HTTP/1.1\r\n\r\n", "a".repeat(MAX_HEADER_LINE));
+        assert!(read_request(&mut long.as_bytes()).is_err());
+        assert!(read_request(&mut &b"GET / HTTP/1.1\r\nHost"[..]).is_err());
+    }
+
+    #[test]
+    fn tensor_headers() {
+        assert_eq!(parse_tensor_header(" images 2, 3,224 "), Some(("images".to_string(), vec![2, 3, 224])));
+        assert_eq!(parse_tensor_header("images"), None);
+        assert_eq!(parse_tensor_header("images 2,-1"), None);
+        assert_eq!(format_dims(&[2, 3]), "2,3");
+    }
+
+    #[test]
+    fn responses_carry_their_length() {
+        let mut out = Vec::new();
+        Response::new(200).part(b"ab".to_vec()).part(b"c".to_vec()).write_to(&mut out, false).unwrap();
+        assert_eq!(out, b"HTTP/1.1 200 OK\r\nContent-Length: 3\r\nConnection: close\r\n\r\nabc");
+        assert_eq!(escape_json("a\"b\n"), "a\\\"b\\n");
+    }
+}
@@ -0,0 +1,73 @@
+mod config;
+mod http;
+mod model;
+mod server;
+
+use clap::Parser;
+use std::{net::TcpListener, path::PathBuf, process, sync::Arc, thread};
+use tensorrt::TRTResult;
+
+// Serves every model of a repository over HTTP/1.1: each subdirectory holding a `config`
+// file (see ModelConfig) is a model, loaded into a pool of contexts drained by a dynamic
+// batcher. Routes:
+//   GET  /v2/health/ready, /v2/health/live
+//   GET  /v2/models                  model names
+//   GET  /v2/models/<name>           inputs and outputs with their dtypes and shapes
+//   POST /v2/models/<name>/infer     raw tensor bytes in and out, see server::infer
+//   GET  /metrics                    Prometheus text of every engine
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long)]
+    repository: PathBuf,
+
+    #[arg(short, long, default_value = "0.0.0.0:8000")]
+    listen: String,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    cuda_rs::init()?;
+
+    let mut models = Vec::new();
+    for config in config::scan(&args.repository)? {
+        let name = config.name.clone();
+        match model::Model::load(config) {
+            Ok(model) => models.push(model),
+            Err(err) => {
+                eprintln!("{}: {:?}", name, err);
+                process::exit(1);
+            }
+        }
+        eprintln!("{}: loaded", name);
+    }
+    if models.is_empty() {
+        eprintln!("no models in {}", args.repository.display());
+        process::exit(1);
+    }
+
+    let server = Arc::new(server::Server::new(models));
+    let listener = TcpListener::bind(&args.listen)?;
+    eprintln!("serving {} models on {}", server.models().len(), args.listen);
+    for stream in listener.incoming() {
+        let stream = match stream {
+            Ok(stream) => stream,
+            Err(err) => {
+                eprintln!("accept: {}", err);
+                continue;
+            }
+        };
+        // small responses go out without waiting for the client's ACK
+        stream.set_nodelay(true).ok();
+        let server = server.clone();
+        thread::spawn(move || {
+            if let Err(err) = server.serve_connection(stream) {
+                if err.kind() != std::io::ErrorKind::UnexpectedEof {
+                    eprintln!("connection: {}", err);
+                }
+            }
+        });
+    }
+    Ok(())
+}
@@ -0,0 +1,104 @@
+use crate::config::ModelConfig;
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use std::{
+    collections::HashMap,
+    process,
+    sync::Arc,
+    thread,
+    time::{Duration, Instant},
+};
+use tensorrt::{
+    BatchConfig, BatchInput, BatchOutput, BatchSubmitter, DynamicBatcher, EnginePool, EnginePoolOptions, IoSchema,
+    PriorityClass, TRTError, TRTResult,
+};
+
+// A loaded model: an EnginePool of `contexts` contexts sharing one deserialized engine, and
+// a DynamicBatcher they all drain, each context on a thread of its own, so requests of
+// concurrent connections are coalesced into batches and the batches run side by side.
+pub struct Model {
+    pub config: ModelConfig,
+    pub schema: IoSchema,
+    submitter: BatchSubmitter,
+}
+
+impl Model {
+    pub fn load(config: ModelConfig) -> TRTResult<Self> {
+        let ctx = CuDevice::new(config.device)?.retain_primary_context()?;
+        let _guard = ctx.guard()?;
+
+        let options = EnginePoolOptions {
+            num_contexts: config.contexts.max(1),
+            profiles: config.profiles.clone(),
+            ..EnginePoolOptions::default()
+        };
+        // sized from the max shapes of each context's profile; a context a failed batch left
+        // in an unknown state is replaced, so its batcher thread keeps serving
+        let pool = EnginePool::new(&config.plan, &options, |_, engine| {
+            engine.allocate_io_tensors(&HashMap::new(), None)?;
+            engine.enable_metrics(&config.name, config.gpu_timing)?;
+            engine.set_auto_recover(true);
+            Ok(())
+        })?;
+        let schema = pool.checkout().io_schema()?.clone();
+
+        let mut batcher = DynamicBatcher::new(BatchConfig {
+            max_batch_size: config.max_batch_size.max(1),
+            max_delay: config.max_delay,
+            max_queued: config.max_queued,
+            ..BatchConfig::default()
+        });
+        // malformed requests fail at submit instead of failing the batch they land in
+        batcher.set_io_schema(Some(schema.clone()));
+        let submitter = batcher.submitter();
+
+        let (pool, batcher) = (Arc::new(pool), Arc::new(batcher));
+        for _ in 0..pool.capacity() {
+            let (pool, batcher, device, name) = (pool.clone(), batcher.clone(), config.device, config.name.clone());
+            thread::spawn(move || {
+                // the batcher only gives up on errors nothing in this process can recover
+                // from, so the server exits rather than answering every request with 503
+                if let Err(err) = serve(&pool, &batcher, device) {
+                    eprintln!("{}: batcher stopped: {:?}", name, err);
+                    process::exit(1);
+                }
+            });
+        }
+        Ok(Self { config, schema, submitter })
+    }
+
+    pub fn name(&self) -> &str {
+        &self.config.name
+    }
+
+    // Runs one request through the batcher and waits for its outputs. Interactive requests
+    // are batched only with each other, ahead of the rest; a request still queued after
+    // `timeout` fails with DeadlineExceeded.
+    pub fn infer(
+        &self,
+        inputs: Vec<BatchInput>,
+        interactive: bool,
+        timeout: Option<Duration>,
+    ) -> TRTResult<Vec<BatchOutput>> {
+        let class = match interactive {
+            true => PriorityClass::Interactive,
+            false => PriorityClass::Batch,
+        };
+        let deadline = timeout.map(|timeout| Instant::now() + timeout);
+        let request = self.submitter.submit_with_deadline(inputs, class, deadline)?;
+        match request.recv() {
+            Ok(result) => result,
+            Err(_) => Err(TRTError::QueueClosed),
+        }
+    }
+}
+
+// One batcher thread: holds a context of the pool for good and runs the batches it takes.
+// Failed batches fail their own requests only (DynamicBatcher::run); this returns once the
+// queue is closed, or with the sticky CUDA error that closed it.
+fn serve(pool: &EnginePool, batcher: &DynamicBatcher, device: i32) -> TRTResult<()> {
+    let ctx = CuDevice::new(device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+    let stream = CuStream::new()?;
+    let mut engine = pool.checkout();
+    batcher.run(&mut engine, &stream)
+}
@@ -0,0 +1,258 @@
+use crate::{
+    http::{self, Request, Response},
+    model::Model,
+};
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use std::{
+    collections::{hash_map::Entry, HashMap},
+    fmt::Write as _,
+    io::{self, BufRead, BufReader, BufWriter, Read},
+    net::TcpStream,
+    time::Duration,
+};
+use tensorrt::{BatchInput, DataType, HostMemoryKind, MetricsRegistry, Shape, TRTError, TRTResult, Tensor};
+
+// nvinfer1::Dims::MAX_DIMS
+const MAX_DIMS: usize = 8;
+// Inputs start at this alignment within a connection's staging buffer.
+const INPUT_ALIGNMENT: usize = 256;
+// Bodies of requests rejected before their body was read are skipped up to this size;
+// beyond it the connection is closed instead.
+const MAX_DISCARD: usize = 1 << 20;
+
+pub struct Server {
+    // by name
+    models: Vec<Model>,
+}
+
+// Mapped pinned memory a connection reads request bodies into, on the device of the models
+// it served. The batcher copies the inputs from it in place, so a request's bytes cross
+// from the socket to the engine's input buffers through a single device copy.
+struct Staging {
+    buffer: Option<Tensor>,
+    stream: CuStream,
+}
+
+impl Staging {
+    // The staging buffer, grown to a power of two of at least `size` bytes.
+    fn reserve(&mut self, size: usize) -> TRTResult<&mut Tensor> {
+        let capacity = self.buffer.as_ref().map_or(0, Tensor::capacity);
+        if capacity < size {
+            let capacity = size.next_power_of_two();
+            self.buffer = None;
+            let shape = Shape::new(&[capacity as i32]);
+            let tensor = Tensor::host_mapped(&shape, capacity, DataType::UINT8, HostMemoryKind::Mapped, &self.stream)?;
+            self.buffer = Some(tensor);
+        }
+        Ok(self.buffer.as_mut().unwrap())
+    }
+}
+
+// An input of an infer request, in the order of its bytes in the body.
+struct InputSlot {
+    name: String,
+    shape: Shape,
+    dtype: DataType,
+    offset: usize,
+    size: usize,
+}
+
+impl Server {
+    pub fn new(mut models: Vec<Model>) -> Self {
+        models.sort_by(|a, b| a.name().cmp(b.name()));
+        Self { models }
+    }
+
+    pub fn models(&self) -> &[Model] {
+        &self.models
+    }
+
+    fn model(&self, name: &str) -> Option<&Model> {
+        self.models.iter().find(|model| model.name() == name)
+    }
+
+    // Serves the requests of one connection until the client closes it or a request cannot
+    // be answered in kind.
+    pub fn serve_connection(&self, stream: TcpStream) -> io::Result<()> {
+        let mut reader = BufReader::new(stream.try_clone()?);
+        let mut writer = BufWriter::new(stream);
+        let mut staging = HashMap::new();
+        while let Some(request) = http::read_request(&mut reader)? {
+            let mut consumed = 0;
+            let response = self.handle(&request, &mut reader, &mut consumed, &mut staging);
+            let keep_alive = request.keep_alive && discard(&mut reader, request.content_length - consumed)?;
+            response.write_to(&mut writer, keep_alive)?;
+            if !keep_alive {
+                break;
+            }
+        }
+        Ok(())
+    }
+
+    fn handle<R: BufRead>(
+        &self,
+        request: &Request,
+        reader: &mut R,
+        consumed: &mut usize,
+        staging: &mut HashMap<i32, Staging>,
+    ) -> Response {
+        let path = request.path.split('?').next().unwrap_or_default();
+        let segments: Vec<&str> = path.trim_matches('/').split('/').collect();
+        match (request.method.as_str(), segments.as_slice()) {
+            ("GET", ["v2", "health", "live"]) | ("GET", ["v2", "health", "ready"]) => Response::new(200),
+            ("GET", ["v2", "models"]) => {
+                let names: Vec<String> =
+                    self.models.iter().map(|model| format!("\"{}\"", http::escape_json(model.name()))).collect();
+                Response::json(200, format!("{{\"models\":[{}]}}", names.join(",")))
+            }
+            ("GET", ["v2", "models", name]) => match self.model(name) {
+                Some(model) => Response::json(200, metadata(model)),
+                None => Response::error(404, &format!("unknown model {}", name)),
+            },
+            ("POST", ["v2", "models", name, "infer"]) => match self.model(name) {
+                Some(model) => match infer(model, request, reader, consumed, staging) {
+                    Ok(response) => response,
+                    Err(err) => Response::error(status(&err), &err.to_string()),
+                },
+                None => Response::error(404, &format!("unknown model {}", name)),
+            },
+            ("GET", ["metrics"]) => {
+                let metrics = MetricsRegistry::global().render_prometheus();
+                Response::text(200, "text/plain; version=0.0.4", metrics)
+            }
+            (_, ["v2", ..]) | (_, ["metrics"]) => Response::error(405, "method not allowed"),
+            _ => Response::error(404, &format!("no route for {}", path)),
+        }
+    }
+}
+
+// Skips the unread rest of a request body; false when it is too large to be worth reading,
+// and the connection is to be closed.
+fn discard<R: Read>(reader: &mut R, size: usize) -> io::Result<bool> {
+    if size > MAX_DISCARD {
+        return Ok(false);
+    }
+    let skipped = io::copy(&mut reader.take(size as u64), &mut io::sink())?;
+    Ok(skipped == size as u64)
+}
+
+// POST /v2/models/<name>/infer. The body is the raw bytes of every input, in the order of
+// their `Tensor-Input: <name> <dims>` headers, each in the dtype the engine declares; the
+// response body is those of every output, described by `Tensor-Output: <name> <dtype>
+// <dims>` headers in the same way. `Priority: interactive` batches the request ahead of the
+// rest and `Timeout-Ms` bounds how long it may wait to be batched. Bodies beyond the model's
+// max_body_bytes and dims beyond every profile's max are rejected before anything is staged.
+fn infer<R: BufRead>(
+    model: &Model,
+    request: &Request,
+    reader: &mut R,
+    consumed: &mut usize,
+    staging: &mut HashMap<i32, Staging>,
+) -> TRTResult<Response> {
+    if request.content_length > model.config.max_body_bytes {
+        let message = format!("body of {} bytes exceeds {} bytes", request.content_length, model.config.max_body_bytes);
+        return Ok(Response::error(413, &message));
+    }
+    let mut slots = Vec::new();
+    let mut end = 0;
+    for value in request.header_values("tensor-input") {
+        let (name, dims) = match http::parse_tensor_header(value) {
+            Some((name, dims)) if dims.len() <= MAX_DIMS => (name, dims),
+            _ => return Ok(Response::error(400, &format!("malformed tensor-input {}", value))),
+        };
+        let shape = Shape::new(&dims);
+        // dims are checked against the profiles before they size anything
+        let dtype = match model.schema.get(&name) {
+            Some(tensor) if tensor.is_input() && tensor.accepts_up_to_max(&shape, None) => tensor.dtype,
+            Some(tensor) if tensor.is_input() => return Err(TRTError::ShapeError(dims)),
+            _ => return Err(TRTError::TensorNotFound(name)),
+        };
+        let size = dims.iter().try_fold(dtype.get_elem_size(), |size, &dim| size.checked_mul(dim as usize));
+        let size = match size {
+            Some(size) if size <= request.content_length => size,
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let offset = (end + INPUT_ALIGNMENT - 1) / INPUT_ALIGNMENT * INPUT_ALIGNMENT;
+        end = offset + size;
+        slots.push(InputSlot { name, shape, dtype, offset, size });
+    }
+    if slots.iter().map(|slot| slot.size).sum::<usize>() != request.content_length {
+        return Err(TRTError::ShapeMismatch);
+    }
+    let interactive = request.header("priority").map_or(false, |priority| priority.eq_ignore_ascii_case("interactive"));
+    let timeout = match request.header("timeout-ms") {
+        Some(value) => match value.parse() {
+            Ok(ms) => Some(Duration::from_millis(ms)),
+            Err(_) => return Ok(Response::error(400, &format!("malformed timeout-ms {}", value))),
+        },
+        None => None,
+    };
+
+    let ctx = CuDevice::new(model.config.device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+    let staging = match staging.entry(model.config.device) {
+        Entry::Occupied(entry) => entry.into_mut(),
+        Entry::Vacant(entry) => entry.insert(Staging { buffer: None, stream: CuStream::new()? }),
+    };
+    let stream = staging.stream.clone();
+    let buffer = staging.reserve(end.max(1))?;
+    // the previous request of the connection has its result, so nothing reads the buffer
+    let host = unsafe { buffer.host_slice_mut() }.ok_or(TRTError::AllocatorError)?;
+    for slot in &slots {
+        reader.read_exact(&mut host[slot.offset..slot.offset + slot.size])?;
+        *consumed += slot.size;
+    }
+    let base = unsafe { buffer.get_raw_ptr() };
+    let inputs: Vec<BatchInput> = slots
+        .iter()
+        .map(|slot| {
+            let view = Tensor::from_raw_ptr(base + slot.offset, &slot.shape, slot.dtype, &stream);
+            // read by the batcher before the request's result arrives, and left untouched until then
+            unsafe { BatchInput::device(&slot.name, &view) }
+        })
+        .collect();
+
+    let outputs = model.infer(inputs, interactive, timeout)?;
+    let mut response = Response::new(200).header("Content-Type", "application/octet-stream");
+    for output in outputs {
+        let dtype = model.schema.get(&output.name).map_or(DataType::UINT8, |tensor| tensor.dtype);
+        let value = format!("{} {:?} {}", output.name, dtype, http::format_dims(output.shape.as_slice()));
+        response = response.header("Tensor-Output", &value).part(output.data);
+    }
+    Ok(response)
+}
+
+fn status(err: &TRTError) -> u16 {
+    match err.root() {
+        TRTError::ShapeError(_) | TRTError::ShapeMismatch | TRTError::DTypeMismatch | TRTError::ProfileError(_) => 400,
+        TRTError::TensorNotFound(_) | TRTError::UnknownModel(_) => 404,
+        TRTError::Overloaded => 429,
+        TRTError::QueueClosed => 503,
+        TRTError::DeadlineExceeded => 504,
+        _ => 500,
+    }
+}
+
+// {"name":..,"inputs":[{"name":..,"datatype":"FLOAT","shape":[-1,3,224,224]},..],"outputs":[..]}
+fn metadata(model: &Model) -> String {
+    let mut out = format!("{{\"name\":\"{}\"", http::escape_json(model.name()));
+    for (key, io) in [("inputs", true), ("outputs", false)] {
+        write!(out, ",\"{}\":[", key).ok();
+        let tensors = model.schema.tensors().iter().filter(|tensor| tensor.is_input() == io);
+        for (i, tensor) in tensors.enumerate() {
+            let separator = if i == 0 { "" } else { "," };
+            write!(
+                out,
+                "{}{{\"name\":\"{}\",\"datatype\":\"{:?}\",\"shape\":[{}]}}",
+                separator,
+                http::escape_json(&tensor.name),
+                tensor.dtype,
+                http::format_dims(tensor.shape.as_slice())
+            )
+            .ok();
+        }
+        out.push(']');
+    }
+    out.push('}');
+    out
+}
@@ -0,0 +1,53 @@
+use criterion::{criterion_group, criterion_main, Criterion};
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use tensorrt::{Shape, TRTEngine, OptProfileSelector, ReadbackPool};
+use std::collections::HashMap;
+
+// Needs a plan to run: TRT_BENCH_PLAN=model.plan cargo bench. Inputs are the engine's
+// zero-initialized buffers at the opt shapes of profile 0.
+fn engine_benches(c: &mut Criterion) {
+    let plan = match std::env::var("TRT_BENCH_PLAN") {
+        Ok(plan) => plan,
+        Err(_) => {
+            eprintln!("TRT_BENCH_PLAN is not set, skipping engine benchmarks");
+            return;
+        }
+    };
+
+    cuda_rs::init().unwrap();
+    let ctx = CuDevice::new(0).unwrap().retain_primary_context().unwrap();
+    let _guard = ctx.guard().unwrap();
+    let stream = CuStream::new().unwrap();
+
+    let mut engine = TRTEngine::new(&plan, &stream).unwrap();
+    engine.activate().unwrap();
+    engine.allocate_io_tensors(&HashMap::new(), None).unwrap();
+    let shapes: Vec<(String, Shape)> = engine
+        .input_names()
+        .iter()
+        .map(|name| (name.clone(), engine.get_profile_shape(name, 0, OptProfileSelector::OPT).unwrap()))
+        .collect();
+    for (name, shape) in &shapes {
+        engine.set_input_shape(name, shape).unwrap();
+    }
+    let output_names = engine.output_names().to_vec();
+    let outputs: Vec<&str> = output_names.iter().map(|name| name.as_str()).collect();
+    let readback = ReadbackPool::new();
+
+    c.bench_function("execute", |b| {
+        b.iter(|| {
+            engine.execute(None).unwrap();
+            stream.synchronize().unwrap();
+        })
+    });
+
+    c.bench_function("execute_readback", |b| {
+        b.iter(|| {
+            engine.execute(None).unwrap();
+            engine.read_outputs(&outputs, &readback, None).unwrap().wait().unwrap()
+        })
+    });
+}
+
+criterion_group!(benches, engine_benches);
+criterion_main!(benches);
@@ -0,0 +1,109 @@
+use clap::{Parser, ValueEnum};
+use tensorrt::{run_benchmark, BenchOptions, Shape, TRTResult, UploadMemory};
+use std::{fmt::Write, fs, path::Path};
+
+#[derive(ValueEnum, Clone, Copy, Debug)]
+enum Model {
+    Clip,
+    #[value(name = "pp_ocr")]
+    PpOcr,
+}
+
+impl Model {
+    fn name(self) -> &'static str {
+        match self {
+            Model::Clip => "clip",
+            Model::PpOcr => "pp_ocr",
+        }
+    }
+
+    // The input the model is served with, at batch 1.
+    fn inputs(self) -> Vec<(String, Shape)> {
+        match self {
+            Model::Clip => vec![("images".to_string(), Shape::new(&[1, 3, 224, 224]))],
+            Model::PpOcr => vec![("x".to_string(), Shape::new(&[1, 3, 352, 640]))],
+        }
+    }
+}
+
+// The benchmark suite for the example models: every precision variant of a model's plan is
+// swept over batch sizes, context counts, CUDA graphs off and on and pinned vs pageable
+// copies, at the input shapes of examples/clip.rs and examples/pp_ocr.rs, and the reports
+// are written as one JSON document. Inputs and iteration counts are fixed, so runs on the
+// same device and plans compare across changes.
+//
+//   benchsuite --model clip --plan fp32=clip_fp32.plan --plan fp16=clip_fp16.plan
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long, value_enum)]
+    model: Model,
+
+    // A precision variant of the model as precision=path, e.g. int8=clip_int8.plan.
+    #[arg(short, long, required = true)]
+    plan: Vec<String>,
+
+    #[arg(short, long, default_value_t = 0)]
+    device: i32,
+
+    #[arg(short, long, value_delimiter = ',', default_value = "1,2,4,8,16")]
+    batch_sizes: Vec<i32>,
+
+    #[arg(short, long, value_delimiter = ',', default_value = "1,2,4")]
+    concurrency: Vec<usize>,
+
+    #[arg(short, long, default_value_t = 20)]
+    warmup: usize,
+
+    #[arg(short, long, default_value_t = 500)]
+    iterations: usize,
+
+    // Writes the results here instead of stdout.
+    #[arg(short, long)]
+    output: Option<String>,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    let mut variants = Vec::new();
+    for plan in &args.plan {
+        match plan.split_once('=') {
+            Some((precision, path)) => variants.push((precision.to_string(), path.to_string())),
+            None => {
+                eprintln!("expected precision=path, got {}", plan);
+                std::process::exit(2);
+            }
+        }
+    }
+
+    cuda_rs::init()?;
+
+    let options = BenchOptions {
+        device: args.device,
+        batch_sizes: args.batch_sizes,
+        concurrency: args.concurrency,
+        warmup_iterations: args.warmup,
+        iterations: args.iterations,
+        cuda_graphs: vec![false, true],
+        uploads: vec![UploadMemory::Pinned, UploadMemory::Pageable],
+        input_shapes: args.model.inputs(),
+        ..BenchOptions::default()
+    };
+
+    let mut out = String::new();
+    write!(out, "{{\"model\":\"{}\",\"variants\":[", args.model.name()).ok();
+    for (i, (precision, path)) in variants.iter().enumerate() {
+        let report = run_benchmark(&Path::new(path), &options)?;
+        let sep = if i == 0 { "" } else { "," };
+        write!(out, "{}{{\"precision\":\"{}\",\"report\":{}}}", sep, precision, report.to_json()).ok();
+    }
+    out.push_str("]}");
+
+    match args.output {
+        Some(path) => fs::write(path, out)?,
+        None => println!("{}", out),
+    }
+
+    Ok(())
+}
@@ -1,7 +1,6 @@
 use clap::Parser;
 use cuda_rs::{device::CuDevice, stream::CuStream};
-use tensorrt::{TRTEngine, TRTResult, Shape, DataType, Tensor};
-use tch::vision::imagenet::load_image_and_resize224;
+use tensorrt::{DataType, ImagePreprocessor, OutputReduction, ReadbackPool, Shape, TRTEngine, TRTResult, Tensor};
 use std::{collections::HashMap, path::Path};
 
 #[derive(Parser, Debug)]
@@ -19,25 +18,26 @@ fn main() -> TRTResult<()> {
     let Args { engine_path, image_path } = args;
     let engine_path = Path::new(&engine_path);
 
-    let image = load_image_and_resize224(&image_path).unwrap();
-    let image = image.contiguous();
-    let image = image.unsqueeze(0);
+    // uint8 HWC pixels; resize and normalization happen on the GPU
+    let image = tch::vision::image::load(&image_path).unwrap();
+    let image = image.permute([1, 2, 0]).contiguous();
+    let image_shape: Vec<i32> = image.size().iter().map(|&dim| dim as i32).collect();
     let host_ptr = image.data_ptr();
 
     cuda_rs::init()?;
 
-    let input_shape = Shape(vec![1, 3, 224, 224]);
-    let output_shape = Shape(vec![1, 768]);
-    let dtype = DataType::FLOAT;
-    let mem_size = input_shape.size() * dtype.get_elem_size();
+    let input_shape = Shape::new(&[1, 3, 224, 224]);
+    let output_shape = Shape::new(&[1, 768]);
+    let image_shape = Shape::new(&image_shape);
+    let mem_size = image_shape.size();
 
     let device = CuDevice::new(0)?;
     let ctx = device.retain_primary_context()?;
     let _guard = ctx.guard()?;
     let stream = CuStream::new()?;
 
-    let input_tensor = Tensor::empty(&input_shape, dtype, &stream)?;
-    input_tensor.get_memory().copy_from_raw(
+    let image_tensor = Tensor::empty(&image_shape, DataType::UINT8, &stream)?;
+    image_tensor.get_memory().copy_from_raw(
         host_ptr as _, mem_size, Some(&stream)
     )?;
 
@@ -51,31 +51,15 @@ fn main() -> TRTResult<()> {
     ]);
     engine.allocate_io_tensors(&max_shape_dict, None)?;
 
-    let feed_dict: HashMap<&str, &Tensor> = HashMap::from([
-        ("images", &input_tensor),
-    ]);
-    let res = engine.inference(&feed_dict, None)?;
-
-    stream.synchronize()?;
-
-    let features = res.get("features").unwrap();
-    let features_ptr = unsafe { features.get_raw_ptr() };
-
-    let device = tch::Device::cuda_if_available();
-    let features = unsafe {
-        tch::Tensor::from_blob(
-            features_ptr as _,
-            vec![1, 768].as_slice(),
-            vec![768, 1].as_slice(),
-            tch::Kind::Float,
-            device,
-        )
-    };
-    let features = features.to_device(tch::Device::Cpu);
-
-    let mean = features.mean(tch::Kind::Float);
+    engine.set_input_shape("images", &input_shape)?;
+    engine.preprocess_input("images", &image_tensor, 0, &ImagePreprocessor::imagenet())?;
+    // only the mean of the features is reduced on the GPU and copied back
+    engine.attach_reduction("features", Some(OutputReduction::Mean))?;
+    engine.execute(None)?;
+    let outputs = engine.read_outputs(&["features"], &ReadbackPool::new(), None)?.wait_as::<f32>()?;
+    let mean = outputs[0][0];
 
-    mean.print();
+    println!("{}", mean);
 
     Ok(())
 }
@@ -0,0 +1,288 @@
+use clap::Parser;
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use tensorrt::{
+    BatchConfig, BatchInput, BatchSubmitter, DataType, DynamicBatcher, EnginePool, EnginePoolOptions, HostMemoryKind,
+    ImagePreprocessor, OutputReduction, ReadbackPool, Shape, TRTEngine, TRTError, TRTResult, Tensor,
+};
+use std::{
+    collections::HashMap,
+    fs,
+    path::{Path, PathBuf},
+    process,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Mutex,
+    },
+    thread,
+    time::{Duration, Instant},
+};
+
+// Embeds a directory of images with a CLIP image encoder twice and reports images per second
+// of each: the naive path of clip.rs per image (CPU resize and normalization, a pageable
+// upload, plain enqueue, a synchronous readback and CPU normalization), then the fast path,
+// where client threads decode into mapped pinned buffers the preprocessing kernel reads in
+// place, submit the preprocessed images to a DynamicBatcher drained by pooled contexts that
+// replay a CUDA graph per batch size, and get back embeddings L2-normalized on the GPU. The
+// embeddings of both paths are compared, so the run fails (exit 1) if the fast path is wrong.
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long)]
+    engine: String,
+
+    // jpg/jpeg/png images
+    #[arg(short, long)]
+    images: String,
+
+    #[arg(short, long, default_value_t = 0)]
+    device: i32,
+
+    #[arg(long, default_value = "images")]
+    input: String,
+
+    #[arg(long, default_value = "features")]
+    output: String,
+
+    #[arg(long, default_value_t = 224)]
+    size: i32,
+
+    // Pooled contexts, each draining the batcher on a thread of its own.
+    #[arg(long, default_value_t = 2)]
+    contexts: usize,
+
+    // Threads decoding, preprocessing and submitting images.
+    #[arg(long, default_value_t = 8)]
+    clients: usize,
+
+    #[arg(long, default_value_t = 32)]
+    max_batch_size: usize,
+
+    #[arg(long, default_value_t = 2000)]
+    max_delay_us: u64,
+
+    // Passes over the images on the fast path; the naive path makes one.
+    #[arg(long, default_value_t = 4)]
+    passes: usize,
+
+    // Lowest cosine similarity allowed between the embeddings of the two paths; the resize
+    // interpolations differ slightly.
+    #[arg(long, default_value_t = 0.98)]
+    min_cosine: f32,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    let mut paths: Vec<PathBuf> = fs::read_dir(&args.images)?
+        .filter_map(|entry| entry.ok().map(|entry| entry.path()))
+        .filter(|path| {
+            let extension = path.extension().and_then(|extension| extension.to_str()).unwrap_or_default();
+            matches!(extension.to_ascii_lowercase().as_str(), "jpg" | "jpeg" | "png")
+        })
+        .collect();
+    paths.sort();
+    if paths.is_empty() {
+        eprintln!("no images in {}", args.images);
+        process::exit(1);
+    }
+
+    cuda_rs::init()?;
+
+    let (naive_rate, reference) = run_naive(&args, &paths)?;
+    let (fast_rate, embeddings, graphs) = run_fast(&args, &paths)?;
+
+    let min_cosine = reference
+        .iter()
+        .zip(&embeddings)
+        .map(|(expected, actual)| match actual {
+            Some(actual) => expected.iter().zip(actual).map(|(a, b)| a * b).sum::<f32>(),
+            None => 0.0,
+        })
+        .fold(1.0f32, f32::min);
+    println!(
+        "{{\"images\":{},\"naive_images_per_sec\":{},\"fast_images_per_sec\":{},\"speedup\":{},\"cuda_graphs\":{},\
+         \"min_cosine\":{}}}",
+        paths.len(),
+        naive_rate,
+        fast_rate,
+        fast_rate / naive_rate.max(1e-9),
+        graphs,
+        min_cosine
+    );
+    if min_cosine < args.min_cosine {
+        eprintln!("embeddings differ: cosine similarity {} < {}", min_cosine, args.min_cosine);
+        process::exit(1);
+    }
+    Ok(())
+}
+
+fn normalized(mut row: Vec<f32>) -> Vec<f32> {
+    let norm = row.iter().map(|x| x * x).sum::<f32>().sqrt().max(1e-12);
+    row.iter_mut().for_each(|x| *x /= norm);
+    row
+}
+
+// One image at a time through a single context, with every slow option.
+fn run_naive(args: &Args, paths: &[PathBuf]) -> TRTResult<(f64, Vec<Vec<f32>>)> {
+    let ctx = CuDevice::new(args.device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+    let stream = CuStream::new()?;
+
+    let mut engine = TRTEngine::new(&Path::new(&args.engine), &stream)?;
+    engine.activate()?;
+    engine.allocate_io_tensors(&HashMap::new(), None)?;
+    // the CPU preprocessing yields FLOAT, cast on the GPU for FP16 engines
+    engine.enable_cast_on_bind(true);
+
+    let input_shape = Shape::new(&[1, 3, args.size, args.size]);
+    let input = Tensor::empty(&input_shape, DataType::FLOAT, &stream)?;
+    let readback = ReadbackPool::new();
+    let mut host = vec![0f32; input_shape.size()];
+
+    let start = Instant::now();
+    let mut embeddings = Vec::with_capacity(paths.len());
+    for path in paths {
+        let image = tch::vision::image::load_and_resize(path, args.size as i64, args.size as i64).unwrap();
+        let image = tch::vision::imagenet::normalize(&image).unwrap();
+        image.copy_data(&mut host, input_shape.size());
+        input.get_memory().copy_from_raw(host.as_ptr() as _, host.len() * 4, Some(&stream))?;
+
+        engine.inference(&HashMap::from([(args.input.as_str(), &input)]), None)?;
+        let outputs = engine.read_outputs(&[args.output.as_str()], &readback, None)?.wait_as::<f32>()?;
+        embeddings.push(normalized(outputs[0].to_vec()));
+    }
+    Ok((paths.len() as f64 / start.elapsed().as_secs_f64(), embeddings))
+}
+
+// The batched pipeline; returns images per second, the first embedding of every image and
+// the graphs the contexts captured.
+fn run_fast(args: &Args, paths: &[PathBuf]) -> TRTResult<(f64, Vec<Option<Vec<f32>>>, usize)> {
+    let ctx = CuDevice::new(args.device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+
+    let options = EnginePoolOptions { num_contexts: args.contexts.max(1), ..EnginePoolOptions::default() };
+    // sized from the profile's max shapes, so a batch of max_batch_size fits if the profile
+    // allows it; the batcher clamps to what was allocated
+    let pool = EnginePool::new(&args.engine, &options, |_, engine| {
+        engine.allocate_io_tensors(&HashMap::new(), None)?;
+        engine.enable_cuda_graphs(true);
+        engine.attach_reduction(&args.output, Some(OutputReduction::L2Normalize))
+    })?;
+    let dtype = match pool.checkout().io_schema()?.get(&args.input) {
+        Some(tensor) => tensor.dtype,
+        None => return Err(TRTError::TensorNotFound(args.input.clone())),
+    };
+
+    let batcher = DynamicBatcher::new(BatchConfig {
+        max_batch_size: args.max_batch_size.max(1),
+        max_delay: Duration::from_micros(args.max_delay_us),
+        ..BatchConfig::default()
+    });
+    let submitter = batcher.submitter();
+    let embeddings = Mutex::new(vec![None; paths.len()]);
+    let next = AtomicUsize::new(0);
+    let total = paths.len() * args.passes.max(1);
+    let graphs = AtomicUsize::new(0);
+
+    let start = Instant::now();
+    let served = thread::scope(|scope| -> TRTResult<usize> {
+        let workers: Vec<_> = (0..pool.capacity())
+            .map(|_| {
+                scope.spawn(|| -> TRTResult<()> {
+                    let ctx = CuDevice::new(args.device)?.retain_primary_context()?;
+                    let _guard = ctx.guard()?;
+                    let stream = CuStream::new()?;
+                    let mut engine = pool.checkout();
+                    let res = batcher.run(&mut engine, &stream);
+                    graphs.fetch_add(engine.num_cuda_graphs(), Ordering::Relaxed);
+                    if res.is_err() {
+                        // no new requests for a pipeline short of a context
+                        submitter.close();
+                    }
+                    res
+                })
+            })
+            .collect();
+        let clients: Vec<_> = (0..args.clients.max(1))
+            .map(|_| scope.spawn(|| client(args, paths, dtype, &submitter, &next, total, &embeddings)))
+            .collect();
+
+        let mut served = 0;
+        let mut result = Ok(());
+        for client in clients {
+            match client.join().unwrap() {
+                Ok(count) => served += count,
+                Err(err) => result = Err(err),
+            }
+        }
+        // the batchers drain and return
+        submitter.close();
+        for worker in workers {
+            worker.join().unwrap()?;
+        }
+        result.map(|_| served)
+    })?;
+    let rate = served as f64 / start.elapsed().as_secs_f64();
+    Ok((rate, embeddings.into_inner().unwrap(), graphs.into_inner()))
+}
+
+// Takes images off `next` until `total` were served: decodes each into a mapped pinned
+// buffer, preprocesses it from there into a device tensor of its own and submits that.
+fn client(
+    args: &Args,
+    paths: &[PathBuf],
+    dtype: DataType,
+    submitter: &BatchSubmitter,
+    next: &AtomicUsize,
+    total: usize,
+    embeddings: &Mutex<Vec<Option<Vec<f32>>>>,
+) -> TRTResult<usize> {
+    let ctx = CuDevice::new(args.device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+    let stream = CuStream::new()?;
+    let preprocessor = ImagePreprocessor::imagenet();
+    let input = Tensor::empty(&Shape::new(&[1, 3, args.size, args.size]), dtype, &stream)?;
+    let mut pixels: Option<Tensor> = None;
+
+    let mut served = 0;
+    loop {
+        let index = next.fetch_add(1, Ordering::Relaxed);
+        if index >= total {
+            return Ok(served);
+        }
+        let index = index % paths.len();
+        // uint8 HWC, the layout the preprocessing kernel reads
+        let image = tch::vision::image::load(&paths[index]).unwrap().permute([1, 2, 0]).contiguous();
+        let dims: Vec<i32> = image.size().iter().map(|&dim| dim as i32).collect();
+        let shape = Shape::new(&dims);
+        if pixels.as_ref().map_or(true, |pixels| pixels.capacity() < shape.size()) {
+            let capacity = shape.size().next_power_of_two();
+            pixels = Some(Tensor::host_mapped(&shape, capacity, DataType::UINT8, HostMemoryKind::Mapped, &stream)?);
+        }
+        let pixels = pixels.as_mut().unwrap();
+        // the previous image's preprocessing was synchronized below
+        unsafe { pixels.reset_shape(&shape)? };
+        let host = unsafe { pixels.host_slice_mut() }.unwrap();
+        image.copy_data_u8(host, shape.size());
+
+        // the kernel reads the pixels over PCIe in place; its result must be complete when
+        // submitted, and the batcher gathers it with the batch's other device inputs
+        preprocessor.run(pixels, &input, 0, &stream)?;
+        stream.synchronize()?;
+        let request = submitter.submit(vec![unsafe { BatchInput::device(&args.input, &input) }])?;
+        let outputs = match request.recv() {
+            Ok(outputs) => outputs?,
+            Err(_) => return Err(TRTError::QueueClosed),
+        };
+        let features = match outputs.iter().find(|output| output.name == args.output) {
+            Some(output) => output,
+            None => return Err(TRTError::TensorNotFound(args.output.clone())),
+        };
+        let mut embeddings = embeddings.lock().unwrap();
+        if embeddings[index].is_none() {
+            let row = features.data.chunks_exact(4).map(|bytes| f32::from_le_bytes(bytes.try_into().unwrap()));
+            embeddings[index] = Some(row.collect());
+        }
+        served += 1;
+    }
+}
@@ -1,64 +1,331 @@
 use clap::Parser;
 use cuda_rs::{device::CuDevice, stream::CuStream};
-use tensorrt::{TRTEngine, TRTResult, Shape, DataType, Tensor};
-use std::{collections::HashMap, path::Path};
+use std::{
+    collections::{BTreeMap, HashMap},
+    fs,
+    path::{Path, PathBuf},
+    process,
+    time::Instant,
+};
+use tensorrt::{
+    BucketPolicy, CtcDecoder, DataType, DbOptions, DbPostprocessor, HostMemoryKind, ImagePreprocessor, Shape,
+    TRTEngine, TRTError, TRTResult, Tensor, TextBox, TextCropper,
+};
 
+// The PP-OCR pipeline end to end on the device: an image is uploaded once (decoded into
+// mapped pinned memory the preprocessing kernels read in place), the DB detector's map is
+// post-processed on the GPU into boxes, every box is cropped out of a full-resolution
+// normalized copy of the image and resized to the recognizer's height in one launch, the
+// crops run through the recognizer in batches bucketed by width, and CTC decoding on the GPU
+// leaves only label ids to read back. Prints the text of every image as one JSON line, then
+// images and regions per second.
 #[derive(Parser, Debug)]
 #[command(author, version, about, long_about = None)]
 struct Args {
+    // the detector
     #[arg(short, long)]
     engine: String,
 
+    #[arg(short, long)]
+    rec_engine: String,
+
+    // PaddleOCR key file, one character per line
+    #[arg(long)]
+    dict: String,
+
+    // a jpg/jpeg/png image or a directory of them
     #[arg(short, long)]
     input_image: String,
+
+    #[arg(short, long, default_value_t = 0)]
+    device: i32,
+
+    #[arg(long, default_value = "x")]
+    det_input: String,
+
+    #[arg(long, default_value = "sigmoid_0.tmp_0")]
+    det_output: String,
+
+    #[arg(long, default_value = "x")]
+    rec_input: String,
+
+    // the longer side of the detector input, as PaddleOCR's det_limit_side_len
+    #[arg(long, default_value_t = 960)]
+    det_limit: i32,
+
+    #[arg(long, default_value_t = 48)]
+    rec_height: i32,
+
+    // crops are widened to a multiple of this, so the recognizer sees few distinct shapes
+    #[arg(long, default_value_t = 32)]
+    rec_width_multiple: i32,
+
+    // wider crops are squeezed
+    #[arg(long, default_value_t = 960)]
+    rec_max_width: i32,
+
+    #[arg(long, default_value_t = 16)]
+    rec_batch: usize,
+
+    // passes over the images; results are printed for the first
+    #[arg(long, default_value_t = 1)]
+    passes: usize,
+}
+
+// Regions of one image recognized together: their boxes, in image pixels, and the width
+// they are resized to.
+struct RecBatch {
+    width: i32,
+    boxes: Vec<usize>,
 }
 
 fn main() -> TRTResult<()> {
     let args = Args::parse();
-    let Args { engine: engine_path, .. } = args;
-    let engine_path = Path::new(&engine_path);
 
-    // 1 * 3 * 352 * 640
-    let input_shape = Shape(vec![1, 3, 352, 640]);
-    let output_shape = Shape(vec![1, 1, 352, 640]);
-    let dtype = DataType::FLOAT;
+    let input = Path::new(&args.input_image);
+    let mut paths: Vec<PathBuf> = match input.is_dir() {
+        true => fs::read_dir(input)?
+            .filter_map(|entry| entry.ok().map(|entry| entry.path()))
+            .filter(|path| {
+                let extension = path.extension().and_then(|extension| extension.to_str()).unwrap_or_default();
+                matches!(extension.to_ascii_lowercase().as_str(), "jpg" | "jpeg" | "png")
+            })
+            .collect(),
+        false => vec![input.to_path_buf()],
+    };
+    paths.sort();
+    if paths.is_empty() {
+        eprintln!("no images in {}", args.input_image);
+        process::exit(1);
+    }
 
-    let mem_size = input_shape.size() * dtype.get_elem_size();
-    let mut host_data = vec![0.0f32; mem_size];
-    let host_ptr = host_data.as_mut_ptr();
+    // the blank first and a space last, as PaddleOCR's use_space_char
+    let mut dictionary = vec![String::new()];
+    dictionary.extend(fs::read_to_string(&args.dict)?.lines().map(|line| line.trim_end_matches('\r').to_string()));
+    dictionary.push(" ".to_string());
 
     cuda_rs::init()?;
 
-    let device = CuDevice::new(0)?;
-    let ctx = device.retain_primary_context()?;
+    let ctx = CuDevice::new(args.device)?.retain_primary_context()?;
     let _guard = ctx.guard()?;
     let stream = CuStream::new()?;
 
-    let input_tensor = Tensor::empty(&input_shape, dtype, &stream)?;
-    input_tensor.get_memory().copy_from_raw(
-        host_ptr as _, mem_size, Some(&stream)
+    // sized from the profiles' max shapes; graphs are captured per detector size and per
+    // recognizer bucket, and replayed from then on
+    let mut det = TRTEngine::new(&Path::new(&args.engine), &stream)?;
+    det.activate()?;
+    det.allocate_io_tensors(&HashMap::new(), None)?;
+    det.enable_cuda_graphs(true);
+    let mut rec = TRTEngine::new(&Path::new(&args.rec_engine), &stream)?;
+    rec.activate()?;
+    rec.allocate_io_tensors(&HashMap::new(), None)?;
+    rec.enable_cuda_graphs(true);
+    let det_dtype = input_dtype(&det, &args.det_input)?;
+    let rec_dtype = input_dtype(&rec, &args.rec_input)?;
+    let rec_output = match rec.output_names().first() {
+        Some(name) => name.clone(),
+        None => return Err(TRTError::TensorNotFound("recognizer output".to_string())),
+    };
+
+    // PaddleOCR feeds its models BGR images, as decoded by OpenCV
+    let det_preprocessor = ImagePreprocessor::imagenet().swap_rb(true);
+    let rec_preprocessor = ImagePreprocessor::with_normalization(&[0.5; 3], &[0.5; 3]).swap_rb(true);
+    let det_max = round_up(args.det_limit, 32);
+    let mut det_input = Tensor::with_capacity(&Shape::new(&[1, 3, det_max, det_max]), 0, det_dtype, &stream)?;
+    let mut postprocessor = DbPostprocessor::new(DbOptions::default(), det_max as usize, det_max as usize, &stream)?;
+
+    let rec_batch = args.rec_batch.max(1);
+    let rec_max_width = round_up(args.rec_max_width, args.rec_width_multiple.max(1));
+    let buckets = BucketPolicy::round_up(&[3], args.rec_width_multiple);
+    let mut rec_input = Tensor::with_capacity(
+        &Shape::new(&[rec_batch as i32, 3, args.rec_height, rec_max_width]),
+        0,
+        rec_dtype,
+        &stream,
     )?;
+    let mut cropper = TextCropper::new(rec_batch, &stream)?;
+    // the recognizer emits at most one step per input column
+    let mut decoder = CtcDecoder::new(dictionary, 0, rec_batch, rec_max_width as usize, &stream)?;
+
+    // the full-resolution normalized image the crops are cut from, grown in place
+    let mut rec_source = Tensor::growable(&Shape::new(&[1, 3, 1, 1]), 0, 3 << 26, rec_dtype, &stream)?;
+    let mut pixels: Option<Tensor> = None;
 
-    let mut engine = TRTEngine::new(&engine_path, &stream).unwrap();
+    let (mut regions, mut det_time, mut rec_time) = (0, 0.0, 0.0);
+    let start = Instant::now();
+    for pass in 0..args.passes.max(1) {
+        for path in &paths {
+            let started = Instant::now();
+            // uint8 HWC, the layout the preprocessing kernels read
+            let image = tch::vision::image::load(path).unwrap().permute([1, 2, 0]).contiguous();
+            let dims: Vec<i32> = image.size().iter().map(|&dim| dim as i32).collect();
+            let shape = Shape::new(&dims);
+            let (height, width) = (dims[0], dims[1]);
+            if pixels.as_ref().map_or(true, |pixels| pixels.capacity() < shape.size()) {
+                let capacity = shape.size().next_power_of_two();
+                pixels = Some(Tensor::host_mapped(&shape, capacity, DataType::UINT8, HostMemoryKind::Mapped, &stream)?);
+            }
+            let pixels = pixels.as_mut().unwrap();
+            // the previous image's kernels were synchronized by its post-processing
+            unsafe { pixels.reset_shape(&shape)? };
+            image.copy_data_u8(unsafe { pixels.host_slice_mut() }.unwrap(), shape.size());
 
-    engine.activate()?;
+            let (det_height, det_width) = det_size(height, width, args.det_limit);
+            unsafe {
+                det_input.reset_shape(&Shape::new(&[1, 3, det_height, det_width]))?;
+                rec_source.reset_shape(&Shape::new(&[1, 3, height, width]))?;
+            }
+            det_preprocessor.run(pixels, &det_input, 0, &stream)?;
+            rec_preprocessor.run(pixels, &rec_source, 0, &stream)?;
+            let outputs = det.inference_zero_copy(&HashMap::from([(args.det_input.as_str(), &det_input)]), None)?;
+            let prob = match outputs.get(&args.det_output) {
+                Some(prob) => prob,
+                None => return Err(TRTError::TensorNotFound(args.det_output.clone())),
+            };
+            let (scale_x, scale_y) = (width as f32 / det_width as f32, height as f32 / det_height as f32);
+            let boxes: Vec<TextBox> =
+                postprocessor.run(prob, 0, &stream)?.iter().map(|text_box| text_box.scaled(scale_x, scale_y)).collect();
+            let rec_started = Instant::now();
+            det_time += (rec_started - started).as_secs_f64();
 
-    let max_shape_dict = HashMap::from([
-        ("x", &input_shape),
-        ("sigmoid_0.tmp_0", &output_shape),
-    ]);
-    engine.allocate_io_tensors(&max_shape_dict, None)?;
+            let mut texts = vec![(String::new(), 0.0); boxes.len()];
+            for batch in rec_batches(&boxes, args.rec_height, &buckets, rec_max_width, rec_batch) {
+                // a crop narrower than its bucket takes in the image to its right rather than
+                // being stretched, keeping its aspect ratio as PaddleOCR's zero padding does
+                let rects: Vec<TextBox> = batch
+                    .boxes
+                    .iter()
+                    .map(|&i| widened(&boxes[i], args.rec_height, batch.width, width as f32))
+                    .collect();
+                // padded to a power of two of rows, so few batch sizes are captured; the
+                // extra rows are left over from earlier batches and ignored
+                let rows = batch.boxes.len().next_power_of_two().min(rec_batch);
+                unsafe { rec_input.reset_shape(&Shape::new(&[rows as i32, 3, args.rec_height, batch.width]))? };
+                cropper.run(&rec_source, &rects, &rec_input, &stream)?;
+                let outputs = rec.inference_zero_copy(&HashMap::from([(args.rec_input.as_str(), &rec_input)]), None)?;
+                let probs = match outputs.get(&rec_output) {
+                    Some(probs) => probs,
+                    None => return Err(TRTError::TensorNotFound(rec_output.clone())),
+                };
+                for (&i, text) in batch.boxes.iter().zip(decoder.run(probs, batch.boxes.len(), &stream)?) {
+                    texts[i] = text;
+                }
+            }
+            rec_time += rec_started.elapsed().as_secs_f64();
+            regions += boxes.len();
 
-    let feed_dict = HashMap::from([
-        ("x", &input_tensor),
-    ]);
-    engine.inference(&feed_dict, None)?;
+            if pass == 0 {
+                println!("{}", image_json(path, &boxes, &texts));
+            }
+        }
+    }
+    let elapsed = start.elapsed().as_secs_f64();
+    let images = paths.len() * args.passes.max(1);
+    println!(
+        "{{\"images\":{},\"regions\":{},\"images_per_sec\":{},\"regions_per_sec\":{},\"det_ms_per_image\":{},\
+         \"rec_ms_per_image\":{},\"det_cuda_graphs\":{},\"rec_cuda_graphs\":{}}}",
+        images,
+        regions,
+        images as f64 / elapsed,
+        regions as f64 / elapsed,
+        det_time * 1e3 / images as f64,
+        rec_time * 1e3 / images as f64,
+        det.num_cuda_graphs(),
+        rec.num_cuda_graphs()
+    );
+    Ok(())
+}
 
-    stream.synchronize()?;
+fn input_dtype(engine: &TRTEngine, name: &str) -> TRTResult<DataType> {
+    match engine.io_schema()?.get(name) {
+        Some(tensor) => Ok(tensor.dtype),
+        None => Err(TRTError::TensorNotFound(name.to_string())),
+    }
+}
 
-    // TODO: post-processing
+fn round_up(value: i32, multiple: i32) -> i32 {
+    (value + multiple - 1) / multiple * multiple
+}
 
-    println!("Done");
+// The detector input of a height x width image: scaled down so its longer side is at most
+// `limit`, each side then rounded to a multiple of 32, as PaddleOCR's DetResizeForTest.
+fn det_size(height: i32, width: i32, limit: i32) -> (i32, i32) {
+    let ratio = match height.max(width) > limit {
+        true => limit as f32 / height.max(width) as f32,
+        false => 1.0,
+    };
+    let side = |dim: i32| (((dim as f32 * ratio / 32.0).round() as i32) * 32).clamp(32, round_up(limit, 32));
+    (side(height), side(width))
+}
 
-    Ok(())
+// The width of a box resized to `rec_height` with its aspect ratio kept.
+fn rec_width(text_box: &TextBox, rec_height: i32) -> i32 {
+    let (w, h) = (text_box.x1 - text_box.x0, (text_box.y1 - text_box.y0).max(1.0));
+    ((rec_height as f32 * w / h).ceil() as i32).max(1)
+}
+
+// Groups the boxes by their bucketed width, in batches of at most `max_rows`.
+fn rec_batches(
+    boxes: &[TextBox],
+    rec_height: i32,
+    buckets: &BucketPolicy,
+    max_width: i32,
+    max_rows: usize,
+) -> Vec<RecBatch> {
+    let mut by_width: BTreeMap<i32, Vec<usize>> = BTreeMap::new();
+    for (i, text_box) in boxes.iter().enumerate() {
+        let shape = Shape::new(&[1, 3, rec_height, rec_width(text_box, rec_height)]);
+        let width = buckets.bucket(&shape).map_or(shape[3], |bucket| bucket[3]).min(max_width);
+        by_width.entry(width).or_default().push(i);
+    }
+    by_width
+        .into_iter()
+        .flat_map(|(width, boxes)| {
+            boxes.chunks(max_rows).map(|boxes| RecBatch { width, boxes: boxes.to_vec() }).collect::<Vec<_>>()
+        })
+        .collect()
+}
+
+// `text_box` extended to the right to fill a crop `width` wide at `rec_height`, up to the
+// image's edge.
+fn widened(text_box: &TextBox, rec_height: i32, width: i32, image_width: f32) -> TextBox {
+    let exact = rec_width(text_box, rec_height);
+    if exact >= width {
+        return *text_box;
+    }
+    let x1 = text_box.x0 + (text_box.x1 - text_box.x0) * width as f32 / exact as f32;
+    TextBox { x1: x1.min(image_width), ..*text_box }
+}
+
+fn escape_json(text: &str) -> String {
+    let mut out = String::with_capacity(text.len());
+    for c in text.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            c if (c as u32) < 0x20 => out.push_str(&format!("\\u{:04x}", c as u32)),
+            c => out.push(c),
+        }
+    }
+    out
+}
+
+// {"image":..,"texts":[{"box":[x0,y0,x1,y1],"text":..,"score":..},..]}
+fn image_json(path: &Path, boxes: &[TextBox], texts: &[(String, f32)]) -> String {
+    let texts: Vec<String> = boxes
+        .iter()
+        .zip(texts)
+        .map(|(text_box, (text, score))| {
+            format!(
+                "{{\"box\":[{:.1},{:.1},{:.1},{:.1}],\"text\":\"{}\",\"score\":{}}}",
+                text_box.x0,
+                text_box.y0,
+                text_box.x1,
+                text_box.y1,
+                escape_json(text),
+                score
+            )
+        })
+        .collect();
+    format!("{{\"image\":\"{}\",\"texts\":[{}]}}", escape_json(&path.display().to_string()), texts.join(","))
 }
@@ -0,0 +1,107 @@
+use clap::{Parser, ValueEnum};
+use tensorrt::{run_benchmark, BenchOptions, TRTResult, UploadMemory, WaitStrategy};
+use std::{fs, path::Path, time::Duration};
+
+#[derive(ValueEnum, Clone, Copy, Debug)]
+enum Wait {
+    Context,
+    Spin,
+    // spin 100us, then yield
+    Yield,
+    Blocking,
+    Callback,
+}
+
+#[derive(ValueEnum, Clone, Copy, Debug)]
+enum Upload {
+    Pinned,
+    Pageable,
+}
+
+// Latency and throughput of a plan through this crate's serving path, as JSON, for comparing
+// against trtexec on the same plan.
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long)]
+    engine: String,
+
+    #[arg(short, long, default_value_t = 0)]
+    device: i32,
+
+    #[arg(short, long, default_value_t = 0)]
+    profile: i32,
+
+    // Leading dims to run the profile's opt shapes at, e.g. 1,8,32.
+    #[arg(short, long, value_delimiter = ',')]
+    batch_sizes: Vec<i32>,
+
+    #[arg(short, long, value_delimiter = ',', default_value = "1")]
+    concurrency: Vec<usize>,
+
+    #[arg(short, long, default_value_t = 10)]
+    warmup: usize,
+
+    #[arg(short, long, default_value_t = 200)]
+    iterations: usize,
+
+    // How iterations wait for the GPU.
+    #[arg(long, value_enum, default_value_t = Wait::Context)]
+    wait: Wait,
+
+    // CUDA graph settings to run, e.g. false,true.
+    #[arg(long, value_delimiter = ',', default_value = "false")]
+    cuda_graphs: Vec<bool>,
+
+    // Host memory for the copies, e.g. pinned,pageable.
+    #[arg(long, value_enum, value_delimiter = ',', default_value = "pinned")]
+    uploads: Vec<Upload>,
+
+    // Writes the report here instead of stdout.
+    #[arg(short, long)]
+    output: Option<String>,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    cuda_rs::init()?;
+
+    let wait_strategy = match args.wait {
+        Wait::Context => WaitStrategy::Context,
+        Wait::Spin => WaitStrategy::Spin,
+        Wait::Yield => WaitStrategy::SpinThenYield(Duration::from_micros(100)),
+        Wait::Blocking => WaitStrategy::BlockingSync,
+        Wait::Callback => WaitStrategy::HostCallback,
+    };
+
+    let uploads = args
+        .uploads
+        .iter()
+        .map(|upload| match upload {
+            Upload::Pinned => UploadMemory::Pinned,
+            Upload::Pageable => UploadMemory::Pageable,
+        })
+        .collect();
+
+    let options = BenchOptions {
+        device: args.device,
+        profile: args.profile,
+        batch_sizes: args.batch_sizes,
+        concurrency: args.concurrency,
+        warmup_iterations: args.warmup,
+        iterations: args.iterations,
+        wait_strategy,
+        cuda_graphs: args.cuda_graphs,
+        uploads,
+        ..BenchOptions::default()
+    };
+    let report = run_benchmark(&Path::new(&args.engine), &options)?;
+
+    match args.output {
+        Some(path) => fs::write(path, report.to_json())?,
+        None => println!("{}", report.to_json()),
+    }
+
+    Ok(())
+}
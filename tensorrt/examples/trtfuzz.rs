@@ -0,0 +1,102 @@
+use clap::{Parser, ValueEnum};
+use std::{fs, process};
+use tensorrt::{run_shape_fuzz, ShapeFuzzOptions, ShapePattern, TRTResult};
+
+#[derive(ValueEnum, Clone, Copy, Debug)]
+enum Pattern {
+    Random,
+    Alternate,
+    Ramp,
+    Revisit,
+}
+
+impl Pattern {
+    fn shape_pattern(self) -> ShapePattern {
+        match self {
+            Pattern::Random => ShapePattern::Random,
+            Pattern::Alternate => ShapePattern::Alternate,
+            Pattern::Ramp => ShapePattern::Ramp,
+            Pattern::Revisit => ShapePattern::Revisit,
+        }
+    }
+}
+
+// Drives a dynamic-shape plan through random and adversarial input shape sequences, reports
+// the cost of every shape change as JSON and checks the outputs against a plain reference
+// context; exits with 1 if any output differed or a step failed.
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long)]
+    engine: String,
+
+    #[arg(short, long, default_value_t = 0)]
+    device: i32,
+
+    // Profiles to draw shapes from, e.g. 0,1.
+    #[arg(short, long, value_delimiter = ',', default_value = "0")]
+    profiles: Vec<i32>,
+
+    // Shape sequences to run: random, alternate, ramp and/or revisit.
+    #[arg(long, value_enum, value_delimiter = ',', default_value = "random,alternate,ramp,revisit")]
+    patterns: Vec<Pattern>,
+
+    #[arg(short, long, default_value_t = 200)]
+    steps: usize,
+
+    // Inferences at every shape after the first.
+    #[arg(short, long, default_value_t = 2)]
+    repeats: usize,
+
+    #[arg(long, default_value_t = 0x5eed)]
+    seed: u64,
+
+    #[arg(long)]
+    cuda_graphs: bool,
+
+    // Rounds the dynamic dims of every input up to this multiple.
+    #[arg(long)]
+    bucket: Option<i32>,
+
+    // Compares outputs every this many steps, 0 for never.
+    #[arg(long, default_value_t = 1)]
+    check_every: usize,
+
+    #[arg(long, default_value_t = 1e-3)]
+    tolerance: f32,
+
+    // Writes the report here instead of stdout.
+    #[arg(short, long)]
+    output: Option<String>,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    cuda_rs::init()?;
+
+    let options = ShapeFuzzOptions {
+        device: args.device,
+        profiles: args.profiles,
+        patterns: args.patterns.iter().map(|pattern| pattern.shape_pattern()).collect(),
+        steps: args.steps,
+        repeats: args.repeats,
+        seed: args.seed,
+        cuda_graphs: args.cuda_graphs,
+        bucket_multiple: args.bucket,
+        check_every: args.check_every,
+        tolerance: args.tolerance,
+        ..ShapeFuzzOptions::default()
+    };
+    let report = run_shape_fuzz(&args.engine, &options)?;
+
+    match args.output {
+        Some(path) => fs::write(path, report.to_json())?,
+        None => println!("{}", report.to_json()),
+    }
+    if !report.passed() {
+        process::exit(1);
+    }
+
+    Ok(())
+}
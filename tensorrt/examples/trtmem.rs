@@ -0,0 +1,106 @@
+use clap::{Parser, ValueEnum};
+use std::{env, fs, process::Command, time::Duration};
+use tensorrt::{run_memory_benchmark, LoadMode, MemoryBenchOptions, TRTResult};
+
+#[derive(ValueEnum, Clone, Copy, Debug)]
+enum Mode {
+    Read,
+    Mmap,
+    Streaming,
+    #[value(name = "shared_arena")]
+    SharedArena,
+}
+
+impl Mode {
+    fn load_mode(self) -> LoadMode {
+        match self {
+            Mode::Read => LoadMode::Read,
+            Mode::Mmap => LoadMode::Mmap,
+            Mode::Streaming => LoadMode::Streaming,
+            Mode::SharedArena => LoadMode::SharedArena,
+        }
+    }
+}
+
+// Host and device memory of loading a plan and serving from it, per load mode, as JSON for
+// regression checks against the fs::read baseline. Every mode runs in a process of its own,
+// so each peak resident set is that mode's alone.
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long)]
+    engine: String,
+
+    #[arg(short, long, default_value_t = 0)]
+    device: i32,
+
+    #[arg(short, long, default_value_t = 0)]
+    profile: i32,
+
+    // Load modes to measure.
+    #[arg(short, long, value_enum, value_delimiter = ',', default_value = "read,mmap,streaming,shared_arena")]
+    modes: Vec<Mode>,
+
+    // Execution contexts created on the engine.
+    #[arg(short, long, default_value_t = 1)]
+    contexts: usize,
+
+    // Inferences per context before the steady state is measured.
+    #[arg(short, long, default_value_t = 20)]
+    iterations: usize,
+
+    // Device memory sampling interval while loading, in microseconds.
+    #[arg(long, default_value_t = 1000)]
+    sample_us: u64,
+
+    // Writes the reports here instead of stdout.
+    #[arg(short, long)]
+    output: Option<String>,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    let modes: Vec<LoadMode> = args.modes.iter().map(|mode| mode.load_mode()).collect();
+
+    let report = match modes.as_slice() {
+        [mode] => {
+            cuda_rs::init()?;
+            let options = MemoryBenchOptions {
+                device: args.device,
+                profile: args.profile,
+                mode: *mode,
+                contexts: args.contexts,
+                iterations: args.iterations,
+                sample_interval: Duration::from_micros(args.sample_us),
+                ..MemoryBenchOptions::default()
+            };
+            run_memory_benchmark(&args.engine, &options)?.to_json()
+        }
+        _ => {
+            // the same arguments with one mode each
+            let exe = env::current_exe()?;
+            let mut reports = Vec::new();
+            for mode in &modes {
+                let mut command = Command::new(&exe);
+                command.args(["--engine", &args.engine, "--modes", mode.name()]);
+                command.args(["--device", &args.device.to_string(), "--profile", &args.profile.to_string()]);
+                command.args(["--contexts", &args.contexts.to_string(), "--iterations", &args.iterations.to_string()]);
+                command.args(["--sample-us", &args.sample_us.to_string()]);
+                let output = command.output()?;
+                if !output.status.success() {
+                    panic!("{} failed: {}", mode.name(), String::from_utf8_lossy(&output.stderr));
+                }
+                reports.push(String::from_utf8_lossy(&output.stdout).trim().to_string());
+            }
+            format!("[{}]", reports.join(","))
+        }
+    };
+
+    match args.output {
+        Some(path) => fs::write(path, report)?,
+        None => println!("{}", report),
+    }
+
+    Ok(())
+}
@@ -0,0 +1,230 @@
+use clap::Parser;
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use tensorrt::{
+    BatchConfig, BatchInput, DynamicBatcher, LatencyStats, RequestRecord, Shape, TRTEngine, TRTResult, Tensor,
+    TraceReader, TraceRecord,
+};
+use std::{
+    collections::HashMap,
+    fmt::Write,
+    fs,
+    path::Path,
+    sync::mpsc,
+    thread,
+    time::{Duration, Instant},
+};
+
+// Replays a trace recorded with TraceRecorder against a plan: requests arrive on the trace's
+// schedule with its shapes (and sampled bytes, zeros elsewhere), either straight through
+// TRTEngine::inference or through a DynamicBatcher, and latency is reported as JSON. A
+// request is timed from its scheduled arrival, so falling behind the trace shows as queueing.
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long)]
+    engine: String,
+
+    #[arg(short, long)]
+    trace: String,
+
+    #[arg(short, long, default_value_t = 0)]
+    device: i32,
+
+    // Arrival rate relative to the trace, e.g. 2 replays it twice as fast.
+    #[arg(short, long, default_value_t = 1.0)]
+    speed: f64,
+
+    // Replays through a DynamicBatcher of this batch size instead of request by request.
+    #[arg(long)]
+    max_batch_size: Option<usize>,
+
+    #[arg(long, default_value_t = 2000)]
+    max_delay_us: u64,
+
+    // Writes the report here instead of stdout.
+    #[arg(short, long)]
+    output: Option<String>,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    let mut requests = Vec::new();
+    for record in TraceReader::open(&Path::new(&args.trace))? {
+        if let TraceRecord::Request(request) = record? {
+            requests.push(request);
+        }
+    }
+    requests.sort_by_key(|request| request.arrival);
+
+    cuda_rs::init()?;
+
+    let device = CuDevice::new(args.device)?;
+    let ctx = device.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+    let stream = CuStream::new()?;
+
+    let mut engine = TRTEngine::new(&Path::new(&args.engine), &stream)?;
+    engine.activate()?;
+    engine.allocate_io_tensors(&HashMap::new(), None)?;
+
+    let speed = args.speed.max(1e-6);
+    let start = Instant::now();
+    let (latencies, failed) = match args.max_batch_size {
+        Some(max_batch_size) => {
+            let config = BatchConfig {
+                max_batch_size,
+                max_delay: Duration::from_micros(args.max_delay_us),
+                ..BatchConfig::default()
+            };
+            replay_batched(&mut engine, &stream, config, &requests, start, speed)?
+        }
+        None => replay(&mut engine, &stream, &requests, start, speed)?,
+    };
+    let elapsed = start.elapsed();
+
+    let report = to_json(&requests, &LatencyStats::from_samples(&latencies), failed, elapsed, speed);
+    match args.output {
+        Some(path) => fs::write(path, report)?,
+        None => println!("{}", report),
+    }
+
+    Ok(())
+}
+
+fn scheduled(start: Instant, request: &RequestRecord, speed: f64) -> Instant {
+    let due = start + request.arrival.div_f64(speed);
+    if let Some(wait) = due.checked_duration_since(Instant::now()) {
+        thread::sleep(wait);
+    }
+    due
+}
+
+fn since_ms(due: Instant) -> f32 {
+    due.elapsed().as_secs_f32() * 1000.0
+}
+
+// Request by request on one stream; a device tensor per input shape is reused.
+fn replay(
+    engine: &mut TRTEngine,
+    stream: &CuStream,
+    requests: &[RequestRecord],
+    start: Instant,
+    speed: f64,
+) -> TRTResult<(Vec<f32>, usize)> {
+    let mut tensors: HashMap<(String, Shape), Tensor> = HashMap::new();
+    let mut latencies = Vec::with_capacity(requests.len());
+    let mut failed = 0;
+    for request in requests {
+        for input in &request.inputs {
+            let key = (input.name.clone(), input.shape);
+            if !tensors.contains_key(&key) {
+                tensors.insert(key.clone(), Tensor::empty(&input.shape, input.dtype, stream)?);
+            }
+            if !input.data.is_empty() {
+                tensors[&key].get_memory().copy_from_raw(input.data.as_ptr() as _, input.data.len(), Some(stream))?;
+            }
+        }
+        let feed_dict: HashMap<&str, &Tensor> = request
+            .inputs
+            .iter()
+            .map(|input| (input.name.as_str(), &tensors[&(input.name.clone(), input.shape)]))
+            .collect();
+
+        let due = scheduled(start, request, speed);
+        let res = engine.inference(&feed_dict, Some(stream)).map(|_| ());
+        stream.synchronize()?;
+        match res {
+            Ok(()) => latencies.push(since_ms(due)),
+            Err(_) => failed += 1,
+        }
+    }
+    Ok((latencies, failed))
+}
+
+// Requests are submitted on the trace's schedule from a thread of their own and their
+// results awaited on another, while this thread runs the batcher.
+fn replay_batched(
+    engine: &mut TRTEngine,
+    stream: &CuStream,
+    config: BatchConfig,
+    requests: &[RequestRecord],
+    start: Instant,
+    speed: f64,
+) -> TRTResult<(Vec<f32>, usize)> {
+    let batcher = DynamicBatcher::new(config);
+    let submitter = batcher.submitter();
+    let (sender, receiver) = mpsc::channel();
+    let requests = requests.to_vec();
+    let feeder = thread::spawn(move || {
+        for request in &requests {
+            let inputs = request
+                .inputs
+                .iter()
+                .map(|input| {
+                    let mut data = input.data.clone();
+                    data.resize(input.shape.size() * input.dtype.get_elem_size(), 0);
+                    BatchInput::host(&input.name, input.shape, data)
+                })
+                .collect();
+            let due = scheduled(start, request, speed);
+            sender.send((due, submitter.submit(inputs))).ok();
+        }
+        submitter.close();
+    });
+    let collector = thread::spawn(move || {
+        let (mut latencies, mut failed) = (Vec::new(), 0);
+        for (due, request) in receiver {
+            match request.map(|request| request.recv()) {
+                Ok(Ok(Ok(_))) => latencies.push(since_ms(due)),
+                _ => failed += 1,
+            }
+        }
+        (latencies, failed)
+    });
+
+    let res = batcher.run(engine, stream);
+    // a failed batch stops the batcher; the requests still queued fail as it is dropped
+    drop(batcher);
+    feeder.join().ok();
+    let collected = collector.join().unwrap_or_default();
+    res.map(|_| collected)
+}
+
+fn to_json(requests: &[RequestRecord], latency: &LatencyStats, failed: usize, elapsed: Duration, speed: f64) -> String {
+    // how often each combination of input shapes arrived
+    let mut shapes: HashMap<String, usize> = HashMap::new();
+    for request in requests {
+        let mut key: Vec<_> = request.inputs.iter().map(|input| format!("{}:{:?}", input.name, input.shape)).collect();
+        key.sort();
+        *shapes.entry(key.join(",")).or_default() += 1;
+    }
+    let mut shapes: Vec<_> = shapes.into_iter().collect();
+    shapes.sort_by(|a, b| b.1.cmp(&a.1));
+
+    let trace_span = requests.last().map_or(Duration::ZERO, |request| request.arrival);
+    let mut out = String::new();
+    write!(
+        out,
+        "{{\"requests\":{},\"failed\":{},\"speed\":{},\"trace_s\":{},\"replay_s\":{},",
+        requests.len(),
+        failed,
+        speed,
+        trace_span.as_secs_f64(),
+        elapsed.as_secs_f64(),
+    )
+    .ok();
+    write!(
+        out,
+        "\"latency\":{{\"count\":{},\"mean_ms\":{},\"p50_ms\":{},\"p90_ms\":{},\"p99_ms\":{},\"max_ms\":{}}},",
+        latency.count, latency.mean_ms, latency.p50_ms, latency.p90_ms, latency.p99_ms, latency.max_ms,
+    )
+    .ok();
+    out.push_str("\"shapes\":[");
+    for (i, (shape, count)) in shapes.iter().enumerate() {
+        let sep = if i == 0 { "" } else { "," };
+        write!(out, "{}{{\"inputs\":\"{}\",\"count\":{}}}", sep, shape.replace('"', "\\\""), count).ok();
+    }
+    out.push_str("]}");
+    out
+}
@@ -0,0 +1,38 @@
+use clap::Parser;
+use tensorrt::{compress_plan, CompressOptions, TRTResult};
+use std::{
+    fs::File,
+    io::{BufReader, BufWriter},
+};
+
+// Compresses a plan for TRTEngine::from_compressed and EngineLoader (which takes .zst paths
+// as compressed), in frames decompressed in parallel at load time.
+//
+//   trtzip --plan model.plan --output model.plan.zst
+#[derive(Parser, Debug)]
+#[command(author, version, about, long_about = None)]
+struct Args {
+    #[arg(short, long)]
+    plan: String,
+
+    #[arg(short, long)]
+    output: String,
+
+    #[arg(short, long, default_value_t = 9)]
+    level: i32,
+
+    #[arg(short, long, default_value_t = 8)]
+    frame_mb: usize,
+}
+
+fn main() -> TRTResult<()> {
+    let args = Args::parse();
+
+    let options = CompressOptions { level: args.level, frame_size: args.frame_mb << 20 };
+    let src = BufReader::new(File::open(&args.plan)?);
+    let size = src.get_ref().metadata()?.len();
+    let compressed = compress_plan(src, BufWriter::new(File::create(&args.output)?), &options)?;
+    println!("{} -> {}: {} -> {} bytes", args.plan, args.output, size, compressed);
+
+    Ok(())
+}
@@ -0,0 +1,219 @@
+use crate::error::{TRTError, TRTResult};
+use std::sync::{
+    atomic::{AtomicBool, AtomicUsize, Ordering},
+    Arc, RwLock,
+};
+
+// What the device memory allocated by this crate holds.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub enum MemoryCategory {
+    // Engine weights, counted as the plan size when the engine is deserialized.
+    Weights,
+    // Activation scratch of execution contexts, and of arenas shared by several of them.
+    Context,
+    // Tensors allocated by the crate, e.g. IO tensors of allocate_io_tensors.
+    Tensors,
+    // Blocks held by DeviceMemoryPools, idle or handed out.
+    Pool,
+    // Buffers of data-dependent outputs, grown during enqueue.
+    Outputs,
+}
+
+const NUM_CATEGORIES: usize = 5;
+
+impl MemoryCategory {
+    fn index(self) -> usize {
+        match self {
+            MemoryCategory::Weights => 0,
+            MemoryCategory::Context => 1,
+            MemoryCategory::Tensors => 2,
+            MemoryCategory::Pool => 3,
+            MemoryCategory::Outputs => 4,
+        }
+    }
+}
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum MemoryEventKind {
+    Reserved,
+    Released,
+    // over the budget; nothing was allocated
+    Rejected,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct MemoryEvent {
+    pub kind: MemoryEventKind,
+    pub category: MemoryCategory,
+    pub bytes: usize,
+    // bytes accounted in total after the event
+    pub total: usize,
+}
+
+// Bytes currently accounted, by category.
+#[derive(Debug, Copy, Clone, Default, PartialEq, Eq)]
+pub struct MemoryUsage {
+    pub weights: usize,
+    pub context: usize,
+    pub tensors: usize,
+    pub pool: usize,
+    pub outputs: usize,
+}
+
+impl MemoryUsage {
+    pub fn total(&self) -> usize {
+        self.weights + self.context + self.tensors + self.pool + self.outputs
+    }
+}
+
+// Device memory held by one TRTEngine. The weights belong to the deserialized engine and
+// are shared by every context created from it, e.g. those of an EnginePool; the rest is
+// the context's own.
+#[derive(Debug, Copy, Clone, Default, PartialEq, Eq)]
+pub struct EngineMemoryUsage {
+    pub weights: usize,
+    // zero for contexts running in a shared DeviceMemoryArena
+    pub context: usize,
+    pub io_tensors: usize,
+    pub outputs: usize,
+}
+
+impl EngineMemoryUsage {
+    pub fn total(&self) -> usize {
+        self.weights + self.context + self.io_tensors + self.outputs
+    }
+}
+
+pub type MemoryHook = Arc<dyn Fn(&MemoryEvent) + Send + Sync>;
+
+// usize::MAX when no budget is set
+static BUDGET: AtomicUsize = AtomicUsize::new(usize::MAX);
+static TOTAL: AtomicUsize = AtomicUsize::new(0);
+static BY_CATEGORY: [AtomicUsize; NUM_CATEGORIES] = [
+    AtomicUsize::new(0),
+    AtomicUsize::new(0),
+    AtomicUsize::new(0),
+    AtomicUsize::new(0),
+    AtomicUsize::new(0),
+];
+static HOOKED: AtomicBool = AtomicBool::new(false);
+static HOOK: RwLock<Option<MemoryHook>> = RwLock::new(None);
+
+// Caps the device memory the crate allocates in this process, over every device. An
+// allocation that would exceed it fails with TRTError::MemoryBudgetExceeded before any
+// CUDA call is made. Memory TensorRT allocates on its own (e.g. through a GpuAllocator) is
+// not accounted.
+pub fn set_device_memory_budget(budget: Option<usize>) {
+    BUDGET.store(budget.unwrap_or(usize::MAX), Ordering::Relaxed);
+}
+
+pub fn get_device_memory_budget() -> Option<usize> {
+    match BUDGET.load(Ordering::Relaxed) {
+        usize::MAX => None,
+        budget => Some(budget),
+    }
+}
+
+pub fn device_memory_usage() -> MemoryUsage {
+    let load = |category: MemoryCategory| BY_CATEGORY[category.index()].load(Ordering::Relaxed);
+    MemoryUsage {
+        weights: load(MemoryCategory::Weights),
+        context: load(MemoryCategory::Context),
+        tensors: load(MemoryCategory::Tensors),
+        pool: load(MemoryCategory::Pool),
+        outputs: load(MemoryCategory::Outputs),
+    }
+}
+
+// Called on every reservation, release and rejection, on the allocating thread; keep it
+// cheap. None removes the hook.
+pub fn set_memory_hook(hook: Option<MemoryHook>) {
+    let mut slot = HOOK.write().unwrap();
+    HOOKED.store(hook.is_some(), Ordering::Release);
+    *slot = hook;
+}
+
+fn notify(kind: MemoryEventKind, category: MemoryCategory, bytes: usize, total: usize) {
+    if !HOOKED.load(Ordering::Acquire) {
+        return;
+    }
+    if let Some(hook) = HOOK.read().unwrap().as_ref() {
+        hook(&MemoryEvent { kind, category, bytes, total });
+    }
+}
+
+// Device memory accounted against the budget until dropped.
+#[derive(Debug)]
+pub(crate) struct MemoryReservation {
+    category: MemoryCategory,
+    bytes: usize,
+}
+
+impl MemoryReservation {
+    pub(crate) fn new(category: MemoryCategory, bytes: usize) -> TRTResult<Self> {
+        let budget = BUDGET.load(Ordering::Relaxed);
+        let mut total = TOTAL.load(Ordering::Relaxed);
+        loop {
+            let next = match total.checked_add(bytes) {
+                Some(next) if next <= budget => next,
+                _ => {
+                    notify(MemoryEventKind::Rejected, category, bytes, total);
+                    return Err(TRTError::MemoryBudgetExceeded(bytes, total, budget));
+                }
+            };
+            match TOTAL.compare_exchange_weak(total, next, Ordering::Relaxed, Ordering::Relaxed) {
+                Ok(_) => break,
+                Err(current) => total = current,
+            }
+        }
+        BY_CATEGORY[category.index()].fetch_add(bytes, Ordering::Relaxed);
+        notify(MemoryEventKind::Reserved, category, bytes, total + bytes);
+        Ok(Self { category, bytes })
+    }
+
+    // Nothing accounted, e.g. for memory the crate does not own.
+    pub(crate) fn none(category: MemoryCategory) -> Self {
+        Self { category, bytes: 0 }
+    }
+
+    pub(crate) fn bytes(&self) -> usize {
+        self.bytes
+    }
+}
+
+impl Drop for MemoryReservation {
+    fn drop(&mut self) {
+        if self.bytes == 0 {
+            return;
+        }
+        BY_CATEGORY[self.category.index()].fetch_sub(self.bytes, Ordering::Relaxed);
+        let total = TOTAL.fetch_sub(self.bytes, Ordering::Relaxed) - self.bytes;
+        notify(MemoryEventKind::Released, self.category, self.bytes, total);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // the counters are process-wide, so everything runs in one test
+    #[test]
+    fn reservations_are_accounted_and_bounded() {
+        let base = device_memory_usage();
+        let weights = MemoryReservation::new(MemoryCategory::Weights, 1000).unwrap();
+        let tensors = MemoryReservation::new(MemoryCategory::Tensors, 24).unwrap();
+        let usage = device_memory_usage();
+        assert_eq!(usage.weights, base.weights + 1000);
+        assert_eq!(usage.tensors, base.tensors + 24);
+
+        set_device_memory_budget(Some(usage.total() + 100));
+        assert!(MemoryReservation::new(MemoryCategory::Pool, 101).is_err());
+        let pool = MemoryReservation::new(MemoryCategory::Pool, 100).unwrap();
+        drop(weights);
+        assert!(MemoryReservation::new(MemoryCategory::Pool, 1000).is_ok());
+        set_device_memory_budget(None);
+
+        drop((tensors, pool));
+        assert_eq!(device_memory_usage(), base);
+    }
+}
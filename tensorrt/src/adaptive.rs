@@ -0,0 +1,283 @@
+use crate::error::{TRTError, TRTResult};
+use std::{
+    collections::VecDeque,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc, Mutex,
+    },
+    time::Duration,
+};
+use tensorrt_rs_sys::stream::CudaEvent;
+
+// Weight of the latest measurement in a batch size's GPU time.
+const GPU_TIME_SMOOTHING: f64 = 0.2;
+// Batch sizes within this share of the best throughput count as good as it; the largest wins.
+const THROUGHPUT_TOLERANCE: f64 = 0.95;
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct AdaptiveBatchingOptions {
+    // Request latency, submission to result, that 99% of requests should stay within.
+    pub p99_target: Duration,
+    // Bounds of the batch-size cap; the upper one is further clamped like
+    // BatchConfig::max_batch_size.
+    pub min_batch_size: usize,
+    pub max_batch_size: usize,
+    // Upper bound on how long a batch waits to fill.
+    pub max_delay: Duration,
+    // Latest request latencies the p99 is taken over.
+    pub window: usize,
+    // Batches between adjustments.
+    pub adjust_every: usize,
+}
+
+impl Default for AdaptiveBatchingOptions {
+    fn default() -> Self {
+        Self {
+            p99_target: Duration::from_millis(20),
+            min_batch_size: 1,
+            max_batch_size: 64,
+            max_delay: Duration::from_millis(10),
+            window: 512,
+            adjust_every: 16,
+        }
+    }
+}
+
+// What the batcher currently batches with, in place of BatchConfig's max_batch_size and
+// max_delay (interactive requests keep their own delay).
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct BatchLimits {
+    pub max_batch_size: usize,
+    pub max_delay: Duration,
+}
+
+struct ControllerState {
+    // smoothed GPU seconds of a batch of `index + 1` rows
+    gpu_time: Vec<Option<f64>>,
+    // seconds, latest last
+    latencies: VecDeque<f64>,
+    // mean queue wait of the oldest request of the batches since the last adjustment
+    queue_wait: f64,
+    batches: usize,
+    // share of the target the limits are planned against, lowered while the p99 misses it
+    scale: f64,
+    limits: BatchLimits,
+}
+
+impl ControllerState {
+    fn new(options: &AdaptiveBatchingOptions) -> Self {
+        let max_batch_size = options.max_batch_size.max(1);
+        Self {
+            gpu_time: vec![None; max_batch_size],
+            latencies: VecDeque::new(),
+            queue_wait: 0.0,
+            batches: 0,
+            scale: 1.0,
+            limits: BatchLimits {
+                max_batch_size: options.min_batch_size.clamp(1, max_batch_size),
+                max_delay: Duration::ZERO,
+            },
+        }
+    }
+
+    fn observe(
+        &mut self,
+        rows: usize,
+        gpu_time: Option<Duration>,
+        oldest_wait: Duration,
+        latencies: &[Duration],
+        window: usize,
+    ) {
+        let slot = rows.checked_sub(1).and_then(|index| self.gpu_time.get_mut(index));
+        if let (Some(gpu_time), Some(slot)) = (gpu_time, slot) {
+            let seconds = gpu_time.as_secs_f64();
+            *slot = Some(match *slot {
+                Some(smoothed) => smoothed + GPU_TIME_SMOOTHING * (seconds - smoothed),
+                None => seconds,
+            });
+        }
+        for latency in latencies {
+            if self.latencies.len() == window.max(1) {
+                self.latencies.pop_front();
+            }
+            self.latencies.push_back(latency.as_secs_f64());
+        }
+        self.batches += 1;
+        self.queue_wait += (oldest_wait.as_secs_f64() - self.queue_wait) / self.batches as f64;
+    }
+
+    // GPU seconds of a batch of `rows`: measured, or scaled linearly from the nearest
+    // smaller measured size, which overestimates as batching amortizes.
+    fn estimate(&self, rows: usize) -> Option<f64> {
+        (1..=rows.min(self.gpu_time.len()))
+            .rev()
+            .find_map(|size| self.gpu_time[size - 1].map(|seconds| seconds * rows as f64 / size as f64))
+    }
+
+    fn p99(&self) -> Option<f64> {
+        if self.latencies.is_empty() {
+            return None;
+        }
+        let mut sorted: Vec<f64> = self.latencies.iter().copied().collect();
+        sorted.sort_by(|a, b| a.total_cmp(b));
+        let rank = (0.99 * sorted.len() as f64).ceil() as usize;
+        Some(sorted[rank.clamp(1, sorted.len()) - 1])
+    }
+
+    // A request may wait for the batch to fill and for the batch ahead of it, and then runs:
+    // about max_delay + 2 x its batch's GPU time. The cap is the batch size of the best
+    // throughput (rows per GPU second) that keeps this within the scaled target, probing at
+    // most twice the largest size measured so far; the delay takes what is left. When the
+    // queue backs up, arrivals outpace the GPU and smaller batches would only make it worse,
+    // so the cap goes to the best throughput and batches stop waiting.
+    fn adjust(&mut self, options: &AdaptiveBatchingOptions) {
+        let target = options.p99_target.as_secs_f64();
+        let (cap, delay) = (self.limits.max_batch_size, self.limits.max_delay.as_secs_f64());
+        let backlogged = self.estimate(cap).map_or(false, |gpu| self.queue_wait > 2.0 * (delay + gpu));
+        match self.p99() {
+            Some(p99) if p99 > target && !backlogged => self.scale = (self.scale * 0.7).max(0.05),
+            Some(p99) if p99 < 0.8 * target => self.scale = (self.scale + 0.05).min(1.0),
+            _ => {}
+        }
+        let budget = self.scale * target;
+
+        let min = options.min_batch_size.clamp(1, self.gpu_time.len());
+        let largest = (1..=self.gpu_time.len()).rev().find(|&size| self.gpu_time[size - 1].is_some());
+        let probe = largest.map_or(cap, |largest| (2 * largest).max(cap).min(self.gpu_time.len()));
+        let candidates: Vec<(usize, f64)> = (min..=probe)
+            .filter_map(|rows| self.estimate(rows).map(|gpu| (rows, gpu)))
+            .filter(|&(_, gpu)| backlogged || 2.0 * gpu <= budget)
+            .collect();
+        let throughput = |&(rows, gpu): &(usize, f64)| rows as f64 / gpu.max(1e-9);
+        let best = candidates.iter().map(throughput).fold(0.0, f64::max);
+        let chosen = candidates.iter().rev().find(|candidate| throughput(candidate) >= THROUGHPUT_TOLERANCE * best);
+        let (cap, gpu) = match chosen {
+            Some(&(rows, gpu)) => (rows, gpu),
+            // nothing fits: the smallest batches, sent at once
+            None => (min, budget),
+        };
+        let delay = match backlogged {
+            true => 0.0,
+            false => (budget - 2.0 * gpu).clamp(0.0, options.max_delay.as_secs_f64()),
+        };
+        self.limits = BatchLimits { max_batch_size: cap, max_delay: Duration::from_secs_f64(delay) };
+        self.batches = 0;
+        self.queue_wait = 0.0;
+    }
+}
+
+// Tunes a DynamicBatcher's batch-size cap and wait online (see
+// DynamicBatcher::set_batch_controller), from the device time of each batch size, measured
+// with a pair of timing events around every batch, the queueing delay and the latency of
+// every request, to get the most rows through the GPU while the p99 latency holds its target.
+pub struct BatchController {
+    options: AdaptiveBatchingOptions,
+    state: Mutex<ControllerState>,
+    // the current limits, read by the batcher without the lock
+    max_batch_size: AtomicUsize,
+    max_delay_ns: AtomicU64,
+    events: Mutex<Vec<(CudaEvent, CudaEvent)>>,
+}
+
+impl BatchController {
+    pub fn new(options: AdaptiveBatchingOptions) -> Arc<Self> {
+        let state = ControllerState::new(&options);
+        let limits = state.limits;
+        Arc::new(Self {
+            options,
+            state: Mutex::new(state),
+            max_batch_size: AtomicUsize::new(limits.max_batch_size),
+            max_delay_ns: AtomicU64::new(limits.max_delay.as_nanos() as u64),
+            events: Mutex::new(Vec::new()),
+        })
+    }
+
+    pub fn limits(&self) -> BatchLimits {
+        BatchLimits {
+            max_batch_size: self.max_batch_size.load(Ordering::Relaxed),
+            max_delay: Duration::from_nanos(self.max_delay_ns.load(Ordering::Relaxed)),
+        }
+    }
+
+    // The p99 of the latest request latencies.
+    pub fn p99(&self) -> Option<Duration> {
+        self.state.lock().unwrap().p99().map(Duration::from_secs_f64)
+    }
+
+    pub fn options(&self) -> &AdaptiveBatchingOptions {
+        &self.options
+    }
+
+    // Feeds one executed batch of `rows`, its device time, how long its oldest request was
+    // queued, and the latencies of its requests; the limits follow every adjust_every batches.
+    pub fn observe(&self, rows: usize, gpu_time: Option<Duration>, oldest_wait: Duration, latencies: &[Duration]) {
+        let mut state = self.state.lock().unwrap();
+        state.observe(rows, gpu_time, oldest_wait, latencies, self.options.window);
+        if state.batches >= self.options.adjust_every.max(1) {
+            state.adjust(&self.options);
+            self.max_batch_size.store(state.limits.max_batch_size, Ordering::Relaxed);
+            self.max_delay_ns.store(state.limits.max_delay.as_nanos() as u64, Ordering::Relaxed);
+        }
+    }
+
+    pub(crate) fn checkout_events(&self) -> TRTResult<(CudaEvent, CudaEvent)> {
+        if let Some(events) = self.events.lock().unwrap().pop() {
+            return Ok(events);
+        }
+        match (CudaEvent::with_timing(), CudaEvent::with_timing()) {
+            (Some(start), Some(end)) => Ok((start, end)),
+            _ => Err(TRTError::EventError),
+        }
+    }
+
+    pub(crate) fn return_events(&self, events: (CudaEvent, CudaEvent)) {
+        self.events.lock().unwrap().push(events);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    // A GPU taking 1ms + 0.25ms per row, fed `batches` full batches at the current cap.
+    fn run(state: &mut ControllerState, options: &AdaptiveBatchingOptions, latency: Duration, batches: usize) {
+        for _ in 0..batches {
+            let rows = state.limits.max_batch_size;
+            let gpu = Duration::from_micros(1000 + 250 * rows as u64);
+            state.observe(rows, Some(gpu), Duration::ZERO, &[latency], options.window);
+            if state.batches >= options.adjust_every {
+                state.adjust(options);
+            }
+        }
+    }
+
+    #[test]
+    fn cap_grows_within_the_target() {
+        let options = AdaptiveBatchingOptions { p99_target: Duration::from_millis(20), ..Default::default() };
+        let mut state = ControllerState::new(&options);
+        run(&mut state, &options, Duration::from_millis(5), 200);
+        // 2 x (1ms + 0.25ms x 36) = 20ms, less what scaling up from smaller sizes overestimates
+        assert_eq!(state.limits.max_batch_size, 35);
+        // what is left of the target waits for the batch to fill
+        assert!(state.limits.max_delay <= Duration::from_micros(500));
+    }
+
+    #[test]
+    fn missed_target_shrinks_the_batches() {
+        let options = AdaptiveBatchingOptions::default();
+        let mut state = ControllerState::new(&options);
+        run(&mut state, &options, Duration::from_millis(5), 200);
+        let cap = state.limits.max_batch_size;
+        run(&mut state, &options, Duration::from_millis(50), 2 * options.window);
+        assert!(state.limits.max_batch_size < cap);
+    }
+
+    #[test]
+    fn estimates_scale_from_smaller_sizes() {
+        let mut state = ControllerState::new(&AdaptiveBatchingOptions::default());
+        assert_eq!(state.estimate(8), None);
+        state.observe(4, Some(Duration::from_millis(2)), Duration::ZERO, &[], 16);
+        assert_eq!(state.estimate(8), Some(0.004));
+        assert_eq!(state.estimate(2), None);
+    }
+}
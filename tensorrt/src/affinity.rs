@@ -0,0 +1,103 @@
+use crate::error::{TRTError, TRTResult};
+use tensorrt_rs_sys::numa;
+
+// The cores a thread launching work on a device may run on.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub enum CoreSet {
+    // wherever the scheduler puts it
+    #[default]
+    Any,
+    // any CPU attached to the device's PCI root, so it stays on the device's NUMA node
+    DeviceLocal,
+    // one isolcpus= core per thread, those attached to the device first
+    Isolated,
+    // one of these cores per thread, in order
+    Cores(Vec<u32>),
+}
+
+// Pinning of GPU submission threads, for the lowest-latency tier: a thread that migrates,
+// or runs on the far socket, adds its cache misses and wake-up latency to every launch.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct ThreadPinning {
+    pub cores: CoreSet,
+    // Spin while waiting for work instead of sleeping: no wake-up latency, but the thread
+    // keeps its core busy. Only for cores nothing else is scheduled on, e.g. Isolated.
+    pub busy_poll: bool,
+}
+
+impl ThreadPinning {
+    pub fn device_local() -> Self {
+        Self { cores: CoreSet::DeviceLocal, busy_poll: false }
+    }
+
+    pub fn isolated() -> Self {
+        Self { cores: CoreSet::Isolated, busy_poll: true }
+    }
+
+    // The CPUs of the `index`th submission thread of `device`; empty for CoreSet::Any.
+    pub fn cpus(&self, device: i32, index: usize) -> TRTResult<Vec<u32>> {
+        let cpus = match &self.cores {
+            CoreSet::Any => return Ok(Vec::new()),
+            CoreSet::DeviceLocal => device_cpus(device),
+            CoreSet::Isolated => {
+                let isolated = numa::get_isolated_cpus();
+                if isolated.is_empty() {
+                    return Err(TRTError::AffinityError("no isolated CPUs"));
+                }
+                pick(&prefer_local(isolated, &device_cpus(device)), index)
+            }
+            CoreSet::Cores(cores) => pick(cores, index),
+        };
+        match cpus.is_empty() {
+            true => Err(TRTError::AffinityError("no CPUs for the device")),
+            false => Ok(cpus),
+        }
+    }
+
+    // Pins the calling thread as the `index`th submission thread of `device`.
+    pub fn pin_current_thread(&self, device: i32, index: usize) -> TRTResult<()> {
+        let cpus = self.cpus(device, index)?;
+        match cpus.is_empty() || numa::bind_thread_to_cpus(&cpus) {
+            true => Ok(()),
+            false => Err(TRTError::AffinityError("sched_setaffinity failed")),
+        }
+    }
+}
+
+// The PCI root's CPUs, or the NUMA node's where sysfs lists none.
+fn device_cpus(device: i32) -> Vec<u32> {
+    let cpus = numa::get_device_cpus(device);
+    match (cpus.is_empty(), numa::get_device_node(device)) {
+        (true, Some(node)) => numa::get_node_cpus(node),
+        _ => cpus,
+    }
+}
+
+fn prefer_local(cpus: Vec<u32>, local: &[u32]) -> Vec<u32> {
+    let near: Vec<u32> = cpus.iter().copied().filter(|cpu| local.contains(cpu)).collect();
+    match near.is_empty() {
+        true => cpus,
+        false => near,
+    }
+}
+
+fn pick(cores: &[u32], index: usize) -> Vec<u32> {
+    match cores.is_empty() {
+        true => Vec::new(),
+        false => vec![cores[index % cores.len()]],
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn isolated_cores_near_the_device_go_first() {
+        let near = prefer_local(vec![2, 3, 18, 19], &[16, 17, 18, 19]);
+        assert_eq!(near, vec![18, 19]);
+        assert_eq!((pick(&near, 0), pick(&near, 1), pick(&near, 2)), (vec![18], vec![19], vec![18]));
+        assert_eq!(prefer_local(vec![2, 3], &[16, 17]), vec![2, 3]);
+        assert!(pick(&[], 0).is_empty());
+    }
+}
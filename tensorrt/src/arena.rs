@@ -0,0 +1,51 @@
+use crate::{
+    accounting::{MemoryCategory, MemoryReservation},
+    engine::TRTEngine,
+    error::TRTResult,
+};
+use cuda_rs::{memory::DeviceMemory, stream::CuStream};
+
+// One activation scratch block shared by every context that runs serially on the same
+// stream, e.g. an OCR detector followed by its recognizer.
+// Contexts are created without device memory and pointed at this block, so scratch is
+// sized by the largest engine instead of the sum of all of them.
+pub struct DeviceMemoryArena {
+    mem: DeviceMemory,
+    size: usize,
+    _reservation: MemoryReservation,
+}
+
+impl DeviceMemoryArena {
+    pub fn new(size: usize, stream: &CuStream) -> TRTResult<Self> {
+        let reservation = MemoryReservation::new(MemoryCategory::Context, size)?;
+        // cuMemAlloc rejects zero-sized allocations
+        let mem = DeviceMemory::new(size.max(1), stream)?;
+        Ok(Self { mem, size, _reservation: reservation })
+    }
+
+    pub fn for_engines(engines: &[&TRTEngine], stream: &CuStream) -> TRTResult<Self> {
+        let mut size = 0;
+        for engine in engines {
+            size = size.max(engine.get_device_memory_size()?);
+        }
+        Self::new(size, stream)
+    }
+
+    // Sized by the largest scratch of each engine's profile, for contexts activated with
+    // TRTEngine::activate_with_arena_for_profile.
+    pub fn for_profiles(engines: &[(&TRTEngine, i32)], stream: &CuStream) -> TRTResult<Self> {
+        let mut size = 0;
+        for (engine, profile) in engines {
+            size = size.max(engine.get_device_memory_size_for_profile(*profile)?);
+        }
+        Self::new(size, stream)
+    }
+
+    pub fn size(&self) -> usize {
+        self.size
+    }
+
+    pub unsafe fn get_raw_ptr(&self) -> usize {
+        self.mem.get_raw() as usize
+    }
+}
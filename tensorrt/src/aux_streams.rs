@@ -0,0 +1,49 @@
+use crate::error::{TRTError, TRTResult};
+use std::sync::Arc;
+use tensorrt_rs_sys::stream::CudaStream;
+
+// The auxiliary streams TensorRT forks an engine's parallel branches onto. Created by the
+// crate instead of by TensorRT per context, so they carry our stream priority and are joined
+// into graph captures of the main stream. Contexts that never run concurrently (e.g. the
+// stages of an EngineChain) may share one set.
+pub struct AuxStreams {
+    streams: Vec<CudaStream>,
+    priority: i32,
+}
+
+impl AuxStreams {
+    pub fn new(count: usize, priority: i32) -> TRTResult<Arc<Self>> {
+        let mut streams = Vec::with_capacity(count);
+        for _ in 0..count {
+            match CudaStream::new(priority) {
+                Some(stream) => streams.push(stream),
+                None => return Err(TRTError::StreamCreationError),
+            }
+        }
+        Ok(Arc::new(Self { streams, priority }))
+    }
+
+    pub fn len(&self) -> usize {
+        self.streams.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.streams.is_empty()
+    }
+
+    pub fn priority(&self) -> i32 {
+        self.priority
+    }
+
+    pub fn synchronize(&self) -> TRTResult<()> {
+        if self.streams.iter().all(|stream| stream.synchronize()) {
+            Ok(())
+        } else {
+            Err(TRTError::StreamCreationError)
+        }
+    }
+
+    pub(crate) fn raw(&self, count: usize) -> Vec<usize> {
+        self.streams.iter().take(count).map(|stream| stream.get_raw()).collect()
+    }
+}
@@ -0,0 +1,1176 @@
+use crate::{
+    adaptive::BatchController,
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    nvtx::{self, Category},
+    packing::SequencePacking,
+    priority::PriorityClass,
+    ring::{submission_ring, RingReceiver, RingSender},
+    schema::IoSchema,
+    spans::{OpenSpan, SpanTracer, SpanValue, Stage, TraceContext},
+    tensor::{Shape, Tensor},
+    trace::{TraceInput, TraceRecorder},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::VecDeque,
+    sync::{
+        atomic::{AtomicBool, AtomicU64, Ordering},
+        mpsc, Arc, Mutex,
+    },
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::{
+    kernels::{batched_copy, sequence_mask, DeviceCopy},
+    logger::Severity,
+    memory::{memcpy_2d_async, memcpy_async, memset_async, MemcpyKind},
+    runtime::{DataType, OptProfileSelector},
+};
+
+// One input of a request, in host memory or, with `device`, already on the device. The
+// leading dim is the number of rows the request contributes to the batch.
+#[derive(Debug, Clone)]
+pub struct BatchInput {
+    pub name: String,
+    pub shape: Shape,
+    pub data: Vec<u8>,
+    // Device address of the input in place of `data`, e.g. an upstream engine's output. Its
+    // contents must be complete when submitted and stay valid until the request's result
+    // arrives; the device inputs of a batch are copied into it in one launch. Set only by
+    // the unsafe BatchInput::device, which carries that contract.
+    device: Option<usize>,
+}
+
+impl BatchInput {
+    pub fn host(name: &str, shape: Shape, data: Vec<u8>) -> Self {
+        Self { name: name.to_string(), shape, data, device: None }
+    }
+
+    // Safety: `tensor` must hold the input, as `device` requires.
+    pub unsafe fn device(name: &str, tensor: &Tensor) -> Self {
+        Self { name: name.to_string(), shape: *tensor.shape(), data: Vec::new(), device: Some(tensor.get_raw_ptr()) }
+    }
+}
+
+#[derive(Debug, Clone)]
+pub struct BatchOutput {
+    pub name: String,
+    pub shape: Shape,
+    pub data: Vec<u8>,
+}
+
+pub type BatchResult = TRTResult<Vec<BatchOutput>>;
+
+// What the batcher does when a request arrives with `max_queued` requests of its class
+// already waiting. Requests are admitted as the batcher takes them off the submission ring,
+// so a rejected request fails through its BatchRequest rather than from submit.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum OverloadPolicy {
+    // the new request fails with Overloaded
+    RejectNew,
+    // the oldest waiting request fails with Overloaded, since it is the likeliest to be
+    // past what its caller waits for
+    ShedOldest,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct BatchConfig {
+    // Upper bound on rows per batch, further clamped to the engine's allocated capacity.
+    pub max_batch_size: usize,
+    // How long the oldest request may wait for the batch to fill.
+    pub max_delay: Duration,
+    // The same for requests submitted with submit_interactive.
+    pub interactive_max_delay: Duration,
+    // Waiting requests per class beyond which `overload` applies; 0 for no bound.
+    pub max_queued: usize,
+    pub overload: OverloadPolicy,
+    // Submissions not yet taken by the batcher; submit fails with Overloaded beyond it.
+    pub submit_capacity: usize,
+    // Spin while waiting for requests instead of sleeping; for batcher threads pinned to a
+    // core of their own (see ThreadPinning).
+    pub busy_poll: bool,
+}
+
+impl Default for BatchConfig {
+    fn default() -> Self {
+        Self {
+            max_batch_size: 8,
+            max_delay: Duration::from_millis(2),
+            interactive_max_delay: Duration::ZERO,
+            max_queued: 0,
+            overload: OverloadPolicy::RejectNew,
+            submit_capacity: 1024,
+            busy_poll: false,
+        }
+    }
+}
+
+// Requests that never reached the device.
+#[derive(Debug, Copy, Clone, Default, PartialEq, Eq)]
+pub struct BatcherStats {
+    // past their deadline before being batched
+    pub expired: u64,
+    // dropped by their caller
+    pub cancelled: u64,
+    // rejected or shed by the overload policy
+    pub shed: u64,
+}
+
+// Batching and padding only grow dims, so requests are checked against the profiles' max
+// dims; the min dims apply to the batch.
+fn check_request(schema: &IoSchema, inputs: &[BatchInput]) -> TRTResult<()> {
+    for input in inputs {
+        let tensor = match schema.get(&input.name) {
+            Some(tensor) if tensor.is_input() => tensor,
+            _ => return Err(TRTError::TensorNotFound(input.name.clone())),
+        };
+        if !tensor.accepts_up_to_max(&input.shape, None) {
+            return Err(TRTError::ShapeError(input.shape.to_vec()));
+        }
+        if input.device.is_none() && input.data.len() != input.shape.size() * tensor.dtype.get_elem_size() {
+            return Err(TRTError::ShapeMismatch);
+        }
+    }
+    Ok(())
+}
+
+// Without a schema the dtypes are unknown, but host data must still hold a whole element of
+// 1, 2, 4 or 8 bytes per value of its shape.
+fn check_host_data(inputs: &[BatchInput]) -> TRTResult<()> {
+    for input in inputs.iter().filter(|input| input.device.is_none()) {
+        let size = input.shape.size();
+        let whole = [1, 2, 4, 8].iter().any(|&elem_size| input.data.len() == size * elem_size);
+        if !whole {
+            return Err(TRTError::ShapeMismatch);
+        }
+    }
+    Ok(())
+}
+
+// The result of a submitted request. Dropping it (or calling cancel) before the result
+// arrives withdraws the request: the batcher discards it instead of batching it, so
+// callers that give up, e.g. on a timeout of their own, cost no GPU time.
+pub struct BatchRequest {
+    receiver: mpsc::Receiver<BatchResult>,
+    cancelled: Arc<AtomicBool>,
+}
+
+impl BatchRequest {
+    pub fn recv(&self) -> Result<BatchResult, mpsc::RecvError> {
+        self.receiver.recv()
+    }
+
+    pub fn recv_timeout(&self, timeout: Duration) -> Result<BatchResult, mpsc::RecvTimeoutError> {
+        self.receiver.recv_timeout(timeout)
+    }
+
+    pub fn try_recv(&self) -> Result<BatchResult, mpsc::TryRecvError> {
+        self.receiver.try_recv()
+    }
+
+    // Has no effect once the request has been batched.
+    pub fn cancel(&self) {
+        self.cancelled.store(true, Ordering::Relaxed);
+    }
+}
+
+impl Drop for BatchRequest {
+    fn drop(&mut self) {
+        self.cancel();
+    }
+}
+
+struct Pending {
+    inputs: Vec<BatchInput>,
+    rows: usize,
+    arrival: Instant,
+    deadline: Option<Instant>,
+    cancelled: Arc<AtomicBool>,
+    sender: mpsc::Sender<BatchResult>,
+    // the "trt.request" span of a traced request, from its submission to its result
+    span: Option<OpenSpan>,
+}
+
+impl Pending {
+    fn is_cancelled(&self) -> bool {
+        self.cancelled.load(Ordering::Relaxed)
+    }
+
+    fn is_expired(&self, now: Instant) -> bool {
+        self.deadline.map_or(false, |deadline| now >= deadline)
+    }
+
+    fn input(&self, name: &str) -> Option<&BatchInput> {
+        self.inputs.iter().find(|input| input.name == name)
+    }
+
+    // Requests can share a batch when every input agrees on everything but the leading dim,
+    // packed inputs on their bucket length rather than their own.
+    fn is_compatible(&self, other: &Pending, packing: Option<&SequencePacking>) -> bool {
+        self.inputs.len() == other.inputs.len()
+            && self.inputs.iter().all(|input| match (other.input(&input.name), packing) {
+                (Some(other), Some(packing)) => {
+                    packing.batch_shape(input).get(1..) == packing.batch_shape(other).get(1..)
+                }
+                (Some(other), None) => input.shape.get(1..) == other.shape.get(1..),
+                (None, _) => false,
+            })
+    }
+}
+
+#[derive(Default)]
+struct Queue {
+    pending: VecDeque<Pending>,
+    interactive: VecDeque<Pending>,
+    stats: BatcherStats,
+}
+
+impl Queue {
+    // Drops cancelled requests and fails expired ones, so neither is batched.
+    fn purge(&mut self, now: Instant) {
+        let stats = &mut self.stats;
+        for pending in [&mut self.pending, &mut self.interactive] {
+            pending.retain(|request| {
+                if request.is_cancelled() {
+                    stats.cancelled += 1;
+                    false
+                } else if request.is_expired(now) {
+                    stats.expired += 1;
+                    request.sender.send(Err(TRTError::DeadlineExceeded)).ok();
+                    false
+                } else {
+                    true
+                }
+            });
+        }
+    }
+
+    // Applies `policy` before a request of `class` is queued; false rejects it.
+    fn admit(&mut self, class: PriorityClass, max_queued: usize, policy: OverloadPolicy) -> bool {
+        if max_queued == 0 || self.get_mut(class).len() < max_queued {
+            return true;
+        }
+        self.purge(Instant::now());
+        if self.get_mut(class).len() < max_queued {
+            return true;
+        }
+        self.stats.shed += 1;
+        match policy {
+            OverloadPolicy::RejectNew => false,
+            OverloadPolicy::ShedOldest => {
+                if let Some(oldest) = self.get_mut(class).pop_front() {
+                    oldest.sender.send(Err(TRTError::Overloaded)).ok();
+                }
+                true
+            }
+        }
+    }
+
+    // Interactive requests are served first; batch requests fill the time in between.
+    fn next_class(&self) -> PriorityClass {
+        match self.interactive.is_empty() {
+            true => PriorityClass::Batch,
+            false => PriorityClass::Interactive,
+        }
+    }
+
+    fn get_mut(&mut self, class: PriorityClass) -> &mut VecDeque<Pending> {
+        match class {
+            PriorityClass::Interactive => &mut self.interactive,
+            PriorityClass::Batch => &mut self.pending,
+        }
+    }
+}
+
+// Pops the longest compatible run from the front of the queue that fits in `max_rows`.
+// With sequence packing, the requests compatible with the first one are gathered from the
+// whole queue instead, so requests are sorted into batches by bucket length. The first
+// request is always taken, so an oversized request fails on its own rather than blocking
+// the queue.
+fn take_batch(pending: &mut VecDeque<Pending>, max_rows: usize, packing: Option<&SequencePacking>) -> Vec<Pending> {
+    let mut batch: Vec<Pending> = Vec::new();
+    let mut rows = 0;
+    let mut index = 0;
+    while let Some(next) = pending.get(index) {
+        if let Some(first) = batch.first() {
+            if rows + next.rows > max_rows || !first.is_compatible(next, packing) {
+                if packing.is_none() {
+                    break;
+                }
+                index += 1;
+                continue;
+            }
+        }
+        rows += next.rows;
+        batch.push(pending.remove(index).unwrap());
+    }
+    batch
+}
+
+fn ready_rows(pending: &VecDeque<Pending>, packing: Option<&SequencePacking>) -> usize {
+    let first = match pending.front() {
+        Some(first) => first,
+        None => return 0,
+    };
+    let compatible = |next: &&Pending| first.is_compatible(next, packing);
+    match packing {
+        Some(_) => pending.iter().filter(compatible).map(|next| next.rows).sum(),
+        None => pending.iter().take_while(compatible).map(|next| next.rows).sum(),
+    }
+}
+
+// The batcher's side of the submission ring, behind a lock only batcher threads take.
+struct Intake {
+    receiver: RingReceiver<(PriorityClass, Pending)>,
+    arrivals: Vec<(PriorityClass, Pending)>,
+    queue: Queue,
+}
+
+impl Intake {
+    // Moves the submitted requests into the queue, applying the overload policy.
+    fn drain(&mut self, config: &BatchConfig) {
+        // at most one ring's worth, so a steady stream of submissions cannot hold it here
+        let capacity = self.receiver.capacity();
+        self.receiver.pop_batch(&mut self.arrivals, capacity);
+        for (class, pending) in self.arrivals.drain(..) {
+            if self.queue.admit(class, config.max_queued, config.overload) {
+                self.queue.get_mut(class).push_back(pending);
+            } else {
+                pending.sender.send(Err(TRTError::Overloaded)).ok();
+            }
+        }
+    }
+}
+
+// Cloneable handle used by request threads to enqueue work for a DynamicBatcher. Submitting
+// takes no lock: requests are handed to the batcher through a lock-free ring.
+#[derive(Clone)]
+pub struct BatchSubmitter {
+    sender: RingSender<(PriorityClass, Pending)>,
+    schema: Option<Arc<IoSchema>>,
+    spans: Option<Arc<SpanTracer>>,
+}
+
+impl BatchSubmitter {
+    pub fn submit(&self, inputs: Vec<BatchInput>) -> TRTResult<BatchRequest> {
+        self.submit_class(inputs, PriorityClass::Batch)
+    }
+
+    // Queues a latency-critical request. Interactive requests are batched only with each
+    // other, ahead of any queued batch work, and executed on a greatest-priority stream.
+    pub fn submit_interactive(&self, inputs: Vec<BatchInput>) -> TRTResult<BatchRequest> {
+        self.submit_class(inputs, PriorityClass::Interactive)
+    }
+
+    pub fn submit_class(&self, inputs: Vec<BatchInput>, class: PriorityClass) -> TRTResult<BatchRequest> {
+        self.submit_with_deadline(inputs, class, None)
+    }
+
+    // A request not batched by `deadline` fails with DeadlineExceeded without running.
+    // Batched requests run to completion.
+    pub fn submit_with_deadline(
+        &self,
+        inputs: Vec<BatchInput>,
+        class: PriorityClass,
+        deadline: Option<Instant>,
+    ) -> TRTResult<BatchRequest> {
+        self.submit_with_context(inputs, class, deadline, None)
+    }
+
+    // Traces the request within `parent`, e.g. from the caller's traceparent header, when the
+    // batcher traces spans and that trace is sampled. Without a parent, the tracer samples
+    // the request into a trace of its own.
+    pub fn submit_with_context(
+        &self,
+        inputs: Vec<BatchInput>,
+        class: PriorityClass,
+        deadline: Option<Instant>,
+        parent: Option<&TraceContext>,
+    ) -> TRTResult<BatchRequest> {
+        let rows = match inputs.first().and_then(|input| input.shape.first()) {
+            Some(&rows) if rows > 0 => rows as usize,
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        if inputs.iter().any(|input| input.shape.first() != Some(&(rows as i32))) {
+            return Err(TRTError::ShapeMismatch);
+        }
+        match self.schema.as_ref() {
+            Some(schema) => check_request(schema, &inputs)?,
+            None => check_host_data(&inputs)?,
+        }
+        if self.sender.is_closed() {
+            return Err(TRTError::QueueClosed);
+        }
+
+        let (sender, receiver) = mpsc::channel();
+        let cancelled = Arc::new(AtomicBool::new(false));
+        let arrival = Instant::now();
+        let mut span = self.spans.as_ref().and_then(|spans| spans.start(parent));
+        if let Some(span) = span.as_mut() {
+            span.set("trt.rows", SpanValue::Int(rows as i64));
+            for input in &inputs {
+                span.set(format!("trt.input.{}", input.name), SpanValue::Shape(input.shape));
+            }
+        }
+        let pending = Pending { inputs, rows, arrival, deadline, cancelled: cancelled.clone(), sender, span };
+        if self.sender.push((class, pending)).is_err() {
+            return Err(TRTError::Overloaded);
+        }
+        Ok(BatchRequest { receiver, cancelled })
+    }
+
+    // Stops accepting requests; the batcher drains what is already queued and returns.
+    pub fn close(&self) {
+        self.sender.close();
+    }
+}
+
+// Coalesces queued requests into one enqueue per batch. Request rows are copied straight
+// into the engine-owned input buffers bound by allocate_io_tensors, and output rows are
+// scattered back to each request.
+pub struct DynamicBatcher {
+    sender: RingSender<(PriorityClass, Pending)>,
+    intake: Mutex<Intake>,
+    // a copy of the intake's, which is locked while the batcher waits for requests
+    stats: Mutex<BatcherStats>,
+    config: BatchConfig,
+    packing: Option<SequencePacking>,
+    trace: Option<Arc<TraceRecorder>>,
+    schema: Option<Arc<IoSchema>>,
+    spans: Option<Arc<SpanTracer>>,
+    batches: AtomicU64,
+    controller: Option<Arc<BatchController>>,
+}
+
+impl DynamicBatcher {
+    pub fn new(config: BatchConfig) -> Self {
+        let (sender, receiver) = submission_ring(config.submit_capacity);
+        let intake = Intake { receiver, arrivals: Vec::new(), queue: Queue::default() };
+        Self {
+            sender,
+            intake: Mutex::new(intake),
+            stats: Mutex::default(),
+            config,
+            packing: None,
+            trace: None,
+            schema: None,
+            spans: None,
+            batches: AtomicU64::new(0),
+            controller: None,
+        }
+    }
+
+    // Batches requests of different sequence lengths together; see SequencePacking.
+    pub fn with_packing(config: BatchConfig, packing: SequencePacking) -> Self {
+        Self { packing: Some(packing), ..Self::new(config) }
+    }
+
+    pub fn packing(&self) -> Option<&SequencePacking> {
+        self.packing.as_ref()
+    }
+
+    pub fn submitter(&self) -> BatchSubmitter {
+        BatchSubmitter { sender: self.sender.clone(), schema: self.schema.clone(), spans: self.spans.clone() }
+    }
+
+    // Has submitters created from now on reject requests the engine could never take, e.g.
+    // `engine.io_schema()`: inputs it does not have, dims beyond every profile's max, data of
+    // the wrong size. Checked on the submitting thread, so such requests never take a place
+    // in a batch or fail the requests batched with them.
+    pub fn set_io_schema(&mut self, schema: Option<IoSchema>) {
+        self.schema = schema.map(Arc::new);
+    }
+
+    pub fn stats(&self) -> BatcherStats {
+        *self.stats.lock().unwrap()
+    }
+
+    pub fn config(&self) -> &BatchConfig {
+        &self.config
+    }
+
+    // Records every executed batch and its requests, with their arrival, completion and
+    // input shapes, to `trace`; None stops recording.
+    pub fn set_trace_recorder(&mut self, trace: Option<Arc<TraceRecorder>>) {
+        self.trace = trace;
+    }
+
+    // Traces the requests of submitters created from now on that `spans` samples: a
+    // "trt.request" span from submission to result with a "trt.queue_wait" child until it
+    // was batched, and for every batch holding one, a "trt.batch" span in a trace of its own,
+    // linked to its requests, with "trt.batch_assembly" (host), "trt.upload", "trt.gpu" and
+    // "trt.download" (device) children. Their attributes carry the batch id and shapes.
+    pub fn set_span_tracer(&mut self, spans: Option<Arc<SpanTracer>>) {
+        self.spans = spans;
+    }
+
+    // Has `controller` set the batch-size cap and the wait of batch requests in place of the
+    // config's max_batch_size and max_delay, feeding it every batch; None restores them.
+    pub fn set_batch_controller(&mut self, controller: Option<Arc<BatchController>>) {
+        self.controller = controller;
+    }
+
+    pub fn batch_controller(&self) -> Option<&Arc<BatchController>> {
+        self.controller.as_ref()
+    }
+
+    // The batch-size cap and batch wait in effect.
+    fn limits(&self) -> (usize, Duration) {
+        match self.controller.as_ref() {
+            Some(controller) => {
+                let limits = controller.limits();
+                (limits.max_batch_size, limits.max_delay)
+            }
+            None => (self.config.max_batch_size, self.config.max_delay),
+        }
+    }
+
+    // Serves batches until the queue is closed and drained. A failed batch fails its own
+    // requests with the cause (BatchFailed) and serving goes on, the engine recovering its
+    // context if auto-recovery is on. A sticky CUDA error, after which nothing can run in
+    // this process, closes the queue, fails every queued request and is returned.
+    pub fn run(&self, engine: &mut TRTEngine, stream: &CuStream) -> TRTResult<()> {
+        loop {
+            match self.process_batch(engine, stream) {
+                Ok(true) => {}
+                Ok(false) => return Ok(()),
+                Err(err) if matches!(err.root(), TRTError::StickyCudaError(..)) => {
+                    let cause = match err {
+                        TRTError::BatchFailed(cause) => cause,
+                        err => Arc::new(err),
+                    };
+                    self.fail_queued(&cause);
+                    return Err(TRTError::BatchFailed(cause));
+                }
+                Err(err) => engine.log(Severity::Error, &format!("Batch failed: {}", err)),
+            }
+        }
+    }
+
+    // Closes the queue and fails everything in it with `cause`.
+    fn fail_queued(&self, cause: &Arc<TRTError>) {
+        self.sender.close();
+        let mut intake = self.intake.lock().unwrap();
+        let intake = &mut *intake;
+        intake.drain(&self.config);
+        let queue = &mut intake.queue;
+        for pending in queue.pending.drain(..).chain(queue.interactive.drain(..)) {
+            pending.sender.send(Err(TRTError::BatchFailed(cause.clone()))).ok();
+        }
+    }
+
+    // Waits for and executes a single batch. Returns false once the queue is closed and empty.
+    pub fn process_batch(&self, engine: &mut TRTEngine, stream: &CuStream) -> TRTResult<bool> {
+        let (batch, class, depth) = match self.wait_for_batch(engine) {
+            Some(batch) => batch,
+            None => return Ok(false),
+        };
+        let batch_id = self.batches.fetch_add(1, Ordering::Relaxed);
+        let mut batch_span = self.begin_batch_span(&batch, batch_id);
+        if let Some(metrics) = engine.metrics() {
+            let now = Instant::now();
+            metrics.queue_depth.set(depth as i64);
+            metrics.batch_size.observe(batch.iter().map(|pending| pending.rows as u64).sum());
+            for pending in &batch {
+                metrics.queue_wait.observe_duration(now - pending.arrival);
+            }
+        }
+
+        // batch work runs at the engine's own stream priority
+        let start = Instant::now();
+        let priority = engine.get_stream_priority();
+        // engine spans, when it traces too, nest under the batch
+        let span_parent = engine.span_parent();
+        if let Some(span) = batch_span.as_ref() {
+            engine.set_span_parent(Some(span.context));
+        }
+        let traced = self.spans.as_deref().zip(batch_span.as_ref().map(|span| &span.context));
+        // untimed when no events are left, rather than failing the batch
+        let timing = self.controller.as_ref().and_then(|controller| controller.checkout_events().ok());
+        if let Some((begin, _)) = timing.as_ref() {
+            begin.record(stream);
+        }
+        let res = match class {
+            PriorityClass::Interactive => engine
+                .set_priority_class(class)
+                .and_then(|_| self.execute_batch(engine, &batch, traced, stream)),
+            PriorityClass::Batch => self.execute_batch(engine, &batch, traced, stream),
+        };
+        engine.set_span_parent(span_parent);
+        // the batch's requests get a result whatever happens here
+        let restored = engine.set_stream_priority(priority);
+        let res = res.and_then(|outputs| restored.map(|_| outputs));
+
+        if let (Some(spans), Some(mut span)) = (self.spans.as_ref(), batch_span.take()) {
+            span.failed = res.is_err();
+            spans.finish(span, "trt.batch", Instant::now());
+        }
+        if let (Some(controller), Some((begin, end))) = (self.controller.as_ref(), timing) {
+            if res.is_ok() {
+                // the batch's copies back were synchronized, so the event completes at once
+                let timed = end.record(stream) && end.synchronize();
+                let gpu_time = end.elapsed_ms_since(&begin).filter(|_| timed);
+                let gpu_time = gpu_time.map(|ms| Duration::from_secs_f32(ms.max(0.0) / 1e3));
+                self.observe_batch(controller, engine, &batch, start, gpu_time);
+            }
+            controller.return_events((begin, end));
+        }
+        match res {
+            Ok(outputs) => {
+                if let Some(trace) = self.trace.as_ref() {
+                    Self::record_batch(trace, engine, &batch, start);
+                }
+                for (mut pending, outputs) in batch.into_iter().zip(outputs) {
+                    pending.sender.send(Ok(outputs)).ok();
+                    self.finish_request_span(&mut pending, batch_id, false);
+                }
+                Ok(true)
+            }
+            Err(err) => {
+                let cause = Arc::new(err);
+                for mut pending in batch {
+                    pending.sender.send(Err(TRTError::BatchFailed(cause.clone()))).ok();
+                    self.finish_request_span(&mut pending, batch_id, true);
+                }
+                Err(TRTError::BatchFailed(cause))
+            }
+        }
+    }
+
+    // Ends the queue wait of the batch's traced requests, and opens the batch's span when
+    // there is one.
+    fn begin_batch_span(&self, batch: &[Pending], batch_id: u64) -> Option<OpenSpan> {
+        let spans = self.spans.as_ref()?;
+        let now = Instant::now();
+        let mut links = Vec::new();
+        for pending in batch {
+            if let Some(request) = pending.span.as_ref() {
+                let mut wait = spans.child(&request.context, pending.arrival);
+                wait.set("trt.batch.id", SpanValue::Int(batch_id as i64));
+                spans.finish(wait, "trt.queue_wait", now);
+                links.push(request.context);
+            }
+        }
+        if links.is_empty() {
+            return None;
+        }
+        let mut span = spans.root(now);
+        span.set("trt.batch.id", SpanValue::Int(batch_id as i64));
+        span.set("trt.batch.rows", SpanValue::Int(batch.iter().map(|pending| pending.rows as i64).sum()));
+        span.set("trt.batch.requests", SpanValue::Int(batch.len() as i64));
+        span.links = links;
+        Some(span)
+    }
+
+    // `start` is when the batch was taken off the queue.
+    fn observe_batch(
+        &self,
+        controller: &BatchController,
+        engine: &TRTEngine,
+        batch: &[Pending],
+        start: Instant,
+        gpu_time: Option<Duration>,
+    ) {
+        let now = Instant::now();
+        let rows = batch.iter().map(|pending| pending.rows).sum();
+        let latencies: Vec<Duration> = batch.iter().map(|pending| now - pending.arrival).collect();
+        let oldest_wait = batch.iter().map(|pending| start.saturating_duration_since(pending.arrival)).max();
+        controller.observe(rows, gpu_time, oldest_wait.unwrap_or_default(), &latencies);
+        if let Some(metrics) = engine.metrics() {
+            let limits = controller.limits();
+            metrics.batch_size_limit.set(limits.max_batch_size as i64);
+            metrics.batch_delay_limit.set(limits.max_delay.as_micros() as i64);
+        }
+    }
+
+    fn finish_request_span(&self, pending: &mut Pending, batch_id: u64, failed: bool) {
+        if let (Some(spans), Some(mut span)) = (self.spans.as_ref(), pending.span.take()) {
+            span.set("trt.batch.id", SpanValue::Int(batch_id as i64));
+            span.failed = failed;
+            spans.finish(span, "trt.request", Instant::now());
+        }
+    }
+
+    fn record_batch(trace: &TraceRecorder, engine: &TRTEngine, batch: &[Pending], start: Instant) {
+        let now = Instant::now();
+        let max_bytes = trace.options().max_sample_bytes;
+        let requests = batch
+            .iter()
+            .map(|pending| {
+                let inputs = |sampled: bool| {
+                    pending
+                        .inputs
+                        .iter()
+                        .map(|input| TraceInput {
+                            name: input.name.clone(),
+                            dtype: engine.get_tensor(&input.name).map_or(DataType::FLOAT, |tensor| tensor.dtype()),
+                            shape: input.shape,
+                            data: match sampled {
+                                true => input.data[..input.data.len().min(max_bytes)].to_vec(),
+                                false => Vec::new(),
+                            },
+                        })
+                        .collect()
+                };
+                trace.record_request(pending.arrival, now - pending.arrival, inputs)
+            })
+            .collect();
+        let rows = batch.iter().map(|pending| pending.rows as u32).sum();
+        trace.record_batch(start, now - start, rows, requests);
+    }
+
+    fn max_rows(&self, engine: &TRTEngine, first: &Pending) -> usize {
+        let mut max_rows = self.limits().0.max(1);
+        for input in &first.inputs {
+            let shape = match self.packing.as_ref() {
+                Some(packing) => packing.batch_shape(input),
+                None => input.shape,
+            };
+            let row_elems: usize = shape.iter().skip(1).map(|&d| d as usize).product();
+            if let Some(tensor) = engine.get_tensor(&input.name) {
+                if row_elems > 0 {
+                    max_rows = max_rows.min(tensor.capacity() / row_elems);
+                }
+            }
+        }
+        max_rows.max(1)
+    }
+
+    // The batch, its class and the number of requests left queued.
+    fn wait_for_batch(&self, engine: &TRTEngine) -> Option<(Vec<Pending>, PriorityClass, usize)> {
+        let _range = nvtx::range!(Category::Wait, "wait for batch");
+        let mut intake = self.intake.lock().unwrap();
+        let intake = &mut *intake;
+        loop {
+            // read first, so everything submitted before the close is drained below
+            let closed = intake.receiver.is_closed();
+            intake.drain(&self.config);
+            let queue = &mut intake.queue;
+            // expired and cancelled requests are dropped before they can fill a batch
+            queue.purge(Instant::now());
+            *self.stats.lock().unwrap() = queue.stats;
+            if queue.pending.is_empty() && queue.interactive.is_empty() {
+                if closed {
+                    return None;
+                }
+                self.wait_for_requests(&mut intake.receiver, None);
+                continue;
+            }
+
+            // re-evaluated on every wakeup, so an interactive arrival preempts a filling batch
+            let class = queue.next_class();
+            let max_delay = match class {
+                PriorityClass::Interactive => self.config.interactive_max_delay,
+                PriorityClass::Batch => self.limits().1,
+            };
+            let pending = queue.get_mut(class);
+            let front = pending.front().unwrap();
+            let max_rows = self.max_rows(engine, front);
+            let flush = front.arrival + max_delay;
+            // wake up for the earliest request deadline too, to fail it on time
+            let wake = pending.iter().filter_map(|request| request.deadline).fold(flush, Instant::min);
+            let now = Instant::now();
+            if closed || now >= flush || ready_rows(pending, self.packing.as_ref()) >= max_rows {
+                let batch = take_batch(pending, max_rows, self.packing.as_ref());
+                return Some((batch, class, queue.pending.len() + queue.interactive.len()));
+            }
+            self.wait_for_requests(&mut intake.receiver, Some(wake.saturating_duration_since(now)));
+        }
+    }
+
+    fn wait_for_requests(&self, receiver: &mut RingReceiver<(PriorityClass, Pending)>, timeout: Option<Duration>) {
+        match self.config.busy_poll {
+            true => receiver.spin(timeout),
+            false => receiver.wait(timeout),
+        }
+    }
+
+    // `traced` is the tracer and span of a traced batch.
+    fn execute_batch(
+        &self,
+        engine: &mut TRTEngine,
+        batch: &[Pending],
+        traced: Option<(&SpanTracer, &TraceContext)>,
+        stream: &CuStream,
+    ) -> TRTResult<Vec<Vec<BatchOutput>>> {
+        const STAGES: &[Stage] = &[("trt.upload", 0, 1), ("trt.gpu", 1, 2), ("trt.download", 2, 3)];
+        let _range = nvtx::range!(Category::Batch, "execute batch");
+        let mut assembly = traced.map(|(spans, batch_span)| spans.child(batch_span, Instant::now()));
+        let mut timeline = traced.and_then(|(spans, _)| spans.timeline(4));
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(0, stream);
+        }
+        let first = &batch[0];
+        let rows: usize = batch.iter().map(|pending| pending.rows).sum();
+        let packing = self.packing.as_ref();
+        // padded length of a packed batch, and each request's own length
+        let (length, lengths) = match packing {
+            Some(packing) => Self::packed_lengths(engine, packing, batch)?,
+            None => (0, Vec::new()),
+        };
+
+        // device-resident inputs, copied in one launch once every input is laid out
+        let mut device_copies = Vec::new();
+        for input in &first.inputs {
+            let packed = packing.map_or(false, |packing| packing.is_packed(&input.name));
+            let mut dims = input.shape.to_vec();
+            dims[0] = rows as i32;
+            if packed {
+                dims[1] = length as i32;
+            }
+            let shape = Shape::new(&dims);
+            engine.reserve_tensor(&input.name, shape.size())?;
+
+            let tensor = match engine.get_tensor(&input.name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(input.name.clone())),
+            };
+            let elem_size = tensor.dtype().get_elem_size();
+            let dst = unsafe { tensor.get_raw_ptr() };
+            // zero padding behind every request's tokens
+            if packed && !unsafe { memset_async(dst, 0, shape.size() * elem_size, stream) } {
+                return Err(TRTError::MemcpyError);
+            }
+
+            let mut offset = 0;
+            for (index, pending) in batch.iter().enumerate() {
+                let src = pending.input(&input.name).unwrap();
+                let size = src.shape.size() * elem_size;
+                if src.device.is_none() && src.data.len() != size {
+                    return Err(TRTError::ShapeMismatch);
+                }
+                let copied = if let Some(device) = src.device {
+                    if packed {
+                        let token_size = size / (pending.rows * lengths[index]).max(1);
+                        let (width, pitch) = (lengths[index] * token_size, length * token_size);
+                        device_copies.extend((0..pending.rows).map(|row| DeviceCopy {
+                            src: device + row * width,
+                            dst: dst + offset + row * pitch,
+                            size: width,
+                        }));
+                        offset += pitch * pending.rows;
+                    } else {
+                        device_copies.push(DeviceCopy { src: device, dst: dst + offset, size });
+                        offset += size;
+                    }
+                    true
+                } else if packed {
+                    // [rows, own length, ...] into [rows, padded length, ...]
+                    let token_size = size / (pending.rows * lengths[index]).max(1);
+                    let width = lengths[index] * token_size;
+                    let pitch = length * token_size;
+                    let copied = unsafe {
+                        memcpy_2d_async(
+                            dst + offset,
+                            pitch,
+                            src.data.as_ptr() as usize,
+                            width,
+                            width,
+                            pending.rows,
+                            MemcpyKind::HostToDevice,
+                            stream,
+                        )
+                    };
+                    offset += pitch * pending.rows;
+                    copied
+                } else {
+                    let copied = unsafe {
+                        memcpy_async(
+                            dst + offset,
+                            src.data.as_ptr() as usize,
+                            size,
+                            MemcpyKind::HostToDevice,
+                            stream,
+                        )
+                    };
+                    offset += size;
+                    copied
+                };
+                if !copied {
+                    return Err(TRTError::MemcpyError);
+                }
+            }
+            if let Some(metrics) = engine.metrics() {
+                metrics.copy_bytes.add(offset as u64);
+            }
+
+            engine.set_input_shape(&input.name, &shape)?;
+            if let Some(span) = assembly.as_mut() {
+                span.set(format!("trt.input.{}", input.name), SpanValue::Shape(shape));
+            }
+        }
+
+        if !device_copies.is_empty() && !unsafe { batched_copy(&device_copies, stream) } {
+            return Err(TRTError::KernelLaunchError);
+        }
+        if let Some(mask) = packing.and_then(|packing| packing.attention_mask.as_ref()) {
+            Self::write_attention_mask(engine, mask, batch, length, &lengths, stream)?;
+        }
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(1, stream);
+        }
+        if let (Some((spans, _)), Some(span)) = (traced, assembly) {
+            spans.finish(span, "trt.batch_assembly", Instant::now());
+        }
+
+        engine.execute(Some(stream))?;
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(2, stream);
+        }
+
+        // outputs with a reduction attached are scattered as its result, e.g. L2-normalized
+        // embeddings, reduced over the whole batch in one launch
+        let mut sources: Vec<(String, Shape, usize, usize)> = Vec::new();
+        for name in engine.output_names().to_vec() {
+            if let Some(reduced) = engine.reduced_outputs(&name, stream)? {
+                for (name, tensor) in reduced {
+                    let src = unsafe { tensor.get_raw_ptr() };
+                    sources.push((name, *tensor.shape(), tensor.dtype().get_elem_size(), src));
+                }
+                continue;
+            }
+            let shape = engine.get_tensor_shape(&name)?;
+            let tensor = match engine.get_tensor(&name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name)),
+            };
+            sources.push((name, shape, tensor.dtype().get_elem_size(), unsafe { tensor.get_raw_ptr() }));
+        }
+
+        let mut outputs: Vec<Vec<BatchOutput>> = batch.iter().map(|_| Vec::new()).collect();
+        for (name, shape, elem_size, src) in sources {
+            if shape.first() != Some(&(rows as i32)) {
+                return Err(TRTError::ShapeError(shape.to_vec()));
+            }
+            let row_size = shape.size() / rows * elem_size;
+            let sequence = packing.map_or(false, |packing| packing.is_sequence_output(&name));
+            if sequence && shape.get(1) != Some(&(length as i32)) {
+                return Err(TRTError::ShapeError(shape.to_vec()));
+            }
+
+            let mut offset = 0;
+            for (index, (pending, outputs)) in batch.iter().zip(outputs.iter_mut()).enumerate() {
+                let mut dims = shape.to_vec();
+                dims[0] = pending.rows as i32;
+                let copied = if sequence {
+                    // [rows, padded length, ...] back to [rows, own length, ...]
+                    dims[1] = lengths[index] as i32;
+                    let token_size = row_size / length;
+                    let width = lengths[index] * token_size;
+                    let mut data = vec![0u8; pending.rows * width];
+                    let copied = unsafe {
+                        memcpy_2d_async(
+                            data.as_mut_ptr() as usize,
+                            width,
+                            src + offset,
+                            row_size,
+                            width,
+                            pending.rows,
+                            MemcpyKind::DeviceToHost,
+                            stream,
+                        )
+                    };
+                    outputs.push(BatchOutput { name: name.clone(), shape: Shape::new(&dims), data });
+                    copied
+                } else {
+                    let mut data = vec![0u8; pending.rows * row_size];
+                    let copied = unsafe {
+                        memcpy_async(
+                            data.as_mut_ptr() as usize,
+                            src + offset,
+                            data.len(),
+                            MemcpyKind::DeviceToHost,
+                            stream,
+                        )
+                    };
+                    outputs.push(BatchOutput { name: name.clone(), shape: Shape::new(&dims), data });
+                    copied
+                };
+                if !copied {
+                    return Err(TRTError::MemcpyError);
+                }
+                offset += pending.rows * row_size;
+            }
+        }
+
+        if let (Some((spans, batch_span)), Some(mut timeline)) = (traced, timeline) {
+            timeline.record(3, stream);
+            spans.finish_timeline(timeline, batch_span, STAGES);
+        }
+
+        // the host buffers above are only valid to read once the copies have landed
+        let _sync = nvtx::range!(Category::Wait, "synchronize batch");
+        engine.synchronize_checked(Some(stream))?;
+        Ok(outputs)
+    }
+
+    // The padded length of the batch, within the max length of the engine's current profile
+    // where possible, and the length of every request.
+    fn packed_lengths(
+        engine: &TRTEngine,
+        packing: &SequencePacking,
+        batch: &[Pending],
+    ) -> TRTResult<(usize, Vec<usize>)> {
+        let mut lengths = Vec::with_capacity(batch.len());
+        for pending in batch {
+            let length = match packing.length(&pending.inputs) {
+                Some(length) if length > 0 => length,
+                _ => return Err(TRTError::ShapeMismatch),
+            };
+            let consistent = pending
+                .inputs
+                .iter()
+                .filter(|input| packing.is_packed(&input.name))
+                .all(|input| input.shape.get(1) == Some(&length));
+            if !consistent {
+                return Err(TRTError::ShapeMismatch);
+            }
+            lengths.push(length as usize);
+        }
+
+        let longest = *lengths.iter().max().unwrap();
+        let mut length = packing.bucket_length(longest as i32) as usize;
+        let first = batch[0].inputs.iter().find(|input| packing.is_packed(&input.name)).unwrap();
+        let max = engine
+            .get_optimization_profile()
+            .and_then(|profile| engine.get_profile_shape(&first.name, profile, OptProfileSelector::MAX));
+        if let Ok(max) = max {
+            if let Some(&max) = max.get(1) {
+                if max > 0 && longest <= max as usize {
+                    length = length.min(max as usize);
+                }
+            }
+        }
+        Ok((length, lengths))
+    }
+
+    fn write_attention_mask(
+        engine: &mut TRTEngine,
+        name: &str,
+        batch: &[Pending],
+        length: usize,
+        lengths: &[usize],
+        stream: &CuStream,
+    ) -> TRTResult<()> {
+        let rows: usize = batch.iter().map(|pending| pending.rows).sum();
+        let shape = Shape::new(&[rows as i32, length as i32]);
+        engine.reserve_tensor(name, shape.size())?;
+        let tensor = match engine.get_tensor(name) {
+            Some(tensor) => tensor,
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
+        };
+        let dtype = tensor.dtype();
+        let row_size = length * dtype.get_elem_size();
+        let mut dst = unsafe { tensor.get_raw_ptr() };
+        for (pending, &own) in batch.iter().zip(lengths) {
+            if !unsafe { sequence_mask(dst, dtype, pending.rows, length, own, stream) } {
+                return Err(TRTError::KernelLaunchError);
+            }
+            dst += pending.rows * row_size;
+        }
+        engine.set_input_shape(name, &shape)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::bucket::BucketPolicy;
+
+    fn pending(dims: &[i32]) -> Pending {
+        let (sender, _) = mpsc::channel();
+        Pending {
+            inputs: vec![BatchInput::host("x", Shape::new(dims), Vec::new())],
+            rows: dims[0] as usize,
+            arrival: Instant::now(),
+            deadline: None,
+            cancelled: Arc::new(AtomicBool::new(false)),
+            sender,
+            span: None,
+        }
+    }
+
+    #[test]
+    fn host_data_must_match_the_shape() {
+        let input = |len: usize| BatchInput::host("x", Shape::new(&[2, 3]), vec![0; len]);
+        assert!(check_host_data(&[input(24)]).is_ok());
+        assert!(check_host_data(&[input(6)]).is_ok());
+        assert!(matches!(check_host_data(&[input(7)]), Err(TRTError::ShapeMismatch)));
+        assert!(matches!(check_host_data(&[input(0)]), Err(TRTError::ShapeMismatch)));
+    }
+
+    #[test]
+    fn take_batch_respects_max_rows() {
+        let mut queue: VecDeque<Pending> =
+            vec![pending(&[2, 3]), pending(&[1, 3]), pending(&[2, 3])].into();
+        let batch = take_batch(&mut queue, 3, None);
+        assert_eq!(batch.len(), 2);
+        assert_eq!(queue.len(), 1);
+    }
+
+    #[test]
+    fn take_batch_stops_at_incompatible_shape() {
+        let mut queue: VecDeque<Pending> =
+            vec![pending(&[1, 3]), pending(&[1, 4]), pending(&[1, 3])].into();
+        assert_eq!(ready_rows(&queue, None), 1);
+        let batch = take_batch(&mut queue, 8, None);
+        assert_eq!(batch.len(), 1);
+        assert_eq!(queue.len(), 2);
+    }
+
+    #[test]
+    fn interactive_queue_is_served_first() {
+        let mut queue = Queue::default();
+        queue.pending.push_back(pending(&[1, 3]));
+        assert_eq!(queue.next_class(), PriorityClass::Batch);
+        queue.interactive.push_back(pending(&[1, 3]));
+        assert_eq!(queue.next_class(), PriorityClass::Interactive);
+    }
+
+    #[test]
+    fn packed_requests_are_grouped_by_bucket() {
+        let packing = SequencePacking::new(&["x"], None, BucketPolicy::round_up(&[1], 64));
+        let mut queue: VecDeque<Pending> =
+            vec![pending(&[1, 40]), pending(&[2, 100]), pending(&[1, 50]), pending(&[1, 64])].into();
+        assert_eq!(ready_rows(&queue, Some(&packing)), 3);
+        let batch = take_batch(&mut queue, 8, Some(&packing));
+        assert_eq!(batch.len(), 3);
+        assert_eq!(queue.len(), 1);
+        assert_eq!(queue[0].rows, 2);
+    }
+
+    #[test]
+    fn take_batch_always_takes_first() {
+        let mut queue: VecDeque<Pending> = vec![pending(&[4, 3])].into();
+        let batch = take_batch(&mut queue, 2, None);
+        assert_eq!(batch.len(), 1);
+        assert!(queue.is_empty());
+    }
+
+    #[test]
+    fn expired_and_cancelled_requests_are_purged() {
+        let mut queue = Queue::default();
+        let now = Instant::now();
+        let mut expired = pending(&[1, 3]);
+        expired.deadline = Some(now);
+        let cancelled = pending(&[1, 3]);
+        cancelled.cancelled.store(true, Ordering::Relaxed);
+        queue.pending.extend([expired, cancelled, pending(&[1, 3])]);
+        queue.purge(now);
+        assert_eq!(queue.pending.len(), 1);
+        assert_eq!(queue.stats, BatcherStats { expired: 1, cancelled: 1, shed: 0 });
+    }
+
+    #[test]
+    fn overload_rejects_or_sheds() {
+        let mut queue = Queue::default();
+        queue.pending.extend([pending(&[1, 3]), pending(&[2, 3])]);
+        assert!(queue.admit(PriorityClass::Batch, 0, OverloadPolicy::RejectNew));
+        assert!(!queue.admit(PriorityClass::Batch, 2, OverloadPolicy::RejectNew));
+        assert!(queue.admit(PriorityClass::Interactive, 2, OverloadPolicy::RejectNew));
+        assert!(queue.admit(PriorityClass::Batch, 2, OverloadPolicy::ShedOldest));
+        assert_eq!(queue.pending.len(), 1);
+        assert_eq!(queue.pending[0].rows, 2);
+        assert_eq!(queue.stats.shed, 2);
+    }
+}
@@ -0,0 +1,1538 @@
+use crate::{
+    accounting::{device_memory_usage, MemoryUsage},
+    arena::DeviceMemoryArena,
+    bucket::BucketPolicy,
+    completion::WaitStrategy,
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    plan::PlanLoadOptions,
+    pool::{EnginePool, EnginePoolOptions},
+    staging::pinned,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use std::{
+    collections::HashMap,
+    fmt::Write,
+    fs::{self, File},
+    io::BufReader,
+    path::Path,
+    sync::{
+        atomic::{AtomicBool, Ordering},
+        Arc, Barrier,
+    },
+    thread,
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::{
+    device,
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    runtime::{get_infer_lib_version, DataType, OptProfileSelector},
+    stream::CudaEvent,
+};
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct BenchOptions {
+    pub device: i32,
+    pub profile: i32,
+    // Leading dims to run the profile's opt shapes at; empty runs the opt shapes as they are.
+    pub batch_sizes: Vec<i32>,
+    // Number of contexts enqueueing concurrently, each from its own thread and stream.
+    pub concurrency: Vec<usize>,
+    pub warmup_iterations: usize,
+    // Timed iterations per context for every batch size and concurrency.
+    pub iterations: usize,
+    pub plan: PlanLoadOptions,
+    // How each iteration waits for its copies back, which shows in end-to-end latency.
+    pub wait_strategy: WaitStrategy,
+    // Runs every configuration with CUDA graphs off and/or on (TRTEngine::enable_cuda_graphs).
+    pub cuda_graphs: Vec<bool>,
+    // Host memory the copies go through, for every configuration.
+    pub uploads: Vec<UploadMemory>,
+    // Shapes to run instead of the profile's opt shapes, e.g. those a model is served at;
+    // batch_sizes still replace their leading dim.
+    pub input_shapes: Vec<(String, Shape)>,
+}
+
+impl Default for BenchOptions {
+    fn default() -> Self {
+        Self {
+            device: 0,
+            profile: 0,
+            batch_sizes: Vec::new(),
+            concurrency: vec![1],
+            warmup_iterations: 10,
+            iterations: 200,
+            plan: PlanLoadOptions::default(),
+            wait_strategy: WaitStrategy::default(),
+            cuda_graphs: vec![false],
+            uploads: vec![UploadMemory::Pinned],
+            input_shapes: Vec::new(),
+        }
+    }
+}
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum UploadMemory {
+    // page-locked, as StagingRing and ReadbackPool use: copies are asynchronous DMA
+    Pinned,
+    // plain heap memory, which the driver stages through bounce buffers of its own
+    Pageable,
+}
+
+impl UploadMemory {
+    pub fn name(&self) -> &'static str {
+        match self {
+            UploadMemory::Pinned => "pinned",
+            UploadMemory::Pageable => "pageable",
+        }
+    }
+}
+
+#[derive(Debug, Default, Copy, Clone, PartialEq)]
+pub struct LatencyStats {
+    pub count: usize,
+    pub mean_ms: f32,
+    pub min_ms: f32,
+    pub p50_ms: f32,
+    pub p90_ms: f32,
+    pub p99_ms: f32,
+    pub p999_ms: f32,
+    pub max_ms: f32,
+}
+
+impl LatencyStats {
+    // Nearest-rank percentiles, as reported by trtexec.
+    pub fn from_samples(samples: &[f32]) -> Self {
+        if samples.is_empty() {
+            return Self::default();
+        }
+        let mut sorted = samples.to_vec();
+        sorted.sort_by(|a, b| a.total_cmp(b));
+        Self {
+            count: sorted.len(),
+            mean_ms: sorted.iter().sum::<f32>() / sorted.len() as f32,
+            min_ms: sorted[0],
+            p50_ms: percentile(&sorted, 0.5),
+            p90_ms: percentile(&sorted, 0.9),
+            p99_ms: percentile(&sorted, 0.99),
+            p999_ms: percentile(&sorted, 0.999),
+            max_ms: sorted[sorted.len() - 1],
+        }
+    }
+
+    fn write_json(&self, out: &mut String) {
+        write!(
+            out,
+            "{{\"count\":{},\"mean_ms\":{},\"min_ms\":{},\"p50_ms\":{},\"p90_ms\":{},\"p99_ms\":{},\"p999_ms\":{},\"max_ms\":{}}}",
+            self.count, self.mean_ms, self.min_ms, self.p50_ms, self.p90_ms, self.p99_ms, self.p999_ms, self.max_ms,
+        )
+        .ok();
+    }
+}
+
+fn percentile(sorted: &[f32], q: f64) -> f32 {
+    let rank = (q * sorted.len() as f64).ceil() as usize;
+    sorted[rank.clamp(1, sorted.len()) - 1]
+}
+
+// One batch size at one concurrency, with graphs on or off and one kind of host memory.
+#[derive(Debug, Clone, PartialEq)]
+pub struct BenchRun {
+    pub batch_size: Option<i32>,
+    pub concurrency: usize,
+    pub cuda_graphs: bool,
+    pub upload: UploadMemory,
+    pub shapes: Vec<(String, Shape)>,
+    // Host-timed: input copies, enqueue, output copies and the stream synchronize, i.e. what a
+    // serving path pays per request.
+    pub end_to_end: LatencyStats,
+    // Device-timed with CUDA events.
+    pub gpu_compute: LatencyStats,
+    pub h2d: LatencyStats,
+    pub d2h: LatencyStats,
+    // Fractions of the device time spent on the copies.
+    pub h2d_share: f32,
+    pub d2h_share: f32,
+    // Inferences per second over all contexts; rows per second counts the batch size.
+    pub throughput: f64,
+    pub rows_per_second: f64,
+}
+
+impl BenchRun {
+    fn write_json(&self, out: &mut String) {
+        out.push_str("{\"batch_size\":");
+        match self.batch_size {
+            Some(batch_size) => write!(out, "{}", batch_size).ok(),
+            None => write!(out, "null").ok(),
+        };
+        write!(
+            out,
+            ",\"concurrency\":{},\"cuda_graphs\":{},\"upload\":\"{}\",\"shapes\":",
+            self.concurrency,
+            self.cuda_graphs,
+            self.upload.name(),
+        )
+        .ok();
+        write_json_shapes(out, &self.shapes);
+        out.push_str(",\"end_to_end\":");
+        self.end_to_end.write_json(out);
+        out.push_str(",\"gpu_compute\":");
+        self.gpu_compute.write_json(out);
+        out.push_str(",\"h2d\":");
+        self.h2d.write_json(out);
+        out.push_str(",\"d2h\":");
+        self.d2h.write_json(out);
+        write!(
+            out,
+            ",\"h2d_share\":{},\"d2h_share\":{},\"throughput\":{},\"rows_per_second\":{}}}",
+            self.h2d_share, self.d2h_share, self.throughput, self.rows_per_second,
+        )
+        .ok();
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct BenchReport {
+    pub plan: String,
+    pub device: String,
+    pub trt_version: i32,
+    pub runs: Vec<BenchRun>,
+}
+
+impl BenchReport {
+    pub fn to_json(&self) -> String {
+        let mut out = String::from("{\"plan\":");
+        write_json_string(&mut out, &self.plan);
+        out.push_str(",\"device\":");
+        write_json_string(&mut out, &self.device);
+        write!(out, ",\"trt_version\":{},\"runs\":[", self.trt_version).ok();
+        for (i, run) in self.runs.iter().enumerate() {
+            if i > 0 {
+                out.push(',');
+            }
+            run.write_json(&mut out);
+        }
+        out.push_str("]}");
+        out
+    }
+}
+
+fn write_json_shapes(out: &mut String, shapes: &[(String, Shape)]) {
+    out.push('{');
+    for (i, (name, shape)) in shapes.iter().enumerate() {
+        if i > 0 {
+            out.push(',');
+        }
+        write_json_string(out, name);
+        write!(out, ":{:?}", shape.as_slice()).ok();
+    }
+    out.push('}');
+}
+
+// null for the infinities and NaN, which JSON has no numbers for.
+fn write_json_f32(out: &mut String, value: f32) {
+    match value.is_finite() {
+        true => write!(out, "{}", value).ok(),
+        false => write!(out, "null").ok(),
+    };
+}
+
+fn write_json_string(out: &mut String, value: &str) {
+    out.push('"');
+    for c in value.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            c if (c as u32) < 0x20 => {
+                write!(out, "\\u{:04x}", c as u32).ok();
+            }
+            c => out.push(c),
+        }
+    }
+    out.push('"');
+}
+
+// Loads `plan_path` into a pool of max(concurrency) contexts and measures every batch size
+// at every concurrency, graph setting and kind of host memory, on synthetic inputs shaped
+// from the profile's opt shapes. Inputs are the same every run, so reports of the same plan
+// on the same device compare.
+pub fn run_benchmark<P: AsRef<Path>>(plan_path: &P, options: &BenchOptions) -> TRTResult<BenchReport> {
+    let ctx = CuDevice::new(options.device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+
+    let num_contexts = options.concurrency.iter().copied().max().unwrap_or(1).max(1);
+    let pool_options = EnginePoolOptions {
+        num_contexts,
+        profiles: vec![options.profile],
+        plan: options.plan.clone(),
+        wait_strategy: options.wait_strategy,
+        ..EnginePoolOptions::default()
+    };
+    // sized from the profile's max shapes
+    let pool = EnginePool::new(plan_path, &pool_options, |_, engine| {
+        engine.allocate_io_tensors(&HashMap::new(), None)
+    })?;
+
+    let opt_shapes = {
+        let engine = pool.checkout();
+        let mut shapes = Vec::new();
+        for name in engine.input_names() {
+            let shape = match options.input_shapes.iter().find(|(input, _)| input == name) {
+                Some((_, shape)) => *shape,
+                None => engine.get_profile_shape(name, options.profile, OptProfileSelector::OPT)?,
+            };
+            shapes.push((name.clone(), shape));
+        }
+        shapes
+    };
+
+    let batch_sizes: Vec<Option<i32>> = match options.batch_sizes.is_empty() {
+        true => vec![None],
+        false => options.batch_sizes.iter().map(|&batch_size| Some(batch_size)).collect(),
+    };
+    let mut runs = Vec::new();
+    for batch_size in batch_sizes {
+        let shapes: Vec<(String, Shape)> = opt_shapes
+            .iter()
+            .map(|(name, shape)| {
+                let mut dims = shape.to_vec();
+                if let (Some(batch_size), Some(dim)) = (batch_size, dims.first_mut()) {
+                    *dim = batch_size;
+                }
+                (name.clone(), Shape::new(&dims))
+            })
+            .collect();
+        for &concurrency in &options.concurrency {
+            for &cuda_graphs in &options.cuda_graphs {
+                for &upload in &options.uploads {
+                    let run = RunConfig { batch_size, concurrency: concurrency.max(1), cuda_graphs, upload };
+                    runs.push(run_config(&pool, &shapes, run, options)?);
+                }
+            }
+        }
+    }
+
+    Ok(BenchReport {
+        plan: plan_path.as_ref().display().to_string(),
+        device: device::get_device_name(options.device),
+        trt_version: get_infer_lib_version(),
+        runs,
+    })
+}
+
+#[derive(Default)]
+struct WorkerTimings {
+    end_to_end: Vec<f32>,
+    gpu_compute: Vec<f32>,
+    h2d: Vec<f32>,
+    d2h: Vec<f32>,
+    elapsed: Duration,
+}
+
+#[derive(Copy, Clone)]
+struct RunConfig {
+    batch_size: Option<i32>,
+    concurrency: usize,
+    cuda_graphs: bool,
+    upload: UploadMemory,
+}
+
+fn run_config(
+    pool: &EnginePool,
+    shapes: &[(String, Shape)],
+    run: RunConfig,
+    options: &BenchOptions,
+) -> TRTResult<BenchRun> {
+    let RunConfig { batch_size, concurrency, cuda_graphs, upload } = run;
+    // timed iterations start together, so the throughput measures the contexts overlapping
+    let barrier = Barrier::new(concurrency);
+    let results: Vec<TRTResult<WorkerTimings>> = thread::scope(|scope| {
+        let handles: Vec<_> = (0..concurrency)
+            .map(|_| {
+                let barrier = &barrier;
+                scope.spawn(move || -> TRTResult<WorkerTimings> {
+                    let ctx = CuDevice::new(options.device)?.retain_primary_context()?;
+                    let _guard = ctx.guard()?;
+                    let mut engine = pool.checkout();
+                    let worker = Worker::new(&mut engine, shapes, cuda_graphs, upload).and_then(|worker| {
+                        for _ in 0..options.warmup_iterations {
+                            worker.iteration(&mut engine)?;
+                        }
+                        Ok(worker)
+                    });
+                    // every thread has to reach the barrier, or the others wait forever
+                    barrier.wait();
+                    let worker = worker?;
+
+                    let mut timings = WorkerTimings::default();
+                    let start = Instant::now();
+                    for _ in 0..options.iterations {
+                        let (end_to_end, h2d, gpu_compute, d2h) = worker.iteration(&mut engine)?;
+                        timings.end_to_end.push(end_to_end);
+                        timings.h2d.push(h2d);
+                        timings.gpu_compute.push(gpu_compute);
+                        timings.d2h.push(d2h);
+                    }
+                    timings.elapsed = start.elapsed();
+                    Ok(timings)
+                })
+            })
+            .collect();
+        handles.into_iter().map(|handle| handle.join().unwrap()).collect()
+    });
+
+    let mut all = WorkerTimings::default();
+    for timings in results {
+        let timings = timings?;
+        all.end_to_end.extend(timings.end_to_end);
+        all.gpu_compute.extend(timings.gpu_compute);
+        all.h2d.extend(timings.h2d);
+        all.d2h.extend(timings.d2h);
+        all.elapsed = all.elapsed.max(timings.elapsed);
+    }
+
+    let (h2d, gpu_compute, d2h) = (
+        all.h2d.iter().sum::<f32>(),
+        all.gpu_compute.iter().sum::<f32>(),
+        all.d2h.iter().sum::<f32>(),
+    );
+    let device_time = (h2d + gpu_compute + d2h).max(f32::MIN_POSITIVE);
+    let seconds = all.elapsed.as_secs_f64().max(f64::MIN_POSITIVE);
+    let throughput = all.end_to_end.len() as f64 / seconds;
+    Ok(BenchRun {
+        batch_size,
+        concurrency,
+        cuda_graphs,
+        upload,
+        shapes: shapes.to_vec(),
+        end_to_end: LatencyStats::from_samples(&all.end_to_end),
+        gpu_compute: LatencyStats::from_samples(&all.gpu_compute),
+        h2d: LatencyStats::from_samples(&all.h2d),
+        d2h: LatencyStats::from_samples(&all.d2h),
+        h2d_share: h2d / device_time,
+        d2h_share: d2h / device_time,
+        throughput,
+        rows_per_second: throughput * batch_size.unwrap_or(1).max(1) as f64,
+    })
+}
+
+enum HostBuffer {
+    Pinned(PinnedMemory),
+    Pageable(Vec<u8>),
+}
+
+impl HostBuffer {
+    fn new(size: usize, upload: UploadMemory) -> TRTResult<Self> {
+        match upload {
+            UploadMemory::Pinned => Ok(HostBuffer::Pinned(pinned(size.max(1))?)),
+            UploadMemory::Pageable => Ok(HostBuffer::Pageable(vec![0; size.max(1)])),
+        }
+    }
+
+    fn get_raw(&self) -> usize {
+        match self {
+            HostBuffer::Pinned(mem) => mem.get_raw(),
+            HostBuffer::Pageable(data) => data.as_ptr() as usize,
+        }
+    }
+
+    // Safety: no copy from or into the buffer may be in flight.
+    unsafe fn as_mut_slice(&mut self) -> &mut [u8] {
+        match self {
+            HostBuffer::Pinned(mem) => mem.as_mut_slice(),
+            HostBuffer::Pageable(data) => data,
+        }
+    }
+}
+
+// Host buffers for one context's inputs and outputs, and the events bracketing the copies
+// and the enqueue of an iteration. Inputs are copied straight into the engine's buffers and
+// fed back as aliases of them, which inference does not copy again; with graphs on, what is
+// captured is the enqueue alone.
+struct Worker {
+    stream: CuStream,
+    inputs: Vec<(usize, HostBuffer, usize)>,
+    outputs: Vec<(usize, HostBuffer, usize)>,
+    feed: Vec<(String, Tensor)>,
+    events: [CudaEvent; 4],
+}
+
+impl Worker {
+    fn new(
+        engine: &mut TRTEngine,
+        shapes: &[(String, Shape)],
+        cuda_graphs: bool,
+        upload: UploadMemory,
+    ) -> TRTResult<Self> {
+        engine.enable_cuda_graphs(cuda_graphs);
+        for (name, shape) in shapes {
+            engine.set_input_shape(name, shape)?;
+        }
+        let stream = engine.get_stream().clone();
+
+        let mut inputs = Vec::with_capacity(shapes.len());
+        let mut feed = Vec::with_capacity(shapes.len());
+        for (name, shape) in shapes {
+            let tensor = match engine.get_tensor(name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name.clone())),
+            };
+            let size = shape.size() * tensor.dtype().get_elem_size();
+            let mut host = HostBuffer::new(size, upload)?;
+            fill_synthetic(unsafe { &mut host.as_mut_slice()[..size] }, tensor.dtype());
+            let device_ptr = unsafe { tensor.get_raw_ptr() };
+            inputs.push((device_ptr, host, size));
+            feed.push((name.clone(), Tensor::from_raw_ptr(device_ptr, shape, tensor.dtype(), &stream)));
+        }
+
+        let mut outputs = Vec::with_capacity(engine.output_names().len());
+        for name in engine.output_names() {
+            let shape = engine.get_tensor_shape(name)?;
+            let tensor = match engine.get_tensor(name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name.clone())),
+            };
+            // data-dependent outputs are read back at their allocated capacity
+            let elems = match shape.iter().any(|&dim| dim < 0) {
+                true => tensor.capacity(),
+                false => shape.size().min(tensor.capacity()),
+            };
+            let size = elems * tensor.dtype().get_elem_size();
+            outputs.push((unsafe { tensor.get_raw_ptr() }, HostBuffer::new(size, upload)?, size));
+        }
+
+        let event = || match CudaEvent::with_timing() {
+            Some(event) => Ok(event),
+            None => Err(TRTError::EventError),
+        };
+        Ok(Self { stream, inputs, outputs, feed, events: [event()?, event()?, event()?, event()?] })
+    }
+
+    // Returns the end-to-end, H2D, compute and D2H milliseconds.
+    fn iteration(&self, engine: &mut TRTEngine) -> TRTResult<(f32, f32, f32, f32)> {
+        let stream = &self.stream;
+        let start = Instant::now();
+        self.record(0)?;
+        for (device_ptr, host, size) in &self.inputs {
+            if !unsafe { memcpy_async(*device_ptr, host.get_raw(), *size, MemcpyKind::HostToDevice, stream) } {
+                return Err(TRTError::MemcpyError);
+            }
+        }
+        self.record(1)?;
+        let feed_dict: HashMap<&str, &Tensor> =
+            self.feed.iter().map(|(name, tensor)| (name.as_str(), tensor)).collect();
+        engine.inference(&feed_dict, Some(stream))?;
+        self.record(2)?;
+        for (device_ptr, host, size) in &self.outputs {
+            if !unsafe { memcpy_async(host.get_raw(), *device_ptr, *size, MemcpyKind::DeviceToHost, stream) } {
+                return Err(TRTError::MemcpyError);
+            }
+        }
+        self.record(3)?;
+        engine.synchronize_checked(Some(stream))?;
+        let end_to_end = start.elapsed().as_secs_f32() * 1000.0;
+
+        let elapsed = |from: usize, to: usize| match self.events[to].elapsed_ms_since(&self.events[from]) {
+            Some(ms) => Ok(ms),
+            None => Err(TRTError::EventError),
+        };
+        Ok((end_to_end, elapsed(0, 1)?, elapsed(1, 2)?, elapsed(2, 3)?))
+    }
+
+    fn record(&self, index: usize) -> TRTResult<()> {
+        match self.events[index].record(&self.stream) {
+            true => Ok(()),
+            false => Err(TRTError::EventError),
+        }
+    }
+}
+
+// How run_memory_benchmark loads the plan.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum LoadMode {
+    // fs::read then TRTEngine::from_bytes, the baseline: the whole plan on the heap
+    Read,
+    // TRTEngine::with_options, reading the plan through a mapping released after the load
+    Mmap,
+    // TRTEngine::from_reader, the plan streamed to TensorRT in chunks
+    Streaming,
+    // mapped like Mmap, with every context sharing one DeviceMemoryArena
+    SharedArena,
+}
+
+impl LoadMode {
+    pub const ALL: [LoadMode; 4] = [LoadMode::Read, LoadMode::Mmap, LoadMode::Streaming, LoadMode::SharedArena];
+
+    pub fn name(&self) -> &'static str {
+        match self {
+            LoadMode::Read => "read",
+            LoadMode::Mmap => "mmap",
+            LoadMode::Streaming => "streaming",
+            LoadMode::SharedArena => "shared_arena",
+        }
+    }
+
+    pub fn from_name(name: &str) -> Option<Self> {
+        Self::ALL.into_iter().find(|mode| mode.name() == name)
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct MemoryBenchOptions {
+    pub device: i32,
+    pub profile: i32,
+    pub mode: LoadMode,
+    // Execution contexts created on the loaded engine, as a pool of that size would.
+    pub contexts: usize,
+    // Inferences per context at the profile's opt shapes before the steady state is measured.
+    pub iterations: usize,
+    pub plan: PlanLoadOptions,
+    // How often device memory is sampled while the plan loads.
+    pub sample_interval: Duration,
+}
+
+impl Default for MemoryBenchOptions {
+    fn default() -> Self {
+        Self {
+            device: 0,
+            profile: 0,
+            mode: LoadMode::Read,
+            contexts: 1,
+            iterations: 20,
+            plan: PlanLoadOptions::default(),
+            sample_interval: Duration::from_millis(1),
+        }
+    }
+}
+
+// Memory one load mode costs, in bytes above what the process used before the load. Host
+// figures (resident set, from /proc) are None where they cannot be read; VmHWM is a peak
+// over the process's lifetime, so only a process measuring a single mode gets a clean one.
+// Device figures come from cudaMemGetInfo and so include other processes on the device.
+#[derive(Debug, Clone, PartialEq)]
+pub struct MemoryReport {
+    pub plan: String,
+    pub device: String,
+    pub trt_version: i32,
+    pub mode: LoadMode,
+    pub contexts: usize,
+    pub plan_size: usize,
+    pub load_time: Duration,
+    pub host_peak_load: Option<usize>,
+    pub host_steady: Option<usize>,
+    pub device_peak_load: usize,
+    pub device_steady: usize,
+    // What the crate itself accounts for in the steady state (device_memory_usage).
+    pub accounted: MemoryUsage,
+}
+
+impl MemoryReport {
+    pub fn to_json(&self) -> String {
+        let mut out = String::from("{\"plan\":");
+        write_json_string(&mut out, &self.plan);
+        out.push_str(",\"device\":");
+        write_json_string(&mut out, &self.device);
+        write!(
+            out,
+            ",\"trt_version\":{},\"mode\":\"{}\",\"contexts\":{},\"plan_size\":{},\"load_ms\":{}",
+            self.trt_version,
+            self.mode.name(),
+            self.contexts,
+            self.plan_size,
+            self.load_time.as_secs_f64() * 1000.0,
+        )
+        .ok();
+        for (key, value) in [("host_peak_load", self.host_peak_load), ("host_steady", self.host_steady)] {
+            match value {
+                Some(bytes) => write!(out, ",\"{}\":{}", key, bytes).ok(),
+                None => write!(out, ",\"{}\":null", key).ok(),
+            };
+        }
+        let accounted = &self.accounted;
+        write!(
+            out,
+            ",\"device_peak_load\":{},\"device_steady\":{},\"accounted\":{{\"weights\":{},\"context\":{},\
+             \"tensors\":{},\"pool\":{},\"outputs\":{},\"total\":{}}}}}",
+            self.device_peak_load,
+            self.device_steady,
+            accounted.weights,
+            accounted.context,
+            accounted.tensors,
+            accounted.pool,
+            accounted.outputs,
+            accounted.total(),
+        )
+        .ok();
+        out
+    }
+}
+
+// Loads `plan_path` the way `options.mode` does, creates `options.contexts` contexts with
+// their I/O tensors, runs each at the profile's opt shapes and reports the host and device
+// memory of the load, at its peak, and of the steady state after it. Meant for regression
+// checks of the load paths against LoadMode::Read, one mode per process (see MemoryReport).
+pub fn run_memory_benchmark<P: AsRef<Path>>(plan_path: &P, options: &MemoryBenchOptions) -> TRTResult<MemoryReport> {
+    let ctx = CuDevice::new(options.device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+    let stream = CuStream::new()?;
+    let path = plan_path.as_ref();
+    let plan_size = fs::metadata(path)?.len() as usize;
+
+    let device_used = || match device::get_mem_info() {
+        Some((free, total)) => Ok(total - free),
+        None => Err(TRTError::DeviceQueryError),
+    };
+    let device_baseline = device_used()?;
+    reset_peak_rss();
+    let host_baseline = host_memory().map(|(rss, _)| rss);
+
+    let sampler = DevicePeakSampler::start(options.device, options.sample_interval);
+    let start = Instant::now();
+    let loaded = load_contexts(path, options, &stream);
+    let load_time = start.elapsed();
+    let device_peak = sampler.stop();
+    let host_peak = host_memory().map(|(_, peak)| peak);
+    let mut engines = loaded?;
+
+    for engine in &mut engines {
+        engine.allocate_io_tensors(&HashMap::new(), None)?;
+        let inputs = engine.input_names().to_vec();
+        for name in &inputs {
+            let shape = engine.get_profile_shape(name, options.profile, OptProfileSelector::OPT)?;
+            engine.set_input_shape(name, &shape)?;
+        }
+        for _ in 0..options.iterations {
+            engine.execute(Some(&stream))?;
+        }
+        engine.synchronize_checked(Some(&stream))?;
+    }
+
+    let above = |value: usize, baseline: usize| value.saturating_sub(baseline);
+    let host_steady = host_memory().map(|(rss, _)| rss);
+    Ok(MemoryReport {
+        plan: path.display().to_string(),
+        device: device::get_device_name(options.device),
+        trt_version: get_infer_lib_version(),
+        mode: options.mode,
+        contexts: engines.len(),
+        plan_size,
+        load_time,
+        host_peak_load: host_peak.zip(host_baseline).map(|(peak, baseline)| above(peak, baseline)),
+        host_steady: host_steady.zip(host_baseline).map(|(rss, baseline)| above(rss, baseline)),
+        device_peak_load: above(device_peak.max(device_used()?), device_baseline),
+        device_steady: above(device_used()?, device_baseline),
+        accounted: device_memory_usage(),
+    })
+}
+
+fn load_contexts(path: &Path, options: &MemoryBenchOptions, stream: &CuStream) -> TRTResult<Vec<TRTEngine>> {
+    let first = match options.mode {
+        LoadMode::Read => TRTEngine::from_bytes(&fs::read(path)?, stream)?,
+        LoadMode::Mmap | LoadMode::SharedArena => TRTEngine::with_options(&path, &options.plan, stream)?,
+        LoadMode::Streaming => TRTEngine::from_reader(BufReader::new(File::open(path)?), stream)?,
+    };
+    let core = first.core()?;
+    let mut engines = vec![first];
+    for _ in 1..options.contexts.max(1) {
+        engines.push(TRTEngine::from_core(core.clone(), stream));
+    }
+    match options.mode {
+        LoadMode::SharedArena => {
+            let arena = Arc::new(DeviceMemoryArena::for_engines(&engines.iter().collect::<Vec<_>>(), stream)?);
+            for engine in &mut engines {
+                engine.activate_with_arena(&arena)?;
+            }
+        }
+        _ => {
+            for engine in &mut engines {
+                engine.activate()?;
+            }
+        }
+    }
+    Ok(engines)
+}
+
+// Polls the device's used memory from its own thread until stopped, keeping the peak.
+struct DevicePeakSampler {
+    stop: Arc<AtomicBool>,
+    handle: thread::JoinHandle<usize>,
+}
+
+impl DevicePeakSampler {
+    fn start(device: i32, interval: Duration) -> Self {
+        let stop = Arc::new(AtomicBool::new(false));
+        let stopped = stop.clone();
+        let handle = thread::spawn(move || {
+            let mut peak = 0;
+            if !device::set_device(device) {
+                return peak;
+            }
+            loop {
+                if let Some((free, total)) = device::get_mem_info() {
+                    peak = peak.max(total - free);
+                }
+                if stopped.load(Ordering::Acquire) {
+                    return peak;
+                }
+                thread::sleep(interval);
+            }
+        });
+        Self { stop, handle }
+    }
+
+    fn stop(self) -> usize {
+        self.stop.store(true, Ordering::Release);
+        self.handle.join().unwrap_or(0)
+    }
+}
+
+// The resident set and its peak (VmRSS, VmHWM) in bytes, on Linux.
+fn host_memory() -> Option<(usize, usize)> {
+    parse_status(&fs::read_to_string("/proc/self/status").ok()?)
+}
+
+fn parse_status(status: &str) -> Option<(usize, usize)> {
+    let field = |key: &str| {
+        let line = status.lines().find(|line| line.starts_with(key))?;
+        let kb: usize = line[key.len()..].trim().trim_end_matches("kB").trim().parse().ok()?;
+        Some(kb * 1024)
+    };
+    Some((field("VmRSS:")?, field("VmHWM:")?))
+}
+
+// Resets VmHWM to the current resident set, where the kernel allows it.
+fn reset_peak_rss() {
+    fs::write("/proc/self/clear_refs", "5").ok();
+}
+
+// How run_shape_fuzz walks the input shapes, within the bounds of the fuzzed profiles.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum ShapePattern {
+    // every dynamic dim uniform in its [min, max]
+    Random,
+    // all dims at their min, then at their max: every step a change to the far end
+    Alternate,
+    // from the min up to the max and back, a step at a time, so buffers keep regrowing
+    Ramp,
+    // a few random shapes again and again, which shape caching and graphs should amortize
+    Revisit,
+}
+
+impl ShapePattern {
+    pub const ALL: [ShapePattern; 4] =
+        [ShapePattern::Random, ShapePattern::Alternate, ShapePattern::Ramp, ShapePattern::Revisit];
+
+    pub fn name(&self) -> &'static str {
+        match self {
+            ShapePattern::Random => "random",
+            ShapePattern::Alternate => "alternate",
+            ShapePattern::Ramp => "ramp",
+            ShapePattern::Revisit => "revisit",
+        }
+    }
+
+    pub fn from_name(name: &str) -> Option<Self> {
+        Self::ALL.into_iter().find(|pattern| pattern.name() == name)
+    }
+}
+
+// Distinct shapes ShapePattern::Revisit cycles through.
+const REVISITED_SHAPES: usize = 4;
+// Mismatches a ShapeFuzzRun lists; the rest are only counted.
+const MAX_REPORTED_MISMATCHES: usize = 16;
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct ShapeFuzzOptions {
+    pub device: i32,
+    // Profiles the shapes are drawn from; with several, the engine under test selects them
+    // itself (TRTEngine::enable_auto_profile) and the reference is switched explicitly.
+    pub profiles: Vec<i32>,
+    pub patterns: Vec<ShapePattern>,
+    // Shapes run per pattern.
+    pub steps: usize,
+    // Inferences at every shape after the first, timed as the steady state.
+    pub repeats: usize,
+    pub seed: u64,
+    pub cuda_graphs: bool,
+    // Buckets the dynamic dims of every input to a multiple (BucketPolicy::round_up); they
+    // are then drawn only up to the largest multiple within the profile's max.
+    pub bucket_multiple: Option<i32>,
+    // Outputs are compared against the reference every `check_every` steps, 0 for never.
+    pub check_every: usize,
+    // Floating-point outputs match within tolerance * (1 + |reference|), others exactly.
+    pub tolerance: f32,
+    pub plan: PlanLoadOptions,
+}
+
+impl Default for ShapeFuzzOptions {
+    fn default() -> Self {
+        Self {
+            device: 0,
+            profiles: vec![0],
+            patterns: ShapePattern::ALL.to_vec(),
+            steps: 200,
+            repeats: 2,
+            seed: 0x5eed,
+            cuda_graphs: false,
+            bucket_multiple: None,
+            check_every: 1,
+            tolerance: 1e-3,
+            plan: PlanLoadOptions::default(),
+        }
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct FuzzMismatch {
+    pub step: usize,
+    pub output: String,
+    pub shapes: Vec<(String, Shape)>,
+    // infinite when the output shapes differ
+    pub max_error: f32,
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct FuzzFailure {
+    pub step: usize,
+    pub shapes: Vec<(String, Shape)>,
+    pub error: String,
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct ShapeFuzzRun {
+    pub pattern: ShapePattern,
+    // fewer than asked when a step failed
+    pub steps: usize,
+    pub distinct_shapes: usize,
+    // Host-timed inference and synchronize: the first at every shape that differs from the
+    // previous step's, and the rest.
+    pub change: LatencyStats,
+    pub steady: LatencyStats,
+    // What a shape change adds to an inference, mean against mean.
+    pub change_cost_ms: f32,
+    pub checked: usize,
+    pub max_error: f32,
+    pub num_mismatches: usize,
+    // the first MAX_REPORTED_MISMATCHES
+    pub mismatches: Vec<FuzzMismatch>,
+    pub cuda_graphs: usize,
+    pub cuda_graph_updates: u64,
+    // the error the pattern stopped at
+    pub failure: Option<FuzzFailure>,
+}
+
+impl ShapeFuzzRun {
+    fn write_json(&self, out: &mut String) {
+        write!(
+            out,
+            "{{\"pattern\":\"{}\",\"steps\":{},\"distinct_shapes\":{},\"change\":",
+            self.pattern.name(),
+            self.steps,
+            self.distinct_shapes,
+        )
+        .ok();
+        self.change.write_json(out);
+        out.push_str(",\"steady\":");
+        self.steady.write_json(out);
+        write!(out, ",\"change_cost_ms\":{},\"checked\":{},\"max_error\":", self.change_cost_ms, self.checked).ok();
+        write_json_f32(out, self.max_error);
+        write!(out, ",\"num_mismatches\":{},\"mismatches\":[", self.num_mismatches).ok();
+        for (i, mismatch) in self.mismatches.iter().enumerate() {
+            if i > 0 {
+                out.push(',');
+            }
+            write!(out, "{{\"step\":{},\"output\":", mismatch.step).ok();
+            write_json_string(out, &mismatch.output);
+            out.push_str(",\"shapes\":");
+            write_json_shapes(out, &mismatch.shapes);
+            out.push_str(",\"max_error\":");
+            write_json_f32(out, mismatch.max_error);
+            out.push('}');
+        }
+        write!(
+            out,
+            "],\"cuda_graphs\":{},\"cuda_graph_updates\":{},\"failure\":",
+            self.cuda_graphs, self.cuda_graph_updates
+        )
+        .ok();
+        match &self.failure {
+            Some(failure) => {
+                write!(out, "{{\"step\":{},\"shapes\":", failure.step).ok();
+                write_json_shapes(out, &failure.shapes);
+                out.push_str(",\"error\":");
+                write_json_string(out, &failure.error);
+                out.push('}');
+            }
+            None => out.push_str("null"),
+        }
+        out.push('}');
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct ShapeFuzzReport {
+    pub plan: String,
+    pub device: String,
+    pub trt_version: i32,
+    pub seed: u64,
+    pub runs: Vec<ShapeFuzzRun>,
+}
+
+impl ShapeFuzzReport {
+    pub fn to_json(&self) -> String {
+        let mut out = String::from("{\"plan\":");
+        write_json_string(&mut out, &self.plan);
+        out.push_str(",\"device\":");
+        write_json_string(&mut out, &self.device);
+        write!(out, ",\"trt_version\":{},\"seed\":{},\"runs\":[", self.trt_version, self.seed).ok();
+        for (i, run) in self.runs.iter().enumerate() {
+            if i > 0 {
+                out.push(',');
+            }
+            run.write_json(&mut out);
+        }
+        out.push_str("]}");
+        out
+    }
+
+    // Whether every pattern ran to the end with outputs matching the reference.
+    pub fn passed(&self) -> bool {
+        self.runs.iter().all(|run| run.failure.is_none() && run.num_mismatches == 0)
+    }
+}
+
+// Drives `plan_path` through every pattern's sequence of input shapes, timing the first
+// inference at each new shape against the repeats at it, and checks the outputs of the
+// engine under test, with graphs and bucketing as configured, against a reference context
+// of the same engine running every shape without them (at its bucket, padded by the
+// fuzzer). Inputs are random with the seed and step as seed, so a failing step reproduces.
+pub fn run_shape_fuzz<P: AsRef<Path>>(plan_path: &P, options: &ShapeFuzzOptions) -> TRTResult<ShapeFuzzReport> {
+    let ctx = CuDevice::new(options.device)?.retain_primary_context()?;
+    let _guard = ctx.guard()?;
+    let stream = CuStream::new()?;
+
+    let mut fuzzer = Fuzzer::new(plan_path.as_ref(), options, &stream)?;
+    let mut runs = Vec::with_capacity(options.patterns.len());
+    for &pattern in &options.patterns {
+        let run = fuzzer.run(pattern, options)?;
+        // a fresh context for the next pattern, in case the failure broke this one
+        if run.failure.is_some() {
+            fuzzer.engine.recover()?;
+        }
+        runs.push(run);
+    }
+
+    Ok(ShapeFuzzReport {
+        plan: plan_path.as_ref().display().to_string(),
+        device: device::get_device_name(options.device),
+        trt_version: get_infer_lib_version(),
+        seed: options.seed,
+        runs,
+    })
+}
+
+struct Fuzzer {
+    engine: TRTEngine,
+    reference: TRTEngine,
+    names: Vec<String>,
+    profiles: Vec<i32>,
+    // per profile, the min and max shape of every input
+    bounds: Vec<Vec<(Shape, Shape)>>,
+    policies: Vec<Option<BucketPolicy>>,
+    // the inputs fed to the engine under test and their padded copies fed to the reference,
+    // both with room for the largest shape
+    inputs: Vec<Tensor>,
+    padded: Vec<Tensor>,
+    stream: CuStream,
+}
+
+#[derive(Default)]
+struct FuzzProgress {
+    change: Vec<f32>,
+    steady: Vec<f32>,
+    checked: usize,
+    max_error: f32,
+    num_mismatches: usize,
+    mismatches: Vec<FuzzMismatch>,
+}
+
+impl Fuzzer {
+    fn new(path: &Path, options: &ShapeFuzzOptions, stream: &CuStream) -> TRTResult<Self> {
+        let mut engine = TRTEngine::with_options(&path, &options.plan, stream)?;
+        let mut reference = TRTEngine::from_core(engine.core()?, stream);
+        for context in [&mut engine, &mut reference] {
+            context.activate()?;
+            context.allocate_io_tensors(&HashMap::new(), None)?;
+        }
+
+        let names = engine.input_names().to_vec();
+        let profiles = match options.profiles.is_empty() {
+            true => vec![0],
+            false => options.profiles.clone(),
+        };
+        let mut bounds = Vec::with_capacity(profiles.len());
+        // elements of every input at its largest shape in any of the profiles
+        let mut capacities = vec![0; names.len()];
+        for &profile in &profiles {
+            let mut inputs = Vec::with_capacity(names.len());
+            for (name, capacity) in names.iter().zip(capacities.iter_mut()) {
+                let min = engine.get_profile_shape(name, profile, OptProfileSelector::MIN)?;
+                let max = engine.get_profile_shape(name, profile, OptProfileSelector::MAX)?;
+                *capacity = (*capacity).max(max.size());
+                inputs.push((min, max));
+            }
+            bounds.push(inputs);
+        }
+
+        let mut policies = vec![None; names.len()];
+        if let Some(multiple) = options.bucket_multiple.filter(|&multiple| multiple > 0) {
+            for (input, name) in names.iter().enumerate() {
+                let dims: Vec<usize> = (0..bounds[0][input].0.nb_dims())
+                    .filter(|&dim| bounds.iter().any(|profile| profile[input].0[dim] < profile[input].1[dim]))
+                    .collect();
+                // beyond the largest multiple within the max, the bucket would exceed it
+                for profile in bounds.iter_mut() {
+                    let (min, max) = &mut profile[input];
+                    let mut clamped = max.to_vec();
+                    for &dim in &dims {
+                        if max[dim] / multiple * multiple >= min[dim] {
+                            clamped[dim] = max[dim] / multiple * multiple;
+                        }
+                    }
+                    *max = Shape::new(&clamped);
+                }
+                let policy = BucketPolicy::round_up(&dims, multiple);
+                engine.set_bucket_policy(name, Some(policy.clone()));
+                policies[input] = Some(policy);
+            }
+        }
+        engine.enable_cuda_graphs(options.cuda_graphs);
+        if profiles.len() > 1 {
+            engine.enable_auto_profile(true)?;
+        }
+
+        // sized for every fuzzed profile, not the one the engine's own tensors were allocated for
+        let (mut inputs, mut padded) = (Vec::with_capacity(names.len()), Vec::with_capacity(names.len()));
+        for (input, name) in names.iter().enumerate() {
+            let tensor = match engine.get_tensor(name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name.clone())),
+            };
+            let (min, dtype, capacity) = (bounds[0][input].0, tensor.dtype(), capacities[input]);
+            inputs.push(Tensor::with_capacity(&min, capacity, dtype, stream)?);
+            padded.push(Tensor::with_capacity(&min, capacity, dtype, stream)?);
+        }
+
+        Ok(Self { engine, reference, names, profiles, bounds, policies, inputs, padded, stream: stream.clone() })
+    }
+
+    fn run(&mut self, pattern: ShapePattern, options: &ShapeFuzzOptions) -> TRTResult<ShapeFuzzRun> {
+        self.engine.clear_cuda_graphs();
+        let updates = self.engine.num_cuda_graph_updates();
+        let sequence = shape_sequence(pattern, &self.bounds, options.steps, options.seed);
+
+        let mut progress = FuzzProgress::default();
+        let (mut distinct, mut previous, mut failure, mut steps) = (Vec::new(), None, None, 0);
+        for (step, (profile, shapes)) in sequence.iter().enumerate() {
+            if !distinct.contains(shapes) {
+                distinct.push(shapes.clone());
+            }
+            let changed = previous != Some(shapes);
+            previous = Some(shapes);
+            if let Err(error) = self.step(step, *profile, shapes, changed, options, &mut progress) {
+                let shapes = self.names.iter().cloned().zip(shapes.iter().copied()).collect();
+                failure = Some(FuzzFailure { step, shapes, error: error.to_string() });
+                break;
+            }
+            steps += 1;
+        }
+
+        let (change, steady) =
+            (LatencyStats::from_samples(&progress.change), LatencyStats::from_samples(&progress.steady));
+        Ok(ShapeFuzzRun {
+            pattern,
+            steps,
+            distinct_shapes: distinct.len(),
+            change,
+            steady,
+            change_cost_ms: change.mean_ms - steady.mean_ms,
+            checked: progress.checked,
+            max_error: progress.max_error,
+            num_mismatches: progress.num_mismatches,
+            mismatches: progress.mismatches,
+            cuda_graphs: self.engine.num_cuda_graphs(),
+            cuda_graph_updates: self.engine.num_cuda_graph_updates() - updates,
+            failure,
+        })
+    }
+
+    fn step(
+        &mut self,
+        step: usize,
+        profile: usize,
+        shapes: &[Shape],
+        changed: bool,
+        options: &ShapeFuzzOptions,
+        progress: &mut FuzzProgress,
+    ) -> TRTResult<()> {
+        let stream = &self.stream;
+        let seed = options.seed ^ (step as u64).wrapping_mul(0x9e37_79b9_7f4a_7c15);
+        for (input, shape) in self.inputs.iter_mut().zip(shapes) {
+            unsafe { input.reset_shape(shape)? };
+            match input.dtype() {
+                DataType::FLOAT | DataType::HALF => input.fill_random(-1.0, 1.0, seed, stream)?,
+                // zeros, since integer inputs are often indices
+                _ => input.zero(stream)?,
+            }
+        }
+        stream.synchronize()?;
+
+        let feed_dict: HashMap<&str, &Tensor> = self.names.iter().map(String::as_str).zip(&self.inputs).collect();
+        for repeat in 0..=options.repeats {
+            let start = Instant::now();
+            self.engine.inference(&feed_dict, Some(stream))?;
+            self.engine.synchronize_checked(Some(stream))?;
+            let ms = start.elapsed().as_secs_f32() * 1000.0;
+            match repeat == 0 && changed {
+                true => progress.change.push(ms),
+                false => progress.steady.push(ms),
+            }
+        }
+        if options.check_every == 0 || step % options.check_every != 0 {
+            return Ok(());
+        }
+
+        // the reference's outputs are sized for its profile, so they are reallocated with it
+        let reference_profile = self.profiles[profile];
+        if self.reference.get_optimization_profile()? != reference_profile {
+            self.reference.set_optimization_profile(reference_profile)?;
+            self.reference.allocate_io_tensors(&HashMap::new(), Some(stream))?;
+        }
+        for ((padded, input), policy) in self.padded.iter_mut().zip(&self.inputs).zip(&self.policies) {
+            let bucket = policy.as_ref().and_then(|policy| policy.bucket(input.shape())).unwrap_or(*input.shape());
+            unsafe { padded.reset_shape(&bucket)? };
+            padded.copy_padded_from(input, stream)?;
+        }
+        let feed_dict: HashMap<&str, &Tensor> = self.names.iter().map(String::as_str).zip(&self.padded).collect();
+        self.reference.inference(&feed_dict, Some(stream))?;
+        self.reference.synchronize_checked(Some(stream))?;
+
+        progress.checked += 1;
+        for name in self.engine.output_names() {
+            let (shape, expected) = (self.engine.get_tensor_shape(name)?, self.reference.get_tensor_shape(name)?);
+            // data-dependent outputs are not compared
+            if shape.iter().chain(expected.iter()).any(|&dim| dim < 0) {
+                continue;
+            }
+            let error = match (self.engine.get_tensor(name), self.reference.get_tensor(name)) {
+                (Some(output), Some(reference)) if shape == expected => {
+                    let dtype = output.dtype();
+                    let (output, reference) =
+                        (read_to_host(output, &shape, stream)?, read_to_host(reference, &shape, stream)?);
+                    max_difference(&output, &reference, dtype)
+                }
+                (Some(_), Some(_)) => f32::INFINITY,
+                _ => return Err(TRTError::TensorNotFound(name.clone())),
+            };
+            progress.max_error = progress.max_error.max(error);
+            if error > options.tolerance {
+                progress.num_mismatches += 1;
+                if progress.mismatches.len() < MAX_REPORTED_MISMATCHES {
+                    let shapes = self.names.iter().cloned().zip(shapes.iter().copied()).collect();
+                    progress.mismatches.push(FuzzMismatch { step, output: name.clone(), shapes, max_error: error });
+                }
+            }
+        }
+        Ok(())
+    }
+}
+
+// The elements of `shape` at the start of `tensor`, copied to the host on `stream`.
+fn read_to_host(tensor: &Tensor, shape: &Shape, stream: &CuStream) -> TRTResult<Vec<u8>> {
+    if shape.size() > tensor.capacity() {
+        return Err(TRTError::ShapeMismatch);
+    }
+    let mut host = vec![0u8; shape.size() * tensor.dtype().get_elem_size()];
+    let size = host.len();
+    let copied = unsafe {
+        memcpy_async(host.as_mut_ptr() as usize, tensor.get_raw_ptr(), size, MemcpyKind::DeviceToHost, stream)
+    };
+    stream.synchronize()?;
+    match copied {
+        true => Ok(host),
+        false => Err(TRTError::MemcpyError),
+    }
+}
+
+// xorshift64, so shape sequences reproduce from their seed.
+struct XorShift(u64);
+
+impl XorShift {
+    fn new(seed: u64) -> Self {
+        Self(seed.max(1))
+    }
+
+    fn next(&mut self) -> u64 {
+        self.0 ^= self.0 << 13;
+        self.0 ^= self.0 >> 7;
+        self.0 ^= self.0 << 17;
+        self.0
+    }
+
+    fn below(&mut self, n: usize) -> usize {
+        (self.next() % n.max(1) as u64) as usize
+    }
+}
+
+// The profile (index into `bounds`) and input shapes of every step of `pattern`. Dims that
+// share their position and range across a profile's inputs, such as a batch or sequence dim,
+// take the same value, as engines usually require of them.
+fn shape_sequence(
+    pattern: ShapePattern,
+    bounds: &[Vec<(Shape, Shape)>],
+    steps: usize,
+    seed: u64,
+) -> Vec<(usize, Vec<Shape>)> {
+    if bounds.is_empty() {
+        return Vec::new();
+    }
+    let mut rng = XorShift::new(seed);
+    let revisited: Vec<(usize, u64)> = (0..REVISITED_SHAPES).map(|_| (rng.below(bounds.len()), rng.next())).collect();
+    // Ramp runs up and down once per profile
+    let segment = (steps / bounds.len()).max(1);
+
+    let mut sequence = Vec::with_capacity(steps);
+    for step in 0..steps {
+        let (profile, mut draw, ramp) = match pattern {
+            ShapePattern::Random => (rng.below(bounds.len()), XorShift::new(rng.next()), 0.0),
+            ShapePattern::Revisit => {
+                let (profile, seed) = revisited[rng.below(revisited.len())];
+                (profile, XorShift::new(seed), 0.0)
+            }
+            ShapePattern::Alternate => (step / 2 % bounds.len(), XorShift::new(1), 0.0),
+            ShapePattern::Ramp => {
+                let profile = (step / segment).min(bounds.len() - 1);
+                let start = profile * segment;
+                let len = match profile == bounds.len() - 1 {
+                    true => steps - start,
+                    false => segment,
+                };
+                let phase = 2.0 * (step - start) as f64 / (len - 1).max(1) as f64;
+                (profile, XorShift::new(1), if phase <= 1.0 { phase } else { 2.0 - phase })
+            }
+        };
+
+        let mut values: Vec<((usize, i32, i32), i32)> = Vec::new();
+        let mut shapes = Vec::with_capacity(bounds[profile].len());
+        for (min, max) in &bounds[profile] {
+            let mut dims = min.to_vec();
+            for (dim, value) in dims.iter_mut().enumerate() {
+                let (low, high) = (min[dim], max[dim]);
+                if low >= high {
+                    continue;
+                }
+                let key = (dim, low, high);
+                *value = match values.iter().find(|(shared, _)| *shared == key) {
+                    Some(&(_, shared)) => shared,
+                    None => {
+                        let drawn = match pattern {
+                            ShapePattern::Random | ShapePattern::Revisit => {
+                                low + draw.below((high - low + 1) as usize) as i32
+                            }
+                            ShapePattern::Alternate if step % 2 == 0 => low,
+                            ShapePattern::Alternate => high,
+                            ShapePattern::Ramp => low + (ramp * (high - low) as f64).round() as i32,
+                        };
+                        values.push((key, drawn));
+                        drawn
+                    }
+                };
+            }
+            shapes.push(Shape::new(&dims));
+        }
+        sequence.push((profile, shapes));
+    }
+    sequence
+}
+
+// Largest difference between two outputs of `dtype`, relative to 1 + |reference| for the
+// floating-point types; any difference in the others, or NaN against a number, is infinite.
+fn max_difference(output: &[u8], reference: &[u8], dtype: DataType) -> f32 {
+    if output.len() != reference.len() {
+        return f32::INFINITY;
+    }
+    let decode = |bytes: &[u8]| -> Option<Vec<f32>> {
+        match dtype {
+            DataType::FLOAT => Some(bytes.chunks_exact(4).map(|c| f32::from_ne_bytes(c.try_into().unwrap())).collect()),
+            DataType::HALF => {
+                Some(bytes.chunks_exact(2).map(|c| half_to_f32(u16::from_ne_bytes(c.try_into().unwrap()))).collect())
+            }
+            _ => None,
+        }
+    };
+    match (decode(output), decode(reference)) {
+        (Some(output), Some(reference)) => output
+            .iter()
+            .zip(&reference)
+            .map(|(&a, &b)| match (a.is_nan(), b.is_nan()) {
+                (true, true) => 0.0,
+                (false, false) if a == b => 0.0,
+                (false, false) => (a - b).abs() / (1.0 + b.abs()),
+                _ => f32::INFINITY,
+            })
+            .fold(0.0, f32::max),
+        _ => match output == reference {
+            true => 0.0,
+            false => f32::INFINITY,
+        },
+    }
+}
+
+fn half_to_f32(bits: u16) -> f32 {
+    let sign = if bits & 0x8000 != 0 { -1.0 } else { 1.0 };
+    let (exponent, mantissa) = ((bits >> 10) & 0x1f, (bits & 0x3ff) as f32);
+    sign * match exponent {
+        0 => mantissa * 2f32.powi(-24),
+        31 if mantissa == 0.0 => f32::INFINITY,
+        31 => f32::NAN,
+        exponent => (1.0 + mantissa / 1024.0) * 2f32.powi(exponent as i32 - 15),
+    }
+}
+
+// Finite values of magnitude [0.5, 1) with random signs and mantissas for floating-point
+// inputs, random bytes for 8-bit ones and zeros for integers, which are often indices.
+fn fill_synthetic(bytes: &mut [u8], dtype: DataType) {
+    let mut state: u32 = 0x9e37_79b9;
+    let mut next = || {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        state
+    };
+    match dtype {
+        DataType::FLOAT => {
+            for chunk in bytes.chunks_exact_mut(4) {
+                let bits = next() & 0x807f_ffff | 0x3f00_0000;
+                chunk.copy_from_slice(&bits.to_ne_bytes());
+            }
+        }
+        DataType::HALF => {
+            for chunk in bytes.chunks_exact_mut(2) {
+                let bits = (next() & 0x83ff | 0x3800) as u16;
+                chunk.copy_from_slice(&bits.to_ne_bytes());
+            }
+        }
+        DataType::INT8 | DataType::UINT8 => bytes.iter_mut().for_each(|byte| *byte = next() as u8),
+        DataType::BOOL => bytes.iter_mut().for_each(|byte| *byte = (next() & 1) as u8),
+        _ => bytes.fill(0),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn nearest_rank_percentiles() {
+        let samples: Vec<f32> = (1..=1000).rev().map(|ms| ms as f32).collect();
+        let stats = LatencyStats::from_samples(&samples);
+        assert_eq!(stats.count, 1000);
+        assert_eq!(stats.min_ms, 1.0);
+        assert_eq!(stats.p50_ms, 500.0);
+        assert_eq!(stats.p90_ms, 900.0);
+        assert_eq!(stats.p99_ms, 990.0);
+        assert_eq!(stats.p999_ms, 999.0);
+        assert_eq!(stats.max_ms, 1000.0);
+        assert_eq!(stats.mean_ms, 500.5);
+    }
+
+    #[test]
+    fn percentiles_of_few_samples() {
+        let stats = LatencyStats::from_samples(&[2.0, 1.0]);
+        assert_eq!(stats.p50_ms, 1.0);
+        assert_eq!(stats.p999_ms, 2.0);
+        assert_eq!(LatencyStats::from_samples(&[]), LatencyStats::default());
+    }
+
+    #[test]
+    fn json_strings_are_escaped() {
+        let mut out = String::new();
+        write_json_string(&mut out, "a\"b\\c\n");
+        assert_eq!(out, "\"a\\\"b\\\\c\\u000a\"");
+    }
+
+    #[test]
+    fn resident_set_from_proc_status() {
+        let status = "Name:\ttrtmem\nVmHWM:\t  204800 kB\nVmRSS:\t  102400 kB\n";
+        assert_eq!(parse_status(status), Some((100 << 20, 200 << 20)));
+        assert_eq!(parse_status("VmRSS:\t1 kB\n"), None);
+        assert_eq!(LoadMode::from_name("shared_arena"), Some(LoadMode::SharedArena));
+    }
+
+    #[test]
+    fn fuzzed_shapes_stay_in_bounds() {
+        // input_ids and attention_mask share the batch and sequence dims; pixels has its own
+        let bounds = vec![vec![
+            (Shape::new(&[1, 16]), Shape::new(&[8, 128])),
+            (Shape::new(&[1, 16]), Shape::new(&[8, 128])),
+            (Shape::new(&[1, 3, 32, 32]), Shape::new(&[8, 3, 64, 64])),
+        ]];
+        for pattern in ShapePattern::ALL {
+            let sequence = shape_sequence(pattern, &bounds, 50, 7);
+            assert_eq!(sequence.len(), 50);
+            for (profile, shapes) in &sequence {
+                assert_eq!(*profile, 0);
+                assert_eq!(shapes[0], shapes[1]);
+                assert_eq!(shapes[0][0], shapes[2][0]);
+                assert_eq!(shapes[2][1], 3);
+                for (shape, (min, max)) in shapes.iter().zip(&bounds[0]) {
+                    assert!(shape.iter().zip(min.iter().zip(max.iter())).all(|(d, (lo, hi))| lo <= d && d <= hi));
+                }
+            }
+            assert_eq!(shape_sequence(pattern, &bounds, 50, 7), sequence);
+        }
+    }
+
+    #[test]
+    fn fuzz_patterns() {
+        let bounds = vec![vec![(Shape::new(&[1, 16]), Shape::new(&[8, 128]))]];
+        let alternate = shape_sequence(ShapePattern::Alternate, &bounds, 4, 0);
+        let shapes: Vec<Shape> = alternate.into_iter().map(|(_, shapes)| shapes[0]).collect();
+        assert_eq!(shapes, [Shape::new(&[1, 16]), Shape::new(&[8, 128]), Shape::new(&[1, 16]), Shape::new(&[8, 128])]);
+
+        let ramp = shape_sequence(ShapePattern::Ramp, &bounds, 9, 0);
+        let batches: Vec<i32> = ramp.iter().map(|(_, shapes)| shapes[0][0]).collect();
+        assert_eq!(batches, [1, 3, 5, 6, 8, 6, 5, 3, 1]);
+
+        let mut revisited: Vec<Vec<Shape>> = Vec::new();
+        for (_, shapes) in shape_sequence(ShapePattern::Revisit, &bounds, 100, 3) {
+            if !revisited.contains(&shapes) {
+                revisited.push(shapes);
+            }
+        }
+        assert!(revisited.len() <= REVISITED_SHAPES);
+
+        let profiles = vec![bounds[0].clone(), vec![(Shape::new(&[16, 16]), Shape::new(&[32, 256]))]];
+        let ramp = shape_sequence(ShapePattern::Ramp, &profiles, 10, 0);
+        assert_eq!(ramp[2], (0, vec![Shape::new(&[8, 128])]));
+        assert_eq!(ramp[4], (0, vec![Shape::new(&[1, 16])]));
+        assert_eq!(ramp[9], (1, vec![Shape::new(&[16, 16])]));
+    }
+
+    #[test]
+    fn output_differences() {
+        let floats = |values: &[f32]| values.iter().flat_map(|value| value.to_ne_bytes()).collect::<Vec<u8>>();
+        let (a, b) = (floats(&[1.0, -3.0, f32::NAN]), floats(&[1.0, -3.01, f32::NAN]));
+        assert!((max_difference(&a, &b, DataType::FLOAT) - 0.01 / 4.01).abs() < 1e-5);
+        assert_eq!(max_difference(&a, &floats(&[1.0, -3.0, 0.0]), DataType::FLOAT), f32::INFINITY);
+        assert_eq!(max_difference(&[1, 2], &[1, 3], DataType::INT8), f32::INFINITY);
+        assert_eq!(max_difference(&[1, 2], &[1, 2], DataType::INT8), 0.0);
+        let halves = |values: &[u16]| values.iter().flat_map(|bits| bits.to_ne_bytes()).collect::<Vec<u8>>();
+        // the next FP16 above 1.0 against 1.0
+        assert_eq!(max_difference(&halves(&[0x3c01]), &halves(&[0x3c00]), DataType::HALF), 2f32.powi(-10) / 2.0);
+        assert_eq!(half_to_f32(0x7bff), 65504.0);
+        assert_eq!(half_to_f32(0xc000), -2.0);
+        assert_eq!(half_to_f32(0x0001), 2f32.powi(-24));
+    }
+}
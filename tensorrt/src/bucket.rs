@@ -0,0 +1,76 @@
+use crate::{
+    error::TRTResult,
+    region::copy_padded,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+
+// Maps input shapes onto a small set of canonical shapes, so a dynamic-shape engine sees few
+// distinct input shapes (and captured graphs get reused) while inputs are zero-padded.
+#[derive(Debug, Clone, PartialEq)]
+pub enum BucketPolicy {
+    // Round the listed dims up to a multiple, e.g. dims [2, 3] of NCHW to multiples of 32.
+    RoundUp { dims: Vec<usize>, multiple: i32 },
+    // The smallest listed shape (by volume) that contains the input.
+    Shapes(Vec<Shape>),
+}
+
+impl BucketPolicy {
+    pub fn round_up(dims: &[usize], multiple: i32) -> Self {
+        Self::RoundUp { dims: dims.to_vec(), multiple }
+    }
+
+    // None if no bucket can hold `shape`.
+    pub fn bucket(&self, shape: &Shape) -> Option<Shape> {
+        match self {
+            Self::RoundUp { dims, multiple } => {
+                if *multiple <= 0 {
+                    return Some(*shape);
+                }
+                let mut bucket = shape.to_vec();
+                for &dim in dims.iter().filter(|&&dim| dim < bucket.len()) {
+                    bucket[dim] = (bucket[dim] + multiple - 1) / multiple * multiple;
+                }
+                Some(Shape::new(&bucket))
+            }
+            Self::Shapes(shapes) => shapes
+                .iter()
+                .filter(|bucket| {
+                    bucket.nb_dims() == shape.nb_dims()
+                        && bucket.iter().zip(shape.iter()).all(|(b, s)| b >= s)
+                })
+                .min_by_key(|bucket| bucket.size())
+                .copied(),
+        }
+    }
+}
+
+// Copies `src` into the top-left corner of `dst`, whose shape is `src`'s shape padded in any
+// dim, and zeroes the rest: one memset and one 2D/3D copy for the usual NCHW buckets.
+pub(crate) fn pad_into(src: &Tensor, dst: &Tensor, stream: &CuStream) -> TRTResult<()> {
+    copy_padded(dst, src, stream)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn round_up_selected_dims() {
+        let policy = BucketPolicy::round_up(&[2, 3], 32);
+        let bucket = policy.bucket(&Shape::new(&[1, 3, 100, 64]));
+        assert_eq!(bucket, Some(Shape::new(&[1, 3, 128, 64])));
+    }
+
+    #[test]
+    fn smallest_containing_shape() {
+        let policy = BucketPolicy::Shapes(vec![
+            Shape::new(&[1, 3, 960, 960]),
+            Shape::new(&[1, 3, 480, 640]),
+            Shape::new(&[1, 3, 640, 480]),
+        ]);
+        assert_eq!(policy.bucket(&Shape::new(&[1, 3, 400, 600])), Some(Shape::new(&[1, 3, 480, 640])));
+        assert_eq!(policy.bucket(&Shape::new(&[1, 3, 700, 600])), Some(Shape::new(&[1, 3, 960, 960])));
+        assert_eq!(policy.bucket(&Shape::new(&[1, 3, 1000, 600])), None);
+    }
+}
@@ -0,0 +1,317 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    profile::ProfileShape,
+};
+use std::{
+    collections::HashMap,
+    fs,
+    io::ErrorKind,
+    path::{Path, PathBuf},
+    process,
+};
+use tensorrt_rs_sys::{
+    builder::{
+        Builder, BuilderConfig, BuilderFlag, DeviceType, HostMemory, Int8Calibrator, MemoryPoolType, NetworkDefinition,
+        TimingCache,
+    },
+    runtime::{HardwareCompatibilityLevel, OptProfileSelector, ProfilingVerbosity},
+};
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct BuildOptions {
+    pub fp16: bool,
+    pub int8: bool,
+    pub tf32: bool,
+    // Build an engine whose weights TRTEngine::refit can replace.
+    pub refittable: bool,
+    pub sparse_weights: bool,
+    // Build an engine whose weights can be streamed from host memory (see
+    // TRTEngine::set_weight_streaming_budget), for engines larger than the device memory.
+    pub weight_streaming: bool,
+    // Build a weight-stripped plan: small to store and load, but unusable until the weights
+    // it was built with are refit, e.g. straight from storage with DeviceWeights.
+    pub strip_weights: bool,
+    // Workspace memory pool limit; None keeps TensorRT's default (the device memory size).
+    pub workspace_size: Option<usize>,
+    // 0 to 5, trading build time for tactic coverage; None keeps TensorRT's default (3).
+    pub optimization_level: Option<i32>,
+    pub profiling_verbosity: ProfilingVerbosity,
+    // The min/opt/max shapes of each optimization profile, by input name. Required when the
+    // model has dynamic inputs.
+    pub profiles: Vec<HashMap<String, ProfileShape>>,
+    // Place layers on this DLA core instead of the GPU. DLA runs FP16 and INT8 only, so one
+    // of them must be enabled; the engine can be loaded onto any core with
+    // TRTEngine::from_bytes_on_dla.
+    pub dla_core: Option<i32>,
+    // With dla_core, run the layers DLA cannot on the GPU instead of failing the build.
+    pub gpu_fallback: bool,
+    // GPU architectures besides the builder's the plan runs on, e.g. AMPEREPLUS for one plan
+    // on every Ampere and newer GPU, at the cost of some tactics.
+    pub hardware_compatibility: HardwareCompatibilityLevel,
+    // A plan later TensorRT versions run too, loaded with PlanCompatibility::allow_host_code,
+    // restricted to the layers of the lean runtime.
+    pub version_compatible: bool,
+    // With version_compatible, leave the lean runtime out of the plan, for
+    // PlanCompatibility::lean_runtime to supply.
+    pub exclude_lean_runtime: bool,
+}
+
+impl Default for BuildOptions {
+    fn default() -> Self {
+        Self {
+            fp16: false,
+            int8: false,
+            tf32: true,
+            refittable: false,
+            sparse_weights: false,
+            weight_streaming: false,
+            strip_weights: false,
+            workspace_size: None,
+            optimization_level: None,
+            profiling_verbosity: ProfilingVerbosity::LAYERNAMESONLY,
+            profiles: Vec::new(),
+            dla_core: None,
+            gpu_fallback: true,
+            hardware_compatibility: HardwareCompatibilityLevel::NONE,
+            version_compatible: false,
+            exclude_lean_runtime: false,
+        }
+    }
+}
+
+// A timing cache persisted to a file and shared by every build that uses it, so tactics
+// timed once are not timed again. Timings are specific to a GPU model and TensorRT
+// version: use one file per SKU and release.
+#[derive(Debug, Clone, PartialEq)]
+pub struct TimingCacheFile {
+    path: PathBuf,
+}
+
+impl TimingCacheFile {
+    pub fn new<P: Into<PathBuf>>(path: P) -> Self {
+        Self { path: path.into() }
+    }
+
+    pub fn path(&self) -> &Path {
+        &self.path
+    }
+
+    // Empty if no build has stored the cache yet.
+    fn read(&self) -> TRTResult<Vec<u8>> {
+        match fs::read(&self.path) {
+            Ok(blob) => Ok(blob),
+            Err(e) if e.kind() == ErrorKind::NotFound => Ok(Vec::new()),
+            Err(e) => Err(e.into()),
+        }
+    }
+
+    fn load(&self, config: &mut BuilderConfig) -> TRTResult<TimingCache> {
+        let cache = match config.create_timing_cache(&self.read()?) {
+            Some(cache) => cache,
+            None => return Err(TRTError::TimingCacheError(self.path.clone())),
+        };
+        // a cache recorded on another device or TensorRT version is rejected
+        if !config.set_timing_cache(&cache, false) {
+            return Err(TRTError::TimingCacheError(self.path.clone()));
+        }
+        Ok(cache)
+    }
+
+    // Merges timings stored by concurrent builds since `load`, then replaces the file
+    // atomically so readers never see a partial cache. A stored cache that cannot be merged
+    // (recorded meanwhile on another device or TensorRT version) is left in place.
+    fn store(&self, config: &BuilderConfig, cache: &mut TimingCache) -> TRTResult<()> {
+        let current = self.read()?;
+        if !current.is_empty() {
+            if let Some(stored) = config.create_timing_cache(&current) {
+                if !cache.combine(&stored, false) {
+                    return Err(TRTError::TimingCacheError(self.path.clone()));
+                }
+            }
+        }
+        let blob = match cache.serialize() {
+            Some(blob) => blob,
+            None => return Err(TRTError::TimingCacheError(self.path.clone())),
+        };
+        let mut tmp = self.path.clone().into_os_string();
+        tmp.push(format!(".{}.tmp", process::id()));
+        fs::write(&tmp, blob.as_slice())?;
+        fs::rename(&tmp, &self.path)?;
+        Ok(())
+    }
+}
+
+// Builds serialized engines from ONNX models, replacing out-of-band trtexec builds.
+pub struct EngineBuilder {
+    builder: Builder,
+    timing_cache: Option<TimingCacheFile>,
+}
+
+impl EngineBuilder {
+    pub fn new() -> TRTResult<Self> {
+        let builder = match Builder::new() {
+            Some(builder) => builder,
+            None => return Err(TRTError::BuilderCreationError),
+        };
+        Ok(Self { builder, timing_cache: None })
+    }
+
+    pub fn with_timing_cache(mut self, cache: TimingCacheFile) -> Self {
+        self.timing_cache = Some(cache);
+        self
+    }
+
+    pub fn platform_has_fast_fp16(&self) -> bool {
+        self.builder.platform_has_fast_fp16()
+    }
+
+    pub fn platform_has_fast_int8(&self) -> bool {
+        self.builder.platform_has_fast_int8()
+    }
+
+    // DLA cores of the current device, for BuildOptions::dla_core; 0 on discrete GPUs.
+    pub fn get_nb_dla_cores(&self) -> i32 {
+        self.builder.get_nb_dla_cores()
+    }
+
+    // Builds the ONNX model at `path`; external weight files are resolved relative to it.
+    pub fn build_onnx_file<P: AsRef<Path>>(&self, path: &P, options: &BuildOptions) -> TRTResult<HostMemory> {
+        let mut network = self.create_network()?;
+        let path = path.as_ref().to_string_lossy();
+        let parsed = network.parse_from_file(&path, 2);
+        Self::check_parsed(&network, parsed)?;
+        self.build(&mut network, options, None)
+    }
+
+    // Like build_onnx_file, with INT8 enabled and calibrated by `calibrator`, e.g. an
+    // EntropyCalibrator. Models with explicit Q/DQ nodes do not need a calibrator.
+    pub fn build_onnx_file_int8<P: AsRef<Path>, C: Int8Calibrator + 'static>(
+        &self,
+        path: &P,
+        options: &BuildOptions,
+        calibrator: C,
+    ) -> TRTResult<HostMemory> {
+        let mut network = self.create_network()?;
+        let path = path.as_ref().to_string_lossy();
+        let parsed = network.parse_from_file(&path, 2);
+        Self::check_parsed(&network, parsed)?;
+        let options = BuildOptions { int8: true, ..options.clone() };
+        self.build(&mut network, &options, Some(Box::new(calibrator)))
+    }
+
+    pub fn build_onnx(&self, model: &[u8], options: &BuildOptions) -> TRTResult<HostMemory> {
+        let mut network = self.create_network()?;
+        let parsed = network.parse(model);
+        Self::check_parsed(&network, parsed)?;
+        self.build(&mut network, options, None)
+    }
+
+    // Builds `onnx_path` and writes the plan to `plan_path`, loadable with TRTEngine::new.
+    pub fn build_onnx_file_to<P: AsRef<Path>, Q: AsRef<Path>>(
+        &self,
+        onnx_path: &P,
+        plan_path: &Q,
+        options: &BuildOptions,
+    ) -> TRTResult<()> {
+        let plan = self.build_onnx_file(onnx_path, options)?;
+        fs::write(plan_path, plan.as_slice())?;
+        Ok(())
+    }
+
+    fn create_network(&self) -> TRTResult<NetworkDefinition<'_>> {
+        match self.builder.create_onnx_network() {
+            Some(network) => Ok(network),
+            None => Err(TRTError::BuilderCreationError),
+        }
+    }
+
+    fn check_parsed(network: &NetworkDefinition, parsed: bool) -> TRTResult<()> {
+        if parsed {
+            Ok(())
+        } else {
+            Err(TRTError::OnnxParseError(network.get_parser_errors().join("; ")))
+        }
+    }
+
+    fn build(
+        &self,
+        network: &mut NetworkDefinition,
+        options: &BuildOptions,
+        calibrator: Option<Box<dyn Int8Calibrator>>,
+    ) -> TRTResult<HostMemory> {
+        let mut config = match self.builder.create_builder_config() {
+            Some(config) => config,
+            None => return Err(TRTError::BuilderCreationError),
+        };
+        let flags = [
+            (BuilderFlag::FP16, options.fp16),
+            (BuilderFlag::INT8, options.int8),
+            (BuilderFlag::TF32, options.tf32),
+            (BuilderFlag::REFIT, options.refittable),
+            (BuilderFlag::SPARSEWEIGHTS, options.sparse_weights),
+            (BuilderFlag::WEIGHTSTREAMING, options.weight_streaming),
+            (BuilderFlag::STRIPPLAN, options.strip_weights),
+            (BuilderFlag::REFITIDENTICAL, options.strip_weights),
+            (BuilderFlag::VERSIONCOMPATIBLE, options.version_compatible),
+            (BuilderFlag::EXCLUDELEANRUNTIME, options.version_compatible && options.exclude_lean_runtime),
+        ];
+        for (flag, enabled) in flags {
+            if !config.set_flag(flag, enabled) {
+                return Err(TRTError::UnsupportedBuilderFlag(flag));
+            }
+        }
+        config.set_hardware_compatibility_level(options.hardware_compatibility);
+        if let Some(size) = options.workspace_size {
+            config.set_memory_pool_limit(MemoryPoolType::WORKSPACE, size);
+        }
+        if let Some(level) = options.optimization_level {
+            config.set_builder_optimization_level(level);
+        }
+        config.set_profiling_verbosity(options.profiling_verbosity);
+        if let Some(core) = options.dla_core {
+            if core < 0 || core >= self.builder.get_nb_dla_cores() {
+                return Err(TRTError::DlaCoreError(core));
+            }
+            config.set_default_device_type(DeviceType::DLA);
+            config.set_dla_core(core);
+            if !config.set_flag(BuilderFlag::GPUFALLBACK, options.gpu_fallback) {
+                return Err(TRTError::UnsupportedBuilderFlag(BuilderFlag::GPUFALLBACK));
+            }
+        }
+        if let Some(calibrator) = calibrator {
+            config.set_int8_calibrator(calibrator);
+        }
+
+        for shapes in &options.profiles {
+            let mut profile = match self.builder.create_optimization_profile() {
+                Some(profile) => profile,
+                None => return Err(TRTError::BuilderCreationError),
+            };
+            for (name, shape) in shapes {
+                let valid = profile.set_dimensions(name, OptProfileSelector::MIN, &shape.min)
+                    && profile.set_dimensions(name, OptProfileSelector::OPT, &shape.opt)
+                    && profile.set_dimensions(name, OptProfileSelector::MAX, &shape.max);
+                if !valid {
+                    return Err(TRTError::TensorNotFound(name.clone()));
+                }
+            }
+            let index = config.add_optimization_profile(&profile);
+            if index < 0 {
+                return Err(TRTError::ProfileError(index));
+            }
+        }
+
+        let mut cache = match &self.timing_cache {
+            Some(file) => Some(file.load(&mut config)?),
+            None => None,
+        };
+        let plan = match self.builder.build_serialized_network(network, &mut config) {
+            Some(plan) => plan,
+            None => return Err(TRTError::EngineBuildError),
+        };
+        if let (Some(file), Some(cache)) = (&self.timing_cache, cache.as_mut()) {
+            file.store(&config, cache)?;
+        }
+        Ok(plan)
+    }
+}
@@ -0,0 +1,129 @@
+use crate::{
+    error::TRTResult,
+    staging,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::HashMap,
+    fs,
+    path::PathBuf,
+    process,
+};
+use tensorrt_rs_sys::{
+    builder::Int8Calibrator,
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    runtime::DataType,
+};
+
+// One calibration batch: the raw host bytes of every network input, by name.
+pub type CalibrationBatch = HashMap<String, Vec<u8>>;
+
+struct CalibrationBuffer {
+    name: String,
+    staging: PinnedMemory,
+    device: Tensor,
+}
+
+// Entropy calibrator for INT8 builds (EngineBuilder::build_onnx_file_int8). Batches are
+// pulled from `batches`, copied into page-locked staging buffers and uploaded to the
+// device inputs TensorRT reads from. A batch missing an input, or whose bytes do not
+// match the input's shape, ends calibration.
+pub struct EntropyCalibrator<I> {
+    buffers: Vec<CalibrationBuffer>,
+    batches: I,
+    cache_path: Option<PathBuf>,
+    stream: CuStream,
+}
+
+impl<I: Iterator<Item = CalibrationBatch> + Send> EntropyCalibrator<I> {
+    // `inputs` are the network inputs with their full (batched) calibration shapes.
+    pub fn new(inputs: &[(&str, &Shape, DataType)], batches: I) -> TRTResult<Self> {
+        let stream = CuStream::new()?;
+        let mut buffers = Vec::with_capacity(inputs.len());
+        for (name, shape, dtype) in inputs {
+            let device = Tensor::empty(shape, *dtype, &stream)?;
+            buffers.push(CalibrationBuffer {
+                name: name.to_string(),
+                staging: staging::pinned(device.size_in_bytes())?,
+                device,
+            });
+        }
+        Ok(Self { buffers, batches, cache_path: None, stream })
+    }
+
+    // Reuses the calibration table stored at `path` by an earlier build, and stores it
+    // there after calibrating.
+    pub fn with_cache_file<P: Into<PathBuf>>(mut self, path: P) -> Self {
+        self.cache_path = Some(path.into());
+        self
+    }
+
+    fn upload(&mut self, batch: &CalibrationBatch) -> bool {
+        for buffer in &mut self.buffers {
+            let data = match batch.get(&buffer.name) {
+                Some(data) if data.len() == buffer.device.size_in_bytes() => data,
+                _ => return false,
+            };
+            // the previous upload was synchronized before TensorRT read it
+            unsafe { buffer.staging.as_mut_slice()[..data.len()].copy_from_slice(data) };
+            let copied = unsafe {
+                memcpy_async(
+                    buffer.device.get_raw_ptr(),
+                    buffer.staging.get_raw(),
+                    data.len(),
+                    MemcpyKind::HostToDevice,
+                    &self.stream,
+                )
+            };
+            if !copied {
+                return false;
+            }
+        }
+        self.stream.synchronize().is_ok()
+    }
+}
+
+impl<I: Iterator<Item = CalibrationBatch> + Send> Int8Calibrator for EntropyCalibrator<I> {
+    // explicit-batch networks take the batch size from the input shapes
+    fn batch_size(&self) -> i32 {
+        1
+    }
+
+    fn next_batch(&mut self) -> bool {
+        match self.batches.next() {
+            Some(batch) => self.upload(&batch),
+            None => false,
+        }
+    }
+
+    fn get_binding(&self, name: &str) -> usize {
+        match self.buffers.iter().find(|buffer| buffer.name == name) {
+            Some(buffer) => unsafe { buffer.device.get_raw_ptr() },
+            None => 0,
+        }
+    }
+
+    fn read_cache(&mut self) -> Vec<u8> {
+        // a missing or unreadable cache means calibrating
+        match &self.cache_path {
+            Some(path) => fs::read(path).unwrap_or_default(),
+            None => Vec::new(),
+        }
+    }
+
+    // Written atomically, so a concurrent build never reads a partial table. Failures only
+    // cost a recalibration next time.
+    fn write_cache(&mut self, cache: &[u8]) {
+        if let Some(path) = &self.cache_path {
+            let mut tmp = path.clone().into_os_string();
+            tmp.push(format!(".{}.tmp", process::id()));
+            if fs::write(&tmp, cache).is_ok() {
+                let _ = fs::rename(&tmp, path);
+            }
+        }
+    }
+}
+
+// The buffers and stream are only used by the builder thread while calibrating.
+unsafe impl<I: Send> Send for EntropyCalibrator<I> {}
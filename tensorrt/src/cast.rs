@@ -0,0 +1,41 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    tensor::Tensor,
+};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::{kernels::cast_tensor, runtime::DataType};
+
+impl Tensor {
+    // Converts `src` into this tensor's dtype on the GPU, e.g. FP32 request data into an FP16
+    // binding. Quantized types (INT8, UINT8, FP8) hold real = q * scale; pass 1.0 otherwise.
+    pub fn copy_from_cast(&mut self, src: &Tensor, scale: f32, stream: &CuStream) -> TRTResult<()> {
+        if self.shape() != src.shape() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        if self.dtype() == src.dtype() {
+            return self.copy_from(src, Some(stream));
+        }
+        let launched = unsafe {
+            cast_tensor(
+                src.get_raw_ptr(),
+                src.dtype(),
+                self.get_raw_ptr(),
+                self.dtype(),
+                src.shape().size(),
+                scale,
+                stream,
+            )
+        };
+        match launched {
+            true => Ok(()),
+            false => Err(TRTError::KernelLaunchError),
+        }
+    }
+
+    // A new tensor holding this one converted to `dtype`; see copy_from_cast.
+    pub fn to_dtype(&self, dtype: DataType, scale: f32, stream: &CuStream) -> TRTResult<Tensor> {
+        let mut dst = Tensor::empty(self.shape(), dtype, stream)?;
+        dst.copy_from_cast(self, scale, stream)?;
+        Ok(dst)
+    }
+}
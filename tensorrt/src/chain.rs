@@ -0,0 +1,548 @@
+use crate::{
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    graph::GraphKey,
+    staging::event,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::collections::HashMap;
+use tensorrt_rs_sys::{
+    graph::{self, CudaGraph, CudaGraphExec},
+    kernels::crop_resize,
+    runtime::DataType,
+    stream::CudaEvent,
+};
+
+enum LinkOp {
+    // the upstream buffer is bound as the downstream input, without a copy
+    Bind,
+    // `rects` ([n, 4] FLOAT, x0 y0 x1 y1) are cropped out of the upstream [1, C, H, W] image
+    // and resized into `output`, a [n, C, h, w] buffer bound as the downstream input
+    CropResize { rects: Tensor, output: Tensor },
+}
+
+struct Link {
+    from: usize,
+    tensor: String,
+    to: usize,
+    input: String,
+    op: LinkOp,
+}
+
+struct Stage {
+    engine: TRTEngine,
+    // recorded on the stage's stream after its enqueue
+    done: CudaEvent,
+    max_batch: Option<usize>,
+    // outputs of batches split into several enqueues, keyed by output name
+    batched_outputs: HashMap<String, Tensor>,
+}
+
+// The chain captured for one shape signature, with the addresses it was captured with.
+struct ChainGraph {
+    exec: CudaGraphExec,
+    addresses: Vec<usize>,
+}
+
+// Several engines chained through device buffers, e.g. detector -> cropper -> recognizer for
+// OCR. Every stage enqueues on its engine's stream, ordered behind its producers with events,
+// and data never goes back to the host between stages. Links either bind an upstream IO
+// buffer directly or run a batched GPU crop/resize in between.
+//
+// Stages are added in topological order. The first stage reads its engine-owned inputs, so
+// fill them (e.g. with preprocess_input, or bind buffers with set_input) before run. A stage
+// with a max batch runs larger batches in chunks into chain-owned output buffers.
+pub struct EngineChain {
+    stages: Vec<Stage>,
+    links: Vec<Link>,
+    fork: CudaEvent,
+    // keyed by the first stage's input shapes and the crop counts
+    graphs: HashMap<GraphKey, ChainGraph>,
+    auto_capture: bool,
+    single_stream: bool,
+    // caller buffers bound as inputs of the first stage
+    inputs: HashMap<String, Tensor>,
+}
+
+impl EngineChain {
+    pub fn new() -> TRTResult<Self> {
+        Ok(Self {
+            stages: Vec::new(),
+            links: Vec::new(),
+            fork: event()?,
+            graphs: HashMap::new(),
+            auto_capture: false,
+            single_stream: false,
+            inputs: HashMap::new(),
+        })
+    }
+
+    // `engine` must be activated with its IO tensors allocated. Returns the stage index.
+    pub fn add_stage(&mut self, engine: TRTEngine) -> TRTResult<usize> {
+        self.stages.push(Stage { engine, done: event()?, max_batch: None, batched_outputs: HashMap::new() });
+        self.graphs.clear();
+        Ok(self.stages.len() - 1)
+    }
+
+    // Splits batches of stage `stage` into enqueues of at most `max_batch` rows.
+    pub fn set_max_batch(&mut self, stage: usize, max_batch: Option<usize>) {
+        self.stages[stage].max_batch = max_batch.filter(|&max_batch| max_batch > 0);
+        self.graphs.clear();
+    }
+
+    pub fn stage(&self, stage: usize) -> &TRTEngine {
+        &self.stages[stage].engine
+    }
+
+    pub fn stage_mut(&mut self, stage: usize) -> &mut TRTEngine {
+        self.graphs.clear();
+        &mut self.stages[stage].engine
+    }
+
+    pub fn num_stages(&self) -> usize {
+        self.stages.len()
+    }
+
+    // Enqueues every stage on the first stage's stream instead of each engine's own, e.g. for
+    // short sequences of small models: stages need no events to order them, and a captured
+    // run is one linear graph. Stages then never overlap.
+    pub fn set_single_stream(&mut self, single: bool) {
+        self.single_stream = single;
+        self.graphs.clear();
+    }
+
+    // With graphs enabled, the first launch with a new shape signature (the first stage's
+    // input shapes and the crop counts) runs the chain and captures it, and later launches
+    // with the same shapes replay it: the whole multi-model request is one graph launch.
+    pub fn enable_cuda_graphs(&mut self, enabled: bool) {
+        self.auto_capture = enabled;
+        if !enabled {
+            self.graphs.clear();
+        }
+    }
+
+    pub fn num_cuda_graphs(&self) -> usize {
+        self.graphs.len()
+    }
+
+    // Binds `tensor` as input `name` of the first stage in place of its engine-owned buffer,
+    // e.g. to run on each request's own preprocessed buffer without a copy. A graph captured
+    // with another buffer gets its addresses updated when launched, not captured again.
+    // Safety: `tensor` must stay valid until the work of every run reading it completed.
+    pub unsafe fn set_input(&mut self, name: &str, tensor: &Tensor) -> TRTResult<()> {
+        let first = match self.stages.first() {
+            Some(first) => &first.engine,
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
+        };
+        match first.get_tensor(name) {
+            Some(target) if first.input_names().iter().any(|input| input == name) => {
+                if target.dtype() != tensor.dtype() {
+                    return Err(TRTError::DTypeMismatch);
+                }
+            }
+            _ => return Err(TRTError::TensorNotFound(name.to_string())),
+        }
+        let view = Tensor::from_raw_ptr(tensor.get_raw_ptr(), tensor.shape(), tensor.dtype(), first.get_stream());
+        self.inputs.insert(name.to_string(), view);
+        Ok(())
+    }
+
+    // Goes back to the engine-owned buffers of the first stage.
+    pub fn clear_inputs(&mut self) {
+        self.inputs.clear();
+    }
+
+    // Feeds IO tensor `tensor` of stage `from` (an output, or an input such as the source
+    // image) to input `input` of the later stage `to`.
+    pub fn connect(&mut self, from: usize, tensor: &str, to: usize, input: &str) -> TRTResult<()> {
+        self.check_link(from, tensor, to, input)?;
+        self.push_link(from, tensor, to, input, LinkOp::Bind);
+        Ok(())
+    }
+
+    // Crops up to `max_rects` boxes out of `tensor` of stage `from` and resizes each to
+    // height x width, feeding the [n, C, height, width] batch to `input` of stage `to`. The
+    // boxes live in a device buffer, see crop_rects. Returns the link index.
+    pub fn connect_crop(
+        &mut self,
+        from: usize,
+        tensor: &str,
+        to: usize,
+        input: &str,
+        max_rects: usize,
+        height: usize,
+        width: usize,
+    ) -> TRTResult<usize> {
+        self.check_link(from, tensor, to, input)?;
+        let source = self.source(from, tensor)?;
+        let channels = match source.shape().as_slice() {
+            &[1, channels, _, _] | &[channels, _, _] => channels,
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        match source.dtype() {
+            DataType::FLOAT | DataType::HALF => (),
+            _ => return Err(TRTError::DTypeMismatch),
+        }
+        match self.stages[to].engine.get_tensor(input) {
+            Some(target) if target.dtype() == source.dtype() => (),
+            Some(_) => return Err(TRTError::DTypeMismatch),
+            None => return Err(TRTError::TensorNotFound(input.to_string())),
+        }
+
+        let stream = self.stages[to].engine.get_stream();
+        let rects = Tensor::empty(&Shape::new(&[max_rects as i32, 4]), DataType::FLOAT, stream)?;
+        let output = Tensor::empty(
+            &Shape::new(&[max_rects as i32, channels, height as i32, width as i32]),
+            source.dtype(),
+            stream,
+        )?;
+        self.push_link(from, tensor, to, input, LinkOp::CropResize { rects, output });
+        Ok(self.links.len() - 1)
+    }
+
+    // The [n, 4] device buffer of crop link `link`. Write the boxes into it (an upload, or a
+    // kernel on the consuming stage's stream) and set n with set_crop_count.
+    pub fn crop_rects(&self, link: usize) -> Option<&Tensor> {
+        match &self.links.get(link)?.op {
+            LinkOp::CropResize { rects, .. } => Some(rects),
+            LinkOp::Bind => None,
+        }
+    }
+
+    pub fn set_crop_count(&mut self, link: usize, count: usize) -> TRTResult<()> {
+        let (rects, output) = match self.links.get_mut(link).map(|link| &mut link.op) {
+            Some(LinkOp::CropResize { rects, output }) => (rects, output),
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let mut dims = output.shape().to_vec();
+        dims[0] = count as i32;
+        unsafe {
+            rects.reset_shape(&Shape::new(&[count as i32, 4]))?;
+            output.reset_shape(&Shape::new(&dims))?;
+        }
+        Ok(())
+    }
+
+    // Output `name` of stage `stage` after the last run.
+    pub fn output(&self, stage: usize, name: &str) -> Option<&Tensor> {
+        let stage = self.stages.get(stage)?;
+        stage.batched_outputs.get(name).or_else(|| stage.engine.get_tensor(name))
+    }
+
+    // Enqueues every stage. Returns once all work is queued; wait with synchronize.
+    pub fn run(&mut self) -> TRTResult<()> {
+        self.enqueue(false)
+    }
+
+    // Records one run of the whole chain into a single CUDA graph for the current shapes,
+    // which launch then replays on the first stage's stream. Call run once beforehand so
+    // TensorRT has done its shape-dependent setup.
+    pub fn capture(&mut self) -> TRTResult<()> {
+        if self.stages.is_empty() {
+            return Ok(());
+        }
+        let key = self.signature();
+        let exec = match self.record()?.instantiate() {
+            Some(exec) => exec,
+            None => return Err(TRTError::GraphCaptureError),
+        };
+        let addresses = self.addresses();
+        self.graphs.insert(key, ChainGraph { exec, addresses });
+        Ok(())
+    }
+
+    // Replays the chain captured for the current shapes, or runs it when there is none, and
+    // with graphs enabled, captures it after that run.
+    pub fn launch(&mut self) -> TRTResult<()> {
+        if self.stages.is_empty() {
+            return Ok(());
+        }
+        let key = self.signature();
+        let stale = match self.graphs.get(&key) {
+            Some(graph) => graph.addresses != self.addresses(),
+            None if self.auto_capture => {
+                self.run()?;
+                return self.capture();
+            }
+            None => return self.run(),
+        };
+        if stale {
+            self.update(&key)?;
+        }
+        if !self.graphs[&key].exec.launch(self.stages[0].engine.get_stream()) {
+            return Err(TRTError::GraphLaunchError);
+        }
+        Ok(())
+    }
+
+    // Records a run at the current addresses and swaps them into the graph of `key`, which
+    // spares instantiating it; a graph whose work changed is instantiated again.
+    fn update(&mut self, key: &GraphKey) -> TRTResult<()> {
+        let recorded = self.record()?;
+        let addresses = self.addresses();
+        let graph = self.graphs.get_mut(key).unwrap();
+        if !graph.exec.update(&recorded) {
+            graph.exec = match recorded.instantiate() {
+                Some(exec) => exec,
+                None => return Err(TRTError::GraphCaptureError),
+            };
+        }
+        graph.addresses = addresses;
+        Ok(())
+    }
+
+    // One run of the chain recorded on the first stage's stream, without executing it.
+    fn record(&mut self) -> TRTResult<CudaGraph> {
+        let root = self.stages[0].engine.get_stream().clone();
+        if !graph::begin_capture(&root) {
+            return Err(TRTError::GraphCaptureError);
+        }
+        let res = self.enqueue_forked(&root);
+        // capture has to be ended even when enqueue failed
+        let captured = graph::end_capture(&root);
+        res?;
+        match captured {
+            Some(graph) => Ok(graph),
+            None => Err(TRTError::GraphCaptureError),
+        }
+    }
+
+    // What a captured run depends on besides its addresses.
+    fn signature(&self) -> GraphKey {
+        let first = &self.stages[0].engine;
+        let mut entries: Vec<(String, Shape)> = first
+            .input_names()
+            .iter()
+            .filter_map(|name| {
+                let tensor = self.inputs.get(name).or_else(|| first.get_tensor(name))?;
+                Some((name.clone(), *tensor.shape()))
+            })
+            .collect();
+        for (index, link) in self.links.iter().enumerate() {
+            if let LinkOp::CropResize { rects, .. } = &link.op {
+                entries.push((format!("crop/{}", index), *rects.shape()));
+            }
+        }
+        GraphKey::from_shapes(entries)
+    }
+
+    // The buffers a run reads or writes that may move between runs: the bound inputs, and
+    // the chunked outputs, which grow with the batch.
+    fn addresses(&self) -> Vec<usize> {
+        let mut inputs: Vec<(&String, &Tensor)> = self.inputs.iter().collect();
+        inputs.sort_unstable_by(|a, b| a.0.cmp(b.0));
+        let mut addresses: Vec<usize> = inputs.iter().map(|(_, tensor)| unsafe { tensor.get_raw_ptr() }).collect();
+        for stage in self.stages.iter() {
+            let mut outputs: Vec<(&String, &Tensor)> = stage.batched_outputs.iter().collect();
+            outputs.sort_unstable_by(|a, b| a.0.cmp(b.0));
+            addresses.extend(outputs.iter().map(|(_, tensor)| unsafe { tensor.get_raw_ptr() }));
+        }
+        addresses
+    }
+
+    pub fn synchronize(&self) -> TRTResult<()> {
+        for stage in self.stages.iter() {
+            stage.engine.get_stream().synchronize()?;
+        }
+        Ok(())
+    }
+
+    // Forks every stage stream off the capturing `root`, enqueues, and joins them back.
+    fn enqueue_forked(&mut self, root: &CuStream) -> TRTResult<()> {
+        if self.single_stream {
+            return self.enqueue(true);
+        }
+        if !self.fork.record(root) {
+            return Err(TRTError::EventError);
+        }
+        for stage in self.stages.iter() {
+            if !self.fork.wait(stage.engine.get_stream()) {
+                return Err(TRTError::EventError);
+            }
+        }
+        self.enqueue(true)?;
+        for stage in self.stages.iter() {
+            if !stage.done.wait(root) {
+                return Err(TRTError::EventError);
+            }
+        }
+        Ok(())
+    }
+
+    fn check_link(&self, from: usize, tensor: &str, to: usize, input: &str) -> TRTResult<()> {
+        if from >= to || to >= self.stages.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        self.source(from, tensor)?;
+        if !self.stages[to].engine.input_names().iter().any(|name| name == input) {
+            return Err(TRTError::TensorNotFound(input.to_string()));
+        }
+        Ok(())
+    }
+
+    fn source(&self, from: usize, tensor: &str) -> TRTResult<&Tensor> {
+        match self.stages[from].engine.get_tensor(tensor) {
+            Some(source) => Ok(source),
+            None => Err(TRTError::TensorNotFound(tensor.to_string())),
+        }
+    }
+
+    fn push_link(&mut self, from: usize, tensor: &str, to: usize, input: &str, op: LinkOp) {
+        self.links.push(Link { from, tensor: tensor.to_string(), to, input: input.to_string(), op });
+        self.graphs.clear();
+    }
+
+    fn enqueue(&mut self, capturing: bool) -> TRTResult<()> {
+        let single = self.single_stream;
+        let root = match self.stages.first() {
+            Some(first) => first.engine.get_stream().clone(),
+            None => return Ok(()),
+        };
+        for index in 0..self.stages.len() {
+            let (upstream, rest) = self.stages.split_at_mut(index);
+            let stream = match single {
+                true => root.clone(),
+                false => rest[0].engine.get_stream().clone(),
+            };
+
+            // the previous run's consumers must be done with this stage's buffers; inside a
+            // capture, replays are serialized on the root stream instead, and on a single
+            // stream, by the stream
+            if !capturing && !single {
+                for link in self.links.iter().filter(|link| link.from == index) {
+                    if !rest[link.to - index].done.wait(&stream) {
+                        return Err(TRTError::EventError);
+                    }
+                }
+            }
+            let stage = &mut rest[0];
+
+            let mut feed_dict: HashMap<&str, &Tensor> = HashMap::new();
+            if index == 0 {
+                feed_dict.extend(self.inputs.iter().map(|(name, tensor)| (name.as_str(), tensor)));
+            }
+            for link in self.links.iter().filter(|link| link.to == index) {
+                let producer = &upstream[link.from];
+                if !single && !producer.done.wait(&stream) {
+                    return Err(TRTError::EventError);
+                }
+                let source = match producer
+                    .batched_outputs
+                    .get(&link.tensor)
+                    .or_else(|| producer.engine.get_tensor(&link.tensor))
+                {
+                    Some(source) => source,
+                    None => return Err(TRTError::TensorNotFound(link.tensor.clone())),
+                };
+                match &link.op {
+                    LinkOp::Bind => {
+                        feed_dict.insert(link.input.as_str(), source);
+                    }
+                    LinkOp::CropResize { rects, output } => {
+                        Self::crop(source, rects, output, &stream)?;
+                        feed_dict.insert(link.input.as_str(), output);
+                    }
+                }
+            }
+
+            Self::execute_stage(stage, &feed_dict, &stream)?;
+            if !single && !stage.done.record(&stream) {
+                return Err(TRTError::EventError);
+            }
+        }
+        Ok(())
+    }
+
+    fn crop(source: &Tensor, rects: &Tensor, output: &Tensor, stream: &CuStream) -> TRTResult<()> {
+        let (channels, height, width) = match source.shape().as_slice() {
+            &[.., channels, height, width] => (channels, height, width),
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let (dst_height, dst_width) = match output.shape().as_slice() {
+            &[_, _, height, width] => (height, width),
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let launched = unsafe {
+            crop_resize(
+                source.get_raw_ptr(),
+                channels as _,
+                height as _,
+                width as _,
+                source.dtype() == DataType::HALF,
+                rects.get_raw_ptr(),
+                rects.shape()[0] as _,
+                output.get_raw_ptr(),
+                dst_height as _,
+                dst_width as _,
+                stream,
+            )
+        };
+        match launched {
+            true => Ok(()),
+            false => Err(TRTError::KernelLaunchError),
+        }
+    }
+
+    fn execute_stage(stage: &mut Stage, feed_dict: &HashMap<&str, &Tensor>, stream: &CuStream) -> TRTResult<()> {
+        if feed_dict.is_empty() {
+            stage.engine.execute(Some(stream))?;
+            return Ok(());
+        }
+        let batch = feed_dict.values().map(|tensor| tensor.shape()[0] as usize).max().unwrap_or(0);
+        let max_batch = match stage.max_batch {
+            Some(max_batch) if batch > max_batch => max_batch,
+            _ => {
+                stage.batched_outputs.clear();
+                stage.engine.inference_zero_copy(feed_dict, Some(stream))?;
+                return Ok(());
+            }
+        };
+
+        let mut start = 0;
+        while start < batch {
+            let count = max_batch.min(batch - start);
+            let inputs: Vec<(&str, Tensor)> = feed_dict
+                .iter()
+                .map(|(&name, &tensor)| (name, tensor.rows(start, count, stream)))
+                .collect();
+            for (name, input) in inputs.iter() {
+                stage.engine.set_input_shape(name, input.shape())?;
+            }
+
+            let mut outputs: Vec<(String, Tensor)> = Vec::with_capacity(stage.engine.output_names().len());
+            for name in stage.engine.output_names().to_vec() {
+                let shape = stage.engine.get_tensor_shape(&name)?;
+                let dtype = match stage.engine.get_tensor(&name) {
+                    Some(tensor) => tensor.dtype(),
+                    None => return Err(TRTError::TensorNotFound(name)),
+                };
+                let mut dims = shape.to_vec();
+                dims[0] = batch as i32;
+                let full = Shape::new(&dims);
+                let buffer = match stage.batched_outputs.remove(&name) {
+                    Some(mut buffer) if buffer.dtype() == dtype && buffer.capacity() >= full.size() => {
+                        unsafe { buffer.reset_shape(&full)? };
+                        buffer
+                    }
+                    _ => Tensor::empty(&full, dtype, stream)?,
+                };
+                outputs.push((name.clone(), buffer.rows(start, count, stream)));
+                stage.batched_outputs.insert(name, buffer);
+            }
+
+            let inputs: HashMap<&str, &Tensor> = inputs.iter().map(|(name, tensor)| (*name, tensor)).collect();
+            let outputs: HashMap<&str, &Tensor> = outputs.iter().map(|(name, tensor)| (name.as_str(), tensor)).collect();
+            stage.engine.inference_into(&inputs, &outputs, Some(stream))?;
+            start += count;
+        }
+        Ok(())
+    }
+}
+
+impl Drop for EngineChain {
+    fn drop(&mut self) {
+        // crop buffers and chunked outputs must outlive the work still queued on them
+        self.synchronize().ok();
+    }
+}
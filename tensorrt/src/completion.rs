@@ -0,0 +1,144 @@
+use crate::error::{TRTError, TRTResult};
+use cuda_rs::stream::CuStream;
+use std::{
+    future::Future,
+    hint,
+    pin::Pin,
+    sync::{Arc, Condvar, Mutex},
+    task::{Context, Poll, Waker},
+    thread,
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::stream::{launch_host_func, CudaEvent, CudaStatus};
+
+// How a thread waits for the work it enqueued, e.g. in TRTEngine::synchronize_checked.
+#[derive(Debug, Copy, Clone, Default, PartialEq, Eq)]
+pub enum WaitStrategy {
+    // cudaEventSynchronize, which spins, yields or blocks as the CUDA context's scheduling
+    // flags say
+    #[default]
+    Context,
+    // Polls cudaEventQuery without giving up the core: the lowest latency, at the cost of a
+    // busy core per waiting thread.
+    Spin,
+    // Spins for the duration, then yields the core between polls.
+    SpinThenYield(Duration),
+    // cudaEventSynchronize on a cudaEventBlockingSync event: the thread sleeps until the
+    // device signals completion, whatever the context's flags.
+    BlockingSync,
+    // Sleeps until a cudaLaunchHostFunc callback queued behind the work wakes it.
+    HostCallback,
+}
+
+// How often a HostCallback wait checks the event as well: host functions are not run once
+// the CUDA context has failed.
+const HOST_CALLBACK_POLL: Duration = Duration::from_millis(1);
+
+impl WaitStrategy {
+    // The event to record for waits with this strategy.
+    pub(crate) fn create_event(&self) -> Option<CudaEvent> {
+        match self {
+            Self::BlockingSync => CudaEvent::blocking_sync(),
+            _ => CudaEvent::new(),
+        }
+    }
+
+    // Waits for `event`, recorded on `stream`, and returns its status.
+    pub(crate) fn wait(&self, event: &CudaEvent, stream: &CuStream) -> CudaStatus {
+        match *self {
+            Self::Context | Self::BlockingSync => event.synchronize_status(),
+            Self::Spin => spin(event, None),
+            Self::SpinThenYield(spin_for) => spin(event, Some(spin_for)),
+            Self::HostCallback => wait_for_callback(event, stream),
+        }
+    }
+}
+
+fn spin(event: &CudaEvent, yield_after: Option<Duration>) -> CudaStatus {
+    let start = Instant::now();
+    loop {
+        let status = event.query_status();
+        if status != CudaStatus::NOT_READY {
+            return status;
+        }
+        match yield_after {
+            Some(yield_after) if start.elapsed() >= yield_after => thread::yield_now(),
+            _ => hint::spin_loop(),
+        }
+    }
+}
+
+fn wait_for_callback(event: &CudaEvent, stream: &CuStream) -> CudaStatus {
+    let done = Arc::new((Mutex::new(false), Condvar::new()));
+    let signal = done.clone();
+    let launched = launch_host_func(stream, move || {
+        *signal.0.lock().unwrap() = true;
+        signal.1.notify_one();
+    });
+    if !launched {
+        return event.synchronize_status();
+    }
+    let (lock, cond) = &*done;
+    let mut finished = lock.lock().unwrap();
+    while !*finished {
+        finished = cond.wait_timeout(finished, HOST_CALLBACK_POLL).unwrap().0;
+        if !*finished {
+            let status = event.query_status();
+            if status != CudaStatus::NOT_READY {
+                return status;
+            }
+        }
+    }
+    event.query_status()
+}
+
+#[derive(Default)]
+struct CompletionState {
+    done: bool,
+    waker: Option<Waker>,
+}
+
+// Resolves once all work queued on a stream at creation time has completed. Completion is
+// signalled from a cudaLaunchHostFunc callback, so no thread blocks in cudaStreamSynchronize
+// while the work is in flight.
+pub struct StreamCompletion {
+    state: Arc<Mutex<CompletionState>>,
+}
+
+impl StreamCompletion {
+    pub fn new(stream: &CuStream) -> TRTResult<Self> {
+        let state = Arc::new(Mutex::new(CompletionState::default()));
+        let callback_state = state.clone();
+        let launched = launch_host_func(stream, move || {
+            let mut state = callback_state.lock().unwrap();
+            state.done = true;
+            if let Some(waker) = state.waker.take() {
+                waker.wake();
+            }
+        });
+        if !launched {
+            return Err(TRTError::StreamCallbackError);
+        }
+        Ok(Self { state })
+    }
+
+    pub fn is_complete(&self) -> bool {
+        self.state.lock().unwrap().done
+    }
+}
+
+impl Future for StreamCompletion {
+    type Output = ();
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<()> {
+        let mut state = self.state.lock().unwrap();
+        if state.done {
+            return Poll::Ready(());
+        }
+        match state.waker.as_ref() {
+            Some(waker) if waker.will_wake(cx.waker()) => {}
+            _ => state.waker = Some(cx.waker().clone()),
+        }
+        Poll::Pending
+    }
+}
@@ -0,0 +1,289 @@
+use std::{
+    collections::BTreeMap,
+    fs::File,
+    io::{self, Cursor, Read, Write},
+    path::Path,
+    sync::{
+        mpsc::{self, Receiver, Sender, SyncSender},
+        Arc, Mutex,
+    },
+    thread,
+};
+
+const ZSTD_MAGIC: u32 = 0xFD2F_B528;
+// A zstd skippable frame ahead of every data frame, holding its compressed and decompressed
+// sizes, so frames are split without parsing them. Decoders that do not know it skip it:
+// the files stay readable by `zstd -d`.
+const SIZES_MAGIC: u32 = 0x184D_2A5B;
+const SIZES_HEADER: usize = 16;
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct CompressOptions {
+    // zstd level, 1 to 22.
+    pub level: i32,
+    // Plan bytes per frame; frames are the unit of parallel decompression.
+    pub frame_size: usize,
+}
+
+impl Default for CompressOptions {
+    fn default() -> Self {
+        Self { level: 9, frame_size: 8 << 20 }
+    }
+}
+
+// Compresses a plan into independent zstd frames that CompressedPlanReader decompresses in
+// parallel. Returns the compressed size.
+pub fn compress_plan<R: Read, W: Write>(mut src: R, mut dst: W, options: &CompressOptions) -> io::Result<u64> {
+    let frame_size = options.frame_size.clamp(1 << 16, u32::MAX as usize);
+    let mut frame = vec![0; frame_size];
+    let mut written = 0;
+    loop {
+        let len = read_full(&mut src, &mut frame)?;
+        if len == 0 {
+            break;
+        }
+        let compressed = zstd::bulk::compress(&frame[..len], options.level)?;
+        let mut header = [0; SIZES_HEADER];
+        header[0..4].copy_from_slice(&SIZES_MAGIC.to_le_bytes());
+        header[4..8].copy_from_slice(&8u32.to_le_bytes());
+        header[8..12].copy_from_slice(&(compressed.len() as u32).to_le_bytes());
+        header[12..16].copy_from_slice(&(len as u32).to_le_bytes());
+        dst.write_all(&header)?;
+        dst.write_all(&compressed)?;
+        written += (SIZES_HEADER + compressed.len()) as u64;
+    }
+    dst.flush()?;
+    Ok(written)
+}
+
+// Fills `buffer` unless the reader ends first; returns the bytes read.
+fn read_full<R: Read>(reader: &mut R, buffer: &mut [u8]) -> io::Result<usize> {
+    let mut len = 0;
+    while len < buffer.len() {
+        match reader.read(&mut buffer[len..]) {
+            Ok(0) => break,
+            Ok(n) => len += n,
+            Err(err) if err.kind() == io::ErrorKind::Interrupted => continue,
+            Err(err) => return Err(err),
+        }
+    }
+    Ok(len)
+}
+
+fn invalid(message: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::InvalidData, message.to_string())
+}
+
+// The plan bytes of a compressed plan, read as they are decompressed, for
+// TRTEngine::from_reader: a background thread reads the frames of compress_plan from the
+// source while a pool of workers decompresses them, and at most a few frames are held at a
+// time, never the whole plan. Other zstd files are decompressed as a single stream, and
+// uncompressed plans are passed through.
+pub struct CompressedPlanReader {
+    inner: Box<dyn Read + Send>,
+}
+
+impl CompressedPlanReader {
+    pub fn new<R: Read + Send + 'static>(mut reader: R, num_workers: usize) -> io::Result<Self> {
+        let mut magic = [0; 4];
+        let len = read_full(&mut reader, &mut magic)?;
+        let source = Cursor::new(magic[..len].to_vec()).chain(reader);
+        let inner: Box<dyn Read + Send> = match (len == 4).then(|| u32::from_le_bytes(magic)) {
+            Some(SIZES_MAGIC) => Box::new(FrameDecoder::new(source, num_workers.max(1))),
+            Some(ZSTD_MAGIC) => Box::new(zstd::stream::read::Decoder::new(source)?),
+            _ => Box::new(source),
+        };
+        Ok(Self { inner })
+    }
+
+    pub fn open<P: AsRef<Path>>(path: &P, num_workers: usize) -> io::Result<Self> {
+        Self::new(File::open(path)?, num_workers)
+    }
+}
+
+impl Read for CompressedPlanReader {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        self.inner.read(buf)
+    }
+}
+
+enum Decoded {
+    Frame(usize, io::Result<Vec<u8>>),
+    // the source ended after this many frames
+    End(usize),
+}
+
+struct FrameDecoder {
+    results: Receiver<Decoded>,
+    // frames decompressed ahead of the one being read
+    ready: BTreeMap<usize, io::Result<Vec<u8>>>,
+    next: usize,
+    end: Option<usize>,
+    current: Vec<u8>,
+    pos: usize,
+    // a frame may be read from the source only for a credit, handed back once it is consumed
+    credits: SyncSender<()>,
+    holding: bool,
+}
+
+impl FrameDecoder {
+    fn new<R: Read + Send + 'static>(source: R, num_workers: usize) -> Self {
+        let in_flight = 2 * num_workers;
+        let (credits, credit) = mpsc::sync_channel(in_flight);
+        for _ in 0..in_flight {
+            credits.send(()).ok();
+        }
+        let (jobs, job) = mpsc::sync_channel::<(usize, Vec<u8>, usize)>(in_flight);
+        let (results, decoded) = mpsc::channel();
+
+        // the threads end as the channels close; none of them is joined, so dropping the
+        // reader never waits for the source
+        let job = Arc::new(Mutex::new(job));
+        for _ in 0..num_workers {
+            let (job, results) = (job.clone(), results.clone());
+            thread::spawn(move || loop {
+                let next = job.lock().unwrap().recv();
+                let (index, compressed, len) = match next {
+                    Ok(next) => next,
+                    Err(_) => break,
+                };
+                let frame = zstd::bulk::decompress(&compressed, len).and_then(|frame| match frame.len() == len {
+                    true => Ok(frame),
+                    false => Err(invalid("zstd frame of unexpected size")),
+                });
+                if results.send(Decoded::Frame(index, frame)).is_err() {
+                    break;
+                }
+            });
+        }
+        thread::spawn(move || Self::read_frames(source, credit, jobs, results));
+
+        Self {
+            results: decoded,
+            ready: BTreeMap::new(),
+            next: 0,
+            end: None,
+            current: Vec::new(),
+            pos: 0,
+            credits,
+            holding: false,
+        }
+    }
+
+    fn read_frames<R: Read>(
+        mut source: R,
+        credit: Receiver<()>,
+        jobs: SyncSender<(usize, Vec<u8>, usize)>,
+        results: Sender<Decoded>,
+    ) {
+        let mut index = 0;
+        while credit.recv().is_ok() {
+            let mut header = [0; SIZES_HEADER];
+            let res = match read_full(&mut source, &mut header) {
+                Ok(0) => break,
+                Ok(SIZES_HEADER) => Ok(header),
+                Ok(_) => Err(invalid("truncated compressed plan")),
+                Err(err) => Err(err),
+            };
+            let frame = res.and_then(|header| {
+                let word = |at: usize| u32::from_le_bytes(header[at..at + 4].try_into().unwrap());
+                if word(0) != SIZES_MAGIC || word(4) != 8 {
+                    return Err(invalid("not a frame of compress_plan"));
+                }
+                let mut compressed = vec![0; word(8) as usize];
+                match read_full(&mut source, &mut compressed)? == compressed.len() {
+                    true => Ok((compressed, word(12) as usize)),
+                    false => Err(invalid("truncated compressed plan")),
+                }
+            });
+            match frame {
+                Ok((compressed, len)) => {
+                    if jobs.send((index, compressed, len)).is_err() {
+                        return;
+                    }
+                }
+                Err(err) => {
+                    results.send(Decoded::Frame(index, Err(err))).ok();
+                    index += 1;
+                    break;
+                }
+            }
+            index += 1;
+        }
+        results.send(Decoded::End(index)).ok();
+    }
+}
+
+impl Read for FrameDecoder {
+    fn read(&mut self, buf: &mut [u8]) -> io::Result<usize> {
+        loop {
+            if self.pos < self.current.len() {
+                let n = buf.len().min(self.current.len() - self.pos);
+                buf[..n].copy_from_slice(&self.current[self.pos..self.pos + n]);
+                self.pos += n;
+                return Ok(n);
+            }
+            if self.holding {
+                self.credits.send(()).ok();
+                self.holding = false;
+            }
+            if self.end.map_or(false, |end| self.next >= end) {
+                return Ok(0);
+            }
+            if let Some(frame) = self.ready.remove(&self.next) {
+                self.next += 1;
+                self.current = frame?;
+                self.pos = 0;
+                self.holding = true;
+                continue;
+            }
+            match self.results.recv() {
+                Ok(Decoded::Frame(index, frame)) => {
+                    self.ready.insert(index, frame);
+                }
+                Ok(Decoded::End(count)) => self.end = Some(count),
+                Err(_) => return Err(io::Error::new(io::ErrorKind::UnexpectedEof, "compressed plan reader stopped")),
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn roundtrip(plan: &[u8], frame_size: usize, num_workers: usize) -> Vec<u8> {
+        let mut compressed = Vec::new();
+        let options = CompressOptions { level: 1, frame_size };
+        compress_plan(plan, &mut compressed, &options).unwrap();
+        let mut reader = CompressedPlanReader::new(Cursor::new(compressed), num_workers).unwrap();
+        let mut out = Vec::new();
+        reader.read_to_end(&mut out).unwrap();
+        out
+    }
+
+    #[test]
+    fn frames_decompress_in_order() {
+        let plan: Vec<u8> = (0..1_000_000u32).map(|i| (i % 251) as u8).collect();
+        assert_eq!(roundtrip(&plan, 1 << 16, 4), plan);
+        assert_eq!(roundtrip(&plan, 1 << 20, 1), plan);
+        assert!(roundtrip(&[], 1 << 16, 2).is_empty());
+    }
+
+    #[test]
+    fn uncompressed_plans_pass_through() {
+        let mut reader = CompressedPlanReader::new(Cursor::new(b"ptrt".to_vec()), 2).unwrap();
+        let mut out = Vec::new();
+        reader.read_to_end(&mut out).unwrap();
+        assert_eq!(out, b"ptrt");
+    }
+
+    #[test]
+    fn truncated_plans_fail() {
+        let mut compressed = Vec::new();
+        compress_plan(&[7u8; 100_000][..], &mut compressed, &CompressOptions::default()).unwrap();
+        compressed.truncate(compressed.len() - 1);
+        let mut reader = CompressedPlanReader::new(Cursor::new(compressed), 2).unwrap();
+        assert!(reader.read_to_end(&mut Vec::new()).is_err());
+    }
+}
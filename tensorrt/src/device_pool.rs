@@ -0,0 +1,335 @@
+use crate::{
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    plan::PlanFile,
+    pool::{EnginePool, EnginePoolOptions, PooledEngine},
+    sm_budget::SmBudget,
+    tensor::Shape,
+};
+use cuda_rs::device::CuDevice;
+use std::{
+    collections::HashMap,
+    ops::{Deref, DerefMut},
+    path::Path,
+    sync::atomic::{AtomicUsize, Ordering},
+    thread,
+};
+use tensorrt_rs_sys::{device, numa};
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum RoutingPolicy {
+    // The device with the most idle contexts.
+    QueueDepth,
+    // The device with the fewest requests checked out or waiting, relative to its contexts.
+    LeastOutstanding,
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct MultiDevicePoolOptions {
+    // Devices to load the engine on; empty selects every visible device.
+    pub devices: Vec<i32>,
+    // Contexts, profiles and plan loading per device.
+    pub pool: EnginePoolOptions,
+    pub routing: RoutingPolicy,
+    // Per-device SM budgets, in place of pool.sm_budget on the device each is for.
+    pub sm_budgets: Vec<SmBudget>,
+}
+
+impl Default for MultiDevicePoolOptions {
+    fn default() -> Self {
+        Self {
+            devices: Vec::new(),
+            pool: EnginePoolOptions::default(),
+            routing: RoutingPolicy::LeastOutstanding,
+            sm_budgets: Vec::new(),
+        }
+    }
+}
+
+struct DevicePool {
+    device: i32,
+    node: Option<i32>,
+    pool: EnginePool,
+    // checked out or waiting for a checkout
+    outstanding: AtomicUsize,
+}
+
+// An EnginePool per GPU, so one process can drive every device of a node. Requests are
+// routed to a device by RoutingPolicy, and a checked-out context comes with its device's
+// primary context bound to the calling thread, so callers never manage CUDA contexts.
+pub struct MultiDevicePool {
+    devices: Vec<DevicePool>,
+    routing: RoutingPolicy,
+    // rotates ties between equally loaded devices
+    next: AtomicUsize,
+}
+
+impl MultiDevicePool {
+    // The plan is read once and deserialized on all devices in parallel. `setup` runs per
+    // context with its device and index, like EnginePool::new's.
+    pub fn new<P, F>(engine_path: &P, options: &MultiDevicePoolOptions, setup: F) -> TRTResult<Self>
+    where
+        P: AsRef<Path>,
+        F: Fn(i32, usize, &mut TRTEngine) -> TRTResult<()> + Sync,
+    {
+        let plan = PlanFile::open(engine_path, &options.pool.plan)?;
+        let pool = Self::from_bytes(plan.as_bytes(), options, setup)?;
+        plan.release()?;
+        Ok(pool)
+    }
+
+    pub fn from_bytes<F>(data: &[u8], options: &MultiDevicePoolOptions, setup: F) -> TRTResult<Self>
+    where
+        F: Fn(i32, usize, &mut TRTEngine) -> TRTResult<()> + Sync,
+    {
+        let devices = if options.devices.is_empty() {
+            (0..device::get_device_count()).collect::<Vec<_>>()
+        } else {
+            options.devices.clone()
+        };
+        if devices.is_empty() {
+            return Err(TRTError::DeviceQueryError);
+        }
+
+        let results = thread::scope(|scope| {
+            let handles = devices
+                .iter()
+                .map(|&device| {
+                    let setup = &setup;
+                    scope.spawn(move || -> TRTResult<EnginePool> {
+                        // host-side engine allocations land next to the device
+                        if let Some(node) = numa::get_device_node(device) {
+                            numa::bind_thread_to_node(node);
+                        }
+                        let ctx = CuDevice::new(device)?.retain_primary_context()?;
+                        let _guard = ctx.guard()?;
+                        let mut pool_options = options.pool.clone();
+                        if let Some(budget) = options.sm_budgets.iter().find(|budget| budget.device() == device) {
+                            pool_options.sm_budget = Some(budget.clone());
+                        }
+                        EnginePool::from_bytes(data, &pool_options, |i, engine| setup(device, i, engine))
+                    })
+                })
+                .collect::<Vec<_>>();
+            handles.into_iter().map(|handle| handle.join().unwrap()).collect::<Vec<_>>()
+        });
+
+        let mut pools = Vec::with_capacity(devices.len());
+        for (device, pool) in devices.into_iter().zip(results) {
+            pools.push(DevicePool {
+                device,
+                node: numa::get_device_node(device),
+                pool: pool?,
+                outstanding: AtomicUsize::new(0),
+            });
+        }
+        Ok(Self { devices: pools, routing: options.routing, next: AtomicUsize::new(0) })
+    }
+
+    pub fn devices(&self) -> Vec<i32> {
+        self.devices.iter().map(|entry| entry.device).collect()
+    }
+
+    pub fn pool(&self, device: i32) -> Option<&EnginePool> {
+        self.devices.iter().find(|entry| entry.device == device).map(|entry| &entry.pool)
+    }
+
+    // NUMA node closest to `device`, for placing its staging buffers and feeder threads.
+    pub fn numa_node(&self, device: i32) -> Option<i32> {
+        self.devices.iter().find(|entry| entry.device == device).and_then(|entry| entry.node)
+    }
+
+    // Pins the calling thread to the socket closest to `device`. Meant for threads that
+    // only feed that device (checkout_on); false if the node is unknown.
+    pub fn pin_current_thread(&self, device: i32) -> bool {
+        match self.numa_node(device) {
+            Some(node) => numa::bind_thread_to_node(node),
+            None => false,
+        }
+    }
+
+    // Requests checked out or waiting on `device`.
+    pub fn outstanding(&self, device: i32) -> usize {
+        match self.devices.iter().find(|entry| entry.device == device) {
+            Some(entry) => entry.outstanding.load(Ordering::Relaxed),
+            None => 0,
+        }
+    }
+
+    // Blocks until a context on the routed device is available.
+    pub fn checkout(&self) -> TRTResult<DeviceEngine<'_>> {
+        let entry = self.route();
+        let claim = Claim::new(entry);
+        let engine = entry.pool.checkout();
+        DeviceEngine::bind(entry, engine, claim)
+    }
+
+    // Like checkout, but for the tightest profile accepting `shapes` on the routed device.
+    pub fn checkout_for(&self, shapes: &HashMap<&str, &Shape>) -> TRTResult<DeviceEngine<'_>> {
+        let entry = self.route();
+        let claim = Claim::new(entry);
+        let engine = entry.pool.checkout_for(shapes)?;
+        DeviceEngine::bind(entry, engine, claim)
+    }
+
+    // An idle context on any device, trying devices in routing order.
+    pub fn try_checkout(&self) -> TRTResult<Option<DeviceEngine<'_>>> {
+        let mut order = (0..self.devices.len()).collect::<Vec<_>>();
+        let first = self.route_index();
+        order.swap(0, first);
+        for index in order {
+            let entry = &self.devices[index];
+            let claim = Claim::new(entry);
+            if let Some(engine) = entry.pool.try_checkout() {
+                return DeviceEngine::bind(entry, engine, claim).map(Some);
+            }
+        }
+        Ok(None)
+    }
+
+    // Blocks until a context on `device` is available.
+    pub fn checkout_on(&self, device: i32) -> TRTResult<DeviceEngine<'_>> {
+        let entry = match self.devices.iter().find(|entry| entry.device == device) {
+            Some(entry) => entry,
+            None => return Err(TRTError::DeviceQueryError),
+        };
+        let claim = Claim::new(entry);
+        let engine = entry.pool.checkout();
+        DeviceEngine::bind(entry, engine, claim)
+    }
+
+    fn route(&self) -> &DevicePool {
+        &self.devices[self.route_index()]
+    }
+
+    fn route_index(&self) -> usize {
+        let loads = self
+            .devices
+            .iter()
+            .map(|entry| DeviceLoad {
+                idle: entry.pool.num_idle(),
+                outstanding: entry.outstanding.load(Ordering::Relaxed),
+                capacity: entry.pool.capacity(),
+            })
+            .collect::<Vec<_>>();
+        let start = self.next.fetch_add(1, Ordering::Relaxed);
+        select_device(&loads, self.routing, start)
+    }
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+struct DeviceLoad {
+    idle: usize,
+    outstanding: usize,
+    capacity: usize,
+}
+
+// Index of the least loaded device; ties go to the first one at or after `start`.
+fn select_device(loads: &[DeviceLoad], routing: RoutingPolicy, start: usize) -> usize {
+    let mut best = start % loads.len();
+    for offset in 1..loads.len() {
+        let index = (start + offset) % loads.len();
+        let (candidate, current) = (&loads[index], &loads[best]);
+        let better = match routing {
+            RoutingPolicy::QueueDepth => candidate.idle > current.idle,
+            // outstanding / capacity, compared without dividing
+            RoutingPolicy::LeastOutstanding => {
+                candidate.outstanding * current.capacity.max(1) < current.outstanding * candidate.capacity.max(1)
+            }
+        };
+        if better {
+            best = index;
+        }
+    }
+    best
+}
+
+// Counts a request as outstanding on its device from routing until the context is returned.
+struct Claim<'a>(&'a DevicePool);
+
+impl<'a> Claim<'a> {
+    fn new(entry: &'a DevicePool) -> Self {
+        entry.outstanding.fetch_add(1, Ordering::Relaxed);
+        Self(entry)
+    }
+}
+
+impl Drop for Claim<'_> {
+    fn drop(&mut self) {
+        self.0.outstanding.fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
+// A checked-out context on one device of a MultiDevicePool. The device stays current on the
+// calling thread while the guard is held; the thread's previous device is restored on drop,
+// after the context has been returned.
+pub struct DeviceEngine<'a> {
+    engine: Option<PooledEngine<'a>>,
+    device: i32,
+    previous_device: Option<i32>,
+    _claim: Claim<'a>,
+}
+
+impl<'a> DeviceEngine<'a> {
+    fn bind(entry: &'a DevicePool, engine: PooledEngine<'a>, claim: Claim<'a>) -> TRTResult<Self> {
+        let previous_device = device::get_device();
+        if !device::set_device(entry.device) {
+            return Err(TRTError::DeviceQueryError);
+        }
+        Ok(Self { engine: Some(engine), device: entry.device, previous_device, _claim: claim })
+    }
+
+    pub fn device(&self) -> i32 {
+        self.device
+    }
+}
+
+impl Deref for DeviceEngine<'_> {
+    type Target = TRTEngine;
+
+    fn deref(&self) -> &TRTEngine {
+        self.engine.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for DeviceEngine<'_> {
+    fn deref_mut(&mut self) -> &mut TRTEngine {
+        self.engine.as_mut().unwrap()
+    }
+}
+
+impl Drop for DeviceEngine<'_> {
+    fn drop(&mut self) {
+        self.engine.take();
+        if let Some(previous) = self.previous_device {
+            if previous != self.device {
+                device::set_device(previous);
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn load(idle: usize, outstanding: usize, capacity: usize) -> DeviceLoad {
+        DeviceLoad { idle, outstanding, capacity }
+    }
+
+    #[test]
+    fn least_outstanding_is_relative_to_capacity() {
+        let loads = [load(0, 4, 4), load(2, 3, 8), load(1, 1, 2)];
+        assert_eq!(select_device(&loads, RoutingPolicy::LeastOutstanding, 0), 1);
+        assert_eq!(select_device(&loads, RoutingPolicy::QueueDepth, 0), 1);
+    }
+
+    #[test]
+    fn ties_rotate_with_start() {
+        let loads = [load(1, 0, 2), load(1, 0, 2), load(1, 0, 2)];
+        for start in 0..6 {
+            assert_eq!(select_device(&loads, RoutingPolicy::LeastOutstanding, start), start % 3);
+            assert_eq!(select_device(&loads, RoutingPolicy::QueueDepth, start), start % 3);
+        }
+    }
+}
@@ -0,0 +1,225 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{ffi::c_void, ops::Deref, ptr};
+use tensorrt_rs_sys::{
+    memory::get_pointer_device,
+    runtime::{DataType, MAX_DIMS},
+};
+
+// ABI-compatible mirrors of dlpack.h (v0.8), for handing device tensors to and from tch,
+// PyTorch, CuPy or CV libraries without a copy.
+pub const DL_CUDA: i32 = 2;
+pub const DL_CUDA_MANAGED: i32 = 13;
+
+const DL_INT: u8 = 0;
+const DL_UINT: u8 = 1;
+const DL_FLOAT: u8 = 2;
+const DL_BOOL: u8 = 6;
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct DLDevice {
+    pub device_type: i32,
+    pub device_id: i32,
+}
+
+#[repr(C)]
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct DLDataType {
+    pub code: u8,
+    pub bits: u8,
+    pub lanes: u16,
+}
+
+#[repr(C)]
+pub struct DLTensor {
+    pub data: *mut c_void,
+    pub device: DLDevice,
+    pub ndim: i32,
+    pub dtype: DLDataType,
+    pub shape: *mut i64,
+    // in elements; null means compact row-major
+    pub strides: *mut i64,
+    pub byte_offset: u64,
+}
+
+#[repr(C)]
+pub struct DLManagedTensor {
+    pub dl_tensor: DLTensor,
+    pub manager_ctx: *mut c_void,
+    pub deleter: Option<unsafe extern "C" fn(*mut DLManagedTensor)>,
+}
+
+fn to_dl_dtype(dtype: DataType) -> TRTResult<DLDataType> {
+    let (code, bits) = match dtype {
+        DataType::FLOAT => (DL_FLOAT, 32),
+        DataType::HALF => (DL_FLOAT, 16),
+        DataType::INT8 => (DL_INT, 8),
+        DataType::INT32 => (DL_INT, 32),
+        DataType::BOOL => (DL_BOOL, 8),
+        DataType::UINT8 => (DL_UINT, 8),
+        DataType::FP8 => return Err(TRTError::DLPackError("FP8 has no DLPack dtype")),
+    };
+    Ok(DLDataType { code, bits, lanes: 1 })
+}
+
+fn from_dl_dtype(dtype: DLDataType) -> TRTResult<DataType> {
+    match (dtype.code, dtype.bits, dtype.lanes) {
+        (DL_FLOAT, 32, 1) => Ok(DataType::FLOAT),
+        (DL_FLOAT, 16, 1) => Ok(DataType::HALF),
+        (DL_INT, 8, 1) => Ok(DataType::INT8),
+        (DL_INT, 32, 1) => Ok(DataType::INT32),
+        (DL_BOOL, 8, 1) => Ok(DataType::BOOL),
+        (DL_UINT, 8, 1) => Ok(DataType::UINT8),
+        _ => Err(TRTError::DLPackError("dtype not supported by TensorRT")),
+    }
+}
+
+struct ExportContext {
+    _tensor: Tensor,
+    _shape: Vec<i64>,
+    _strides: Vec<i64>,
+    managed: DLManagedTensor,
+}
+
+unsafe extern "C" fn delete_exported(managed: *mut DLManagedTensor) {
+    if !managed.is_null() {
+        drop(Box::from_raw((*managed).manager_ctx as *mut ExportContext));
+    }
+}
+
+// Hands `tensor` over to a DLPack consumer, which frees (or pools) it by calling the
+// deleter. Work queued on the tensor must be ordered before the consumer's use of it.
+pub fn to_dlpack(tensor: Tensor) -> TRTResult<*mut DLManagedTensor> {
+    let dtype = to_dl_dtype(tensor.dtype())?;
+    let data = unsafe { tensor.get_raw_ptr() };
+    let device_id = match get_pointer_device(data) {
+        Some(device) => device,
+        None => return Err(TRTError::DLPackError("not device memory")),
+    };
+    let mut shape: Vec<i64> = tensor.shape().iter().map(|&dim| dim as i64).collect();
+    let mut strides = vec![1i64; shape.len()];
+    for i in (0..shape.len().saturating_sub(1)).rev() {
+        strides[i] = strides[i + 1] * shape[i + 1];
+    }
+
+    let dl_tensor = DLTensor {
+        data: data as *mut c_void,
+        device: DLDevice { device_type: DL_CUDA, device_id },
+        ndim: shape.len() as i32,
+        dtype,
+        shape: shape.as_mut_ptr(),
+        strides: strides.as_mut_ptr(),
+        byte_offset: 0,
+    };
+    // the Vec buffers do not move when the vectors are moved into the context
+    let context = Box::new(ExportContext {
+        _tensor: tensor,
+        _shape: shape,
+        _strides: strides,
+        managed: DLManagedTensor {
+            dl_tensor,
+            manager_ctx: ptr::null_mut(),
+            deleter: Some(delete_exported),
+        },
+    });
+    let context = Box::into_raw(context);
+    unsafe {
+        (*context).managed.manager_ctx = context as *mut c_void;
+        Ok(&mut (*context).managed)
+    }
+}
+
+// A Tensor borrowing a DLPack producer's memory. The producer's deleter runs on drop.
+pub struct DLPackTensor {
+    tensor: Option<Tensor>,
+    managed: *mut DLManagedTensor,
+}
+
+unsafe impl Send for DLPackTensor {}
+
+impl DLPackTensor {
+    // Takes ownership of `managed` on success; on error it stays with the caller. Only
+    // compact row-major CUDA tensors can be bound to TensorRT. The producer's pending work
+    // must be ordered before `stream`.
+    pub unsafe fn from_raw(managed: *mut DLManagedTensor, stream: &CuStream) -> TRTResult<Self> {
+        if managed.is_null() {
+            return Err(TRTError::DLPackError("null tensor"));
+        }
+        let dl_tensor = &(*managed).dl_tensor;
+        if dl_tensor.device.device_type != DL_CUDA && dl_tensor.device.device_type != DL_CUDA_MANAGED {
+            return Err(TRTError::DLPackError("not a CUDA tensor"));
+        }
+        let dtype = from_dl_dtype(dl_tensor.dtype)?;
+        let ndim = dl_tensor.ndim.max(0) as usize;
+        if ndim > MAX_DIMS {
+            return Err(TRTError::DLPackError("too many dims"));
+        }
+
+        let dims = match ndim {
+            0 => &[][..],
+            _ => std::slice::from_raw_parts(dl_tensor.shape, ndim),
+        };
+        if dims.iter().any(|&dim| dim < 0 || dim > i32::MAX as i64) {
+            return Err(TRTError::DLPackError("dim out of range"));
+        }
+        if !dl_tensor.strides.is_null() && ndim > 0 {
+            let strides = std::slice::from_raw_parts(dl_tensor.strides, ndim);
+            let mut expected = 1i64;
+            for i in (0..ndim).rev() {
+                // strides of unit dims carry no information
+                if dims[i] != 1 && strides[i] != expected {
+                    return Err(TRTError::DLPackError("not compact row-major"));
+                }
+                expected *= dims[i];
+            }
+        }
+
+        let shape = Shape::new(&dims.iter().map(|&dim| dim as i32).collect::<Vec<_>>());
+        let ptr = dl_tensor.data as usize + dl_tensor.byte_offset as usize;
+        let tensor = Tensor::from_raw_ptr(ptr, &shape, dtype, stream);
+        Ok(Self { tensor: Some(tensor), managed })
+    }
+}
+
+impl Deref for DLPackTensor {
+    type Target = Tensor;
+
+    fn deref(&self) -> &Tensor {
+        self.tensor.as_ref().unwrap()
+    }
+}
+
+impl Drop for DLPackTensor {
+    fn drop(&mut self) {
+        // the non-owning Tensor goes first, then the producer releases the memory
+        self.tensor = None;
+        unsafe {
+            if let Some(deleter) = (*self.managed).deleter {
+                deleter(self.managed);
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn dtype_round_trip() {
+        for dtype in [DataType::FLOAT, DataType::HALF, DataType::INT8, DataType::INT32, DataType::BOOL, DataType::UINT8] {
+            assert_eq!(from_dl_dtype(to_dl_dtype(dtype).unwrap()).unwrap(), dtype);
+        }
+        assert!(to_dl_dtype(DataType::FP8).is_err());
+    }
+
+    #[test]
+    fn layout_matches_dlpack_h() {
+        assert_eq!(std::mem::size_of::<DLDataType>(), 4);
+        assert_eq!(std::mem::size_of::<DLTensor>(), 48);
+    }
+}
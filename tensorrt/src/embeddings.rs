@@ -0,0 +1,211 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    reduce::fit,
+    staging::pinned,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::collections::HashMap;
+use tensorrt_rs_sys::{
+    kernels::{cast_tensor, similarity, topk_rows},
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    runtime::DataType,
+};
+
+// Rows of the matrix added before the index first grows.
+const INITIAL_ROWS: usize = 1024;
+
+// Embeddings kept on the GPU as an FP16 [len, dim] matrix, searched by inner product next
+// to the engine producing them: an encoder's output (L2-normalized with attach_reduction,
+// for cosine similarity) is inserted or searched where it lies, and only the ids of the
+// nearest rows reach the host. Search is exhaustive, one scores matrix plus a top-k.
+pub struct EmbeddingIndex {
+    // growable, so inserts never move it
+    matrix: Tensor,
+    dim: usize,
+    // id of every row
+    ids: Vec<u64>,
+    rows: HashMap<u64, usize>,
+    // [queries, len] scores and [queries, k] results of the last search
+    scores: Option<Tensor>,
+    values: Option<Tensor>,
+    indices: Option<Tensor>,
+    host: Option<PinnedMemory>,
+}
+
+impl EmbeddingIndex {
+    // Address space for `max_len` rows is reserved up front; memory is mapped as rows are.
+    pub fn new(dim: usize, max_len: usize, stream: &CuStream) -> TRTResult<Self> {
+        if dim == 0 || dim > i32::MAX as usize {
+            return Err(TRTError::ShapeError(vec![0, dim as i32]));
+        }
+        let max_len = max_len.max(1);
+        let (capacity, reserve) = (INITIAL_ROWS.min(max_len) * dim, max_len * dim * DataType::HALF.get_elem_size());
+        let matrix = Tensor::growable(&shape(0, dim), capacity, reserve, DataType::HALF, stream)?;
+        Ok(Self {
+            matrix,
+            dim,
+            ids: Vec::new(),
+            rows: HashMap::new(),
+            scores: None,
+            values: None,
+            indices: None,
+            host: None,
+        })
+    }
+
+    // Appends the [n, dim] FLOAT or HALF `embeddings` (e.g. an engine output) as rows with
+    // the given ids, converted to FP16 on `stream`. Ids already present are rejected.
+    pub fn insert(&mut self, embeddings: &Tensor, ids: &[u64], stream: &CuStream) -> TRTResult<()> {
+        let count = self.rows_of(embeddings)?;
+        if count != ids.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let duplicate = ids.iter().enumerate().find(|&(i, id)| self.rows.contains_key(id) || ids[..i].contains(id));
+        if let Some((_, &id)) = duplicate {
+            return Err(TRTError::DuplicateEmbeddingId(id));
+        }
+        let len = self.ids.len();
+        unsafe { self.matrix.reset_shape(&shape(len + count, self.dim))? };
+        let dst = unsafe { self.matrix.get_raw_ptr() } + len * self.row_bytes();
+        let src = unsafe { embeddings.get_raw_ptr() };
+        if !unsafe { cast_tensor(src, embeddings.dtype(), dst, DataType::HALF, count * self.dim, 1.0, stream) } {
+            return Err(TRTError::KernelLaunchError);
+        }
+        for (offset, &id) in ids.iter().enumerate() {
+            self.rows.insert(id, len + offset);
+        }
+        self.ids.extend_from_slice(ids);
+        Ok(())
+    }
+
+    // Drops the row of `id` by moving the last row into its place on `stream`; false if
+    // there is none.
+    pub fn remove(&mut self, id: u64, stream: &CuStream) -> TRTResult<bool> {
+        let row = match self.rows.remove(&id) {
+            Some(row) => row,
+            None => return Ok(false),
+        };
+        let last = self.ids.len() - 1;
+        if row != last {
+            let base = unsafe { self.matrix.get_raw_ptr() };
+            let (dst, src) = (base + row * self.row_bytes(), base + last * self.row_bytes());
+            if !unsafe { memcpy_async(dst, src, self.row_bytes(), MemcpyKind::DeviceToDevice, stream) } {
+                return Err(TRTError::MemcpyError);
+            }
+            self.ids[row] = self.ids[last];
+            self.rows.insert(self.ids[row], row);
+        }
+        self.ids.pop();
+        unsafe { self.matrix.reset_shape(&shape(last, self.dim))? };
+        Ok(true)
+    }
+
+    // Enqueues the search of the [queries, dim] FLOAT or HALF `queries` on `stream` and returns
+    // the FLOAT scores and INT32 rows of each query's k best matches, [queries, k] on the
+    // device, for callers that keep going on the GPU; rows map to ids through id_of.
+    pub fn search_device(&mut self, queries: &Tensor, k: usize, stream: &CuStream) -> TRTResult<(&Tensor, &Tensor)> {
+        let num_queries = self.rows_of(queries)?;
+        let len = self.ids.len();
+        let k = k.min(len);
+        if k == 0 {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let (scores_shape, results_shape) = (shape(num_queries, len), shape(num_queries, k));
+        let scores = fit(&mut self.scores, &scores_shape, DataType::FLOAT, stream)?;
+        let values = fit(&mut self.values, &results_shape, DataType::FLOAT, stream)?;
+        let indices = fit(&mut self.indices, &results_shape, DataType::INT32, stream)?;
+        let launched = unsafe {
+            let half = queries.dtype() == DataType::HALF;
+            let (matrix, scores) = (self.matrix.get_raw_ptr(), scores.get_raw_ptr());
+            similarity(queries.get_raw_ptr(), half, num_queries, matrix, len, self.dim, scores, stream)
+                && topk_rows(scores, false, num_queries, len, k, values.get_raw_ptr(), indices.get_raw_ptr(), stream)
+        };
+        match launched {
+            true => Ok((self.values.as_ref().unwrap(), self.indices.as_ref().unwrap())),
+            false => Err(TRTError::KernelLaunchError),
+        }
+    }
+
+    // Like search_device, then reads back only the results, synchronizing `stream`: per
+    // query, up to k (id, score) pairs, best first.
+    pub fn search(&mut self, queries: &Tensor, k: usize, stream: &CuStream) -> TRTResult<Vec<Vec<(u64, f32)>>> {
+        let (values, indices) = self.search_device(queries, k, stream)?;
+        let (num_queries, k) = (values.shape()[0] as usize, values.shape()[1] as usize);
+        let (values_ptr, indices_ptr) = unsafe { (values.get_raw_ptr(), indices.get_raw_ptr()) };
+        let size = num_queries * k * 4;
+        if self.host.as_ref().map_or(true, |host| host.len() < 2 * size) {
+            self.host = Some(pinned(2 * size)?);
+        }
+        let host = self.host.as_ref().unwrap();
+        let copied = unsafe {
+            memcpy_async(host.get_raw(), values_ptr, size, MemcpyKind::DeviceToHost, stream)
+                && memcpy_async(host.get_raw() + size, indices_ptr, size, MemcpyKind::DeviceToHost, stream)
+        };
+        stream.synchronize()?;
+        if !copied {
+            return Err(TRTError::MemcpyError);
+        }
+
+        let bytes = unsafe { &host.as_slice()[..2 * size] };
+        let word = |offset: usize| bytes[offset..offset + 4].try_into().unwrap();
+        let results = (0..num_queries)
+            .map(|q| {
+                (0..k)
+                    .filter_map(|j| {
+                        let entry = (q * k + j) * 4;
+                        let row = i32::from_ne_bytes(word(size + entry));
+                        let id = *self.ids.get(usize::try_from(row).ok()?)?;
+                        Some((id, f32::from_ne_bytes(word(entry))))
+                    })
+                    .collect()
+            })
+            .collect();
+        Ok(results)
+    }
+
+    // The id of matrix row `row`, as search_device returns rows.
+    pub fn id_of(&self, row: usize) -> Option<u64> {
+        self.ids.get(row).copied()
+    }
+
+    pub fn contains(&self, id: u64) -> bool {
+        self.rows.contains_key(&id)
+    }
+
+    pub fn len(&self) -> usize {
+        self.ids.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.ids.is_empty()
+    }
+
+    pub fn dim(&self) -> usize {
+        self.dim
+    }
+
+    // The FP16 [len, dim] matrix, e.g. to save it.
+    pub fn matrix(&self) -> &Tensor {
+        &self.matrix
+    }
+
+    fn row_bytes(&self) -> usize {
+        self.dim * DataType::HALF.get_elem_size()
+    }
+
+    // Rows of a [.., dim] FLOAT or HALF tensor.
+    fn rows_of(&self, tensor: &Tensor) -> TRTResult<usize> {
+        if tensor.dtype() != DataType::FLOAT && tensor.dtype() != DataType::HALF {
+            return Err(TRTError::DTypeMismatch);
+        }
+        match tensor.shape().as_slice().split_last() {
+            Some((&dim, rows)) if dim as usize == self.dim => Ok(rows.iter().map(|&dim| dim as usize).product()),
+            _ => Err(TRTError::ShapeError(tensor.shape().to_vec())),
+        }
+    }
+}
+
+fn shape(rows: usize, cols: usize) -> Shape {
+    Shape::new(&[rows as i32, cols as i32])
+}
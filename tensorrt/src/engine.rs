@@ -1,71 +1,2982 @@
 use crate::{
+    accounting::{EngineMemoryUsage, MemoryCategory, MemoryReservation},
+    arena::DeviceMemoryArena,
+    aux_streams::AuxStreams,
+    bucket::{pad_into, BucketPolicy},
+    completion::{StreamCompletion, WaitStrategy},
+    compressed::CompressedPlanReader,
     error::{TRTError, TRTResult},
-    tensor::{Shape, Tensor},
+    graph::{GraphCache, GraphKey},
+    l2::{self, L2Window},
+    layout::TensorLayout,
+    lease::{OutputLease, OutputRing},
+    metrics::{EngineMetrics, InferenceTiming, Instrumentation, MetricsRegistry},
+    nvtx::{self, Category},
+    output::GrowableOutput,
+    plan::{PlanCompatibility, PlanFile, PlanLoadOptions},
+    priority::{PriorityClass, PriorityLane},
+    profile::{ProfileSelector, ProfileShape},
+    readback::{Readback, ReadbackPool},
+    reduce::{OutputReduction, ReducedOutput},
+    refit::NamedWeights,
+    runtime::SharedRuntime,
+    schema::IoSchema,
+    shapes::ShapeTracker,
+    shared::SharedEngine,
+    slot::{IoSlot, SlotBinding},
+    sm_budget::SmBudget,
+    spans::{OpenSpan, SpanTracer, SpanValue, Stage, Timeline, TraceContext},
+    startup::{StartupPhase, StartupTimings},
+    state::StateSession,
+    tensor::{IoMemory, Shape, Tensor},
+    trace::{TraceRecorder, TracedRequest},
+    typed::{TrtElement, TypedBinding, TypedSlot},
+    warmup::WarmupRun,
+    weight_streaming::{self, WeightStreamingBudget},
 };
-use cuda_rs::stream::CuStream;
+use cuda_rs::{memory::DeviceMemory, stream::CuStream};
 use tensorrt_rs_sys::{
-    runtime::{Runtime, CudaEngine, ExecutionContext},
-    logger::Severity,
+    allocator::DeviceAllocator,
+    builder::HostMemory,
+    device::{self, PrimaryContext},
+    error_recorder::{ErrorRecorder, RecordedError},
+    runtime::{
+        BindingError, BindingStatus, CudaEngine, DataType, EngineInspector, ExecutionContext,
+        HardwareCompatibilityLevel, LayerInformationFormat, OptProfileSelector, Runtime, TensorBinding, TensorDims,
+        TensorHandle, TensorIOMode, MAX_DIMS,
+    },
+    logger::{AsyncOverflowPolicy, Severity},
+    profiler::LayerProfiler,
+    refitter::Refitter,
+    memory::{memcpy_async, HostMemoryKind, MemcpyKind, PinnedMemory},
+    stream::{get_stream_priority_range, CudaEvent, CudaStatus},
 };
-use std::{collections::HashMap, fs, path::Path};
+use std::{
+    collections::HashMap,
+    io::Read,
+    path::Path,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc, Mutex, RwLock, RwLockReadGuard,
+    },
+    time::{Duration, Instant},
+};
+
+struct CountingReader<R> {
+    inner: R,
+    read: Arc<AtomicUsize>,
+}
+
+impl<R: Read> Read for CountingReader<R> {
+    fn read(&mut self, buf: &mut [u8]) -> std::io::Result<usize> {
+        let read = self.inner.read(buf)?;
+        self.read.fetch_add(read, Ordering::Relaxed);
+        Ok(read)
+    }
+}
+
+// ids of EngineCore, never reused
+static NEXT_CORE_ID: AtomicU64 = AtomicU64::new(0);
+
+// A deserialized engine and the runtime that must outlive it, shared by every context
+// created from it (see EnginePool and SharedEngine). Queries and context creation take the
+// engine's read lock; only refit and the weight streaming budget take the write lock.
+pub(crate) struct EngineCore {
+    // declared first so the engine is destroyed before its runtime
+    engine: RwLock<CudaEngine>,
+    runtime: Arc<Mutex<Runtime>>,
+    // deserialized through a SharedRuntime, whose logger and recorder other engines use too
+    shared_runtime: bool,
+    weights: MemoryReservation,
+    // unique among the cores of the process, unlike its address once it is freed
+    id: u64,
+    // bumped by every refit
+    generation: AtomicU64,
+    dla_core: Option<i32>,
+    // installed on the runtime and engine for the errors outside any context; every context
+    // has its own (see TRTEngine::bind_error_recorder)
+    recorder: Arc<ErrorRecorder>,
+    schema: IoSchema,
+    // runtime creation and deserialization, copied into the engine that deserialized it
+    startup: StartupTimings,
+    // the primary context the engine was deserialized in, retained until everything else is
+    // destroyed
+    context: PrimaryContext,
+}
+
+impl EngineCore {
+    // `dla_core` is the DLA core the engine's DLA layers are loaded onto.
+    pub(crate) fn from_bytes(
+        data: &[u8],
+        max_threads: Option<i32>,
+        dla_core: Option<i32>,
+        compatibility: &PlanCompatibility,
+    ) -> TRTResult<Arc<Self>> {
+        let started = Instant::now();
+        let runtime = Self::create_runtime(max_threads, dla_core, compatibility)?;
+        let mut startup = StartupTimings::default();
+        startup.record(StartupPhase::RuntimeCreation, started.elapsed());
+        Self::deserialize(Arc::new(Mutex::new(runtime)), false, data, dla_core, startup)
+    }
+
+    // Deserializes through `runtime` instead of a runtime of the engine's own.
+    pub(crate) fn from_bytes_shared(data: &[u8], runtime: &SharedRuntime) -> TRTResult<Arc<Self>> {
+        Self::deserialize(runtime.handle(), true, data, None, StartupTimings::default())
+    }
+
+    fn deserialize(
+        runtime: Arc<Mutex<Runtime>>,
+        shared: bool,
+        data: &[u8],
+        dla_core: Option<i32>,
+        mut startup: StartupTimings,
+    ) -> TRTResult<Arc<Self>> {
+        // the plan size stands in for the weights it holds
+        let weights = MemoryReservation::new(MemoryCategory::Weights, data.len())?;
+        let started = Instant::now();
+        let engine = match runtime.lock().unwrap().deserialize(data) {
+            Some(engine) => engine,
+            None => return Err(TRTError::EngineDeserializationError),
+        };
+        startup.record(StartupPhase::Deserialize, started.elapsed());
+
+        Self::new(runtime, shared, engine, weights, dla_core, startup)
+    }
+
+    pub(crate) fn create_runtime(
+        max_threads: Option<i32>,
+        dla_core: Option<i32>,
+        compatibility: &PlanCompatibility,
+    ) -> TRTResult<Runtime> {
+        let mut runtime = match Runtime::new() {
+            Some(runtime) => runtime,
+            None => return Err(TRTError::RuntimeCreationError),
+        };
+        // first, since the lean runtime starts from its own defaults
+        if let Some(path) = &compatibility.lean_runtime {
+            if !runtime.load_lean_runtime(&path.to_string_lossy()) {
+                return Err(TRTError::LeanRuntimeLoadError(path.clone()));
+            }
+        }
+        runtime.set_engine_host_code_allowed(compatibility.allow_host_code);
+        if let Some(dir) = &compatibility.temporary_directory {
+            runtime.set_temporary_directory(&dir.to_string_lossy());
+        }
+        if let Some(max_threads) = max_threads {
+            if !runtime.set_max_threads(max_threads) {
+                return Err(TRTError::RuntimeCreationError);
+            }
+        }
+        if let Some(core) = dla_core {
+            if core < 0 || core >= runtime.get_nb_dla_cores() {
+                return Err(TRTError::DlaCoreError(core));
+            }
+            runtime.set_dla_core(core);
+        }
+        Ok(runtime)
+    }
+
+    fn new(
+        runtime: Arc<Mutex<Runtime>>,
+        shared: bool,
+        mut engine: CudaEngine,
+        weights: MemoryReservation,
+        dla_core: Option<i32>,
+        startup: StartupTimings,
+    ) -> TRTResult<Arc<Self>> {
+        let context = match PrimaryContext::current() {
+            Some(context) => context,
+            None => return Err(TRTError::DeviceQueryError),
+        };
+        Self::check_hardware_compatibility(&engine, context.device())?;
+        let recorder = Arc::new(ErrorRecorder::default());
+        // every engine logs under its own name and level, unless its runtime is shared
+        if !shared {
+            let mut runtime = runtime.lock().unwrap();
+            if !engine.get_name().is_empty() {
+                runtime.logger().set_name(engine.get_name());
+            }
+            runtime.set_error_recorder(&recorder);
+        }
+        engine.set_error_recorder(&recorder);
+        let schema = IoSchema::from_engine(&engine);
+        Ok(Arc::new(Self {
+            engine: RwLock::new(engine),
+            runtime,
+            shared_runtime: shared,
+            weights,
+            id: NEXT_CORE_ID.fetch_add(1, Ordering::Relaxed),
+            generation: AtomicU64::new(0),
+            dla_core,
+            recorder,
+            schema,
+            startup,
+            context,
+        }))
+    }
+
+    // Checked here rather than left to the first launch, so that a plan shipped to a node it
+    // cannot run on fails to load with the reason.
+    fn check_hardware_compatibility(engine: &CudaEngine, device: i32) -> TRTResult<()> {
+        let capability = match device::get_compute_capability(device) {
+            Some(capability) => capability,
+            None => return Err(TRTError::DeviceQueryError),
+        };
+        match engine.get_hardware_compatibility_level() {
+            HardwareCompatibilityLevel::AMPEREPLUS if capability < 80 => {
+                Err(TRTError::IncompatiblePlan(format!("plan requires Ampere or newer, device is sm_{}", capability)))
+            }
+            _ => Ok(()),
+        }
+    }
+
+    pub(crate) fn engine(&self) -> RwLockReadGuard<'_, CudaEngine> {
+        self.engine.read().unwrap()
+    }
+
+    pub(crate) fn make_current(&self) -> TRTResult<()> {
+        match self.context.make_current() {
+            true => Ok(()),
+            false => Err(TRTError::DeviceQueryError),
+        }
+    }
+
+    pub(crate) fn schema(&self) -> &IoSchema {
+        &self.schema
+    }
+
+    pub(crate) fn weights(&self) -> usize {
+        self.weights.bytes()
+    }
+
+    pub(crate) fn id(&self) -> u64 {
+        self.id
+    }
+
+    // Changes whenever the weights do, e.g. to invalidate results computed with older ones.
+    pub(crate) fn generation(&self) -> u64 {
+        self.generation.load(Ordering::Acquire)
+    }
+}
+
+impl Drop for EngineCore {
+    // before the fields, so the engine is destroyed in its own context on any thread
+    fn drop(&mut self) {
+        self.context.make_current();
+    }
+}
+
+pub struct TRTEngine {
+    core: Option<Arc<EngineCore>>,
+    context: Option<ExecutionContext>,
+    // the context's own activation memory
+    context_memory: MemoryReservation,
+    // that memory when sized for the context's profile, see activate_for_profile
+    scratch: Option<DeviceMemory>,
+    stream: CuStream,
+    tensors: HashMap<String, Tensor>,
+    // where allocate_io_tensors puts `tensors`
+    io_memory: IoMemory,
+    handles: HashMap<String, TensorHandle>,
+    layouts: HashMap<String, TensorLayout>,
+    // engine-owned buffers by IO index, for the IoSlot path
+    slots: Vec<SlotBinding>,
+    arena: Option<Arc<DeviceMemoryArena>>,
+    graphs: Option<GraphCache>,
+    dynamic_outputs: HashMap<String, GrowableOutput>,
+    // outputs read back reduced, see attach_reduction
+    reductions: HashMap<String, ReducedOutput>,
+    input_names: Vec<String>,
+    output_names: Vec<String>,
+    // aligned with output_names
+    output_handles: Vec<TensorHandle>,
+    // every IO tensor has a static shape; see is_static
+    static_shapes: bool,
+    // IO tensors other than shape tensors are host-located, which TensorRT reads and writes
+    // on the host as it enqueues
+    host_io: bool,
+    // a profiler is attached with set_profiler; its enqueues bypass captured graphs, which
+    // would not report them
+    profiled: bool,
+    // input shapes applied to the context and output shapes inferred from them
+    shapes: ShapeTracker,
+    input_consumed: Option<CudaEvent>,
+    profile_selector: Option<ProfileSelector>,
+    bucket_policies: HashMap<String, BucketPolicy>,
+    valid_shapes: HashMap<String, Shape>,
+    // per-input quantization scales when inputs are cast on bind
+    cast_scales: Option<HashMap<String, f32>>,
+    // declared after the context, which may still reference them on drop
+    aux_streams: Option<Arc<AuxStreams>>,
+    aux_priority: i32,
+    // priority streams enqueues have been forked onto, and the one in use
+    lanes: Vec<PriorityLane>,
+    lane: Option<usize>,
+    // the SMs the lanes' streams are confined to
+    sm_budget: Option<SmBudget>,
+    instrumentation: Option<Instrumentation>,
+    trace: Option<Arc<TraceRecorder>>,
+    spans: Option<Arc<SpanTracer>>,
+    // the trace of the calls' spans, see set_span_parent
+    span_parent: Option<TraceContext>,
+    faults: FaultHandling,
+    sampling: Option<ProfileSampling>,
+    startup: StartupTimings,
+}
+
+// Attribution of and recovery from failed requests, and how their completion is waited
+// for; see recover and synchronize_checked.
+#[derive(Default)]
+struct FaultHandling {
+    recorder: Option<Arc<ErrorRecorder>>,
+    auto_recover: bool,
+    recoveries: u64,
+    // recorded by record_completion, of the kind `wait` needs
+    completion: Option<CudaEvent>,
+    wait: WaitStrategy,
+}
+
+// One request in every `every` run with `profiler` attached; see set_profile_sampling.
+struct ProfileSampling {
+    profiler: Arc<LayerProfiler>,
+    every: u64,
+    requests: u64,
+    profiled: u64,
+}
+
+impl TRTEngine {
+    pub fn new<P: AsRef<Path>>(engine_path: &P, stream: &CuStream) -> TRTResult<Self> {
+        Self::with_options(engine_path, &PlanLoadOptions::default(), stream)
+    }
+
+    pub fn with_options<P: AsRef<Path>>(
+        engine_path: &P,
+        options: &PlanLoadOptions,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        let started = Instant::now();
+        let plan = PlanFile::open(engine_path, options)?;
+        let read = started.elapsed();
+        let mut engine = Self::from_plan(&plan, stream)?;
+        plan.release()?;
+        engine.record_startup(StartupPhase::PlanRead, read);
+        Ok(engine)
+    }
+
+    pub fn from_plan(plan: &PlanFile, stream: &CuStream) -> TRTResult<Self> {
+        Self::from_bytes(plan.as_bytes(), stream)
+    }
+
+    pub fn from_bytes(data: &[u8], stream: &CuStream) -> TRTResult<Self> {
+        Self::from_bytes_with_threads(data, stream, None)
+    }
+
+    // `max_threads` caps the threads TensorRT itself may use (IRuntime::setMaxThreads), e.g.
+    // when many engines are deserialized at once.
+    pub fn from_bytes_with_threads(
+        data: &[u8],
+        stream: &CuStream,
+        max_threads: Option<i32>,
+    ) -> TRTResult<Self> {
+        Ok(Self::loaded(EngineCore::from_bytes(data, max_threads, None, &PlanCompatibility::default())?, stream))
+    }
+
+    // A plan built to run on other GPUs or TensorRT versions than the builder's, loaded as
+    // `compatibility` allows; see PlanCompatibility.
+    pub fn from_bytes_compatible(data: &[u8], stream: &CuStream, compatibility: &PlanCompatibility) -> TRTResult<Self> {
+        Self::from_bytes_on(data, stream, None, None, compatibility)
+    }
+
+    // Deserializes an engine built for DLA (BuildOptions::dla_core) onto DLA core `core`,
+    // which may differ from the core it was built for, e.g. to spread replicas over both
+    // cores of an Orin. Layers that fell back to the GPU still run on the current device.
+    pub fn from_bytes_on_dla(data: &[u8], stream: &CuStream, core: i32) -> TRTResult<Self> {
+        Self::from_bytes_on(data, stream, None, Some(core), &PlanCompatibility::default())
+    }
+
+    // Deserializes through `runtime`, shared with the other engines loaded through it, rather
+    // than creating a runtime (and logger) of its own; see SharedRuntime.
+    pub fn from_bytes_shared(data: &[u8], stream: &CuStream, runtime: &SharedRuntime) -> TRTResult<Self> {
+        Ok(Self::loaded(EngineCore::from_bytes_shared(data, runtime)?, stream))
+    }
+
+    pub(crate) fn from_bytes_on(
+        data: &[u8],
+        stream: &CuStream,
+        max_threads: Option<i32>,
+        dla_core: Option<i32>,
+        compatibility: &PlanCompatibility,
+    ) -> TRTResult<Self> {
+        Ok(Self::loaded(EngineCore::from_bytes(data, max_threads, dla_core, compatibility)?, stream))
+    }
+
+    // DLA core the engine was deserialized onto, None for GPU-only loads.
+    pub fn get_dla_core(&self) -> Option<i32> {
+        self.core.as_ref()?.dla_core
+    }
+
+    // Whether the engine was deserialized through a SharedRuntime, whose logger the logging
+    // settings of this engine then change for every engine sharing it.
+    pub fn shares_runtime(&self) -> bool {
+        self.core.as_ref().map_or(false, |core| core.shared_runtime)
+    }
+
+    // Deserializes while the plan is still being read, e.g. from a download or a
+    // decrypting reader, without holding the whole plan in host memory.
+    pub fn from_reader<R: Read + 'static>(reader: R, stream: &CuStream) -> TRTResult<Self> {
+        Self::from_reader_on(reader, stream, None, None, &PlanCompatibility::default())
+    }
+
+    pub(crate) fn from_reader_on<R: Read + 'static>(
+        reader: R,
+        stream: &CuStream,
+        max_threads: Option<i32>,
+        dla_core: Option<i32>,
+        compatibility: &PlanCompatibility,
+    ) -> TRTResult<Self> {
+        let started = Instant::now();
+        let runtime = EngineCore::create_runtime(max_threads, dla_core, compatibility)?;
+        let mut startup = StartupTimings::default();
+        startup.record(StartupPhase::RuntimeCreation, started.elapsed());
+        Self::from_reader_with(reader, stream, Arc::new(Mutex::new(runtime)), false, dla_core, startup)
+    }
+
+    // Like from_reader, through `runtime`.
+    pub fn from_reader_shared<R: Read + 'static>(
+        reader: R,
+        stream: &CuStream,
+        runtime: &SharedRuntime,
+    ) -> TRTResult<Self> {
+        Self::from_reader_with(reader, stream, runtime.handle(), true, None, StartupTimings::default())
+    }
+
+    fn from_reader_with<R: Read + 'static>(
+        reader: R,
+        stream: &CuStream,
+        runtime: Arc<Mutex<Runtime>>,
+        shared: bool,
+        dla_core: Option<i32>,
+        mut startup: StartupTimings,
+    ) -> TRTResult<Self> {
+        // the size is only known once read, so the budget is checked after deserialization
+        let read = Arc::new(AtomicUsize::new(0));
+        let reader = CountingReader { inner: reader, read: read.clone() };
+        let started = Instant::now();
+        let engine = match runtime.lock().unwrap().deserialize_from_reader(reader) {
+            Some(engine) => engine,
+            None => return Err(TRTError::EngineDeserializationError),
+        };
+        startup.record(StartupPhase::Deserialize, started.elapsed());
+        let weights = MemoryReservation::new(MemoryCategory::Weights, read.load(Ordering::Relaxed))?;
+
+        Ok(Self::loaded(EngineCore::new(runtime, shared, engine, weights, dla_core, startup)?, stream))
+    }
+
+    // A plan written by compress_plan (or any zstd-compressed plan), decompressed by
+    // `num_workers` threads as TensorRT reads it.
+    pub fn from_compressed<P: AsRef<Path>>(engine_path: &P, stream: &CuStream, num_workers: usize) -> TRTResult<Self> {
+        Self::from_reader(CompressedPlanReader::open(engine_path, num_workers)?, stream)
+    }
+
+    // An engine over a core it deserialized itself, which inherits the core's startup timings.
+    fn loaded(core: Arc<EngineCore>, stream: &CuStream) -> Self {
+        let startup = core.startup.clone();
+        let mut engine = Self::from_core(core, stream);
+        engine.startup = startup;
+        engine
+    }
+
+    pub(crate) fn from_core(core: Arc<EngineCore>, stream: &CuStream) -> Self {
+        Self {
+            core: Some(core),
+            context: None,
+            context_memory: MemoryReservation::none(MemoryCategory::Context),
+            scratch: None,
+            stream: stream.clone(),
+            tensors: HashMap::new(),
+            io_memory: IoMemory::for_current_device(),
+            handles: HashMap::new(),
+            layouts: HashMap::new(),
+            slots: Vec::new(),
+            arena: None,
+            graphs: None,
+            dynamic_outputs: HashMap::new(),
+            reductions: HashMap::new(),
+            input_names: Vec::new(),
+            output_names: Vec::new(),
+            output_handles: Vec::new(),
+            static_shapes: false,
+            host_io: false,
+            profiled: false,
+            shapes: ShapeTracker::default(),
+            input_consumed: None,
+            profile_selector: None,
+            bucket_policies: HashMap::new(),
+            valid_shapes: HashMap::new(),
+            cast_scales: None,
+            aux_streams: None,
+            aux_priority: 0,
+            lanes: Vec::new(),
+            lane: None,
+            sm_budget: None,
+            instrumentation: None,
+            trace: None,
+            spans: None,
+            span_parent: None,
+            faults: FaultHandling::default(),
+            sampling: None,
+            startup: StartupTimings::default(),
+        }
+    }
+
+    pub(crate) fn core(&self) -> TRTResult<Arc<EngineCore>> {
+        match self.core.as_ref() {
+            Some(core) => Ok(core.clone()),
+            None => Err(TRTError::EngineCreationError),
+        }
+    }
+
+    // Binds the primary context the engine was created in to the calling thread, unless it is
+    // current already, and leaves it bound. Everything that allocates or enqueues does this
+    // first, so engines can be used from any thread without binding a context per call.
+    pub fn make_current(&self) -> TRTResult<()> {
+        match self.core.as_ref() {
+            Some(core) => core.make_current(),
+            None => Err(TRTError::EngineCreationError),
+        }
+    }
+
+    // The device the engine was created on.
+    pub fn device(&self) -> TRTResult<i32> {
+        Ok(self.core()?.context.device())
+    }
+
+    // A handle on this engine's deserialized engine, for other threads to create their own
+    // contexts from without deserializing the plan again.
+    pub fn share(&self) -> TRTResult<SharedEngine> {
+        Ok(SharedEngine::from_core(self.core()?))
+    }
+
+    pub fn get_device_memory_size(&self) -> TRTResult<usize> {
+        let core = self.core()?;
+        let engine = core.engine();
+        Ok(engine.get_device_memory_size())
+    }
+
+    // The scratch of a context bound to `profile`, which for small profiles is far below
+    // get_device_memory_size, the largest over all profiles. Before TensorRT 10.1 contexts
+    // cannot be given less, and this is get_device_memory_size for every profile.
+    pub fn get_device_memory_size_for_profile(&self, profile: i32) -> TRTResult<usize> {
+        let core = self.core()?;
+        let engine = core.engine();
+        match engine.get_device_memory_size_for_profile(profile) {
+            Some(size) => Ok(size),
+            None => Err(TRTError::ProfileError(profile)),
+        }
+    }
+
+    // Keeps `budget` of the streamable weights resident and streams the rest, so engines
+    // larger than the free device memory still run. Call before activate: the budget only
+    // applies to execution contexts created afterwards. Returns the bytes kept resident.
+    pub fn set_weight_streaming_budget(&mut self, budget: WeightStreamingBudget) -> TRTResult<usize> {
+        self.apply_weight_streaming(budget, 1)
+    }
+
+    pub(crate) fn apply_weight_streaming(&mut self, budget: WeightStreamingBudget, contexts: usize) -> TRTResult<usize> {
+        let core = self.core()?;
+        let mut engine = core.engine.write().unwrap();
+        weight_streaming::apply(&mut engine, budget, contexts)
+    }
+
+    pub fn get_weight_streaming_budget(&self) -> TRTResult<usize> {
+        let core = self.core()?;
+        let engine = core.engine();
+        Ok(engine.get_weight_streaming_budget())
+    }
+
+    pub fn get_streamable_weights_size(&self) -> TRTResult<usize> {
+        let core = self.core()?;
+        let engine = core.engine();
+        Ok(engine.get_streamable_weights_size())
+    }
+
+    // Device memory held by this engine and its context, by category.
+    pub fn memory_usage(&self) -> TRTResult<EngineMemoryUsage> {
+        let core = self.core()?;
+        let io_tensors = self
+            .tensors
+            .iter()
+            .filter(|(name, _)| !self.dynamic_outputs.contains_key(*name))
+            .map(|(_, tensor)| tensor.capacity() * tensor.dtype().get_elem_size())
+            .sum();
+        Ok(EngineMemoryUsage {
+            weights: core.weights(),
+            context: self.context_memory.bytes(),
+            io_tensors,
+            outputs: self.dynamic_output_capacity(),
+        })
+    }
+
+    pub fn get_num_layers(&self) -> TRTResult<i32> {
+        let core = self.core()?;
+        let engine = core.engine();
+        Ok(engine.get_num_layers())
+    }
+
+    // Names of the weights refit can replace; empty unless the engine was built refittable.
+    pub fn get_refittable_weights(&self) -> TRTResult<Vec<String>> {
+        let core = self.core()?;
+        let mut engine = core.engine.write().unwrap();
+        if !engine.is_refittable() {
+            return Ok(Vec::new());
+        }
+        let mut runtime = core.runtime.lock().unwrap();
+        match Refitter::new(&mut engine, runtime.logger()) {
+            Some(refitter) => Ok(refitter.get_all_weights()),
+            None => Err(TRTError::RefitError("refitter creation failed".to_string())),
+        }
+    }
+
+    // Replaces engine weights in place, e.g. to roll out a fine-tuned checkpoint of the same
+    // architecture without deserializing a new plan. Contexts, IO buffers and captured graphs
+    // stay valid. Must run between requests: work already queued on `stream` is ordered
+    // before the refit, and other contexts of a shared engine (EnginePool) have to be
+    // drained by the caller. Returns once the weight memory is no longer read.
+    pub fn refit(&mut self, weights: &[NamedWeights], stream: Option<&CuStream>) -> TRTResult<()> {
+        let core = self.core()?;
+        core.make_current()?;
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let mut engine = core.engine.write().unwrap();
+        if !engine.is_refittable() {
+            return Err(TRTError::RefitError("engine is not refittable".to_string()));
+        }
+        let mut runtime = core.runtime.lock().unwrap();
+        let mut refitter = match Refitter::new(&mut engine, runtime.logger()) {
+            Some(refitter) => refitter,
+            None => return Err(TRTError::RefitError("refitter creation failed".to_string())),
+        };
+
+        for weights in weights {
+            let staged = unsafe {
+                refitter.set_named_weights(weights.name, weights.dtype, weights.ptr, weights.count, weights.on_device)
+            };
+            if !staged {
+                return Err(TRTError::RefitError(weights.name.to_string()));
+            }
+        }
+        let missing = refitter.get_missing_weights();
+        if !missing.is_empty() {
+            return Err(TRTError::RefitError(format!("missing weights: {}", missing.join(", "))));
+        }
+        if !refitter.refit(stream) {
+            runtime.logger().replay_captured();
+            return Err(TRTError::RefitError("refit failed".to_string()));
+        }
+        core.generation.fetch_add(1, Ordering::AcqRel);
+        // the weights are borrowed until the refit has run on the stream
+        stream.synchronize()?;
+        Ok(())
+    }
+
+    // The plan of the engine with its current weights, refits included; see
+    // EngineCache::store to persist it.
+    pub fn serialize(&self) -> TRTResult<HostMemory> {
+        let core = self.core()?;
+        let engine = core.engine();
+        match engine.serialize() {
+            Some(plan) => Ok(plan),
+            None => Err(TRTError::EngineSerializationError),
+        }
+    }
+
+    // Whole-engine layer/tactic report, for the current input shapes if a context is active.
+    pub fn get_engine_information(&self, format: LayerInformationFormat) -> TRTResult<String> {
+        self.inspect(|inspector| inspector.get_engine_information(format))
+    }
+
+    pub fn get_layer_information(&self, layer: i32, format: LayerInformationFormat) -> TRTResult<String> {
+        self.inspect(|inspector| inspector.get_layer_information(layer, format))
+    }
+
+    fn inspect<F: FnOnce(&EngineInspector) -> String>(&self, f: F) -> TRTResult<String> {
+        let core = self.core()?;
+        let engine = core.engine();
+        let mut inspector = match engine.create_engine_inspector() {
+            Some(inspector) => inspector,
+            None => return Err(TRTError::InspectorCreationError),
+        };
+        if let Some(context) = self.context.as_ref() {
+            if !inspector.set_execution_context(context) {
+                return Err(TRTError::InspectorCreationError);
+            }
+        }
+        Ok(f(&inspector))
+    }
+
+    pub fn activate(&mut self) -> TRTResult<()> {
+        self.timed_activation(Self::replace_context)
+    }
+
+    // Like activate, with the context's scratch sized for `profile` alone instead of the
+    // largest profile, e.g. for contexts dedicated to small-batch latency: they would
+    // otherwise each hold the scratch of the largest batch. Switching the context to a
+    // profile needing more grows it. Before TensorRT 10.1 the scratch is that of activate,
+    // see get_device_memory_size_for_profile.
+    pub fn activate_for_profile(&mut self, profile: i32) -> TRTResult<()> {
+        self.timed_activation(|engine| engine.replace_context_for_profile(profile))
+    }
+
+    // Creates the execution context without its own scratch memory and binds it to the
+    // shared arena instead. Only engines that never run concurrently may share an arena.
+    pub fn activate_with_arena(&mut self, arena: &Arc<DeviceMemoryArena>) -> TRTResult<()> {
+        self.timed_activation(|engine| engine.attach_arena(arena, None))
+    }
+
+    // Like activate_with_arena, for an arena that need only hold `profile`'s scratch, e.g.
+    // one sized with DeviceMemoryArena::for_profiles.
+    pub fn activate_with_arena_for_profile(&mut self, arena: &Arc<DeviceMemoryArena>, profile: i32) -> TRTResult<()> {
+        self.timed_activation(|engine| engine.attach_arena(arena, Some(profile)))
+    }
+
+    // The activations above count towards the ContextCreation startup phase; those of
+    // recover do not, so recoveries do not add to the engine's startup time.
+    fn timed_activation<F: FnOnce(&mut Self) -> TRTResult<()>>(&mut self, activation: F) -> TRTResult<()> {
+        let started = Instant::now();
+        activation(self)?;
+        self.record_startup(StartupPhase::ContextCreation, started.elapsed());
+        Ok(())
+    }
+
+    fn replace_context(&mut self) -> TRTResult<()> {
+        let core = self.core()?;
+        core.make_current()?;
+        let engine = core.engine();
+
+        // replaces the reservation of the context being replaced rather than adding to it
+        self.context_memory = MemoryReservation::none(MemoryCategory::Context);
+        let context_memory = MemoryReservation::new(MemoryCategory::Context, engine.get_device_memory_size())?;
+        self.context = match engine.create_execution_context() {
+            Some(context) => Some(context),
+            None => return Err(TRTError::ExecutionContextCreationError),
+        };
+        self.context_memory = context_memory;
+        self.scratch = None;
+        self.arena = None;
+        self.input_consumed = None;
+        self.profiled = false;
+        self.static_shapes = false;
+        self.shapes = ShapeTracker::default();
+        self.clear_cuda_graphs();
+        self.bind_aux_streams(&engine)?;
+        self.bind_error_recorder();
+        Ok(())
+    }
+
+    fn replace_context_for_profile(&mut self, profile: i32) -> TRTResult<()> {
+        let required = self.get_device_memory_size_for_profile(profile)?;
+        let core = self.core()?;
+        core.make_current()?;
+
+        // the engine lock is released before the scratch is allocated, so a refit of the
+        // shared engine does not wait on cudaMalloc
+        self.context = Some(self.create_context_for_profile(&core.engine(), profile)?);
+        self.context_memory = MemoryReservation::none(MemoryCategory::Context);
+        self.scratch = None;
+        self.bind_scratch(required)?;
+        self.arena = None;
+        self.input_consumed = None;
+        self.profiled = false;
+        self.static_shapes = false;
+        self.shapes = ShapeTracker::default();
+        self.clear_cuda_graphs();
+        self.bind_aux_streams(&core.engine())?;
+        self.bind_error_recorder();
+        Ok(())
+    }
+
+    // A context without device memory, switched to `profile` before any is set, since the
+    // memory set must hold the current profile's scratch.
+    fn create_context_for_profile(&self, engine: &CudaEngine, profile: i32) -> TRTResult<ExecutionContext> {
+        let mut context = match engine.create_execution_context_without_device_memory() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextCreationError),
+        };
+        if profile != 0 && !context.set_optimization_profile_async(profile, &self.stream) {
+            return Err(TRTError::ProfileError(profile));
+        }
+        Ok(context)
+    }
+
+    // Points the context at `size` bytes of scratch of its own. The previous block is freed
+    // in stream order, after the work already queued on it, so the graphs captured with its
+    // address are dropped.
+    fn bind_scratch(&mut self, size: usize) -> TRTResult<()> {
+        let reservation = MemoryReservation::new(MemoryCategory::Context, size)?;
+        // cuMemAlloc rejects zero-sized allocations
+        let scratch = DeviceMemory::new(size.max(1), &self.stream)?;
+        match self.context.as_mut() {
+            Some(context) => context.set_device_memory_v2(scratch.get_raw() as usize, size),
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        }
+        self.scratch = Some(scratch);
+        self.context_memory = reservation;
+        self.clear_cuda_graphs();
+        Ok(())
+    }
+
+    // Profile-sized scratch of its own (activate_for_profile) or in an arena
+    // (activate_with_arena_for_profile) that holds `profile`'s, grown if it is the former.
+    fn fit_scratch(&mut self, profile: i32) -> TRTResult<()> {
+        if self.scratch.is_none() && self.arena.is_none() {
+            return Ok(());
+        }
+        let required = self.get_device_memory_size_for_profile(profile)?;
+        match self.arena.as_ref().map(|arena| arena.size()) {
+            Some(size) if size < required => Err(TRTError::ArenaTooSmall(required, size)),
+            Some(_) => Ok(()),
+            None if self.context_memory.bytes() < required => self.bind_scratch(required),
+            None => Ok(()),
+        }
+    }
+
+    fn attach_arena(&mut self, arena: &Arc<DeviceMemoryArena>, profile: Option<i32>) -> TRTResult<()> {
+        let required = match profile {
+            Some(profile) => self.get_device_memory_size_for_profile(profile)?,
+            None => self.get_device_memory_size()?,
+        };
+        let core = self.core()?;
+        core.make_current()?;
+        let engine = core.engine();
+
+        if arena.size() < required {
+            return Err(TRTError::ArenaTooSmall(required, arena.size()));
+        }
+
+        let mut context = self.create_context_for_profile(&engine, profile.unwrap_or(0))?;
+        context.set_device_memory_v2(unsafe { arena.get_raw_ptr() }, arena.size());
+
+        self.context = Some(context);
+        // accounted by the arena
+        self.context_memory = MemoryReservation::none(MemoryCategory::Context);
+        self.scratch = None;
+        self.arena = Some(arena.clone());
+        self.input_consumed = None;
+        self.profiled = false;
+        self.static_shapes = false;
+        self.shapes = ShapeTracker::default();
+        self.clear_cuda_graphs();
+        self.bind_aux_streams(&engine)?;
+        self.bind_error_recorder();
+        Ok(())
+    }
+
+    // Each context reports to a recorder of its own, so a failure is attributed the errors
+    // of its context only and not those of other contexts of a shared engine; one set with
+    // set_error_recorder is kept across reactivation.
+    fn bind_error_recorder(&mut self) {
+        let recorder = self.faults.recorder.get_or_insert_with(|| Arc::new(ErrorRecorder::default()));
+        if let Some(context) = self.context.as_mut() {
+            context.set_error_recorder(recorder);
+        }
+    }
+
+    // Engines with parallel branches run them on auxiliary streams. Rather than letting
+    // TensorRT create its own per context, the context gets crate-owned streams: this
+    // engine's shared set if it is large enough, else a new set at aux_priority.
+    fn bind_aux_streams(&mut self, engine: &CudaEngine) -> TRTResult<()> {
+        let count = engine.get_num_aux_streams().max(0) as usize;
+        if count == 0 {
+            return Ok(());
+        }
+        let reusable = match &self.aux_streams {
+            Some(streams) => streams.len() >= count && streams.priority() == self.aux_priority,
+            None => false,
+        };
+        if !reusable {
+            self.aux_streams = Some(AuxStreams::new(count, self.aux_priority)?);
+        }
+        let streams = self.aux_streams.as_ref().unwrap().raw(count);
+        if let Some(context) = self.context.as_mut() {
+            context.set_aux_streams_raw(&streams);
+        }
+        Ok(())
+    }
+
+    // Priority of the aux streams created for this engine (see
+    // tensorrt_rs_sys::stream::get_stream_priority_range). Rebinds an active context.
+    pub fn set_aux_stream_priority(&mut self, priority: i32) -> TRTResult<()> {
+        self.aux_priority = priority;
+        if self.context.is_some() {
+            let core = self.core()?;
+            let engine = core.engine();
+            self.bind_aux_streams(&engine)?;
+            self.clear_cuda_graphs();
+        }
+        Ok(())
+    }
+
+    // Binds `streams` as this engine's aux streams, e.g. one set for every stage of a chain.
+    // Engines sharing a set must never be enqueued concurrently.
+    pub fn share_aux_streams(&mut self, streams: &Arc<AuxStreams>) -> TRTResult<()> {
+        let core = self.core()?;
+        let engine = core.engine();
+        let count = engine.get_num_aux_streams().max(0) as usize;
+        if streams.len() < count {
+            return Err(TRTError::StreamCreationError);
+        }
+        self.aux_priority = streams.priority();
+        self.aux_streams = Some(streams.clone());
+        self.bind_aux_streams(&engine)?;
+        self.clear_cuda_graphs();
+        Ok(())
+    }
+
+    pub fn get_aux_streams(&self) -> Option<&Arc<AuxStreams>> {
+        self.aux_streams.as_ref()
+    }
+
+    pub fn get_hardware_compatibility_level(&self) -> TRTResult<HardwareCompatibilityLevel> {
+        Ok(self.core()?.engine().get_hardware_compatibility_level())
+    }
+
+    pub fn get_num_aux_streams(&self) -> TRTResult<i32> {
+        let core = self.core()?;
+        let engine = core.engine();
+        Ok(engine.get_num_aux_streams())
+    }
+
+    // Forks each enqueue onto a stream of `priority` (see
+    // tensorrt_rs_sys::stream::get_stream_priority_range) and joins it back, so copies and
+    // completions stay ordered on the caller's stream. None enqueues on the caller's stream
+    // directly. Streams are kept per priority, so switching classes between requests creates
+    // none once warm. Aux streams keep their own priority (see set_aux_stream_priority).
+    // Under an SM budget None is the least priority, since every enqueue goes through a lane.
+    pub fn set_stream_priority(&mut self, priority: Option<i32>) -> TRTResult<()> {
+        let priority = match (priority, self.sm_budget.is_some()) {
+            (None, true) => Some(get_stream_priority_range().0),
+            (priority, _) => priority,
+        };
+        self.lane = match priority {
+            Some(priority) => match self.lanes.iter().position(|lane| lane.priority() == priority) {
+                Some(index) => Some(index),
+                None => {
+                    self.lanes.push(PriorityLane::new(priority, self.sm_budget.as_ref())?);
+                    Some(self.lanes.len() - 1)
+                }
+            },
+            None => None,
+        };
+        Ok(())
+    }
+
+    pub fn set_priority_class(&mut self, class: PriorityClass) -> TRTResult<()> {
+        self.set_stream_priority(Some(class.stream_priority()))
+    }
+
+    pub fn get_stream_priority(&self) -> Option<i32> {
+        self.lane.map(|index| self.lanes[index].priority())
+    }
+
+    // Confines the context's kernels to the SMs of `budget`, which must be on the current
+    // device; None lifts the confinement. The enqueues are forked onto streams of the
+    // budget's green context the way set_stream_priority forks them, so the caller's stream,
+    // the IO buffers and the copies are unchanged, and the stream priority is kept. TensorRT's
+    // aux streams are not confined.
+    pub fn set_sm_budget(&mut self, budget: Option<SmBudget>) -> TRTResult<()> {
+        if let Some(budget) = budget.as_ref() {
+            if device::get_device() != Some(budget.device()) {
+                return Err(TRTError::SmBudgetError("budget is for another device"));
+            }
+        }
+        let priority = self.get_stream_priority();
+        self.lanes.clear();
+        self.lane = None;
+        self.sm_budget = budget;
+        // captured graphs launch on the streams being replaced
+        self.clear_cuda_graphs();
+        self.set_stream_priority(priority)
+    }
+
+    pub fn get_sm_budget(&self) -> Option<&SmBudget> {
+        self.sm_budget.as_ref()
+    }
+
+    // Routes TensorRT's enqueue-time scratch allocations (e.g. a stream-ordered
+    // DeviceAllocator::mem_pool) away from cudaMalloc/cudaFree.
+    pub fn set_temporary_storage_allocator(&mut self, allocator: &DeviceAllocator) -> TRTResult<()> {
+        let context = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        if !context.set_temporary_storage_allocator(allocator) {
+            return Err(TRTError::AllocatorError);
+        }
+        Ok(())
+    }
+
+    pub fn allocate_io_tensors(
+        &mut self,
+        max_shape_dict: &HashMap<&str, &Shape>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<()> {
+        let started = Instant::now();
+        self.allocate_io_tensors_untimed(max_shape_dict, stream)?;
+        self.record_startup(StartupPhase::IoAllocation, started.elapsed());
+        Ok(())
+    }
+
+    fn allocate_io_tensors_untimed(
+        &mut self,
+        max_shape_dict: &HashMap<&str, &Shape>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<()> {
+        let core = self.core()?;
+        core.make_current()?;
+        let schema = core.schema();
+
+        let context: &mut ExecutionContext = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+
+        // Captured graphs reference the tensor addresses being replaced
+        if let Some(graphs) = self.graphs.as_mut() {
+            graphs.clear();
+        }
+
+        self.input_names.clear();
+        self.output_names.clear();
+        self.output_handles.clear();
+        self.shapes.prepare(schema.tensors().iter().map(|tensor| tensor.is_input()));
+        let shape_inputs: Vec<TensorHandle> =
+            schema.inputs().filter(|tensor| tensor.shape_inference).map(|tensor| tensor.handle()).collect();
+        self.shapes.track_values(&shape_inputs);
+
+        // dynamic inputs missing from `max_shape_dict` are sized from the kMAX shape of the
+        // context's profile; inputs are applied first so that output shapes resolve from them
+        let profile = context.get_optimization_profile().max(0);
+        schema.validate_inputs(max_shape_dict.iter().map(|(name, shape)| (*name, *shape)), Some(profile))?;
+        let mut input_shapes: HashMap<&str, Shape> = HashMap::new();
+        for tensor in schema.inputs() {
+            let name = tensor.name.as_str();
+            let handle = tensor.handle();
+            let shape = match max_shape_dict.get(name) {
+                Some(&max_shape) => *max_shape,
+                None => match (tensor.is_dynamic(), tensor.profile_shape(profile, OptProfileSelector::MAX)) {
+                    (true, Some(max)) => max,
+                    _ => tensor.shape,
+                },
+            };
+            if shape.iter().all(|&dim| dim >= 0) && !self.shapes.is_applied(handle, &shape) {
+                if !context.set_input_dims_by_handle(handle, &shape.to_dims()) {
+                    self.shapes.invalidate();
+                    return Err(TRTError::ShapeError(shape.to_vec()));
+                }
+                self.shapes.record(handle, shape);
+            }
+            input_shapes.insert(name, shape);
+        }
+
+        let mut bindings = Vec::with_capacity(schema.len());
+        for tensor in schema.tensors() {
+            let handle = tensor.handle();
+            let name = tensor.name.as_str();
+            self.handles.insert(name.to_string(), handle);
+            match tensor.io_mode {
+                TensorIOMode::INPUT => self.input_names.push(name.to_string()),
+                TensorIOMode::OUTPUT => {
+                    self.output_names.push(name.to_string());
+                    self.output_handles.push(handle);
+                }
+                TensorIOMode::NONE => {}
+            }
+            let shape = match (input_shapes.get(name), max_shape_dict.get(name)) {
+                (Some(&shape), _) => shape,
+                (None, Some(&max_shape)) => *max_shape,
+                // resolved from the input shapes above; still dynamic if data-dependent
+                (None, None) => match context.get_tensor_dims_by_handle(handle) {
+                    dims if dims.is_valid() => Shape::from(dims),
+                    _ => tensor.shape,
+                },
+            };
+            let shape = &shape;
+            if shape.iter().any(|&dim| dim < 0) {
+                if !tensor.is_output() {
+                    return Err(TRTError::ShapeError(shape.to_vec()));
+                }
+                // data-dependent output: TensorRT asks for the memory during enqueue
+                let output = GrowableOutput::new(tensor.dtype);
+                if !context.set_output_allocator(name, output.allocator(stream)) {
+                    return Err(TRTError::OutputAllocatorError);
+                }
+                self.tensors.remove(name);
+                self.dynamic_outputs.insert(name.to_string(), output);
+                continue;
+            }
+            // vectorized formats pad the channel axis beyond shape.size() elements
+            let capacity = match tensor.layout.is_linear() {
+                true => shape.size(),
+                false => tensor.layout.volume(shape, tensor.dtype),
+            };
+            // where TensorRT accesses the tensor, so that it never copies it there itself
+            let buffer = match tensor.on_host() {
+                true => Tensor::host_mapped(shape, capacity, tensor.dtype, HostMemoryKind::Mapped, stream)?,
+                false => Tensor::with_memory(shape, capacity, tensor.dtype, self.io_memory, stream)?,
+            };
+            self.layouts.insert(name.to_string(), tensor.layout);
+            let ptr = Self::binding_address(&buffer, tensor.on_host());
+            self.tensors.insert(name.to_string(), buffer);
+            // inputs were applied above
+            bindings.push(TensorBinding::address(handle, ptr));
+        }
+        Self::apply_bindings(context, &bindings)?;
+        // shape-tensor values change output shapes that static shapes would never resolve again
+        self.static_shapes = self.dynamic_outputs.is_empty() && shape_inputs.is_empty() && schema.is_static();
+        self.host_io = schema.tensors().iter().any(|tensor| tensor.on_host() && !tensor.shape_inference);
+
+        self.slots = schema
+            .tensors()
+            .iter()
+            .map(|tensor| {
+                let (ptr, capacity) = match self.tensors.get(&tensor.name) {
+                    Some(buffer) if !self.dynamic_outputs.contains_key(&tensor.name) => {
+                        (Self::binding_address(buffer, tensor.on_host()), buffer.capacity())
+                    }
+                    _ => (0, 0),
+                };
+                SlotBinding {
+                    ptr,
+                    capacity,
+                    dtype: tensor.dtype,
+                    is_input: tensor.is_input(),
+                    shape_io: tensor.shape_inference,
+                    on_host: tensor.on_host(),
+                }
+            })
+            .collect();
+
+        Ok(())
+    }
+
+    // What the engine reports about its IO tensors, queried once when it was deserialized.
+    pub fn io_schema(&self) -> TRTResult<&IoSchema> {
+        match self.core.as_ref() {
+            Some(core) => Ok(core.schema()),
+            None => Err(TRTError::EngineCreationError),
+        }
+    }
+
+    pub fn io_slot(&self, name: &str) -> Option<IoSlot> {
+        self.handles.get(name).map(|&handle| IoSlot(handle))
+    }
+
+    // Indexed counterpart of inference_into: binds the caller's tensors by slot, enqueues and
+    // restores the engine-owned addresses, without hashing or name-based FFI calls. Outputs
+    // not listed are written to the engine-owned buffers. Profile auto-selection, bucketing
+    // and output shape resizing of the map-based API do not apply; output shapes are queried
+    // with get_slot_shape.
+    pub fn inference_slots(
+        &mut self,
+        inputs: &[(IoSlot, &Tensor)],
+        outputs: &[(IoSlot, &Tensor)],
+        stream: Option<&CuStream>,
+    ) -> TRTResult<()> {
+        self.sampled(|engine| engine.launch_slots(inputs.iter().copied(), outputs.iter().copied(), stream, true))
+    }
+
+    // Resolves `name` as a slot of element type T, checked against the engine's dtype here
+    // rather than on every inference.
+    pub fn typed_slot<T: TrtElement>(&self, name: &str) -> TRTResult<TypedSlot<T>> {
+        let slot = match self.io_slot(name) {
+            Some(slot) => slot,
+            None => return Err(TRTError::InvalidAddress),
+        };
+        match self.slots.get(slot.index()) {
+            Some(binding) if binding.dtype == T::DTYPE => Ok(TypedSlot::new(slot)),
+            Some(_) => Err(TRTError::DTypeMismatch),
+            None => Err(TRTError::InvalidAddress),
+        }
+    }
+
+    // inference_slots for tensors bound through TypedSlot::bind, whose dtypes need no check.
+    pub fn inference_typed(
+        &mut self,
+        inputs: &[TypedBinding<'_>],
+        outputs: &[TypedBinding<'_>],
+        stream: Option<&CuStream>,
+    ) -> TRTResult<()> {
+        let inputs = inputs.iter().map(|binding| (binding.slot, binding.tensor));
+        let outputs = outputs.iter().map(|binding| (binding.slot, binding.tensor));
+        self.sampled(|engine| engine.launch_slots(inputs, outputs, stream, false))
+    }
+
+    fn launch_slots<'t>(
+        &mut self,
+        inputs: impl ExactSizeIterator<Item = (IoSlot, &'t Tensor)>,
+        outputs: impl ExactSizeIterator<Item = (IoSlot, &'t Tensor)>,
+        stream: Option<&CuStream>,
+        check_dtypes: bool,
+    ) -> TRTResult<()> {
+        self.make_current()?;
+        let context: &mut ExecutionContext = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let lane = self.lane.map(|index| &self.lanes[index]);
+        let slots = &self.slots;
+        let shapes = &mut self.shapes;
+
+        // validated up front, so that nothing is bound when a tensor does not match its slot
+        let mut bindings = Vec::with_capacity(inputs.len() + outputs.len());
+        let mut restore = Vec::with_capacity(inputs.len() + outputs.len());
+        for (slot, tensor) in inputs {
+            let binding = match slots.get(slot.index()) {
+                Some(binding) if binding.is_input => binding,
+                _ => return Err(TRTError::InvalidAddress),
+            };
+            if check_dtypes && binding.dtype != tensor.dtype() {
+                return Err(TRTError::DTypeMismatch);
+            }
+            let ptr = match binding.shape_io {
+                true => {
+                    let values = Self::read_shape_values(tensor, stream)?;
+                    Self::write_shape_values(binding, slot.0, shapes, &values)?;
+                    binding.ptr
+                }
+                false => Self::caller_address(binding, tensor, stream)?,
+            };
+            bindings.push(match shapes.is_applied(slot.0, tensor.shape()) {
+                true => TensorBinding::address(slot.0, ptr),
+                false => TensorBinding::input(slot.0, ptr, &tensor.shape().to_dims()),
+            });
+            restore.push(TensorBinding::address(slot.0, binding.ptr));
+        }
+        for (slot, tensor) in outputs {
+            let binding = match slots.get(slot.index()) {
+                Some(binding) if !binding.is_input && binding.ptr != 0 => binding,
+                _ => return Err(TRTError::InvalidAddress),
+            };
+            if check_dtypes && binding.dtype != tensor.dtype() {
+                return Err(TRTError::DTypeMismatch);
+            }
+            let ptr = Self::caller_address(binding, tensor, stream)?;
+            bindings.push(TensorBinding::output(slot.0, ptr, tensor.capacity()));
+            restore.push(TensorBinding::address(slot.0, binding.ptr));
+        }
+
+        let status = Self::launch_bound(context, &bindings, lane, stream);
+        match status.is_ok() {
+            true => shapes.record_bindings(&bindings),
+            false => shapes.invalidate(),
+        }
+        let restored = Self::apply_bindings(context, &restore);
+        Self::check_launch(&self.core, status, &bindings)?;
+        restored?;
+
+        if !self.dynamic_outputs.is_empty() {
+            Self::collect_dynamic_outputs(&self.dynamic_outputs, &mut self.tensors, stream);
+        }
+        Ok(())
+    }
+
+    // Shape of a slot as resolved by the context for the current input shapes.
+    pub fn get_slot_shape(&self, slot: IoSlot) -> TRTResult<Shape> {
+        let context = match self.context.as_ref() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let dims = context.get_tensor_dims_by_handle(slot.0);
+        if !dims.is_valid() {
+            return Err(TRTError::InvalidAddress);
+        }
+        Ok(Shape::from(dims))
+    }
+
+    // Selects the optimization profile used by this context, e.g. one profile per context of
+    // an EnginePool. IO tensors must be (re-)allocated for the profile's shapes afterwards.
+    pub fn set_optimization_profile(&mut self, profile: i32) -> TRTResult<()> {
+        match self.context.as_ref() {
+            Some(context) if context.get_optimization_profile() == profile => return Ok(()),
+            Some(_) => {}
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        }
+        self.fit_scratch(profile)?;
+        let context = self.context.as_mut().unwrap();
+        if !context.set_optimization_profile_async(profile, &self.stream) {
+            return Err(TRTError::ProfileError(profile));
+        }
+
+        // input shapes are per profile; re-apply the current ones, clamped into the new
+        // profile's bounds, so they stay in sync with the engine-owned tensors
+        self.rebind_io_tensors()
+    }
+
+    // Applies the shapes and addresses of the engine-owned tensors to the context. Input
+    // shapes are first clamped into the bounds of the context's profile, which then need not
+    // be the one they were set for; an input whose clamped shape exceeds its buffer is left
+    // unset until the next request (or allocate_io_tensors) sets it.
+    fn rebind_io_tensors(&mut self) -> TRTResult<()> {
+        let core = self.core()?;
+        let schema = core.schema();
+        let context = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let profile = context.get_optimization_profile();
+        self.shapes.invalidate();
+        for (name, tensor) in self.tensors.iter_mut() {
+            let handle = match self.handles.get(name) {
+                Some(&handle) => handle,
+                None => continue,
+            };
+            if self.input_names.contains(name) {
+                let shape = match schema.get(name).and_then(|tensor| tensor.profile(profile)) {
+                    Some(range) => range.clamp(tensor.shape()),
+                    None => *tensor.shape(),
+                };
+                if shape.size() <= tensor.capacity() {
+                    unsafe { tensor.reset_shape(&shape)? };
+                    if !context.set_input_dims_by_handle(handle, &shape.to_dims()) {
+                        self.shapes.invalidate();
+                        return Err(TRTError::ShapeError(shape.to_vec()));
+                    }
+                    self.shapes.record(handle, shape);
+                }
+            }
+            let on_host = matches!(self.slots.get(handle as usize), Some(binding) if binding.on_host);
+            if !context.set_tensor_address_by_handle(handle, Self::binding_address(tensor, on_host)) {
+                return Err(TRTError::InvalidAddress);
+            }
+        }
+        self.clear_cuda_graphs();
+        Ok(())
+    }
+
+    pub fn get_optimization_profile(&self) -> TRTResult<i32> {
+        match self.context.as_ref() {
+            Some(context) => Ok(context.get_optimization_profile()),
+            None => Err(TRTError::ExecutionContextNotInitialized),
+        }
+    }
+
+    pub fn get_num_optimization_profiles(&self) -> TRTResult<i32> {
+        Ok(self.io_schema()?.num_profiles())
+    }
+
+    pub fn get_profile_shape(
+        &self,
+        name: &str,
+        profile: i32,
+        select: OptProfileSelector,
+    ) -> TRTResult<Shape> {
+        match self.io_schema()?.profile_shape(name, profile, select) {
+            Some(shape) => Ok(shape),
+            None => Err(TRTError::ProfileError(profile)),
+        }
+    }
+
+    // Host values of shape-tensor input `name` for `profile`; empty if it is not one.
+    pub fn get_profile_tensor_values(
+        &self,
+        name: &str,
+        profile: i32,
+        select: OptProfileSelector,
+    ) -> TRTResult<Vec<i32>> {
+        let core = self.core()?;
+        let engine = core.engine();
+        Ok(engine.get_profile_tensor_values(name, profile, select))
+    }
+
+    // min/opt/max of every input for every profile.
+    pub fn get_profile_selector(&self) -> TRTResult<ProfileSelector> {
+        Ok(self.io_schema()?.profile_selector())
+    }
+
+    // With auto profile selection, inference switches to the tightest profile accepting the
+    // input shapes before enqueueing. Input buffers must be allocated for the largest profile.
+    pub fn enable_auto_profile(&mut self, enabled: bool) -> TRTResult<()> {
+        self.profile_selector = match enabled {
+            true => Some(self.get_profile_selector()?),
+            false => None,
+        };
+        Ok(())
+    }
+
+    // Rejects input shapes the current profile does not accept before any is applied, so a
+    // bad request fails on the calling thread instead of in TensorRT mid-enqueue. Static
+    // engines only compare against the built shapes.
+    fn check_input_shapes(&self, feed_dict: &HashMap<&str, &Tensor>) -> TRTResult<()> {
+        let profile = match self.static_shapes {
+            true => None,
+            false => Some(self.get_optimization_profile()?),
+        };
+        let shapes = feed_dict.iter().map(|(name, tensor)| (*name, tensor.shape()));
+        self.io_schema()?.validate_inputs(shapes, profile)
+    }
+
+    fn select_profile(&mut self, feed_dict: &HashMap<&str, &Tensor>) -> TRTResult<()> {
+        let selector = match self.profile_selector.as_ref() {
+            Some(selector) if selector.num_profiles() > 1 => selector,
+            _ => return Ok(()),
+        };
+        let shapes: HashMap<&str, &Shape> =
+            feed_dict.iter().map(|(name, tensor)| (*name, tensor.shape())).collect();
+        match selector.select(&shapes) {
+            Some(profile) => self.set_optimization_profile(profile),
+            // rejected by check_input_shapes
+            None => Ok(()),
+        }
+    }
+
+    // Runs `iterations` synthetic (zero-filled) enqueues for the min, opt and max input shapes
+    // of every optimization profile, and for every listed bucket shape (BucketPolicy::Shapes)
+    // a profile accepts, so kernel loading and first-touch allocations happen before serving.
+    // IO tensors must be allocated; shapes beyond their capacity are skipped. The current
+    // profile and input shapes are restored afterwards.
+    pub fn warmup(&mut self, iterations: usize) -> TRTResult<Vec<WarmupRun>> {
+        let started = Instant::now();
+        let runs = self.warmup_untimed(iterations)?;
+        self.record_startup(StartupPhase::Warmup, started.elapsed());
+        Ok(runs)
+    }
+
+    fn warmup_untimed(&mut self, iterations: usize) -> TRTResult<Vec<WarmupRun>> {
+        let selector = self.get_profile_selector()?;
+        let current = self.get_optimization_profile()?;
+        let original: Vec<(String, Shape)> = self
+            .input_names
+            .iter()
+            .filter_map(|name| self.tensors.get(name).map(|tensor| (name.clone(), *tensor.shape())))
+            .collect();
+
+        let picks: [fn(&ProfileShape) -> Shape; 3] = [|range| range.min, |range| range.opt, |range| range.max];
+        let mut runs = Vec::new();
+        for profile in 0..selector.num_profiles() as i32 {
+            let ranges = match selector.get(profile) {
+                Some(ranges) => ranges,
+                None => continue,
+            };
+            let shapes_with = |pick: fn(&ProfileShape) -> Shape| -> Vec<(String, Shape)> {
+                let mut shapes: Vec<(String, Shape)> =
+                    ranges.iter().map(|(name, range)| (name.clone(), pick(range))).collect();
+                shapes.sort_by(|a, b| a.0.cmp(&b.0));
+                shapes
+            };
+
+            let mut candidates: Vec<Vec<(String, Shape)>> = picks.iter().map(|&pick| shapes_with(pick)).collect();
+            for (name, policy) in self.bucket_policies.iter() {
+                let (range, buckets) = match (ranges.get(name), policy) {
+                    (Some(range), BucketPolicy::Shapes(buckets)) => (range, buckets),
+                    _ => continue,
+                };
+                for bucket in buckets.iter().filter(|bucket| range.contains(bucket)) {
+                    let mut shapes = shapes_with(|range| range.opt);
+                    for entry in shapes.iter_mut().filter(|entry| entry.0 == *name) {
+                        entry.1 = *bucket;
+                    }
+                    candidates.push(shapes);
+                }
+            }
+            let mut unique: Vec<Vec<(String, Shape)>> = Vec::with_capacity(candidates.len());
+            for shapes in candidates {
+                if !unique.contains(&shapes) {
+                    unique.push(shapes);
+                }
+            }
+
+            for shapes in unique {
+                let fits = shapes.iter().all(|(name, shape)| {
+                    self.tensors.get(name).map_or(false, |tensor| tensor.can_hold(shape.size()))
+                });
+                if !fits {
+                    continue;
+                }
+                self.stage_input_shapes(profile, &shapes)?;
+
+                let mut timings_ms = Vec::with_capacity(iterations);
+                for _ in 0..iterations {
+                    let start = Instant::now();
+                    self.execute(None)?;
+                    self.synchronize_checked(None)?;
+                    timings_ms.push(start.elapsed().as_secs_f32() * 1000.0);
+                }
+                runs.push(WarmupRun { profile, shapes, timings_ms });
+            }
+        }
+
+        if selector.num_profiles() > 0 {
+            self.stage_input_shapes(current, &original)?;
+        }
+        self.stream.synchronize()?;
+        Ok(runs)
+    }
+
+    // Switches to `profile` with `shapes` applied, and zeroes the inputs for synthetic runs.
+    fn stage_input_shapes(&mut self, profile: i32, shapes: &[(String, Shape)]) -> TRTResult<()> {
+        // the profile switch re-applies the tensors' shapes, which must be valid for it
+        for (name, shape) in shapes {
+            if let Some(tensor) = self.tensors.get_mut(name) {
+                unsafe { tensor.reset_shape(shape)? };
+            }
+        }
+        self.set_optimization_profile(profile)?;
+        for (name, shape) in shapes {
+            self.set_input_shape(name, shape)?;
+        }
+        for name in self.input_names.iter() {
+            if let Some(tensor) = self.tensors.get(name) {
+                tensor.zero(&self.stream)?;
+            }
+        }
+        Ok(())
+    }
+
+    // Has TensorRT record an event once every enqueue has consumed its inputs. That is usually
+    // well before the enqueue finishes, so input buffers can be refilled early (see
+    // input_consumed_event).
+    pub fn enable_input_consumed_event(&mut self) -> TRTResult<()> {
+        let context = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        if self.input_consumed.is_some() {
+            return Ok(());
+        }
+        let event = match CudaEvent::new() {
+            Some(event) => event,
+            None => return Err(TRTError::EventError),
+        };
+        if !context.set_input_consumed_cuda_event(Some(&event)) {
+            return Err(TRTError::EventError);
+        }
+        self.input_consumed = Some(event);
+        Ok(())
+    }
+
+    // Re-recorded by every enqueue, so waits must be issued (e.g. CudaEvent::wait on a copy
+    // stream) before the next enqueue on this engine.
+    pub fn input_consumed_event(&self) -> Option<&CudaEvent> {
+        self.input_consumed.as_ref()
+    }
+
+    // Attaches a per-layer profiler. With `emit_on_enqueue`, TensorRT reports every enqueue as
+    // it happens, which makes enqueue wait for the GPU; otherwise call report_to_profiler after
+    // the stream is synchronized to report the last enqueue.
+    pub fn set_profiler(&mut self, profiler: Option<&LayerProfiler>, emit_on_enqueue: bool) -> TRTResult<()> {
+        let context = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        match profiler {
+            Some(profiler) => {
+                context.set_profiler(profiler);
+                context.set_enqueue_emits_profile(emit_on_enqueue);
+            }
+            None => {
+                context.unset_profiler();
+                context.set_enqueue_emits_profile(true);
+            }
+        }
+        // profiled enqueues are neither replayed from nor captured into a graph; the graphs
+        // captured so far stay valid for when the profiler is detached
+        self.profiled = profiler.is_some();
+        Ok(())
+    }
+
+    pub fn report_to_profiler(&mut self) -> TRTResult<()> {
+        match self.context.as_mut() {
+            Some(context) => {
+                context.report_to_profiler();
+                Ok(())
+            }
+            None => Err(TRTError::ExecutionContextNotInitialized),
+        }
+    }
+
+    // Profiles one request in every `every` into `profiler` and leaves the others as they are,
+    // so per-layer statistics are gathered from production traffic at a small cost. The
+    // profiler is attached for the sampled enqueue only, which reports as it runs and so waits
+    // for the GPU, and bypasses CUDA graph replay. Contexts of a pool may share one profiler
+    // to aggregate all of their requests. Replaces a profiler set with set_profiler; None
+    // stops sampling.
+    pub fn set_profile_sampling(&mut self, profiler: Option<Arc<LayerProfiler>>, every: u64) -> TRTResult<()> {
+        self.set_profiler(None, true)?;
+        let every = every.max(1);
+        self.sampling = profiler.map(|profiler| ProfileSampling { profiler, every, requests: 0, profiled: 0 });
+        Ok(())
+    }
+
+    // Requests profiled since set_profile_sampling.
+    pub fn num_profiled(&self) -> u64 {
+        self.sampling.as_ref().map_or(0, |sampling| sampling.profiled)
+    }
+
+    // Runs `run` with the sampling profiler attached when this request is one to profile.
+    fn sampled<T, F>(&mut self, run: F) -> TRTResult<T>
+    where
+        F: FnOnce(&mut Self) -> TRTResult<T>,
+    {
+        let sampling = match self.sampling.as_mut() {
+            Some(sampling) => sampling,
+            None => return run(self),
+        };
+        sampling.requests += 1;
+        if (sampling.requests - 1) % sampling.every != 0 {
+            return run(self);
+        }
+        let context = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        context.set_profiler(&sampling.profiler);
+        context.set_enqueue_emits_profile(true);
+        sampling.profiled += 1;
+        // a replayed graph would not report the enqueue
+        let graphs = self.graphs.take();
+        let res = run(self);
+        self.graphs = graphs;
+        if let Some(context) = self.context.as_mut() {
+            context.unset_profiler();
+        }
+        res
+    }
+
+    pub fn get_stream(&self) -> &CuStream {
+        &self.stream
+    }
+
+    // Opt-in: the input copies and enqueueV3 are captured into a CUDA graph per input
+    // signature (shapes) and replayed on later calls that match. A call with other source
+    // or, for inference_zero_copy and inference_into, bound addresses updates the graph's
+    // parameters in place rather than capturing and instantiating it again.
+    pub fn enable_cuda_graphs(&mut self, enabled: bool) {
+        if enabled {
+            self.graphs.get_or_insert_with(GraphCache::default);
+        } else {
+            self.graphs = None;
+        }
+    }
+
+    pub fn num_cuda_graphs(&self) -> usize {
+        self.graphs.as_ref().map_or(0, |graphs| graphs.len())
+    }
+
+    // Replays that first updated a graph to new addresses.
+    pub fn num_cuda_graph_updates(&self) -> u64 {
+        self.graphs.as_ref().map_or(0, |graphs| graphs.updates())
+    }
+
+    pub fn clear_cuda_graphs(&mut self) {
+        if let Some(graphs) = self.graphs.as_mut() {
+            graphs.clear();
+        }
+    }
+
+    // Keeps the named IO tensors (e.g. the state of a recurrent model) resident in L2 across
+    // enqueues on `stream`, instead of re-reading them from HBM. A stream has a single access
+    // policy window, so the tensors are covered by their bounding address range: allocate
+    // them adjacently (e.g. from a DeviceMemoryArena) so the window holds nothing else.
+    // Sizes the device's persisting set-aside, and this context's limit, to the window.
+    pub fn set_l2_persisting_tensors(&mut self, names: &[&str], stream: Option<&CuStream>) -> TRTResult<L2Window> {
+        let mut regions = Vec::with_capacity(names.len());
+        for name in names {
+            let tensor = match self.tensors.get(*name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name.to_string())),
+            };
+            regions.push((unsafe { tensor.get_raw_ptr() }, tensor.capacity() * tensor.dtype().get_elem_size()));
+        }
+        self.set_l2_persisting_regions(&regions, stream)
+    }
+
+    // Like set_l2_persisting_tensors, for raw device regions such as weights or state kept
+    // outside the engine's IO tensors.
+    pub fn set_l2_persisting_regions(
+        &mut self,
+        regions: &[(usize, usize)],
+        stream: Option<&CuStream>,
+    ) -> TRTResult<L2Window> {
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let window = l2::persist(regions, stream)?;
+        if let Some(context) = self.context.as_mut() {
+            context.set_persistent_cache_limit(window.set_aside);
+        }
+        // graphs captured before carry no window in their kernel nodes
+        if let Some(graphs) = self.graphs.as_mut() {
+            graphs.clear();
+        }
+        Ok(window)
+    }
+
+    pub fn clear_l2_persisting(&mut self, stream: Option<&CuStream>) -> TRTResult<()> {
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        l2::clear(stream)?;
+        if let Some(graphs) = self.graphs.as_mut() {
+            graphs.clear();
+        }
+        Ok(())
+    }
+
+    // Pads `name` up to the bucket chosen by `policy` on every inference; None removes the
+    // policy. Buffers must be allocated for the largest bucket.
+    pub fn set_bucket_policy(&mut self, name: &str, policy: Option<BucketPolicy>) {
+        match policy {
+            Some(policy) => self.bucket_policies.insert(name.to_string(), policy),
+            None => self.bucket_policies.remove(name),
+        };
+        self.valid_shapes.remove(name);
+    }
+
+    // Lets inference convert inputs whose dtype differs from the binding (e.g. FP32 data into an
+    // FP16 engine) with a GPU cast during the input copy, instead of failing with
+    // DTypeMismatch. The zero-copy and bucketed paths still require matching dtypes.
+    pub fn enable_cast_on_bind(&mut self, enabled: bool) {
+        self.cast_scales = match enabled {
+            true => Some(self.cast_scales.take().unwrap_or_default()),
+            false => None,
+        };
+    }
+
+    // Quantization scale (real = q * scale) used when casting into the INT8, UINT8 or FP8
+    // input `name`. Enables cast on bind.
+    pub fn set_input_scale(&mut self, name: &str, scale: f32) {
+        self.cast_scales.get_or_insert_with(HashMap::new).insert(name.to_string(), scale);
+    }
+
+    // The unpadded shape of a bucketed input in the last inference. The valid region starts at
+    // the origin of every dim, so post-processing can crop (or rescale) outputs with it.
+    pub fn get_valid_shape(&self, name: &str) -> Option<&Shape> {
+        self.valid_shapes.get(name)
+    }
+
+    pub fn inference(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<&HashMap<String, Tensor>> {
+        let traced = self.trace.as_ref().map(|trace| trace.begin(feed_dict, stream.unwrap_or(&self.stream)));
+        let copy_bytes = || feed_dict.values().map(|tensor| tensor.size_in_bytes()).sum();
+        let res =
+            self.metered(stream, copy_bytes, |engine, copied| engine.dispatch(feed_dict, stream, copied).map(|_| ()));
+        self.finish_trace(traced);
+        res?;
+        Ok(&self.tensors)
+    }
+
+    // Like inference, and also returns the sequence number of the call's GPU timing, to be
+    // taken with gpu_timing once its work completed. The number is None unless metrics are
+    // enabled with gpu_timing, and while every timing event is in flight.
+    pub fn inference_timed(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<(&HashMap<String, Tensor>, Option<u64>)> {
+        let traced = self.trace.as_ref().map(|trace| trace.begin(feed_dict, stream.unwrap_or(&self.stream)));
+        let copy_bytes = || feed_dict.values().map(|tensor| tensor.size_in_bytes()).sum();
+        let res =
+            self.metered(stream, copy_bytes, |engine, copied| engine.dispatch(feed_dict, stream, copied).map(|_| ()));
+        self.finish_trace(traced);
+        Ok((&self.tensors, res?))
+    }
+
+    // Failed requests are recorded too: they arrived all the same, and a sample's copy may
+    // still be in flight.
+    fn finish_trace(&self, traced: Option<TracedRequest>) {
+        if let (Some(trace), Some(traced)) = (self.trace.as_ref(), traced) {
+            trace.finish(traced);
+        }
+    }
+
+    // Runs `run` between the begin and the end of a metrics sample when metrics are enabled,
+    // and within a span when the call is traced. `run` records the events it is given once
+    // the input copies are issued. Returns the sequence number of the sample when it is timed
+    // on the device.
+    fn metered<B, F>(&mut self, stream: Option<&CuStream>, copy_bytes: B, run: F) -> TRTResult<Option<u64>>
+    where
+        B: FnOnce() -> usize,
+        F: FnOnce(&mut Self, &[Option<&CudaEvent>]) -> TRTResult<()>,
+    {
+        let _range = nvtx::range!(Category::Enqueue, "TRTEngine::inference");
+        self.make_current()?;
+        let span = self.begin_span(stream.unwrap_or(&self.stream));
+        let span_copied = span.as_ref().and_then(|(_, timeline)| timeline.as_ref()).map(|timeline| timeline.event(1));
+        let mut instrumentation = match self.instrumentation.take() {
+            Some(instrumentation) => instrumentation,
+            None => {
+                let res = self.sampled(|engine| run(engine, &[span_copied]));
+                self.end_span(span, stream.unwrap_or(&self.stream), &res);
+                return self.recover_on_failure(res).map(|_| None);
+            }
+        };
+        let sample = instrumentation.begin(stream.unwrap_or(&self.stream));
+        let res = self.sampled(|engine| run(engine, &[instrumentation.copied_event(&sample), span_copied]));
+        let sequence = instrumentation.end(sample, stream.unwrap_or(&self.stream), &res, copy_bytes());
+        self.instrumentation = Some(instrumentation);
+        self.end_span(span, stream.unwrap_or(&self.stream), &res);
+        self.recover_on_failure(res).map(|_| sequence)
+    }
+
+    // The span of a traced call, and the marks of its device stages unless every timing event
+    // is in flight: 0 before the call, 1 once the input copies are issued, 2 after its work.
+    fn begin_span(&self, stream: &CuStream) -> Option<(OpenSpan, Option<Timeline>)> {
+        let spans = self.spans.as_ref()?;
+        let span = spans.start(self.span_parent.as_ref())?;
+        let mut timeline = spans.timeline(3);
+        if let Some(timeline) = timeline.as_mut() {
+            // the upload stays empty unless the copies re-record mark 1, e.g. inside a graph
+            timeline.record(0, stream);
+            timeline.record(1, stream);
+        }
+        Some((span, timeline))
+    }
+
+    fn end_span(&self, span: Option<(OpenSpan, Option<Timeline>)>, stream: &CuStream, res: &TRTResult<()>) {
+        const STAGES: &[Stage] = &[("trt.upload", 0, 1), ("trt.gpu", 1, 2)];
+        let (spans, (mut span, timeline)) = match (self.spans.as_ref(), span) {
+            (Some(spans), Some(span)) => (spans, span),
+            _ => return,
+        };
+        span.failed = res.is_err();
+        for name in &self.input_names {
+            if let Ok(shape) = self.get_tensor_shape(name) {
+                span.set(format!("trt.input.{}", name), SpanValue::Shape(shape));
+            }
+        }
+        if let Some(mut timeline) = timeline {
+            timeline.record(2, stream);
+            spans.finish_timeline(timeline, &span.context, STAGES);
+        }
+        spans.finish(span, "trt.enqueue", Instant::now());
+    }
+
+    fn dispatch(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+        copied: &[Option<&CudaEvent>],
+    ) -> TRTResult<&HashMap<String, Tensor>> {
+        if self.static_shapes && self.bucket_policies.is_empty() {
+            self.check_input_shapes(feed_dict)?;
+            return self.run_static(feed_dict.iter().map(|(name, tensor)| (*name, *tensor)), stream, copied);
+        }
+        self.select_profile(feed_dict)?;
+        // bucketed requests are padded to a bucket before their shapes are applied
+        if !self.bucket_policies.is_empty() {
+            return self.inference_bucketed(feed_dict, stream);
+        }
+        self.check_input_shapes(feed_dict)?;
+
+        let context: &mut ExecutionContext = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let lane = self.lane.map(|index| &self.lanes[index]);
+
+        for (name, input_tensor) in feed_dict {
+            let tensor = match self.tensors.get_mut(name.to_owned()) {
+                Some(tensor) => tensor,
+                None => continue,
+            };
+            let handle = self.handles.get(*name).copied();
+            Self::apply_input_shape(context, &mut self.shapes, tensor, name, handle, input_tensor.shape())?;
+            if let Some((handle, binding)) = Self::shape_input(&self.slots, handle) {
+                let values = Self::read_shape_values(input_tensor, stream)?;
+                Self::write_shape_values(&binding, handle, &mut self.shapes, &values)?;
+            }
+        }
+        Self::resolve_output_shapes(context, &mut self.shapes, &mut self.tensors, &self.output_names, &self.output_handles)?;
+
+        // data-dependent outputs make TensorRT synchronize inside enqueue, and shape-tensor
+        // values and host-located tensors are accessed on the host by it, none of which a
+        // captured graph replays
+        let replayable = self.dynamic_outputs.is_empty() && !self.shapes.tracks_values() && !self.host_io;
+        let graphs = match replayable && !self.profiled {
+            true => self.graphs.as_mut(),
+            false => None,
+        };
+        let casts = self.cast_scales.as_ref();
+        let (handles, slots) = (&self.handles, &self.slots);
+        let inputs = feed_dict
+            .iter()
+            .map(|(name, tensor)| (*name, *tensor))
+            .filter(move |(name, _)| Self::shape_input(slots, handles.get(*name).copied()).is_none());
+        let graph_key = match graphs {
+            Some(graphs) => {
+                let key = GraphKey::new(feed_dict).with_priority(lane.map(|lane| lane.priority()));
+                let tensors = &mut self.tensors;
+                let record = || Self::enqueue(context, tensors, casts, inputs.clone(), lane, &[], stream);
+                if let Some(res) = graphs.replay(&key, stream, record) {
+                    res?;
+                    return Ok(&self.tensors);
+                }
+                Some(key)
+            }
+            None => None,
+        };
+
+        Self::enqueue(context, &mut self.tensors, casts, inputs.clone(), lane, copied, stream)
+            .map_err(|err| Self::replay_log_on_failure(&self.core, err))?;
+
+        if let (Some(graphs), Some(key)) = (self.graphs.as_mut(), graph_key) {
+            let tensors = &mut self.tensors;
+            graphs.capture(key, stream, || Self::enqueue(context, tensors, casts, inputs, lane, &[], stream))?;
+        }
+
+        Self::collect_dynamic_outputs(&self.dynamic_outputs, &mut self.tensors, stream);
+
+        Ok(&self.tensors)
+    }
+
+    // True once allocate_io_tensors found every IO shape static. The addresses are then bound
+    // once, and inference skips profile selection, shape application and output shape
+    // resolution: it is the input copies plus enqueueV3, or a graph launch.
+    pub fn is_static(&self) -> bool {
+        self.static_shapes
+    }
+
+    pub(crate) fn inference_static<'a, I>(
+        &mut self,
+        inputs: I,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<&HashMap<String, Tensor>>
+    where
+        I: Iterator<Item = (&'a str, &'a Tensor)> + Clone,
+    {
+        let copy_bytes = || inputs.clone().map(|(_, tensor)| tensor.size_in_bytes()).sum();
+        self.metered(stream, copy_bytes, |engine, copied| {
+            engine.run_static(inputs.clone(), stream, copied).map(|_| ())
+        })?;
+        Ok(&self.tensors)
+    }
+
+    // The shapes are fixed, so the input copies (which check them) are the only validation.
+    fn run_static<'a, I>(
+        &mut self,
+        inputs: I,
+        stream: Option<&CuStream>,
+        copied: &[Option<&CudaEvent>],
+    ) -> TRTResult<&HashMap<String, Tensor>>
+    where
+        I: Iterator<Item = (&'a str, &'a Tensor)> + Clone,
+    {
+        let context: &mut ExecutionContext = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let lane = self.lane.map(|index| &self.lanes[index]);
+
+        let casts = self.cast_scales.as_ref();
+        let graph_key = match self.graphs.as_mut().filter(|_| !self.host_io && !self.profiled) {
+            Some(graphs) => {
+                let key = GraphKey::from_inputs(inputs.clone()).with_priority(lane.map(|lane| lane.priority()));
+                let tensors = &mut self.tensors;
+                let record = || Self::enqueue(context, tensors, casts, inputs.clone(), lane, &[], stream);
+                if let Some(res) = graphs.replay(&key, stream, record) {
+                    res?;
+                    return Ok(&self.tensors);
+                }
+                Some(key)
+            }
+            None => None,
+        };
+
+        Self::enqueue(context, &mut self.tensors, casts, inputs.clone(), lane, copied, stream)
+            .map_err(|err| Self::replay_log_on_failure(&self.core, err))?;
+
+        if let (Some(graphs), Some(key)) = (self.graphs.as_mut(), graph_key) {
+            let tensors = &mut self.tensors;
+            graphs.capture(key, stream, || Self::enqueue(context, tensors, casts, inputs, lane, &[], stream))?;
+        }
+        Ok(&self.tensors)
+    }
+
+    // Inputs are padded into the engine-owned buffers outside of any captured graph, so graphs
+    // only capture enqueueV3 and are keyed by bucket shapes, not by request shapes.
+    fn inference_bucketed(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<&HashMap<String, Tensor>> {
+        let context: &mut ExecutionContext = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let lane = self.lane.map(|index| &self.lanes[index]);
+
+        let mut key_entries = Vec::with_capacity(feed_dict.len());
+        for (name, input_tensor) in feed_dict {
+            let tensor = match self.tensors.get_mut(name.to_owned()) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name.to_string())),
+            };
+            let bucket = match self.bucket_policies.get(*name) {
+                Some(policy) => match policy.bucket(input_tensor.shape()) {
+                    Some(bucket) => bucket,
+                    None => return Err(TRTError::ShapeError(input_tensor.shape().to_vec())),
+                },
+                None => *input_tensor.shape(),
+            };
+            let handle = self.handles.get(*name).copied();
+            Self::apply_input_shape(context, &mut self.shapes, tensor, name, handle, &bucket)?;
+            let _range = nvtx::range!(Category::Copy, "pad input");
+            pad_into(input_tensor, tensor, stream)?;
+
+            self.valid_shapes.insert(name.to_string(), *input_tensor.shape());
+            key_entries.push((name.to_string(), bucket));
+        }
+        Self::resolve_output_shapes(context, &mut self.shapes, &mut self.tensors, &self.output_names, &self.output_handles)?;
+
+        // the padded host-located inputs are read by TensorRT as it enqueues
+        if self.host_io {
+            stream.synchronize()?;
+        }
+        let enqueue = |context: &mut ExecutionContext| match Self::launch(context, lane, stream) {
+            true => Ok(()),
+            false => Err(Self::replay_log_on_failure(&self.core, TRTError::EnqueueError)),
+        };
+
+        let graphs = match self.dynamic_outputs.is_empty() && !self.host_io && !self.profiled {
+            true => self.graphs.as_mut(),
+            false => None,
+        };
+        match graphs {
+            Some(graphs) => {
+                let key = GraphKey::from_shapes(key_entries).with_priority(lane.map(|lane| lane.priority()));
+                match graphs.replay(&key, stream, || enqueue(context)) {
+                    Some(res) => res?,
+                    None => {
+                        enqueue(context)?;
+                        graphs.capture(key, stream, || enqueue(context))?;
+                    }
+                }
+            }
+            None => enqueue(context)?,
+        }
+
+        Self::collect_dynamic_outputs(&self.dynamic_outputs, &mut self.tensors, stream);
+
+        Ok(&self.tensors)
+    }
+
+    // Like inference, but binds the caller's input memory directly instead of copying it into
+    // the engine-owned buffers. Shapes are validated against the allocated input capacity, and
+    // the engine-owned addresses are restored once enqueue returns. The caller's tensors must
+    // stay alive until the work on `stream` has completed. With CUDA graphs enabled, the
+    // graph of the input shapes is replayed, its addresses updated to each request's.
+    pub fn inference_zero_copy(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<&HashMap<String, Tensor>> {
+        self.sampled(|engine| engine.execute_bound(feed_dict, &HashMap::new(), stream))?;
+        Ok(&self.tensors)
+    }
+
+    // Zero-copy for outputs as well: TensorRT writes straight into the caller's tensors, whose
+    // capacity must cover the output shapes resolved for the given inputs (see
+    // get_tensor_shape). Used to keep several output buffer sets in flight.
+    pub fn inference_into(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        output_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<()> {
+        self.sampled(|engine| engine.execute_bound(feed_dict, output_dict, stream))
+    }
+
+    // Rows of the inputs in `feed_dict` one enqueue can take: the max batch of the current
+    // profile (of any profile with auto profile selection) and of the allocated input buffers.
+    // Shape-tensor inputs carry no rows and are passed to every chunk unchanged.
+    pub fn max_chunk_rows(&self, feed_dict: &HashMap<&str, &Tensor>) -> TRTResult<usize> {
+        let profiles: Vec<i32> = match self.profile_selector.as_ref() {
+            Some(selector) if selector.num_profiles() > 1 => (0..selector.num_profiles() as i32).collect(),
+            _ => vec![self.get_optimization_profile()?],
+        };
+        let mut rows = usize::MAX;
+        for (&name, tensor) in feed_dict {
+            if Self::shape_input(&self.slots, self.handles.get(name).copied()).is_some() {
+                continue;
+            }
+            let capacity = match self.tensors.get(name) {
+                Some(buffer) => buffer.capacity(),
+                None => return Err(TRTError::TensorNotFound(name.to_string())),
+            };
+            let dims = tensor.shape().to_vec();
+            if dims.is_empty() {
+                return Err(TRTError::ShapeMismatch);
+            }
+            let row_elems = dims[1..].iter().map(|&d| d.max(0) as usize).product::<usize>().max(1);
+            rows = rows.min(capacity / row_elems);
+            let profile_max = profiles
+                .iter()
+                .filter_map(|&profile| self.get_profile_shape(name, profile, OptProfileSelector::MAX).ok())
+                .map(|shape| shape.to_vec()[0])
+                .max();
+            if let Some(max) = profile_max.filter(|&max| max > 0) {
+                rows = rows.min(max as usize);
+            }
+        }
+        match rows {
+            0 | usize::MAX => Err(TRTError::ShapeMismatch),
+            rows => Ok(rows),
+        }
+    }
+
+    // Like inference, for a batch of any size: the inputs, which must agree on their first
+    // dim, are cut into chunks of max_chunk_rows rows enqueued back to back on `stream`, each
+    // writing its rows of outputs allocated for the whole batch. Outputs must keep the batch
+    // as their first dim; data-dependent outputs are not supported. See
+    // EnginePool::inference_chunked to spread the chunks over several contexts.
+    pub fn inference_chunked(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<HashMap<String, Tensor>> {
+        self.make_current()?;
+        let stream = stream.cloned().unwrap_or_else(|| self.stream.clone());
+        let batch = self.batch_rows(feed_dict)?;
+        let rows = self.max_chunk_rows(feed_dict)?;
+        let outputs = self.chunked_outputs(feed_dict, batch, rows, Some(&stream))?;
+        let chunks: Vec<_> = (0..batch).step_by(rows).map(|start| (start, rows.min(batch - start))).collect();
+        self.run_chunks(feed_dict, &outputs, &chunks, Some(&stream))?;
+        Ok(outputs)
+    }
+
+    // The first dim shared by the batched inputs of `feed_dict`.
+    pub(crate) fn batch_rows(&self, feed_dict: &HashMap<&str, &Tensor>) -> TRTResult<usize> {
+        let mut batch = None;
+        for (&name, tensor) in feed_dict {
+            if Self::shape_input(&self.slots, self.handles.get(name).copied()).is_some() {
+                continue;
+            }
+            let rows = match tensor.shape().to_vec().first() {
+                Some(&rows) => rows.max(0) as usize,
+                None => return Err(TRTError::ShapeMismatch),
+            };
+            match batch {
+                Some(batch) if batch != rows => return Err(TRTError::ShapeMismatch),
+                _ => batch = Some(rows),
+            }
+        }
+        match batch {
+            Some(batch) => Ok(batch),
+            None => Err(TRTError::ShapeMismatch),
+        }
+    }
+
+    // Outputs for `batch` rows, shaped from those the context resolves for a chunk of `rows`.
+    pub(crate) fn chunked_outputs(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        batch: usize,
+        rows: usize,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<HashMap<String, Tensor>> {
+        let stream = stream.cloned().unwrap_or_else(|| self.stream.clone());
+        let first = self.chunk_inputs(feed_dict, 0, rows.min(batch), &stream);
+        let first_dict: HashMap<&str, &Tensor> = first.iter().map(|(name, tensor)| (*name, tensor)).collect();
+        self.select_profile(&first_dict)?;
+        for (name, tensor) in first.iter() {
+            if Self::shape_input(&self.slots, self.handles.get(*name).copied()).is_none() {
+                self.set_input_shape(name, tensor.shape())?;
+            }
+        }
+
+        let mut outputs = HashMap::with_capacity(self.output_names.len());
+        for name in self.output_names.clone() {
+            if self.dynamic_outputs.contains_key(&name) {
+                return Err(TRTError::ShapeMismatch);
+            }
+            let mut dims = self.get_tensor_shape(&name)?.to_vec();
+            if dims.first() != Some(&(rows.min(batch) as i32)) {
+                return Err(TRTError::ShapeMismatch);
+            }
+            dims[0] = batch as i32;
+            let dtype = match self.tensors.get(&name) {
+                Some(tensor) => tensor.dtype(),
+                None => return Err(TRTError::TensorNotFound(name)),
+            };
+            let shape = Shape::new(&dims);
+            let tensor = Tensor::with_memory(&shape, shape.size(), dtype, self.io_memory, &stream)?;
+            outputs.insert(name, tensor);
+        }
+        Ok(outputs)
+    }
+
+    // Enqueues the (start, count) row ranges of `chunks`, each into its rows of `outputs`.
+    pub(crate) fn run_chunks(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        outputs: &HashMap<String, Tensor>,
+        chunks: &[(usize, usize)],
+        stream: Option<&CuStream>,
+    ) -> TRTResult<()> {
+        let stream = stream.cloned().unwrap_or_else(|| self.stream.clone());
+        for &(start, count) in chunks {
+            let inputs = self.chunk_inputs(feed_dict, start, count, &stream);
+            let views: Vec<(&str, Tensor)> =
+                outputs.iter().map(|(name, tensor)| (name.as_str(), tensor.rows(start, count, &stream))).collect();
+            let input_dict: HashMap<&str, &Tensor> = inputs.iter().map(|(name, tensor)| (*name, tensor)).collect();
+            let output_dict: HashMap<&str, &Tensor> = views.iter().map(|(name, tensor)| (*name, tensor)).collect();
+            self.inference_into(&input_dict, &output_dict, Some(&stream))?;
+        }
+        Ok(())
+    }
+
+    fn chunk_inputs<'a>(
+        &self,
+        feed_dict: &HashMap<&'a str, &Tensor>,
+        start: usize,
+        count: usize,
+        stream: &CuStream,
+    ) -> Vec<(&'a str, Tensor)> {
+        feed_dict
+            .iter()
+            .map(|(&name, &tensor)| match Self::shape_input(&self.slots, self.handles.get(name).copied()) {
+                Some(_) => {
+                    let ptr = unsafe { tensor.get_raw_ptr() };
+                    (name, Tensor::from_raw_ptr(ptr, tensor.shape(), tensor.dtype(), stream))
+                }
+                None => (name, tensor.rows(start, count, stream)),
+            })
+            .collect()
+    }
+
+    // `sets` sets of output tensors for inference_leased, each output allocated like its
+    // engine-owned buffer. Data-dependent outputs are not leased; they stay in get_tensor.
+    pub fn output_ring(&self, sets: usize, stream: Option<&CuStream>) -> TRTResult<OutputRing> {
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let mut ring = Vec::with_capacity(sets);
+        for _ in 0..sets.max(1) {
+            let mut tensors = HashMap::with_capacity(self.output_names.len());
+            for name in self.output_names.iter().filter(|name| !self.dynamic_outputs.contains_key(*name)) {
+                let tensor = match self.tensors.get(name) {
+                    Some(tensor) => tensor,
+                    None => return Err(TRTError::TensorNotFound(name.to_string())),
+                };
+                let (shape, capacity, dtype) = (tensor.shape(), tensor.capacity(), tensor.dtype());
+                let leased = Tensor::with_memory(shape, capacity, dtype, self.io_memory, stream)?;
+                tensors.insert(name.clone(), leased);
+            }
+            ring.push(tensors);
+        }
+        OutputRing::new(ring)
+    }
+
+    // One step of a stateful engine: the state inputs of `session` are bound to its current
+    // buffers and its state outputs to the other ones, which then hold the current state, so
+    // no state is copied between steps. `feed_dict` holds the other inputs; the outputs that
+    // are not state are the engine-owned tensors returned.
+    pub fn inference_stateful(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        session: &mut StateSession,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<&HashMap<String, Tensor>> {
+        let stream = stream.cloned().unwrap_or_else(|| self.stream.clone());
+        session.wait(&stream)?;
+        {
+            let mut inputs = feed_dict.clone();
+            let mut outputs = HashMap::new();
+            session.bind(&mut inputs, &mut outputs);
+            self.sampled(|engine| engine.execute_bound(&inputs, &outputs, Some(&stream)))?;
+        }
+        session.advance(&self.tensors, &stream)?;
+        Ok(&self.tensors)
+    }
+
+    // Like inference_into, into the next free set of `ring`, which is handed back as an owned
+    // lease: the engine takes the next request while the caller still reads this one's
+    // outputs. Blocks while every set of the ring is leased.
+    pub fn inference_leased(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        ring: &OutputRing,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<OutputLease> {
+        let stream = stream.cloned().unwrap_or_else(|| self.stream.clone());
+        let mut lease = ring.checkout(&stream)?;
+        {
+            let outputs: HashMap<&str, &Tensor> =
+                lease.tensors().iter().map(|(name, tensor)| (name.as_str(), tensor)).collect();
+            self.sampled(|engine| engine.execute_bound(feed_dict, &outputs, Some(&stream)))?;
+        }
+        // the shapes resolved for this request's inputs
+        for (name, tensor) in lease.tensors_mut().iter_mut() {
+            if let Some(resolved) = self.tensors.get(name) {
+                if tensor.shape() != resolved.shape() {
+                    unsafe { tensor.reset_shape(resolved.shape())? };
+                }
+            }
+        }
+        lease.record_written(&stream)?;
+        Ok(lease)
+    }
+
+    fn execute_bound(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        output_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<()> {
+        self.make_current()?;
+        self.select_profile(feed_dict)?;
+        self.check_input_shapes(feed_dict)?;
+
+        let context: &mut ExecutionContext = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let lane = self.lane.map(|index| &self.lanes[index]);
+
+        // inputs are bound first so that the output shapes resolve from them
+        let mut inputs = Vec::with_capacity(feed_dict.len());
+        let mut outputs = Vec::with_capacity(output_dict.len());
+        let mut restore = Vec::with_capacity(feed_dict.len() + output_dict.len());
+        for (name, tensor) in feed_dict {
+            if let Some((handle, binding)) = Self::shape_input(&self.slots, self.handles.get(*name).copied()) {
+                let values = Self::read_shape_values(tensor, stream)?;
+                Self::write_shape_values(&binding, handle, &mut self.shapes, &values)?;
+            }
+        }
+        let (slots, shapes) = (&self.slots, &self.shapes);
+        let (tensors, handles) = (&mut self.tensors, &self.handles);
+        Self::bind_inputs(tensors, handles, slots, shapes, feed_dict, stream, &mut inputs, &mut restore)?;
+        let res = Self::apply_bindings(context, &inputs)
+            .map(|_| self.shapes.record_bindings(&inputs))
+            .and_then(|_| {
+                Self::resolve_output_shapes(context, &mut self.shapes, &mut self.tensors, &self.output_names, &self.output_handles)
+            })
+            .and_then(|_| {
+                let (tensors, handles) = (&self.tensors, &self.handles);
+                Self::bind_outputs(tensors, handles, slots, output_dict, stream, &mut outputs, &mut restore)
+            })
+            .and_then(|_| {
+                // as in inference: nothing the host does inside enqueue may be needed
+                let replayable = self.dynamic_outputs.is_empty() && !self.shapes.tracks_values() && !self.host_io;
+                let graphs = match replayable && !self.profiled {
+                    true => self.graphs.as_mut(),
+                    false => None,
+                };
+                let core = &self.core;
+                let mut launch = || {
+                    let status = Self::launch_bound(context, &outputs, lane, stream);
+                    Self::check_launch(core, status, &outputs)
+                };
+                let graphs = match graphs {
+                    Some(graphs) => graphs,
+                    None => return launch(),
+                };
+                let shapes = feed_dict.iter().map(|(name, tensor)| (name.to_string(), *tensor.shape())).collect();
+                let mut bound: Vec<&TensorBinding> = inputs.iter().chain(outputs.iter()).collect();
+                bound.sort_unstable_by_key(|binding| binding.handle);
+                let key = GraphKey::from_shapes(shapes)
+                    .with_addresses(bound.iter().map(|binding| binding.address).collect())
+                    .with_priority(lane.map(|lane| lane.priority()));
+                match graphs.replay(&key, stream, &mut launch) {
+                    Some(res) => res,
+                    None => {
+                        launch()?;
+                        graphs.capture(key, stream, launch)
+                    }
+                }
+            });
+
+        if res.is_err() {
+            self.shapes.invalidate();
+        }
+        // enqueueV3 has consumed the addresses; put the engine-owned buffers back
+        Self::apply_bindings(context, &restore)?;
+        res?;
+
+        Self::collect_dynamic_outputs(&self.dynamic_outputs, &mut self.tensors, stream);
+
+        Ok(())
+    }
+
+    // Shape tensors stay bound to their host buffers, which hold the request's values.
+    #[allow(clippy::too_many_arguments)]
+    fn bind_inputs(
+        tensors: &mut HashMap<String, Tensor>,
+        handles: &HashMap<String, TensorHandle>,
+        slots: &[SlotBinding],
+        shapes: &ShapeTracker,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: &CuStream,
+        bindings: &mut Vec<TensorBinding>,
+        restore: &mut Vec<TensorBinding>,
+    ) -> TRTResult<()> {
+        for (name, input_tensor) in feed_dict {
+            let (tensor, handle) = match (tensors.get_mut(name.to_owned()), handles.get(*name)) {
+                (Some(tensor), Some(&handle)) => (tensor, handle),
+                _ => continue,
+            };
+            if tensor.dtype() != input_tensor.dtype() {
+                return Err(TRTError::DTypeMismatch);
+            }
+            if tensor.shape() != input_tensor.shape() {
+                unsafe { tensor.reset_shape(input_tensor.shape())? };
+            }
+
+            let (ptr, original) = match (Self::shape_input(slots, Some(handle)), slots.get(handle as usize)) {
+                (Some((_, binding)), _) => (binding.ptr, binding.ptr),
+                (None, Some(binding)) => {
+                    let ptr = Self::caller_address(binding, input_tensor, stream)?;
+                    (ptr, Self::binding_address(tensor, binding.on_host))
+                }
+                (None, None) => (unsafe { input_tensor.get_raw_ptr() }, unsafe { tensor.get_raw_ptr() }),
+            };
+            bindings.push(match shapes.is_applied(handle, input_tensor.shape()) {
+                true => TensorBinding::address(handle, ptr),
+                false => TensorBinding::input(handle, ptr, &input_tensor.shape().to_dims()),
+            });
+            restore.push(TensorBinding::address(handle, original));
+        }
+        Ok(())
+    }
+
+    fn bind_outputs(
+        tensors: &HashMap<String, Tensor>,
+        handles: &HashMap<String, TensorHandle>,
+        slots: &[SlotBinding],
+        output_dict: &HashMap<&str, &Tensor>,
+        stream: &CuStream,
+        bindings: &mut Vec<TensorBinding>,
+        restore: &mut Vec<TensorBinding>,
+    ) -> TRTResult<()> {
+        for (name, output_tensor) in output_dict {
+            let (tensor, handle) = match (tensors.get(*name), handles.get(*name)) {
+                (Some(tensor), Some(&handle)) => (tensor, handle),
+                _ => return Err(TRTError::TensorNotFound(name.to_string())),
+            };
+            if tensor.dtype() != output_tensor.dtype() {
+                return Err(TRTError::DTypeMismatch);
+            }
+
+            let (ptr, original) = match slots.get(handle as usize) {
+                Some(binding) => {
+                    let ptr = Self::caller_address(binding, output_tensor, stream)?;
+                    (ptr, Self::binding_address(tensor, binding.on_host))
+                }
+                None => (unsafe { output_tensor.get_raw_ptr() }, unsafe { tensor.get_raw_ptr() }),
+            };
+            bindings.push(TensorBinding::output(handle, ptr, output_tensor.capacity()));
+            restore.push(TensorBinding::address(handle, original));
+        }
+        Ok(())
+    }
+
+    fn apply_bindings(context: &mut ExecutionContext, bindings: &[TensorBinding]) -> TRTResult<()> {
+        if bindings.is_empty() {
+            return Ok(());
+        }
+        match context.apply_bindings(bindings) {
+            status if status.is_ok() => Ok(()),
+            status => Err(Self::binding_error(status, bindings)),
+        }
+    }
+
+    // The error the per-tensor calls would have returned for the failed binding.
+    fn binding_error(status: BindingStatus, bindings: &[TensorBinding]) -> TRTError {
+        let binding = status.failed_index().and_then(|index| bindings.get(index));
+        match (status.error, binding) {
+            (BindingError::SHAPE, Some(binding)) => TRTError::ShapeError(binding.dims.as_slice().to_vec()),
+            (BindingError::CAPACITY, _) => TRTError::ShapeMismatch,
+            (BindingError::ENQUEUE, _) => TRTError::EnqueueError,
+            _ => TRTError::InvalidAddress,
+        }
+    }
+
+    fn check_launch(core: &Option<Arc<EngineCore>>, status: BindingStatus, bindings: &[TensorBinding]) -> TRTResult<()> {
+        match status.error {
+            BindingError::NONE => Ok(()),
+            BindingError::ENQUEUE => Err(Self::replay_log_on_failure(core, TRTError::EnqueueError)),
+            _ => Err(Self::binding_error(status, bindings)),
+        }
+    }
+
+    // Shrinks the engine-owned outputs from their max-shape allocation to the shapes inferred
+    // for the current inputs, so callers only read back the valid elements. Data-dependent
+    // outputs are not in `tensors` until enqueue and are sized by their allocator.
+    fn resolve_output_shapes(
+        context: &mut ExecutionContext,
+        shapes: &mut ShapeTracker,
+        tensors: &mut HashMap<String, Tensor>,
+        output_names: &[String],
+        output_handles: &[TensorHandle],
+    ) -> TRTResult<()> {
+        let _range = nvtx::range!(Category::Shape, "resolve output shapes");
+        // input shapes seen before resolve without any bridge call
+        if let Some(resolved) = shapes.cached_outputs() {
+            return Self::apply_output_shapes(tensors, output_names, resolved);
+        }
+        let missing = context.infer_shapes();
+        if missing != 0 {
+            return Err(TRTError::ShapeInferenceError(missing));
+        }
+        let mut resolved = vec![TensorDims::invalid(); output_handles.len()];
+        context.get_tensor_dims_many(output_handles, &mut resolved);
+        Self::apply_output_shapes(tensors, output_names, &resolved)?;
+        shapes.cache_outputs(resolved);
+        Ok(())
+    }
+
+    fn apply_output_shapes(
+        tensors: &mut HashMap<String, Tensor>,
+        output_names: &[String],
+        resolved: &[TensorDims],
+    ) -> TRTResult<()> {
+        for (name, dims) in output_names.iter().zip(resolved.iter()) {
+            let tensor = match tensors.get_mut(name) {
+                Some(tensor) => tensor,
+                None => continue,
+            };
+            if !dims.is_valid() {
+                continue;
+            }
+            let shape = Shape::from(*dims);
+            if shape.iter().any(|&dim| dim < 0) || shape == *tensor.shape() {
+                continue;
+            }
+            if !tensor.can_hold(shape.size()) {
+                return Err(TRTError::ShapeError(shape.to_vec()));
+            }
+            unsafe { tensor.reset_shape(&shape)? };
+        }
+        Ok(())
+    }
+
+    fn collect_dynamic_outputs(
+        dynamic_outputs: &HashMap<String, GrowableOutput>,
+        tensors: &mut HashMap<String, Tensor>,
+        stream: &CuStream,
+    ) {
+        for (name, output) in dynamic_outputs.iter() {
+            if let Some(tensor) = output.tensor(stream) {
+                tensors.insert(name.clone(), tensor);
+            }
+        }
+    }
+
+    // Enqueues like inference and resolves once the outputs are ready, without blocking a
+    // thread in stream.synchronize(). Any executor can drive the returned future.
+    pub async fn inference_async(
+        &mut self,
+        feed_dict: &HashMap<&str, &Tensor>,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<&HashMap<String, Tensor>> {
+        let stream = match stream {
+            Some(stream) => stream.clone(),
+            None => self.stream.clone(),
+        };
+        self.inference(feed_dict, Some(&stream))?;
+        StreamCompletion::new(&stream)?.await;
+        Ok(&self.tensors)
+    }
+
+    // Counts requests, host enqueue time and copied bytes into the metrics registered as
+    // `name`, shared with every engine enabled under the same name. With `gpu_timing`, device
+    // and copy times of every call are measured with event triples from a recycled pool, and
+    // gathered without waiting once the call's work completed.
+    pub fn enable_metrics(&mut self, name: &str, gpu_timing: bool) -> TRTResult<Arc<EngineMetrics>> {
+        let metrics = MetricsRegistry::global().register(name);
+        self.instrumentation = Some(Instrumentation::new(metrics.clone(), gpu_timing)?);
+        metrics.set_startup(&self.startup);
+        Ok(metrics)
+    }
+
+    // Wall time of every startup phase this engine went through: plan read, runtime creation
+    // and deserialization when it loaded its plan itself, then context creation, IO
+    // allocation and warmup. StartupTimings::to_json reports them.
+    pub fn startup_timings(&self) -> &StartupTimings {
+        &self.startup
+    }
+
+    // Attributes `duration` to `phase`, for phases that run outside the engine, e.g.
+    // PluginManager::load_time as StartupPhase::PluginLoad; published to the engine's metrics.
+    pub fn record_startup(&mut self, phase: StartupPhase, duration: Duration) {
+        self.startup.record(phase, duration);
+        if let Some(metrics) = self.metrics() {
+            metrics.set_startup(&self.startup);
+        }
+    }
 
-pub struct TRTEngine {
-    runtime: Option<Runtime>,
-    engine: Option<CudaEngine>,
-    context: Option<ExecutionContext>,
-    stream: CuStream,
-    tensors: HashMap<String, Tensor>,
-}
+    pub fn disable_metrics(&mut self) {
+        self.instrumentation = None;
+    }
 
-impl TRTEngine {
-    pub fn new<P: AsRef<Path>>(engine_path: &P, stream: &CuStream) -> TRTResult<Self> {
-        let mut runtime = match Runtime::new() {
-            Some(runtime) => runtime,
-            None => return Err(TRTError::RuntimeCreationError),
+    // Records the arrival, enqueue time and input shapes of every inference and
+    // inference_timed call to `trace`, which engines may share; None stops recording.
+    pub fn set_trace_recorder(&mut self, trace: Option<Arc<TraceRecorder>>) {
+        self.trace = trace;
+    }
+
+    pub fn trace_recorder(&self) -> Option<&Arc<TraceRecorder>> {
+        self.trace.as_ref()
+    }
+
+    // Traces every inference, inference_timed and execute call sampled by `spans`, which
+    // engines may share, as a "trt.enqueue" span of its host time and input shapes, with the
+    // device time of its input copies ("trt.upload") and of its work ("trt.gpu") as children.
+    // None stops tracing.
+    pub fn set_span_tracer(&mut self, spans: Option<Arc<SpanTracer>>) {
+        self.spans = spans;
+    }
+
+    pub fn span_tracer(&self) -> Option<&Arc<SpanTracer>> {
+        self.spans.as_ref()
+    }
+
+    // The trace the spans of the following calls belong to, e.g. the request being served
+    // (the DynamicBatcher sets its batch); None samples each call into a trace of its own.
+    pub fn set_span_parent(&mut self, parent: Option<TraceContext>) {
+        self.span_parent = parent;
+    }
+
+    pub fn span_parent(&self) -> Option<TraceContext> {
+        self.span_parent
+    }
+
+    // The timing of the inference_timed call numbered `sequence`, once its work completed.
+    // Each timing is returned once; the oldest are dropped when they are not taken.
+    pub fn gpu_timing(&mut self, sequence: u64) -> Option<InferenceTiming> {
+        self.instrumentation.as_mut()?.take_timing(sequence)
+    }
+
+    // Every completed timing not taken yet, including those of calls other than
+    // inference_timed.
+    pub fn drain_gpu_timings(&mut self) -> Vec<InferenceTiming> {
+        match self.instrumentation.as_mut() {
+            Some(instrumentation) => instrumentation.drain_timings(),
+            None => Vec::new(),
+        }
+    }
+
+    pub fn metrics(&self) -> Option<&Arc<EngineMetrics>> {
+        self.instrumentation.as_ref().map(|instrumentation| instrumentation.metrics())
+    }
+
+    // Current device bytes held by the growable buffers of data-dependent outputs.
+    pub fn dynamic_output_capacity(&self) -> usize {
+        self.dynamic_outputs.values().map(|output| output.capacity()).sum()
+    }
+
+    pub fn input_names(&self) -> &[String] {
+        &self.input_names
+    }
+
+    pub fn output_names(&self) -> &[String] {
+        &self.output_names
+    }
+
+    // The engine-owned IO buffer bound for `name` by allocate_io_tensors.
+    pub fn get_tensor(&self, name: &str) -> Option<&Tensor> {
+        self.tensors.get(name)
+    }
+
+    // Makes room for `elements` elements in the engine-owned buffer `name`: growable
+    // buffers (IoMemory::Growable) map more memory at the same address, others must
+    // already be large enough.
+    pub fn reserve_tensor(&mut self, name: &str, elements: usize) -> TRTResult<()> {
+        match self.tensors.get_mut(name) {
+            Some(tensor) => tensor.reserve(elements),
+            None => Err(TRTError::TensorNotFound(name.to_string())),
+        }
+    }
+
+    // Memory layout of the engine-owned buffer `name`, e.g. CHW32 for an INT8 input.
+    pub fn get_tensor_layout(&self, name: &str) -> Option<TensorLayout> {
+        self.layouts.get(name).copied()
+    }
+
+    // Sets the shape of input `name` to that of the linear tensor `src` and converts it into
+    // the engine-owned buffer in the binding's layout, so engines with vectorized IO can be
+    // fed without TensorRT's reformat layers. Follow with execute.
+    pub fn copy_input_from_linear(&mut self, name: &str, src: &Tensor, stream: Option<&CuStream>) -> TRTResult<()> {
+        self.set_input_shape(name, src.shape())?;
+        let (tensor, layout) = match (self.tensors.get(name), self.layouts.get(name)) {
+            (Some(tensor), Some(layout)) => (tensor, layout),
+            _ => return Err(TRTError::TensorNotFound(name.to_string())),
+        };
+        layout.from_linear(src, tensor, stream.unwrap_or(&self.stream))
+    }
+
+    // Converts the engine-owned output `name` from its binding layout into the linear tensor
+    // `dst`, which must have the output's resolved shape (see get_tensor_shape).
+    pub fn copy_output_to_linear(&self, name: &str, dst: &Tensor, stream: Option<&CuStream>) -> TRTResult<()> {
+        let (tensor, layout) = match (self.tensors.get(name), self.layouts.get(name)) {
+            (Some(tensor), Some(layout)) => (tensor, layout),
+            _ => return Err(TRTError::TensorNotFound(name.to_string())),
         };
+        if tensor.dtype() != dst.dtype() {
+            return Err(TRTError::DTypeMismatch);
+        }
+        if self.get_tensor_shape(name)? != *dst.shape() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let ptr = unsafe { tensor.get_raw_ptr() };
+        layout.convert(dst, ptr, tensor.capacity(), false, stream.unwrap_or(&self.stream))
+    }
 
-        let data = fs::read(engine_path)?;
+    // Where allocate_io_tensors allocates the IO buffers; takes effect at its next call. The
+    // default is IoMemory::for_current_device: mapped host memory on integrated GPUs, where
+    // inputs are then written and outputs read in place through get_host_buffer.
+    pub fn set_io_memory(&mut self, memory: IoMemory) {
+        self.io_memory = memory;
+    }
 
-        let engine = match runtime.deserialize(data.as_slice()) {
-            Some(engine) => engine,
-            None => return Err(TRTError::EngineDeserializationError),
+    pub fn io_memory(&self) -> IoMemory {
+        self.io_memory
+    }
+
+    // Host view of the engine-owned IO buffer `name` at its current shape, when it is mapped
+    // or managed (see set_io_memory). Inputs written through it need no copy: pass the
+    // engine's own tensor to inference, or set_input_shape and execute.
+    // Safety: no enqueue of this context may be in flight.
+    pub unsafe fn get_host_buffer(&mut self, name: &str) -> TRTResult<&mut [u8]> {
+        let tensor = match self.tensors.get_mut(name) {
+            Some(tensor) => tensor,
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
         };
+        match tensor.host_slice_mut() {
+            Some(host) => Ok(host),
+            None => Err(TRTError::NotHostMapped(name.to_string())),
+        }
+    }
 
-        Ok(Self {
-            runtime: Some(runtime),
-            engine: Some(engine),
-            context: None,
-            stream: stream.clone(),
-            tensors: HashMap::new(),
-        })
+    // Sets the shape of an engine-owned input buffer, e.g. the batch size after a batching
+    // front end wrote rows directly into it. The shape must fit the allocated capacity.
+    pub fn set_input_shape(&mut self, name: &str, shape: &Shape) -> TRTResult<()> {
+        let context = match self.context.as_mut() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let tensor = match self.tensors.get_mut(name) {
+            Some(tensor) => tensor,
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
+        };
+        let handle = self.handles.get(name).copied();
+        Self::apply_input_shape(context, &mut self.shapes, tensor, name, handle, shape)
     }
 
-    // TODO: reuse device memory
-    pub fn activate(&mut self) -> TRTResult<()> {
-        let engine = match self.engine.as_mut() {
-            Some(engine) => engine,
-            None => return Err(TRTError::EngineCreationError),
+    // Sets the values of shape-tensor input `name`, e.g. the target size of a resize, in its
+    // pinned host buffer; a 1-D shape tensor takes the length of `values` as its shape.
+    // Follow with execute.
+    pub fn set_shape_tensor_values(&mut self, name: &str, values: &[i32]) -> TRTResult<()> {
+        let handle = self.handles.get(name).copied();
+        let (handle, binding) = match Self::shape_input(&self.slots, handle) {
+            Some(input) => input,
+            None => return Err(TRTError::NotShapeTensor(name.to_string())),
+        };
+        if values.len() > MAX_DIMS {
+            return Err(TRTError::ShapeError(values.to_vec()));
+        }
+        let shape = match self.tensors.get(name) {
+            Some(tensor) if tensor.shape().nb_dims() == 1 => Shape::new(&[values.len() as i32]),
+            Some(tensor) => *tensor.shape(),
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
         };
+        if shape.size() != values.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        self.set_input_shape(name, &shape)?;
+        Self::write_shape_values(&binding, handle, &mut self.shapes, &Shape::new(values))
+    }
 
-        self.context = match engine.create_execution_context() {
-            Some(context) => Some(context),
-            None => return Err(TRTError::ExecutionContextCreationError),
+    // Values of shape tensor `name`: those set for an input, or, for an output, those
+    // TensorRT computed on the host when the last request was enqueued.
+    pub fn get_shape_tensor_values(&self, name: &str) -> TRTResult<Vec<i32>> {
+        let binding = match self.handles.get(name).and_then(|&handle| self.slots.get(handle as usize)) {
+            Some(binding) if binding.shape_io && binding.ptr != 0 && binding.dtype == DataType::INT32 => binding,
+            _ => return Err(TRTError::NotShapeTensor(name.to_string())),
+        };
+        let len = match self.tensors.get(name) {
+            Some(tensor) => tensor.shape().size().min(binding.capacity),
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
+        };
+        Ok(unsafe { std::slice::from_raw_parts(binding.ptr as *const i32, len) }.to_vec())
+    }
+
+    // Shape of `name` as resolved by the context for the current input shapes.
+    pub fn get_tensor_shape(&self, name: &str) -> TRTResult<Shape> {
+        let context = match self.context.as_ref() {
+            Some(context) => context,
+            None => return Err(TRTError::ExecutionContextNotInitialized),
+        };
+        let dims = match self.handles.get(name) {
+            Some(&handle) => context.get_tensor_dims_by_handle(handle),
+            None => context.get_tensor_dims(name),
         };
+        if !dims.is_valid() {
+            return Err(TRTError::TensorNotFound(name.to_string()));
+        }
+        Ok(Shape::from(dims))
+    }
 
+    // Reduces output `name` on the GPU whenever it is read back by read_outputs or scattered by
+    // a DynamicBatcher, so only the result is copied to the host; None reads it back whole
+    // again. The output must be FLOAT or HALF.
+    pub fn attach_reduction(&mut self, name: &str, reduction: Option<OutputReduction>) -> TRTResult<()> {
+        match self.io_schema()?.get(name) {
+            Some(tensor) if tensor.is_output() => match tensor.dtype {
+                DataType::FLOAT | DataType::HALF => {}
+                _ => return Err(TRTError::DTypeMismatch),
+            },
+            _ => return Err(TRTError::TensorNotFound(name.to_string())),
+        }
+        match reduction {
+            Some(reduction) => self.reductions.insert(name.to_string(), ReducedOutput::new(reduction)),
+            None => self.reductions.remove(name),
+        };
         Ok(())
     }
 
-    pub fn allocate_io_tensors(
+    // The outputs of the reduction attached to output `name`, enqueued on `stream`, named as
+    // read_outputs names them; None when it has no reduction.
+    pub(crate) fn reduced_outputs(
         &mut self,
-        max_shape_dict: &HashMap<&str, &Shape>,
+        name: &str,
+        stream: &CuStream,
+    ) -> TRTResult<Option<Vec<(String, &Tensor)>>> {
+        if !self.reductions.contains_key(name) {
+            return Ok(None);
+        }
+        // execute leaves the output buffers at their last resolved shapes
+        let shape = self.get_tensor_shape(name)?;
+        if let Some(tensor) = self.tensors.get_mut(name).filter(|tensor| tensor.shape() != &shape) {
+            unsafe { tensor.reset_shape(&shape)? };
+        }
+        self.reduce_output(name, Some(stream))?;
+        let reduced = &self.reductions[name];
+        let mut outputs = Vec::new();
+        if let Some(result) = reduced.result.as_ref() {
+            outputs.push((name.to_string(), result));
+        }
+        if let Some(indices) = reduced.indices.as_ref() {
+            outputs.push((format!("{}/indices", name), indices));
+        }
+        Ok(Some(outputs))
+    }
+
+    // Enqueues the reduction attached to output `name` on `stream` and returns its result on
+    // the device, e.g. to pass normalized embeddings on to another engine.
+    pub fn reduce_output(&mut self, name: &str, stream: Option<&CuStream>) -> TRTResult<&Tensor> {
+        self.make_current()?;
+        let stream = stream.unwrap_or(&self.stream);
+        match (self.tensors.get(name), self.reductions.get_mut(name)) {
+            (Some(tensor), Some(reduced)) => reduced.run(tensor, stream),
+            _ => Err(TRTError::TensorNotFound(name.to_string())),
+        }
+    }
+
+    // Enqueues async copies of the named outputs into pooled pinned buffers on `stream` (the
+    // engine's stream by default), after the inference already queued there. Only the
+    // elements of each output's current shape are copied, or if a reduction is attached to
+    // the output, only its result, reduced on `stream` first.
+    pub fn read_outputs(
+        &mut self,
+        names: &[&str],
+        pool: &Arc<ReadbackPool>,
         stream: Option<&CuStream>,
-    ) -> TRTResult<()> {
-        let engine = match self.engine.as_mut() {
-            Some(engine) => engine,
-            None => return Err(TRTError::EngineCreationError),
+    ) -> TRTResult<Readback> {
+        self.make_current()?;
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
         };
+        for name in names {
+            if let (Some(tensor), Some(reduced)) = (self.tensors.get(*name), self.reductions.get_mut(*name)) {
+                reduced.run(tensor, stream)?;
+            }
+        }
+        let mut tensors = Vec::with_capacity(names.len());
+        for name in names {
+            let reduced = self.reductions.get(*name);
+            match (self.tensors.get(*name), reduced.and_then(|reduced| reduced.result.as_ref())) {
+                (Some(_), Some(result)) => tensors.push((name.to_string(), result)),
+                (Some(tensor), None) => tensors.push((name.to_string(), tensor)),
+                (None, _) => return Err(TRTError::TensorNotFound(name.to_string())),
+            }
+            if let Some(indices) = reduced.and_then(|reduced| reduced.indices.as_ref()) {
+                tensors.push((format!("{}/indices", name), indices));
+            }
+        }
+        let tensors: Vec<(&str, &Tensor)> = tensors.iter().map(|(name, tensor)| (name.as_str(), *tensor)).collect();
+        Readback::enqueue(&tensors, pool, stream)
+    }
 
-        let context: &mut ExecutionContext = match self.context.as_mut() {
+    // Like read_outputs, but into a caller-owned pinned buffer. The copy is only enqueued; the
+    // caller synchronizes `stream` before reading `dst`, and keeps it alive until then.
+    pub unsafe fn read_output_into(
+        &self,
+        name: &str,
+        dst: &mut PinnedMemory,
+        stream: Option<&CuStream>,
+    ) -> TRTResult<Shape> {
+        let stream = match stream {
+            Some(stream) => stream,
+            None => &self.stream,
+        };
+        let tensor = match self.tensors.get(name) {
+            Some(tensor) => tensor,
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
+        };
+        let size = tensor.size_in_bytes();
+        if size > dst.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        if !memcpy_async(dst.get_raw(), tensor.get_raw_ptr(), size, MemcpyKind::DeviceToHost, stream) {
+            return Err(TRTError::MemcpyError);
+        }
+        Ok(*tensor.shape())
+    }
+
+    // Enqueues on the already-filled engine-owned input buffers, without any input copies.
+    // With CUDA graphs enabled, enqueueV3 is replayed from a graph per input shapes, e.g. for
+    // the batches of a DynamicBatcher.
+    pub fn execute(&mut self, stream: Option<&CuStream>) -> TRTResult<&HashMap<String, Tensor>> {
+        self.metered(stream, || 0, |engine, _| engine.run_execute(stream))?;
+        Ok(&self.tensors)
+    }
+
+    fn run_execute(&mut self, stream: Option<&CuStream>) -> TRTResult<()> {
+        let context = match self.context.as_mut() {
             Some(context) => context,
             None => return Err(TRTError::ExecutionContextNotInitialized),
         };
@@ -73,96 +2984,509 @@ impl TRTEngine {
             Some(stream) => stream,
             None => &self.stream,
         };
+        let lane = self.lane.map(|index| &self.lanes[index]);
+        let core = &self.core;
+        let enqueue = |context: &mut ExecutionContext| match Self::launch(context, lane, stream) {
+            true => Ok(()),
+            false => Err(Self::replay_log_on_failure(core, TRTError::EnqueueError)),
+        };
 
-        let num_io_tensors = engine.get_num_io_tensors();
+        // as in inference: nothing the host does inside enqueue may be needed
+        let replayable = self.dynamic_outputs.is_empty() && !self.shapes.tracks_values() && !self.host_io;
+        let graphs = match replayable && !self.profiled {
+            true => self.graphs.as_mut(),
+            false => None,
+        };
+        let graphs = match graphs {
+            Some(graphs) => graphs,
+            None => return enqueue(context),
+        };
+        // only enqueueV3 is captured, over the engine-owned buffers, which reserve_tensor may
+        // move; a moved buffer updates the graph
+        let tensors = &self.tensors;
+        let shapes = self
+            .input_names
+            .iter()
+            .filter_map(|name| tensors.get(name).map(|tensor| (name.clone(), *tensor.shape())))
+            .collect();
+        let mut names: Vec<&String> = tensors.keys().collect();
+        names.sort_unstable();
+        let addresses = names.iter().map(|name| unsafe { tensors[*name].get_raw_ptr() }).collect();
+        let key = GraphKey::from_shapes(shapes)
+            .with_addresses(addresses)
+            .with_priority(lane.map(|lane| lane.priority()));
+        match graphs.replay(&key, stream, || enqueue(context)) {
+            Some(res) => res,
+            None => {
+                enqueue(context)?;
+                graphs.capture(key, stream, || enqueue(context))
+            }
+        }
+    }
 
-        for i in 0..num_io_tensors {
-            let name = engine.get_io_tensor_name(i);
-            let shape = engine.get_tensor_shape(name);
-            let shape = Shape(shape);
-            let shape = match max_shape_dict.get(name) {
-                Some(max_shape) => max_shape,
-                None => &shape,
-            };
-            if shape.0.iter().any(|&dim| dim < 0) {
-                return Err(TRTError::ShapeError(shape.0.clone()));
+    fn launch(context: &mut ExecutionContext, lane: Option<&PriorityLane>, stream: &CuStream) -> bool {
+        Self::launch_bound(context, &[], lane, stream).is_ok()
+    }
+
+    // Applies `bindings` and enqueues in a single call into the bridge.
+    fn launch_bound(
+        context: &mut ExecutionContext,
+        bindings: &[TensorBinding],
+        lane: Option<&PriorityLane>,
+        stream: &CuStream,
+    ) -> BindingStatus {
+        let _range = nvtx::range!(Category::Enqueue, "enqueueV3");
+        let lane = match lane {
+            Some(lane) => lane,
+            None => return context.apply_bindings_and_enqueue(bindings, stream),
+        };
+        let mut status = BindingStatus::enqueue_failed();
+        let joined = lane.enqueue_with(stream, |lane_stream| {
+            status = context.apply_bindings_and_enqueue_raw(bindings, lane_stream);
+            status.is_ok()
+        });
+        match (joined, status.is_ok()) {
+            (false, true) => BindingStatus::enqueue_failed(),
+            _ => status,
+        }
+    }
+
+    // The tensor is compared against the shape the context last accepted rather than the
+    // buffer's, as the indexed and bound paths apply request shapes without resizing it.
+    fn apply_input_shape(
+        context: &mut ExecutionContext,
+        shapes: &mut ShapeTracker,
+        tensor: &mut Tensor,
+        name: &str,
+        handle: Option<TensorHandle>,
+        shape: &Shape,
+    ) -> TRTResult<()> {
+        if tensor.shape() != shape {
+            unsafe { tensor.reset_shape(shape)? };
+        }
+        let _range = nvtx::range!(Category::Shape, "set input shape");
+        let applied = match handle {
+            Some(handle) if shapes.is_applied(handle, shape) => return Ok(()),
+            Some(handle) => context.set_input_dims_by_handle(handle, &shape.to_dims()),
+            None => context.set_input_shape(name, shape.as_slice()),
+        };
+        if !applied {
+            shapes.invalidate();
+            return Err(TRTError::ShapeError(shape.to_vec()));
+        }
+        if let Some(handle) = handle {
+            shapes.record(handle, *shape);
+        }
+        Ok(())
+    }
+
+    // Shape tensors are bound by their host address, every other buffer by its device one.
+    fn binding_address(tensor: &Tensor, on_host: bool) -> usize {
+        match (on_host, tensor.host_ptr()) {
+            (true, Some(ptr)) => ptr,
+            _ => unsafe { tensor.get_raw_ptr() },
+        }
+    }
+
+    // Where a caller's tensor is bound for a slot. Host-located inputs in device memory are
+    // staged through the slot's host buffer, which TensorRT reads as it enqueues; host-located
+    // outputs must be host memory.
+    fn caller_address(binding: &SlotBinding, tensor: &Tensor, stream: &CuStream) -> TRTResult<usize> {
+        if !binding.on_host {
+            return Ok(unsafe { tensor.get_raw_ptr() });
+        }
+        if let Some(ptr) = tensor.host_ptr() {
+            return Ok(ptr);
+        }
+        if !binding.is_input || binding.ptr == 0 || tensor.shape().size() > binding.capacity {
+            return Err(TRTError::InvalidAddress);
+        }
+        let size = tensor.shape().size() * tensor.dtype().get_elem_size();
+        if !unsafe { memcpy_async(binding.ptr, tensor.get_raw_ptr(), size, MemcpyKind::DeviceToHost, stream) } {
+            return Err(TRTError::MemcpyError);
+        }
+        stream.synchronize()?;
+        Ok(binding.ptr)
+    }
+
+    fn shape_input(slots: &[SlotBinding], handle: Option<TensorHandle>) -> Option<(TensorHandle, SlotBinding)> {
+        let handle = handle?;
+        match slots.get(handle as usize) {
+            Some(binding) if binding.shape_io && binding.is_input => Some((handle, *binding)),
+            _ => None,
+        }
+    }
+
+    // The values of a request's shape tensor: read in place from host-mapped tensors, else
+    // copied back, which synchronizes `stream`.
+    fn read_shape_values(tensor: &Tensor, stream: &CuStream) -> TRTResult<Shape> {
+        if tensor.dtype() != DataType::INT32 {
+            return Err(TRTError::DTypeMismatch);
+        }
+        let len = tensor.shape().size();
+        if len > MAX_DIMS {
+            return Err(TRTError::ShapeError(tensor.shape().to_vec()));
+        }
+        let mut values = [0i32; MAX_DIMS];
+        match unsafe { tensor.host_slice() } {
+            Some(bytes) => {
+                for (value, bytes) in values.iter_mut().zip(bytes.chunks_exact(4)) {
+                    *value = i32::from_ne_bytes([bytes[0], bytes[1], bytes[2], bytes[3]]);
+                }
             }
-            if engine.get_tensor_io_mode(name).is_input() {
-                if !context.set_input_shape(name, shape.0.as_slice()) {
-                    return Err(TRTError::ShapeError(shape.0.clone()));
+            None => {
+                let size = len * DataType::INT32.get_elem_size();
+                let dst = values.as_mut_ptr() as usize;
+                if !unsafe { memcpy_async(dst, tensor.get_raw_ptr(), size, MemcpyKind::DeviceToHost, stream) } {
+                    return Err(TRTError::MemcpyError);
                 }
+                stream.synchronize()?;
             }
+        }
+        Ok(Shape::new(&values[..len]))
+    }
 
-            let dtype = engine.get_tensor_dtype(name);
-            let tensor = Tensor::empty(&shape, dtype, stream)?;
-            let ptr = unsafe { tensor.get_raw_ptr() };
-            self.tensors.insert(name.to_string(), tensor);
-            if !context.set_tensor_address(name, ptr as _) {
-                return Err(TRTError::InvalidAddress);
+    // TensorRT reads shape-tensor values on the host when a request is enqueued, so they are
+    // rewritten without waiting for work in flight, and not at all while unchanged.
+    fn write_shape_values(
+        binding: &SlotBinding,
+        handle: TensorHandle,
+        shapes: &mut ShapeTracker,
+        values: &Shape,
+    ) -> TRTResult<()> {
+        if shapes.values_applied(handle, values) {
+            return Ok(());
+        }
+        if binding.dtype != DataType::INT32 {
+            return Err(TRTError::DTypeMismatch);
+        }
+        if binding.ptr == 0 || values.len() > binding.capacity {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let host = unsafe { std::slice::from_raw_parts_mut(binding.ptr as *mut i32, values.len()) };
+        host.copy_from_slice(values);
+        shapes.record_values(handle, *values);
+        Ok(())
+    }
+
+    // `copied` is recorded once the input copies are issued, for the copy time of metrics and
+    // spans.
+    fn enqueue<'a, I: Iterator<Item = (&'a str, &'a Tensor)>>(
+        context: &mut ExecutionContext,
+        tensors: &mut HashMap<String, Tensor>,
+        casts: Option<&HashMap<String, f32>>,
+        inputs: I,
+        lane: Option<&PriorityLane>,
+        copied: &[Option<&CudaEvent>],
+        stream: &CuStream,
+    ) -> TRTResult<()> {
+        let copies = nvtx::range!(Category::Copy, "copy inputs");
+        let mut host_inputs = false;
+        for (name, input_tensor) in inputs {
+            if let Some(tensor) = tensors.get_mut(name) {
+                host_inputs |= tensor.host_ptr().is_some();
+                match casts {
+                    Some(scales) if tensor.dtype() != input_tensor.dtype() => {
+                        let scale = scales.get(name).copied().unwrap_or(1.0);
+                        tensor.copy_from_cast(input_tensor, scale, stream)?;
+                    }
+                    _ => tensor.copy_from(input_tensor, Some(stream))?,
+                }
             }
         }
+        for copied in copied.iter().flatten() {
+            copied.record(stream);
+        }
+        // host-located inputs are read by TensorRT as it enqueues
+        if host_inputs {
+            stream.synchronize()?;
+        }
+        drop(copies);
 
-        // TODO: validate shapes, (batch size)
+        if !Self::launch(context, lane, stream) {
+            return Err(TRTError::EnqueueError);
+        }
 
         Ok(())
     }
 
-    // TODO: use cuda graph
-    pub fn inference(
-        &mut self,
-        feed_dict: &HashMap<&str, &Tensor>,
-        stream: Option<&CuStream>,
-    ) -> TRTResult<&HashMap<String, Tensor>> {
-        let context: &mut ExecutionContext = match self.context.as_mut() {
+    pub fn log(&mut self, level: Severity, msg: &str) {
+        let core = self.core.as_ref().unwrap();
+        core.runtime.lock().unwrap().logger().log(level, msg);
+    }
+
+    // Keeps the runtime's verbose messages in an in-memory ring of `capacity` lines, while
+    // only those within the logger's level are written out. The ring is replayed through the
+    // regular sinks whenever enqueueV3 fails.
+    pub fn enable_log_capture(&mut self, capacity: usize) -> bool {
+        let core = self.core.as_ref().unwrap();
+        let mut runtime = core.runtime.lock().unwrap();
+        runtime.logger().enable_capture(capacity, Severity::Verbose)
+    }
+
+    pub fn dump_log(&self, lines: usize) -> Vec<String> {
+        let core = self.core.as_ref().unwrap();
+        let mut runtime = core.runtime.lock().unwrap();
+        runtime.logger().dump_captured(lines)
+    }
+
+    fn replay_log_on_failure(core: &Option<Arc<EngineCore>>, err: TRTError) -> TRTError {
+        if let (TRTError::EnqueueError, Some(core)) = (&err, core) {
+            core.runtime.lock().unwrap().logger().replay_captured();
+        }
+        err
+    }
+
+    // TensorRT reports the errors of this context (e.g. why an enqueue failed) to `recorder`,
+    // instead of the one the context was activated with, as well as to the log; it stays
+    // attached across recover and reactivation.
+    pub fn set_error_recorder(&mut self, recorder: Arc<ErrorRecorder>) -> TRTResult<()> {
+        let context = match self.context.as_mut() {
             Some(context) => context,
             None => return Err(TRTError::ExecutionContextNotInitialized),
         };
-        let stream = match stream {
-            Some(stream) => stream,
-            None => &self.stream,
-        };
+        context.set_error_recorder(&recorder);
+        self.faults.recorder = Some(recorder);
+        Ok(())
+    }
 
-        for (name, input_tensor) in feed_dict {
-            let tensor = match self.tensors.get_mut(name.to_owned()) {
-                Some(tensor) => tensor,
-                None => continue,
+    pub fn error_recorder(&self) -> Option<&Arc<ErrorRecorder>> {
+        self.faults.recorder.as_ref()
+    }
+
+    // Recreates the context (see recover) after a request fails to enqueue or raises a
+    // recoverable asynchronous error, so only that request fails.
+    pub fn set_auto_recover(&mut self, enabled: bool) {
+        self.faults.auto_recover = enabled;
+    }
+
+    // How often the context has been recreated by recover.
+    pub fn num_recoveries(&self) -> u64 {
+        self.faults.recoveries
+    }
+
+    // Marks the end of the work enqueued on `stream` so far, e.g. one request, for
+    // poll_completion.
+    pub fn record_completion(&mut self, stream: Option<&CuStream>) -> TRTResult<()> {
+        if self.faults.completion.is_none() {
+            self.faults.completion = match self.faults.wait.create_event() {
+                Some(event) => Some(event),
+                None => return Err(TRTError::EventError),
             };
-            let new_shape = input_tensor.shape();
-            if tensor.shape() != new_shape {
-                unsafe { tensor.reset_shape(new_shape)? };
-                if !context.set_input_shape(name, new_shape.0.as_slice()) {
-                    return Err(TRTError::ShapeError(new_shape.0.clone()));
-                }
-            }
-            tensor.copy_from(input_tensor, Some(stream))?;
         }
+        let event = self.faults.completion.as_ref().unwrap();
+        match event.record(stream.unwrap_or(&self.stream)) {
+            true => Ok(()),
+            false => Err(TRTError::EventError),
+        }
+    }
+
+    // Without blocking: false while the work marked by record_completion runs, true once it
+    // completed, or the asynchronous error it raised as with synchronize_checked.
+    pub fn poll_completion(&mut self) -> TRTResult<bool> {
+        let status = match self.faults.completion.as_ref() {
+            Some(event) => event.query_status(),
+            None => return Ok(true),
+        };
+        if status == CudaStatus::NOT_READY {
+            return Ok(false);
+        }
+        self.check_completion(status).map(|_| true)
+    }
 
-        // TODO: validate shapes, (batch size)
+    // Waits for the work enqueued on `stream` and attributes an asynchronous CUDA error it
+    // raised to this engine's request, instead of surfacing at some later synchronize:
+    // AsyncCudaError (after which set_auto_recover recreates the context), or
+    // StickyCudaError when the error corrupted the CUDA context of the whole process.
+    // How the wait is made is set by set_wait_strategy.
+    pub fn synchronize_checked(&mut self, stream: Option<&CuStream>) -> TRTResult<()> {
+        self.make_current()?;
+        self.record_completion(stream)?;
+        let event = self.faults.completion.as_ref().unwrap();
+        let status = self.faults.wait.wait(event, stream.unwrap_or(&self.stream));
+        self.check_completion(status)
+    }
 
-        if !context.enqueue_v3(stream) {
-            return Err(TRTError::EnqueueError);
+    // E.g. Spin for the contexts of a latency tier and BlockingSync for those of a batch tier.
+    pub fn set_wait_strategy(&mut self, strategy: WaitStrategy) {
+        let blocking = |strategy: WaitStrategy| strategy == WaitStrategy::BlockingSync;
+        if blocking(strategy) != blocking(self.faults.wait) {
+            // recreated on the next record_completion, with the flags the strategy needs
+            self.faults.completion = None;
         }
+        self.faults.wait = strategy;
+    }
 
-        Ok(&self.tensors)
+    pub fn wait_strategy(&self) -> WaitStrategy {
+        self.faults.wait
     }
 
-    pub fn log(&mut self, level: Severity, msg: &str) {
-        self.runtime.as_mut().unwrap().logger().log(level, msg);
+    fn check_completion(&mut self, status: CudaStatus) -> TRTResult<()> {
+        if status.is_success() {
+            return Ok(());
+        }
+        if status.is_sticky() {
+            return Err(TRTError::StickyCudaError(status.0, status.name()));
+        }
+        // reset so that it is not reported again by an unrelated call
+        CudaStatus::take_last();
+        if self.faults.auto_recover {
+            self.recover()?;
+        }
+        Err(TRTError::AsyncCudaError(status.0, status.name()))
+    }
+
+    // The errors TensorRT reported for this context since the last call, or before it is
+    // activated, those reported to the engine's recorder (e.g. while deserializing).
+    pub fn take_recorded_errors(&self) -> Vec<RecordedError> {
+        match (self.faults.recorder.as_ref(), self.core.as_ref()) {
+            (Some(recorder), _) => recorder.take_errors(),
+            (None, Some(core)) => core.recorder.take_errors(),
+            (None, None) => Vec::new(),
+        }
+    }
+
+    fn recover_on_failure(&mut self, res: TRTResult<()>) -> TRTResult<()> {
+        let err = match res {
+            Ok(()) => return Ok(()),
+            Err(err) => err,
+        };
+        let err = match self.take_recorded_errors() {
+            recorded if recorded.is_empty() => err,
+            recorded => TRTError::Recorded(Box::new(err), recorded),
+        };
+        if !self.faults.auto_recover || !matches!(err.root(), TRTError::EnqueueError | TRTError::GraphLaunchError) {
+            return Err(err);
+        }
+        let status = CudaStatus::take_last();
+        if status.is_sticky() {
+            return Err(TRTError::StickyCudaError(status.0, status.name()));
+        }
+        // the request fails either way; the next one runs on the new context
+        if let Err(recovery) = self.recover() {
+            self.log(Severity::Error, &format!("Context recovery failed: {}", recovery));
+        }
+        Err(err)
+    }
+
+    // Replaces the execution context, e.g. after a failed enqueue left it in an unknown
+    // state, with a new one in the same optimization profile with the same input shapes, IO
+    // tensors, data-dependent output allocators and error recorder. Captured CUDA graphs are
+    // dropped; a profiler, input-consumed event, L2 persistence or temporary storage
+    // allocator has to be set again. Sticky errors cannot be recovered from in-process.
+    pub fn recover(&mut self) -> TRTResult<()> {
+        let profile = self.get_optimization_profile()?;
+        let shapes = std::mem::take(&mut self.shapes);
+        let static_shapes = self.static_shapes;
+        match (self.arena.clone(), self.scratch.is_some()) {
+            (Some(arena), _) => self.attach_arena(&arena, Some(profile))?,
+            (None, true) => self.replace_context_for_profile(profile)?,
+            (None, false) => self.replace_context()?,
+        }
+        self.shapes = shapes;
+        self.static_shapes = static_shapes;
+
+        let context = self.context.as_mut().unwrap();
+        let switch = context.get_optimization_profile() != profile;
+        if switch && !context.set_optimization_profile_async(profile, &self.stream) {
+            return Err(TRTError::ProfileError(profile));
+        }
+        for (name, output) in self.dynamic_outputs.iter() {
+            if !context.set_output_allocator(name, output.allocator(&self.stream)) {
+                return Err(TRTError::OutputAllocatorError);
+            }
+        }
+        self.rebind_io_tensors()?;
+        self.faults.recoveries += 1;
+        Ok(())
+    }
+
+    // Bounds the log volume of warnings TensorRT repeats on every request; see
+    // Logger::enable_rate_limit.
+    pub fn set_log_rate_limit(&mut self, rate_per_sec: f64, burst: u32, dedup_window: Duration) -> bool {
+        let core = self.core.as_ref().unwrap();
+        let mut runtime = core.runtime.lock().unwrap();
+        runtime.logger().enable_rate_limit(rate_per_sec, burst, dedup_window)
+    }
+
+    // Routes the runtime's log messages into `callback` (e.g. tracing) instead of stdout.
+    pub fn set_log_callback<F>(&mut self, callback: F)
+    where
+        F: Fn(Severity, &str) + Send + Sync + 'static,
+    {
+        let core = self.core.as_ref().unwrap();
+        core.runtime.lock().unwrap().logger().set_callback(callback);
+    }
+
+    // Only affects this engine (and the contexts sharing it); other engines keep their level.
+    pub fn set_log_level(&mut self, level: Severity) {
+        let core = self.core.as_ref().unwrap();
+        core.runtime.lock().unwrap().logger().set_level(level);
+    }
+
+    // Switches the runtime's logger (shared by every context of this engine) to the
+    // asynchronous backend.
+    pub fn set_async_logging(&mut self, queue_size: usize, policy: AsyncOverflowPolicy) -> bool {
+        let core = self.core.as_ref().unwrap();
+        core.runtime.lock().unwrap().logger().set_async(queue_size, policy)
     }
 }
 
+// Vouches only for the cuda-rs stream and device buffers (`stream`, `scratch` and those in
+// `tensors`, the outputs and graphs), whose raw handles carry no thread affinity and are only
+// ever driven by the thread that currently holds the engine, e.g. through an EnginePool
+// checkout. The rest must be Send on its own; see assert_send_fields.
+unsafe impl Send for TRTEngine {}
+
+#[allow(dead_code)]
+fn assert_send_fields(engine: &TRTEngine) {
+    fn send<T: Send>(_: &T) {}
+    send(&engine.core);
+    send(&engine.context);
+    send(&engine.context_memory);
+    send(&engine.handles);
+    send(&engine.layouts);
+    send(&engine.slots);
+    send(&engine.input_consumed);
+    send(&engine.profile_selector);
+    send(&engine.bucket_policies);
+    send(&engine.valid_shapes);
+    send(&engine.cast_scales);
+    send(&engine.aux_streams);
+    send(&engine.lanes);
+    send(&engine.sm_budget);
+    send(&engine.trace);
+    send(&engine.spans);
+    send(&engine.span_parent);
+    send(&engine.faults);
+    send(&engine.sampling);
+    send(&engine.startup);
+}
+
 impl Drop for TRTEngine {
     fn drop(&mut self) {
+        // the context and buffers are freed in the context they were created in
+        self.make_current().ok();
+
+        if let Some(graphs) = self.graphs.take() {
+            std::mem::drop(graphs);
+        }
+
         if let Some(context) = self.context.take() {
             std::mem::drop(context);
         }
 
-        if let Some(engine) = self.engine.take() {
-            std::mem::drop(engine);
+        // only after the context that records it is gone
+        self.input_consumed = None;
+
+        self.dynamic_outputs.clear();
+
+        if let Some(arena) = self.arena.take() {
+            std::mem::drop(arena);
         }
 
-        if let Some(runtime) = self.runtime.take() {
-            std::mem::drop(runtime);
+        if let Some(core) = self.core.take() {
+            std::mem::drop(core);
         }
     }
 }
@@ -0,0 +1,309 @@
+use crate::{
+    builder::{BuildOptions, EngineBuilder, TimingCacheFile},
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    plan::PlanLoadOptions,
+};
+use cuda_rs::stream::CuStream;
+use memmap2::Mmap;
+use std::{
+    fs::{self, File},
+    path::{Path, PathBuf},
+    process,
+};
+use tensorrt_rs_sys::{
+    device,
+    runtime::{get_infer_lib_version, HardwareCompatibilityLevel},
+};
+
+// What a cached plan was built from and for. Plans only deserialize on the compute
+// capability and TensorRT release they were built with, so both are part of the key.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub struct EngineCacheKey {
+    pub model_hash: u128,
+    pub compute_capability: i32,
+    pub trt_version: i32,
+    pub options_hash: u64,
+}
+
+impl EngineCacheKey {
+    pub fn new(model: &[u8], options: &BuildOptions, compute_capability: i32, trt_version: i32) -> Self {
+        let mut model_hash = Fnv1a::new();
+        model_hash.update(model);
+        Self {
+            model_hash: model_hash.finish(),
+            compute_capability,
+            trt_version,
+            options_hash: options_hash(options),
+        }
+    }
+
+    // The key of a variant of this key's engine, e.g. the engine refit with another set of
+    // weights, identified by `variant`. Variants are cached next to the built plan.
+    pub fn variant(&self, variant: &[u8]) -> Self {
+        let mut hash = Fnv1a::new();
+        hash.update(&self.options_hash.to_le_bytes());
+        hash.update(variant);
+        let hash = hash.finish();
+        Self { options_hash: (hash >> 64) as u64 ^ hash as u64, ..*self }
+    }
+
+    pub fn file_name(&self) -> String {
+        format!(
+            "{:032x}-sm{}-trt{}-{:016x}.plan",
+            self.model_hash, self.compute_capability, self.trt_version, self.options_hash,
+        )
+    }
+}
+
+// A directory of plans built from ONNX models, one per EngineCacheKey. A hit is loaded
+// through the mmap path of TRTEngine::with_options; a miss builds the plan for the current
+// device and stores it atomically, so concurrent processes never load a partial plan.
+// Only the .onnx file is hashed: external weight files must change together with it.
+pub struct EngineCache {
+    dir: PathBuf,
+    plan_options: PlanLoadOptions,
+    timing_cache: Option<TimingCacheFile>,
+}
+
+impl EngineCache {
+    pub fn new<P: Into<PathBuf>>(dir: P) -> TRTResult<Self> {
+        let dir = dir.into();
+        fs::create_dir_all(&dir)?;
+        Ok(Self {
+            dir,
+            plan_options: PlanLoadOptions::default(),
+            timing_cache: None,
+        })
+    }
+
+    pub fn with_plan_options(mut self, options: PlanLoadOptions) -> Self {
+        self.plan_options = options;
+        self
+    }
+
+    // Timing cache used by builds on a miss.
+    pub fn with_timing_cache(mut self, cache: TimingCacheFile) -> Self {
+        self.timing_cache = Some(cache);
+        self
+    }
+
+    pub fn key<P: AsRef<Path>>(&self, onnx_path: &P, options: &BuildOptions) -> TRTResult<EngineCacheKey> {
+        let device = match device::get_device() {
+            Some(device) => device,
+            None => return Err(TRTError::DeviceQueryError),
+        };
+        let compute_capability = match device::get_compute_capability(device) {
+            Some(capability) => capability,
+            None => return Err(TRTError::DeviceQueryError),
+        };
+        // one Ampere-compatible plan serves every node from sm_80 up
+        let compute_capability = match options.hardware_compatibility {
+            HardwareCompatibilityLevel::AMPEREPLUS => compute_capability.min(80),
+            _ => compute_capability,
+        };
+        let file = File::open(onnx_path)?;
+        let model = unsafe { Mmap::map(&file)? };
+        Ok(EngineCacheKey::new(&model, options, compute_capability, get_infer_lib_version()))
+    }
+
+    pub fn plan_path(&self, key: &EngineCacheKey) -> PathBuf {
+        self.dir.join(key.file_name())
+    }
+
+    // The engine for `onnx_path` on the current device, built on a miss.
+    pub fn load<P: AsRef<Path>>(
+        &self,
+        onnx_path: &P,
+        options: &BuildOptions,
+        stream: &CuStream,
+    ) -> TRTResult<TRTEngine> {
+        let path = self.plan_path(&self.key(onnx_path, options)?);
+        if let Some(engine) = self.try_load(&path, stream)? {
+            return Ok(engine);
+        }
+        self.build(onnx_path, options, &path)?;
+        TRTEngine::with_options(&path, &self.plan_options, stream)
+    }
+
+    // The engine cached under `key`; on a miss, the engine `create` returns, e.g. a base
+    // engine refit with new weights, after its plan is stored under `key`. A later process
+    // then deserializes the variant instead of creating it again.
+    pub fn load_or_create<F>(&self, key: &EngineCacheKey, stream: &CuStream, create: F) -> TRTResult<TRTEngine>
+    where
+        F: FnOnce() -> TRTResult<TRTEngine>,
+    {
+        if let Some(engine) = self.try_load(&self.plan_path(key), stream)? {
+            return Ok(engine);
+        }
+        let engine = create()?;
+        self.store(key, &engine)?;
+        Ok(engine)
+    }
+
+    // Stores the current plan of `engine` under `key`, refits included.
+    pub fn store(&self, key: &EngineCacheKey, engine: &TRTEngine) -> TRTResult<PathBuf> {
+        let plan = engine.serialize()?;
+        let path = self.plan_path(key);
+        write_plan(&path, &plan)?;
+        Ok(path)
+    }
+
+    fn try_load(&self, path: &Path, stream: &CuStream) -> TRTResult<Option<TRTEngine>> {
+        if !path.exists() {
+            return Ok(None);
+        }
+        match TRTEngine::with_options(&path, &self.plan_options, stream) {
+            Ok(engine) => Ok(Some(engine)),
+            // a truncated or foreign file under a valid key is replaced by the caller
+            Err(TRTError::EngineDeserializationError) => Ok(None),
+            Err(e) => Err(e),
+        }
+    }
+
+    fn build<P: AsRef<Path>>(&self, onnx_path: &P, options: &BuildOptions, path: &Path) -> TRTResult<()> {
+        let mut builder = EngineBuilder::new()?;
+        if let Some(cache) = &self.timing_cache {
+            builder = builder.with_timing_cache(cache.clone());
+        }
+        let plan = builder.build_onnx_file(onnx_path, options)?;
+        write_plan(path, plan.as_slice())
+    }
+}
+
+// Through a temporary file and a rename, so concurrent readers never see a partial plan.
+fn write_plan(path: &Path, plan: &[u8]) -> TRTResult<()> {
+    let mut tmp = path.to_path_buf().into_os_string();
+    tmp.push(format!(".{}.tmp", process::id()));
+    fs::write(&tmp, plan)?;
+    fs::rename(&tmp, path)?;
+    Ok(())
+}
+
+// FNV-1a: stable across processes and releases, unlike std's DefaultHasher.
+struct Fnv1a(u128);
+
+impl Fnv1a {
+    const OFFSET: u128 = 0x6c62272e07bb014262b821756295c58d;
+    const PRIME: u128 = 0x0000000001000000000000000000013b;
+
+    fn new() -> Self {
+        Self(Self::OFFSET)
+    }
+
+    fn update(&mut self, bytes: &[u8]) {
+        for &byte in bytes {
+            self.0 ^= byte as u128;
+            self.0 = self.0.wrapping_mul(Self::PRIME);
+        }
+    }
+
+    fn finish(&self) -> u128 {
+        self.0
+    }
+}
+
+fn options_hash(options: &BuildOptions) -> u64 {
+    let mut hash = Fnv1a::new();
+    let flags = [options.fp16, options.int8, options.tf32, options.refittable, options.sparse_weights];
+    hash.update(&flags.map(|flag| flag as u8));
+    // only when set, so keys of existing builds are unchanged
+    if options.weight_streaming {
+        hash.update(b"weight_streaming");
+    }
+    if options.strip_weights {
+        hash.update(b"strip_weights");
+    }
+    if options.hardware_compatibility != HardwareCompatibilityLevel::NONE {
+        hash.update(b"hardware_compatibility");
+        hash.update(&[options.hardware_compatibility as u8]);
+    }
+    if options.version_compatible {
+        hash.update(b"version_compatible");
+        hash.update(&[options.exclude_lean_runtime as u8]);
+    }
+    if let Some(core) = options.dla_core {
+        hash.update(b"dla");
+        hash.update(&core.to_le_bytes());
+        hash.update(&[options.gpu_fallback as u8]);
+    }
+    hash.update(&options.workspace_size.map_or(u64::MAX, |size| size as u64).to_le_bytes());
+    hash.update(&options.optimization_level.unwrap_or(-1).to_le_bytes());
+    hash.update(&(options.profiling_verbosity as i32).to_le_bytes());
+    for profile in &options.profiles {
+        // by name, so the map's iteration order does not change the key
+        let mut inputs = profile.iter().collect::<Vec<_>>();
+        inputs.sort_by(|a, b| a.0.cmp(b.0));
+        hash.update(&(inputs.len() as u32).to_le_bytes());
+        for (name, shape) in inputs {
+            hash.update(name.as_bytes());
+            for dims in [&shape.min, &shape.opt, &shape.max] {
+                hash.update(&(dims.nb_dims() as u32).to_le_bytes());
+                for dim in dims.iter() {
+                    hash.update(&dim.to_le_bytes());
+                }
+            }
+        }
+    }
+    let hash = hash.finish();
+    (hash >> 64) as u64 ^ hash as u64
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::{profile::ProfileShape, tensor::Shape};
+    use std::collections::HashMap;
+
+    #[test]
+    fn fnv1a_matches_reference_values() {
+        assert_eq!(Fnv1a::new().finish(), 0x6c62272e07bb014262b821756295c58d);
+        let mut hash = Fnv1a::new();
+        hash.update(b"a");
+        assert_eq!(hash.finish(), 0xd228cb696f1a8caf78912b704e4a8964);
+    }
+
+    #[test]
+    fn key_depends_on_every_component() {
+        let options = BuildOptions::default();
+        let key = EngineCacheKey::new(b"model", &options, 86, 8601);
+        assert_eq!(key, EngineCacheKey::new(b"model", &options, 86, 8601));
+        assert_ne!(key, EngineCacheKey::new(b"model2", &options, 86, 8601));
+        assert_ne!(key, EngineCacheKey::new(b"model", &options, 89, 8601));
+        assert_ne!(key, EngineCacheKey::new(b"model", &options, 86, 8602));
+
+        let fp16 = BuildOptions { fp16: true, ..BuildOptions::default() };
+        assert_ne!(key, EngineCacheKey::new(b"model", &fp16, 86, 8601));
+        assert_ne!(key.file_name(), EngineCacheKey::new(b"model", &fp16, 86, 8601).file_name());
+    }
+
+    #[test]
+    fn variants_get_their_own_plan() {
+        let key = EngineCacheKey::new(b"model", &BuildOptions::default(), 86, 8601);
+        let variant = key.variant(b"weights-v2");
+        assert_eq!(variant, key.variant(b"weights-v2"));
+        assert_ne!(variant, key.variant(b"weights-v3"));
+        assert_ne!(variant.file_name(), key.file_name());
+        assert_eq!((variant.model_hash, variant.compute_capability), (key.model_hash, key.compute_capability));
+    }
+
+    #[test]
+    fn options_hash_ignores_profile_map_order() {
+        let range = |max| ProfileShape {
+            min: Shape::new(&[1, 3]),
+            opt: Shape::new(&[4, 3]),
+            max: Shape::new(&[max, 3]),
+        };
+        let mut a = HashMap::new();
+        a.insert("x".to_string(), range(8));
+        a.insert("y".to_string(), range(16));
+        let mut b = HashMap::new();
+        b.insert("y".to_string(), range(16));
+        b.insert("x".to_string(), range(8));
+        let with = |profile| BuildOptions { profiles: vec![profile], ..BuildOptions::default() };
+        assert_eq!(options_hash(&with(a.clone())), options_hash(&with(b)));
+
+        a.insert("x".to_string(), range(32));
+        assert_ne!(options_hash(&with(a)), options_hash(&BuildOptions::default()));
+    }
+}
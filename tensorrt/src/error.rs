@@ -1,3 +1,5 @@
+use std::sync::Arc;
+use tensorrt_rs_sys::error_recorder::RecordedError;
 use thiserror::Error;
 
 #[derive(Error, Debug)]
@@ -10,8 +12,12 @@ pub enum TRTError {
     RuntimeCreationError,
     #[error("TensorRT engine deserialization error")]
     EngineDeserializationError,
+    #[error("TensorRT engine serialization error")]
+    EngineSerializationError,
     #[error("TensorRT engine creation error")]
     EngineCreationError,
+    #[error("TensorRT engine inspector creation error")]
+    InspectorCreationError,
     #[error("TensorRT execution context not initialized")]
     ExecutionContextNotInitialized,
     #[error("TensorRT execution context creation error")]
@@ -26,8 +32,180 @@ pub enum TRTError {
     ResetShapesError,
     #[error("TensorRT shape mismatch")]
     ShapeMismatch,
+    #[error("TensorRT shape inference failed: {0}")]
+    ShapeInferenceError(i32),
     #[error("TensorRT dtype mismatch")]
     DTypeMismatch,
+    #[error("BOOL output holds bytes other than 0 and 1: {0}")]
+    InvalidBoolOutput(String),
+    #[error("TensorRT device memory arena too small: required {0} bytes, available {1} bytes")]
+    ArenaTooSmall(usize, usize),
+    #[error("TensorRT invalid optimization profile: {0}")]
+    ProfileError(i32),
+    #[error("TensorRT tensor not found: {0}")]
+    TensorNotFound(String),
+    #[error("CUDA IPC error: {0}")]
+    IpcError(&'static str),
+    #[error("DLA core {0} is not available")]
+    DlaCoreError(i32),
+    #[error("Tensor is not in host-mapped memory: {0}")]
+    NotHostMapped(String),
+    #[error("Not a shape tensor: {0}")]
+    NotShapeTensor(String),
+    #[error("TensorRT batch execution failed")]
+    BatchExecutionError,
+    // what every request of a failed batch gets: the error the batch failed with
+    #[error("TensorRT batch execution failed: {0}")]
+    BatchFailed(Arc<TRTError>),
+    #[error("CUDA memcpy error")]
+    MemcpyError,
+    #[error("Request queue closed")]
+    QueueClosed,
+    #[error("Frame dropped")]
+    FrameDropped,
+    #[error("Request deadline exceeded")]
+    DeadlineExceeded,
+    #[error("Request shed: queue overloaded")]
+    Overloaded,
+    #[error("Pipeline stage panicked")]
+    StagePanicked,
+    #[error("Pipeline executor has no engines")]
+    NoEngines,
+    #[error("Engine variant {0} does not match the IO of the others")]
+    VariantMismatch(String),
+    #[error("Unknown engine variant: {0}")]
+    UnknownVariant(String),
+    #[error("No engine variant serves batch size {0}")]
+    NoVariant(usize),
+    #[error("TensorRT GPU allocator error")]
+    AllocatorError,
+    #[error("TensorRT output allocator error")]
+    OutputAllocatorError,
+    #[error("CUDA stream error")]
+    StreamCreationError,
+    #[error("CUDA event error")]
+    EventError,
+    #[error("CUDA stream callback error")]
+    StreamCallbackError,
+    #[error("CUDA graph capture error")]
+    GraphCaptureError,
+    #[error("CUDA graph launch error")]
+    GraphLaunchError,
+    #[error("CUDA error raised by enqueued work: {1} ({0})")]
+    AsyncCudaError(i32, String),
+    #[error("Sticky CUDA error {1} ({0}): the CUDA context is lost until the process restarts")]
+    StickyCudaError(i32, String),
+    #[error("CUDA kernel launch error")]
+    KernelLaunchError,
+    #[error("Unsupported tensor layout: {0:?}")]
+    UnsupportedLayout(tensorrt_rs_sys::runtime::TensorFormat),
+    #[error("CUDA device query error")]
+    DeviceQueryError,
+    #[error("CPU affinity error: {0}")]
+    AffinityError(&'static str),
+    #[error("SM budget error: {0}")]
+    SmBudgetError(&'static str),
+    #[error("L2 persisting accesses are not supported on this device")]
+    L2PersistenceUnsupported,
+    #[error("L2 access policy window too large: {0} bytes, device maximum {1} bytes")]
+    L2WindowTooLarge(usize, usize),
+    #[error("TensorRT builder creation error")]
+    BuilderCreationError,
+    #[error("ONNX parse error: {0}")]
+    OnnxParseError(String),
+    #[error("TensorRT engine build error")]
+    EngineBuildError,
+    #[error("TensorRT builder flag not supported by this TensorRT version: {0:?}")]
+    UnsupportedBuilderFlag(tensorrt_rs_sys::builder::BuilderFlag),
+    #[error("TensorRT timing cache error: {0:?}")]
+    TimingCacheError(std::path::PathBuf),
+    #[error("TensorRT refit error: {0}")]
+    RefitError(String),
+    #[error("Unsupported DLPack tensor: {0}")]
+    DLPackError(&'static str),
+    #[error("TensorRT engine has no streamable weights")]
+    WeightStreamingUnsupported,
+    #[error("TensorRT weight streaming budget rejected: {0} bytes")]
+    WeightStreamingBudgetError(usize),
+    #[error("State binding does not pair an engine input with an output: {0} -> {1}")]
+    StateBindingError(String, String),
+    #[error("Unknown or busy state session: {0}")]
+    SessionNotFound(u64),
+    #[error("Out of state blocks: {0} needed, {1} free")]
+    StateBlocksExhausted(usize, usize),
+    #[error("Embedding id already in the index: {0}")]
+    DuplicateEmbeddingId(u64),
+    #[error("Unknown model: {0}")]
+    UnknownModel(String),
+    #[error("Device memory budget exceeded: requested {0} bytes with {1} of {2} bytes in use")]
+    MemoryBudgetExceeded(usize, usize, usize),
+    #[error("TensorRT standard plugin registration failed")]
+    PluginInitError,
+    #[error("TensorRT lean runtime load error: {0:?}")]
+    LeanRuntimeLoadError(std::path::PathBuf),
+    #[error("Incompatible plan: {0}")]
+    IncompatiblePlan(String),
+    #[error("TensorRT plugin library load error: {0:?}")]
+    PluginLoadError(std::path::PathBuf),
+    #[error("TensorRT plugin creator registration failed: {0}")]
+    PluginRegistrationError(String),
+    // a failed call with the errors TensorRT reported to the error recorder meanwhile
+    #[error("{0}: {}", .1.iter().map(|error| error.desc.as_str()).collect::<Vec<_>>().join("; "))]
+    Recorded(Box<TRTError>, Vec<RecordedError>),
+}
+
+impl TRTError {
+    // The error without the recorded details of Recorded, and the cause of BatchFailed.
+    pub fn root(&self) -> &TRTError {
+        match self {
+            Self::Recorded(err, _) => err.root(),
+            Self::BatchFailed(err) => err.root(),
+            err => err,
+        }
+    }
+
+    pub fn recorded_errors(&self) -> &[RecordedError] {
+        match self {
+            Self::Recorded(_, recorded) => recorded,
+            Self::BatchFailed(err) => err.recorded_errors(),
+            _ => &[],
+        }
+    }
+
+    // Whether retrying the same request may succeed, going by what TensorRT reported: only
+    // transient failures (see ErrorCode::is_transient) and recoverable asynchronous errors.
+    pub fn is_retryable(&self) -> bool {
+        match self {
+            Self::Recorded(_, recorded) => recorded.iter().all(|error| error.error_code().is_transient()),
+            Self::AsyncCudaError(..) => true,
+            Self::BatchFailed(err) => err.is_retryable(),
+            _ => false,
+        }
+    }
 }
 
 pub type TRTResult<T> = Result<T, TRTError>;
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn recorded_errors_decide_retries() {
+        let recorded = |code| RecordedError { code, desc: "out of memory".to_string() };
+        let err = TRTError::Recorded(Box::new(TRTError::EnqueueError), vec![recorded(5)]);
+        assert!(matches!(err.root(), TRTError::EnqueueError));
+        assert_eq!(err.recorded_errors().len(), 1);
+        assert!(err.is_retryable());
+        assert_eq!(err.to_string(), "TensorRT enqueue error: out of memory");
+        let err = TRTError::Recorded(Box::new(TRTError::EnqueueError), vec![recorded(5), recorded(3)]);
+        assert!(!err.is_retryable());
+        assert!(!TRTError::EnqueueError.is_retryable());
+
+        let cause = TRTError::Recorded(Box::new(TRTError::EnqueueError), vec![recorded(5)]);
+        let err = TRTError::BatchFailed(Arc::new(cause));
+        assert!(matches!(err.root(), TRTError::EnqueueError));
+        assert!(err.is_retryable());
+        assert_eq!(err.to_string(), "TensorRT batch execution failed: TensorRT enqueue error: out of memory");
+    }
+}
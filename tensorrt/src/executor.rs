@@ -0,0 +1,387 @@
+use crate::{
+    affinity::ThreadPinning,
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+};
+use crossbeam_deque::{Injector, Steal, Stealer, Worker};
+use crossbeam_queue::ArrayQueue;
+use std::{
+    hint, iter,
+    panic::{self, AssertUnwindSafe},
+    sync::{
+        atomic::{AtomicBool, AtomicUsize, Ordering},
+        mpsc, Arc, Condvar, Mutex,
+    },
+    thread::{self, JoinHandle},
+};
+use tensorrt_rs_sys::{device, numa};
+
+type Task = Box<dyn FnOnce() + Send>;
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct ExecutorOptions {
+    // threads running the host stages
+    pub cpu_workers: usize,
+    // requests between submit and their result; submit blocks beyond it
+    pub max_in_flight: usize,
+    // preprocessed inputs waiting for a GPU thread; pre stages block beyond it
+    pub gpu_queue_depth: usize,
+    // cores of the GPU threads, the index being the engine's among those of its device;
+    // by default they only stay on their device's NUMA node
+    pub gpu_pinning: ThreadPinning,
+}
+
+impl Default for ExecutorOptions {
+    fn default() -> Self {
+        Self {
+            cpu_workers: thread::available_parallelism().map_or(4, |n| n.get()),
+            max_in_flight: 256,
+            gpu_queue_depth: 16,
+            gpu_pinning: ThreadPinning::default(),
+        }
+    }
+}
+
+// Sleep and wake-up of the threads waiting for one kind of work. Wakers only take the lock
+// when someone sleeps; sleepers re-check under the lock, so no wake-up is lost.
+#[derive(Default)]
+struct Signal {
+    sleepers: AtomicUsize,
+    lock: Mutex<()>,
+    cond: Condvar,
+}
+
+impl Signal {
+    fn wait(&self, ready: impl Fn() -> bool) {
+        self.sleepers.fetch_add(1, Ordering::SeqCst);
+        let guard = self.lock.lock().unwrap();
+        if !ready() {
+            drop(self.cond.wait(guard).unwrap());
+        }
+        self.sleepers.fetch_sub(1, Ordering::SeqCst);
+    }
+
+    fn notify_one(&self) {
+        if self.sleepers.load(Ordering::SeqCst) > 0 {
+            let _guard = self.lock.lock().unwrap();
+            self.cond.notify_one();
+        }
+    }
+
+    fn notify_all(&self) {
+        let _guard = self.lock.lock().unwrap();
+        self.cond.notify_all();
+    }
+}
+
+// Host tasks. Post stages are taken before anything else, so finished inferences drain
+// ahead of new requests; pre stages are batched into the worker's own deque, then stolen
+// by idle workers.
+struct CpuPool {
+    pre: Injector<Task>,
+    post: Injector<Task>,
+    stealers: Vec<Stealer<Task>>,
+    signal: Signal,
+    stop: AtomicBool,
+}
+
+impl CpuPool {
+    fn spawn_pre(&self, task: Task) {
+        self.pre.push(task);
+        self.signal.notify_one();
+    }
+
+    fn spawn_post(&self, task: Task) {
+        self.post.push(task);
+        self.signal.notify_one();
+    }
+
+    fn has_work(&self) -> bool {
+        !self.post.is_empty() || !self.pre.is_empty() || self.stealers.iter().any(|stealer| !stealer.is_empty())
+    }
+
+    fn find_task(&self, local: &Worker<Task>) -> Option<Task> {
+        if let Steal::Success(task) = self.post.steal() {
+            return Some(task);
+        }
+        local.pop().or_else(|| {
+            iter::repeat_with(|| {
+                self.post
+                    .steal()
+                    .or_else(|| self.stealers.iter().map(|stealer| stealer.steal()).collect())
+                    .or_else(|| self.pre.steal_batch_and_pop(local))
+            })
+            .find(|steal| !steal.is_retry())
+            .and_then(|steal| steal.success())
+        })
+    }
+
+    fn run(&self, local: Worker<Task>) {
+        loop {
+            match self.find_task(&local) {
+                // a panicking stage fails its own request (see Completion) and nothing else
+                Some(task) => drop(panic::catch_unwind(AssertUnwindSafe(task))),
+                None if self.stop.load(Ordering::SeqCst) => return,
+                None => self.signal.wait(|| self.has_work() || self.stop.load(Ordering::SeqCst)),
+            }
+        }
+    }
+}
+
+struct GpuJob<P, G> {
+    input: P,
+    then: Box<dyn FnOnce(TRTResult<G>) + Send>,
+}
+
+struct GpuQueue<P, G> {
+    jobs: ArrayQueue<GpuJob<P, G>>,
+    ready: Signal,
+    space: Signal,
+    stop: AtomicBool,
+}
+
+impl<P, G> GpuQueue<P, G> {
+    fn push(&self, mut job: GpuJob<P, G>) {
+        loop {
+            match self.jobs.push(job) {
+                Ok(()) => return self.ready.notify_one(),
+                Err(back) => job = back,
+            }
+            self.space.wait(|| !self.jobs.is_full());
+        }
+    }
+
+    fn pop(&self, busy_poll: bool) -> Option<GpuJob<P, G>> {
+        loop {
+            if let Some(job) = self.jobs.pop() {
+                self.space.notify_one();
+                return Some(job);
+            }
+            if self.stop.load(Ordering::SeqCst) {
+                return None;
+            }
+            match busy_poll {
+                true => hint::spin_loop(),
+                false => self.ready.wait(|| !self.jobs.is_empty() || self.stop.load(Ordering::SeqCst)),
+            }
+        }
+    }
+}
+
+#[derive(Default)]
+struct InFlight {
+    count: Mutex<usize>,
+    cond: Condvar,
+}
+
+impl InFlight {
+    fn release(&self) {
+        *self.count.lock().unwrap() -= 1;
+        self.cond.notify_all();
+    }
+}
+
+// The reply of one request; fails it with StagePanicked when dropped unanswered.
+struct Completion<O> {
+    sender: Option<mpsc::Sender<TRTResult<O>>>,
+    in_flight: Arc<InFlight>,
+}
+
+impl<O> Completion<O> {
+    fn complete(mut self, result: TRTResult<O>) {
+        if let Some(sender) = self.sender.take() {
+            let _ = sender.send(result);
+        }
+    }
+}
+
+impl<O> Drop for Completion<O> {
+    fn drop(&mut self) {
+        if let Some(sender) = self.sender.take() {
+            let _ = sender.send(Err(TRTError::StagePanicked));
+        }
+        self.in_flight.release();
+    }
+}
+
+// Host stages around inference, e.g. decode and crop before and box extraction after a
+// detector. `pre` and `post` run on work-stealing CPU workers; each engine gets its own
+// submission thread, pinned to its device (and that device's NUMA node), that only runs
+// `gpu` and hands the result back to the CPU workers without waiting on them, so a slow
+// host stage occupies a CPU worker, never a GPU thread. Preprocessed inputs wait in a
+// bounded queue; when it is full the pre stages wait for the GPU, not the other way round.
+pub struct PipelineExecutor<I, O> {
+    schedule: Arc<dyn Fn(I, Completion<O>) + Send + Sync>,
+    in_flight: Arc<InFlight>,
+    max_in_flight: usize,
+    cpu: Arc<CpuPool>,
+    stop_gpu: Box<dyn Fn() + Send + Sync>,
+    cpu_threads: Vec<JoinHandle<()>>,
+    gpu_threads: Vec<JoinHandle<TRTEngine>>,
+}
+
+impl<I: Send + 'static, O: Send + 'static> PipelineExecutor<I, O> {
+    // `engines` pairs each engine with the device it was created on; engines may share a
+    // device, e.g. two contexts of one EnginePool generation for copy/compute overlap.
+    pub fn new<P, G, Pre, Gpu, Post>(
+        engines: Vec<(i32, TRTEngine)>,
+        options: ExecutorOptions,
+        pre: Pre,
+        gpu: Gpu,
+        post: Post,
+    ) -> TRTResult<Self>
+    where
+        P: Send + 'static,
+        G: Send + 'static,
+        Pre: Fn(I) -> TRTResult<P> + Send + Sync + 'static,
+        Gpu: Fn(&mut TRTEngine, P) -> TRTResult<G> + Send + Sync + 'static,
+        Post: Fn(G) -> TRTResult<O> + Send + Sync + 'static,
+    {
+        if engines.is_empty() {
+            return Err(TRTError::NoEngines);
+        }
+        let workers: Vec<Worker<Task>> = (0..options.cpu_workers.max(1)).map(|_| Worker::new_fifo()).collect();
+        let cpu = Arc::new(CpuPool {
+            pre: Injector::new(),
+            post: Injector::new(),
+            stealers: workers.iter().map(|worker| worker.stealer()).collect(),
+            signal: Signal::default(),
+            stop: AtomicBool::new(false),
+        });
+        let queue = Arc::new(GpuQueue {
+            jobs: ArrayQueue::new(options.gpu_queue_depth.max(1)),
+            ready: Signal::default(),
+            space: Signal::default(),
+            stop: AtomicBool::new(false),
+        });
+
+        let (pre, post) = (Arc::new(pre), Arc::new(post));
+        let (schedule_cpu, schedule_queue) = (cpu.clone(), queue.clone());
+        let schedule = move |input: I, completion: Completion<O>| {
+            let (cpu, queue, pre, post) = (schedule_cpu.clone(), schedule_queue.clone(), pre.clone(), post.clone());
+            schedule_cpu.spawn_pre(Box::new(move || {
+                let input = match pre(input) {
+                    Ok(input) => input,
+                    Err(err) => return completion.complete(Err(err)),
+                };
+                let then = move |result: TRTResult<G>| match result {
+                    Ok(output) => cpu.spawn_post(Box::new(move || completion.complete(post(output)))),
+                    Err(err) => completion.complete(Err(err)),
+                };
+                queue.push(GpuJob { input, then: Box::new(then) });
+            }));
+        };
+        let stop_queue = queue.clone();
+        let stop_gpu = move || {
+            stop_queue.stop.store(true, Ordering::SeqCst);
+            stop_queue.ready.notify_all();
+        };
+
+        // a failed spawn drops the executor, which stops the threads spawned so far
+        let mut executor = Self {
+            schedule: Arc::new(schedule),
+            in_flight: Arc::new(InFlight::default()),
+            max_in_flight: options.max_in_flight.max(1),
+            cpu: cpu.clone(),
+            stop_gpu: Box::new(stop_gpu),
+            cpu_threads: Vec::with_capacity(workers.len()),
+            gpu_threads: Vec::with_capacity(engines.len()),
+        };
+        for (i, local) in workers.into_iter().enumerate() {
+            let cpu = cpu.clone();
+            let handle = thread::Builder::new().name(format!("trt-cpu-{}", i)).spawn(move || cpu.run(local))?;
+            executor.cpu_threads.push(handle);
+        }
+        let gpu = Arc::new(gpu);
+        let devices: Vec<i32> = engines.iter().map(|(device_id, _)| *device_id).collect();
+        let busy_poll = options.gpu_pinning.busy_poll;
+        for (i, (device_id, mut engine)) in engines.into_iter().enumerate() {
+            let index = devices[..i].iter().filter(|&&other| other == device_id).count();
+            let cpus = options.gpu_pinning.cpus(device_id, index)?;
+            let (queue, gpu) = (queue.clone(), gpu.clone());
+            let handle = thread::Builder::new().name(format!("trt-gpu-{}-{}", device_id, i)).spawn(move || {
+                device::set_device(device_id);
+                if !cpus.is_empty() {
+                    numa::bind_thread_to_cpus(&cpus);
+                } else if let Some(node) = numa::get_device_node(device_id) {
+                    numa::bind_thread_to_node(node);
+                }
+                while let Some(job) = queue.pop(busy_poll) {
+                    let result = match panic::catch_unwind(AssertUnwindSafe(|| gpu(&mut engine, job.input))) {
+                        Ok(result) => result,
+                        Err(_) => Err(TRTError::StagePanicked),
+                    };
+                    (job.then)(result);
+                }
+                engine
+            })?;
+            executor.gpu_threads.push(handle);
+        }
+        Ok(executor)
+    }
+
+    // Queues `input`, waiting while max_in_flight requests are outstanding.
+    pub fn submit(&self, input: I) -> mpsc::Receiver<TRTResult<O>> {
+        let mut count = self.in_flight.count.lock().unwrap();
+        while *count >= self.max_in_flight {
+            count = self.in_flight.cond.wait(count).unwrap();
+        }
+        *count += 1;
+        drop(count);
+        self.schedule_admitted(input)
+    }
+
+    // Queues `input`, or fails with Overloaded when max_in_flight requests are outstanding.
+    pub fn try_submit(&self, input: I) -> TRTResult<mpsc::Receiver<TRTResult<O>>> {
+        let mut count = self.in_flight.count.lock().unwrap();
+        if *count >= self.max_in_flight {
+            return Err(TRTError::Overloaded);
+        }
+        *count += 1;
+        drop(count);
+        Ok(self.schedule_admitted(input))
+    }
+
+    fn schedule_admitted(&self, input: I) -> mpsc::Receiver<TRTResult<O>> {
+        let (sender, receiver) = mpsc::channel();
+        (self.schedule)(input, Completion { sender: Some(sender), in_flight: self.in_flight.clone() });
+        receiver
+    }
+}
+
+impl<I, O> PipelineExecutor<I, O> {
+    pub fn num_in_flight(&self) -> usize {
+        *self.in_flight.count.lock().unwrap()
+    }
+
+    // Waits for every submitted request to complete, stops the threads and returns the
+    // engines.
+    pub fn shutdown(mut self) -> Vec<TRTEngine> {
+        self.stop()
+    }
+
+    fn stop(&mut self) -> Vec<TRTEngine> {
+        let mut count = self.in_flight.count.lock().unwrap();
+        while *count > 0 {
+            count = self.in_flight.cond.wait(count).unwrap();
+        }
+        drop(count);
+
+        (self.stop_gpu)();
+        let engines = self.gpu_threads.drain(..).filter_map(|handle| handle.join().ok()).collect();
+        self.cpu.stop.store(true, Ordering::SeqCst);
+        self.cpu.signal.notify_all();
+        for handle in self.cpu_threads.drain(..) {
+            let _ = handle.join();
+        }
+        engines
+    }
+}
+
+impl<I, O> Drop for PipelineExecutor<I, O> {
+    fn drop(&mut self) {
+        if !self.gpu_threads.is_empty() || !self.cpu_threads.is_empty() {
+            self.stop();
+        }
+    }
+}
@@ -0,0 +1,150 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    nvtx::{self, Category},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::graph::{self, CudaGraph, CudaGraphExec};
+use std::collections::HashMap;
+
+// Identifies one captured launch sequence: its signature, the input shapes and the priority
+// of the stream it was captured from (kernel nodes keep it), decides whether a graph can be
+// replayed, and the addresses it baked in (e.g. the sources of its input copies) whether it
+// has to be updated first.
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
+pub(crate) struct GraphKey {
+    signature: Signature,
+    addresses: Vec<usize>,
+}
+
+#[derive(Clone, Debug, PartialEq, Eq, Hash)]
+struct Signature(Vec<(String, Shape)>, Option<i32>);
+
+impl GraphKey {
+    pub(crate) fn new(feed_dict: &HashMap<&str, &Tensor>) -> Self {
+        Self::from_inputs(feed_dict.iter().map(|(name, tensor)| (*name, *tensor)))
+    }
+
+    pub(crate) fn from_inputs<'a, I: Iterator<Item = (&'a str, &'a Tensor)>>(inputs: I) -> Self {
+        let mut entries: Vec<_> = inputs
+            .map(|(name, tensor)| {
+                let ptr = unsafe { tensor.get_raw_ptr() };
+                (name.to_string(), *tensor.shape(), ptr)
+            })
+            .collect();
+        entries.sort_unstable_by(|a, b| a.0.cmp(&b.0));
+        let addresses = entries.iter().map(|entry| entry.2).collect();
+        let shapes = entries.into_iter().map(|(name, shape, _)| (name, shape)).collect();
+        Self { signature: Signature(shapes, None), addresses }
+    }
+
+    // For graphs that only capture enqueue on engine-owned buffers, where the shapes alone
+    // identify the launch.
+    pub(crate) fn from_shapes(mut entries: Vec<(String, Shape)>) -> Self {
+        entries.sort_unstable_by(|a, b| a.0.cmp(&b.0));
+        Self { signature: Signature(entries, None), addresses: Vec::new() }
+    }
+
+    // The addresses bound to the captured enqueue, e.g. zero-copy inputs and outputs.
+    pub(crate) fn with_addresses(mut self, addresses: Vec<usize>) -> Self {
+        self.addresses = addresses;
+        self
+    }
+
+    pub(crate) fn with_priority(mut self, priority: Option<i32>) -> Self {
+        self.signature.1 = priority;
+        self
+    }
+}
+
+struct CachedGraph {
+    exec: CudaGraphExec,
+    addresses: Vec<usize>,
+}
+
+#[derive(Default)]
+pub(crate) struct GraphCache {
+    execs: HashMap<Signature, CachedGraph>,
+    updates: u64,
+}
+
+impl GraphCache {
+    // Replays the graph of `key`'s signature, None if there is none. A graph captured at other
+    // addresses is first updated to `key`'s with cudaGraphExecUpdate from a recording of
+    // `record`, which runs nothing and spares instantiating the graph again; only a recording
+    // whose work differs (e.g. other kernels) is instantiated anew.
+    pub(crate) fn replay<F>(&mut self, key: &GraphKey, stream: &CuStream, record: F) -> Option<TRTResult<()>>
+    where
+        F: FnOnce() -> TRTResult<()>,
+    {
+        let cached = self.execs.get_mut(&key.signature)?;
+        if cached.addresses != key.addresses {
+            let _range = nvtx::range!(Category::Enqueue, "graph update");
+            let graph = match Self::record(stream, record) {
+                Ok(graph) => graph,
+                Err(err) => return Some(Err(err)),
+            };
+            if !cached.exec.update(&graph) {
+                cached.exec = match graph.instantiate() {
+                    Some(exec) => exec,
+                    None => return Some(Err(TRTError::GraphCaptureError)),
+                };
+            }
+            cached.addresses = key.addresses.clone();
+            self.updates += 1;
+        }
+        let _range = nvtx::range!(Category::Enqueue, "graph launch");
+        if cached.exec.launch(stream) {
+            Some(Ok(()))
+        } else {
+            Some(Err(TRTError::GraphLaunchError))
+        }
+    }
+
+    // Records everything `enqueue` puts on `stream` into a graph and keeps its executable.
+    // Nothing captured is executed, so the caller must have run the same work once
+    // already, which also lets TensorRT finish its shape-dependent setup before capture.
+    pub(crate) fn capture<F>(&mut self, key: GraphKey, stream: &CuStream, enqueue: F) -> TRTResult<()>
+    where
+        F: FnOnce() -> TRTResult<()>,
+    {
+        let _range = nvtx::range!(Category::Enqueue, "graph capture");
+        let exec = match Self::record(stream, enqueue)?.instantiate() {
+            Some(exec) => exec,
+            None => return Err(TRTError::GraphCaptureError),
+        };
+        self.execs.insert(key.signature, CachedGraph { exec, addresses: key.addresses });
+
+        Ok(())
+    }
+
+    fn record<F>(stream: &CuStream, enqueue: F) -> TRTResult<CudaGraph>
+    where
+        F: FnOnce() -> TRTResult<()>,
+    {
+        if !graph::begin_capture(stream) {
+            return Err(TRTError::GraphCaptureError);
+        }
+        let res = enqueue();
+        // capture has to be ended even when enqueue failed
+        let graph = graph::end_capture(stream);
+        res?;
+        match graph {
+            Some(graph) => Ok(graph),
+            None => Err(TRTError::GraphCaptureError),
+        }
+    }
+
+    pub(crate) fn clear(&mut self) {
+        self.execs.clear();
+    }
+
+    pub(crate) fn len(&self) -> usize {
+        self.execs.len()
+    }
+
+    // Graphs updated to new addresses instead of being captured again.
+    pub(crate) fn updates(&self) -> u64 {
+        self.updates
+    }
+}
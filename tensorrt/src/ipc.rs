@@ -0,0 +1,249 @@
+use crate::{
+    accounting::{MemoryCategory, MemoryReservation},
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::ops::Deref;
+use tensorrt_rs_sys::{
+    ipc::{IpcEventHandle, IpcMemHandle, IpcMemory, ShareableMemory, IPC_HANDLE_SIZE},
+    runtime::{DataType, MAX_DIMS},
+    stream::CudaEvent,
+};
+
+// Bytes of IpcTensorHandle::to_bytes.
+pub const IPC_TENSOR_HANDLE_SIZE: usize = 3 * IPC_HANDLE_SIZE + 4 + 4 + 4 * MAX_DIMS + 8;
+
+// Everything another process needs to open an IpcTensor, sent over any channel (a Unix
+// socket, shared memory) as to_bytes.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct IpcTensorHandle {
+    pub memory: IpcMemHandle,
+    // recorded by the writer once the data is complete
+    pub ready: IpcEventHandle,
+    // recorded by the reader once it no longer reads the data
+    pub released: IpcEventHandle,
+    pub dtype: DataType,
+    pub shape: Shape,
+    // elements of the buffer, which may exceed the shape
+    pub capacity: usize,
+}
+
+impl IpcTensorHandle {
+    pub fn to_bytes(&self) -> Vec<u8> {
+        let mut bytes = Vec::with_capacity(IPC_TENSOR_HANDLE_SIZE);
+        bytes.extend_from_slice(&self.memory.0);
+        bytes.extend_from_slice(&self.ready.0);
+        bytes.extend_from_slice(&self.released.0);
+        bytes.extend_from_slice(&(self.dtype as i32).to_le_bytes());
+        bytes.extend_from_slice(&(self.shape.nb_dims() as u32).to_le_bytes());
+        for i in 0..MAX_DIMS {
+            let dim = self.shape.get(i).copied().unwrap_or(0);
+            bytes.extend_from_slice(&dim.to_le_bytes());
+        }
+        bytes.extend_from_slice(&(self.capacity as u64).to_le_bytes());
+        bytes
+    }
+
+    pub fn from_bytes(bytes: &[u8]) -> TRTResult<Self> {
+        if bytes.len() != IPC_TENSOR_HANDLE_SIZE {
+            return Err(TRTError::IpcError("handle size"));
+        }
+        let handle = |i: usize| -> [u8; IPC_HANDLE_SIZE] {
+            bytes[i * IPC_HANDLE_SIZE..(i + 1) * IPC_HANDLE_SIZE].try_into().unwrap()
+        };
+        let mut rest = &bytes[3 * IPC_HANDLE_SIZE..];
+        let mut word = || {
+            let (head, tail) = rest.split_at(4);
+            rest = tail;
+            i32::from_le_bytes(head.try_into().unwrap())
+        };
+        let dtype = match DataType::from_i32(word()) {
+            Some(dtype) => dtype,
+            None => return Err(TRTError::IpcError("data type")),
+        };
+        let nb_dims = word() as usize;
+        if nb_dims > MAX_DIMS {
+            return Err(TRTError::IpcError("rank"));
+        }
+        let dims: Vec<i32> = (0..MAX_DIMS).map(|_| word()).collect();
+        let capacity = u64::from_le_bytes(rest.try_into().unwrap()) as usize;
+        let shape = Shape::new(&dims[..nb_dims]);
+        if shape.size() > capacity {
+            return Err(TRTError::IpcError("shape exceeds capacity"));
+        }
+        Ok(Self {
+            memory: IpcMemHandle(handle(0)),
+            ready: IpcEventHandle(handle(1)),
+            released: IpcEventHandle(handle(2)),
+            dtype,
+            shape,
+            capacity,
+        })
+    }
+}
+
+enum Backing {
+    Exported(ShareableMemory, MemoryReservation),
+    Imported(IpcMemory),
+}
+
+// A device tensor shared between processes on one host through CUDA IPC, e.g. written by a
+// decoder process and bound by TRTEngine::inference_into in an inference process, so frames
+// never pass through host memory. The exporting process owns the memory and must keep the
+// tensor alive while others have it open.
+//
+// Access is ordered with two interprocess events: the writer signals ready after writing
+// and the reader waits for it before reading; the reader signals released after its reads
+// and the writer waits for it before writing again. A wait only covers a signal already
+// issued when it is called, so every signal must be followed by a message (on the channel
+// the handle was sent over) that the other side receives before waiting.
+pub struct IpcTensor {
+    // a non-owning view, dropped before the memory
+    tensor: Tensor,
+    backing: Backing,
+    ready: CudaEvent,
+    released: CudaEvent,
+}
+
+impl IpcTensor {
+    // Allocates a tensor that other processes open from handle().
+    pub fn export(shape: &Shape, dtype: DataType, stream: &CuStream) -> TRTResult<Self> {
+        let size = shape.size() * dtype.get_elem_size();
+        let reservation = MemoryReservation::new(MemoryCategory::Tensors, size)?;
+        let memory = match ShareableMemory::new(size) {
+            Some(memory) => memory,
+            None => return Err(TRTError::AllocatorError),
+        };
+        let tensor = Tensor::from_raw_ptr(memory.get_raw(), shape, dtype, stream);
+        Ok(Self {
+            tensor,
+            backing: Backing::Exported(memory, reservation),
+            ready: interprocess_event()?,
+            released: interprocess_event()?,
+        })
+    }
+
+    // Maps a tensor exported by another process. Its shape is that of the handle; the
+    // exporter and importer agree on any later change themselves (see reset_shape).
+    pub fn import(handle: &IpcTensorHandle, stream: &CuStream) -> TRTResult<Self> {
+        let memory = match IpcMemory::open(&handle.memory) {
+            Some(memory) => memory,
+            None => return Err(TRTError::IpcError("cannot open memory handle")),
+        };
+        let mut tensor =
+            Tensor::from_raw_ptr(memory.get_raw(), &Shape::new(&[handle.capacity as i32]), handle.dtype, stream);
+        unsafe { tensor.reset_shape(&handle.shape)? };
+        let open = |event: &IpcEventHandle| match CudaEvent::from_ipc_handle(event) {
+            Some(event) => Ok(event),
+            None => Err(TRTError::IpcError("cannot open event handle")),
+        };
+        Ok(Self {
+            tensor,
+            backing: Backing::Imported(memory),
+            ready: open(&handle.ready)?,
+            released: open(&handle.released)?,
+        })
+    }
+
+    pub fn is_exported(&self) -> bool {
+        matches!(self.backing, Backing::Exported(..))
+    }
+
+    // The handle to send to other processes; only the exporting process has one.
+    pub fn handle(&self) -> TRTResult<IpcTensorHandle> {
+        let memory = match &self.backing {
+            Backing::Exported(memory, _) => memory,
+            Backing::Imported(_) => return Err(TRTError::IpcError("tensor was imported")),
+        };
+        let handles = (memory.ipc_handle(), self.ready.ipc_handle(), self.released.ipc_handle());
+        let (memory, ready, released) = match handles {
+            (Some(memory), Some(ready), Some(released)) => (memory, ready, released),
+            _ => return Err(TRTError::IpcError("cannot export handle")),
+        };
+        Ok(IpcTensorHandle {
+            memory,
+            ready,
+            released,
+            dtype: self.tensor.dtype(),
+            shape: *self.tensor.shape(),
+            capacity: self.tensor.capacity(),
+        })
+    }
+
+    // Safety: the other processes must use the same shape before their next access.
+    pub unsafe fn reset_shape(&mut self, shape: &Shape) -> TRTResult<()> {
+        self.tensor.reset_shape(shape)
+    }
+
+    // Writer: the work queued on `stream` so far completes the data.
+    pub fn signal_ready(&self, stream: &CuStream) -> TRTResult<()> {
+        record(&self.ready, stream)
+    }
+
+    // Reader: work queued on `stream` from now on runs after the writer's last signal_ready.
+    pub fn wait_ready(&self, stream: &CuStream) -> TRTResult<()> {
+        wait(&self.ready, stream)
+    }
+
+    // Reader: the work queued on `stream` so far is the last to read the data.
+    pub fn signal_released(&self, stream: &CuStream) -> TRTResult<()> {
+        record(&self.released, stream)
+    }
+
+    // Writer: work queued on `stream` from now on runs after the reader's last
+    // signal_released.
+    pub fn wait_released(&self, stream: &CuStream) -> TRTResult<()> {
+        wait(&self.released, stream)
+    }
+}
+
+impl Deref for IpcTensor {
+    type Target = Tensor;
+
+    fn deref(&self) -> &Tensor {
+        &self.tensor
+    }
+}
+
+fn interprocess_event() -> TRTResult<CudaEvent> {
+    match CudaEvent::interprocess() {
+        Some(event) => Ok(event),
+        None => Err(TRTError::EventError),
+    }
+}
+
+fn record(event: &CudaEvent, stream: &CuStream) -> TRTResult<()> {
+    match event.record(stream) {
+        true => Ok(()),
+        false => Err(TRTError::EventError),
+    }
+}
+
+fn wait(event: &CudaEvent, stream: &CuStream) -> TRTResult<()> {
+    match event.wait(stream) {
+        true => Ok(()),
+        false => Err(TRTError::EventError),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn handle_bytes_round_trip() {
+        let handle = IpcTensorHandle {
+            memory: IpcMemHandle([1; IPC_HANDLE_SIZE]),
+            ready: IpcEventHandle([2; IPC_HANDLE_SIZE]),
+            released: IpcEventHandle([3; IPC_HANDLE_SIZE]),
+            dtype: DataType::HALF,
+            shape: Shape::new(&[1, 3, 720, 1280]),
+            capacity: 3 * 720 * 1280,
+        };
+        let bytes = handle.to_bytes();
+        assert_eq!(bytes.len(), IPC_TENSOR_HANDLE_SIZE);
+        assert_eq!(IpcTensorHandle::from_bytes(&bytes).unwrap(), handle);
+        assert!(IpcTensorHandle::from_bytes(&bytes[1..]).is_err());
+    }
+}
@@ -0,0 +1,85 @@
+use crate::error::{TRTError, TRTResult};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::{device, stream::set_access_policy_window};
+
+// The access policy window installed on a stream, and the L2 set-aside backing it.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct L2Window {
+    pub base: usize,
+    pub num_bytes: usize,
+    // fraction of the window's accesses that persist; below 1 when the window exceeds the
+    // set-aside, so persisting lines do not thrash each other
+    pub hit_ratio: f32,
+    pub set_aside: usize,
+}
+
+// Smallest range covering every (address, size) region.
+fn bounding_window(regions: &[(usize, usize)]) -> Option<(usize, usize)> {
+    let start = regions.iter().map(|(base, _)| *base).min()?;
+    let end = regions.iter().map(|(base, size)| base + size).max()?;
+    Some((start, end - start))
+}
+
+fn hit_ratio(num_bytes: usize, set_aside: usize) -> f32 {
+    match num_bytes {
+        0 => 0.0,
+        _ => (set_aside as f64 / num_bytes as f64).min(1.0) as f32,
+    }
+}
+
+// Installs one window over `regions` on `stream` and sizes the current device's persisting
+// set-aside to it, capped by what the device supports.
+pub(crate) fn persist(regions: &[(usize, usize)], stream: &CuStream) -> TRTResult<L2Window> {
+    let device = match device::get_device() {
+        Some(device) => device,
+        None => return Err(TRTError::DeviceQueryError),
+    };
+    let max_set_aside = device::get_max_persisting_l2_cache_size(device);
+    let max_window = device::get_max_access_policy_window_size(device);
+    if max_set_aside == 0 || max_window == 0 {
+        return Err(TRTError::L2PersistenceUnsupported);
+    }
+    let (base, num_bytes) = match bounding_window(regions) {
+        Some(window) => window,
+        None => return Err(TRTError::ShapeMismatch),
+    };
+    if num_bytes > max_window {
+        return Err(TRTError::L2WindowTooLarge(num_bytes, max_window));
+    }
+
+    let set_aside = num_bytes.min(max_set_aside);
+    if !device::set_persisting_l2_cache_limit(set_aside) {
+        return Err(TRTError::L2PersistenceUnsupported);
+    }
+    let window = L2Window { base, num_bytes, hit_ratio: hit_ratio(num_bytes, set_aside), set_aside };
+    if !set_access_policy_window(stream, base, num_bytes, window.hit_ratio) {
+        return Err(TRTError::L2PersistenceUnsupported);
+    }
+    Ok(window)
+}
+
+// Removes the stream's window and demotes lines it left persisting.
+pub(crate) fn clear(stream: &CuStream) -> TRTResult<()> {
+    if !set_access_policy_window(stream, 0, 0, 0.0) || !device::reset_persisting_l2_cache() {
+        return Err(TRTError::L2PersistenceUnsupported);
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn window_covers_all_regions() {
+        assert_eq!(bounding_window(&[(4096, 256), (1024, 512), (2048, 64)]), Some((1024, 3328)));
+        assert_eq!(bounding_window(&[]), None);
+    }
+
+    #[test]
+    fn hit_ratio_scales_down_oversized_windows() {
+        assert_eq!(hit_ratio(1 << 20, 4 << 20), 1.0);
+        assert_eq!(hit_ratio(8 << 20, 4 << 20), 0.5);
+        assert_eq!(hit_ratio(0, 4 << 20), 0.0);
+    }
+}
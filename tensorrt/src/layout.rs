@@ -0,0 +1,276 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::{
+    kernels::{convert_dla_hwc4, convert_layout},
+    memory::{memcpy_2d_async, memcpy_async, MemcpyKind},
+    runtime::{DataType, TensorFormat},
+};
+
+// DLA line strides; the Orin requirement also satisfies Xavier's 32 bytes.
+const DLA_LINE_ALIGN: usize = 64;
+
+// Memory layout of an IO tensor, as reported by the engine. Shapes stay logical (e.g.
+// [N, C, H, W]); vectorized formats pad the channel axis and need more memory than
+// shape.size() elements.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct TensorLayout {
+    pub format: TensorFormat,
+    pub vectorized_dim: i32,
+    pub components: i32,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+enum LayoutKind {
+    Linear,
+    // [N][C / k][H][W][k]
+    ChannelBlocked,
+    // [N][H][W][roundUp(C, k)]
+    ChannelLast,
+    // [N][C][H][roundUp(W, 64 / elem)]
+    DlaLinear,
+    // [N][H][roundUp(W, 64 / C' / elem)][C']
+    DlaHwc4,
+}
+
+impl TensorLayout {
+    pub fn new(format: TensorFormat, vectorized_dim: i32, components: i32) -> Self {
+        Self { format, vectorized_dim, components }
+    }
+
+    pub fn linear() -> Self {
+        Self::new(TensorFormat::LINEAR, -1, 1)
+    }
+
+    pub fn is_linear(&self) -> bool {
+        self.kind() == LayoutKind::Linear
+    }
+
+    fn kind(&self) -> LayoutKind {
+        match self.format {
+            TensorFormat::LINEAR => LayoutKind::Linear,
+            TensorFormat::CHW2
+            | TensorFormat::CHW4
+            | TensorFormat::CHW16
+            | TensorFormat::CHW32
+            | TensorFormat::CDHW32 => LayoutKind::ChannelBlocked,
+            TensorFormat::HWC
+            | TensorFormat::HWC8
+            | TensorFormat::HWC16
+            | TensorFormat::DHWC
+            | TensorFormat::DHWC8 => LayoutKind::ChannelLast,
+            TensorFormat::DLALINEAR => LayoutKind::DlaLinear,
+            TensorFormat::DLAHWC4 => LayoutKind::DlaHwc4,
+        }
+    }
+
+    fn components(&self) -> usize {
+        self.components.max(1) as usize
+    }
+
+    // C is dims[nbDims - 3], or dims[nbDims - 4] for the 3D-spatial formats, unless the
+    // engine reports the vectorized dim.
+    fn channel_axis(&self, nb_dims: usize) -> Option<usize> {
+        if self.vectorized_dim >= 0 && (self.vectorized_dim as usize) < nb_dims {
+            return Some(self.vectorized_dim as usize);
+        }
+        match self.format {
+            TensorFormat::CDHW32 | TensorFormat::DHWC | TensorFormat::DHWC8 => nb_dims.checked_sub(4),
+            _ => nb_dims.checked_sub(3),
+        }
+    }
+
+    // Elements the layout occupies for `shape`, including padding.
+    pub fn volume(&self, shape: &Shape, dtype: DataType) -> usize {
+        let mut dims: Vec<usize> = shape.iter().map(|&dim| dim.max(0) as usize).collect();
+        let elem_size = dtype.get_elem_size().max(1);
+        match (self.kind(), self.channel_axis(dims.len())) {
+            (LayoutKind::Linear, _) | (_, None) => (),
+            (LayoutKind::ChannelBlocked, Some(axis)) | (LayoutKind::ChannelLast, Some(axis)) => {
+                dims[axis] = round_up(dims[axis], self.components());
+            }
+            (LayoutKind::DlaLinear, Some(_)) => {
+                let last = dims.len() - 1;
+                dims[last] = round_up(dims[last], (DLA_LINE_ALIGN / elem_size).max(1));
+            }
+            (LayoutKind::DlaHwc4, Some(axis)) => {
+                let channels = if dims[axis] <= 1 { 1 } else { 4 };
+                let last = dims.len() - 1;
+                dims[axis] = channels;
+                dims[last] = round_up(dims[last], (DLA_LINE_ALIGN / channels / elem_size).max(1));
+            }
+        }
+        dims.iter().product()
+    }
+
+    // [outer, channels, inner] around the channel axis.
+    fn geometry(&self, shape: &Shape) -> Option<(usize, usize, usize)> {
+        let dims: Vec<usize> = shape.iter().map(|&dim| dim.max(0) as usize).collect();
+        let axis = self.channel_axis(dims.len())?;
+        Some((dims[..axis].iter().product(), dims[axis], dims[axis + 1..].iter().product()))
+    }
+
+    // `linear` holds the logical shape; `vectorized` points at `capacity` elements in this
+    // layout.
+    pub(crate) fn convert(
+        &self,
+        linear: &Tensor,
+        vectorized: usize,
+        capacity: usize,
+        to_vectorized: bool,
+        stream: &CuStream,
+    ) -> TRTResult<()> {
+        if linear.capacity() < linear.shape().size() || capacity < self.volume(linear.shape(), linear.dtype()) {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let linear_ptr = unsafe { linear.get_raw_ptr() };
+        let (src_ptr, dst_ptr) = match to_vectorized {
+            true => (linear_ptr, vectorized),
+            false => (vectorized, linear_ptr),
+        };
+
+        let shape = linear.shape();
+        let elem_size = linear.dtype().get_elem_size();
+        let ok = match self.kind() {
+            LayoutKind::Linear => unsafe {
+                memcpy_async(dst_ptr, src_ptr, linear.size_in_bytes(), MemcpyKind::DeviceToDevice, stream)
+            },
+            LayoutKind::DlaLinear => {
+                let width = shape.last().copied().unwrap_or(1).max(0) as usize * elem_size;
+                let pitch = round_up(width, DLA_LINE_ALIGN);
+                let rows = match width {
+                    0 => 0,
+                    _ => shape.size() * elem_size / width,
+                };
+                let (dst_pitch, src_pitch) = match to_vectorized {
+                    true => (pitch, width),
+                    false => (width, pitch),
+                };
+                unsafe {
+                    memcpy_2d_async(dst_ptr, dst_pitch, src_ptr, src_pitch, width, rows, MemcpyKind::DeviceToDevice, stream)
+                }
+            }
+            LayoutKind::ChannelBlocked | LayoutKind::ChannelLast => {
+                let (outer, channels, inner) = match self.geometry(shape) {
+                    Some(geometry) => geometry,
+                    None => return Err(TRTError::ShapeMismatch),
+                };
+                let launched = unsafe {
+                    convert_layout(
+                        src_ptr,
+                        dst_ptr,
+                        elem_size,
+                        outer,
+                        channels,
+                        inner,
+                        self.components(),
+                        self.kind() == LayoutKind::ChannelLast,
+                        to_vectorized,
+                        stream,
+                    )
+                };
+                if !launched {
+                    return Err(TRTError::KernelLaunchError);
+                }
+                true
+            }
+            LayoutKind::DlaHwc4 => {
+                let (outer, channels, inner) = match self.geometry(shape) {
+                    Some(geometry) => geometry,
+                    None => return Err(TRTError::ShapeMismatch),
+                };
+                if channels > 4 || elem_size > 2 {
+                    return Err(TRTError::UnsupportedLayout(self.format));
+                }
+                let width = shape.last().copied().unwrap_or(1).max(1) as usize;
+                let components = if channels <= 1 { 1 } else { 4 };
+                let padded_width = round_up(width, (DLA_LINE_ALIGN / components / elem_size).max(1));
+                let launched = unsafe {
+                    convert_dla_hwc4(
+                        src_ptr,
+                        dst_ptr,
+                        elem_size,
+                        outer,
+                        channels,
+                        inner / width,
+                        width,
+                        padded_width,
+                        to_vectorized,
+                        stream,
+                    )
+                };
+                if !launched {
+                    return Err(TRTError::KernelLaunchError);
+                }
+                true
+            }
+        };
+        match ok {
+            true => Ok(()),
+            false => Err(TRTError::MemcpyError),
+        }
+    }
+
+    // Writes the linear tensor `src` into `dst`, whose memory is in this layout (e.g. an
+    // engine-owned CHW32 input). Channel padding is zeroed.
+    pub fn from_linear(&self, src: &Tensor, dst: &Tensor, stream: &CuStream) -> TRTResult<()> {
+        check_pair(src, dst)?;
+        self.convert(src, unsafe { dst.get_raw_ptr() }, dst.capacity(), true, stream)
+    }
+
+    // Reads `src`, whose memory is in this layout, into the linear tensor `dst`.
+    pub fn to_linear(&self, src: &Tensor, dst: &Tensor, stream: &CuStream) -> TRTResult<()> {
+        check_pair(dst, src)?;
+        self.convert(dst, unsafe { src.get_raw_ptr() }, src.capacity(), false, stream)
+    }
+}
+
+fn check_pair(linear: &Tensor, vectorized: &Tensor) -> TRTResult<()> {
+    if linear.dtype() != vectorized.dtype() {
+        return Err(TRTError::DTypeMismatch);
+    }
+    if linear.shape() != vectorized.shape() {
+        return Err(TRTError::ShapeMismatch);
+    }
+    Ok(())
+}
+
+fn round_up(value: usize, multiple: usize) -> usize {
+    (value + multiple - 1) / multiple * multiple
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_layout_volume() {
+        let shape = Shape::new(&[2, 3, 5, 7]);
+        assert_eq!(TensorLayout::linear().volume(&shape, DataType::FLOAT), 2 * 3 * 5 * 7);
+
+        let chw32 = TensorLayout::new(TensorFormat::CHW32, 1, 32);
+        assert_eq!(chw32.volume(&shape, DataType::INT8), 2 * 32 * 5 * 7);
+
+        // vectorized dim not reported: C is dims[nbDims - 3]
+        let hwc8 = TensorLayout::new(TensorFormat::HWC8, -1, 8);
+        assert_eq!(hwc8.volume(&shape, DataType::HALF), 2 * 8 * 5 * 7);
+
+        // rows padded to 64 bytes
+        let dla = TensorLayout::new(TensorFormat::DLALINEAR, -1, 1);
+        assert_eq!(dla.volume(&shape, DataType::HALF), 2 * 3 * 5 * 32);
+
+        // C = 3 becomes 4, W padded to 64 / 4 / 1 elements
+        let dla_hwc4 = TensorLayout::new(TensorFormat::DLAHWC4, -1, 4);
+        assert_eq!(dla_hwc4.volume(&shape, DataType::INT8), 2 * 4 * 5 * 16);
+    }
+
+    #[test]
+    fn test_layout_geometry() {
+        let shape = Shape::new(&[2, 40, 3, 4, 5]);
+        let cdhw32 = TensorLayout::new(TensorFormat::CDHW32, -1, 32);
+        assert_eq!(cdhw32.geometry(&shape), Some((2, 40, 60)));
+        assert_eq!(cdhw32.volume(&shape, DataType::HALF), 2 * 64 * 60);
+    }
+}
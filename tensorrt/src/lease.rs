@@ -0,0 +1,153 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    staging::event,
+    tensor::Tensor,
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::{HashMap, VecDeque},
+    sync::{Arc, Condvar, Mutex},
+};
+use tensorrt_rs_sys::stream::CudaEvent;
+
+struct OutputSet {
+    tensors: HashMap<String, Tensor>,
+    // recorded once the request writing the set was enqueued
+    written: CudaEvent,
+    // recorded by release_after, on the stream of the last reader
+    released: CudaEvent,
+    release_pending: bool,
+}
+
+struct RingState {
+    free: Mutex<VecDeque<OutputSet>>,
+    returned: Condvar,
+    num_sets: usize,
+}
+
+impl RingState {
+    fn release(&self, set: OutputSet) {
+        self.free.lock().unwrap().push_back(set);
+        self.returned.notify_one();
+    }
+}
+
+// Pre-allocated sets of output tensors that TRTEngine::inference_leased writes requests into
+// in turn. Each result is handed out as an OutputLease that owns its set until dropped, so
+// results are consumed while the engine already runs the next requests instead of between
+// them. With every set leased, the next request waits for one to come back.
+#[derive(Clone)]
+pub struct OutputRing {
+    state: Arc<RingState>,
+}
+
+impl OutputRing {
+    pub(crate) fn new(sets: Vec<HashMap<String, Tensor>>) -> TRTResult<Self> {
+        let mut free = VecDeque::with_capacity(sets.len());
+        for tensors in sets {
+            free.push_back(OutputSet { tensors, written: event()?, released: event()?, release_pending: false });
+        }
+        let num_sets = free.len();
+        Ok(Self { state: Arc::new(RingState { free: Mutex::new(free), returned: Condvar::new(), num_sets }) })
+    }
+
+    pub fn num_sets(&self) -> usize {
+        self.state.num_sets
+    }
+
+    // Sets not currently leased.
+    pub fn num_free(&self) -> usize {
+        self.state.free.lock().unwrap().len()
+    }
+
+    // Takes the next free set, waiting for one to be returned if need be, for a request on
+    // `stream`: its writes are ordered after the previous request's and after its last reader.
+    pub(crate) fn checkout(&self, stream: &CuStream) -> TRTResult<OutputLease> {
+        let mut free = self.state.free.lock().unwrap();
+        let mut set = loop {
+            match free.pop_front() {
+                Some(set) => break set,
+                None => free = self.state.returned.wait(free).unwrap(),
+            }
+        };
+        drop(free);
+        let ordered = set.written.wait(stream) && (!set.release_pending || set.released.wait(stream));
+        set.release_pending = false;
+        let lease = OutputLease { set: Some(set), ring: self.state.clone() };
+        match ordered {
+            true => Ok(lease),
+            false => Err(TRTError::EventError),
+        }
+    }
+}
+
+// The outputs of one request, owned by the caller until dropped, when the set goes back to
+// its ring. They are written asynchronously: wait (or wait_on) before reading them.
+pub struct OutputLease {
+    set: Option<OutputSet>,
+    ring: Arc<RingState>,
+}
+
+impl OutputLease {
+    pub fn get(&self, name: &str) -> Option<&Tensor> {
+        self.tensors().get(name)
+    }
+
+    pub fn tensors(&self) -> &HashMap<String, Tensor> {
+        &self.set.as_ref().unwrap().tensors
+    }
+
+    pub(crate) fn tensors_mut(&mut self) -> &mut HashMap<String, Tensor> {
+        &mut self.set.as_mut().unwrap().tensors
+    }
+
+    pub(crate) fn record_written(&self, stream: &CuStream) -> TRTResult<()> {
+        match self.set.as_ref().unwrap().written.record(stream) {
+            true => Ok(()),
+            false => Err(TRTError::EventError),
+        }
+    }
+
+    pub fn is_ready(&self) -> bool {
+        self.set.as_ref().unwrap().written.is_complete()
+    }
+
+    // Blocks until the request's outputs are written.
+    pub fn wait(&self) -> TRTResult<()> {
+        match self.set.as_ref().unwrap().written.synchronize() {
+            true => Ok(()),
+            false => Err(TRTError::EventError),
+        }
+    }
+
+    // Orders work on `stream` (e.g. postprocessing) after the outputs are written, without
+    // blocking the host.
+    pub fn wait_on(&self, stream: &CuStream) -> TRTResult<()> {
+        match self.set.as_ref().unwrap().written.wait(stream) {
+            true => Ok(()),
+            false => Err(TRTError::EventError),
+        }
+    }
+
+    // Returns the set once the work enqueued on `stream` so far, which reads the outputs, has
+    // run. Dropping the lease instead suits readers that already waited on the host.
+    pub fn release_after(mut self, stream: &CuStream) -> TRTResult<()> {
+        let set = self.set.as_mut().unwrap();
+        set.release_pending = set.released.record(stream);
+        match set.release_pending {
+            true => Ok(()),
+            false => {
+                stream.synchronize()?;
+                Err(TRTError::EventError)
+            }
+        }
+    }
+}
+
+impl Drop for OutputLease {
+    fn drop(&mut self) {
+        if let Some(set) = self.set.take() {
+            self.ring.release(set);
+        }
+    }
+}
@@ -1,9 +1,162 @@
+pub mod accounting;
+pub mod adaptive;
+pub mod affinity;
+pub mod arena;
+pub mod aux_streams;
+pub mod batcher;
+pub mod bench;
+pub mod bucket;
+pub mod builder;
+pub mod calibrator;
+mod cast;
+pub mod chain;
+pub mod completion;
+pub mod compressed;
+pub mod device_pool;
+pub mod dlpack;
+pub mod embeddings;
 pub mod engine;
+pub mod engine_cache;
 pub mod error;
+pub mod executor;
+mod graph;
+pub mod ipc;
+mod l2;
+pub mod layout;
+pub mod lease;
+pub mod loader;
+pub mod mempool;
+pub mod metrics;
+mod nvtx;
+mod output;
+pub mod packing;
+pub mod paged;
+pub mod pipeline;
+pub mod plan;
+pub mod plan_info;
+pub mod plugins;
+pub mod pool;
+pub mod postprocess;
+pub mod prefetch;
+pub mod preprocess;
+pub mod priority;
+pub mod profile;
+pub mod readback;
+pub mod reduce;
+pub mod refit;
+pub mod residency;
+pub mod result_cache;
+pub mod runtime;
+pub mod schema;
+pub mod ring;
+mod region;
+mod shapes;
+pub mod shared;
+pub mod slot;
+pub mod sm_budget;
+pub mod spans;
+pub mod standby;
+pub mod state;
+pub mod staging;
+pub mod startup;
+pub mod static_engine;
+pub mod streaming;
+pub mod tenancy;
 pub mod tensor;
+pub mod trace;
+pub mod typed;
+pub mod variants;
+pub mod view;
+pub mod warmup;
+pub mod weight_streaming;
 
+pub use accounting::{
+    device_memory_usage, set_device_memory_budget, set_memory_hook, EngineMemoryUsage, MemoryCategory, MemoryEvent,
+    MemoryEventKind, MemoryUsage,
+};
+pub use adaptive::{AdaptiveBatchingOptions, BatchController, BatchLimits};
+pub use affinity::{CoreSet, ThreadPinning};
+pub use arena::DeviceMemoryArena;
+pub use aux_streams::AuxStreams;
+pub use batcher::{
+    BatchConfig, BatchInput, BatchOutput, BatchRequest, BatchSubmitter, BatcherStats, DynamicBatcher, OverloadPolicy,
+};
+pub use bench::{
+    run_benchmark, run_memory_benchmark, run_shape_fuzz, BenchOptions, BenchReport, BenchRun, FuzzFailure, FuzzMismatch,
+    LatencyStats, LoadMode, MemoryBenchOptions, MemoryReport, ShapeFuzzOptions, ShapeFuzzReport, ShapeFuzzRun,
+    ShapePattern, UploadMemory,
+};
+pub use bucket::BucketPolicy;
+pub use builder::{BuildOptions, EngineBuilder, TimingCacheFile};
+pub use calibrator::{CalibrationBatch, EntropyCalibrator};
+pub use chain::EngineChain;
+pub use completion::{StreamCompletion, WaitStrategy};
+pub use compressed::{compress_plan, CompressOptions, CompressedPlanReader};
+pub use device_pool::{DeviceEngine, MultiDevicePool, MultiDevicePoolOptions, RoutingPolicy};
+pub use dlpack::{DLManagedTensor, DLPackTensor};
+pub use embeddings::EmbeddingIndex;
 pub use engine::TRTEngine;
+pub use engine_cache::{EngineCache, EngineCacheKey};
 pub use error::{TRTError, TRTResult};
-pub use tensor::{Shape, Tensor};
+pub use executor::{ExecutorOptions, PipelineExecutor};
+pub use ipc::{IpcTensor, IpcTensorHandle};
+pub use l2::L2Window;
+pub use layout::TensorLayout;
+pub use lease::{OutputLease, OutputRing};
+pub use loader::{EngineLoader, EngineSpec, LoaderOptions};
+pub use mempool::DeviceMemoryPool;
+pub use metrics::{EngineMetrics, InferenceTiming, MetricsRegistry};
+pub use packing::SequencePacking;
+pub use paged::{BlockTable, PagedStatePool};
+pub use pipeline::InferencePipeline;
+pub use plan::{PlanCompatibility, PlanFile, PlanLoadOptions};
+pub use plan_info::PlanInfo;
+pub use plugins::{PluginManager, PluginOptions};
+pub use pool::{EnginePool, EnginePoolOptions, PooledEngine};
+pub use postprocess::{CtcDecoder, DbOptions, DbPostprocessor, TextBox, TextCropper};
+pub use prefetch::{PlanPrefetcher, PrefetchMode, PrefetchOptions};
+pub use preprocess::ImagePreprocessor;
+pub use priority::{AdmissionPolicy, PriorityClass};
+pub use profile::{ProfileSelector, ProfileShape};
+pub use readback::{HostOutput, PinnedResult, Readback, ReadbackPool};
+pub use reduce::OutputReduction;
+pub use refit::{DeviceWeights, MappedWeights, NamedWeights, WeightRange, WeightStore};
+pub use residency::{EvictionPolicy, ModelManager, ResidencyOptions};
+pub use result_cache::{ResultCache, ResultCacheStats};
+pub use runtime::SharedRuntime;
+pub use schema::{IoSchema, TensorSchema};
+pub use ring::{submission_ring, RingReceiver, RingSender};
+pub use shared::SharedEngine;
+pub use slot::IoSlot;
+pub use sm_budget::{SmBudget, SmPartition};
+pub use spans::{
+    OtlpJsonExporter, SpanAttributes, SpanExporter, SpanOptions, SpanRecord, SpanTracer, SpanValue, TraceContext,
+};
+pub use standby::ProfileContexts;
+pub use state::{StateBinding, StateSession};
+pub use staging::{GatherInput, GatheredInputs, StagingRing};
+pub use startup::{StartupPhase, StartupTimings};
+pub use static_engine::StaticEngine;
+pub use streaming::{
+    FrameReceiver, FrameResult, FrameSender, FrameStream, OverflowPolicy, StreamStats, StreamingOptions,
+};
+pub use tenancy::{GpuScheduler, GpuSchedulerOptions, Tenant, TenantOptions, TenantUsage};
+pub use tensor::{IoMemory, Shape, Tensor};
+pub use trace::{BatchRecord, RequestRecord, TraceInput, TraceOptions, TraceReader, TraceRecord, TraceRecorder};
+pub use typed::{Half, TrtElement, TypedBinding, TypedSlot, TypedTensor};
+pub use variants::{EngineVariants, VariantEngine, VariantOptions, VariantRouting, VariantSpec};
+pub use view::{copy_view, TensorView};
+pub use warmup::WarmupRun;
+pub use weight_streaming::WeightStreamingBudget;
 
-pub use tensorrt_rs_sys::runtime::DataType;
+pub use tensorrt_rs_sys::allocator::{DeviceAllocator, GpuAllocator};
+pub use tensorrt_rs_sys::builder::{BuilderFlag, DeviceType, HostMemory, Int8Calibrator, MemoryPoolType};
+pub use tensorrt_rs_sys::error_recorder::{ErrorRecorder, RecordedError};
+pub use tensorrt_rs_sys::ipc::{IpcEventHandle, IpcMemHandle};
+pub use tensorrt_rs_sys::logger::{AsyncOverflowPolicy, Severity};
+pub use tensorrt_rs_sys::memory::{HostMemoryKind, MemcpyKind};
+pub use tensorrt_rs_sys::plugin::{
+    OutputDim, Plugin, PluginCreator, PluginCreatorInfo, PluginField, PluginTensor,
+};
+pub use tensorrt_rs_sys::profiler::{LayerProfiler, LayerTiming};
+pub use tensorrt_rs_sys::runtime::{DataType, LayerInformationFormat, OptProfileSelector};
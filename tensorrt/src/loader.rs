@@ -0,0 +1,262 @@
+use crate::{
+    compressed::CompressedPlanReader,
+    engine::TRTEngine,
+    error::TRTResult,
+    plan::{PlanCompatibility, PlanFile, PlanLoadOptions},
+    plan_info::PlanInfo,
+    prefetch::{PlanPrefetcher, PrefetchOptions},
+    runtime::SharedRuntime,
+    startup::StartupPhase,
+    tensor::Shape,
+};
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use std::{
+    collections::HashMap,
+    path::PathBuf,
+    sync::{
+        atomic::{AtomicUsize, Ordering},
+        Condvar, Mutex,
+    },
+    thread,
+    time::Instant,
+};
+
+// One engine to bring up: its plan, the device it runs on, and the max input/output shapes
+// its IO tensors are allocated for (left empty to skip allocation).
+#[derive(Debug, Clone, PartialEq)]
+pub struct EngineSpec {
+    pub path: PathBuf,
+    pub device: i32,
+    pub max_shapes: HashMap<String, Shape>,
+    pub plan: PlanLoadOptions,
+    // DLA core of `device` to load a DLA-built engine onto; None for GPU engines.
+    pub dla_core: Option<i32>,
+}
+
+impl EngineSpec {
+    pub fn new<P: Into<PathBuf>>(path: P, device: i32) -> Self {
+        Self {
+            path: path.into(),
+            device,
+            max_shapes: HashMap::new(),
+            plan: PlanLoadOptions::default(),
+            dla_core: None,
+        }
+    }
+
+    pub fn with_max_shapes(mut self, max_shapes: &HashMap<&str, &Shape>) -> Self {
+        self.max_shapes = max_shapes
+            .iter()
+            .map(|(name, shape)| (name.to_string(), **shape))
+            .collect();
+        self
+    }
+
+    pub fn with_dla_core(mut self, core: i32) -> Self {
+        self.dla_core = Some(core);
+        self
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct LoaderOptions {
+    // Loader threads in total.
+    pub num_workers: usize,
+    // Engines being brought up at once on the same device, bounding device memory spikes
+    // and contention on the device's context.
+    pub max_per_device: usize,
+    // Passed to Runtime::set_max_threads for every engine; None keeps TensorRT's default.
+    pub max_threads: Option<i32>,
+    // Warms the page cache with all plans, in the order of the specs, while the first ones
+    // deserialize, so engines waiting for a device slot do not start from cold storage.
+    pub prefetch: Option<PrefetchOptions>,
+    // Threads decompressing each plan stored compressed (a .zst path, see compress_plan).
+    pub decompress_workers: usize,
+    // Saves a PlanInfo sidecar next to every plan loaded that has none yet, for scheduling
+    // decisions about the model later on without deserializing it.
+    pub save_plan_info: bool,
+    // How plans built for other GPUs or TensorRT versions are loaded.
+    pub compatibility: PlanCompatibility,
+    // Deserializes every GPU engine through this runtime, with its thread count and
+    // compatibility settings in place of max_threads and compatibility; DLA loads still
+    // get a runtime of their own, as the DLA core is a runtime setting.
+    pub runtime: Option<SharedRuntime>,
+}
+
+impl Default for LoaderOptions {
+    fn default() -> Self {
+        Self {
+            num_workers: thread::available_parallelism().map_or(4, |n| n.get()),
+            max_per_device: 2,
+            max_threads: None,
+            prefetch: Some(PrefetchOptions::default()),
+            decompress_workers: 4,
+            save_plan_info: true,
+            compatibility: PlanCompatibility::default(),
+            runtime: None,
+        }
+    }
+}
+
+// Reads, deserializes, activates and allocates many engines concurrently, e.g. at service
+// startup, instead of one TRTEngine::new after the other.
+pub struct EngineLoader {
+    options: LoaderOptions,
+}
+
+impl EngineLoader {
+    pub fn new(options: LoaderOptions) -> Self {
+        Self { options }
+    }
+
+    // One result per spec, in the order of `specs`. A failing engine does not stop the others.
+    pub fn load(&self, specs: &[EngineSpec]) -> Vec<TRTResult<TRTEngine>> {
+        let next = AtomicUsize::new(0);
+        let slots = DeviceSlots::new(self.options.max_per_device.max(1));
+        let results: Mutex<Vec<Option<TRTResult<TRTEngine>>>> =
+            Mutex::new((0..specs.len()).map(|_| None).collect());
+        let prefetcher = self.options.prefetch.map(PlanPrefetcher::new);
+        if let Some(prefetcher) = prefetcher.as_ref() {
+            specs.iter().for_each(|spec| prefetcher.prefetch(&spec.path));
+        }
+
+        let num_workers = self.options.num_workers.clamp(1, specs.len().max(1));
+        thread::scope(|scope| {
+            for _ in 0..num_workers {
+                scope.spawn(|| loop {
+                    let index = next.fetch_add(1, Ordering::Relaxed);
+                    let spec = match specs.get(index) {
+                        Some(spec) => spec,
+                        None => break,
+                    };
+                    let res = {
+                        let _slot = slots.acquire(spec.device);
+                        self.load_one(spec)
+                    };
+                    results.lock().unwrap()[index] = Some(res);
+                });
+            }
+        });
+
+        results
+            .into_inner()
+            .unwrap()
+            .into_iter()
+            .map(|res| res.unwrap())
+            .collect()
+    }
+
+    fn load_one(&self, spec: &EngineSpec) -> TRTResult<TRTEngine> {
+        // worker threads have no current context; bind the device's primary one
+        let device = CuDevice::new(spec.device)?;
+        let ctx = device.retain_primary_context()?;
+        let _guard = ctx.guard()?;
+        let stream = CuStream::new()?;
+
+        let (max_threads, dla_core) = (self.options.max_threads, spec.dla_core);
+        let compatibility = &self.options.compatibility;
+        let shared = self.options.runtime.as_ref().filter(|_| dla_core.is_none());
+        let mut engine = match spec.path.extension().map_or(false, |extension| extension == "zst") {
+            true => {
+                let reader = CompressedPlanReader::open(&spec.path, self.options.decompress_workers)?;
+                match shared {
+                    Some(runtime) => TRTEngine::from_reader_shared(reader, &stream, runtime)?,
+                    None => TRTEngine::from_reader_on(reader, &stream, max_threads, dla_core, compatibility)?,
+                }
+            }
+            false => {
+                let started = Instant::now();
+                let plan = PlanFile::open(&spec.path, &spec.plan)?;
+                let read = started.elapsed();
+                let mut engine = match shared {
+                    Some(runtime) => TRTEngine::from_bytes_shared(plan.as_bytes(), &stream, runtime)?,
+                    None => TRTEngine::from_bytes_on(plan.as_bytes(), &stream, max_threads, dla_core, compatibility)?,
+                };
+                plan.release()?;
+                engine.record_startup(StartupPhase::PlanRead, read);
+                engine
+            }
+        };
+
+        if self.options.save_plan_info && PlanInfo::load(&spec.path).is_none() {
+            // a read-only plan directory does not fail the load
+            PlanInfo::from_engine(&engine).and_then(|info| info.save(&spec.path)).ok();
+        }
+
+        engine.activate()?;
+        if !spec.max_shapes.is_empty() {
+            let max_shape_dict: HashMap<&str, &Shape> = spec
+                .max_shapes
+                .iter()
+                .map(|(name, shape)| (name.as_str(), shape))
+                .collect();
+            engine.allocate_io_tensors(&max_shape_dict, None)?;
+        }
+        stream.synchronize()?;
+        Ok(engine)
+    }
+}
+
+impl Default for EngineLoader {
+    fn default() -> Self {
+        Self::new(LoaderOptions::default())
+    }
+}
+
+// A counting semaphore per device.
+struct DeviceSlots {
+    in_use: Mutex<HashMap<i32, usize>>,
+    released: Condvar,
+    limit: usize,
+}
+
+impl DeviceSlots {
+    fn new(limit: usize) -> Self {
+        Self {
+            in_use: Mutex::new(HashMap::new()),
+            released: Condvar::new(),
+            limit,
+        }
+    }
+
+    fn acquire(&self, device: i32) -> DeviceSlot<'_> {
+        let mut in_use = self.in_use.lock().unwrap();
+        while *in_use.get(&device).unwrap_or(&0) >= self.limit {
+            in_use = self.released.wait(in_use).unwrap();
+        }
+        *in_use.entry(device).or_insert(0) += 1;
+        DeviceSlot { slots: self, device }
+    }
+}
+
+struct DeviceSlot<'a> {
+    slots: &'a DeviceSlots,
+    device: i32,
+}
+
+impl Drop for DeviceSlot<'_> {
+    fn drop(&mut self) {
+        let mut in_use = self.slots.in_use.lock().unwrap();
+        if let Some(count) = in_use.get_mut(&self.device) {
+            *count -= 1;
+        }
+        self.slots.released.notify_all();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn device_slots_limit_per_device() {
+        let slots = DeviceSlots::new(1);
+        let first = slots.acquire(0);
+        // another device is not blocked by device 0
+        let other = slots.acquire(1);
+        drop(first);
+        let _again = slots.acquire(0);
+        drop(other);
+        assert_eq!(slots.in_use.lock().unwrap()[&1], 0);
+    }
+}
@@ -0,0 +1,153 @@
+use crate::{
+    accounting::{MemoryCategory, MemoryReservation},
+    error::TRTResult,
+    staging::event,
+};
+use cuda_rs::{memory::DeviceMemory, stream::CuStream};
+use std::{
+    collections::HashMap,
+    sync::{Arc, Mutex},
+};
+use tensorrt_rs_sys::stream::CudaEvent;
+
+struct FreeBlock {
+    mem: DeviceMemory,
+    reservation: MemoryReservation,
+    // recorded on `stream` when the block was returned
+    released: CudaEvent,
+    stream: usize,
+}
+
+#[derive(Default)]
+struct PoolState {
+    free: HashMap<usize, Vec<FreeBlock>>,
+    events: Vec<CudaEvent>,
+    cached_bytes: usize,
+}
+
+// Size-class device memory pool for per-request tensors (Tensor::empty_pooled), so building
+// a tensor no longer costs a device-synchronizing cudaMalloc/cudaFree pair.
+//
+// Reuse is stream-ordered: a block released on a stream is handed out again on that stream
+// straight away, since later work there runs after the work that used it. Blocks released
+// on other streams are only reused once their release event has completed, or else after
+// making the new stream wait on it.
+pub struct DeviceMemoryPool {
+    state: Mutex<PoolState>,
+    max_cached_bytes: usize,
+}
+
+impl DeviceMemoryPool {
+    // Blocks beyond `max_cached_bytes` of idle memory are freed instead of cached.
+    pub fn new(max_cached_bytes: usize) -> Arc<Self> {
+        Arc::new(Self {
+            state: Mutex::new(PoolState::default()),
+            max_cached_bytes,
+        })
+    }
+
+    pub fn cached_bytes(&self) -> usize {
+        self.state.lock().unwrap().cached_bytes
+    }
+
+    // Frees every idle block.
+    pub fn trim(&self) {
+        let mut state = self.state.lock().unwrap();
+        for (_, blocks) in state.free.drain() {
+            for block in blocks {
+                block.released.synchronize();
+            }
+        }
+        state.cached_bytes = 0;
+    }
+
+    // Returns the block and its size class, which is at least `size` bytes.
+    pub(crate) fn allocate(
+        &self,
+        size: usize,
+        stream: &CuStream,
+    ) -> TRTResult<(DeviceMemory, usize, MemoryReservation)> {
+        let class = size_class(size);
+        let key = unsafe { stream.get_raw() } as usize;
+
+        let mut state = self.state.lock().unwrap();
+        let taken = state.free.get_mut(&class).and_then(|blocks| {
+            let index = blocks
+                .iter()
+                .rposition(|block| block.stream == key)
+                .or_else(|| blocks.iter().rposition(|block| block.released.is_complete()))
+                .or_else(|| blocks.len().checked_sub(1))?;
+            Some(blocks.swap_remove(index))
+        });
+        match taken {
+            Some(block) => {
+                if block.stream != key && !block.released.wait(stream) {
+                    block.released.synchronize();
+                }
+                state.cached_bytes -= class;
+                state.events.push(block.released);
+                Ok((block.mem, class, block.reservation))
+            }
+            None => {
+                drop(state);
+                let reservation = MemoryReservation::new(MemoryCategory::Pool, class)?;
+                Ok((DeviceMemory::new(class, stream)?, class, reservation))
+            }
+        }
+    }
+
+    pub(crate) fn release(&self, mem: DeviceMemory, class: usize, reservation: MemoryReservation, stream: &CuStream) {
+        let mut state = self.state.lock().unwrap();
+        if state.cached_bytes + class > self.max_cached_bytes {
+            drop(state);
+            // freed in stream order by the memory itself
+            drop(mem);
+            return;
+        }
+        let released = match state.events.pop() {
+            Some(event) => event,
+            None => match event() {
+                Ok(event) => event,
+                Err(_) => return,
+            },
+        };
+        if !released.record(stream) {
+            return;
+        }
+        let key = unsafe { stream.get_raw() } as usize;
+        state.cached_bytes += class;
+        state.free.entry(class).or_default().push(FreeBlock { mem, reservation, released, stream: key });
+    }
+}
+
+impl Drop for DeviceMemoryPool {
+    fn drop(&mut self) {
+        self.trim();
+    }
+}
+
+// Four classes per power of two, from 256 bytes: at most 25% of a block goes unused.
+fn size_class(size: usize) -> usize {
+    let size = size.max(256);
+    let step = (size.next_power_of_two() / 8).max(256);
+    (size + step - 1) / step * step
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn size_classes() {
+        assert_eq!(size_class(0), 256);
+        assert_eq!(size_class(256), 256);
+        assert_eq!(size_class(257), 512);
+        assert_eq!(size_class(1000), 1024);
+        assert_eq!(size_class(1025), 1280);
+        assert_eq!(size_class(3 * 224 * 224 * 4), 655360);
+        for size in [1usize, 300, 5000, 70000, 1 << 20, (1 << 20) + 1] {
+            let class = size_class(size);
+            assert!(class >= size && class <= size.max(256) * 5 / 4 + 256);
+        }
+    }
+}
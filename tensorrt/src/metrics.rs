@@ -0,0 +1,494 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    startup::{StartupPhase, StartupTimings},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::VecDeque,
+    fmt::Write,
+    sync::{
+        atomic::{AtomicI64, AtomicU64, Ordering},
+        Arc, Mutex,
+    },
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::stream::CudaEvent;
+
+// Upper bounds in microseconds, exported in seconds.
+const LATENCY_BOUNDS_US: &[u64] = &[
+    10, 25, 50, 100, 250, 500, 1_000, 2_500, 5_000, 10_000, 25_000, 50_000, 100_000, 250_000, 1_000_000,
+];
+const BATCH_BOUNDS: &[u64] = &[1, 2, 4, 8, 16, 32, 64, 128, 256, 512];
+
+#[derive(Debug, Default)]
+pub struct Counter(AtomicU64);
+
+impl Counter {
+    pub fn inc(&self) {
+        self.add(1);
+    }
+
+    pub fn add(&self, value: u64) {
+        self.0.fetch_add(value, Ordering::Relaxed);
+    }
+
+    pub fn get(&self) -> u64 {
+        self.0.load(Ordering::Relaxed)
+    }
+}
+
+#[derive(Debug, Default)]
+pub struct Gauge(AtomicI64);
+
+impl Gauge {
+    pub fn set(&self, value: i64) {
+        self.0.store(value, Ordering::Relaxed);
+    }
+
+    pub fn get(&self) -> i64 {
+        self.0.load(Ordering::Relaxed)
+    }
+}
+
+// Fixed-bucket histogram of integer observations; every operation is a few relaxed atomics.
+#[derive(Debug)]
+pub struct Histogram {
+    bounds: &'static [u64],
+    // exported bound = bound / per_unit, e.g. 1e6 for microseconds exported as seconds; a
+    // division so the bounds come out exact (50 / 1e6 is 5e-5, 50 * 1e-6 is not)
+    per_unit: f64,
+    // one per bound, and the +Inf bucket last; not cumulative
+    buckets: Box<[AtomicU64]>,
+    sum: AtomicU64,
+    count: AtomicU64,
+}
+
+impl Histogram {
+    fn new(bounds: &'static [u64], per_unit: f64) -> Self {
+        Self {
+            bounds,
+            per_unit,
+            buckets: (0..=bounds.len()).map(|_| AtomicU64::new(0)).collect(),
+            sum: AtomicU64::new(0),
+            count: AtomicU64::new(0),
+        }
+    }
+
+    pub fn observe(&self, value: u64) {
+        let bucket = self.bounds.partition_point(|&bound| bound < value);
+        self.buckets[bucket].fetch_add(1, Ordering::Relaxed);
+        self.sum.fetch_add(value, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+    }
+
+    pub fn observe_duration(&self, duration: Duration) {
+        self.observe(duration.as_micros().min(u64::MAX as u128) as u64);
+    }
+
+    pub fn count(&self) -> u64 {
+        self.count.load(Ordering::Relaxed)
+    }
+
+    // Sum of the observations, in exported units.
+    pub fn sum(&self) -> f64 {
+        self.sum.load(Ordering::Relaxed) as f64 / self.per_unit
+    }
+
+    fn render(&self, out: &mut String, name: &str, labels: &str) {
+        let mut cumulative = 0;
+        for (i, bucket) in self.buckets.iter().enumerate() {
+            cumulative += bucket.load(Ordering::Relaxed);
+            match self.bounds.get(i) {
+                Some(&bound) => {
+                    let le = bound as f64 / self.per_unit;
+                    writeln!(out, "{}_bucket{{{},le=\"{}\"}} {}", name, labels, le, cumulative)
+                }
+                None => writeln!(out, "{}_bucket{{{},le=\"+Inf\"}} {}", name, labels, cumulative),
+            }
+            .unwrap();
+        }
+        writeln!(out, "{}_sum{{{}}} {}", name, labels, self.sum()).unwrap();
+        writeln!(out, "{}_count{{{}}} {}", name, labels, self.count()).unwrap();
+    }
+}
+
+// Hot-path metrics of one engine, or of every context sharing its name (e.g. an EnginePool).
+#[derive(Debug)]
+pub struct EngineMetrics {
+    pub requests: Counter,
+    pub errors: Counter,
+    // host time spent in inference/execute, including the input copies being issued
+    pub enqueue_time: Histogram,
+    // device time of the enqueued work, and of the input copies before it; calls beyond the
+    // timing events in flight go untimed
+    pub gpu_time: Histogram,
+    pub copy_time: Histogram,
+    pub copy_bytes: Counter,
+    pub batch_size: Histogram,
+    // arrival to execution of batched requests
+    pub queue_wait: Histogram,
+    pub queue_depth: Gauge,
+    // the batch-size cap and batch wait (microseconds) a BatchController last set
+    pub batch_size_limit: Gauge,
+    pub batch_delay_limit: Gauge,
+    // microseconds of every StartupPhase, in StartupPhase::ALL order, of the engine that last
+    // reported under this name
+    pub startup: [Gauge; 7],
+}
+
+impl Default for EngineMetrics {
+    fn default() -> Self {
+        Self {
+            requests: Counter::default(),
+            errors: Counter::default(),
+            enqueue_time: Histogram::new(LATENCY_BOUNDS_US, 1e6),
+            gpu_time: Histogram::new(LATENCY_BOUNDS_US, 1e6),
+            copy_time: Histogram::new(LATENCY_BOUNDS_US, 1e6),
+            copy_bytes: Counter::default(),
+            batch_size: Histogram::new(BATCH_BOUNDS, 1.0),
+            queue_wait: Histogram::new(LATENCY_BOUNDS_US, 1e6),
+            queue_depth: Gauge::default(),
+            batch_size_limit: Gauge::default(),
+            batch_delay_limit: Gauge::default(),
+            startup: Default::default(),
+        }
+    }
+}
+
+impl EngineMetrics {
+    // Publishes the phases of `timings` that ran.
+    pub fn set_startup(&self, timings: &StartupTimings) {
+        for phase in StartupPhase::ALL {
+            if let Some(duration) = timings.get(phase) {
+                self.startup[phase.index()].set(duration.as_micros().min(i64::MAX as u128) as i64);
+            }
+        }
+    }
+}
+
+// Named EngineMetrics, pulled by a scraper through render_prometheus.
+pub struct MetricsRegistry {
+    engines: Mutex<Vec<(String, Arc<EngineMetrics>)>>,
+}
+
+static GLOBAL: MetricsRegistry = MetricsRegistry { engines: Mutex::new(Vec::new()) };
+
+impl MetricsRegistry {
+    pub fn global() -> &'static MetricsRegistry {
+        &GLOBAL
+    }
+
+    // The metrics registered under `name`, created on first use.
+    pub fn register(&self, name: &str) -> Arc<EngineMetrics> {
+        let mut engines = self.engines.lock().unwrap();
+        if let Some((_, metrics)) = engines.iter().find(|(engine, _)| engine == name) {
+            return metrics.clone();
+        }
+        let metrics = Arc::new(EngineMetrics::default());
+        engines.push((name.to_string(), metrics.clone()));
+        metrics
+    }
+
+    pub fn get(&self, name: &str) -> Option<Arc<EngineMetrics>> {
+        let engines = self.engines.lock().unwrap();
+        engines.iter().find(|(engine, _)| engine == name).map(|(_, metrics)| metrics.clone())
+    }
+
+    pub fn unregister(&self, name: &str) {
+        self.engines.lock().unwrap().retain(|(engine, _)| engine != name);
+    }
+
+    // Prometheus text exposition format, one series per engine label.
+    pub fn render_prometheus(&self) -> String {
+        let engines: Vec<_> = self.engines.lock().unwrap().clone();
+        let labels: Vec<String> = engines.iter().map(|(name, _)| format!("engine=\"{}\"", escape(name))).collect();
+        let mut out = String::new();
+
+        let counters: [(&str, &str, fn(&EngineMetrics) -> &Counter); 3] = [
+            ("trt_requests_total", "Inference requests.", |m| &m.requests),
+            ("trt_errors_total", "Failed inference requests.", |m| &m.errors),
+            ("trt_copy_bytes_total", "Bytes copied into engine inputs.", |m| &m.copy_bytes),
+        ];
+        for (name, help, counter) in counters {
+            writeln!(out, "# HELP {} {}\n# TYPE {} counter", name, help, name).unwrap();
+            for ((_, metrics), labels) in engines.iter().zip(&labels) {
+                writeln!(out, "{}{{{}}} {}", name, labels, counter(metrics).get()).unwrap();
+            }
+        }
+
+        let gauges: [(&str, &str, fn(&EngineMetrics) -> &Gauge); 3] = [
+            ("trt_queue_depth", "Requests waiting in the batcher queue.", |m| &m.queue_depth),
+            ("trt_batch_size_limit", "Batch-size cap set by the batch controller.", |m| &m.batch_size_limit),
+            ("trt_batch_delay_limit_us", "Batch wait set by the batch controller.", |m| &m.batch_delay_limit),
+        ];
+        for (name, help, gauge) in gauges {
+            writeln!(out, "# HELP {} {}\n# TYPE {} gauge", name, help, name).unwrap();
+            for ((_, metrics), labels) in engines.iter().zip(&labels) {
+                writeln!(out, "{}{{{}}} {}", name, labels, gauge(metrics).get()).unwrap();
+            }
+        }
+
+        let name = "trt_startup_phase_us";
+        writeln!(out, "# HELP {} Wall time of each engine startup phase.\n# TYPE {} gauge", name, name).unwrap();
+        for ((_, metrics), labels) in engines.iter().zip(&labels) {
+            for phase in StartupPhase::ALL {
+                let value = metrics.startup[phase.index()].get();
+                writeln!(out, "{}{{{},phase=\"{}\"}} {}", name, labels, phase.name(), value).unwrap();
+            }
+        }
+
+        let histograms: [(&str, &str, fn(&EngineMetrics) -> &Histogram); 5] = [
+            ("trt_enqueue_seconds", "Host time to issue an inference.", |m| &m.enqueue_time),
+            ("trt_gpu_seconds", "Device execution time of timed calls.", |m| &m.gpu_time),
+            ("trt_copy_seconds", "Device time of input copies of timed calls.", |m| &m.copy_time),
+            ("trt_batch_size", "Rows per executed batch.", |m| &m.batch_size),
+            ("trt_queue_wait_seconds", "Batcher queue wait per request.", |m| &m.queue_wait),
+        ];
+        for (name, help, histogram) in histograms {
+            writeln!(out, "# HELP {} {}\n# TYPE {} histogram", name, help, name).unwrap();
+            for ((_, metrics), labels) in engines.iter().zip(&labels) {
+                histogram(metrics).render(&mut out, name, labels);
+            }
+        }
+        out
+    }
+}
+
+fn escape(value: &str) -> String {
+    value.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n")
+}
+
+// Host and device time of one timed inference call.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct InferenceTiming {
+    // as returned by TRTEngine::inference_timed
+    pub sequence: u64,
+    // host time spent in the call, including the input copies being issued
+    pub host: Duration,
+    // device time of the input copies, zero when they are not issued by the call (e.g. graph
+    // launches)
+    pub copy: Duration,
+    // device time from the end of the copies to the end of enqueueV3's work
+    pub gpu: Duration,
+}
+
+// Every call in flight holds one triple, at most this many at once; calls beyond go untimed.
+const MAX_TIMED_IN_FLIGHT: usize = 32;
+// completed timings kept until they are taken
+const MAX_COMPLETED: usize = 256;
+
+struct TimingEvents {
+    start: CudaEvent,
+    copied: CudaEvent,
+    done: CudaEvent,
+}
+
+impl TimingEvents {
+    fn new() -> Option<Self> {
+        Some(Self {
+            start: CudaEvent::with_timing()?,
+            copied: CudaEvent::with_timing()?,
+            done: CudaEvent::with_timing()?,
+        })
+    }
+}
+
+struct InFlight {
+    sequence: u64,
+    host: Duration,
+    events: TimingEvents,
+}
+
+// Device timing from start/copied/done event triples, recycled once their call completed.
+// Completions are polled, never waited for, so the request path never blocks on the device.
+#[derive(Default)]
+struct GpuTimer {
+    idle: Vec<TimingEvents>,
+    created: usize,
+    in_flight: VecDeque<InFlight>,
+    completed: VecDeque<InferenceTiming>,
+    next_sequence: u64,
+}
+
+impl GpuTimer {
+    fn checkout(&mut self) -> Option<TimingEvents> {
+        if let Some(events) = self.idle.pop() {
+            return Some(events);
+        }
+        if self.created == MAX_TIMED_IN_FLIGHT {
+            return None;
+        }
+        let events = TimingEvents::new()?;
+        self.created += 1;
+        Some(events)
+    }
+
+    // Moves the completed calls into `completed`, in any order, as they may run on several
+    // streams.
+    fn harvest(&mut self, metrics: &EngineMetrics) {
+        let mut i = 0;
+        while i < self.in_flight.len() {
+            if !self.in_flight[i].events.done.is_complete() {
+                i += 1;
+                continue;
+            }
+            let InFlight { sequence, host, events } = self.in_flight.remove(i).unwrap();
+            let times = (events.copied.elapsed_ms_since(&events.start), events.done.elapsed_ms_since(&events.copied));
+            if let (Some(copy), Some(gpu)) = times {
+                let timing = InferenceTiming {
+                    sequence,
+                    host,
+                    copy: Duration::from_secs_f32(copy.max(0.0) / 1e3),
+                    gpu: Duration::from_secs_f32(gpu.max(0.0) / 1e3),
+                };
+                metrics.copy_time.observe_duration(timing.copy);
+                metrics.gpu_time.observe_duration(timing.gpu);
+                if self.completed.len() == MAX_COMPLETED {
+                    self.completed.pop_front();
+                }
+                self.completed.push_back(timing);
+            }
+            self.idle.push(events);
+        }
+    }
+}
+
+pub(crate) struct Sample {
+    started: Instant,
+    events: Option<TimingEvents>,
+}
+
+// Per-engine instrumentation state; the metrics themselves may be shared.
+pub(crate) struct Instrumentation {
+    metrics: Arc<EngineMetrics>,
+    timer: Option<GpuTimer>,
+}
+
+impl Instrumentation {
+    pub(crate) fn new(metrics: Arc<EngineMetrics>, gpu_timing: bool) -> TRTResult<Self> {
+        let mut timer = match gpu_timing {
+            true => Some(GpuTimer::default()),
+            false => None,
+        };
+        // one triple up front, so that a failing event creation surfaces here
+        if let Some(timer) = timer.as_mut() {
+            match timer.checkout() {
+                Some(events) => timer.idle.push(events),
+                None => return Err(TRTError::EventError),
+            }
+        }
+        Ok(Self { metrics, timer })
+    }
+
+    pub(crate) fn metrics(&self) -> &Arc<EngineMetrics> {
+        &self.metrics
+    }
+
+    pub(crate) fn begin(&mut self, stream: &CuStream) -> Sample {
+        let started = Instant::now();
+        let timer = match self.timer.as_mut() {
+            Some(timer) => timer,
+            None => return Sample { started, events: None },
+        };
+        timer.harvest(&self.metrics);
+        let events = match timer.checkout() {
+            Some(events) => events,
+            None => return Sample { started, events: None },
+        };
+        // the copy time stays zero unless the copies re-record `copied`, e.g. inside a graph
+        if !events.start.record(stream) || !events.copied.record(stream) {
+            timer.idle.push(events);
+            return Sample { started, events: None };
+        }
+        Sample { started, events: Some(events) }
+    }
+
+    // Recorded after the input copies are issued; None when the sample is not timed.
+    pub(crate) fn copied_event<'a>(&self, sample: &'a Sample) -> Option<&'a CudaEvent> {
+        sample.events.as_ref().map(|events| &events.copied)
+    }
+
+    // The sequence number the call's timing is reported under, when it is timed.
+    pub(crate) fn end<T>(&mut self, sample: Sample, stream: &CuStream, res: &TRTResult<T>, copy_bytes: usize) -> Option<u64> {
+        let host = sample.started.elapsed();
+        self.metrics.enqueue_time.observe_duration(host);
+        self.metrics.requests.inc();
+        self.metrics.copy_bytes.add(copy_bytes as u64);
+        if res.is_err() {
+            self.metrics.errors.inc();
+        }
+        let (timer, events) = match (self.timer.as_mut(), sample.events) {
+            (Some(timer), Some(events)) => (timer, events),
+            _ => return None,
+        };
+        if res.is_err() || !events.done.record(stream) {
+            timer.idle.push(events);
+            return None;
+        }
+        let sequence = timer.next_sequence;
+        timer.next_sequence += 1;
+        timer.in_flight.push_back(InFlight { sequence, host, events });
+        Some(sequence)
+    }
+
+    // The timing of call `sequence` once its work completed; it is taken out of the completed
+    // timings.
+    pub(crate) fn take_timing(&mut self, sequence: u64) -> Option<InferenceTiming> {
+        let timer = self.timer.as_mut()?;
+        timer.harvest(&self.metrics);
+        let index = timer.completed.iter().position(|timing| timing.sequence == sequence)?;
+        timer.completed.remove(index)
+    }
+
+    pub(crate) fn drain_timings(&mut self) -> Vec<InferenceTiming> {
+        match self.timer.as_mut() {
+            Some(timer) => {
+                timer.harvest(&self.metrics);
+                timer.completed.drain(..).collect()
+            }
+            None => Vec::new(),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn histogram_buckets_are_cumulative_on_export() {
+        let histogram = Histogram::new(&[10, 100], 1.0);
+        for value in [5, 10, 11, 1000] {
+            histogram.observe(value);
+        }
+        let mut out = String::new();
+        histogram.render(&mut out, "h", "engine=\"e\"");
+        assert!(out.contains("h_bucket{engine=\"e\",le=\"10\"} 2"));
+        assert!(out.contains("h_bucket{engine=\"e\",le=\"100\"} 3"));
+        assert!(out.contains("h_bucket{engine=\"e\",le=\"+Inf\"} 4"));
+        assert!(out.contains("h_count{engine=\"e\"} 4"));
+        assert!(out.contains("h_sum{engine=\"e\"} 1026"));
+    }
+
+    #[test]
+    fn microsecond_bounds_export_as_exact_seconds() {
+        let histogram = Histogram::new(&[50, 250], 1e6);
+        histogram.observe(50);
+        let mut out = String::new();
+        histogram.render(&mut out, "h", "engine=\"e\"");
+        assert!(out.contains("h_bucket{engine=\"e\",le=\"0.00005\"} 1"));
+        assert!(out.contains("h_bucket{engine=\"e\",le=\"0.00025\"} 1"));
+        assert!(out.contains("h_sum{engine=\"e\"} 0.00005"));
+    }
+
+    #[test]
+    fn registry_shares_metrics_by_name() {
+        let registry = MetricsRegistry { engines: Mutex::new(Vec::new()) };
+        let a = registry.register("det\"ector");
+        registry.register("det\"ector").requests.add(3);
+        assert_eq!(a.requests.get(), 3);
+        let text = registry.render_prometheus();
+        assert!(text.contains("trt_requests_total{engine=\"det\\\"ector\"} 3"));
+        assert!(text.contains("# TYPE trt_gpu_seconds histogram"));
+    }
+}
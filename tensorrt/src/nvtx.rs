@@ -0,0 +1,74 @@
+// NVTX ranges around the crate's hot paths, in the "tensorrt-rs" domain. Without the `nvtx`
+// feature a range is a zero-sized guard and `range!` compiles to nothing.
+#[cfg(feature = "nvtx")]
+use std::sync::Once;
+#[cfg(feature = "nvtx")]
+use tensorrt_rs_sys::nvtx;
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub(crate) enum Category {
+    // host to device copies of the inputs, casts included
+    Copy = 1,
+    // setInputShape and output shape inference
+    Shape = 2,
+    // enqueueV3 and graph launches
+    Enqueue = 3,
+    // waits for requests, contexts or streams
+    Wait = 4,
+    // batch assembly and scatter
+    Batch = 5,
+    // stages of an InferencePipeline
+    Pipeline = 6,
+}
+
+#[cfg(feature = "nvtx")]
+const CATEGORIES: [(Category, &str); 6] = [
+    (Category::Copy, "copy"),
+    (Category::Shape, "shape"),
+    (Category::Enqueue, "enqueue"),
+    (Category::Wait, "wait"),
+    (Category::Batch, "batch"),
+    (Category::Pipeline, "pipeline"),
+];
+
+// Pops its range when dropped.
+#[must_use]
+pub(crate) struct Range {
+    _private: (),
+}
+
+impl Range {
+    // `message` ends with a NUL, see range!.
+    #[inline(always)]
+    #[allow(unused_variables)]
+    pub(crate) fn push(category: Category, message: &'static str) -> Self {
+        #[cfg(feature = "nvtx")]
+        {
+            static NAMED: Once = Once::new();
+            NAMED.call_once(|| {
+                for (category, name) in CATEGORIES {
+                    nvtx::name_category(category as u32, name);
+                }
+            });
+            nvtx::range_push(category as u32, message);
+        }
+        Self { _private: () }
+    }
+}
+
+#[cfg(feature = "nvtx")]
+impl Drop for Range {
+    fn drop(&mut self) {
+        nvtx::range_pop();
+    }
+}
+
+// range!(Category::Copy, "copy inputs") opens a range until the end of the scope when bound:
+// `let _range = range!(..);`.
+macro_rules! range {
+    ($category:expr, $message:literal) => {
+        crate::nvtx::Range::push($category, concat!($message, "\0"))
+    };
+}
+
+pub(crate) use range;
@@ -0,0 +1,145 @@
+use crate::{
+    accounting::{MemoryCategory, MemoryReservation},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::{memory::DeviceMemory, stream::CuStream};
+use tensorrt_rs_sys::{
+    runtime::{DataType, OutputAllocator},
+    stream::CudaEvent,
+};
+use std::sync::{Arc, Mutex};
+
+// A buffer replaced by a larger one, kept until the work queued before the switch is done.
+struct RetiredBlock {
+    _mem: DeviceMemory,
+    _reservation: Option<MemoryReservation>,
+    released: CudaEvent,
+}
+
+struct GrowableOutputState {
+    mem: Option<DeviceMemory>,
+    reservation: Option<MemoryReservation>,
+    capacity: usize,
+    shape: Option<Shape>,
+    retired: Vec<RetiredBlock>,
+}
+
+impl GrowableOutputState {
+    fn release_completed(&mut self) {
+        self.retired.retain(|block| !block.released.is_complete());
+    }
+}
+
+impl Drop for GrowableOutputState {
+    fn drop(&mut self) {
+        for block in &self.retired {
+            block.released.synchronize();
+        }
+    }
+}
+
+// Output buffer for a data-dependent output shape. TensorRT asks for memory once the size
+// is known during enqueue; the buffer only grows and is reused by every later request.
+pub(crate) struct GrowableOutput {
+    state: Arc<Mutex<GrowableOutputState>>,
+    dtype: DataType,
+}
+
+impl GrowableOutput {
+    pub(crate) fn new(dtype: DataType) -> Self {
+        let state = GrowableOutputState {
+            mem: None,
+            reservation: None,
+            capacity: 0,
+            shape: None,
+            retired: Vec::new(),
+        };
+        Self {
+            state: Arc::new(Mutex::new(state)),
+            dtype,
+        }
+    }
+
+    pub(crate) fn allocator(&self, stream: &CuStream) -> GrowableOutputAllocator {
+        GrowableOutputAllocator {
+            state: self.state.clone(),
+            stream: stream.clone(),
+        }
+    }
+
+    pub(crate) fn capacity(&self) -> usize {
+        self.state.lock().unwrap().capacity
+    }
+
+    // A non-owning tensor over the current buffer with the shape TensorRT reported for the
+    // last enqueue, or None if nothing has been produced yet.
+    pub(crate) fn tensor(&self, stream: &CuStream) -> Option<Tensor> {
+        let state = self.state.lock().unwrap();
+        let mem = state.mem.as_ref()?;
+        let shape = state.shape.as_ref()?;
+        let ptr = unsafe { mem.get_raw() } as usize;
+        Some(Tensor::from_raw_ptr(ptr, shape, self.dtype, stream))
+    }
+}
+
+pub(crate) struct GrowableOutputAllocator {
+    state: Arc<Mutex<GrowableOutputState>>,
+    stream: CuStream,
+}
+
+impl OutputAllocator for GrowableOutputAllocator {
+    fn reallocate_output(
+        &mut self,
+        _tensor_name: &str,
+        _current_memory: usize,
+        size: u64,
+        _alignment: u64,
+        stream: usize,
+    ) -> usize {
+        let mut state = self.state.lock().unwrap();
+        state.release_completed();
+        let size = size as usize;
+        if state.mem.is_none() || state.capacity < size {
+            // grow geometrically so a slowly increasing output does not reallocate each time
+            let capacity = size.max(state.capacity + state.capacity / 2).max(1);
+            let reservation = match MemoryReservation::new(MemoryCategory::Outputs, capacity) {
+                Ok(reservation) => reservation,
+                Err(_) => return 0,
+            };
+            let mem = match DeviceMemory::new(capacity, &self.stream) {
+                Ok(mem) => mem,
+                Err(_) => return 0,
+            };
+            // earlier enqueues and readbacks of the old buffer may still be queued: it is freed
+            // once an event recorded behind them has completed, not here
+            if let Some(old) = state.mem.take() {
+                let own = unsafe { self.stream.get_raw() } as usize;
+                let stream = if stream == 0 { own } else { stream };
+                let released = match CudaEvent::new() {
+                    Some(event) if event.record_raw(stream) => event,
+                    _ => {
+                        state.mem = Some(old);
+                        return 0;
+                    }
+                };
+                let reservation = state.reservation.take();
+                state.retired.push(RetiredBlock {
+                    _mem: old,
+                    _reservation: reservation,
+                    released,
+                });
+            }
+            state.mem = Some(mem);
+            state.reservation = Some(reservation);
+            state.capacity = capacity;
+        }
+        match state.mem.as_ref() {
+            Some(mem) => unsafe { mem.get_raw() as usize },
+            None => 0,
+        }
+    }
+
+    fn notify_shape(&mut self, _tensor_name: &str, dims: &[i32]) {
+        self.state.lock().unwrap().shape = Some(Shape::new(dims));
+    }
+}
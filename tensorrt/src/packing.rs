@@ -0,0 +1,116 @@
+use crate::{
+    batcher::BatchInput,
+    bucket::BucketPolicy,
+    engine::TRTEngine,
+    error::TRTResult,
+    tensor::Shape,
+};
+use tensorrt_rs_sys::runtime::OptProfileSelector;
+
+// Variable-length sequence inputs for a DynamicBatcher, e.g. the token ids of a text
+// encoder. Requests submit [rows, length, ...] inputs at their own length; the batcher
+// groups requests whose lengths fall into the same bucket, pads them to the bucket length
+// on the device, generates the attention mask and cuts sequence outputs back to each
+// request's length.
+#[derive(Debug, Clone, PartialEq)]
+pub struct SequencePacking {
+    // Inputs whose dim 1 is the sequence length; zero-padded. Every request gives all of
+    // them the same length.
+    pub inputs: Vec<String>,
+    // Engine input of shape [rows, length] that the batcher fills with 1 over the tokens and
+    // 0 over the padding; requests do not submit it.
+    pub attention_mask: Option<String>,
+    // Outputs of shape [rows, length, ...], returned at the request's length.
+    pub sequence_outputs: Vec<String>,
+    // Padded lengths, applied to the shape [1, length]: e.g. BucketPolicy::round_up(&[1], 32),
+    // or profile_buckets for the opt and max lengths of the engine's profiles.
+    pub buckets: BucketPolicy,
+}
+
+impl SequencePacking {
+    pub fn new(inputs: &[&str], attention_mask: Option<&str>, buckets: BucketPolicy) -> Self {
+        Self {
+            inputs: inputs.iter().map(|name| name.to_string()).collect(),
+            attention_mask: attention_mask.map(|name| name.to_string()),
+            sequence_outputs: Vec::new(),
+            buckets,
+        }
+    }
+
+    // Buckets at the opt and max length (dim 1) of `input` in every optimization profile.
+    pub fn profile_buckets(engine: &TRTEngine, input: &str) -> TRTResult<BucketPolicy> {
+        let mut lengths = Vec::new();
+        for profile in 0..engine.get_num_optimization_profiles()? {
+            for select in [OptProfileSelector::OPT, OptProfileSelector::MAX] {
+                let shape = engine.get_profile_shape(input, profile, select)?;
+                if let Some(&length) = shape.get(1) {
+                    lengths.push(length);
+                }
+            }
+        }
+        lengths.sort_unstable();
+        lengths.dedup();
+        Ok(BucketPolicy::Shapes(lengths.into_iter().map(|length| Shape::new(&[1, length])).collect()))
+    }
+
+    pub(crate) fn is_packed(&self, name: &str) -> bool {
+        self.inputs.iter().any(|input| input == name)
+    }
+
+    pub(crate) fn is_sequence_output(&self, name: &str) -> bool {
+        self.sequence_outputs.iter().any(|output| output == name)
+    }
+
+    // The padded length of `length` tokens; the length itself when no bucket holds it.
+    pub(crate) fn bucket_length(&self, length: i32) -> i32 {
+        match self.buckets.bucket(&Shape::new(&[1, length])) {
+            Some(bucket) => bucket[1].max(length),
+            None => length,
+        }
+    }
+
+    // Sequence length of a request, from its first packed input.
+    pub(crate) fn length(&self, inputs: &[BatchInput]) -> Option<i32> {
+        inputs
+            .iter()
+            .find(|input| self.is_packed(&input.name))
+            .and_then(|input| input.shape.get(1).copied())
+    }
+
+    // The shape `input` is batched at: packed inputs at their bucket length.
+    pub(crate) fn batch_shape(&self, input: &BatchInput) -> Shape {
+        if !self.is_packed(&input.name) || input.shape.nb_dims() < 2 {
+            return input.shape;
+        }
+        let mut dims = input.shape.to_vec();
+        dims[1] = self.bucket_length(dims[1]);
+        Shape::new(&dims)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn input(name: &str, dims: &[i32]) -> BatchInput {
+        BatchInput::host(name, Shape::new(dims), Vec::new())
+    }
+
+    #[test]
+    fn packed_inputs_are_bucketed() {
+        let packing = SequencePacking::new(&["input_ids"], Some("attention_mask"), BucketPolicy::round_up(&[1], 32));
+        assert_eq!(packing.batch_shape(&input("input_ids", &[2, 40])), Shape::new(&[2, 64]));
+        assert_eq!(packing.batch_shape(&input("pixels", &[2, 40])), Shape::new(&[2, 40]));
+        assert_eq!(packing.length(&[input("pixels", &[2, 7]), input("input_ids", &[2, 40])]), Some(40));
+    }
+
+    #[test]
+    fn lengths_beyond_the_buckets_are_kept() {
+        let buckets = BucketPolicy::Shapes(vec![Shape::new(&[1, 64]), Shape::new(&[1, 128])]);
+        let packing = SequencePacking::new(&["input_ids"], None, buckets);
+        assert_eq!(packing.bucket_length(10), 64);
+        assert_eq!(packing.bucket_length(64), 64);
+        assert_eq!(packing.bucket_length(100), 128);
+        assert_eq!(packing.bucket_length(300), 300);
+    }
+}
@@ -0,0 +1,337 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    staging::{event, StagingRing},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::VecDeque,
+    sync::{Arc, Mutex},
+};
+use tensorrt_rs_sys::{runtime::DataType, stream::CudaEvent};
+
+// Session state, e.g. a KV cache, in fixed-size blocks of one device pool rather than one
+// buffer per session sized for the longest sequence, for engines that address their state
+// through block tables (a paged attention plugin taking the pool and each sequence's block
+// indices as inputs). A session holds only the blocks its length needs, and since every
+// block is the same size any freed block fits any session, so the pool never fragments.
+pub struct PagedStatePool {
+    // [num_blocks, block_shape..]
+    pool: Tensor,
+    rows_per_block: usize,
+    block_bytes: usize,
+    blocks: Arc<BlockAllocator>,
+}
+
+impl PagedStatePool {
+    // `block_shape` is the layout of one block, holding `rows_per_block` positions of a
+    // sequence, e.g. [2, heads, 64, head_dim] for the keys and values of 64 tokens.
+    pub fn new(
+        block_shape: &Shape,
+        rows_per_block: usize,
+        num_blocks: usize,
+        dtype: DataType,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        if rows_per_block == 0 || num_blocks == 0 || num_blocks > u32::MAX as usize {
+            return Err(TRTError::ShapeError(block_shape.to_vec()));
+        }
+        let mut dims = vec![num_blocks as i32];
+        dims.extend_from_slice(block_shape.as_slice());
+        let pool = Tensor::empty(&Shape::new(&dims), dtype, stream)?;
+        let block_bytes = block_shape.size() * dtype.get_elem_size();
+        Ok(Self { pool, rows_per_block, block_bytes, blocks: Arc::new(BlockAllocator::new(num_blocks)) })
+    }
+
+    // As many blocks as fit in `bytes` of device memory.
+    pub fn with_budget(
+        block_shape: &Shape,
+        rows_per_block: usize,
+        bytes: usize,
+        dtype: DataType,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        let block_bytes = (block_shape.size() * dtype.get_elem_size()).max(1);
+        Self::new(block_shape, rows_per_block, bytes / block_bytes, dtype, stream)
+    }
+
+    // An empty table for a new session whose steps run on `stream` (see BlockTable).
+    pub fn open(&self, stream: &CuStream) -> BlockTable {
+        BlockTable {
+            blocks: Vec::new(),
+            rows: 0,
+            rows_per_block: self.rows_per_block,
+            allocator: self.blocks.clone(),
+            stream: Some(stream.clone()),
+        }
+    }
+
+    // Grows `table` to hold `rows` positions. Either all of the blocks needed are taken or,
+    // with StateBlocksExhausted, none are, so a caller may evict or defer the session.
+    pub fn reserve(&self, table: &mut BlockTable, rows: usize) -> TRTResult<()> {
+        if !Arc::ptr_eq(&table.allocator, &self.blocks) {
+            return Err(TRTError::InvalidAddress);
+        }
+        table.grow(rows)
+    }
+
+    // The whole pool, bound as the engine's state input.
+    pub fn tensor(&self) -> &Tensor {
+        &self.pool
+    }
+
+    // Device address of `block`.
+    pub fn block_ptr(&self, block: u32) -> Option<usize> {
+        match (block as usize) < self.blocks.num_blocks {
+            true => Some(unsafe { self.pool.get_raw_ptr() } + block as usize * self.block_bytes),
+            false => None,
+        }
+    }
+
+    // Uploads the tables of a batch of sessions into `dst`, an INT32 [batch, max_blocks]
+    // block table input, row k for tables[k]. Entries past a session's blocks are 0; kernels
+    // mask them by the session's length.
+    pub fn write_block_tables(
+        &self,
+        tables: &[&BlockTable],
+        dst: &Tensor,
+        staging: &mut StagingRing,
+        stream: &CuStream,
+    ) -> TRTResult<()> {
+        let shape = dst.shape();
+        if dst.dtype() != DataType::INT32 || shape.nb_dims() != 2 || shape[0] as usize != tables.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let blocks: Vec<&[u32]> = tables.iter().map(|table| table.blocks()).collect();
+        let rows = match table_rows(&blocks, shape[1] as usize) {
+            Some(rows) => rows,
+            None => return Err(TRTError::ShapeMismatch),
+        };
+        let data: Vec<u8> = rows.iter().flat_map(|block| block.to_ne_bytes()).collect();
+        staging.upload(&data, dst, stream)
+    }
+
+    pub fn rows_per_block(&self) -> usize {
+        self.rows_per_block
+    }
+
+    pub fn block_bytes(&self) -> usize {
+        self.block_bytes
+    }
+
+    pub fn num_blocks(&self) -> usize {
+        self.blocks.num_blocks
+    }
+
+    pub fn num_free(&self) -> usize {
+        self.blocks.num_free()
+    }
+}
+
+// The block indices of one session in order: block k holds its positions from
+// k * rows_per_block on. Dropping the table returns its blocks to the pool. Blocks are
+// returned in the order of the table's stream: another session gets them only once the
+// work queued on that stream by then, which may still read or write them, has completed.
+pub struct BlockTable {
+    blocks: Vec<u32>,
+    rows: usize,
+    rows_per_block: usize,
+    allocator: Arc<BlockAllocator>,
+    // None for tables no device work uses
+    stream: Option<CuStream>,
+}
+
+impl BlockTable {
+    pub fn blocks(&self) -> &[u32] {
+        &self.blocks
+    }
+
+    // Positions reserved so far.
+    pub fn rows(&self) -> usize {
+        self.rows
+    }
+
+    // The stream the session's steps run on from now on. Work still queued on the previous
+    // one must be complete, or ordered before that of `stream`.
+    pub fn set_stream(&mut self, stream: &CuStream) {
+        self.stream = Some(stream.clone());
+    }
+
+    // Keeps the blocks holding the first `rows` positions, e.g. after a rejected draft, and
+    // returns the others to the pool.
+    pub fn truncate(&mut self, rows: usize) {
+        let keep = rows.div_ceil(self.rows_per_block);
+        if keep < self.blocks.len() {
+            self.allocator.give(self.blocks.drain(keep..).collect(), self.stream.as_ref());
+        }
+        self.rows = self.rows.min(rows);
+    }
+
+    // Returns every block, for the table to start another sequence.
+    pub fn clear(&mut self) {
+        if !self.blocks.is_empty() {
+            self.allocator.give(std::mem::take(&mut self.blocks), self.stream.as_ref());
+        }
+        self.rows = 0;
+    }
+
+    fn grow(&mut self, rows: usize) -> TRTResult<()> {
+        let needed = rows.div_ceil(self.rows_per_block).saturating_sub(self.blocks.len());
+        if needed > 0 {
+            match self.allocator.take(needed) {
+                Some(blocks) => self.blocks.extend(blocks),
+                None => return Err(TRTError::StateBlocksExhausted(needed, self.allocator.num_free())),
+            }
+        }
+        self.rows = self.rows.max(rows);
+        Ok(())
+    }
+}
+
+impl Drop for BlockTable {
+    fn drop(&mut self) {
+        self.clear();
+    }
+}
+
+// Free blocks, the most recently freed on top, so reuse favours blocks still in L2.
+struct BlockAllocator {
+    free: Mutex<FreeBlocks>,
+    num_blocks: usize,
+}
+
+#[derive(Default)]
+struct FreeBlocks {
+    ready: Vec<u32>,
+    // freed behind an event recorded on the stream of their table, oldest first
+    pending: VecDeque<(CudaEvent, Vec<u32>)>,
+    pending_blocks: usize,
+    // of pending entries reclaimed, for reuse
+    events: Vec<CudaEvent>,
+}
+
+impl FreeBlocks {
+    // Moves the pending blocks whose work has completed to `ready`, and waits for more until
+    // at least `count` are ready, as far as the pending ones allow.
+    fn reclaim(&mut self, count: usize) {
+        while let Some((event, _)) = self.pending.front() {
+            if !event.is_complete() && (self.ready.len() >= count || !event.synchronize()) {
+                break;
+            }
+            let (event, blocks) = self.pending.pop_front().unwrap();
+            self.pending_blocks -= blocks.len();
+            self.ready.extend(blocks);
+            self.events.push(event);
+        }
+    }
+}
+
+impl BlockAllocator {
+    fn new(num_blocks: usize) -> Self {
+        let ready = (0..num_blocks as u32).rev().collect();
+        Self { free: Mutex::new(FreeBlocks { ready, ..FreeBlocks::default() }), num_blocks }
+    }
+
+    // `count` blocks, or none if fewer are free.
+    fn take(&self, count: usize) -> Option<Vec<u32>> {
+        let mut free = self.free.lock().unwrap();
+        free.reclaim(count);
+        let rest = free.ready.len().checked_sub(count)?;
+        let mut blocks = free.ready.split_off(rest);
+        blocks.reverse();
+        Some(blocks)
+    }
+
+    // Blocks that work queued on `stream` may still use; None if no work uses them.
+    fn give(&self, blocks: Vec<u32>, stream: Option<&CuStream>) {
+        let mut free = self.free.lock().unwrap();
+        let stream = match stream {
+            Some(stream) => stream,
+            None => {
+                free.ready.extend(blocks);
+                return;
+            }
+        };
+        let released = match free.events.pop() {
+            Some(event) => Ok(event),
+            None => event(),
+        };
+        match released {
+            Ok(event) if event.record(stream) => {
+                free.pending_blocks += blocks.len();
+                free.pending.push_back((event, blocks));
+            }
+            _ => {
+                // cannot be ordered on the device: reused only once the stream is idle
+                stream.synchronize().ok();
+                free.ready.extend(blocks);
+            }
+        }
+    }
+
+    // Including blocks freed behind work still in flight.
+    fn num_free(&self) -> usize {
+        let free = self.free.lock().unwrap();
+        free.ready.len() + free.pending_blocks
+    }
+}
+
+// Row-major [tables, width] block indices, zero-padded; None if a table is wider.
+fn table_rows(tables: &[&[u32]], width: usize) -> Option<Vec<i32>> {
+    if tables.iter().any(|blocks| blocks.len() > width) {
+        return None;
+    }
+    let mut rows = vec![0i32; tables.len() * width];
+    for (row, blocks) in rows.chunks_mut(width.max(1)).zip(tables) {
+        for (entry, &block) in row.iter_mut().zip(blocks.iter()) {
+            *entry = block as i32;
+        }
+    }
+    Some(rows)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn table(allocator: &Arc<BlockAllocator>) -> BlockTable {
+        BlockTable { blocks: Vec::new(), rows: 0, rows_per_block: 64, allocator: allocator.clone(), stream: None }
+    }
+
+    #[test]
+    fn tables_take_whole_blocks_or_none() {
+        let allocator = Arc::new(BlockAllocator::new(4));
+        let mut first = table(&allocator);
+        first.grow(100).unwrap();
+        assert_eq!(first.blocks(), &[0, 1]);
+        first.grow(128).unwrap();
+        assert_eq!(first.blocks().len(), 2);
+
+        let mut second = table(&allocator);
+        assert!(matches!(second.grow(3 * 64), Err(TRTError::StateBlocksExhausted(3, 2))));
+        assert!(second.blocks().is_empty());
+        assert_eq!(allocator.num_free(), 2);
+    }
+
+    #[test]
+    fn freed_blocks_are_reused_first() {
+        let allocator = Arc::new(BlockAllocator::new(4));
+        let mut first = table(&allocator);
+        first.grow(3 * 64).unwrap();
+        first.truncate(64);
+        assert_eq!(first.blocks(), &[0]);
+
+        let mut second = table(&allocator);
+        second.grow(64).unwrap();
+        assert_eq!(second.blocks(), &[2]);
+        drop(first);
+        drop(second);
+        assert_eq!(allocator.num_free(), 4);
+    }
+
+    #[test]
+    fn tables_are_zero_padded() {
+        assert_eq!(table_rows(&[&[3, 1], &[2]], 3), Some(vec![3, 1, 0, 2, 0, 0]));
+        assert_eq!(table_rows(&[&[3, 1]], 1), None);
+    }
+}
@@ -0,0 +1,359 @@
+use crate::{
+    batcher::{BatchInput, BatchOutput},
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    nvtx::{self, Category},
+    spans::{SpanTracer, SpanValue, Stage, TraceContext},
+    staging::{event, pinned},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::{HashMap, VecDeque},
+    sync::Arc,
+    time::Instant,
+};
+use tensorrt_rs_sys::{
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    stream::CudaEvent,
+};
+
+pub(crate) struct StagedTensor {
+    pub(crate) host: PinnedMemory,
+    pub(crate) device: Tensor,
+}
+
+impl StagedTensor {
+    pub(crate) fn new(like: &Tensor, stream: &CuStream) -> TRTResult<Self> {
+        let capacity = like.capacity();
+        let host = pinned(capacity * like.dtype().get_elem_size())?;
+        let device = Tensor::empty(&Shape::new(&[capacity as i32]), like.dtype(), stream)?;
+        Ok(Self { host, device })
+    }
+}
+
+struct InputSlot {
+    inputs: HashMap<String, StagedTensor>,
+    // the pinned buffers may be rewritten once this completes
+    uploaded: CudaEvent,
+    // the device buffers may be rewritten once this completes (TensorRT consumed them)
+    released: CudaEvent,
+}
+
+struct PipelineSlot {
+    outputs: HashMap<String, StagedTensor>,
+    output_shapes: Vec<(String, Shape)>,
+    computed: CudaEvent,
+    downloaded: CudaEvent,
+    busy: bool,
+}
+
+// Double/triple-buffered execution for PCIe-bound workloads. Every slot owns pinned host and
+// device buffers for all IO tensors; uploads run on a dedicated H2D stream, enqueueV3 on the
+// engine's stream and downloads on a dedicated D2H stream, chained with events. While batch N
+// computes, batch N+1 is being uploaded and batch N-1 downloaded.
+//
+// Input buffers are handed back through the engine's input-consumed event rather than after
+// the whole batch, so two input buffer sets are enough however deep the output side is.
+//
+// Engines with data-dependent output shapes are not supported, since their output buffers
+// are owned by the output allocator.
+pub struct InferencePipeline {
+    h2d: CuStream,
+    d2h: CuStream,
+    // forwards the engine's input-consumed signal into per-slot events
+    release: CuStream,
+    input_slots: Vec<InputSlot>,
+    next_input: usize,
+    slots: Vec<PipelineSlot>,
+    next: usize,
+    spans: Option<Arc<SpanTracer>>,
+    // batches submitted so far, the id of the next one
+    submitted: u64,
+    // outputs of completed batches not yet returned, oldest first; more than one only after
+    // a submit failed once it had completed the batch of the slot it reused
+    completed: VecDeque<Vec<BatchOutput>>,
+}
+
+impl InferencePipeline {
+    pub fn new(engine: &mut TRTEngine, depth: usize) -> TRTResult<Self> {
+        Self::with_input_buffers(engine, depth, 2)
+    }
+
+    // `engine` must already have its IO tensors allocated; slot buffers are sized to match.
+    // `depth` output buffer sets and `num_input_buffers` input buffer sets are allocated.
+    pub fn with_input_buffers(
+        engine: &mut TRTEngine,
+        depth: usize,
+        num_input_buffers: usize,
+    ) -> TRTResult<Self> {
+        engine.enable_input_consumed_event()?;
+
+        let h2d = CuStream::new()?;
+        let d2h = CuStream::new()?;
+        let release = CuStream::new()?;
+
+        let mut input_slots = Vec::with_capacity(num_input_buffers.max(1));
+        for _ in 0..num_input_buffers.max(1) {
+            let mut inputs = HashMap::new();
+            for name in engine.input_names() {
+                let tensor = match engine.get_tensor(name) {
+                    Some(tensor) => tensor,
+                    None => return Err(TRTError::TensorNotFound(name.clone())),
+                };
+                inputs.insert(name.clone(), StagedTensor::new(tensor, &h2d)?);
+            }
+            input_slots.push(InputSlot { inputs, uploaded: event()?, released: event()? });
+        }
+
+        let mut slots = Vec::with_capacity(depth.max(2));
+        for _ in 0..depth.max(2) {
+            let mut outputs = HashMap::new();
+            for name in engine.output_names() {
+                let tensor = match engine.get_tensor(name) {
+                    Some(tensor) => tensor,
+                    None => return Err(TRTError::TensorNotFound(name.clone())),
+                };
+                outputs.insert(name.clone(), StagedTensor::new(tensor, &d2h)?);
+            }
+            slots.push(PipelineSlot {
+                outputs,
+                output_shapes: Vec::new(),
+                computed: event()?,
+                downloaded: event()?,
+                busy: false,
+            });
+        }
+        h2d.synchronize()?;
+        d2h.synchronize()?;
+
+        Ok(Self {
+            h2d,
+            d2h,
+            release,
+            input_slots,
+            next_input: 0,
+            slots,
+            next: 0,
+            spans: None,
+            submitted: 0,
+            completed: VecDeque::new(),
+        })
+    }
+
+    pub fn depth(&self) -> usize {
+        self.slots.len()
+    }
+
+    pub fn num_in_flight(&self) -> usize {
+        self.slots.iter().filter(|slot| slot.busy).count()
+    }
+
+    // Traces the batches `spans` samples as a "trt.pipeline" span of the submit, with the
+    // batch id and input shapes, a "trt.queue_wait" child for the input slot and the device
+    // times of the batch's "trt.upload", "trt.gpu" and "trt.download" on their streams.
+    pub fn set_span_tracer(&mut self, spans: Option<Arc<SpanTracer>>) {
+        self.spans = spans;
+    }
+
+    // Queues one batch. Once the pipeline is full this returns the outputs of the oldest batch,
+    // whose slot is being reused; otherwise None. A submit that fails after completing that
+    // batch keeps its outputs for the next submit or flush.
+    pub fn submit(
+        &mut self,
+        engine: &mut TRTEngine,
+        inputs: &[BatchInput],
+    ) -> TRTResult<Option<Vec<BatchOutput>>> {
+        self.submit_with_context(engine, inputs, None)
+    }
+
+    // Like submit, with the batch traced within `parent` when that trace is sampled.
+    pub fn submit_with_context(
+        &mut self,
+        engine: &mut TRTEngine,
+        inputs: &[BatchInput],
+        parent: Option<&TraceContext>,
+    ) -> TRTResult<Option<Vec<BatchOutput>>> {
+        // marks 0 and 1 on the H2D stream, 2 and 3 on the engine's, 4 and 5 on the D2H stream
+        const STAGES: &[Stage] = &[("trt.upload", 0, 1), ("trt.gpu", 2, 3), ("trt.download", 4, 5)];
+        let _range = nvtx::range!(Category::Pipeline, "pipeline submit");
+        let batch_id = self.submitted;
+        self.submitted += 1;
+        let spans = self.spans.clone();
+        let mut span = spans.as_ref().and_then(|spans| spans.start(parent));
+        let index = self.next;
+        if self.slots[index].busy {
+            let outputs = self.complete(index)?;
+            self.completed.push_back(outputs);
+        }
+
+        let compute = engine.get_stream().clone();
+        let input_slot = &mut self.input_slots[self.next_input];
+        self.next_input = (self.next_input + 1) % self.input_slots.len();
+
+        // host side: the previous upload out of the pinned buffers has to be done; device side:
+        // the previous batch using these device buffers has to be consumed by TensorRT
+        let wait = nvtx::range!(Category::Wait, "wait for input slot");
+        let waited = Instant::now();
+        if !input_slot.uploaded.synchronize() || !input_slot.released.wait(&self.h2d) {
+            return Err(TRTError::EventError);
+        }
+        drop(wait);
+        if let (Some(spans), Some(span)) = (spans.as_ref(), span.as_ref()) {
+            spans.finish(spans.child(&span.context, waited), "trt.queue_wait", Instant::now());
+        }
+        let upload = nvtx::range!(Category::Copy, "upload inputs");
+        // created only now: its host anchor has to be taken next to the first mark, after the
+        // waits above
+        let mut timeline = spans.as_ref().filter(|_| span.is_some()).and_then(|spans| spans.timeline(6));
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(0, &self.h2d);
+        }
+        for input in inputs {
+            let staged = match input_slot.inputs.get_mut(&input.name) {
+                Some(staged) => staged,
+                None => return Err(TRTError::TensorNotFound(input.name.clone())),
+            };
+            let size = input.shape.size() * staged.device.dtype().get_elem_size();
+            if input.data.len() != size || size > staged.host.len() {
+                return Err(TRTError::ShapeMismatch);
+            }
+            if let Some(span) = span.as_mut() {
+                span.set(format!("trt.input.{}", input.name), SpanValue::Shape(input.shape));
+            }
+            unsafe {
+                staged.device.reset_shape(&input.shape)?;
+                staged.host.as_mut_slice()[..size].copy_from_slice(&input.data);
+                if !memcpy_async(
+                    staged.device.get_raw_ptr(),
+                    staged.host.get_raw(),
+                    size,
+                    MemcpyKind::HostToDevice,
+                    &self.h2d,
+                ) {
+                    return Err(TRTError::MemcpyError);
+                }
+            }
+        }
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(1, &self.h2d);
+        }
+        if !input_slot.uploaded.record(&self.h2d) || !input_slot.uploaded.wait(&compute) {
+            return Err(TRTError::EventError);
+        }
+        drop(upload);
+
+        let slot = &mut self.slots[index];
+        let feed_dict: HashMap<&str, &Tensor> = input_slot
+            .inputs
+            .iter()
+            .map(|(name, staged)| (name.as_str(), &staged.device))
+            .collect();
+        let output_dict: HashMap<&str, &Tensor> = slot
+            .outputs
+            .iter()
+            .map(|(name, staged)| (name.as_str(), &staged.device))
+            .collect();
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(2, &compute);
+        }
+        engine.inference_into(&feed_dict, &output_dict, Some(&compute))?;
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(3, &compute);
+        }
+
+        // the engine re-records its input-consumed event on the next enqueue, so hand this
+        // occurrence over to the slot now
+        let consumed = match engine.input_consumed_event() {
+            Some(consumed) => consumed,
+            None => return Err(TRTError::EventError),
+        };
+        if !consumed.wait(&self.release) || !input_slot.released.record(&self.release) {
+            return Err(TRTError::EventError);
+        }
+
+        if !slot.computed.record(&compute) || !slot.computed.wait(&self.d2h) {
+            return Err(TRTError::EventError);
+        }
+
+        let _download = nvtx::range!(Category::Pipeline, "download outputs");
+        if let Some(timeline) = timeline.as_mut() {
+            timeline.record(4, &self.d2h);
+        }
+        slot.output_shapes.clear();
+        for (name, staged) in slot.outputs.iter() {
+            let shape = engine.get_tensor_shape(name)?;
+            let size = shape.size() * staged.device.dtype().get_elem_size();
+            let copied = unsafe {
+                memcpy_async(
+                    staged.host.get_raw(),
+                    staged.device.get_raw_ptr(),
+                    size,
+                    MemcpyKind::DeviceToHost,
+                    &self.d2h,
+                )
+            };
+            if !copied {
+                return Err(TRTError::MemcpyError);
+            }
+            slot.output_shapes.push((name.clone(), shape));
+        }
+        if !slot.downloaded.record(&self.d2h) {
+            return Err(TRTError::EventError);
+        }
+        if let (Some(spans), Some(mut span)) = (spans.as_ref(), span.take()) {
+            if let Some(mut timeline) = timeline.take() {
+                timeline.record(5, &self.d2h);
+                spans.finish_timeline(timeline, &span.context, STAGES);
+            }
+            span.set("trt.batch.id", SpanValue::Int(batch_id as i64));
+            spans.finish(span, "trt.pipeline", Instant::now());
+        }
+
+        slot.busy = true;
+        self.next = (index + 1) % self.slots.len();
+        Ok(self.completed.pop_front())
+    }
+
+    // Waits for every batch still in flight and returns their outputs in submission order.
+    pub fn flush(&mut self) -> TRTResult<Vec<Vec<BatchOutput>>> {
+        let mut completed: Vec<_> = self.completed.drain(..).collect();
+        for i in 0..self.slots.len() {
+            let index = (self.next + i) % self.slots.len();
+            if self.slots[index].busy {
+                completed.push(self.complete(index)?);
+            }
+        }
+        Ok(completed)
+    }
+
+    fn complete(&mut self, index: usize) -> TRTResult<Vec<BatchOutput>> {
+        let slot = &mut self.slots[index];
+        let wait = nvtx::range!(Category::Wait, "wait for outputs");
+        if !slot.downloaded.synchronize() {
+            return Err(TRTError::EventError);
+        }
+        drop(wait);
+        slot.busy = false;
+
+        let mut outputs = Vec::with_capacity(slot.output_shapes.len());
+        for (name, shape) in slot.output_shapes.iter() {
+            let staged = &slot.outputs[name];
+            let size = shape.size() * staged.device.dtype().get_elem_size();
+            let data = unsafe { staged.host.as_slice()[..size].to_vec() };
+            outputs.push(BatchOutput { name: name.clone(), shape: *shape, data });
+        }
+        Ok(outputs)
+    }
+}
+
+impl Drop for InferencePipeline {
+    fn drop(&mut self) {
+        // pinned and device buffers must outlive the copies still queued on them
+        self.h2d.synchronize().ok();
+        self.release.synchronize().ok();
+        for slot in self.slots.iter() {
+            slot.downloaded.synchronize();
+        }
+    }
+}
@@ -0,0 +1,88 @@
+use crate::error::TRTResult;
+use memmap2::{Advice, Mmap, MmapOptions};
+use std::{
+    fs::File,
+    path::{Path, PathBuf},
+};
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct PlanLoadOptions {
+    // Pre-fault the whole mapping (MAP_POPULATE) so deserialization never page-faults.
+    pub populate: bool,
+    // madvise(MADV_SEQUENTIAL): TensorRT reads the plan front to back.
+    pub sequential: bool,
+    // madvise(MADV_WILLNEED): start readahead right after mapping.
+    pub will_need: bool,
+}
+
+impl Default for PlanLoadOptions {
+    fn default() -> Self {
+        Self {
+            populate: false,
+            sequential: true,
+            will_need: true,
+        }
+    }
+}
+
+// How plans built to run on other GPUs or TensorRT versions than the builder's are loaded
+// (BuildOptions::hardware_compatibility and version_compatible), e.g. to ship one plan to
+// every node type of a fleet.
+#[derive(Debug, Clone, PartialEq, Default)]
+pub struct PlanCompatibility {
+    // A version-compatible plan carries the lean runtime it runs on, host code that TensorRT
+    // only loads when allowed: enable for plans from a trusted source.
+    pub allow_host_code: bool,
+    // The libnvinfer_lean of the TensorRT version that built plans with exclude_lean_runtime,
+    // which they are deserialized with instead of the linked TensorRT.
+    pub lean_runtime: Option<PathBuf>,
+    // Where an embedded lean runtime is written to be loaded, when it cannot be loaded from an
+    // in-memory file; None keeps TensorRT's default.
+    pub temporary_directory: Option<PathBuf>,
+}
+
+// A read-only, memory-mapped engine plan.
+// The mapped bytes are handed straight to deserializeCudaEngine, so the plan is never
+// copied into anonymous heap memory before TensorRT reads it.
+pub struct PlanFile {
+    mmap: Mmap,
+}
+
+impl PlanFile {
+    pub fn open<P: AsRef<Path>>(path: &P, options: &PlanLoadOptions) -> TRTResult<Self> {
+        let file = File::open(path)?;
+
+        let mut mmap_options = MmapOptions::new();
+        if options.populate {
+            mmap_options.populate();
+        }
+        let mmap = unsafe { mmap_options.map(&file)? };
+
+        if options.sequential {
+            mmap.advise(Advice::Sequential)?;
+        }
+        if options.will_need {
+            mmap.advise(Advice::WillNeed)?;
+        }
+
+        Ok(Self { mmap })
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.mmap
+    }
+
+    pub fn len(&self) -> usize {
+        self.mmap.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.mmap.is_empty()
+    }
+
+    // Hint that the plan pages are no longer needed, e.g. once the engine is deserialized.
+    pub fn release(&self) -> TRTResult<()> {
+        unsafe { self.mmap.unchecked_advise(memmap2::UncheckedAdvice::DontNeed)? };
+        Ok(())
+    }
+}
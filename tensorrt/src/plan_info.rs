@@ -0,0 +1,349 @@
+use crate::{
+    engine::TRTEngine,
+    error::TRTResult,
+    layout::TensorLayout,
+    profile::ProfileShape,
+    schema::{IoSchema, TensorSchema},
+    tensor::Shape,
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    fs,
+    io::{self, ErrorKind, Read},
+    path::{Path, PathBuf},
+    time::UNIX_EPOCH,
+};
+use tensorrt_rs_sys::runtime::{
+    DataType, HardwareCompatibilityLevel, ProfilingVerbosity, TensorFormat, TensorIOMode, TensorLocation, MAX_DIMS,
+};
+
+const MAGIC: &[u8; 8] = b"TRTINFO\0";
+const VERSION: u32 = 2;
+
+// What scheduling needs to know about a plan without deserializing it: its IO schema, the
+// memory it takes once loaded and how it was built. Extracted once from a loaded engine and
+// kept in a sidecar file next to the plan (see save and load), stamped with the plan's size
+// and modification time so a rebuilt plan is never described by its predecessor's info.
+#[derive(Debug, Clone, PartialEq)]
+pub struct PlanInfo {
+    pub schema: IoSchema,
+    // context memory of one execution context
+    pub device_memory_size: usize,
+    // the weights resident on the device, as accounted when the plan was loaded
+    pub weights_size: usize,
+    pub streamable_weights_size: usize,
+    pub num_layers: i32,
+    pub num_aux_streams: i32,
+    pub refittable: bool,
+    pub hardware_compatibility: HardwareCompatibilityLevel,
+    pub profiling_verbosity: ProfilingVerbosity,
+    plan_size: u64,
+    plan_modified: u64,
+}
+
+impl PlanInfo {
+    pub fn from_engine(engine: &TRTEngine) -> TRTResult<Self> {
+        let core = engine.core()?;
+        let cuda_engine = core.engine();
+        Ok(Self {
+            schema: engine.io_schema()?.clone(),
+            device_memory_size: cuda_engine.get_device_memory_size(),
+            weights_size: core.weights(),
+            streamable_weights_size: cuda_engine.get_streamable_weights_size(),
+            num_layers: cuda_engine.get_num_layers(),
+            num_aux_streams: cuda_engine.get_num_aux_streams(),
+            refittable: cuda_engine.is_refittable(),
+            hardware_compatibility: cuda_engine.get_hardware_compatibility_level(),
+            profiling_verbosity: cuda_engine.get_profiling_verbosity(),
+            plan_size: 0,
+            plan_modified: 0,
+        })
+    }
+
+    // Device memory of the engine with one context, without its IO tensors.
+    pub fn footprint(&self) -> usize {
+        self.weights_size + self.device_memory_size
+    }
+
+    // `model.plan` is described by `model.plan.info`.
+    pub fn sidecar_path(plan: &Path) -> PathBuf {
+        let mut name = plan.as_os_str().to_os_string();
+        name.push(".info");
+        PathBuf::from(name)
+    }
+
+    // The info saved next to `plan`; None when there is none, or it is stale or unreadable.
+    pub fn load<P: AsRef<Path>>(plan: &P) -> Option<Self> {
+        let stamp = plan_stamp(plan.as_ref()).ok()?;
+        let data = fs::read(Self::sidecar_path(plan.as_ref())).ok()?;
+        let info = decode(&mut data.as_slice()).ok()?;
+        match (info.plan_size, info.plan_modified) == stamp {
+            true => Some(info),
+            false => None,
+        }
+    }
+
+    // Writes the sidecar of `plan`, replacing it atomically.
+    pub fn save<P: AsRef<Path>>(&self, plan: &P) -> TRTResult<()> {
+        let (plan_size, plan_modified) = plan_stamp(plan.as_ref())?;
+        let info = Self { plan_size, plan_modified, ..self.clone() };
+        let path = Self::sidecar_path(plan.as_ref());
+        let mut temp = path.clone().into_os_string();
+        temp.push(format!(".{}.tmp", std::process::id()));
+        let mut out = Vec::new();
+        encode(&info, &mut out);
+        fs::write(&temp, &out)?;
+        fs::rename(&temp, &path)?;
+        Ok(())
+    }
+
+    // The saved info of `plan`, or, failing that, the info of the plan deserialized once
+    // on the current device, saved for the next caller when the directory is writable.
+    pub fn extract<P: AsRef<Path>>(plan: &P, stream: &CuStream) -> TRTResult<Self> {
+        if let Some(info) = Self::load(plan) {
+            return Ok(info);
+        }
+        let info = Self::from_engine(&TRTEngine::new(plan, stream)?)?;
+        info.save(plan).ok();
+        Ok(info)
+    }
+}
+
+fn plan_stamp(plan: &Path) -> io::Result<(u64, u64)> {
+    let metadata = fs::metadata(plan)?;
+    let modified = metadata.modified()?.duration_since(UNIX_EPOCH).map_or(0, |since| since.as_nanos() as u64);
+    Ok((metadata.len(), modified))
+}
+
+fn put_u32(out: &mut Vec<u8>, value: usize) {
+    out.extend_from_slice(&(value.min(u32::MAX as usize) as u32).to_le_bytes());
+}
+
+fn put_u64(out: &mut Vec<u8>, value: u64) {
+    out.extend_from_slice(&value.to_le_bytes());
+}
+
+fn put_i32(out: &mut Vec<u8>, value: i32) {
+    out.extend_from_slice(&value.to_le_bytes());
+}
+
+fn put_shape(out: &mut Vec<u8>, shape: &Shape) {
+    out.push(shape.nb_dims() as u8);
+    shape.as_slice().iter().for_each(|&dim| put_i32(out, dim));
+}
+
+// Little-endian throughout.
+fn encode(info: &PlanInfo, out: &mut Vec<u8>) {
+    out.extend_from_slice(MAGIC);
+    put_u32(out, VERSION as usize);
+    put_u64(out, info.plan_size);
+    put_u64(out, info.plan_modified);
+    put_u64(out, info.device_memory_size as u64);
+    put_u64(out, info.weights_size as u64);
+    put_u64(out, info.streamable_weights_size as u64);
+    put_i32(out, info.num_layers);
+    put_i32(out, info.num_aux_streams);
+    out.push(info.refittable as u8);
+    out.push(info.hardware_compatibility as u8);
+    out.push(info.profiling_verbosity as u8);
+
+    put_i32(out, info.schema.num_profiles());
+    put_u32(out, info.schema.len());
+    for tensor in info.schema.tensors() {
+        put_u32(out, tensor.name.len());
+        out.extend_from_slice(tensor.name.as_bytes());
+        put_u32(out, tensor.index);
+        out.push(tensor.io_mode as u8);
+        out.push(tensor.dtype as u8);
+        put_i32(out, tensor.layout.format as i32);
+        put_i32(out, tensor.layout.vectorized_dim);
+        put_i32(out, tensor.layout.components);
+        put_shape(out, &tensor.shape);
+        out.push(tensor.shape_inference as u8);
+        out.push(tensor.location as u8);
+        put_u32(out, tensor.profiles.len());
+        for profile in tensor.profiles.iter() {
+            match profile {
+                Some(range) => {
+                    out.push(1);
+                    [&range.min, &range.opt, &range.max].iter().for_each(|shape| put_shape(out, shape));
+                }
+                None => out.push(0),
+            }
+        }
+    }
+}
+
+fn invalid(what: &str) -> io::Error {
+    io::Error::new(ErrorKind::InvalidData, format!("invalid plan info: {}", what))
+}
+
+fn read_array<const N: usize>(reader: &mut impl Read) -> io::Result<[u8; N]> {
+    let mut bytes = [0; N];
+    reader.read_exact(&mut bytes)?;
+    Ok(bytes)
+}
+
+fn read_u8(reader: &mut impl Read) -> io::Result<u8> {
+    Ok(read_array::<1>(reader)?[0])
+}
+
+fn read_u32(reader: &mut impl Read) -> io::Result<usize> {
+    Ok(u32::from_le_bytes(read_array(reader)?) as usize)
+}
+
+fn read_u64(reader: &mut impl Read) -> io::Result<u64> {
+    Ok(u64::from_le_bytes(read_array(reader)?))
+}
+
+fn read_i32(reader: &mut impl Read) -> io::Result<i32> {
+    Ok(i32::from_le_bytes(read_array(reader)?))
+}
+
+fn read_shape(reader: &mut impl Read) -> io::Result<Shape> {
+    let nb_dims = read_u8(reader)? as usize;
+    if nb_dims > MAX_DIMS {
+        return Err(invalid("dims"));
+    }
+    let dims = (0..nb_dims).map(|_| read_i32(reader)).collect::<io::Result<Vec<_>>>()?;
+    Ok(Shape::new(&dims))
+}
+
+fn decode(reader: &mut impl Read) -> io::Result<PlanInfo> {
+    if &read_array::<8>(reader)? != MAGIC || read_u32(reader)? != VERSION as usize {
+        return Err(invalid("header"));
+    }
+    let (plan_size, plan_modified) = (read_u64(reader)?, read_u64(reader)?);
+    let device_memory_size = read_u64(reader)? as usize;
+    let weights_size = read_u64(reader)? as usize;
+    let streamable_weights_size = read_u64(reader)? as usize;
+    let (num_layers, num_aux_streams) = (read_i32(reader)?, read_i32(reader)?);
+    let refittable = read_u8(reader)? != 0;
+    let hardware_compatibility = match read_u8(reader)? {
+        0 => HardwareCompatibilityLevel::NONE,
+        1 => HardwareCompatibilityLevel::AMPEREPLUS,
+        2 => HardwareCompatibilityLevel::SAMECOMPUTECAPABILITY,
+        _ => return Err(invalid("hardware compatibility level")),
+    };
+    let profiling_verbosity = match read_u8(reader)? {
+        0 => ProfilingVerbosity::LAYERNAMESONLY,
+        1 => ProfilingVerbosity::NONE,
+        2 => ProfilingVerbosity::DETAILED,
+        _ => return Err(invalid("profiling verbosity")),
+    };
+
+    let num_profiles = read_i32(reader)?;
+    let num_tensors = read_u32(reader)?;
+    let mut tensors = Vec::new();
+    for _ in 0..num_tensors {
+        let len = read_u32(reader)?;
+        let mut name = Vec::new();
+        reader.take(len as u64).read_to_end(&mut name)?;
+        let name = match (name.len() == len).then(|| String::from_utf8(name)) {
+            Some(Ok(name)) => name,
+            _ => return Err(invalid("tensor name")),
+        };
+        let index = read_u32(reader)?;
+        let io_mode = match read_u8(reader)? {
+            1 => TensorIOMode::INPUT,
+            2 => TensorIOMode::OUTPUT,
+            _ => TensorIOMode::NONE,
+        };
+        let dtype = match DataType::from_i32(read_u8(reader)? as i32) {
+            Some(dtype) => dtype,
+            None => return Err(invalid("dtype")),
+        };
+        let format = match TensorFormat::from_i32(read_i32(reader)?) {
+            Some(format) => format,
+            None => return Err(invalid("tensor format")),
+        };
+        let layout = TensorLayout::new(format, read_i32(reader)?, read_i32(reader)?);
+        let shape = read_shape(reader)?;
+        let shape_inference = read_u8(reader)? != 0;
+        let location = match read_u8(reader)? {
+            0 => TensorLocation::DEVICE,
+            1 => TensorLocation::HOST,
+            _ => return Err(invalid("tensor location")),
+        };
+        let mut profiles = Vec::new();
+        for _ in 0..read_u32(reader)? {
+            profiles.push(match read_u8(reader)? {
+                0 => None,
+                _ => {
+                    let (min, opt, max) = (read_shape(reader)?, read_shape(reader)?, read_shape(reader)?);
+                    Some(ProfileShape { min, opt, max })
+                }
+            });
+        }
+        tensors.push(TensorSchema { name, index, io_mode, dtype, layout, shape, shape_inference, location, profiles });
+    }
+
+    Ok(PlanInfo {
+        schema: IoSchema::new(tensors, num_profiles),
+        device_memory_size,
+        weights_size,
+        streamable_weights_size,
+        num_layers,
+        num_aux_streams,
+        refittable,
+        hardware_compatibility,
+        profiling_verbosity,
+        plan_size,
+        plan_modified,
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn info_roundtrips() {
+        let input = TensorSchema {
+            name: "images".to_string(),
+            index: 0,
+            io_mode: TensorIOMode::INPUT,
+            dtype: DataType::HALF,
+            layout: TensorLayout::new(TensorFormat::LINEAR, -1, 1),
+            shape: Shape::new(&[-1, 3, 224, 224]),
+            shape_inference: false,
+            location: TensorLocation::DEVICE,
+            profiles: vec![
+                Some(ProfileShape {
+                    min: Shape::new(&[1, 3, 224, 224]),
+                    opt: Shape::new(&[8, 3, 224, 224]),
+                    max: Shape::new(&[32, 3, 224, 224]),
+                }),
+                None,
+            ],
+        };
+        let output = TensorSchema {
+            name: "embeddings".to_string(),
+            index: 1,
+            io_mode: TensorIOMode::OUTPUT,
+            dtype: DataType::FLOAT,
+            layout: TensorLayout::new(TensorFormat::LINEAR, -1, 1),
+            shape: Shape::new(&[-1, 512]),
+            shape_inference: false,
+            location: TensorLocation::HOST,
+            profiles: Vec::new(),
+        };
+        let info = PlanInfo {
+            schema: IoSchema::new(vec![input, output], 2),
+            device_memory_size: 1 << 30,
+            weights_size: 300 << 20,
+            streamable_weights_size: 0,
+            num_layers: 412,
+            num_aux_streams: 1,
+            refittable: true,
+            hardware_compatibility: HardwareCompatibilityLevel::AMPEREPLUS,
+            profiling_verbosity: ProfilingVerbosity::DETAILED,
+            plan_size: 123,
+            plan_modified: 456,
+        };
+        let mut out = Vec::new();
+        encode(&info, &mut out);
+        assert_eq!(decode(&mut out.as_slice()).unwrap(), info);
+        assert!(decode(&mut &out[..out.len() - 1]).is_err());
+    }
+}
@@ -0,0 +1,139 @@
+use crate::error::{TRTError, TRTResult};
+use std::{
+    path::PathBuf,
+    thread,
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::plugin::{self, PluginCreator, PluginCreatorInfo, PluginLibraryHandle};
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct PluginOptions {
+    // Registers the plugins shipped in libnvinfer_plugin.
+    pub standard_plugins: bool,
+    // Namespace of the standard plugins, empty for the default one. Only the first
+    // registration in the process applies.
+    pub plugin_namespace: String,
+    // Plugin libraries to load, e.g. those engines were built with. Loaded concurrently.
+    pub libraries: Vec<PathBuf>,
+}
+
+impl Default for PluginOptions {
+    fn default() -> Self {
+        Self {
+            standard_plugins: true,
+            plugin_namespace: String::new(),
+            libraries: Vec::new(),
+        }
+    }
+}
+
+// Registers plugins up front, at startup, so that no engine deserialization or first request
+// pays for loading them. Create it before any engine using the plugins is deserialized and
+// keep it until those engines are dropped: dropping it deregisters the libraries it loaded.
+pub struct PluginManager {
+    libraries: Vec<(PathBuf, PluginLibraryHandle)>,
+    registered: Vec<PluginCreatorInfo>,
+    plugin_namespace: String,
+    load_time: Duration,
+}
+
+impl PluginManager {
+    pub fn load(options: &PluginOptions) -> TRTResult<Self> {
+        let started = Instant::now();
+        let before = plugin::get_plugin_creators();
+        if options.standard_plugins && !plugin::init_lib_nvinfer_plugins(&options.plugin_namespace) {
+            return Err(TRTError::PluginInitError);
+        }
+
+        let handles: Vec<PluginLibraryHandle> = thread::scope(|scope| {
+            let loads: Vec<_> = options
+                .libraries
+                .iter()
+                .map(|path| scope.spawn(move || plugin::load_library(&path.to_string_lossy())))
+                .collect();
+            loads.into_iter().map(|load| load.join().unwrap_or(0)).collect()
+        });
+        let mut manager = Self {
+            libraries: Vec::with_capacity(handles.len()),
+            registered: Vec::new(),
+            plugin_namespace: options.plugin_namespace.clone(),
+            load_time: Duration::ZERO,
+        };
+        let mut failed = None;
+        for (path, handle) in options.libraries.iter().zip(handles) {
+            match handle {
+                0 => failed = failed.or_else(|| Some(path.clone())),
+                handle => manager.libraries.push((path.clone(), handle)),
+            }
+        }
+        // the libraries that did load are deregistered when `manager` drops
+        if let Some(path) = failed {
+            return Err(TRTError::PluginLoadError(path));
+        }
+
+        manager.registered = registered_since(&before, plugin::get_plugin_creators());
+        manager.load_time = started.elapsed();
+        Ok(manager)
+    }
+
+    // Registers a Rust-implemented plugin under `name` and `version` in the namespace of the
+    // options; it stays registered for the rest of the process.
+    pub fn register_creator<C: PluginCreator + 'static>(&mut self, name: &str, version: &str, creator: C) -> TRTResult<()> {
+        if !plugin::register_plugin_creator(name, version, &self.plugin_namespace, creator) {
+            return Err(TRTError::PluginRegistrationError(name.to_string()));
+        }
+        self.registered.push(PluginCreatorInfo {
+            name: name.to_string(),
+            version: version.to_string(),
+            plugin_namespace: self.plugin_namespace.clone(),
+        });
+        Ok(())
+    }
+
+    // The creators that were not in the registry before this manager loaded its plugins.
+    pub fn registered_creators(&self) -> &[PluginCreatorInfo] {
+        &self.registered
+    }
+
+    // Every creator in the registry, whoever registered it.
+    pub fn all_creators(&self) -> Vec<PluginCreatorInfo> {
+        plugin::get_plugin_creators()
+    }
+
+    pub fn libraries(&self) -> impl Iterator<Item = &PathBuf> {
+        self.libraries.iter().map(|(path, _)| path)
+    }
+
+    // How long load took, for TRTEngine::record_startup(StartupPhase::PluginLoad, ..).
+    pub fn load_time(&self) -> Duration {
+        self.load_time
+    }
+}
+
+impl Drop for PluginManager {
+    fn drop(&mut self) {
+        for (_, handle) in self.libraries.drain(..) {
+            plugin::unload_library(handle);
+        }
+    }
+}
+
+fn registered_since(before: &[PluginCreatorInfo], after: Vec<PluginCreatorInfo>) -> Vec<PluginCreatorInfo> {
+    after.into_iter().filter(|creator| !before.contains(creator)).collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn creator(name: &str, version: &str) -> PluginCreatorInfo {
+        PluginCreatorInfo { name: name.to_string(), version: version.to_string(), plugin_namespace: String::new() }
+    }
+
+    #[test]
+    fn reports_new_creators_only() {
+        let before = [creator("NMS", "1")];
+        let after = vec![creator("NMS", "1"), creator("NMS", "2"), creator("ROIAlign", "1")];
+        assert_eq!(registered_since(&before, after), vec![creator("NMS", "2"), creator("ROIAlign", "1")]);
+    }
+}
@@ -0,0 +1,561 @@
+use crate::{
+    completion::WaitStrategy,
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    nvtx::{self, Category},
+    plan::{PlanFile, PlanLoadOptions},
+    priority::{AdmissionPolicy, PriorityClass},
+    profile::ProfileSelector,
+    runtime::SharedRuntime,
+    sm_budget::SmBudget,
+    state::{SessionSlots, StateBinding, StateSession},
+    tensor::{Shape, Tensor},
+    weight_streaming::WeightStreamingBudget,
+};
+use crossbeam_queue::ArrayQueue;
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::runtime::DataType;
+use std::{
+    collections::HashMap,
+    ops::{Deref, DerefMut},
+    path::Path,
+    sync::{Arc, Condvar, Mutex, RwLock},
+    thread,
+    time::Instant,
+};
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct EnginePoolOptions {
+    pub num_contexts: usize,
+    // Optimization profile per context, assigned round-robin; empty keeps profile 0. Contexts
+    // bound to a profile hold only its scratch, grown when a checkout switches them to a
+    // profile needing more.
+    pub profiles: Vec<i32>,
+    pub plan: PlanLoadOptions,
+    // Applies to checkout_class only.
+    pub admission: AdmissionPolicy,
+    // Set on the shared engine before any context is created; FreeMemory accounts for all
+    // of the pool's contexts.
+    pub weight_streaming: Option<WeightStreamingBudget>,
+    // Applied to every context; see TRTEngine::set_wait_strategy.
+    pub wait_strategy: WaitStrategy,
+    // SMs all of the pool's contexts share, taken from an SmPartition of the device together
+    // with the budgets of the other engines it runs next to; see TRTEngine::set_sm_budget.
+    pub sm_budget: Option<SmBudget>,
+    // State inputs and outputs of a stateful engine, for open_session.
+    pub state_bindings: Vec<StateBinding>,
+    // Deserializes the plan through this runtime instead of one of the pool's own, e.g. one
+    // with a pooled allocator (SharedRuntime::with_allocator) for the engine and contexts.
+    pub runtime: Option<SharedRuntime>,
+}
+
+impl Default for EnginePoolOptions {
+    fn default() -> Self {
+        Self {
+            num_contexts: 2,
+            profiles: Vec::new(),
+            plan: PlanLoadOptions::default(),
+            admission: AdmissionPolicy::default(),
+            weight_streaming: None,
+            wait_strategy: WaitStrategy::default(),
+            sm_budget: None,
+            state_bindings: Vec::new(),
+            runtime: None,
+        }
+    }
+}
+
+// One deployed plan: its contexts, idle ones queued by the profile they are bound to.
+struct Generation {
+    version: u64,
+    idle: Vec<ArrayQueue<TRTEngine>>,
+    selector: ProfileSelector,
+    num_contexts: usize,
+}
+
+impl Generation {
+    // With `background`, setup runs on low-priority streams, so warming a version deployed by
+    // swap yields to the traffic still served by the current one.
+    fn new<F>(
+        data: &[u8],
+        options: &EnginePoolOptions,
+        version: u64,
+        background: bool,
+        mut setup: F,
+    ) -> TRTResult<Self>
+    where
+        F: FnMut(usize, &mut TRTEngine) -> TRTResult<()>,
+    {
+        if options.num_contexts == 0 {
+            return Err(TRTError::ExecutionContextCreationError);
+        }
+
+        let stream = CuStream::new()?;
+        let mut first = match options.runtime.as_ref() {
+            Some(runtime) => TRTEngine::from_bytes_shared(data, &stream, runtime)?,
+            None => TRTEngine::from_bytes(data, &stream)?,
+        };
+        if let Some(budget) = options.weight_streaming {
+            first.apply_weight_streaming(budget, options.num_contexts)?;
+        }
+        let core = first.core()?;
+        let selector = first.get_profile_selector()?;
+
+        // every queue can hold every context, since contexts may switch profiles
+        let idle = (0..selector.num_profiles().max(1))
+            .map(|_| ArrayQueue::new(options.num_contexts))
+            .collect();
+        let generation = Self { version, idle, selector, num_contexts: options.num_contexts };
+
+        let mut engines = vec![first];
+        for _ in 1..options.num_contexts {
+            engines.push(TRTEngine::from_core(core.clone(), &CuStream::new()?));
+        }
+
+        for (i, mut engine) in engines.into_iter().enumerate() {
+            match options.profiles.is_empty() {
+                true => engine.activate()?,
+                false => engine.activate_for_profile(options.profiles[i % options.profiles.len()])?,
+            }
+            engine.set_wait_strategy(options.wait_strategy);
+            if options.sm_budget.is_some() {
+                engine.set_sm_budget(options.sm_budget.clone())?;
+            }
+            if background {
+                engine.set_priority_class(PriorityClass::Batch)?;
+                setup(i, &mut engine)?;
+                engine.set_stream_priority(None)?;
+            } else {
+                setup(i, &mut engine)?;
+            }
+            generation.push(engine);
+        }
+
+        Ok(generation)
+    }
+
+    fn num_idle(&self) -> usize {
+        self.idle.iter().map(|queue| queue.len()).sum()
+    }
+
+    fn pop(&self) -> Option<TRTEngine> {
+        self.idle.iter().find_map(|queue| queue.pop())
+    }
+
+    fn push(&self, engine: TRTEngine) {
+        let profile = engine.get_optimization_profile().unwrap_or(0).max(0) as usize;
+        let queue = &self.idle[profile.min(self.idle.len() - 1)];
+        queue.push(engine).ok();
+    }
+}
+
+// N execution contexts over a single deserialized CudaEngine, each with its own stream and
+// IO buffers. Idle contexts sit in lock-free queues, one per optimization profile, so a
+// request can be routed to a context already bound to the tightest profile for its shapes.
+// The mutex/condvar pair is only touched when a caller has to wait for a checkin, or to
+// check out by priority class.
+//
+// swap deploys another plan under live traffic; checkouts then come from the new version
+// while those of the old one finish on the old contexts.
+pub struct EnginePool {
+    current: RwLock<Arc<Generation>>,
+    options: EnginePoolOptions,
+    admission: AdmissionPolicy,
+    waiters: (Mutex<Admission>, Condvar),
+    // one swap at a time
+    swapping: Mutex<()>,
+    sessions: SessionSlots,
+}
+
+#[derive(Default)]
+struct Admission {
+    interactive_waiting: usize,
+    batch_waiting: usize,
+    batch_in_flight: usize,
+    // swaps waiting for the contexts of an old version
+    draining: usize,
+}
+
+impl EnginePool {
+    // `setup` runs once per context after activation and profile selection, typically to
+    // call allocate_io_tensors with the max shapes of that context's profile.
+    pub fn new<P, F>(engine_path: &P, options: &EnginePoolOptions, setup: F) -> TRTResult<Self>
+    where
+        P: AsRef<Path>,
+        F: FnMut(usize, &mut TRTEngine) -> TRTResult<()>,
+    {
+        let plan = PlanFile::open(engine_path, &options.plan)?;
+        let pool = Self::from_bytes(plan.as_bytes(), options, setup)?;
+        plan.release()?;
+        Ok(pool)
+    }
+
+    pub fn from_bytes<F>(data: &[u8], options: &EnginePoolOptions, setup: F) -> TRTResult<Self>
+    where
+        F: FnMut(usize, &mut TRTEngine) -> TRTResult<()>,
+    {
+        let generation = Generation::new(data, options, 0, false, setup)?;
+        Ok(Self {
+            current: RwLock::new(Arc::new(generation)),
+            options: options.clone(),
+            admission: options.admission,
+            waiters: (Mutex::new(Admission::default()), Condvar::new()),
+            swapping: Mutex::new(()),
+            sessions: SessionSlots::default(),
+        })
+    }
+
+    // Deploys the plan at `engine_path` in place of the current one; see swap_bytes.
+    pub fn swap<P, F>(&self, engine_path: &P, setup: F) -> TRTResult<u64>
+    where
+        P: AsRef<Path>,
+        F: FnMut(usize, &mut TRTEngine) -> TRTResult<()>,
+    {
+        let plan = PlanFile::open(engine_path, &self.options.plan)?;
+        let version = self.swap_bytes(plan.as_bytes(), setup)?;
+        plan.release()?;
+        Ok(version)
+    }
+
+    // Hot-swaps the engine without pausing traffic, returning the new version. Run it on a
+    // thread of its own: it builds the new version's contexts with the pool's options and
+    // runs `setup` on them (allocate IO tensors, warm up) while requests are still served by
+    // the current version, then switches all later checkouts to the new version at once,
+    // waits for the checkouts of the old version to be returned and frees the old contexts
+    // itself, so no request pays for loading, warmup or teardown. Both versions are resident
+    // in between. On error the current version stays in place.
+    pub fn swap_bytes<F>(&self, data: &[u8], setup: F) -> TRTResult<u64>
+    where
+        F: FnMut(usize, &mut TRTEngine) -> TRTResult<()>,
+    {
+        let _swapping = self.swapping.lock().unwrap();
+        let _range = nvtx::range!(Category::Wait, "swap engine");
+        let version = self.generation().version + 1;
+        let next = Arc::new(Generation::new(data, &self.options, version, true, setup)?);
+        let old = std::mem::replace(&mut *self.current.write().unwrap(), next);
+
+        let (lock, cond) = &self.waiters;
+        let mut state = lock.lock().unwrap();
+        // waiters retry on the new version's idle contexts
+        cond.notify_all();
+        state.draining += 1;
+        while old.num_idle() < old.num_contexts {
+            state = cond.wait(state).unwrap();
+        }
+        state.draining -= 1;
+        drop(state);
+
+        // dropped here rather than by the request releasing the last reference
+        while let Some(engine) = old.pop() {
+            drop(engine);
+        }
+        Ok(version)
+    }
+
+    // Version of the plan checkouts come from: 0 for the one the pool was created with, one
+    // more for every swap.
+    pub fn version(&self) -> u64 {
+        self.generation().version
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.generation().num_contexts
+    }
+
+    pub fn num_idle(&self) -> usize {
+        self.generation().num_idle()
+    }
+
+    pub fn profile_selector(&self) -> ProfileSelector {
+        self.generation().selector.clone()
+    }
+
+    fn generation(&self) -> Arc<Generation> {
+        self.current.read().unwrap().clone()
+    }
+
+    pub fn try_checkout(&self) -> Option<PooledEngine<'_>> {
+        let generation = self.generation();
+        let engine = generation.pop()?;
+        Some(PooledEngine { pool: self, generation, engine: Some(engine), class: None })
+    }
+
+    // A context already bound to `profile`, if one is idle.
+    pub fn try_checkout_profile(&self, profile: i32) -> Option<PooledEngine<'_>> {
+        let generation = self.generation();
+        let engine = generation.idle.get(profile as usize).and_then(|queue| queue.pop())?;
+        Some(PooledEngine { pool: self, generation, engine: Some(engine), class: None })
+    }
+
+    // Blocks until a context is available.
+    pub fn checkout(&self) -> PooledEngine<'_> {
+        self.wait_for(|| self.try_checkout())
+    }
+
+    // Like checkout, but gives up with DeadlineExceeded at `deadline`, so a request whose
+    // caller has stopped waiting never takes a context.
+    pub fn checkout_until(&self, deadline: Instant) -> TRTResult<PooledEngine<'_>> {
+        if let Some(engine) = self.try_checkout() {
+            return Ok(engine);
+        }
+
+        let _range = nvtx::range!(Category::Wait, "wait for context");
+        let (lock, cond) = &self.waiters;
+        let mut guard = lock.lock().unwrap();
+        loop {
+            if let Some(engine) = self.try_checkout() {
+                return Ok(engine);
+            }
+            let now = Instant::now();
+            if now >= deadline {
+                return Err(TRTError::DeadlineExceeded);
+            }
+            guard = cond.wait_timeout(guard, deadline - now).unwrap().0;
+        }
+    }
+
+    // Blocks until a context for the tightest profile accepting `shapes` is available.
+    // Contexts pre-bound to that profile are preferred; otherwise any idle context is switched.
+    pub fn checkout_for(&self, shapes: &HashMap<&str, &Shape>) -> TRTResult<PooledEngine<'_>> {
+        let generation = self.generation();
+        let selector = &generation.selector;
+        let profile = match selector.num_profiles() {
+            0 | 1 => return Ok(self.checkout()),
+            _ => match selector.select(shapes) {
+                Some(profile) => profile,
+                None => return Err(TRTError::ShapeMismatch),
+            },
+        };
+
+        let mut engine = self.wait_for(|| {
+            self.try_checkout_profile(profile).or_else(|| self.try_checkout())
+        });
+        engine.set_optimization_profile(profile)?;
+        Ok(engine)
+    }
+    // Blocks until the admission policy lets `class` take a context, whose enqueues then run
+    // on a stream of the class priority until checkin. Interactive callers take any idle
+    // context and hold back batch checkouts while they wait; batch callers only take contexts
+    // beyond the policy's interactive reserve.
+    pub fn checkout_class(&self, class: PriorityClass) -> TRTResult<PooledEngine<'_>> {
+        let _range = nvtx::range!(Category::Wait, "checkout context");
+        let (lock, cond) = &self.waiters;
+        let mut state = lock.lock().unwrap();
+        let mut engine = match class {
+            PriorityClass::Interactive => {
+                state.interactive_waiting += 1;
+                let engine = loop {
+                    if let Some(engine) = self.try_checkout() {
+                        break engine;
+                    }
+                    state = cond.wait(state).unwrap();
+                };
+                state.interactive_waiting -= 1;
+                // batch waiters held back by this caller may proceed now
+                if state.interactive_waiting == 0 && state.batch_waiting > 0 {
+                    cond.notify_all();
+                }
+                engine
+            }
+            PriorityClass::Batch => {
+                state.batch_waiting += 1;
+                let engine = loop {
+                    let admitted = self.admission.admits_batch(
+                        self.capacity(),
+                        self.num_idle(),
+                        state.interactive_waiting,
+                        state.batch_in_flight,
+                    );
+                    if admitted {
+                        if let Some(engine) = self.try_checkout() {
+                            break engine;
+                        }
+                    }
+                    state = cond.wait(state).unwrap();
+                };
+                state.batch_waiting -= 1;
+                state.batch_in_flight += 1;
+                engine
+            }
+        };
+        drop(state);
+
+        engine.class = Some(class);
+        engine.set_priority_class(class)?;
+        Ok(engine)
+    }
+
+    // TRTEngine::inference_chunked with the chunks spread round-robin over one checked-out
+    // context and every other context idle at the call, each enqueueing its share on its own
+    // stream; returns once all of them have completed. Chunks are sized for the first
+    // context, so contexts bound to different profiles need auto profile selection.
+    pub fn inference_chunked(&self, feed_dict: &HashMap<&str, &Tensor>) -> TRTResult<HashMap<String, Tensor>> {
+        let mut first = self.checkout();
+        let batch = first.batch_rows(feed_dict)?;
+        let rows = first.max_chunk_rows(feed_dict)?;
+        let outputs = first.chunked_outputs(feed_dict, batch, rows, None)?;
+        // the outputs are written from the other contexts' streams
+        first.synchronize_checked(None)?;
+
+        let chunks: Vec<_> = (0..batch).step_by(rows).map(|start| (start, rows.min(batch - start))).collect();
+        let mut engines = vec![first];
+        while engines.len() < chunks.len() {
+            match self.try_checkout() {
+                Some(engine) => engines.push(engine),
+                None => break,
+            }
+        }
+
+        // tensors stay on this thread; the workers take views of the same memory
+        let views = |tensors: Vec<(&str, &Tensor)>| -> Vec<(String, usize, Shape, DataType)> {
+            let view = |(name, tensor): (&str, &Tensor)| {
+                (name.to_string(), unsafe { tensor.get_raw_ptr() }, *tensor.shape(), tensor.dtype())
+            };
+            tensors.into_iter().map(view).collect()
+        };
+        let inputs = views(feed_dict.iter().map(|(&name, &tensor)| (name, tensor)).collect());
+        let output_views = views(outputs.iter().map(|(name, tensor)| (name.as_str(), tensor)).collect());
+        let workers = engines.len();
+        let results: Vec<TRTResult<()>> = thread::scope(|scope| {
+            let handles: Vec<_> = engines
+                .into_iter()
+                .enumerate()
+                .map(|(k, mut engine)| {
+                    let (inputs, output_views, chunks) = (&inputs, &output_views, &chunks);
+                    scope.spawn(move || -> TRTResult<()> {
+                        engine.make_current()?;
+                        let stream = engine.get_stream().clone();
+                        let tensor = |(name, ptr, shape, dtype): &(String, usize, Shape, DataType)| {
+                            (name.clone(), Tensor::from_raw_ptr(*ptr, shape, *dtype, &stream))
+                        };
+                        let inputs: Vec<_> = inputs.iter().map(tensor).collect();
+                        let outputs: HashMap<String, Tensor> = output_views.iter().map(tensor).collect();
+                        let feed_dict = inputs.iter().map(|(name, tensor)| (name.as_str(), tensor)).collect();
+                        let share: Vec<_> = chunks.iter().copied().skip(k).step_by(workers).collect();
+                        engine.run_chunks(&feed_dict, &outputs, &share, None)?;
+                        engine.synchronize_checked(None)
+                    })
+                })
+                .collect();
+            handles.into_iter().map(|handle| handle.join().unwrap()).collect()
+        });
+        for res in results {
+            res?;
+        }
+        Ok(outputs)
+    }
+
+    // Opens a sequence of a stateful engine, with its state in the options' state_bindings
+    // zeroed at the `initial` shapes; returns the id its steps are run by. The state stays
+    // with the pool between steps, so any context may run the next one.
+    pub fn open_session(&self, initial: &HashMap<&str, &Shape>) -> TRTResult<u64> {
+        let engine = self.checkout();
+        let session = StateSession::new(&engine, &self.options.state_bindings, initial, engine.get_stream())?;
+        Ok(self.sessions.insert(session))
+    }
+
+    // Runs the next step of session `id` on whichever context is free (see
+    // TRTEngine::inference_stateful) and hands its outputs to `read` before the context is
+    // checked in. Fails with SessionNotFound while another step of the session runs.
+    pub fn step<R, F>(&self, id: u64, feed_dict: &HashMap<&str, &Tensor>, read: F) -> TRTResult<R>
+    where
+        F: FnOnce(&HashMap<String, Tensor>) -> TRTResult<R>,
+    {
+        let mut session = self.sessions.take(id)?;
+        let result = (|| {
+            let mut engine = self.checkout();
+            let outputs = engine.inference_stateful(feed_dict, &mut session, None)?;
+            read(outputs)
+        })();
+        self.sessions.put(id, session);
+        result
+    }
+
+    // Frees the state of session `id`; false if there is none or a step of it is running.
+    pub fn close_session(&self, id: u64) -> bool {
+        self.sessions.remove(id).is_some()
+    }
+
+    pub fn num_sessions(&self) -> usize {
+        self.sessions.len()
+    }
+
+    fn wait_for<'a, F: Fn() -> Option<PooledEngine<'a>>>(&'a self, try_checkout: F) -> PooledEngine<'a> {
+        if let Some(engine) = try_checkout() {
+            return engine;
+        }
+
+        let _range = nvtx::range!(Category::Wait, "wait for context");
+        let (lock, cond) = &self.waiters;
+        let mut guard = lock.lock().unwrap();
+        loop {
+            // re-checked under the lock, so a checkin between the pop and the wait is not missed
+            if let Some(engine) = try_checkout() {
+                return engine;
+            }
+            guard = cond.wait(guard).unwrap();
+        }
+    }
+
+    fn checkin(&self, generation: &Generation, mut engine: TRTEngine, class: Option<PriorityClass>) {
+        if class.is_some() {
+            engine.set_stream_priority(None).ok();
+        }
+        generation.push(engine);
+        let (lock, cond) = &self.waiters;
+        let mut state = lock.lock().unwrap();
+        if class == Some(PriorityClass::Batch) {
+            state.batch_in_flight -= 1;
+        }
+        // a single wakeup could go to a batch waiter the policy turns away, or to a swap
+        // waiting for another version
+        if state.batch_waiting > 0 || state.draining > 0 {
+            cond.notify_all();
+        } else {
+            cond.notify_one();
+        }
+    }
+}
+
+// A checked-out context; returned to the pool on drop. Work enqueued on its stream must be
+// synchronized (or awaited) before the guard is dropped, since the next holder reuses the
+// same IO buffers.
+pub struct PooledEngine<'a> {
+    pool: &'a EnginePool,
+    generation: Arc<Generation>,
+    engine: Option<TRTEngine>,
+    class: Option<PriorityClass>,
+}
+
+impl PooledEngine<'_> {
+    pub fn priority_class(&self) -> Option<PriorityClass> {
+        self.class
+    }
+
+    // The EnginePool::version this context belongs to.
+    pub fn version(&self) -> u64 {
+        self.generation.version
+    }
+}
+
+impl Deref for PooledEngine<'_> {
+    type Target = TRTEngine;
+
+    fn deref(&self) -> &TRTEngine {
+        self.engine.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for PooledEngine<'_> {
+    fn deref_mut(&mut self) -> &mut TRTEngine {
+        self.engine.as_mut().unwrap()
+    }
+}
+
+impl Drop for PooledEngine<'_> {
+    fn drop(&mut self) {
+        if let Some(engine) = self.engine.take() {
+            self.pool.checkin(&self.generation, engine, self.class);
+        }
+    }
+}
@@ -0,0 +1,425 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    staging::pinned,
+    tensor::Tensor,
+};
+use cuda_rs::{memory::DeviceMemory, stream::CuStream};
+use std::mem::size_of;
+use tensorrt_rs_sys::{
+    kernels::{crop_resize, ctc_greedy_decode, db_postprocess, DbBoxStats},
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    runtime::DataType,
+};
+
+// Thresholds of DB (differentiable binarization) text detectors such as PP-OCR's; the
+// defaults are PaddleOCR's.
+#[derive(Debug, Clone)]
+pub struct DbOptions {
+    // probability above which a pixel is text
+    pub thresh: f32,
+    // minimum mean probability of a kept box
+    pub box_thresh: f32,
+    // how far boxes are grown to undo the shrunk text kernels the model predicts
+    pub unclip_ratio: f32,
+    // boxes with a shorter side are dropped
+    pub min_size: f32,
+    pub max_candidates: usize,
+}
+
+impl Default for DbOptions {
+    fn default() -> Self {
+        Self { thresh: 0.3, box_thresh: 0.6, unclip_ratio: 1.5, min_size: 3.0, max_candidates: 1000 }
+    }
+}
+
+// An axis-aligned text box in probability-map pixels, with its mean probability.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct TextBox {
+    pub x0: f32,
+    pub y0: f32,
+    pub x1: f32,
+    pub y1: f32,
+    pub score: f32,
+}
+
+impl TextBox {
+    // Maps the box back to the source image, e.g. `src_width / map_width`.
+    pub fn scaled(&self, scale_x: f32, scale_y: f32) -> Self {
+        Self {
+            x0: self.x0 * scale_x,
+            y0: self.y0 * scale_y,
+            x1: self.x1 * scale_x,
+            y1: self.y1 * scale_y,
+            score: self.score,
+        }
+    }
+}
+
+// GPU post-processing of DB probability maps: thresholding, connected components and box
+// extraction run on the device, and only the per-component statistics (a few KB) are read
+// back instead of the whole map.
+pub struct DbPostprocessor {
+    options: DbOptions,
+    capacity: usize,
+    labels: DeviceMemory,
+    roots: DeviceMemory,
+    boxes: DeviceMemory,
+    count: DeviceMemory,
+    // count, padded to 8 bytes, followed by max_candidates DbBoxStats
+    host: PinnedMemory,
+}
+
+const HOST_BOXES_OFFSET: usize = 8;
+
+impl DbPostprocessor {
+    // Scratch space is sized for maps of up to `max_height * max_width` pixels.
+    pub fn new(options: DbOptions, max_height: usize, max_width: usize, stream: &CuStream) -> TRTResult<Self> {
+        let capacity = max_height * max_width;
+        let boxes_size = options.max_candidates.max(1) * size_of::<DbBoxStats>();
+        Ok(Self {
+            labels: DeviceMemory::new(capacity * size_of::<i32>(), stream)?,
+            roots: DeviceMemory::new(capacity * size_of::<i32>(), stream)?,
+            boxes: DeviceMemory::new(boxes_size, stream)?,
+            count: DeviceMemory::new(size_of::<i32>(), stream)?,
+            host: pinned(HOST_BOXES_OFFSET + boxes_size)?,
+            options,
+            capacity,
+        })
+    }
+
+    pub fn options(&self) -> &DbOptions {
+        &self.options
+    }
+
+    // Extracts the text boxes of batch entry `batch_index` of `prob`, a FLOAT or HALF map
+    // whose last two dims are [H, W] (e.g. [N, 1, H, W]). Synchronizes `stream`; boxes are in
+    // top-to-bottom, left-to-right order.
+    pub fn run(&mut self, prob: &Tensor, batch_index: usize, stream: &CuStream) -> TRTResult<Vec<TextBox>> {
+        let prob_half = match prob.dtype() {
+            DataType::FLOAT => false,
+            DataType::HALF => true,
+            _ => return Err(TRTError::DTypeMismatch),
+        };
+        let dims = prob.shape().as_slice();
+        let (height, width) = match dims {
+            &[.., height, width] => (height as usize, width as usize),
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let plane = height * width;
+        if plane == 0 || plane > self.capacity || (batch_index + 1) * plane > prob.shape().size() {
+            return Err(TRTError::ShapeMismatch);
+        }
+
+        let max_boxes = self.options.max_candidates;
+        let boxes_size = max_boxes * size_of::<DbBoxStats>();
+        let host = self.host.get_raw();
+        unsafe {
+            let map = prob.get_raw_ptr() + batch_index * plane * prob.dtype().get_elem_size();
+            let launched = db_postprocess(
+                map,
+                width as _,
+                height as _,
+                prob_half,
+                self.options.thresh,
+                self.labels.get_raw() as _,
+                self.roots.get_raw() as _,
+                self.boxes.get_raw() as _,
+                max_boxes,
+                self.count.get_raw() as _,
+                stream,
+            );
+            if !launched {
+                return Err(TRTError::KernelLaunchError);
+            }
+            let count = self.count.get_raw() as usize;
+            let boxes = self.boxes.get_raw() as usize;
+            if !memcpy_async(host, count, size_of::<i32>(), MemcpyKind::DeviceToHost, stream)
+                || !memcpy_async(host + HOST_BOXES_OFFSET, boxes, boxes_size, MemcpyKind::DeviceToHost, stream)
+            {
+                return Err(TRTError::MemcpyError);
+            }
+        }
+        stream.synchronize()?;
+
+        let stats = unsafe {
+            let count = (*(host as *const i32)).clamp(0, max_boxes as i32) as usize;
+            std::slice::from_raw_parts((host + HOST_BOXES_OFFSET) as *const DbBoxStats, count)
+        };
+        Ok(boxes_from_stats(stats, width as f32, height as f32, &self.options))
+    }
+}
+
+// Cuts text boxes out of an image and resizes each into one entry of a recognizer batch in
+// a single launch, so the regions never leave the device. Only the box corners are uploaded.
+pub struct TextCropper {
+    max_boxes: usize,
+    rects: DeviceMemory,
+    host: PinnedMemory,
+}
+
+impl TextCropper {
+    pub fn new(max_boxes: usize, stream: &CuStream) -> TRTResult<Self> {
+        let size = max_boxes.max(1) * 4 * size_of::<f32>();
+        Ok(Self { max_boxes, rects: DeviceMemory::new(size, stream)?, host: pinned(size)? })
+    }
+
+    // Crops `boxes`, in pixels of `image` (a planar FLOAT or HALF [.., C, H, W] tensor), and
+    // bilinearly resizes them into the first boxes.len() entries of `dst`, [N, C, H', W'] of
+    // the same dtype. Asynchronous on `stream`, which must have finished the previous run's
+    // upload (any synchronization after it does).
+    pub fn run(&mut self, image: &Tensor, boxes: &[TextBox], dst: &Tensor, stream: &CuStream) -> TRTResult<()> {
+        let (channels, height, width) = match image.shape().as_slice() {
+            &[.., channels, height, width] => (channels, height, width),
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let (dst_height, dst_width) = match dst.shape().as_slice() {
+            &[batch, dst_channels, height, width] if batch as usize >= boxes.len() && dst_channels == channels => {
+                (height, width)
+            }
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let half = match (image.dtype(), dst.dtype()) {
+            (DataType::FLOAT, DataType::FLOAT) => false,
+            (DataType::HALF, DataType::HALF) => true,
+            _ => return Err(TRTError::DTypeMismatch),
+        };
+        if boxes.len() > self.max_boxes {
+            return Err(TRTError::ShapeMismatch);
+        }
+        if boxes.is_empty() {
+            return Ok(());
+        }
+
+        let host = self.host.get_raw();
+        let rects = unsafe { std::slice::from_raw_parts_mut(host as *mut f32, boxes.len() * 4) };
+        for (rect, text_box) in rects.chunks_exact_mut(4).zip(boxes) {
+            rect.copy_from_slice(&[text_box.x0, text_box.y0, text_box.x1, text_box.y1]);
+        }
+        let launched = unsafe {
+            let device_rects = self.rects.get_raw() as usize;
+            memcpy_async(device_rects, host, boxes.len() * 4 * size_of::<f32>(), MemcpyKind::HostToDevice, stream)
+                && crop_resize(
+                    image.get_raw_ptr(),
+                    channels as _,
+                    height as _,
+                    width as _,
+                    half,
+                    device_rects,
+                    boxes.len() as _,
+                    dst.get_raw_ptr(),
+                    dst_height as _,
+                    dst_width as _,
+                    stream,
+                )
+        };
+        match launched {
+            true => Ok(()),
+            false => Err(TRTError::KernelLaunchError),
+        }
+    }
+}
+
+// Greedy CTC decoding of text recognizer outputs (CRNN, SVTR, PP-OCR rec) on the GPU: the
+// per-step argmax, merging and blank removal run on the device, and only the label ids of
+// each row come back, to be mapped to text here.
+pub struct CtcDecoder {
+    // the text of every class, indexed as the recognizer's last axis
+    dictionary: Vec<String>,
+    blank: usize,
+    max_rows: usize,
+    max_steps: usize,
+    labels: DeviceMemory,
+    lengths: DeviceMemory,
+    scores: DeviceMemory,
+    // max_rows lengths, max_rows scores, then max_rows * max_steps labels
+    host: PinnedMemory,
+}
+
+impl CtcDecoder {
+    // `dictionary` has one entry per class, `blank` included (PaddleOCR: the blank at 0, the
+    // lines of its key file, then " ").
+    pub fn new(
+        dictionary: Vec<String>,
+        blank: usize,
+        max_rows: usize,
+        max_steps: usize,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        if blank >= dictionary.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let (max_rows, max_steps) = (max_rows.max(1), max_steps.max(1));
+        let labels_size = max_rows * max_steps * size_of::<i32>();
+        Ok(Self {
+            labels: DeviceMemory::new(labels_size, stream)?,
+            lengths: DeviceMemory::new(max_rows * size_of::<i32>(), stream)?,
+            scores: DeviceMemory::new(max_rows * size_of::<f32>(), stream)?,
+            host: pinned(2 * max_rows * size_of::<i32>() + labels_size)?,
+            dictionary,
+            blank,
+            max_rows,
+            max_steps,
+        })
+    }
+
+    // Decodes the first `rows` sequences of `probs`, the FLOAT or HALF [N, T, classes]
+    // output of the recognizer, into their text and mean label probability. Synchronizes
+    // `stream`.
+    pub fn run(&mut self, probs: &Tensor, rows: usize, stream: &CuStream) -> TRTResult<Vec<(String, f32)>> {
+        let half = match probs.dtype() {
+            DataType::FLOAT => false,
+            DataType::HALF => true,
+            _ => return Err(TRTError::DTypeMismatch),
+        };
+        let (steps, classes) = match probs.shape().as_slice() {
+            &[batch, steps, classes] if rows <= batch as usize => (steps as usize, classes as usize),
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        if rows > self.max_rows || steps == 0 || steps > self.max_steps || classes != self.dictionary.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        if rows == 0 {
+            return Ok(Vec::new());
+        }
+
+        let host = self.host.get_raw();
+        let host_scores = host + self.max_rows * size_of::<i32>();
+        let host_labels = host_scores + self.max_rows * size_of::<f32>();
+        unsafe {
+            let (labels, lengths, scores) =
+                (self.labels.get_raw() as usize, self.lengths.get_raw() as usize, self.scores.get_raw() as usize);
+            let launched = ctc_greedy_decode(
+                probs.get_raw_ptr(),
+                half,
+                rows,
+                steps,
+                classes,
+                self.blank,
+                labels,
+                lengths,
+                scores,
+                stream,
+            );
+            if !launched {
+                return Err(TRTError::KernelLaunchError);
+            }
+            let d2h = MemcpyKind::DeviceToHost;
+            if !memcpy_async(host, lengths, rows * size_of::<i32>(), d2h, stream)
+                || !memcpy_async(host_scores, scores, rows * size_of::<f32>(), d2h, stream)
+                || !memcpy_async(host_labels, labels, rows * steps * size_of::<i32>(), d2h, stream)
+            {
+                return Err(TRTError::MemcpyError);
+            }
+        }
+        stream.synchronize()?;
+
+        let (lengths, scores, labels) = unsafe {
+            (
+                std::slice::from_raw_parts(host as *const i32, rows),
+                std::slice::from_raw_parts(host_scores as *const f32, rows),
+                std::slice::from_raw_parts(host_labels as *const i32, rows * steps),
+            )
+        };
+        Ok(decode_labels(labels, lengths, scores, steps, &self.dictionary))
+    }
+}
+
+// Maps the [rows, steps] label ids the CTC kernel kept, `lengths` of them per row, to text.
+fn decode_labels(
+    labels: &[i32],
+    lengths: &[i32],
+    scores: &[f32],
+    steps: usize,
+    dictionary: &[String],
+) -> Vec<(String, f32)> {
+    lengths
+        .iter()
+        .zip(scores)
+        .zip(labels.chunks_exact(steps))
+        .map(|((&length, &score), row)| {
+            let text = row[..(length.max(0) as usize).min(steps)]
+                .iter()
+                .filter_map(|&label| dictionary.get(label as usize))
+                .map(String::as_str)
+                .collect();
+            (text, score)
+        })
+        .collect()
+}
+
+// Applies the score and size filters and the DB unclip to component statistics. The unclip
+// grows a w x h box by area * ratio / perimeter on every side, as PaddleOCR does for
+// its polygons.
+fn boxes_from_stats(stats: &[DbBoxStats], width: f32, height: f32, options: &DbOptions) -> Vec<TextBox> {
+    let mut boxes: Vec<TextBox> = stats
+        .iter()
+        .filter(|stats| stats.area > 0)
+        .filter_map(|stats| {
+            let w = (stats.max_x - stats.min_x + 1) as f32;
+            let h = (stats.max_y - stats.min_y + 1) as f32;
+            if w.min(h) < options.min_size {
+                return None;
+            }
+            let score = stats.score_sum / stats.area as f32;
+            if score < options.box_thresh {
+                return None;
+            }
+            let distance = w * h * options.unclip_ratio / (2.0 * (w + h));
+            let text_box = TextBox {
+                x0: (stats.min_x as f32 - distance).max(0.0),
+                y0: (stats.min_y as f32 - distance).max(0.0),
+                x1: ((stats.max_x + 1) as f32 + distance).min(width),
+                y1: ((stats.max_y + 1) as f32 + distance).min(height),
+                score,
+            };
+            if (text_box.x1 - text_box.x0).min(text_box.y1 - text_box.y0) < options.min_size + 2.0 {
+                return None;
+            }
+            Some(text_box)
+        })
+        .collect();
+    boxes.sort_by(|a, b| a.y0.total_cmp(&b.y0).then(a.x0.total_cmp(&b.x0)));
+    boxes
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn stats(min_x: i32, min_y: i32, max_x: i32, max_y: i32, score: f32) -> DbBoxStats {
+        let area = (max_x - min_x + 1) * (max_y - min_y + 1);
+        DbBoxStats { min_x, min_y, max_x, max_y, area, score_sum: score * area as f32 }
+    }
+
+    #[test]
+    fn test_boxes_from_stats() {
+        let options = DbOptions::default();
+        let stats = [
+            stats(100, 50, 199, 59, 0.9),
+            // too thin
+            stats(10, 10, 200, 11, 0.9),
+            // too unsure
+            stats(10, 100, 60, 120, 0.4),
+            stats(0, 0, 39, 9, 0.8),
+        ];
+        let boxes = boxes_from_stats(&stats, 640.0, 352.0, &options);
+        assert_eq!(boxes.len(), 2);
+
+        // 40 x 10 grows by 40 * 10 * 1.5 / 100 = 6 on each side, clamped to the map
+        assert_eq!((boxes[0].x0, boxes[0].y0, boxes[0].x1, boxes[0].y1), (0.0, 0.0, 46.0, 16.0));
+        assert!((boxes[0].score - 0.8).abs() < 1e-5);
+        // 100 x 10 grows by 100 * 10 * 1.5 / 220
+        let distance = 1500.0 / 220.0;
+        assert!((boxes[1].x0 - (100.0 - distance)).abs() < 1e-4);
+        assert!((boxes[1].y1 - (60.0 + distance)).abs() < 1e-4);
+    }
+
+    #[test]
+    fn test_decode_labels() {
+        let dictionary: Vec<String> = ["", "a", "b", " "].iter().map(|key| key.to_string()).collect();
+        // two rows of 4 steps; labels past a row's length are stale
+        let labels = [1, 2, 1, 0, 3, 2, 3, 3];
+        let decoded = decode_labels(&labels, &[3, 0], &[0.9, 0.0], 4, &dictionary);
+        assert_eq!(decoded, vec![("aba".to_string(), 0.9), (String::new(), 0.0)]);
+    }
+}
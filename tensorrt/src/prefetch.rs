@@ -0,0 +1,215 @@
+use memmap2::{Advice, Mmap};
+use std::{
+    collections::{HashSet, VecDeque},
+    fs::File,
+    io::{self, Read},
+    path::{Path, PathBuf},
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Arc, Condvar, Mutex,
+    },
+    thread::{self, JoinHandle},
+};
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum PrefetchMode {
+    // madvise(MADV_WILLNEED) on a transient mapping: the kernel starts asynchronous readahead
+    // of the whole file and the worker moves on at once.
+    Advise,
+    // Reads the file through, so its pages are cached once the prefetch completes, even
+    // where the kernel caps or drops readahead.
+    Read,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct PrefetchOptions {
+    // Files warmed at once; cold storage is usually best read by few streams.
+    pub num_workers: usize,
+    pub mode: PrefetchMode,
+    // Size of the reads of PrefetchMode::Read.
+    pub chunk_size: usize,
+}
+
+impl Default for PrefetchOptions {
+    fn default() -> Self {
+        Self { num_workers: 2, mode: PrefetchMode::Read, chunk_size: 4 << 20 }
+    }
+}
+
+#[derive(Default)]
+struct Queue {
+    paths: VecDeque<PathBuf>,
+    // queued or being warmed, so repeated predictions of one plan warm it once
+    pending: HashSet<PathBuf>,
+    closed: bool,
+}
+
+struct Shared {
+    queue: Mutex<Queue>,
+    changed: Condvar,
+    bytes: AtomicU64,
+    failed: AtomicU64,
+}
+
+// Warms the page cache with engine plans that are about to be deserialized, so that
+// deserializeCudaEngine reads them from memory instead of page-faulting on cold storage.
+// Fed by the model manager's predictions (ModelManager::set_prefetcher) and the startup
+// loader's list of specs; plans are warmed by background workers in the order they are
+// queued. Warming is a hint: errors are counted, not returned.
+pub struct PlanPrefetcher {
+    shared: Arc<Shared>,
+    workers: Vec<JoinHandle<()>>,
+}
+
+impl PlanPrefetcher {
+    pub fn new(options: PrefetchOptions) -> Self {
+        let shared = Arc::new(Shared {
+            queue: Mutex::new(Queue::default()),
+            changed: Condvar::new(),
+            bytes: AtomicU64::new(0),
+            failed: AtomicU64::new(0),
+        });
+        let workers = (0..options.num_workers.max(1))
+            .map(|_| {
+                let shared = shared.clone();
+                thread::spawn(move || Self::work(&shared, options))
+            })
+            .collect();
+        Self { shared, workers }
+    }
+
+    // Queues `path` unless it is queued or being warmed already.
+    pub fn prefetch<P: AsRef<Path>>(&self, path: &P) {
+        let path = path.as_ref().to_path_buf();
+        let mut queue = self.shared.queue.lock().unwrap();
+        if queue.closed || !queue.pending.insert(path.clone()) {
+            return;
+        }
+        queue.paths.push_back(path);
+        self.shared.changed.notify_all();
+    }
+
+    // Plans queued or being warmed.
+    pub fn num_pending(&self) -> usize {
+        self.shared.queue.lock().unwrap().pending.len()
+    }
+
+    // Blocks until every queued plan has been warmed (or its readahead issued).
+    pub fn wait(&self) {
+        let mut queue = self.shared.queue.lock().unwrap();
+        while !queue.pending.is_empty() {
+            queue = self.shared.changed.wait(queue).unwrap();
+        }
+    }
+
+    // Bytes warmed so far.
+    pub fn bytes_prefetched(&self) -> u64 {
+        self.shared.bytes.load(Ordering::Relaxed)
+    }
+
+    // Plans that could not be opened or read.
+    pub fn num_failed(&self) -> u64 {
+        self.shared.failed.load(Ordering::Relaxed)
+    }
+
+    fn work(shared: &Shared, options: PrefetchOptions) {
+        let mut buffer = Vec::new();
+        loop {
+            let path = {
+                let mut queue = shared.queue.lock().unwrap();
+                loop {
+                    if let Some(path) = queue.paths.pop_front() {
+                        break path;
+                    }
+                    if queue.closed {
+                        return;
+                    }
+                    queue = shared.changed.wait(queue).unwrap();
+                }
+            };
+
+            match warm(&path, options, &mut buffer) {
+                Ok(bytes) => shared.bytes.fetch_add(bytes, Ordering::Relaxed),
+                Err(_) => shared.failed.fetch_add(1, Ordering::Relaxed),
+            };
+
+            let mut queue = shared.queue.lock().unwrap();
+            queue.pending.remove(&path);
+            shared.changed.notify_all();
+        }
+    }
+}
+
+impl Default for PlanPrefetcher {
+    fn default() -> Self {
+        Self::new(PrefetchOptions::default())
+    }
+}
+
+impl Drop for PlanPrefetcher {
+    // Plans still queued are dropped; the ones being read are finished.
+    fn drop(&mut self) {
+        {
+            let mut queue = self.shared.queue.lock().unwrap();
+            queue.closed = true;
+            queue.paths.clear();
+            self.shared.changed.notify_all();
+        }
+        for worker in self.workers.drain(..) {
+            worker.join().ok();
+        }
+    }
+}
+
+fn warm(path: &Path, options: PrefetchOptions, buffer: &mut Vec<u8>) -> io::Result<u64> {
+    let mut file = File::open(path)?;
+    match options.mode {
+        PrefetchMode::Advise => {
+            let len = file.metadata()?.len();
+            if len == 0 {
+                return Ok(0);
+            }
+            // the readahead outlives the mapping: it fills the page cache, not this process
+            let mmap = unsafe { Mmap::map(&file)? };
+            mmap.advise(Advice::WillNeed)?;
+            Ok(len)
+        }
+        PrefetchMode::Read => {
+            buffer.resize(options.chunk_size.max(4096), 0);
+            let mut total = 0;
+            loop {
+                match file.read(buffer) {
+                    Ok(0) => return Ok(total),
+                    Ok(n) => total += n as u64,
+                    Err(err) if err.kind() == io::ErrorKind::Interrupted => continue,
+                    Err(err) => return Err(err),
+                }
+            }
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn warms_queued_plans() {
+        let dir = std::env::temp_dir().join(format!("trt-prefetch-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let (a, b) = (dir.join("a.plan"), dir.join("b.plan"));
+        std::fs::write(&a, vec![1u8; 10000]).unwrap();
+        std::fs::write(&b, vec![2u8; 300]).unwrap();
+
+        let options = PrefetchOptions { num_workers: 1, chunk_size: 4096, ..PrefetchOptions::default() };
+        let prefetcher = PlanPrefetcher::new(options);
+        prefetcher.prefetch(&a);
+        prefetcher.prefetch(&b);
+        prefetcher.prefetch(&dir.join("missing.plan"));
+        prefetcher.wait();
+        assert_eq!(prefetcher.num_pending(), 0);
+        assert_eq!(prefetcher.num_failed(), 1);
+        assert_eq!(prefetcher.bytes_prefetched(), 10300);
+        std::fs::remove_dir_all(&dir).ok();
+    }
+}
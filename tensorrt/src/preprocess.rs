@@ -0,0 +1,137 @@
+use crate::{
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    tensor::Tensor,
+};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::{kernels, runtime::DataType};
+
+// GPU image preprocessing: a uint8 HWC image is resized, normalized, transposed to CHW and
+// optionally cast to FP16 by one kernel, writing straight into an NCHW input binding. Only the
+// uint8 pixels cross PCIe, a quarter of the float32 NCHW bytes.
+#[derive(Debug, Clone)]
+pub struct ImagePreprocessor {
+    scale: [f32; 4],
+    bias: [f32; 4],
+    swap_rb: bool,
+}
+
+impl ImagePreprocessor {
+    // Scales pixels to [0, 1].
+    pub fn new() -> Self {
+        Self { scale: [1.0 / 255.0; 4], bias: [0.0; 4], swap_rb: false }
+    }
+
+    // (pixel / 255 - mean) / std per channel, with mean and std given on the [0, 1] scale.
+    pub fn with_normalization(mean: &[f32], std: &[f32]) -> Self {
+        assert!(mean.len() == std.len() && mean.len() <= 4, "mean/std must have one entry per channel, at most 4");
+        let mut preprocessor = Self::new();
+        for (c, (&mean, &std)) in mean.iter().zip(std).enumerate() {
+            preprocessor.scale[c] = 1.0 / (255.0 * std);
+            preprocessor.bias[c] = -mean / std;
+        }
+        preprocessor
+    }
+
+    // The torchvision ImageNet normalization used by most CLIP and ResNet exports.
+    pub fn imagenet() -> Self {
+        Self::with_normalization(&[0.485, 0.456, 0.406], &[0.229, 0.224, 0.225])
+    }
+
+    // Reverses the first three channels, e.g. BGR images from a decoder into an RGB model.
+    pub fn swap_rb(mut self, swap_rb: bool) -> Self {
+        self.swap_rb = swap_rb;
+        self
+    }
+
+    // Writes `image`, a UINT8 [H, W, C] device tensor, into batch entry `batch_index` of `dst`,
+    // a FLOAT or HALF [N, C, H', W'] tensor, resizing from H x W to H' x W'.
+    pub fn run(&self, image: &Tensor, dst: &Tensor, batch_index: usize, stream: &CuStream) -> TRTResult<()> {
+        if image.dtype() != DataType::UINT8 {
+            return Err(TRTError::DTypeMismatch);
+        }
+        let dst_half = match dst.dtype() {
+            DataType::FLOAT => false,
+            DataType::HALF => true,
+            _ => return Err(TRTError::DTypeMismatch),
+        };
+        let (src_height, src_width, channels) = match image.shape().as_slice() {
+            &[height, width, channels] => (height as usize, width as usize, channels as usize),
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        let (batch, dst_height, dst_width) = match dst.shape().as_slice() {
+            &[batch, dst_channels, height, width] if dst_channels as usize == channels => {
+                (batch as usize, height as usize, width as usize)
+            }
+            _ => return Err(TRTError::ShapeMismatch),
+        };
+        if batch_index >= batch || channels == 0 || channels > 4 {
+            return Err(TRTError::ShapeMismatch);
+        }
+
+        let slot_size = channels * dst_height * dst_width * dst.dtype().get_elem_size();
+        let launched = unsafe {
+            kernels::preprocess_image(
+                image.get_raw_ptr(),
+                src_width as _,
+                src_height as _,
+                src_width * channels,
+                channels as _,
+                dst.get_raw_ptr() + batch_index * slot_size,
+                dst_width as _,
+                dst_height as _,
+                dst_half,
+                self.swap_rb,
+                &self.scale,
+                &self.bias,
+                stream,
+            )
+        };
+        if !launched {
+            return Err(TRTError::KernelLaunchError);
+        }
+        Ok(())
+    }
+}
+
+impl Default for ImagePreprocessor {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+impl TRTEngine {
+    // Preprocesses `image` directly into the engine-owned input buffer `name` at
+    // `batch_index`, on the engine stream. Follow with set_input_shape and execute.
+    pub fn preprocess_input(
+        &self,
+        name: &str,
+        image: &Tensor,
+        batch_index: usize,
+        preprocessor: &ImagePreprocessor,
+    ) -> TRTResult<()> {
+        let tensor = match self.get_tensor(name) {
+            Some(tensor) => tensor,
+            None => return Err(TRTError::TensorNotFound(name.to_string())),
+        };
+        preprocessor.run(image, tensor, batch_index, self.get_stream())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_normalization_coefficients() {
+        let preprocessor = ImagePreprocessor::imagenet();
+        // (pixel / 255 - mean) / std == pixel * scale + bias
+        for (c, (mean, std)) in [(0.485f32, 0.229f32), (0.456, 0.224), (0.406, 0.225)].into_iter().enumerate() {
+            for pixel in [0.0f32, 128.0, 255.0] {
+                let expected = (pixel / 255.0 - mean) / std;
+                let actual = pixel * preprocessor.scale[c] + preprocessor.bias[c];
+                assert!((expected - actual).abs() < 1e-5);
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    sm_budget::SmBudget,
+};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::stream::{get_stream_priority_range, CudaEvent, CudaStream};
+
+// Traffic classes sharing a GPU. Interactive work is enqueued on greatest-priority streams,
+// so its kernels are scheduled ahead of batch kernels already queued on the device.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub enum PriorityClass {
+    Interactive,
+    Batch,
+}
+
+impl PriorityClass {
+    // Stream priority of the class on the current device.
+    pub fn stream_priority(self) -> i32 {
+        let (least, greatest) = get_stream_priority_range();
+        match self {
+            PriorityClass::Interactive => greatest,
+            PriorityClass::Batch => least,
+        }
+    }
+}
+
+// How many contexts of a pool batch work may hold. Batch checkouts are admitted only while
+// no interactive caller is waiting and at least `reserved_interactive` contexts would
+// remain idle, so a burst of interactive requests never queues behind a full batch load.
+// The reserve is capped at all but one context, so batch work can run on any pool.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct AdmissionPolicy {
+    pub reserved_interactive: usize,
+    // Upper bound on contexts checked out for batch work at once; 0 means no bound.
+    pub max_batch_in_flight: usize,
+}
+
+impl Default for AdmissionPolicy {
+    fn default() -> Self {
+        Self {
+            reserved_interactive: 1,
+            max_batch_in_flight: 0,
+        }
+    }
+}
+
+impl AdmissionPolicy {
+    pub(crate) fn admits_batch(
+        &self,
+        capacity: usize,
+        num_idle: usize,
+        interactive_waiting: usize,
+        batch_in_flight: usize,
+    ) -> bool {
+        interactive_waiting == 0
+            && num_idle > self.reserved_interactive.min(capacity.saturating_sub(1))
+            && (self.max_batch_in_flight == 0 || batch_in_flight < self.max_batch_in_flight)
+    }
+}
+
+// A stream of a given priority that an engine forks its enqueue onto: the lane waits for the
+// work already on the caller's stream, runs the engine, and the caller's stream waits for the
+// lane. Copies stay on the caller's stream, and the fork/join is legal under graph capture.
+// Under an SM budget the lane's stream belongs to the budget's green context, which confines
+// the engine's kernels to its SMs.
+pub(crate) struct PriorityLane {
+    stream: CudaStream,
+    fork: CudaEvent,
+    join: CudaEvent,
+}
+
+impl PriorityLane {
+    pub(crate) fn new(priority: i32, budget: Option<&SmBudget>) -> TRTResult<Self> {
+        let stream = match budget {
+            Some(budget) => budget.create_stream(priority)?,
+            None => match CudaStream::new(priority) {
+                Some(stream) => stream,
+                None => return Err(TRTError::StreamCreationError),
+            },
+        };
+        match (CudaEvent::new(), CudaEvent::new()) {
+            (Some(fork), Some(join)) => Ok(Self { stream, fork, join }),
+            _ => Err(TRTError::EventError),
+        }
+    }
+
+    pub(crate) fn priority(&self) -> i32 {
+        self.stream.priority()
+    }
+
+    // Runs `enqueue` with the lane's raw stream in between the fork and the join.
+    pub(crate) fn enqueue_with<F: FnOnce(usize) -> bool>(&self, stream: &CuStream, enqueue: F) -> bool {
+        let lane = self.stream.get_raw();
+        if !self.fork.record(stream) || !self.fork.wait_raw(lane) {
+            return false;
+        }
+        let enqueued = enqueue(lane);
+        // joined even when the enqueue failed, so the caller's stream never overtakes the lane
+        self.join.record_raw(lane) && self.join.wait(stream) && enqueued
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn batch_yields_to_waiting_interactive() {
+        let policy = AdmissionPolicy { reserved_interactive: 0, max_batch_in_flight: 0 };
+        assert!(policy.admits_batch(4, 2, 0, 0));
+        assert!(!policy.admits_batch(4, 2, 1, 0));
+    }
+
+    #[test]
+    fn batch_leaves_reserved_contexts_idle() {
+        let policy = AdmissionPolicy { reserved_interactive: 1, max_batch_in_flight: 0 };
+        assert!(policy.admits_batch(4, 2, 0, 2));
+        assert!(!policy.admits_batch(4, 1, 0, 3));
+        assert!(!policy.admits_batch(4, 0, 0, 4));
+    }
+
+    #[test]
+    fn reserve_never_takes_every_context() {
+        let policy = AdmissionPolicy::default();
+        assert!(policy.admits_batch(1, 1, 0, 0));
+        let policy = AdmissionPolicy { reserved_interactive: 3, max_batch_in_flight: 0 };
+        assert!(policy.admits_batch(2, 2, 0, 0));
+        assert!(!policy.admits_batch(2, 1, 0, 1));
+    }
+
+    #[test]
+    fn batch_in_flight_is_bounded() {
+        let policy = AdmissionPolicy { reserved_interactive: 0, max_batch_in_flight: 2 };
+        assert!(policy.admits_batch(4, 4, 0, 1));
+        assert!(!policy.admits_batch(4, 4, 0, 2));
+    }
+}
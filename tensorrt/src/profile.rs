@@ -0,0 +1,126 @@
+use crate::tensor::Shape;
+use std::collections::HashMap;
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct ProfileShape {
+    pub min: Shape,
+    pub opt: Shape,
+    pub max: Shape,
+}
+
+impl ProfileShape {
+    pub fn contains(&self, shape: &Shape) -> bool {
+        shape.nb_dims() == self.min.nb_dims()
+            && shape.nb_dims() == self.max.nb_dims()
+            && shape
+                .iter()
+                .zip(self.min.iter().zip(self.max.iter()))
+                .all(|(&dim, (&min, &max))| min <= dim && dim <= max)
+    }
+
+    // `shape` with every dim moved into [min, max], e.g. to carry a context's input shapes
+    // over to another profile. Shapes of another rank are returned unchanged.
+    pub fn clamp(&self, shape: &Shape) -> Shape {
+        if shape.nb_dims() != self.min.nb_dims() || shape.nb_dims() != self.max.nb_dims() {
+            return *shape;
+        }
+        let dims: Vec<i32> = shape
+            .iter()
+            .zip(self.min.iter().zip(self.max.iter()))
+            .map(|(&dim, (&min, &max))| dim.clamp(min, max))
+            .collect();
+        Shape::new(&dims)
+    }
+}
+
+// The min/opt/max input shapes of every optimization profile of an engine, used to route a
+// request to the tightest profile that accepts it.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct ProfileSelector {
+    profiles: Vec<HashMap<String, ProfileShape>>,
+}
+
+impl ProfileSelector {
+    pub fn new(profiles: Vec<HashMap<String, ProfileShape>>) -> Self {
+        Self { profiles }
+    }
+
+    pub fn num_profiles(&self) -> usize {
+        self.profiles.len()
+    }
+
+    pub fn get(&self, profile: i32) -> Option<&HashMap<String, ProfileShape>> {
+        self.profiles.get(profile as usize)
+    }
+
+    // Among the profiles whose [min, max] range accepts every given input, picks the one with
+    // the smallest max volume, i.e. the one whose kernels were tuned closest to the request.
+    // Ties go to the lower profile index.
+    pub fn select(&self, shapes: &HashMap<&str, &Shape>) -> Option<i32> {
+        let mut best: Option<(usize, usize)> = None;
+        for (index, profile) in self.profiles.iter().enumerate() {
+            let mut volume = 0;
+            let mut accepted = true;
+            for (name, shape) in shapes {
+                match profile.get(*name) {
+                    Some(range) if range.contains(shape) => volume += range.max.size(),
+                    Some(_) => {
+                        accepted = false;
+                        break;
+                    }
+                    // not a shape input of this engine
+                    None => {}
+                }
+            }
+            if accepted && best.map_or(true, |(_, best_volume)| volume < best_volume) {
+                best = Some((index, volume));
+            }
+        }
+        best.map(|(index, _)| index as i32)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn profile(min: &[i32], max: &[i32]) -> HashMap<String, ProfileShape> {
+        let range = ProfileShape {
+            min: Shape::new(min),
+            opt: Shape::new(max),
+            max: Shape::new(max),
+        };
+        HashMap::from([("x".to_string(), range)])
+    }
+
+    #[test]
+    fn select_tightest_profile() {
+        let selector = ProfileSelector::new(vec![
+            profile(&[1, 3, 32, 32], &[8, 3, 1024, 1024]),
+            profile(&[1, 3, 32, 32], &[8, 3, 256, 256]),
+            profile(&[1, 3, 32, 32], &[8, 3, 512, 512]),
+        ]);
+        let small = Shape::new(&[1, 3, 200, 100]);
+        let large = Shape::new(&[1, 3, 800, 600]);
+        assert_eq!(selector.select(&HashMap::from([("x", &small)])), Some(1));
+        assert_eq!(selector.select(&HashMap::from([("x", &large)])), Some(0));
+    }
+
+    #[test]
+    fn select_rejects_out_of_range() {
+        let selector = ProfileSelector::new(vec![profile(&[1, 3, 32, 32], &[8, 3, 256, 256])]);
+        let shape = Shape::new(&[16, 3, 64, 64]);
+        assert_eq!(selector.select(&HashMap::from([("x", &shape)])), None);
+    }
+
+    #[test]
+    fn clamp_into_profile() {
+        let range = &profile(&[1, 3, 32, 32], &[8, 3, 256, 256])["x"];
+        let clamped = range.clamp(&Shape::new(&[16, 3, 1024, 16]));
+        assert_eq!(clamped, Shape::new(&[8, 3, 256, 32]));
+        let within = Shape::new(&[4, 3, 64, 64]);
+        assert_eq!(range.clamp(&within), within);
+        let other_rank = Shape::new(&[4, 64]);
+        assert_eq!(range.clamp(&other_rank), other_rank);
+    }
+}
@@ -0,0 +1,250 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    staging::{event, pinned_on},
+    tensor::{Shape, Tensor},
+    typed::TrtElement,
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    marker::PhantomData,
+    mem::size_of,
+    ops::Deref,
+    slice,
+    sync::{Arc, Mutex},
+};
+use tensorrt_rs_sys::{
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    numa,
+    runtime::DataType,
+    stream::CudaEvent,
+};
+
+// Page-locked host buffers and events recycled across read-backs, so fetching outputs costs
+// no cudaHostAlloc or cudaEventCreate once warm. Buffers are kept in power-of-two sizes.
+#[derive(Default)]
+pub struct ReadbackPool {
+    buffers: Mutex<Vec<PinnedMemory>>,
+    events: Mutex<Vec<CudaEvent>>,
+    node: Option<i32>,
+}
+
+impl ReadbackPool {
+    pub fn new() -> Arc<Self> {
+        Arc::new(Self::default())
+    }
+
+    // Buffers on the NUMA node closest to `device`.
+    pub fn for_device(device: i32) -> Arc<Self> {
+        Arc::new(Self { node: numa::get_device_node(device), ..Self::default() })
+    }
+
+    pub fn num_free_buffers(&self) -> usize {
+        self.buffers.lock().unwrap().len()
+    }
+
+    fn take_buffer(&self, size: usize) -> TRTResult<PinnedMemory> {
+        let mut buffers = self.buffers.lock().unwrap();
+        let best = buffers
+            .iter()
+            .enumerate()
+            .filter(|(_, buffer)| buffer.len() >= size)
+            .min_by_key(|(_, buffer)| buffer.len())
+            .map(|(index, _)| index);
+        match best {
+            Some(index) => Ok(buffers.swap_remove(index)),
+            None => {
+                drop(buffers);
+                pinned_on(size.max(1).next_power_of_two(), self.node)
+            }
+        }
+    }
+
+    fn take_event(&self) -> TRTResult<CudaEvent> {
+        match self.events.lock().unwrap().pop() {
+            Some(event) => Ok(event),
+            None => event(),
+        }
+    }
+}
+
+// One output copied to the host. The buffer goes back to its pool on drop.
+pub struct HostOutput {
+    pub name: String,
+    pub shape: Shape,
+    // what into_typed checks T against, so not to be changed
+    dtype: DataType,
+    size: usize,
+    buffer: Option<PinnedMemory>,
+    pool: Arc<ReadbackPool>,
+}
+
+impl HostOutput {
+    pub fn as_bytes(&self) -> &[u8] {
+        match self.buffer.as_ref() {
+            // only handed out once the copy into the buffer has completed
+            Some(buffer) => unsafe { &buffer.as_slice()[..self.size] },
+            None => &[],
+        }
+    }
+
+    pub fn to_vec(&self) -> Vec<u8> {
+        self.as_bytes().to_vec()
+    }
+
+    pub fn dtype(&self) -> DataType {
+        self.dtype
+    }
+
+    // The output as elements of T, read in place; T must be of its data type. BOOL outputs
+    // are checked to hold only 0 and 1, the only bytes that are valid bools.
+    pub fn into_typed<T: TrtElement>(self) -> TRTResult<PinnedResult<T>> {
+        if T::DTYPE != self.dtype {
+            return Err(TRTError::DTypeMismatch);
+        }
+        if T::DTYPE == DataType::BOOL && self.as_bytes().iter().any(|&byte| byte > 1) {
+            return Err(TRTError::InvalidBoolOutput(self.name.clone()));
+        }
+        Ok(PinnedResult { output: self, _marker: PhantomData })
+    }
+}
+
+impl Drop for HostOutput {
+    fn drop(&mut self) {
+        if let Some(buffer) = self.buffer.take() {
+            self.pool.buffers.lock().unwrap().push(buffer);
+        }
+    }
+}
+
+// An output read back into a pooled pinned buffer, as a slice of its elements: no copy into
+// a Vec, and the buffer goes back to its pool on drop.
+pub struct PinnedResult<T: TrtElement> {
+    output: HostOutput,
+    _marker: PhantomData<T>,
+}
+
+impl<T: TrtElement> PinnedResult<T> {
+    pub fn name(&self) -> &str {
+        &self.output.name
+    }
+
+    pub fn shape(&self) -> &Shape {
+        &self.output.shape
+    }
+
+    pub fn into_inner(self) -> HostOutput {
+        self.output
+    }
+}
+
+impl<T: TrtElement> Deref for PinnedResult<T> {
+    type Target = [T];
+
+    fn deref(&self) -> &[T] {
+        let bytes = self.output.as_bytes();
+        // pinned buffers are page-aligned, and T is the output's data type, checked to be valid
+        // for its bytes by into_typed
+        unsafe { slice::from_raw_parts(bytes.as_ptr() as *const T, bytes.len() / size_of::<T>()) }
+    }
+}
+
+// Device-to-host copies in flight on a stream. For async callers, awaiting a
+// StreamCompletion of the same stream first makes `wait` return immediately.
+pub struct Readback {
+    outputs: Vec<HostOutput>,
+    done: Option<CudaEvent>,
+    pool: Arc<ReadbackPool>,
+}
+
+impl Readback {
+    // Enqueues the copies of `tensors` (at their current, not max, shapes) on `stream`.
+    pub(crate) fn enqueue(
+        tensors: &[(&str, &Tensor)],
+        pool: &Arc<ReadbackPool>,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        let mut outputs = Vec::with_capacity(tensors.len());
+        match Self::enqueue_copies(tensors, pool, stream, &mut outputs) {
+            Ok(done) => Ok(Self { outputs, done: Some(done), pool: pool.clone() }),
+            Err(err) => {
+                Self::discard(outputs, stream);
+                Err(err)
+            }
+        }
+    }
+
+    fn enqueue_copies(
+        tensors: &[(&str, &Tensor)],
+        pool: &Arc<ReadbackPool>,
+        stream: &CuStream,
+        outputs: &mut Vec<HostOutput>,
+    ) -> TRTResult<CudaEvent> {
+        for (name, tensor) in tensors {
+            let size = tensor.size_in_bytes();
+            let buffer = pool.take_buffer(size)?;
+            let copied = unsafe {
+                memcpy_async(buffer.get_raw(), tensor.get_raw_ptr(), size, MemcpyKind::DeviceToHost, stream)
+            };
+            // pushed before checking, so the buffer is recycled either way
+            outputs.push(HostOutput {
+                name: name.to_string(),
+                shape: *tensor.shape(),
+                dtype: tensor.dtype(),
+                size,
+                buffer: Some(buffer),
+                pool: pool.clone(),
+            });
+            if !copied {
+                return Err(TRTError::MemcpyError);
+            }
+        }
+
+        let done = pool.take_event()?;
+        if !done.record(stream) {
+            return Err(TRTError::EventError);
+        }
+        Ok(done)
+    }
+
+    // The copies queued into `outputs` before enqueueing failed may still be running, so their
+    // buffers only go back to the pool once the stream is idle; they are leaked if it cannot
+    // be synchronized rather than handed out while written to.
+    fn discard(outputs: Vec<HostOutput>, stream: &CuStream) {
+        if stream.synchronize().is_err() {
+            for mut output in outputs {
+                if let Some(buffer) = output.buffer.take() {
+                    std::mem::forget(buffer);
+                }
+            }
+        }
+    }
+
+    pub fn is_complete(&self) -> bool {
+        self.done.as_ref().map_or(true, |done| done.is_complete())
+    }
+
+    // Blocks until the copies have landed.
+    pub fn wait(mut self) -> TRTResult<Vec<HostOutput>> {
+        let done = self.done.take().unwrap();
+        if !done.synchronize() {
+            return Err(TRTError::EventError);
+        }
+        self.pool.events.lock().unwrap().push(done);
+        Ok(std::mem::take(&mut self.outputs))
+    }
+
+    // Like wait, with every output as elements of T, e.g. the FLOAT logits of a classifier.
+    pub fn wait_as<T: TrtElement>(self) -> TRTResult<Vec<PinnedResult<T>>> {
+        self.wait()?.into_iter().map(HostOutput::into_typed).collect()
+    }
+}
+
+impl Drop for Readback {
+    fn drop(&mut self) {
+        // the buffers must not be reused while a copy into them is still queued
+        if let Some(done) = self.done.take() {
+            done.synchronize();
+            self.pool.events.lock().unwrap().push(done);
+        }
+    }
+}
@@ -0,0 +1,119 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::{
+    kernels::{mean_rows, normalize_rows, topk_rows},
+    runtime::DataType,
+};
+
+// A reduction over the last axis of a FLOAT or HALF output, run on the GPU so only its
+// result is read back, e.g. the top-5 classes of [256, 1000] logits instead of the logits.
+// See TRTEngine::attach_reduction.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum OutputReduction {
+    // FLOAT rows of unit L2 norm, e.g. CLIP embeddings for cosine similarity.
+    L2Normalize,
+    Softmax,
+    // INT32 index of each row's largest element.
+    Argmax,
+    // FLOAT [.., k] values of each row's k largest elements in descending order, with their
+    // INT32 indices read back as "<output>/indices".
+    TopK(usize),
+    // FLOAT mean of each row.
+    Mean,
+}
+
+impl OutputReduction {
+    fn shape(&self, rows: &[i32], cols: usize) -> Shape {
+        let mut dims = rows.to_vec();
+        match self {
+            Self::L2Normalize | Self::Softmax => dims.push(cols as i32),
+            Self::TopK(k) => dims.push((*k).min(cols) as i32),
+            Self::Argmax | Self::Mean => {}
+        }
+        Shape::new(&dims)
+    }
+}
+
+// The result tensors of one attached reduction, grown as the output's shape does.
+pub(crate) struct ReducedOutput {
+    pub(crate) reduction: OutputReduction,
+    pub(crate) result: Option<Tensor>,
+    // the indices of TopK
+    pub(crate) indices: Option<Tensor>,
+}
+
+impl ReducedOutput {
+    pub(crate) fn new(reduction: OutputReduction) -> Self {
+        Self { reduction, result: None, indices: None }
+    }
+
+    // Enqueues the reduction of `src` at its current shape on `stream`.
+    pub(crate) fn run(&mut self, src: &Tensor, stream: &CuStream) -> TRTResult<&Tensor> {
+        let half = match src.dtype() {
+            DataType::FLOAT => false,
+            DataType::HALF => true,
+            _ => return Err(TRTError::DTypeMismatch),
+        };
+        let dims = src.shape().as_slice();
+        let (&cols, rows_dims) = match dims.split_last() {
+            Some((cols, rows_dims)) if *cols > 0 => (cols, rows_dims),
+            _ => return Err(TRTError::ShapeError(dims.to_vec())),
+        };
+        let (cols, rows) = (cols as usize, rows_dims.iter().map(|&dim| dim as usize).product::<usize>());
+        let shape = self.reduction.shape(rows_dims, cols);
+        let result_type = match self.reduction {
+            OutputReduction::Argmax => DataType::INT32,
+            _ => DataType::FLOAT,
+        };
+        let result = fit(&mut self.result, &shape, result_type, stream)?;
+
+        let src_ptr = unsafe { src.get_raw_ptr() };
+        let result_ptr = unsafe { result.get_raw_ptr() };
+        let launched = unsafe {
+            match self.reduction {
+                OutputReduction::L2Normalize => normalize_rows(src_ptr, half, rows, cols, false, result_ptr, stream),
+                OutputReduction::Softmax => normalize_rows(src_ptr, half, rows, cols, true, result_ptr, stream),
+                OutputReduction::Mean => mean_rows(src_ptr, half, rows, cols, result_ptr, stream),
+                OutputReduction::Argmax => topk_rows(src_ptr, half, rows, cols, 1, 0, result_ptr, stream),
+                OutputReduction::TopK(k) => {
+                    let indices = fit(&mut self.indices, &shape, DataType::INT32, stream)?;
+                    topk_rows(src_ptr, half, rows, cols, k, result_ptr, indices.get_raw_ptr(), stream)
+                }
+            }
+        };
+        match launched {
+            true => Ok(self.result.as_ref().unwrap()),
+            false => Err(TRTError::KernelLaunchError),
+        }
+    }
+}
+
+// `slot` reshaped to `shape`, reallocated when it cannot hold it.
+pub(crate) fn fit<'a>(
+    slot: &'a mut Option<Tensor>,
+    shape: &Shape,
+    dtype: DataType,
+    stream: &CuStream,
+) -> TRTResult<&'a Tensor> {
+    match slot {
+        Some(tensor) if tensor.capacity() >= shape.size() => unsafe { tensor.reset_shape(shape)? },
+        _ => *slot = Some(Tensor::empty(shape, dtype, stream)?),
+    }
+    Ok(slot.as_ref().unwrap())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn reductions_keep_the_leading_axes() {
+        assert_eq!(OutputReduction::Argmax.shape(&[256], 1000), Shape::new(&[256]));
+        assert_eq!(OutputReduction::TopK(5).shape(&[2, 8], 1000), Shape::new(&[2, 8, 5]));
+        assert_eq!(OutputReduction::TopK(5).shape(&[4], 3), Shape::new(&[4, 3]));
+        assert_eq!(OutputReduction::L2Normalize.shape(&[1], 768), Shape::new(&[1, 768]));
+    }
+}
@@ -0,0 +1,245 @@
+use crate::{
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use memmap2::{Advice, Mmap};
+use std::{collections::HashMap, fs::File, marker::PhantomData, path::Path};
+use tensorrt_rs_sys::{
+    gds::{self, GdsBuffer, GdsFile},
+    runtime::DataType,
+};
+
+// New values for one named engine weight (see TRTEngine::get_refittable_weights). The memory
+// is borrowed and only read while TRTEngine::refit runs.
+#[derive(Clone, Copy)]
+pub struct NamedWeights<'a> {
+    pub(crate) name: &'a str,
+    pub(crate) dtype: DataType,
+    pub(crate) ptr: usize,
+    pub(crate) count: usize,
+    pub(crate) on_device: bool,
+    _data: PhantomData<&'a [u8]>,
+}
+
+impl<'a> NamedWeights<'a> {
+    pub fn host(name: &'a str, dtype: DataType, data: &'a [u8]) -> Self {
+        Self {
+            name,
+            dtype,
+            ptr: data.as_ptr() as usize,
+            count: data.len() / dtype.get_elem_size(),
+            on_device: false,
+            _data: PhantomData,
+        }
+    }
+
+    // Weights already on the GPU, which skips the host-to-device copy (TensorRT 10).
+    pub fn device(name: &'a str, tensor: &'a Tensor) -> Self {
+        Self {
+            name,
+            dtype: tensor.dtype(),
+            ptr: unsafe { tensor.get_raw_ptr() },
+            count: tensor.shape().size(),
+            on_device: true,
+            _data: PhantomData,
+        }
+    }
+
+    pub fn name(&self) -> &str {
+        self.name
+    }
+}
+
+// A memory-mapped weights file, e.g. a raw dump of a fine-tuned checkpoint, from which
+// named weights are sliced without reading the file into the heap first.
+pub struct MappedWeights {
+    mmap: Mmap,
+}
+
+impl MappedWeights {
+    pub fn open<P: AsRef<Path>>(path: &P) -> TRTResult<Self> {
+        let file = File::open(path)?;
+        let mmap = unsafe { Mmap::map(&file)? };
+        mmap.advise(Advice::WillNeed)?;
+        Ok(Self { mmap })
+    }
+
+    // `len` bytes at `offset` holding the weights `name`.
+    pub fn weights<'a>(&'a self, name: &'a str, dtype: DataType, offset: usize, len: usize) -> TRTResult<NamedWeights<'a>> {
+        match offset.checked_add(len) {
+            Some(end) if end <= self.mmap.len() && len % dtype.get_elem_size() == 0 => {
+                Ok(NamedWeights::host(name, dtype, &self.mmap[offset..end]))
+            }
+            _ => Err(TRTError::RefitError(format!("{}: out of bounds of the weights file", name))),
+        }
+    }
+
+    pub fn as_bytes(&self) -> &[u8] {
+        &self.mmap
+    }
+}
+
+// Where one named weight lies in a weights file.
+#[derive(Debug, Clone, PartialEq)]
+pub struct WeightRange {
+    pub name: String,
+    pub dtype: DataType,
+    pub offset: usize,
+    pub len: usize,
+}
+
+// Ranges at least this large are registered with cuFile for the read.
+const GDS_REGISTER_MIN: usize = 16 << 20;
+
+// Named weights read from a weights file into device memory of their own, for
+// TRTEngine::refit of a weight-stripped plan (BuildOptions::strip_weights) or of a new
+// checkpoint. With GPUDirect Storage (the gds feature and the nvidia-fs driver) the reads go
+// from storage to the device without passing through host memory; otherwise the file is
+// mapped and copied up.
+pub struct DeviceWeights {
+    weights: Vec<(String, Tensor)>,
+    direct: bool,
+}
+
+impl DeviceWeights {
+    pub fn load<P: AsRef<Path>>(path: &P, ranges: &[WeightRange], stream: &CuStream) -> TRTResult<Self> {
+        let mut weights = Vec::with_capacity(ranges.len());
+        for range in ranges {
+            if range.len % range.dtype.get_elem_size() != 0 {
+                return Err(TRTError::RefitError(format!("{}: not a whole number of elements", range.name)));
+            }
+            let shape = Shape::new(&[(range.len / range.dtype.get_elem_size()) as i32]);
+            weights.push((range.name.clone(), Tensor::empty(&shape, range.dtype, stream)?));
+        }
+        // cuFile reads are synchronous and not ordered on the stream
+        stream.synchronize()?;
+
+        let file = match gds::is_available() {
+            true => GdsFile::open(path),
+            false => None,
+        };
+        let direct = file.is_some();
+        match file {
+            Some(file) => {
+                for (range, (_, tensor)) in ranges.iter().zip(weights.iter()) {
+                    Self::read_direct(&file, range, tensor)?;
+                }
+            }
+            None => {
+                let mapped = MappedWeights::open(path)?;
+                for (range, (_, tensor)) in ranges.iter().zip(weights.iter()) {
+                    let data = mapped.weights(&range.name, range.dtype, range.offset, range.len)?;
+                    tensor.get_memory().copy_from_raw(data.ptr as _, range.len, Some(stream))?;
+                }
+                stream.synchronize()?;
+            }
+        }
+        Ok(Self { weights, direct })
+    }
+
+    fn read_direct(file: &GdsFile, range: &WeightRange, tensor: &Tensor) -> TRTResult<()> {
+        let out_of_bounds = || TRTError::RefitError(format!("{}: out of bounds of the weights file", range.name));
+        match range.offset.checked_add(range.len) {
+            Some(end) if end <= file.len() => {}
+            _ => return Err(out_of_bounds()),
+        }
+        let ptr = unsafe { tensor.get_raw_ptr() };
+        let _registered = match range.len >= GDS_REGISTER_MIN {
+            true => GdsBuffer::register(ptr, range.len),
+            false => None,
+        };
+        match file.read(ptr, range.len, range.offset) {
+            Some(n) if n == range.len => Ok(()),
+            Some(_) => Err(out_of_bounds()),
+            None => Err(TRTError::RefitError(format!("{}: cuFile read failed", range.name))),
+        }
+    }
+
+    // Whether the weights were read with GPUDirect Storage.
+    pub fn is_direct(&self) -> bool {
+        self.direct
+    }
+
+    pub fn get(&self, name: &str) -> Option<&Tensor> {
+        self.weights.iter().find(|(weight, _)| weight == name).map(|(_, tensor)| tensor)
+    }
+
+    // All of them, to pass to TRTEngine::refit.
+    pub fn named_weights(&self) -> Vec<NamedWeights<'_>> {
+        self.weights.iter().map(|(name, tensor)| NamedWeights::device(name, tensor)).collect()
+    }
+
+    pub fn size(&self) -> usize {
+        self.weights.iter().map(|(_, tensor)| tensor.shape().size() * tensor.dtype().get_elem_size()).sum()
+    }
+}
+
+// Device copies of the weights several engines have in common, e.g. a backbone shared by
+// plans with different heads or profiles, each built weight-stripped: the common weights are
+// read from storage and held once, however many engines are refit from them. TensorRT copies
+// refit weights into the memory of each engine, so the store itself can be dropped once
+// every engine is refit, or kept to refit engines loaded later.
+#[derive(Default)]
+pub struct WeightStore {
+    sets: Vec<DeviceWeights>,
+    // weight name to the set holding it; later sets shadow earlier ones
+    names: HashMap<String, usize>,
+}
+
+impl WeightStore {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    pub fn add(&mut self, weights: DeviceWeights) {
+        let index = self.sets.len();
+        for (name, _) in weights.weights.iter() {
+            self.names.insert(name.clone(), index);
+        }
+        self.sets.push(weights);
+    }
+
+    pub fn load<P: AsRef<Path>>(&mut self, path: &P, ranges: &[WeightRange], stream: &CuStream) -> TRTResult<()> {
+        self.add(DeviceWeights::load(path, ranges, stream)?);
+        Ok(())
+    }
+
+    pub fn get(&self, name: &str) -> Option<&Tensor> {
+        self.names.get(name).and_then(|&index| self.sets[index].get(name))
+    }
+
+    pub fn contains(&self, name: &str) -> bool {
+        self.names.contains_key(name)
+    }
+
+    pub fn size(&self) -> usize {
+        self.sets.iter().map(|set| set.size()).sum()
+    }
+
+    // Refits every refittable weight of `engine` found here, and those of `own` (e.g. the
+    // head of this engine), which take precedence. Returns the number of weights refit from
+    // the store; fails with the names covered by neither.
+    pub fn refit(&self, engine: &mut TRTEngine, own: &[NamedWeights], stream: Option<&CuStream>) -> TRTResult<usize> {
+        let mut weights: Vec<NamedWeights> = Vec::new();
+        let mut missing = Vec::new();
+        let refittable = engine.get_refittable_weights()?;
+        for name in refittable.iter() {
+            if own.iter().any(|weight| weight.name == name.as_str()) {
+                continue;
+            }
+            match self.get(name) {
+                Some(tensor) => weights.push(NamedWeights::device(name, tensor)),
+                None => missing.push(name.as_str()),
+            }
+        }
+        if !missing.is_empty() {
+            return Err(TRTError::RefitError(format!("not in the store: {}", missing.join(", "))));
+        }
+        let shared = weights.len();
+        weights.extend(own.iter().copied());
+        engine.refit(&weights, stream)?;
+        Ok(shared)
+    }
+}
@@ -0,0 +1,287 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use tensorrt_rs_sys::{
+    kernels::{batched_copy, DeviceCopy},
+    memory::{memcpy_2d_async, memcpy_3d_async, memcpy_async, memset_async, MemcpyKind},
+};
+
+// One dim of a box copy, in elements: copied extent, full size of either tensor and the
+// box's offset in either tensor.
+#[derive(Debug, Copy, Clone, PartialEq)]
+struct BoxDim {
+    extent: usize,
+    src_size: usize,
+    dst_size: usize,
+    src_offset: usize,
+    dst_offset: usize,
+}
+
+impl BoxDim {
+    fn is_full(&self) -> bool {
+        self.extent == self.src_size
+            && self.extent == self.dst_size
+            && self.src_offset == 0
+            && self.dst_offset == 0
+    }
+}
+
+// Folds every dim into its outer neighbour while the inner one is copied whole in both
+// tensors, so e.g. padding H and W of NCHW becomes a single [N*C, H, W] copy.
+fn merge_dims(mut dims: Vec<BoxDim>) -> Vec<BoxDim> {
+    let mut i = dims.len();
+    while i >= 2 {
+        i -= 1;
+        if dims[i].is_full() {
+            let inner = dims.remove(i);
+            let outer = &mut dims[i - 1];
+            outer.extent *= inner.extent;
+            outer.src_offset *= inner.src_size;
+            outer.dst_offset *= inner.dst_size;
+            outer.src_size *= inner.src_size;
+            outer.dst_size *= inner.dst_size;
+        }
+    }
+    dims
+}
+
+// Copies the `extent` box at `src_offset` in `src` to `dst_offset` in `dst`, as one
+// cudaMemcpy (contiguous), cudaMemcpy2DAsync or cudaMemcpy3DAsync after merging dims; only
+// boxes that stay above 3D after merging take one 3D copy per outer index.
+pub(crate) fn copy_region(
+    dst: &Tensor,
+    dst_offset: &[usize],
+    src: &Tensor,
+    src_offset: &[usize],
+    extent: &Shape,
+    stream: &CuStream,
+) -> TRTResult<()> {
+    if src.dtype() != dst.dtype() {
+        return Err(TRTError::DTypeMismatch);
+    }
+    let nb_dims = extent.nb_dims();
+    if src.shape().nb_dims() != nb_dims
+        || dst.shape().nb_dims() != nb_dims
+        || src_offset.len() != nb_dims
+        || dst_offset.len() != nb_dims
+    {
+        return Err(TRTError::ShapeMismatch);
+    }
+    let mut dims = Vec::with_capacity(nb_dims.max(1));
+    for i in 0..nb_dims {
+        let dim = BoxDim {
+            extent: extent[i] as usize,
+            src_size: src.shape()[i] as usize,
+            dst_size: dst.shape()[i] as usize,
+            src_offset: src_offset[i],
+            dst_offset: dst_offset[i],
+        };
+        if dim.src_offset + dim.extent > dim.src_size || dim.dst_offset + dim.extent > dim.dst_size {
+            return Err(TRTError::ShapeMismatch);
+        }
+        dims.push(dim);
+    }
+    if extent.size() == 0 {
+        return Ok(());
+    }
+    if dims.is_empty() {
+        dims.push(BoxDim { extent: 1, src_size: 1, dst_size: 1, src_offset: 0, dst_offset: 0 });
+    }
+
+    let dims = merge_dims(dims);
+    let elem_size = src.dtype().get_elem_size();
+    let src_ptr = unsafe { src.get_raw_ptr() };
+    let dst_ptr = unsafe { dst.get_raw_ptr() };
+
+    // the innermost three dims, padded with unit dims
+    let split = dims.len().saturating_sub(3);
+    let (outer, inner) = dims.split_at(split);
+    let unit = BoxDim { extent: 1, src_size: 1, dst_size: 1, src_offset: 0, dst_offset: 0 };
+    let mut box3 = [unit; 3];
+    box3[3 - inner.len()..].copy_from_slice(inner);
+    let [depth, height, width] = box3;
+
+    let src_strides = strides(&dims, |dim| dim.src_size);
+    let dst_strides = strides(&dims, |dim| dim.dst_size);
+
+    let mut index = vec![0usize; outer.len()];
+    loop {
+        let mut src_start = 0;
+        let mut dst_start = 0;
+        for (i, dim) in dims.iter().enumerate() {
+            let idx = index.get(i).copied().unwrap_or(0);
+            src_start += (dim.src_offset + idx) * src_strides[i];
+            dst_start += (dim.dst_offset + idx) * dst_strides[i];
+        }
+        let src_addr = src_ptr + src_start * elem_size;
+        let dst_addr = dst_ptr + dst_start * elem_size;
+
+        let copied = unsafe {
+            if depth.extent == 1 && height.extent == 1 {
+                memcpy_async(dst_addr, src_addr, width.extent * elem_size, MemcpyKind::DeviceToDevice, stream)
+            } else if depth.extent == 1 {
+                memcpy_2d_async(
+                    dst_addr,
+                    width.dst_size * elem_size,
+                    src_addr,
+                    width.src_size * elem_size,
+                    width.extent * elem_size,
+                    height.extent,
+                    MemcpyKind::DeviceToDevice,
+                    stream,
+                )
+            } else {
+                memcpy_3d_async(
+                    dst_addr,
+                    width.dst_size * elem_size,
+                    height.dst_size,
+                    src_addr,
+                    width.src_size * elem_size,
+                    height.src_size,
+                    width.extent * elem_size,
+                    height.extent,
+                    depth.extent,
+                    MemcpyKind::DeviceToDevice,
+                    stream,
+                )
+            }
+        };
+        if !copied {
+            return Err(TRTError::MemcpyError);
+        }
+
+        let mut dim = index.len();
+        loop {
+            if dim == 0 {
+                return Ok(());
+            }
+            dim -= 1;
+            index[dim] += 1;
+            if index[dim] < outer[dim].extent {
+                break;
+            }
+            index[dim] = 0;
+        }
+    }
+}
+
+fn strides<F: Fn(&BoxDim) -> usize>(dims: &[BoxDim], size: F) -> Vec<usize> {
+    let mut strides = vec![1; dims.len()];
+    for i in (0..dims.len().saturating_sub(1)).rev() {
+        strides[i] = strides[i + 1] * size(&dims[i + 1]);
+    }
+    strides
+}
+
+// Zeroes `dst` and copies all of `src` into its origin corner; `dst` may be larger in any dim.
+pub(crate) fn copy_padded(dst: &Tensor, src: &Tensor, stream: &CuStream) -> TRTResult<()> {
+    if src.shape() != dst.shape() && !unsafe { memset_async(dst.get_raw_ptr(), 0, dst.size_in_bytes(), stream) } {
+        return Err(TRTError::MemcpyError);
+    }
+    let origin = vec![0; src.shape().nb_dims()];
+    copy_region(dst, &origin, src, &origin, src.shape(), stream)
+}
+
+// Concatenates `parts` along their leading dim into `whole` with one batched copy instead
+// of a cudaMemcpyAsync per part, and returns the rows copied; the reverse with `scatter`,
+// each part taking as many rows as it has. Parts must agree with `whole` on the dtype and
+// every other dim, and fit in its capacity (gather) or its rows (scatter).
+pub(crate) fn copy_rows(whole: &Tensor, parts: &[&Tensor], scatter: bool, stream: &CuStream) -> TRTResult<usize> {
+    let mut part_dims = Vec::with_capacity(parts.len());
+    for part in parts {
+        if part.dtype() != whole.dtype() {
+            return Err(TRTError::DTypeMismatch);
+        }
+        part_dims.push((unsafe { part.get_raw_ptr() }, part.shape().as_slice()));
+    }
+    let available = match scatter {
+        true => whole.size_in_bytes(),
+        false => whole.capacity() * whole.dtype().get_elem_size(),
+    };
+    let base = unsafe { whole.get_raw_ptr() };
+    let elem_size = whole.dtype().get_elem_size();
+    let (copies, rows) = match row_copies(base, whole.shape(), available, elem_size, &part_dims, scatter) {
+        Some(plan) => plan,
+        None => return Err(TRTError::ShapeMismatch),
+    };
+    match unsafe { batched_copy(&copies, stream) } {
+        true => Ok(rows),
+        false => Err(TRTError::KernelLaunchError),
+    }
+}
+
+// The copies between consecutive rows of the tensor at `base` and each (address, dims)
+// part, and the rows they cover; None when a part does not fit.
+fn row_copies(
+    base: usize,
+    shape: &Shape,
+    available: usize,
+    elem_size: usize,
+    parts: &[(usize, &[i32])],
+    scatter: bool,
+) -> Option<(Vec<DeviceCopy>, usize)> {
+    let row_dims = shape.get(1..)?;
+    let (mut copies, mut offset, mut rows) = (Vec::with_capacity(parts.len()), 0, 0);
+    for &(ptr, dims) in parts {
+        let (&part_rows, part_row_dims) = dims.split_first()?;
+        if part_row_dims != row_dims || part_rows < 0 {
+            return None;
+        }
+        let size = dims.iter().map(|&dim| dim as usize).product::<usize>() * elem_size;
+        if offset + size > available {
+            return None;
+        }
+        let (src, dst) = match scatter {
+            true => (base + offset, ptr),
+            false => (ptr, base + offset),
+        };
+        if size > 0 {
+            copies.push(DeviceCopy { src, dst, size });
+        }
+        offset += size;
+        rows += part_rows as usize;
+    }
+    Some((copies, rows))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn dim(extent: usize, src_size: usize, dst_size: usize) -> BoxDim {
+        BoxDim { extent, src_size, dst_size, src_offset: 0, dst_offset: 0 }
+    }
+
+    #[test]
+    fn rows_are_gathered_back_to_back() {
+        let (whole, parts) = (Shape::new(&[0, 3]), [(100, &[2, 3][..]), (200, &[1, 3][..])]);
+        let (copies, rows) = row_copies(1000, &whole, 64, 4, &parts, false).unwrap();
+        assert_eq!(rows, 3);
+        let expected = vec![DeviceCopy { src: 100, dst: 1000, size: 24 }, DeviceCopy { src: 200, dst: 1024, size: 12 }];
+        assert_eq!(copies, expected);
+        assert_eq!(row_copies(1000, &whole, 32, 4, &parts, false), None);
+        assert_eq!(row_copies(1000, &whole, 64, 4, &[(100, &[2, 4][..])], true), None);
+    }
+
+    #[test]
+    fn merge_padded_nchw() {
+        // [2, 3, 100, 64] into [2, 3, 128, 128]
+        let dims = vec![dim(2, 2, 2), dim(3, 3, 3), dim(100, 100, 128), dim(64, 64, 128)];
+        let merged = merge_dims(dims);
+        assert_eq!(merged, vec![dim(6, 6, 6), dim(100, 100, 128), dim(64, 64, 128)]);
+    }
+
+    #[test]
+    fn merge_batch_row() {
+        // one [1, 3, 224, 224] request into row 5 of a [8, 3, 224, 224] batch
+        let mut row = dim(1, 1, 8);
+        row.dst_offset = 5;
+        let dims = vec![row, dim(3, 3, 3), dim(224, 224, 224), dim(224, 224, 224)];
+        let merged = merge_dims(dims);
+        assert_eq!(merged.len(), 1);
+        assert_eq!(merged[0].extent, 3 * 224 * 224);
+        assert_eq!(merged[0].dst_offset, 5 * 3 * 224 * 224);
+    }
+}
@@ -0,0 +1,326 @@
+use crate::{
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    plan::{PlanFile, PlanLoadOptions},
+    plan_info::PlanInfo,
+    prefetch::PlanPrefetcher,
+    tensor::Shape,
+};
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use std::{
+    collections::HashMap,
+    path::{Path, PathBuf},
+    sync::Arc,
+};
+use tensorrt_rs_sys::device;
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum EvictionPolicy {
+    // Least recently used first.
+    Lru,
+    // Least frequently used first, least recently used among equals.
+    Lfu,
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct ResidencyOptions {
+    pub device: i32,
+    // Device memory the resident engines may hold in total: weights, context memory and IO
+    // tensors.
+    pub memory_budget: usize,
+    pub policy: EvictionPolicy,
+    pub plan: PlanLoadOptions,
+}
+
+impl Default for ResidencyOptions {
+    fn default() -> Self {
+        Self {
+            device: 0,
+            memory_budget: usize::MAX,
+            policy: EvictionPolicy::Lru,
+            plan: PlanLoadOptions { will_need: false, ..PlanLoadOptions::default() },
+        }
+    }
+}
+
+#[derive(Debug, Copy, Clone, Default, PartialEq)]
+struct Usage {
+    resident: bool,
+    // device memory of the engine once loaded; the plan size until it first is
+    footprint: usize,
+    last_used: u64,
+    uses: u64,
+}
+
+struct Model {
+    path: PathBuf,
+    plan: PlanFile,
+    info: Option<PlanInfo>,
+    max_shapes: HashMap<String, Shape>,
+    engine: Option<TRTEngine>,
+    usage: Usage,
+}
+
+// Many models on one device, only some of them resident. Plans stay memory-mapped, engines
+// are deserialized, activated and allocated on first use, and cold engines are dropped,
+// freeing their context, device memory and IO tensors, to keep the resident ones within
+// the memory budget. Use it from threads with the device current, as evicted engines are
+// freed by the thread that evicts them.
+pub struct ModelManager {
+    options: ResidencyOptions,
+    models: Vec<Model>,
+    names: HashMap<String, usize>,
+    clock: u64,
+    prefetcher: Option<Arc<PlanPrefetcher>>,
+}
+
+impl ModelManager {
+    pub fn new(options: ResidencyOptions) -> Self {
+        Self { options, models: Vec::new(), names: HashMap::new(), clock: 0, prefetcher: None }
+    }
+
+    // Warms the page cache with the plans of predicted models (see warm_predicted and
+    // prefetch_predicted), so loading them is not bound by page faults on cold storage.
+    pub fn set_prefetcher(&mut self, prefetcher: Option<Arc<PlanPrefetcher>>) {
+        self.prefetcher = prefetcher;
+    }
+
+    // Maps the plan; nothing is read or deserialized until the model is used. An empty
+    // `max_shapes` sizes the IO tensors from the max shapes of profile 0. The footprint is
+    // estimated from the plan's PlanInfo sidecar if it has one, and from its size if not.
+    pub fn register<P: AsRef<Path>>(
+        &mut self,
+        name: &str,
+        path: &P,
+        max_shapes: &HashMap<&str, &Shape>,
+    ) -> TRTResult<()> {
+        let plan = PlanFile::open(path, &self.options.plan)?;
+        let info = PlanInfo::load(path);
+        let footprint = info.as_ref().map_or(plan.len(), |info| info.footprint());
+        let usage = Usage { footprint, ..Usage::default() };
+        let model = Model {
+            path: path.as_ref().to_path_buf(),
+            plan,
+            info,
+            max_shapes: max_shapes.iter().map(|(name, shape)| (name.to_string(), **shape)).collect(),
+            engine: None,
+            usage,
+        };
+        match self.names.get(name) {
+            Some(&index) => self.models[index] = model,
+            None => {
+                self.names.insert(name.to_string(), self.models.len());
+                self.models.push(model);
+            }
+        }
+        Ok(())
+    }
+
+    // The engine of `name`, loaded first if it is not resident.
+    pub fn acquire(&mut self, name: &str) -> TRTResult<&mut TRTEngine> {
+        let index = self.index(name)?;
+        self.make_resident(index)?;
+        self.clock += 1;
+        let model = &mut self.models[index];
+        model.usage.last_used = self.clock;
+        model.usage.uses += 1;
+        Ok(model.engine.as_mut().unwrap())
+    }
+
+    // Loads `name` ahead of its use, e.g. on predicted demand. It does not count as a use.
+    pub fn prefetch(&mut self, name: &str) -> TRTResult<()> {
+        let index = self.index(name)?;
+        self.make_resident(index)
+    }
+
+    // Prefetches the most used models that are not resident, as long as they fit next to the
+    // resident ones without evicting any. Returns how many were loaded.
+    pub fn prefetch_predicted(&mut self, max_models: usize) -> TRTResult<usize> {
+        let budget = self.options.memory_budget;
+        let mut loaded = 0;
+        // the next plans are read from storage while the first ones deserialize
+        let indices = predicted(&self.usages(), max_models);
+        self.warm(&indices);
+        for index in indices {
+            if self.resident_bytes() + self.models[index].usage.footprint > budget {
+                continue;
+            }
+            self.make_resident(index)?;
+            loaded += 1;
+        }
+        Ok(loaded)
+    }
+
+    // Only warms the plans of the models prefetch_predicted would load, without taking device
+    // memory. Returns how many were queued on the prefetcher; none without one.
+    pub fn warm_predicted(&self, max_models: usize) -> usize {
+        self.warm(&predicted(&self.usages(), max_models))
+    }
+
+    fn warm(&self, indices: &[usize]) -> usize {
+        match self.prefetcher.as_ref() {
+            Some(prefetcher) => {
+                indices.iter().for_each(|&index| prefetcher.prefetch(&self.models[index].path));
+                indices.len()
+            }
+            None => 0,
+        }
+    }
+
+    pub fn evict(&mut self, name: &str) -> TRTResult<()> {
+        let index = self.index(name)?;
+        self.unload(index);
+        Ok(())
+    }
+
+    // What is known about `name` without loading it: from its sidecar, or from its engine
+    // once loaded.
+    pub fn plan_info(&self, name: &str) -> Option<&PlanInfo> {
+        self.models[*self.names.get(name)?].info.as_ref()
+    }
+
+    pub fn is_resident(&self, name: &str) -> bool {
+        self.names.get(name).map_or(false, |&index| self.models[index].usage.resident)
+    }
+
+    pub fn num_resident(&self) -> usize {
+        self.models.iter().filter(|model| model.usage.resident).count()
+    }
+
+    pub fn resident_bytes(&self) -> usize {
+        resident_bytes(&self.usages())
+    }
+
+    fn index(&self, name: &str) -> TRTResult<usize> {
+        match self.names.get(name) {
+            Some(&index) => Ok(index),
+            None => Err(TRTError::UnknownModel(name.to_string())),
+        }
+    }
+
+    fn usages(&self) -> Vec<Usage> {
+        self.models.iter().map(|model| model.usage).collect()
+    }
+
+    fn make_resident(&mut self, index: usize) -> TRTResult<()> {
+        if self.models[index].usage.resident {
+            return Ok(());
+        }
+        let budget = self.options.memory_budget;
+        let footprint = self.models[index].usage.footprint;
+        while let Some(victim) = victim(&self.usages(), self.options.policy, budget.saturating_sub(footprint), index) {
+            self.unload(victim);
+        }
+
+        // the estimate may be low, or other processes hold memory: retry after evicting more
+        loop {
+            match self.load(index) {
+                Ok(()) => break,
+                Err(err) => match victim(&self.usages(), self.options.policy, 0, index) {
+                    Some(victim) => self.unload(victim),
+                    None => return Err(err),
+                },
+            }
+        }
+
+        // the measured footprint may exceed the budget now
+        while let Some(victim) = victim(&self.usages(), self.options.policy, budget, index) {
+            self.unload(victim);
+        }
+        Ok(())
+    }
+
+    fn load(&mut self, index: usize) -> TRTResult<()> {
+        let cu_device = CuDevice::new(self.options.device)?;
+        let ctx = cu_device.retain_primary_context()?;
+        let _guard = ctx.guard()?;
+        let stream = CuStream::new()?;
+
+        let model = &mut self.models[index];
+        let free_before = device::get_mem_info().map(|(free, _)| free);
+        let mut engine = TRTEngine::from_plan(&model.plan, &stream)?;
+        model.plan.release()?;
+        if model.info.is_none() {
+            let info = PlanInfo::from_engine(&engine)?;
+            info.save(&model.path).ok();
+            model.info = Some(info);
+        }
+        engine.activate()?;
+        let max_shapes: HashMap<&str, &Shape> =
+            model.max_shapes.iter().map(|(name, shape)| (name.as_str(), shape)).collect();
+        engine.allocate_io_tensors(&max_shapes, None)?;
+        stream.synchronize()?;
+
+        if let (Some(before), Some((after, _))) = (free_before, device::get_mem_info()) {
+            model.usage.footprint = before.saturating_sub(after).max(engine.get_device_memory_size()?);
+        }
+        model.engine = Some(engine);
+        model.usage.resident = true;
+        Ok(())
+    }
+
+    fn unload(&mut self, index: usize) {
+        let model = &mut self.models[index];
+        if model.engine.take().is_some() {
+            model.usage.resident = false;
+        }
+    }
+}
+
+fn resident_bytes(usages: &[Usage]) -> usize {
+    usages.iter().filter(|usage| usage.resident).map(|usage| usage.footprint).sum()
+}
+
+// The resident model to evict while the resident models hold more than `limit` bytes,
+// never `keep`.
+fn victim(usages: &[Usage], policy: EvictionPolicy, limit: usize, keep: usize) -> Option<usize> {
+    if resident_bytes(usages) <= limit {
+        return None;
+    }
+    let candidates = usages.iter().enumerate().filter(|(index, usage)| usage.resident && *index != keep);
+    match policy {
+        EvictionPolicy::Lru => candidates.min_by_key(|(_, usage)| usage.last_used),
+        EvictionPolicy::Lfu => candidates.min_by_key(|(_, usage)| (usage.uses, usage.last_used)),
+    }
+    .map(|(index, _)| index)
+}
+
+// Models used before but not resident, most used first.
+fn predicted(usages: &[Usage], max_models: usize) -> Vec<usize> {
+    let mut cold: Vec<usize> = (0..usages.len()).filter(|&i| !usages[i].resident && usages[i].uses > 0).collect();
+    cold.sort_by_key(|&i| (std::cmp::Reverse(usages[i].uses), std::cmp::Reverse(usages[i].last_used)));
+    cold.truncate(max_models);
+    cold
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn usage(resident: bool, footprint: usize, last_used: u64, uses: u64) -> Usage {
+        Usage { resident, footprint, last_used, uses }
+    }
+
+    #[test]
+    fn lru_evicts_least_recent() {
+        let usages = [usage(true, 4, 3, 1), usage(true, 4, 1, 9), usage(false, 4, 0, 0)];
+        assert_eq!(victim(&usages, EvictionPolicy::Lru, 4, 2), Some(1));
+        // within the limit
+        assert_eq!(victim(&usages, EvictionPolicy::Lru, 8, 2), None);
+        // the model being loaded is never evicted
+        assert_eq!(victim(&usages, EvictionPolicy::Lru, 4, 1), Some(0));
+    }
+
+    #[test]
+    fn lfu_evicts_least_used() {
+        let usages = [usage(true, 4, 3, 1), usage(true, 4, 1, 9), usage(true, 4, 2, 1)];
+        assert_eq!(victim(&usages, EvictionPolicy::Lfu, 8, 1), Some(2));
+    }
+
+    #[test]
+    fn predicts_most_used_cold_models() {
+        let usages = [usage(false, 4, 3, 2), usage(true, 4, 5, 9), usage(false, 4, 1, 0), usage(false, 4, 4, 7)];
+        assert_eq!(predicted(&usages, 4), vec![3, 0]);
+        assert_eq!(predicted(&usages, 1), vec![3]);
+    }
+}
@@ -0,0 +1,351 @@
+use crate::{
+    batcher::{BatchInput, BatchOutput},
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::{BTreeMap, HashMap},
+    mem::size_of,
+    sync::{Arc, Mutex},
+};
+use tensorrt_rs_sys::memory::{memcpy_async, MemcpyKind};
+
+const K0: u64 = 0x9e37_79b9_7f4a_7c15;
+const K1: u64 = 0xc2b2_ae3d_27d4_eb4f;
+
+// 128 bits of the input names, shapes and bytes; collisions are not checked for.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+struct CacheKey(u64, u64);
+
+struct KeyHasher {
+    a: u64,
+    b: u64,
+}
+
+impl KeyHasher {
+    fn new() -> Self {
+        Self { a: K0, b: K1 }
+    }
+
+    // Eight bytes per step; the length is mixed in, so inputs differing only in trailing
+    // zeros hash differently.
+    fn write(&mut self, bytes: &[u8]) {
+        let mut words = bytes.chunks_exact(8);
+        for word in &mut words {
+            self.mix(u64::from_le_bytes(word.try_into().unwrap()));
+        }
+        let rest = words.remainder();
+        if !rest.is_empty() {
+            let mut word = [0u8; 8];
+            word[..rest.len()].copy_from_slice(rest);
+            self.mix(u64::from_le_bytes(word));
+        }
+        self.mix(bytes.len() as u64);
+    }
+
+    fn mix(&mut self, word: u64) {
+        self.a = (self.a ^ word).wrapping_mul(K1).rotate_left(31);
+        self.b = (self.b.rotate_left(27) ^ word).wrapping_mul(K0).wrapping_add(self.a);
+    }
+
+    fn finish(self) -> CacheKey {
+        CacheKey(avalanche(self.a ^ self.b.rotate_left(17)), avalanche(self.b ^ self.a))
+    }
+}
+
+fn avalanche(mut h: u64) -> u64 {
+    h ^= h >> 33;
+    h = h.wrapping_mul(0xff51_afd7_ed55_8ccd);
+    h ^= h >> 33;
+    h = h.wrapping_mul(0xc4ce_b9fe_1a85_ec53);
+    h ^ (h >> 33)
+}
+
+fn key_of(inputs: &[BatchInput]) -> CacheKey {
+    let mut hasher = KeyHasher::new();
+    for input in inputs {
+        hasher.write(input.name.as_bytes());
+        for &dim in input.shape.iter() {
+            hasher.mix(dim as u64);
+        }
+        hasher.write(&input.data);
+    }
+    hasher.finish()
+}
+
+fn entry_bytes(outputs: &[BatchOutput]) -> usize {
+    outputs.iter().map(|output| size_of::<BatchOutput>() + output.name.len() + output.data.len()).sum()
+}
+
+#[derive(Debug, Copy, Clone, Default, PartialEq, Eq)]
+pub struct ResultCacheStats {
+    pub hits: u64,
+    pub misses: u64,
+    pub evictions: u64,
+    // flushes because the engine was refit, or the cache was used with another engine
+    pub invalidations: u64,
+    pub entries: usize,
+    pub bytes: usize,
+}
+
+struct Entry {
+    outputs: Arc<Vec<BatchOutput>>,
+    bytes: usize,
+    last_used: u64,
+}
+
+#[derive(Default)]
+struct State {
+    entries: HashMap<CacheKey, Entry>,
+    // last use to key, oldest first
+    lru: BTreeMap<u64, CacheKey>,
+    clock: u64,
+    // id and refit generation of the engine core the entries were computed with
+    owner: Option<(u64, u64)>,
+    stats: ResultCacheStats,
+}
+
+impl State {
+    fn check_owner(&mut self, owner: (u64, u64)) {
+        if self.owner != Some(owner) {
+            if !self.entries.is_empty() {
+                self.stats.invalidations += 1;
+            }
+            self.clear();
+            self.owner = Some(owner);
+        }
+    }
+
+    fn clear(&mut self) {
+        self.entries.clear();
+        self.lru.clear();
+        self.stats.entries = 0;
+        self.stats.bytes = 0;
+    }
+
+    fn touch(&mut self, key: CacheKey) -> Option<Arc<Vec<BatchOutput>>> {
+        self.clock += 1;
+        let clock = self.clock;
+        let entry = self.entries.get_mut(&key)?;
+        self.lru.remove(&entry.last_used);
+        entry.last_used = clock;
+        self.lru.insert(clock, key);
+        Some(entry.outputs.clone())
+    }
+
+    fn insert(&mut self, key: CacheKey, outputs: Arc<Vec<BatchOutput>>, capacity: usize) {
+        let bytes = entry_bytes(&outputs);
+        if bytes > capacity {
+            return;
+        }
+        if let Some(old) = self.entries.remove(&key) {
+            self.lru.remove(&old.last_used);
+            self.stats.bytes -= old.bytes;
+        }
+        while self.stats.bytes + bytes > capacity {
+            let (_, oldest) = match self.lru.pop_first() {
+                Some(oldest) => oldest,
+                None => break,
+            };
+            let evicted = self.entries.remove(&oldest).unwrap();
+            self.stats.bytes -= evicted.bytes;
+            self.stats.evictions += 1;
+        }
+        self.clock += 1;
+        self.lru.insert(self.clock, key);
+        self.entries.insert(key, Entry { outputs, bytes, last_used: self.clock });
+        self.stats.bytes += bytes;
+        self.stats.entries = self.entries.len();
+    }
+}
+
+// Host copies of the outputs of deterministic engines (e.g. embedding encoders), keyed by a
+// hash of the inputs, so repeated requests skip the device entirely. Bounded to `capacity`
+// bytes of outputs, least recently used evicted first. The entries belong to one engine and
+// its weights: using the cache with another engine, or after a refit of its engine (by any
+// context sharing it), flushes it. Share one cache between the contexts of an EnginePool.
+pub struct ResultCache {
+    capacity: usize,
+    state: Mutex<State>,
+}
+
+impl ResultCache {
+    pub fn new(capacity: usize) -> Arc<Self> {
+        Arc::new(Self { capacity, state: Mutex::new(State::default()) })
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    pub fn stats(&self) -> ResultCacheStats {
+        self.state.lock().unwrap().stats
+    }
+
+    pub fn clear(&self) {
+        self.state.lock().unwrap().clear();
+    }
+
+    fn get(&self, owner: (u64, u64), key: CacheKey) -> Option<Arc<Vec<BatchOutput>>> {
+        let mut state = self.state.lock().unwrap();
+        state.check_owner(owner);
+        let outputs = state.touch(key);
+        if outputs.is_some() {
+            state.stats.hits += 1;
+        } else {
+            state.stats.misses += 1;
+        }
+        outputs
+    }
+
+    fn insert(&self, owner: (u64, u64), key: CacheKey, outputs: Arc<Vec<BatchOutput>>) {
+        let mut state = self.state.lock().unwrap();
+        // refit while the request ran: its outputs may be of either weights
+        if state.owner != Some(owner) {
+            return;
+        }
+        state.insert(key, outputs, self.capacity);
+    }
+}
+
+impl TRTEngine {
+    // Inference on host inputs through `cache`: a hit returns the cached outputs without
+    // touching the device; a miss copies the inputs into the engine-owned buffers (see
+    // allocate_io_tensors), runs the engine on `stream` and synchronizes it, and caches the
+    // outputs read back. Only for engines whose outputs depend on nothing but the inputs.
+    pub fn inference_cached(
+        &mut self,
+        cache: &ResultCache,
+        inputs: &[BatchInput],
+        stream: Option<&CuStream>,
+    ) -> TRTResult<Arc<Vec<BatchOutput>>> {
+        let core = self.core()?;
+        let owner = (core.id(), core.generation());
+        let key = key_of(inputs);
+        if let Some(outputs) = cache.get(owner, key) {
+            return Ok(outputs);
+        }
+
+        let stream = match stream {
+            Some(stream) => stream.clone(),
+            None => self.get_stream().clone(),
+        };
+        for input in inputs {
+            self.reserve_tensor(&input.name, input.shape.size())?;
+            let tensor = match self.get_tensor(&input.name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(input.name.clone())),
+            };
+            if input.data.len() != input.shape.size() * tensor.dtype().get_elem_size() {
+                return Err(TRTError::ShapeMismatch);
+            }
+            let copied = unsafe {
+                memcpy_async(
+                    tensor.get_raw_ptr(),
+                    input.data.as_ptr() as usize,
+                    input.data.len(),
+                    MemcpyKind::HostToDevice,
+                    &stream,
+                )
+            };
+            if !copied {
+                return Err(TRTError::MemcpyError);
+            }
+            self.set_input_shape(&input.name, &input.shape)?;
+        }
+
+        self.execute(Some(&stream))?;
+
+        let mut outputs = Vec::with_capacity(self.output_names().len());
+        for name in self.output_names() {
+            let shape = self.get_tensor_shape(name)?;
+            let tensor = match self.get_tensor(name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name.clone())),
+            };
+            let mut data = vec![0u8; shape.size() * tensor.dtype().get_elem_size()];
+            let copied = unsafe {
+                memcpy_async(
+                    data.as_mut_ptr() as usize,
+                    tensor.get_raw_ptr(),
+                    data.len(),
+                    MemcpyKind::DeviceToHost,
+                    &stream,
+                )
+            };
+            if !copied {
+                stream.synchronize()?;
+                return Err(TRTError::MemcpyError);
+            }
+            outputs.push(BatchOutput { name: name.clone(), shape, data });
+        }
+        // the host buffers above are only valid to read once the copies have landed
+        self.synchronize_checked(Some(&stream))?;
+
+        let outputs = Arc::new(outputs);
+        cache.insert(owner, key, outputs.clone());
+        Ok(outputs)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::tensor::Shape;
+
+    fn input(name: &str, dims: &[i32], data: &[u8]) -> BatchInput {
+        BatchInput::host(name, Shape::new(dims), data.to_vec())
+    }
+
+    fn outputs(size: usize) -> Arc<Vec<BatchOutput>> {
+        Arc::new(vec![BatchOutput { name: String::new(), shape: Shape::new(&[size as i32]), data: vec![0; size] }])
+    }
+
+    #[test]
+    fn keys_cover_names_shapes_and_bytes() {
+        let key = key_of(&[input("images", &[1, 3], &[1, 2, 3])]);
+        assert_eq!(key, key_of(&[input("images", &[1, 3], &[1, 2, 3])]));
+        assert_ne!(key, key_of(&[input("pixels", &[1, 3], &[1, 2, 3])]));
+        assert_ne!(key, key_of(&[input("images", &[3, 1], &[1, 2, 3])]));
+        assert_ne!(key, key_of(&[input("images", &[1, 3], &[1, 2, 4])]));
+        assert_ne!(key, key_of(&[input("images", &[1, 3], &[1, 2, 3, 0])]));
+    }
+
+    #[test]
+    fn evicts_least_recently_used_within_capacity() {
+        let entry = entry_bytes(&outputs(100));
+        let cache = ResultCache::new(2 * entry);
+        let owner = (1, 0);
+        let (a, b, c) = (CacheKey(1, 0), CacheKey(2, 0), CacheKey(3, 0));
+        assert!(cache.get(owner, a).is_none());
+        cache.insert(owner, a, outputs(100));
+        cache.insert(owner, b, outputs(100));
+        assert!(cache.get(owner, a).is_some());
+        cache.insert(owner, c, outputs(100));
+        assert!(cache.get(owner, b).is_none());
+        assert!(cache.get(owner, a).is_some());
+
+        let stats = cache.stats();
+        assert_eq!((stats.entries, stats.bytes, stats.evictions), (2, 2 * entry, 1));
+        assert_eq!((stats.hits, stats.misses), (2, 2));
+
+        // larger than the whole cache
+        cache.insert(owner, b, outputs(1000));
+        assert!(cache.get(owner, b).is_none());
+    }
+
+    #[test]
+    fn refit_invalidates() {
+        let cache = ResultCache::new(1 << 20);
+        let key = CacheKey(1, 0);
+        cache.get((1, 0), key);
+        cache.insert((1, 0), key, outputs(10));
+        assert!(cache.get((1, 0), key).is_some());
+        assert!(cache.get((1, 1), key).is_none());
+        // computed before the refit
+        cache.insert((1, 0), key, outputs(10));
+        assert!(cache.get((1, 1), key).is_none());
+        assert_eq!(cache.stats().invalidations, 1);
+    }
+}
@@ -0,0 +1,289 @@
+use std::{
+    cell::UnsafeCell,
+    hint,
+    mem::MaybeUninit,
+    ops::Deref,
+    sync::{
+        atomic::{fence, AtomicBool, AtomicUsize, Ordering},
+        Arc, Mutex,
+    },
+    thread::{self, Thread},
+    time::{Duration, Instant},
+};
+
+// Keeps the producer and consumer indices on separate cache lines (two, for the adjacent
+// line prefetcher), so producers do not invalidate the line the consumer polls.
+#[repr(align(128))]
+struct Padded<T>(T);
+
+impl<T> Deref for Padded<T> {
+    type Target = T;
+
+    fn deref(&self) -> &T {
+        &self.0
+    }
+}
+
+struct Slot<T> {
+    // position + 1 once written, position + capacity once read
+    sequence: AtomicUsize,
+    value: UnsafeCell<MaybeUninit<T>>,
+}
+
+struct Ring<T> {
+    tail: Padded<AtomicUsize>,
+    head: Padded<AtomicUsize>,
+    sleeping: Padded<AtomicBool>,
+    closed: AtomicBool,
+    consumer: Mutex<Option<Thread>>,
+    slots: Box<[Slot<T>]>,
+    mask: usize,
+}
+
+unsafe impl<T: Send> Send for Ring<T> {}
+unsafe impl<T: Send> Sync for Ring<T> {}
+
+impl<T> Ring<T> {
+    fn is_ready(&self, head: usize) -> bool {
+        self.slots[head & self.mask].sequence.load(Ordering::Acquire) == head + 1
+    }
+
+    // Only when the consumer parked itself; the common push costs no lock and no syscall.
+    fn wake(&self) {
+        fence(Ordering::SeqCst);
+        if self.sleeping.load(Ordering::Relaxed) && self.sleeping.swap(false, Ordering::AcqRel) {
+            if let Some(consumer) = self.consumer.lock().unwrap().as_ref() {
+                consumer.unpark();
+            }
+        }
+    }
+}
+
+impl<T> Drop for Ring<T> {
+    fn drop(&mut self) {
+        let mut head = *self.head.0.get_mut();
+        while self.is_ready(head) {
+            unsafe { self.slots[head & self.mask].value.get_mut().assume_init_drop() };
+            head += 1;
+        }
+    }
+}
+
+// A bounded lock-free handoff from any number of request threads to the one thread that
+// launches their work (Vyukov's bounded queue, single consumer). Producers claim a slot with
+// one CAS on the tail and publish it through the slot's sequence; the consumer takes runs
+// of slots with a single store of the head. Capacity is rounded up to a power of two.
+pub fn submission_ring<T>(capacity: usize) -> (RingSender<T>, RingReceiver<T>) {
+    let capacity = capacity.max(2).next_power_of_two();
+    let slots = (0..capacity)
+        .map(|i| Slot { sequence: AtomicUsize::new(i), value: UnsafeCell::new(MaybeUninit::uninit()) })
+        .collect();
+    let ring = Arc::new(Ring {
+        tail: Padded(AtomicUsize::new(0)),
+        head: Padded(AtomicUsize::new(0)),
+        sleeping: Padded(AtomicBool::new(false)),
+        closed: AtomicBool::new(false),
+        consumer: Mutex::new(None),
+        slots,
+        mask: capacity - 1,
+    });
+    (RingSender { ring: ring.clone() }, RingReceiver { ring })
+}
+
+pub struct RingSender<T> {
+    ring: Arc<Ring<T>>,
+}
+
+impl<T> Clone for RingSender<T> {
+    fn clone(&self) -> Self {
+        Self { ring: self.ring.clone() }
+    }
+}
+
+impl<T> RingSender<T> {
+    // Fails with the value when the ring is full.
+    pub fn push(&self, value: T) -> Result<(), T> {
+        let ring = &*self.ring;
+        let mut tail = ring.tail.load(Ordering::Relaxed);
+        loop {
+            let slot = &ring.slots[tail & ring.mask];
+            let sequence = slot.sequence.load(Ordering::Acquire);
+            match sequence.wrapping_sub(tail) as isize {
+                0 => match ring.tail.compare_exchange_weak(tail, tail + 1, Ordering::Relaxed, Ordering::Relaxed) {
+                    Ok(_) => {
+                        unsafe { (*slot.value.get()).write(value) };
+                        slot.sequence.store(tail + 1, Ordering::Release);
+                        ring.wake();
+                        return Ok(());
+                    }
+                    Err(current) => tail = current,
+                },
+                // the slot still holds the value of the previous lap
+                distance if distance < 0 => return Err(value),
+                // another producer claimed it first
+                _ => tail = ring.tail.load(Ordering::Relaxed),
+            }
+        }
+    }
+
+    // Tells the receiver no more values are coming; pushes still succeed, but a receiver
+    // that saw the ring closed and empty may never read them.
+    pub fn close(&self) {
+        self.ring.closed.store(true, Ordering::SeqCst);
+        self.ring.sleeping.store(true, Ordering::Relaxed);
+        self.ring.wake();
+    }
+
+    pub fn is_closed(&self) -> bool {
+        self.ring.closed.load(Ordering::Acquire)
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.ring.slots.len()
+    }
+}
+
+pub struct RingReceiver<T> {
+    ring: Arc<Ring<T>>,
+}
+
+impl<T> RingReceiver<T> {
+    pub fn pop(&mut self) -> Option<T> {
+        let ring = &*self.ring;
+        let head = ring.head.load(Ordering::Relaxed);
+        if !ring.is_ready(head) {
+            return None;
+        }
+        let value = self.take(head);
+        ring.head.store(head + 1, Ordering::Release);
+        Some(value)
+    }
+
+    // Appends up to `max` values to `values`; the number appended.
+    pub fn pop_batch(&mut self, values: &mut Vec<T>, max: usize) -> usize {
+        let ring = &*self.ring;
+        let start = ring.head.load(Ordering::Relaxed);
+        let mut head = start;
+        while head - start < max && ring.is_ready(head) {
+            values.push(self.take(head));
+            head += 1;
+        }
+        ring.head.store(head, Ordering::Release);
+        head - start
+    }
+
+    pub fn is_empty(&self) -> bool {
+        !self.ring.is_ready(self.ring.head.load(Ordering::Relaxed))
+    }
+
+    pub fn is_closed(&self) -> bool {
+        self.ring.closed.load(Ordering::Acquire)
+    }
+
+    pub fn capacity(&self) -> usize {
+        self.ring.slots.len()
+    }
+
+    // Parks until a value is pushed, the ring is closed or `timeout` passes; may return
+    // spuriously.
+    pub fn wait(&mut self, timeout: Option<Duration>) {
+        let ring = &*self.ring;
+        {
+            let mut consumer = ring.consumer.lock().unwrap();
+            if consumer.as_ref().map_or(true, |consumer| consumer.id() != thread::current().id()) {
+                *consumer = Some(thread::current());
+            }
+        }
+        ring.sleeping.store(true, Ordering::Relaxed);
+        fence(Ordering::SeqCst);
+        if self.is_empty() && !self.is_closed() {
+            match timeout {
+                Some(timeout) => thread::park_timeout(timeout),
+                None => thread::park(),
+            }
+        }
+        ring.sleeping.store(false, Ordering::Relaxed);
+    }
+
+    // As wait, but spinning instead of parking; for consumers on cores of their own.
+    pub fn spin(&self, timeout: Option<Duration>) {
+        let deadline = timeout.map(|timeout| Instant::now() + timeout);
+        while self.is_empty() && !self.is_closed() {
+            if deadline.map_or(false, |deadline| Instant::now() >= deadline) {
+                return;
+            }
+            hint::spin_loop();
+        }
+    }
+
+    fn take(&self, head: usize) -> T {
+        let ring = &*self.ring;
+        let slot = &ring.slots[head & ring.mask];
+        let value = unsafe { (*slot.value.get()).assume_init_read() };
+        slot.sequence.store(head + ring.slots.len(), Ordering::Release);
+        value
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn fills_wraps_and_drains_in_order() {
+        let (sender, mut receiver) = submission_ring(3);
+        assert_eq!(sender.capacity(), 4);
+        for lap in 0..3 {
+            for i in 0..4 {
+                assert!(sender.push(lap * 4 + i).is_ok());
+            }
+            assert_eq!(sender.push(99), Err(99));
+            assert_eq!(receiver.pop(), Some(lap * 4));
+            let mut values = Vec::new();
+            assert_eq!(receiver.pop_batch(&mut values, 8), 3);
+            assert_eq!(values, vec![lap * 4 + 1, lap * 4 + 2, lap * 4 + 3]);
+            assert!(receiver.is_empty());
+        }
+    }
+
+    #[test]
+    fn many_producers_one_consumer() {
+        let (sender, mut receiver) = submission_ring(64);
+        let producers: Vec<_> = (0..4u64)
+            .map(|p| {
+                let sender = sender.clone();
+                thread::spawn(move || {
+                    for i in 0..10_000 {
+                        let mut value = p * 10_000 + i;
+                        while let Err(back) = sender.push(value) {
+                            value = back;
+                            thread::yield_now();
+                        }
+                    }
+                })
+            })
+            .collect();
+        let (mut count, mut sum, mut values) = (0, 0, Vec::new());
+        while count < 40_000 {
+            values.clear();
+            if receiver.pop_batch(&mut values, 16) == 0 {
+                receiver.wait(Some(Duration::from_millis(1)));
+            }
+            count += values.len();
+            sum += values.iter().sum::<u64>();
+        }
+        producers.into_iter().for_each(|producer| producer.join().unwrap());
+        assert_eq!(sum, (0..40_000).sum());
+        assert!(receiver.is_empty());
+    }
+
+    #[test]
+    fn unread_values_are_dropped() {
+        let value = Arc::new(());
+        let (sender, receiver) = submission_ring(4);
+        sender.push(value.clone()).unwrap();
+        sender.push(value.clone()).unwrap();
+        drop((sender, receiver));
+        assert_eq!(Arc::strong_count(&value), 1);
+    }
+}
@@ -0,0 +1,105 @@
+use crate::{
+    engine::EngineCore,
+    error::{TRTError, TRTResult},
+    plan::PlanCompatibility,
+};
+use std::{
+    fmt,
+    sync::{Arc, Mutex},
+};
+use tensorrt_rs_sys::{allocator::DeviceAllocator, runtime::Runtime};
+
+static GLOBAL: Mutex<Option<SharedRuntime>> = Mutex::new(None);
+
+// One IRuntime (and logger) that many engines deserialize through, instead of one each, so
+// its thread count is configured once (set_max_threads) for every load. Deserializations
+// through it take turns, each using up to max_threads of TensorRT's own threads. Engines
+// sharing it share its logger: their names and log settings are no longer their own.
+// Clones share the runtime, which lives until the last engine deserialized through it.
+#[derive(Clone)]
+pub struct SharedRuntime {
+    runtime: Arc<Mutex<Runtime>>,
+    // installed on the runtime before its first deserialization, which holds on to it too
+    allocator: Option<Arc<DeviceAllocator>>,
+}
+
+impl SharedRuntime {
+    pub fn new(max_threads: Option<i32>) -> TRTResult<Self> {
+        Self::with_compatibility(max_threads, &PlanCompatibility::default())
+    }
+
+    // For plans loaded as `compatibility` allows, e.g. through the lean runtime.
+    pub fn with_compatibility(max_threads: Option<i32>, compatibility: &PlanCompatibility) -> TRTResult<Self> {
+        Self::create(max_threads, compatibility, None)
+    }
+
+    // Engines deserialized through it take their weights, and their contexts the scratch
+    // and IO TensorRT allocates, from `allocator` (e.g. a stream-ordered
+    // DeviceAllocator::mem_pool) instead of cudaMalloc/cudaFree, which synchronize the device.
+    pub fn with_allocator(
+        max_threads: Option<i32>,
+        compatibility: &PlanCompatibility,
+        allocator: Arc<DeviceAllocator>,
+    ) -> TRTResult<Self> {
+        Self::create(max_threads, compatibility, Some(allocator))
+    }
+
+    fn create(
+        max_threads: Option<i32>,
+        compatibility: &PlanCompatibility,
+        allocator: Option<Arc<DeviceAllocator>>,
+    ) -> TRTResult<Self> {
+        let mut runtime = EngineCore::create_runtime(max_threads, None, compatibility)?;
+        if let Some(allocator) = allocator.as_ref() {
+            runtime.set_gpu_allocator(allocator);
+        }
+        Ok(Self { runtime: Arc::new(Mutex::new(runtime)), allocator })
+    }
+
+    // The process-wide runtime, created with TensorRT's defaults on first use.
+    pub fn global() -> TRTResult<Self> {
+        let mut global = GLOBAL.lock().unwrap();
+        if let Some(runtime) = global.as_ref() {
+            return Ok(runtime.clone());
+        }
+        let runtime = Self::new(None)?;
+        *global = Some(runtime.clone());
+        Ok(runtime)
+    }
+
+    // Applies to the deserializations started afterwards.
+    pub fn set_max_threads(&self, max_threads: i32) -> TRTResult<()> {
+        match self.runtime.lock().unwrap().set_max_threads(max_threads) {
+            true => Ok(()),
+            false => Err(TRTError::RuntimeCreationError),
+        }
+    }
+
+    pub fn get_max_threads(&self) -> i32 {
+        self.runtime.lock().unwrap().get_max_threads()
+    }
+
+    pub fn gpu_allocator(&self) -> Option<&Arc<DeviceAllocator>> {
+        self.allocator.as_ref()
+    }
+
+    pub(crate) fn handle(&self) -> Arc<Mutex<Runtime>> {
+        self.runtime.clone()
+    }
+}
+
+impl fmt::Debug for SharedRuntime {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("SharedRuntime")
+            .field("max_threads", &self.get_max_threads())
+            .field("gpu_allocator", &self.allocator.is_some())
+            .finish()
+    }
+}
+
+// Runtimes are equal when they are the same runtime.
+impl PartialEq for SharedRuntime {
+    fn eq(&self, other: &Self) -> bool {
+        Arc::ptr_eq(&self.runtime, &other.runtime)
+    }
+}
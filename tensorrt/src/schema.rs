@@ -0,0 +1,286 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    layout::TensorLayout,
+    profile::{ProfileSelector, ProfileShape},
+    tensor::Shape,
+};
+use std::collections::HashMap;
+use tensorrt_rs_sys::runtime::{CudaEngine, DataType, OptProfileSelector, TensorHandle, TensorIOMode, TensorLocation};
+
+// What the engine reports about one of its IO tensors.
+#[derive(Debug, Clone, PartialEq)]
+pub struct TensorSchema {
+    pub name: String,
+    // the IO index, which doubles as the tensor handle
+    pub index: usize,
+    pub io_mode: TensorIOMode,
+    pub dtype: DataType,
+    pub layout: TensorLayout,
+    // as built, with -1 for dynamic dimensions
+    pub shape: Shape,
+    // a shape tensor, whose values TensorRT needs on the host to infer shapes
+    pub shape_inference: bool,
+    pub location: TensorLocation,
+    // min/opt/max per optimization profile; None for outputs
+    pub profiles: Vec<Option<ProfileShape>>,
+}
+
+impl TensorSchema {
+    pub fn is_input(&self) -> bool {
+        self.io_mode.is_input()
+    }
+
+    pub fn is_output(&self) -> bool {
+        self.io_mode.is_output()
+    }
+
+    // Whether the tensor is bound to host memory: shape tensors, and tensors TensorRT reads or
+    // writes on the host.
+    pub fn on_host(&self) -> bool {
+        self.shape_inference || self.location == TensorLocation::HOST
+    }
+
+    pub fn is_dynamic(&self) -> bool {
+        self.shape.iter().any(|&dim| dim < 0)
+    }
+
+    pub fn profile(&self, profile: i32) -> Option<&ProfileShape> {
+        match profile < 0 {
+            true => None,
+            false => self.profiles.get(profile as usize)?.as_ref(),
+        }
+    }
+
+    pub fn profile_shape(&self, profile: i32, select: OptProfileSelector) -> Option<Shape> {
+        let range = self.profile(profile)?;
+        Some(match select {
+            OptProfileSelector::MIN => range.min,
+            OptProfileSelector::OPT => range.opt,
+            OptProfileSelector::MAX => range.max,
+        })
+    }
+
+    pub(crate) fn handle(&self) -> TensorHandle {
+        self.index as TensorHandle
+    }
+
+    // Whether an input of `shape` can be enqueued with `profile`, or with one of the profiles
+    // when None: the rank and static dims as built, and the dynamic dims within the profile's
+    // min and max. Shape tensors are checked for their own dims only, not their values.
+    pub fn accepts(&self, shape: &Shape, profile: Option<i32>) -> bool {
+        self.matches_built(shape) && self.within_profiles(profile, |range| range.contains(shape))
+    }
+
+    // The same against the max dims only, for inputs that batching or padding can only grow.
+    pub fn accepts_up_to_max(&self, shape: &Shape, profile: Option<i32>) -> bool {
+        let below = |range: &ProfileShape| shape.iter().zip(range.max.iter()).all(|(&dim, &max)| dim <= max);
+        self.matches_built(shape) && self.within_profiles(profile, below)
+    }
+
+    fn matches_built(&self, shape: &Shape) -> bool {
+        shape.nb_dims() == self.shape.nb_dims()
+            && shape.iter().zip(self.shape.iter()).all(|(&dim, &built)| dim >= 0 && (built < 0 || dim == built))
+    }
+
+    fn within_profiles<F: Fn(&ProfileShape) -> bool>(&self, profile: Option<i32>, within: F) -> bool {
+        if self.shape_inference || !self.is_dynamic() {
+            return true;
+        }
+        match profile {
+            Some(profile) => self.profile(profile).map_or(true, &within),
+            None => self.profiles.iter().all(Option::is_none) || self.profiles.iter().flatten().any(within),
+        }
+    }
+}
+
+// The IO tensors of an engine, queried once when it is deserialized and shared by every
+// context created from it. Refits change weights only, so it never goes stale; lookups take
+// neither an FFI call nor the engine's lock.
+#[derive(Debug, Clone, Default, PartialEq)]
+pub struct IoSchema {
+    tensors: Vec<TensorSchema>,
+    by_name: HashMap<String, usize>,
+    num_profiles: i32,
+}
+
+impl IoSchema {
+    pub(crate) fn from_engine(engine: &CudaEngine) -> Self {
+        let num_profiles = engine.get_num_optimization_profiles().max(0);
+        let tensors = (0..engine.get_num_io_tensors().max(0))
+            .map(|i| {
+                let name = engine.get_io_tensor_name(i);
+                let io_mode = engine.get_tensor_io_mode(name);
+                let profiles = match io_mode.is_input() {
+                    true => (0..num_profiles).map(|profile| Self::query_profile(engine, name, profile)).collect(),
+                    false => Vec::new(),
+                };
+                TensorSchema {
+                    name: name.to_string(),
+                    index: i as usize,
+                    io_mode,
+                    dtype: engine.get_tensor_dtype(name),
+                    layout: TensorLayout::new(
+                        engine.get_tensor_format(name),
+                        engine.get_tensor_vectorized_dim(name),
+                        engine.get_tensor_components_per_element(name),
+                    ),
+                    shape: Shape::from(engine.get_tensor_dims_by_handle(i)),
+                    shape_inference: engine.is_shape_inference_io(name),
+                    location: engine.get_tensor_location(name),
+                    profiles,
+                }
+            })
+            .collect();
+        Self::new(tensors, num_profiles)
+    }
+
+    fn query_profile(engine: &CudaEngine, name: &str, profile: i32) -> Option<ProfileShape> {
+        let min = engine.get_profile_shape(name, profile, OptProfileSelector::MIN);
+        let opt = engine.get_profile_shape(name, profile, OptProfileSelector::OPT);
+        let max = engine.get_profile_shape(name, profile, OptProfileSelector::MAX);
+        match min.is_valid() && opt.is_valid() && max.is_valid() {
+            true => Some(ProfileShape { min: Shape::from(min), opt: Shape::from(opt), max: Shape::from(max) }),
+            false => None,
+        }
+    }
+
+    pub(crate) fn new(tensors: Vec<TensorSchema>, num_profiles: i32) -> Self {
+        let by_name = tensors.iter().map(|tensor| (tensor.name.clone(), tensor.index)).collect();
+        Self { tensors, by_name, num_profiles }
+    }
+
+    // In IO index order.
+    pub fn tensors(&self) -> &[TensorSchema] {
+        &self.tensors
+    }
+
+    pub fn len(&self) -> usize {
+        self.tensors.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.tensors.is_empty()
+    }
+
+    pub fn get(&self, name: &str) -> Option<&TensorSchema> {
+        self.by_name.get(name).map(|&index| &self.tensors[index])
+    }
+
+    pub fn get_by_index(&self, index: usize) -> Option<&TensorSchema> {
+        self.tensors.get(index)
+    }
+
+    pub fn index_of(&self, name: &str) -> Option<usize> {
+        self.by_name.get(name).copied()
+    }
+
+    pub fn inputs(&self) -> impl Iterator<Item = &TensorSchema> {
+        self.tensors.iter().filter(|tensor| tensor.is_input())
+    }
+
+    pub fn outputs(&self) -> impl Iterator<Item = &TensorSchema> {
+        self.tensors.iter().filter(|tensor| tensor.is_output())
+    }
+
+    pub fn num_profiles(&self) -> i32 {
+        self.num_profiles
+    }
+
+    // Checks the shapes of a request's inputs with TensorSchema::accepts, on the host, before
+    // any of them is applied to a context. Names that are not inputs of the engine are
+    // skipped, as inference skips them.
+    pub fn validate_inputs<'a, I>(&self, inputs: I, profile: Option<i32>) -> TRTResult<()>
+    where
+        I: IntoIterator<Item = (&'a str, &'a Shape)>,
+    {
+        for (name, shape) in inputs {
+            match self.get(name) {
+                Some(tensor) if tensor.is_input() && !tensor.accepts(shape, profile) => {
+                    return Err(TRTError::ShapeError(shape.to_vec()));
+                }
+                _ => {}
+            }
+        }
+        Ok(())
+    }
+
+    pub fn profile_shape(&self, name: &str, profile: i32, select: OptProfileSelector) -> Option<Shape> {
+        self.get(name)?.profile_shape(profile, select)
+    }
+
+    // Every IO tensor was built with a static shape.
+    pub fn is_static(&self) -> bool {
+        self.tensors.iter().all(|tensor| !tensor.is_dynamic())
+    }
+
+    // min/opt/max of every input for every profile.
+    pub fn profile_selector(&self) -> ProfileSelector {
+        let profiles = (0..self.num_profiles)
+            .map(|profile| {
+                self.inputs()
+                    .filter_map(|tensor| Some((tensor.name.clone(), tensor.profile(profile)?.clone())))
+                    .collect::<HashMap<_, _>>()
+            })
+            .collect();
+        ProfileSelector::new(profiles)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn tensor(name: &str, index: usize, io_mode: TensorIOMode, shape: &[i32]) -> TensorSchema {
+        let range = ProfileShape { min: Shape::new(&[1, 3]), opt: Shape::new(&[4, 3]), max: Shape::new(&[8, 3]) };
+        TensorSchema {
+            name: name.to_string(),
+            index,
+            io_mode,
+            dtype: DataType::FLOAT,
+            layout: TensorLayout::linear(),
+            shape: Shape::new(shape),
+            shape_inference: false,
+            location: TensorLocation::DEVICE,
+            profiles: match io_mode.is_input() {
+                true => vec![Some(range), None],
+                false => Vec::new(),
+            },
+        }
+    }
+
+    #[test]
+    fn lookups_and_profiles() {
+        let schema = IoSchema::new(
+            vec![tensor("input", 0, TensorIOMode::INPUT, &[-1, 3]), tensor("output", 1, TensorIOMode::OUTPUT, &[-1])],
+            2,
+        );
+        assert_eq!(schema.index_of("output"), Some(1));
+        assert_eq!(schema.get("input").map(|tensor| tensor.is_dynamic()), Some(true));
+        assert_eq!(schema.inputs().count(), 1);
+        assert!(!schema.is_static());
+        assert_eq!(schema.profile_shape("input", 0, OptProfileSelector::MAX), Some(Shape::new(&[8, 3])));
+        assert_eq!(schema.profile_shape("input", 1, OptProfileSelector::MAX), None);
+        assert_eq!(schema.profile_shape("output", 0, OptProfileSelector::MAX), None);
+        assert_eq!(schema.profile_selector().num_profiles(), 2);
+        assert!(schema.profile_selector().get(1).map_or(false, |shapes| shapes.is_empty()));
+    }
+
+    #[test]
+    fn inputs_are_checked_against_profile_bounds() {
+        let input = tensor("input", 0, TensorIOMode::INPUT, &[-1, 3]);
+        assert!(input.accepts(&Shape::new(&[4, 3]), Some(0)));
+        assert!(input.accepts(&Shape::new(&[8, 3]), None));
+        assert!(!input.accepts(&Shape::new(&[9, 3]), None));
+        assert!(!input.accepts(&Shape::new(&[4, 2]), Some(0)));
+        assert!(!input.accepts(&Shape::new(&[4]), Some(0)));
+        // profile 1 has no bounds for the input
+        assert!(input.accepts(&Shape::new(&[9, 3]), Some(1)));
+        assert!(!input.accepts(&Shape::new(&[0, 3]), Some(0)));
+        assert!(input.accepts_up_to_max(&Shape::new(&[0, 3]), Some(0)));
+
+        let schema = IoSchema::new(vec![input, tensor("output", 1, TensorIOMode::OUTPUT, &[-1])], 2);
+        let (small, large) = (Shape::new(&[2, 3]), Shape::new(&[16, 3]));
+        assert!(schema.validate_inputs([("input", &small), ("other", &large)], Some(0)).is_ok());
+        assert!(matches!(schema.validate_inputs([("input", &large)], Some(0)), Err(TRTError::ShapeError(_))));
+    }
+}
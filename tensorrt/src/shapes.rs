@@ -0,0 +1,194 @@
+use crate::tensor::Shape;
+use std::collections::HashMap;
+use tensorrt_rs_sys::runtime::{TensorBinding, TensorDims, TensorHandle};
+
+// Bounds the output shape cache of engines fed unbounded shape variety.
+const MAX_SIGNATURES: usize = 64;
+
+// Input shapes last applied to one execution context, by IO index, and the output shapes
+// TensorRT inferred for every input shape signature seen. setInputShape invalidates the
+// context's shape-dependent state even for an unchanged shape, so it is only issued for
+// shapes that differ from the applied ones, and a known signature skips shape inference.
+// Output shapes also depend on the values of shape-tensor inputs, which are part of the
+// signature and are only rewritten into their host buffers when they change.
+#[derive(Default)]
+pub(crate) struct ShapeTracker {
+    is_input: Vec<bool>,
+    // None for outputs and for inputs in an unknown state; followed by the values last
+    // written for each shape-tensor input
+    applied: Vec<Option<Shape>>,
+    // where in `applied` the values of a shape-tensor input are, by IO index
+    value_slots: Vec<Option<usize>>,
+    outputs: HashMap<Vec<Option<Shape>>, Vec<TensorDims>>,
+}
+
+impl ShapeTracker {
+    // Sizes the tracker for the engine's IO tensors; what is known is kept when they match.
+    pub(crate) fn prepare<I: Iterator<Item = bool>>(&mut self, is_input: I) {
+        let is_input: Vec<bool> = is_input.collect();
+        if self.is_input != is_input {
+            self.applied = vec![None; is_input.len()];
+            self.value_slots = vec![None; is_input.len()];
+            self.is_input = is_input;
+            self.outputs.clear();
+        }
+    }
+
+    // Tracks the values of the shape-tensor inputs `handles`, after prepare.
+    pub(crate) fn track_values(&mut self, handles: &[TensorHandle]) {
+        let count = self.is_input.len();
+        let mut value_slots = vec![None; count];
+        for (i, &handle) in handles.iter().enumerate() {
+            if let Some(slot) = value_slots.get_mut(handle as usize) {
+                *slot = Some(count + i);
+            }
+        }
+        if self.value_slots != value_slots {
+            self.applied.resize(count, None);
+            self.applied.resize(count + handles.len(), None);
+            self.value_slots = value_slots;
+            self.outputs.clear();
+        }
+    }
+
+    pub(crate) fn tracks_values(&self) -> bool {
+        self.applied.len() > self.is_input.len()
+    }
+
+    // Shape tensors hold at most MAX_DIMS values, as a shape does.
+    pub(crate) fn values_applied(&self, handle: TensorHandle, values: &Shape) -> bool {
+        match self.value_slots.get(handle as usize) {
+            Some(&Some(slot)) => self.applied[slot].as_ref() == Some(values),
+            _ => false,
+        }
+    }
+
+    pub(crate) fn record_values(&mut self, handle: TensorHandle, values: Shape) {
+        if let Some(&Some(slot)) = self.value_slots.get(handle as usize) {
+            self.applied[slot] = Some(values);
+        }
+    }
+
+    pub(crate) fn is_applied(&self, handle: TensorHandle, shape: &Shape) -> bool {
+        matches!(self.applied.get(handle as usize), Some(Some(applied)) if applied == shape)
+    }
+
+    pub(crate) fn record(&mut self, handle: TensorHandle, shape: Shape) {
+        if let Some(applied) = self.applied.get_mut(handle as usize) {
+            *applied = Some(shape);
+        }
+    }
+
+    // Records the shapes of a batch of bindings the context accepted.
+    pub(crate) fn record_bindings(&mut self, bindings: &[TensorBinding]) {
+        for binding in bindings.iter().filter(|binding| binding.dims.is_valid()) {
+            self.record(binding.handle, Shape::from(binding.dims));
+        }
+    }
+
+    // After a failed call the context's shapes are unknown; they are applied again.
+    pub(crate) fn invalidate(&mut self) {
+        self.applied.iter_mut().for_each(|applied| *applied = None);
+    }
+
+    fn is_complete(&self) -> bool {
+        let (shapes, values) = self.applied.split_at(self.is_input.len());
+        shapes.iter().zip(self.is_input.iter()).all(|(applied, &is_input)| !is_input || applied.is_some())
+            && values.iter().all(Option::is_some)
+    }
+
+    // Output dims, by output handle order, inferred for the applied input shapes.
+    pub(crate) fn cached_outputs(&self) -> Option<&[TensorDims]> {
+        if !self.is_complete() {
+            return None;
+        }
+        self.outputs.get(self.applied.as_slice()).map(Vec::as_slice)
+    }
+
+    pub(crate) fn cache_outputs(&mut self, resolved: Vec<TensorDims>) {
+        if !self.is_complete() {
+            return;
+        }
+        if self.outputs.len() >= MAX_SIGNATURES {
+            self.outputs.clear();
+        }
+        self.outputs.insert(self.applied.clone(), resolved);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn tracker() -> ShapeTracker {
+        let mut shapes = ShapeTracker::default();
+        // two inputs and an output
+        shapes.prepare([true, true, false].into_iter());
+        shapes
+    }
+
+    #[test]
+    fn only_changed_shapes_need_applying() {
+        let mut shapes = tracker();
+        let shape = Shape::new(&[1, 3, 224, 224]);
+        assert!(!shapes.is_applied(0, &shape));
+        shapes.record(0, shape);
+        assert!(shapes.is_applied(0, &shape));
+        assert!(!shapes.is_applied(0, &Shape::new(&[2, 3, 224, 224])));
+        shapes.invalidate();
+        assert!(!shapes.is_applied(0, &shape));
+    }
+
+    #[test]
+    fn outputs_are_cached_per_signature() {
+        let mut shapes = tracker();
+        shapes.record(0, Shape::new(&[1, 8]));
+        // incomplete signature
+        shapes.cache_outputs(vec![TensorDims::new(&[1, 4])]);
+        assert!(shapes.cached_outputs().is_none());
+
+        shapes.record(1, Shape::new(&[1, 2]));
+        shapes.cache_outputs(vec![TensorDims::new(&[1, 4])]);
+        shapes.record(0, Shape::new(&[2, 8]));
+        assert!(shapes.cached_outputs().is_none());
+        shapes.cache_outputs(vec![TensorDims::new(&[2, 4])]);
+
+        shapes.record(0, Shape::new(&[1, 8]));
+        assert_eq!(shapes.cached_outputs().unwrap()[0].as_slice(), &[1, 4]);
+    }
+
+    #[test]
+    fn shape_tensor_values_are_part_of_the_signature() {
+        let mut shapes = tracker();
+        shapes.track_values(&[1]);
+        let values = Shape::new(&[480, 640]);
+        shapes.record(0, Shape::new(&[1, 3, 720, 1280]));
+        shapes.record(1, Shape::new(&[2]));
+        assert!(!shapes.values_applied(1, &values));
+        assert!(!shapes.values_applied(0, &values));
+        shapes.cache_outputs(vec![TensorDims::new(&[1, 3, 480, 640])]);
+        assert!(shapes.cached_outputs().is_none());
+
+        shapes.record_values(1, values);
+        assert!(shapes.values_applied(1, &values));
+        shapes.cache_outputs(vec![TensorDims::new(&[1, 3, 480, 640])]);
+        shapes.record_values(1, Shape::new(&[240, 320]));
+        assert!(shapes.cached_outputs().is_none());
+        shapes.record_values(1, values);
+        assert_eq!(shapes.cached_outputs().unwrap()[0].as_slice(), &[1, 3, 480, 640]);
+
+        // unchanged slots keep what is known
+        shapes.track_values(&[1]);
+        assert!(shapes.values_applied(1, &values));
+    }
+
+    #[test]
+    fn prepare_keeps_matching_state() {
+        let mut shapes = tracker();
+        shapes.record(1, Shape::new(&[4]));
+        shapes.prepare([true, true, false].into_iter());
+        assert!(shapes.is_applied(1, &Shape::new(&[4])));
+        shapes.prepare([true, false].into_iter());
+        assert!(!shapes.is_applied(1, &Shape::new(&[4])));
+    }
+}
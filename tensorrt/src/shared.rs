@@ -0,0 +1,124 @@
+use crate::{
+    engine::{EngineCore, TRTEngine},
+    error::{TRTError, TRTResult},
+    plan::{PlanCompatibility, PlanFile, PlanLoadOptions},
+    runtime::SharedRuntime,
+    schema::IoSchema,
+    tensor::Shape,
+};
+use cuda_rs::stream::CuStream;
+use std::{path::Path, sync::Arc};
+use tensorrt_rs_sys::runtime::DataType;
+
+// A deserialized engine that threads share by cloning the handle. Each worker creates its
+// own TRTEngine (execution context, stream and IO tensors) from it, and every one of them
+// runs on the same weights. Queries and context creation may run concurrently; the engine
+// is destroyed with the last handle or context.
+#[derive(Clone)]
+pub struct SharedEngine(Arc<EngineCore>);
+
+impl SharedEngine {
+    pub fn new<P: AsRef<Path>>(engine_path: &P, options: &PlanLoadOptions) -> TRTResult<Self> {
+        let plan = PlanFile::open(engine_path, options)?;
+        let engine = Self::from_plan(&plan)?;
+        plan.release()?;
+        Ok(engine)
+    }
+
+    pub fn from_plan(plan: &PlanFile) -> TRTResult<Self> {
+        Self::from_bytes(plan.as_bytes())
+    }
+
+    pub fn from_bytes(data: &[u8]) -> TRTResult<Self> {
+        Self::from_bytes_compatible(data, &PlanCompatibility::default())
+    }
+
+    pub fn from_bytes_compatible(data: &[u8], compatibility: &PlanCompatibility) -> TRTResult<Self> {
+        Ok(Self(EngineCore::from_bytes(data, None, None, compatibility)?))
+    }
+
+    // Deserializes through `runtime`; see SharedRuntime.
+    pub fn from_bytes_shared(data: &[u8], runtime: &SharedRuntime) -> TRTResult<Self> {
+        Ok(Self(EngineCore::from_bytes_shared(data, runtime)?))
+    }
+
+    pub(crate) fn from_core(core: Arc<EngineCore>) -> Self {
+        Self(core)
+    }
+
+    // An activated engine with its own execution context on `stream`, e.g. one per worker
+    // thread. IO tensors are left to the caller (allocate_io_tensors).
+    pub fn create_engine(&self, stream: &CuStream) -> TRTResult<TRTEngine> {
+        let mut engine = TRTEngine::from_core(self.0.clone(), stream);
+        engine.activate()?;
+        Ok(engine)
+    }
+
+    // Handles and engines currently holding the engine.
+    pub fn num_holders(&self) -> usize {
+        Arc::strong_count(&self.0)
+    }
+
+    // Plan size, which stands in for the device memory of the weights.
+    pub fn get_weights_size(&self) -> usize {
+        self.0.weights()
+    }
+
+    // Activation memory each execution context allocates.
+    pub fn get_device_memory_size(&self) -> usize {
+        self.0.engine().get_device_memory_size()
+    }
+
+    pub fn get_num_layers(&self) -> i32 {
+        self.0.engine().get_num_layers()
+    }
+
+    pub fn get_num_optimization_profiles(&self) -> i32 {
+        self.0.schema().num_profiles()
+    }
+
+    pub fn get_name(&self) -> String {
+        self.0.engine().get_name().to_string()
+    }
+
+    pub fn io_schema(&self) -> &IoSchema {
+        self.0.schema()
+    }
+
+    pub fn input_names(&self) -> Vec<String> {
+        self.0.schema().inputs().map(|tensor| tensor.name.clone()).collect()
+    }
+
+    pub fn output_names(&self) -> Vec<String> {
+        self.0.schema().outputs().map(|tensor| tensor.name.clone()).collect()
+    }
+
+    // As built, with -1 for dynamic dimensions.
+    pub fn get_tensor_shape(&self, name: &str) -> TRTResult<Shape> {
+        match self.0.schema().get(name) {
+            Some(tensor) => Ok(tensor.shape),
+            None => Err(TRTError::TensorNotFound(name.to_string())),
+        }
+    }
+
+    pub fn get_tensor_dtype(&self, name: &str) -> TRTResult<DataType> {
+        match self.0.schema().get(name) {
+            Some(tensor) => Ok(tensor.dtype),
+            None => Err(TRTError::TensorNotFound(name.to_string())),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn is_send_sync<T: Send + Sync>() {}
+    fn is_send<T: Send>() {}
+
+    #[test]
+    fn handles_cross_threads() {
+        is_send_sync::<SharedEngine>();
+        is_send::<TRTEngine>();
+    }
+}
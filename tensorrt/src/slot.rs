@@ -0,0 +1,27 @@
+use tensorrt_rs_sys::runtime::{DataType, TensorHandle};
+
+// An IO tensor resolved once by name (TRTEngine::io_slot), for the indexed binding path
+// where requests neither hash names nor go through name-based FFI calls.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub struct IoSlot(pub(crate) TensorHandle);
+
+impl IoSlot {
+    pub fn index(&self) -> usize {
+        self.0 as usize
+    }
+}
+
+// Engine-owned buffer of one IO tensor, indexed by IoSlot. Data-dependent outputs, whose
+// memory belongs to the output allocator, have a null `ptr`.
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub(crate) struct SlotBinding {
+    pub(crate) ptr: usize,
+    pub(crate) capacity: usize,
+    pub(crate) dtype: DataType,
+    pub(crate) is_input: bool,
+    // a shape tensor, whose values TensorRT reads and writes on the host
+    pub(crate) shape_io: bool,
+    // bound to host memory (TensorSchema::on_host): `ptr` is the host address of a pinned
+    // buffer
+    pub(crate) on_host: bool,
+}
@@ -0,0 +1,131 @@
+use crate::error::{TRTError, TRTResult};
+use std::{
+    fmt,
+    sync::{Arc, Mutex},
+};
+use tensorrt_rs_sys::{
+    green::{self, GreenContext, SmPartitioner},
+    stream::CudaStream,
+};
+
+// A group of SMs that the contexts given it run their kernels on, for predictable latency
+// next to other engines on the same GPU: see EnginePoolOptions::sm_budget and
+// TRTEngine::set_sm_budget. Clones share the group.
+#[derive(Clone)]
+pub struct SmBudget {
+    context: Arc<GreenContext>,
+    device: i32,
+}
+
+impl SmBudget {
+    pub fn sm_count(&self) -> u32 {
+        self.context.sm_count()
+    }
+
+    pub fn device(&self) -> i32 {
+        self.device
+    }
+
+    pub(crate) fn create_stream(&self, priority: i32) -> TRTResult<CudaStream> {
+        match self.context.create_stream(priority) {
+            Some(stream) => Ok(stream),
+            None => Err(TRTError::StreamCreationError),
+        }
+    }
+}
+
+impl fmt::Debug for SmBudget {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_struct("SmBudget").field("device", &self.device).field("sm_count", &self.sm_count()).finish()
+    }
+}
+
+// Budgets are equal when they are the same group of SMs.
+impl PartialEq for SmBudget {
+    fn eq(&self, other: &Self) -> bool {
+        Arc::ptr_eq(&self.context, &other.context)
+    }
+}
+
+// The SMs of one device, handed out as disjoint budgets, e.g. a third of the GPU to a
+// latency-critical model and the rest to batch traffic. Budgets come from green contexts
+// (CUDA 12.4+); on older drivers, setting CUDA_MPS_ACTIVE_THREAD_PERCENTAGE per process
+// under MPS is the alternative, see set_mps_active_thread_percentage.
+pub struct SmPartition {
+    device: i32,
+    num_sms: u32,
+    partitioner: Mutex<SmPartitioner>,
+}
+
+impl SmPartition {
+    pub fn new(device: i32) -> TRTResult<Self> {
+        let partitioner = match SmPartitioner::new(device) {
+            Some(partitioner) => partitioner,
+            None => return Err(TRTError::SmBudgetError("green contexts are not supported")),
+        };
+        let num_sms = partitioner.remaining();
+        Ok(Self { device, num_sms, partitioner: Mutex::new(partitioner) })
+    }
+
+    pub fn is_supported() -> bool {
+        green::is_supported()
+    }
+
+    // Takes at least `sm_count` SMs; the device rounds the count up to its granularity.
+    pub fn take(&self, sm_count: u32) -> TRTResult<SmBudget> {
+        match self.partitioner.lock().unwrap().take(sm_count.max(1)) {
+            Some(context) => Ok(SmBudget { context: Arc::new(context), device: self.device }),
+            None => Err(TRTError::SmBudgetError("not enough SMs left")),
+        }
+    }
+
+    // Takes `fraction` of all of the device's SMs.
+    pub fn take_fraction(&self, fraction: f32) -> TRTResult<SmBudget> {
+        self.take(sm_count(self.num_sms, fraction))
+    }
+
+    // One budget per fraction of the device, e.g. [0.25, 0.75].
+    pub fn split(&self, fractions: &[f32]) -> TRTResult<Vec<SmBudget>> {
+        fractions.iter().map(|fraction| self.take_fraction(*fraction)).collect()
+    }
+
+    pub fn device(&self) -> i32 {
+        self.device
+    }
+
+    pub fn num_sms(&self) -> u32 {
+        self.num_sms
+    }
+
+    // SMs not taken yet.
+    pub fn num_remaining(&self) -> u32 {
+        self.partitioner.lock().unwrap().remaining()
+    }
+}
+
+fn sm_count(num_sms: u32, fraction: f32) -> u32 {
+    ((num_sms as f64 * fraction.clamp(0.0, 1.0) as f64).floor() as u32).max(1)
+}
+
+// Caps every context of this process at `percentage` of each device's SMs when it is an MPS
+// client. Process-wide, and only read when CUDA initializes, so it must be called before
+// any CUDA call; engines that need different budgets then run in processes of their own.
+pub fn set_mps_active_thread_percentage(percentage: u32) -> TRTResult<()> {
+    if percentage == 0 || percentage > 100 {
+        return Err(TRTError::SmBudgetError("MPS active thread percentage must be in 1..=100"));
+    }
+    std::env::set_var("CUDA_MPS_ACTIVE_THREAD_PERCENTAGE", percentage.to_string());
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn fractions_round_down_to_at_least_one_sm() {
+        assert_eq!(sm_count(132, 0.25), 33);
+        assert_eq!(sm_count(132, 1.5), 132);
+        assert_eq!(sm_count(132, 0.0), 1);
+    }
+}
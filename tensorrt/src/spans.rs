@@ -0,0 +1,629 @@
+use crate::{
+    ring::{submission_ring, RingReceiver, RingSender},
+    tensor::Shape,
+};
+use crossbeam_queue::ArrayQueue;
+use cuda_rs::stream::CuStream;
+use std::{
+    borrow::Cow,
+    fmt::Write as _,
+    io::{self, Write},
+    process,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc, Mutex,
+    },
+    thread::{self, JoinHandle},
+    time::{Duration, Instant, SystemTime, UNIX_EPOCH},
+};
+use tensorrt_rs_sys::{device, stream::CudaEvent};
+
+// attribute lists kept for reuse by the spans to come
+const POOLED_ATTRIBUTES: usize = 256;
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct SpanOptions {
+    // Spans in flight to the exporter thread; spans beyond it are dropped and counted rather
+    // than blocking the request.
+    pub capacity: usize,
+    // Starts a trace for every n-th request arriving outside of one; 0 traces only the
+    // requests continuing a sampled trace, see TraceContext::from_traceparent.
+    pub sample_every: u64,
+    // Timing events shared by the device spans in flight; calls beyond them go without
+    // device spans.
+    pub max_events: usize,
+}
+
+impl Default for SpanOptions {
+    fn default() -> Self {
+        Self { capacity: 4096, sample_every: 100, max_events: 256 }
+    }
+}
+
+// The W3C trace context of a span, as carried by a traceparent header, so the spans of a
+// request join the trace of the service that sent it.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct TraceContext {
+    pub trace_id: u128,
+    pub span_id: u64,
+    pub sampled: bool,
+}
+
+impl TraceContext {
+    // "00-<trace id>-<parent span id>-<flags>"; None for a malformed header, which starts a
+    // trace of its own as per the W3C spec.
+    pub fn from_traceparent(header: &str) -> Option<Self> {
+        let fields: Vec<&str> = header.trim().split('-').collect();
+        let (version, trace_id, span_id, flags) = match fields.as_slice() {
+            [version, trace_id, span_id, flags, rest @ ..] if rest.is_empty() || *version != "00" => {
+                (*version, *trace_id, *span_id, *flags)
+            }
+            _ => return None,
+        };
+        let lengths = [(version, 2), (trace_id, 32), (span_id, 16), (flags, 2)];
+        if version == "ff" || !lengths.iter().all(|&(field, len)| field.len() == len && is_lower_hex(field)) {
+            return None;
+        }
+        let trace_id = u128::from_str_radix(trace_id, 16).ok()?;
+        let span_id = u64::from_str_radix(span_id, 16).ok()?;
+        let flags = u8::from_str_radix(flags, 16).ok()?;
+        match trace_id != 0 && span_id != 0 {
+            true => Some(Self { trace_id, span_id, sampled: flags & 1 == 1 }),
+            false => None,
+        }
+    }
+
+    pub fn traceparent(&self) -> String {
+        format!("00-{:032x}-{:016x}-{:02x}", self.trace_id, self.span_id, self.sampled as u8)
+    }
+}
+
+fn is_lower_hex(field: &str) -> bool {
+    field.bytes().all(|byte| byte.is_ascii_digit() || (b'a'..=b'f').contains(&byte))
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub enum SpanValue {
+    Bool(bool),
+    Int(i64),
+    Str(Cow<'static, str>),
+    // exported as an array of ints
+    Shape(Shape),
+}
+
+pub type SpanAttributes = Vec<(Cow<'static, str>, SpanValue)>;
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct SpanRecord {
+    pub trace_id: u128,
+    pub span_id: u64,
+    // 0 for the root of a trace
+    pub parent_span_id: u64,
+    pub name: &'static str,
+    // since the Unix epoch
+    pub start: Duration,
+    pub end: Duration,
+    pub attributes: SpanAttributes,
+    // the requests of a batch, which belong to traces of their own
+    pub links: Vec<TraceContext>,
+    pub failed: bool,
+}
+
+// Receives finished spans on the tracer's exporter thread, in batches, e.g. to hand them to
+// an OpenTelemetry SDK exporter, or OtlpJsonExporter.
+pub trait SpanExporter: Send + 'static {
+    fn export(&mut self, spans: &[SpanRecord]) -> io::Result<()>;
+
+    // Called while no spans are waiting.
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
+// One OTLP/JSON ExportTraceServiceRequest per line, as read by the OpenTelemetry Collector's
+// otlpjsonfile receiver, or posted as is to an OTLP/HTTP /v1/traces endpoint.
+pub struct OtlpJsonExporter<W: Write + Send + 'static> {
+    out: W,
+    service_name: String,
+    line: String,
+}
+
+impl<W: Write + Send + 'static> OtlpJsonExporter<W> {
+    pub fn new(out: W, service_name: &str) -> Self {
+        Self { out, service_name: service_name.to_string(), line: String::new() }
+    }
+}
+
+impl<W: Write + Send + 'static> SpanExporter for OtlpJsonExporter<W> {
+    fn export(&mut self, spans: &[SpanRecord]) -> io::Result<()> {
+        if spans.is_empty() {
+            return Ok(());
+        }
+        self.line.clear();
+        encode_otlp(&self.service_name, spans, &mut self.line);
+        self.line.push('\n');
+        self.out.write_all(self.line.as_bytes())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        self.out.flush()
+    }
+}
+
+fn push_json_str(out: &mut String, value: &str) {
+    out.push('"');
+    for c in value.chars() {
+        match c {
+            '"' => out.push_str("\\\""),
+            '\\' => out.push_str("\\\\"),
+            '\n' => out.push_str("\\n"),
+            c if (c as u32) < 0x20 => write!(out, "\\u{:04x}", c as u32).unwrap(),
+            c => out.push(c),
+        }
+    }
+    out.push('"');
+}
+
+// OTLP/JSON encodes ids in hex and 64-bit integers as strings.
+fn push_value(out: &mut String, value: &SpanValue) {
+    match value {
+        SpanValue::Bool(value) => write!(out, "{{\"boolValue\":{}}}", value).unwrap(),
+        SpanValue::Int(value) => write!(out, "{{\"intValue\":\"{}\"}}", value).unwrap(),
+        SpanValue::Str(value) => {
+            out.push_str("{\"stringValue\":");
+            push_json_str(out, value);
+            out.push('}');
+        }
+        SpanValue::Shape(shape) => {
+            out.push_str("{\"arrayValue\":{\"values\":[");
+            for (i, dim) in shape.iter().enumerate() {
+                let sep = if i > 0 { "," } else { "" };
+                write!(out, "{}{{\"intValue\":\"{}\"}}", sep, dim).unwrap();
+            }
+            out.push_str("]}}");
+        }
+    }
+}
+
+fn encode_otlp(service_name: &str, spans: &[SpanRecord], out: &mut String) {
+    out.push_str("{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":");
+    push_value(out, &SpanValue::Str(Cow::Owned(service_name.to_string())));
+    out.push_str("}]},\"scopeSpans\":[{\"scope\":{\"name\":\"tensorrt-rs\"},\"spans\":[");
+    for (i, span) in spans.iter().enumerate() {
+        if i > 0 {
+            out.push(',');
+        }
+        write!(out, "{{\"traceId\":\"{:032x}\",\"spanId\":\"{:016x}\",", span.trace_id, span.span_id).unwrap();
+        if span.parent_span_id != 0 {
+            write!(out, "\"parentSpanId\":\"{:016x}\",", span.parent_span_id).unwrap();
+        }
+        out.push_str("\"name\":");
+        push_json_str(out, span.name);
+        let (start, end) = (span.start.as_nanos(), span.end.as_nanos());
+        write!(out, ",\"kind\":1,\"startTimeUnixNano\":\"{}\",\"endTimeUnixNano\":\"{}\",\"attributes\":[", start, end)
+            .unwrap();
+        for (j, (key, value)) in span.attributes.iter().enumerate() {
+            out.push_str(if j > 0 { ",{\"key\":" } else { "{\"key\":" });
+            push_json_str(out, key);
+            out.push_str(",\"value\":");
+            push_value(out, value);
+            out.push('}');
+        }
+        out.push_str("],\"links\":[");
+        for (j, link) in span.links.iter().enumerate() {
+            let sep = if j > 0 { "," } else { "" };
+            let (trace_id, span_id) = (link.trace_id, link.span_id);
+            write!(out, "{}{{\"traceId\":\"{:032x}\",\"spanId\":\"{:016x}\"}}", sep, trace_id, span_id).unwrap();
+        }
+        out.push(']');
+        if span.failed {
+            out.push_str(",\"status\":{\"code\":2}");
+        }
+        out.push('}');
+    }
+    out.push_str("]}]}]}");
+}
+
+// splitmix64 over a counter seeded from the clock and the process id, so ids differ across
+// processes without a source of randomness.
+struct SpanIds(AtomicU64);
+
+impl SpanIds {
+    fn new() -> Self {
+        let now = SystemTime::now().duration_since(UNIX_EPOCH).unwrap_or_default();
+        Self(AtomicU64::new(now.as_nanos() as u64 ^ ((process::id() as u64) << 32)))
+    }
+
+    fn next(&self) -> u64 {
+        const GAMMA: u64 = 0x9e37_79b9_7f4a_7c15;
+        let mut z = self.0.fetch_add(GAMMA, Ordering::Relaxed).wrapping_add(GAMMA);
+        z = (z ^ (z >> 30)).wrapping_mul(0xbf58_476d_1ce4_e5b9);
+        z = (z ^ (z >> 27)).wrapping_mul(0x94d0_49bb_1331_11eb);
+        // 0 is no span
+        (z ^ (z >> 31)).max(1)
+    }
+
+    fn trace_id(&self) -> u128 {
+        (self.next() as u128) << 64 | self.next() as u128
+    }
+}
+
+// Instants as wall-clock time, anchored once so that spans are consistent with each other.
+struct Clock {
+    start: Instant,
+    start_unix: Duration,
+}
+
+impl Clock {
+    fn unix(&self, instant: Instant) -> Duration {
+        match instant.checked_duration_since(self.start) {
+            Some(since) => self.start_unix + since,
+            None => self.start_unix.saturating_sub(self.start - instant),
+        }
+    }
+}
+
+// Timing events and attribute lists recycled by the exporter thread.
+struct Pools {
+    events: ArrayQueue<CudaEvent>,
+    created: AtomicUsize,
+    attributes: ArrayQueue<SpanAttributes>,
+}
+
+impl Pools {
+    fn take_event(&self) -> Option<CudaEvent> {
+        if let Some(event) = self.events.pop() {
+            return Some(event);
+        }
+        let max = self.events.capacity();
+        self.created.fetch_update(Ordering::Relaxed, Ordering::Relaxed, |n| (n < max).then(|| n + 1)).ok()?;
+        let event = CudaEvent::with_timing();
+        if event.is_none() {
+            self.created.fetch_sub(1, Ordering::Relaxed);
+        }
+        event
+    }
+
+    fn recycle(&self, mut attributes: SpanAttributes) {
+        if attributes.capacity() > 0 {
+            attributes.clear();
+            self.attributes.push(attributes).ok();
+        }
+    }
+}
+
+// A span being timed on the host, exported by SpanTracer::finish.
+pub(crate) struct OpenSpan {
+    pub(crate) context: TraceContext,
+    parent_span_id: u64,
+    start: Instant,
+    attributes: SpanAttributes,
+    pub(crate) links: Vec<TraceContext>,
+    pub(crate) failed: bool,
+}
+
+impl OpenSpan {
+    pub(crate) fn set(&mut self, key: impl Into<Cow<'static, str>>, value: SpanValue) {
+        self.attributes.push((key.into(), value));
+    }
+}
+
+// (name, first mark, last mark) of a stage of a Timeline.
+pub(crate) type Stage = (&'static str, usize, usize);
+
+// Timing events recorded on the device at the boundaries of a call's stages, e.g. before and
+// after its uploads; each stage is exported as a span once every mark completed. The events
+// go back to the pool when it is dropped, exported or not.
+pub(crate) struct Timeline {
+    events: Vec<CudaEvent>,
+    // the host time of the first mark, which the device times are laid out from: a stage
+    // starts that much later than the device actually reached it
+    anchor: Duration,
+    recorded: bool,
+    pools: Arc<Pools>,
+}
+
+impl Timeline {
+    pub(crate) fn record(&mut self, mark: usize, stream: &CuStream) {
+        self.recorded &= self.events[mark].record(stream);
+    }
+
+    pub(crate) fn event(&self, mark: usize) -> &CudaEvent {
+        &self.events[mark]
+    }
+}
+
+// Re-recording an event still pending is fine, so a timeline may be dropped at any point.
+impl Drop for Timeline {
+    fn drop(&mut self) {
+        for event in self.events.drain(..) {
+            self.pools.events.push(event).ok();
+        }
+    }
+}
+
+struct DeviceSpans {
+    parent: TraceContext,
+    timeline: Timeline,
+    stages: &'static [Stage],
+}
+
+enum Entry {
+    Span(SpanRecord),
+    Device(DeviceSpans),
+}
+
+// Times the stages of sampled requests as OpenTelemetry-style spans: host spans from
+// instants, device spans from timing events. Tracing takes no lock and no IO on the request
+// path: spans are pushed to an exporter thread through a submission ring, which waits for
+// the device spans' events and hands the spans to a SpanExporter. Requests left unsampled
+// cost a counter increment; events and attribute lists are recycled.
+pub struct SpanTracer {
+    sender: RingSender<Entry>,
+    options: SpanOptions,
+    clock: Clock,
+    ids: Arc<SpanIds>,
+    requests: AtomicU64,
+    pools: Arc<Pools>,
+    dropped: Arc<AtomicU64>,
+    writer: Mutex<Option<JoinHandle<()>>>,
+}
+
+impl SpanTracer {
+    pub fn new<E: SpanExporter>(exporter: E, options: SpanOptions) -> Arc<Self> {
+        let (sender, receiver) = submission_ring(options.capacity);
+        let ids = Arc::new(SpanIds::new());
+        let pools = Arc::new(Pools {
+            events: ArrayQueue::new(options.max_events.max(1)),
+            created: AtomicUsize::new(0),
+            attributes: ArrayQueue::new(POOLED_ATTRIBUTES),
+        });
+        let dropped = Arc::new(AtomicU64::new(0));
+        let writer = {
+            let (ids, pools, dropped) = (ids.clone(), pools.clone(), dropped.clone());
+            // the events are waited for on the device they were recorded on
+            let device = device::get_device();
+            thread::spawn(move || {
+                if let Some(device) = device {
+                    device::set_device(device);
+                }
+                export_entries(receiver, exporter, &ids, &pools, &dropped);
+            })
+        };
+        let clock = Clock {
+            start: Instant::now(),
+            start_unix: SystemTime::now().duration_since(UNIX_EPOCH).unwrap_or_default(),
+        };
+        Arc::new(Self {
+            sender,
+            options,
+            clock,
+            ids,
+            requests: AtomicU64::new(0),
+            pools,
+            dropped,
+            writer: Mutex::new(Some(writer)),
+        })
+    }
+
+    pub fn options(&self) -> &SpanOptions {
+        &self.options
+    }
+
+    // Spans lost to a full ring or a failed export.
+    pub fn dropped(&self) -> u64 {
+        self.dropped.load(Ordering::Relaxed)
+    }
+
+    // The span of a request, when it is traced: within `parent` when that trace is sampled,
+    // otherwise in a trace of its own for every sample_every-th request.
+    pub(crate) fn start(&self, parent: Option<&TraceContext>) -> Option<OpenSpan> {
+        let (trace_id, parent_span_id) = match parent {
+            Some(parent) if parent.sampled => (parent.trace_id, parent.span_id),
+            Some(_) => return None,
+            None => {
+                let request = self.requests.fetch_add(1, Ordering::Relaxed);
+                if self.options.sample_every == 0 || request % self.options.sample_every != 0 {
+                    return None;
+                }
+                (self.ids.trace_id(), 0)
+            }
+        };
+        Some(self.open(trace_id, parent_span_id, Instant::now()))
+    }
+
+    pub(crate) fn child(&self, parent: &TraceContext, start: Instant) -> OpenSpan {
+        self.open(parent.trace_id, parent.span_id, start)
+    }
+
+    // A span starting a trace of its own whatever the sampling, e.g. a batch of sampled
+    // requests.
+    pub(crate) fn root(&self, start: Instant) -> OpenSpan {
+        self.open(self.ids.trace_id(), 0, start)
+    }
+
+    fn open(&self, trace_id: u128, parent_span_id: u64, start: Instant) -> OpenSpan {
+        OpenSpan {
+            context: TraceContext { trace_id, span_id: self.ids.next(), sampled: true },
+            parent_span_id,
+            start,
+            attributes: self.pools.attributes.pop().unwrap_or_default(),
+            links: Vec::new(),
+            failed: false,
+        }
+    }
+
+    pub(crate) fn finish(&self, span: OpenSpan, name: &'static str, end: Instant) {
+        let OpenSpan { context, parent_span_id, start, attributes, links, failed } = span;
+        let record = SpanRecord {
+            trace_id: context.trace_id,
+            span_id: context.span_id,
+            parent_span_id,
+            name,
+            start: self.clock.unix(start),
+            end: self.clock.unix(end),
+            attributes,
+            links,
+            failed,
+        };
+        if let Err(Entry::Span(record)) = self.sender.push(Entry::Span(record)) {
+            self.dropped.fetch_add(1, Ordering::Relaxed);
+            self.pools.recycle(record.attributes);
+        }
+    }
+
+    // `marks` events out of the pool, None while they are all in flight.
+    pub(crate) fn timeline(&self, marks: usize) -> Option<Timeline> {
+        let mut events = Vec::with_capacity(marks);
+        for _ in 0..marks {
+            match self.pools.take_event() {
+                Some(event) => events.push(event),
+                None => {
+                    for event in events {
+                        self.pools.events.push(event).ok();
+                    }
+                    return None;
+                }
+            }
+        }
+        let anchor = self.clock.unix(Instant::now());
+        Some(Timeline { events, anchor, recorded: true, pools: self.pools.clone() })
+    }
+
+    // Exports the stages of `timeline` as children of `parent` once its marks completed.
+    pub(crate) fn finish_timeline(&self, timeline: Timeline, parent: &TraceContext, stages: &'static [Stage]) {
+        let entry = Entry::Device(DeviceSpans { parent: *parent, timeline, stages });
+        if self.sender.push(entry).is_err() {
+            self.dropped.fetch_add(stages.len() as u64, Ordering::Relaxed);
+        }
+    }
+}
+
+impl Drop for SpanTracer {
+    fn drop(&mut self) {
+        self.sender.close();
+        if let Some(writer) = self.writer.lock().unwrap().take() {
+            writer.join().ok();
+        }
+    }
+}
+
+fn export_entries<E: SpanExporter>(
+    mut receiver: RingReceiver<Entry>,
+    mut exporter: E,
+    ids: &SpanIds,
+    pools: &Pools,
+    dropped: &AtomicU64,
+) {
+    let mut entries = Vec::new();
+    let mut spans = Vec::new();
+    loop {
+        // read first, so everything pushed before the close is exported below
+        let closed = receiver.is_closed();
+        if receiver.pop_batch(&mut entries, 64) == 0 {
+            if closed {
+                break;
+            }
+            exporter.flush().ok();
+            receiver.wait(None);
+            continue;
+        }
+        for entry in entries.drain(..) {
+            match entry {
+                Entry::Span(span) => spans.push(span),
+                Entry::Device(device) => resolve(device, ids, &mut spans, dropped),
+            }
+        }
+        if exporter.export(&spans).is_err() {
+            dropped.fetch_add(spans.len() as u64, Ordering::Relaxed);
+        }
+        for span in spans.drain(..) {
+            pools.recycle(span.attributes);
+        }
+    }
+    exporter.flush().ok();
+}
+
+fn resolve(device: DeviceSpans, ids: &SpanIds, spans: &mut Vec<SpanRecord>, dropped: &AtomicU64) {
+    let DeviceSpans { parent, timeline, stages } = device;
+    let events = &timeline.events;
+    let completed = timeline.recorded && events.iter().all(|event| event.synchronize());
+    for &(name, first, last) in stages {
+        let times = match completed {
+            true => (events[first].elapsed_ms_since(&events[0]), events[last].elapsed_ms_since(&events[0])),
+            false => (None, None),
+        };
+        let (start, end) = match times {
+            (Some(start), Some(end)) => (start.max(0.0), end.max(start)),
+            _ => {
+                dropped.fetch_add(1, Ordering::Relaxed);
+                continue;
+            }
+        };
+        let at = |ms: f32| timeline.anchor + Duration::from_secs_f64(ms as f64 / 1e3);
+        spans.push(SpanRecord {
+            trace_id: parent.trace_id,
+            span_id: ids.next(),
+            parent_span_id: parent.span_id,
+            name,
+            start: at(start),
+            end: at(end),
+            attributes: Vec::new(),
+            links: Vec::new(),
+            failed: false,
+        });
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn traceparent_round_trips() {
+        let header = "00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-01";
+        let context = TraceContext::from_traceparent(header).unwrap();
+        assert_eq!(context.trace_id, 0x4bf92f3577b34da6a3ce929d0e0e4736);
+        assert_eq!(context.span_id, 0x00f067aa0ba902b7);
+        assert!(context.sampled);
+        assert_eq!(context.traceparent(), header);
+
+        assert!(!TraceContext::from_traceparent("00-4bf92f3577b34da6a3ce929d0e0e4736-00f067aa0ba902b7-00")
+            .unwrap()
+            .sampled);
+        // uppercase hex, an all-zero id, and extra fields in version 00 are invalid
+        assert!(TraceContext::from_traceparent("00-4BF92F3577B34DA6A3CE929D0E0E4736-00f067aa0ba902b7-01").is_none());
+        assert!(TraceContext::from_traceparent("00-00000000000000000000000000000000-00f067aa0ba902b7-01").is_none());
+        assert!(TraceContext::from_traceparent(&format!("{}-00", header)).is_none());
+        assert!(TraceContext::from_traceparent(&format!("01{}-00", &header[2..])).is_some());
+    }
+
+    #[test]
+    fn spans_encode_as_otlp_json() {
+        let span = SpanRecord {
+            trace_id: 1,
+            span_id: 2,
+            parent_span_id: 3,
+            name: "trt.gpu",
+            start: Duration::from_nanos(10),
+            end: Duration::from_nanos(20),
+            attributes: vec![
+                ("trt.batch.id".into(), SpanValue::Int(7)),
+                ("trt.input.x".into(), SpanValue::Shape(Shape::new(&[2, 3]))),
+            ],
+            links: vec![TraceContext { trace_id: 4, span_id: 5, sampled: true }],
+            failed: true,
+        };
+        let mut out = String::new();
+        encode_otlp("svc \"a\"", &[span], &mut out);
+        assert!(out.starts_with("{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\""));
+        assert!(out.contains("\"stringValue\":\"svc \\\"a\\\"\""));
+        assert!(out.contains("\"traceId\":\"00000000000000000000000000000001\",\"spanId\":\"0000000000000002\""));
+        assert!(out.contains("\"parentSpanId\":\"0000000000000003\",\"name\":\"trt.gpu\",\"kind\":1"));
+        assert!(out.contains("\"startTimeUnixNano\":\"10\",\"endTimeUnixNano\":\"20\""));
+        assert!(out.contains("{\"key\":\"trt.batch.id\",\"value\":{\"intValue\":\"7\"}}"));
+        assert!(out.contains("{\"arrayValue\":{\"values\":[{\"intValue\":\"2\"},{\"intValue\":\"3\"}]}}"));
+        assert!(out.contains("\"links\":[{\"traceId\":\"00000000000000000000000000000004\""));
+        assert!(out.ends_with(",\"status\":{\"code\":2}}]}]}]}"));
+    }
+}
@@ -0,0 +1,208 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    mempool::DeviceMemoryPool,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{collections::HashMap, sync::Arc};
+use tensorrt_rs_sys::{
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    numa,
+    runtime::DataType,
+    stream::CudaEvent,
+};
+
+// Offsets of the inputs packed by upload_gathered, as TensorRT wants bindings aligned.
+const GATHER_ALIGNMENT: usize = 256;
+
+pub(crate) fn pinned(size: usize) -> TRTResult<PinnedMemory> {
+    match PinnedMemory::new(size) {
+        Some(mem) => Ok(mem),
+        None => Err(TRTError::AllocatorError),
+    }
+}
+
+// Pinned memory on NUMA `node` if given, else (or if the node cannot hold it) wherever
+// the allocating thread runs.
+pub(crate) fn pinned_on(size: usize, node: Option<i32>) -> TRTResult<PinnedMemory> {
+    if let Some(mem) = node.and_then(|node| PinnedMemory::new_on_node(size, node)) {
+        return Ok(mem);
+    }
+    pinned(size)
+}
+
+pub(crate) fn event() -> TRTResult<CudaEvent> {
+    match CudaEvent::new() {
+        Some(event) => Ok(event),
+        None => Err(TRTError::EventError),
+    }
+}
+
+struct StagingSlot {
+    mem: PinnedMemory,
+    // recorded after the last copy out of `mem`; the slot is reusable once it completes
+    released: CudaEvent,
+}
+
+// A ring of page-locked host buffers for uploads from pageable memory (a Vec<f32>, a tch
+// tensor). Host data is memcpy'd into the next pinned slot and copied to the device
+// asynchronously, so the caller neither blocks on the DMA nor goes through the driver's
+// pageable bounce path. A slot is only rewritten after its previous copy has completed.
+pub struct StagingRing {
+    slots: Vec<StagingSlot>,
+    next: usize,
+    node: Option<i32>,
+}
+
+impl StagingRing {
+    pub fn new(num_slots: usize, slot_size: usize) -> TRTResult<Self> {
+        Self::with_node(num_slots, slot_size, None)
+    }
+
+    // Slots on the NUMA node closest to `device`, which is what bounds H2D bandwidth on
+    // multi-socket hosts.
+    pub fn for_device(num_slots: usize, slot_size: usize, device: i32) -> TRTResult<Self> {
+        Self::with_node(num_slots, slot_size, numa::get_device_node(device))
+    }
+
+    fn with_node(num_slots: usize, slot_size: usize, node: Option<i32>) -> TRTResult<Self> {
+        let mut slots = Vec::with_capacity(num_slots.max(1));
+        for _ in 0..num_slots.max(1) {
+            slots.push(StagingSlot { mem: pinned_on(slot_size, node)?, released: event()? });
+        }
+        Ok(Self { slots, next: 0, node })
+    }
+
+    pub fn num_slots(&self) -> usize {
+        self.slots.len()
+    }
+
+    // Stages `data` and enqueues its copy into `dst` on `stream`. Slots grow on demand.
+    pub fn upload(&mut self, data: &[u8], dst: &Tensor, stream: &CuStream) -> TRTResult<()> {
+        if data.len() > dst.capacity() * dst.dtype().get_elem_size() {
+            return Err(TRTError::ShapeMismatch);
+        }
+
+        let slot = self.next_slot(data.len())?;
+        unsafe {
+            slot.mem.as_mut_slice()[..data.len()].copy_from_slice(data);
+        }
+        Self::copy_out(slot, unsafe { dst.get_raw_ptr() }, data.len(), stream)
+    }
+
+    // Uploads many small inputs (ids, masks, token types, positions) with one H2D copy
+    // instead of one each: they are packed into one slot, copied into one block of `pool`,
+    // and returned as tensors at their offsets in it, for inference_zero_copy or
+    // inference_into to bind in place of the engine's buffers. The block returns to the
+    // pool when the GatheredInputs is dropped, ordered on `stream`, so the inference must
+    // run on `stream` too.
+    pub fn upload_gathered(
+        &mut self,
+        inputs: &[GatherInput<'_>],
+        pool: &Arc<DeviceMemoryPool>,
+        stream: &CuStream,
+    ) -> TRTResult<GatheredInputs> {
+        for input in inputs {
+            if input.data.len() != input.shape.size() * input.dtype.get_elem_size() {
+                return Err(TRTError::ShapeMismatch);
+            }
+        }
+        let offsets = gather_offsets(inputs.iter().map(|input| input.data.len()));
+        let size = offsets.last().copied().unwrap_or(0);
+        let region = Tensor::empty_pooled(&Shape::new(&[size.max(1) as i32]), DataType::UINT8, pool, stream)?;
+        let base = unsafe { region.get_raw_ptr() };
+
+        let slot = self.next_slot(size)?;
+        let staged = unsafe { slot.mem.as_mut_slice() };
+        for (input, &offset) in inputs.iter().zip(&offsets) {
+            staged[offset..offset + input.data.len()].copy_from_slice(input.data);
+        }
+        Self::copy_out(slot, base, size, stream)?;
+
+        let tensors = inputs
+            .iter()
+            .zip(&offsets)
+            .map(|(input, &offset)| {
+                (input.name.to_string(), Tensor::from_raw_ptr(base + offset, input.shape, input.dtype, stream))
+            })
+            .collect();
+        Ok(GatheredInputs { tensors, region })
+    }
+
+    // The next slot, once its previous copy has completed, holding at least `size` bytes.
+    fn next_slot(&mut self, size: usize) -> TRTResult<&mut StagingSlot> {
+        let slot = &mut self.slots[self.next];
+        self.next = (self.next + 1) % self.slots.len();
+
+        if !slot.released.synchronize() {
+            return Err(TRTError::EventError);
+        }
+        if slot.mem.len() < size {
+            slot.mem = pinned_on(size, self.node)?;
+        }
+        Ok(slot)
+    }
+
+    fn copy_out(slot: &StagingSlot, dst: usize, size: usize, stream: &CuStream) -> TRTResult<()> {
+        if size > 0 && !unsafe { memcpy_async(dst, slot.mem.get_raw(), size, MemcpyKind::HostToDevice, stream) } {
+            return Err(TRTError::MemcpyError);
+        }
+        if !slot.released.record(stream) {
+            return Err(TRTError::EventError);
+        }
+        Ok(())
+    }
+}
+
+// One host input of StagingRing::upload_gathered; `data` holds exactly `shape`.
+#[derive(Debug, Copy, Clone)]
+pub struct GatherInput<'a> {
+    pub name: &'a str,
+    pub shape: &'a Shape,
+    pub dtype: DataType,
+    pub data: &'a [u8],
+}
+
+// Inputs uploaded together: one device block holding all of them, and a tensor per input
+// viewing its part of it.
+pub struct GatheredInputs {
+    tensors: HashMap<String, Tensor>,
+    // declared after the views of it
+    region: Tensor,
+}
+
+impl GatheredInputs {
+    pub fn get(&self, name: &str) -> Option<&Tensor> {
+        self.tensors.get(name)
+    }
+
+    pub fn feed_dict(&self) -> HashMap<&str, &Tensor> {
+        self.tensors.iter().map(|(name, tensor)| (name.as_str(), tensor)).collect()
+    }
+
+    // Bytes of the block, alignment padding included.
+    pub fn size(&self) -> usize {
+        self.region.size_in_bytes()
+    }
+}
+
+// Aligned offset of every input, then the end of the last one.
+fn gather_offsets(sizes: impl Iterator<Item = usize>) -> Vec<usize> {
+    let mut offsets = vec![0];
+    for size in sizes {
+        let end = offsets.last().unwrap() + size;
+        offsets.push((end + GATHER_ALIGNMENT - 1) / GATHER_ALIGNMENT * GATHER_ALIGNMENT);
+    }
+    offsets
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn gathered_inputs_are_aligned() {
+        assert_eq!(gather_offsets([8, 300, 256].into_iter()), vec![0, 256, 768, 1024]);
+        assert_eq!(gather_offsets(std::iter::empty()), vec![0]);
+    }
+}
@@ -0,0 +1,116 @@
+use crate::{
+    arena::DeviceMemoryArena,
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    plan::{PlanFile, PlanLoadOptions},
+    profile::ProfileSelector,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{collections::HashMap, path::Path, sync::Arc};
+
+// One execution context per optimization profile of an engine, each bound to its profile,
+// its IO allocated and warmed once, so a request for another profile switches contexts
+// rather than calling set_optimization_profile, which re-binds every tensor and drops the
+// captured graphs. The contexts run one at a time on one stream out of one scratch arena,
+// so the standby contexts cost their IO tensors but no activation memory of their own.
+pub struct ProfileContexts {
+    // indexed by profile
+    contexts: Vec<TRTEngine>,
+    selector: ProfileSelector,
+    arena: Arc<DeviceMemoryArena>,
+    active: usize,
+    switches: u64,
+}
+
+impl ProfileContexts {
+    pub fn new<P, F>(engine_path: &P, options: &PlanLoadOptions, stream: &CuStream, setup: F) -> TRTResult<Self>
+    where
+        P: AsRef<Path>,
+        F: FnMut(i32, &mut TRTEngine) -> TRTResult<()>,
+    {
+        let plan = PlanFile::open(engine_path, options)?;
+        let contexts = Self::from_bytes(plan.as_bytes(), stream, setup)?;
+        plan.release()?;
+        Ok(contexts)
+    }
+
+    // `setup` runs once per context after it is bound to its profile, typically to call
+    // allocate_io_tensors with that profile's max shapes and warm up.
+    pub fn from_bytes<F>(data: &[u8], stream: &CuStream, mut setup: F) -> TRTResult<Self>
+    where
+        F: FnMut(i32, &mut TRTEngine) -> TRTResult<()>,
+    {
+        let first = TRTEngine::from_bytes(data, stream)?;
+        let core = first.core()?;
+        let selector = first.get_profile_selector()?;
+        let arena = Arc::new(DeviceMemoryArena::for_engines(&[&first], stream)?);
+
+        let mut contexts = vec![first];
+        for _ in 1..selector.num_profiles().max(1) {
+            contexts.push(TRTEngine::from_core(core.clone(), stream));
+        }
+        for (profile, engine) in contexts.iter_mut().enumerate() {
+            engine.activate_with_arena_for_profile(&arena, profile as i32)?;
+            setup(profile as i32, engine)?;
+        }
+
+        Ok(Self { contexts, selector, arena, active: 0, switches: 0 })
+    }
+
+    // The context of the tightest profile accepting `shapes`.
+    pub fn select(&mut self, shapes: &HashMap<&str, &Shape>) -> TRTResult<&mut TRTEngine> {
+        let profile = match self.contexts.len() {
+            1 => 0,
+            _ => match self.selector.select(shapes) {
+                Some(profile) => profile,
+                None => return Err(TRTError::ShapeMismatch),
+            },
+        };
+        self.activate(profile as usize)
+    }
+
+    pub fn context(&mut self, profile: i32) -> TRTResult<&mut TRTEngine> {
+        match profile >= 0 && (profile as usize) < self.contexts.len() {
+            true => self.activate(profile as usize),
+            false => Err(TRTError::ProfileError(profile)),
+        }
+    }
+
+    // TRTEngine::inference on the context selected for the shapes of `feed_dict`. Must run
+    // on the contexts' stream, which orders them around the shared arena.
+    pub fn inference(&mut self, feed_dict: &HashMap<&str, &Tensor>) -> TRTResult<&HashMap<String, Tensor>> {
+        let shapes = feed_dict.iter().map(|(name, tensor)| (*name, tensor.shape())).collect();
+        self.select(&shapes)?.inference(feed_dict, None)
+    }
+
+    fn activate(&mut self, profile: usize) -> TRTResult<&mut TRTEngine> {
+        if profile != self.active {
+            self.active = profile;
+            self.switches += 1;
+        }
+        Ok(&mut self.contexts[profile])
+    }
+
+    // Profile of the context used last.
+    pub fn active(&self) -> i32 {
+        self.active as i32
+    }
+
+    pub fn num_profiles(&self) -> usize {
+        self.contexts.len()
+    }
+
+    // Times a request went to another profile's context than the one before it.
+    pub fn num_switches(&self) -> u64 {
+        self.switches
+    }
+
+    pub fn scratch_size(&self) -> usize {
+        self.arena.size()
+    }
+
+    pub fn profile_selector(&self) -> &ProfileSelector {
+        &self.selector
+    }
+}
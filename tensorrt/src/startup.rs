@@ -0,0 +1,98 @@
+use std::{fmt::Write, time::Duration};
+
+// The phases of bringing an engine up, in the order they run.
+#[derive(Debug, Copy, Clone, PartialEq, Eq, Hash)]
+pub enum StartupPhase {
+    // opening the plan: a read into memory or an mmap, see PlanLoadOptions
+    PlanRead,
+    // plugin libraries, loaded outside the engine and recorded with TRTEngine::record_startup
+    PluginLoad,
+    RuntimeCreation,
+    // deserializeCudaEngine; for plans streamed from a reader, their reading as well
+    Deserialize,
+    ContextCreation,
+    // allocate_io_tensors
+    IoAllocation,
+    Warmup,
+}
+
+impl StartupPhase {
+    pub const ALL: [Self; 7] = [
+        Self::PlanRead,
+        Self::PluginLoad,
+        Self::RuntimeCreation,
+        Self::Deserialize,
+        Self::ContextCreation,
+        Self::IoAllocation,
+        Self::Warmup,
+    ];
+
+    pub fn name(&self) -> &'static str {
+        match self {
+            Self::PlanRead => "plan_read",
+            Self::PluginLoad => "plugin_load",
+            Self::RuntimeCreation => "runtime_creation",
+            Self::Deserialize => "deserialize",
+            Self::ContextCreation => "context_creation",
+            Self::IoAllocation => "io_allocation",
+            Self::Warmup => "warmup",
+        }
+    }
+
+    pub(crate) fn index(&self) -> usize {
+        Self::ALL.iter().position(|phase| phase == self).unwrap()
+    }
+}
+
+// Wall time of every startup phase of one engine (TRTEngine::startup_timings). Phases that
+// run again, e.g. a second activate, add up. Contexts created from an already deserialized
+// engine (EnginePool, SharedEngine) have no read or deserialization of their own.
+#[derive(Debug, Clone, Default, PartialEq, Eq)]
+pub struct StartupTimings {
+    phases: [Option<Duration>; 7],
+}
+
+impl StartupTimings {
+    pub fn record(&mut self, phase: StartupPhase, duration: Duration) {
+        let slot = &mut self.phases[phase.index()];
+        *slot = Some(slot.unwrap_or_default() + duration);
+    }
+
+    // None for phases that did not run.
+    pub fn get(&self, phase: StartupPhase) -> Option<Duration> {
+        self.phases[phase.index()]
+    }
+
+    pub fn total(&self) -> Duration {
+        self.phases.iter().flatten().sum()
+    }
+
+    // {"plan_read_ms":1.5,...,"total_ms":..}, with the phases that ran.
+    pub fn to_json(&self) -> String {
+        let mut out = String::from("{");
+        for phase in StartupPhase::ALL {
+            if let Some(duration) = self.get(phase) {
+                write!(out, "\"{}_ms\":{},", phase.name(), duration.as_secs_f64() * 1000.0).ok();
+            }
+        }
+        write!(out, "\"total_ms\":{}}}", self.total().as_secs_f64() * 1000.0).ok();
+        out
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn phases_add_up() {
+        let mut timings = StartupTimings::default();
+        timings.record(StartupPhase::Deserialize, Duration::from_millis(40));
+        timings.record(StartupPhase::ContextCreation, Duration::from_millis(2));
+        timings.record(StartupPhase::ContextCreation, Duration::from_millis(3));
+        assert_eq!(timings.get(StartupPhase::ContextCreation), Some(Duration::from_millis(5)));
+        assert_eq!(timings.get(StartupPhase::PlanRead), None);
+        assert_eq!(timings.total(), Duration::from_millis(45));
+        assert_eq!(timings.to_json(), "{\"deserialize_ms\":40,\"context_creation_ms\":5,\"total_ms\":45}");
+    }
+}
@@ -0,0 +1,208 @@
+use crate::{
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::HashMap,
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Mutex,
+    },
+};
+use tensorrt_rs_sys::{memory::memset_async, stream::CudaEvent};
+
+// An output of a stateful engine that is fed back as an input on the next step, e.g. the
+// KV cache of a decoder or the hidden state of an RNN.
+#[derive(Debug, Clone, PartialEq)]
+pub struct StateBinding {
+    pub input: String,
+    pub output: String,
+}
+
+impl StateBinding {
+    pub fn new(input: &str, output: &str) -> Self {
+        Self { input: input.to_string(), output: output.to_string() }
+    }
+}
+
+// The state of one sequence of a stateful engine (see TRTEngine::inference_stateful): two
+// persistent buffers per StateBinding, which the steps read and write in turn. A step's
+// output state becomes the next step's input by swapping the buffers' roles, never through
+// copy_from. A session is tied to no context, so any context of the engine may run its
+// next step; the steps themselves are ordered through an event.
+pub struct StateSession {
+    states: Vec<State>,
+    steps: u64,
+    // recorded after each step, on the stream it ran on
+    written: Option<CudaEvent>,
+}
+
+struct State {
+    binding: StateBinding,
+    buffers: [Tensor; 2],
+    // the buffer holding the current state, read by the next step
+    current: usize,
+}
+
+impl StateSession {
+    // `initial` is the shape of every state input at the first step, e.g. a KV cache of
+    // length 0; the state starts zeroed. Buffers are sized for the largest shape any profile
+    // accepts for the input, so a step whose output state outgrows it fails.
+    pub fn new(
+        engine: &TRTEngine,
+        bindings: &[StateBinding],
+        initial: &HashMap<&str, &Shape>,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        let schema = engine.io_schema()?;
+        let mut states = Vec::with_capacity(bindings.len());
+        for binding in bindings {
+            let (input, output) = match (schema.get(&binding.input), schema.get(&binding.output)) {
+                (Some(input), Some(output)) if input.is_input() && output.is_output() => (input, output),
+                (Some(_), Some(_)) => {
+                    return Err(TRTError::StateBindingError(binding.input.clone(), binding.output.clone()))
+                }
+                (None, _) => return Err(TRTError::TensorNotFound(binding.input.clone())),
+                (_, None) => return Err(TRTError::TensorNotFound(binding.output.clone())),
+            };
+            if input.dtype != output.dtype {
+                return Err(TRTError::DTypeMismatch);
+            }
+            let shape = match (initial.get(binding.input.as_str()), input.is_dynamic()) {
+                (Some(&shape), _) => *shape,
+                (None, false) => input.shape,
+                (None, true) => return Err(TRTError::ShapeError(input.shape.to_vec())),
+            };
+            let capacity = input.profiles.iter().flatten().map(|range| range.max.size()).max().unwrap_or(0);
+            let capacity = capacity.max(shape.size());
+            let buffer = || Tensor::with_capacity(&shape, capacity, input.dtype, stream);
+            let buffers = [buffer()?, buffer()?];
+            states.push(State { binding: binding.clone(), buffers, current: 0 });
+        }
+        let mut session = Self { states, steps: 0, written: None };
+        session.zero(stream)?;
+        Ok(session)
+    }
+
+    // Starts the session over from zeroed state of the `initial` shapes, e.g. to reuse its
+    // buffers for another sequence. Inputs not listed keep their current shape.
+    pub fn reset(&mut self, initial: &HashMap<&str, &Shape>, stream: &CuStream) -> TRTResult<()> {
+        self.wait(stream)?;
+        for state in self.states.iter_mut() {
+            state.current = 0;
+            if let Some(&shape) = initial.get(state.binding.input.as_str()) {
+                unsafe { state.buffers[0].reset_shape(shape)? };
+            }
+        }
+        self.steps = 0;
+        self.zero(stream)
+    }
+
+    fn zero(&mut self, stream: &CuStream) -> TRTResult<()> {
+        for state in self.states.iter() {
+            let tensor = &state.buffers[state.current];
+            if !unsafe { memset_async(tensor.get_raw_ptr(), 0, tensor.size_in_bytes(), stream) } {
+                return Err(TRTError::MemcpyError);
+            }
+        }
+        self.record(stream)
+    }
+
+    // The current state of the input `name`, as the last step left it.
+    pub fn state(&self, name: &str) -> Option<&Tensor> {
+        let state = self.states.iter().find(|state| state.binding.input == name)?;
+        Some(&state.buffers[state.current])
+    }
+
+    pub fn bindings(&self) -> impl Iterator<Item = &StateBinding> {
+        self.states.iter().map(|state| &state.binding)
+    }
+
+    pub fn steps(&self) -> u64 {
+        self.steps
+    }
+
+    // The state inputs bound to the current buffers and the state outputs to the others.
+    pub(crate) fn bind<'a>(
+        &'a self,
+        inputs: &mut HashMap<&'a str, &'a Tensor>,
+        outputs: &mut HashMap<&'a str, &'a Tensor>,
+    ) {
+        for state in self.states.iter() {
+            inputs.insert(&state.binding.input, &state.buffers[state.current]);
+            outputs.insert(&state.binding.output, &state.buffers[1 - state.current]);
+        }
+    }
+
+    // Makes `stream` wait for the previous step, which may have run on another context.
+    pub(crate) fn wait(&self, stream: &CuStream) -> TRTResult<()> {
+        match &self.written {
+            Some(event) if !event.wait(stream) => Err(TRTError::EventError),
+            _ => Ok(()),
+        }
+    }
+
+    // After a step: the buffers written take the output shapes the step resolved and hold
+    // the current state.
+    pub(crate) fn advance(&mut self, tensors: &HashMap<String, Tensor>, stream: &CuStream) -> TRTResult<()> {
+        for state in self.states.iter_mut() {
+            let next = 1 - state.current;
+            if let Some(resolved) = tensors.get(&state.binding.output) {
+                if state.buffers[next].shape() != resolved.shape() {
+                    unsafe { state.buffers[next].reset_shape(resolved.shape())? };
+                }
+            }
+            state.current = next;
+        }
+        self.steps += 1;
+        self.record(stream)
+    }
+
+    fn record(&mut self, stream: &CuStream) -> TRTResult<()> {
+        if self.written.is_none() {
+            self.written = CudaEvent::new();
+        }
+        match &self.written {
+            Some(event) if event.record(stream) => Ok(()),
+            _ => Err(TRTError::EventError),
+        }
+    }
+}
+
+// StateSessions by id, for a pool whose contexts take turns at the steps of many sequences
+// (see EnginePool::open_session). A session is taken out for the duration of a step, so
+// two steps of one session never run at once.
+#[derive(Default)]
+pub(crate) struct SessionSlots {
+    sessions: Mutex<HashMap<u64, StateSession>>,
+    next_id: AtomicU64,
+}
+
+impl SessionSlots {
+    pub(crate) fn insert(&self, session: StateSession) -> u64 {
+        let id = self.next_id.fetch_add(1, Ordering::Relaxed);
+        self.sessions.lock().unwrap().insert(id, session);
+        id
+    }
+
+    pub(crate) fn take(&self, id: u64) -> TRTResult<StateSession> {
+        match self.sessions.lock().unwrap().remove(&id) {
+            Some(session) => Ok(session),
+            None => Err(TRTError::SessionNotFound(id)),
+        }
+    }
+
+    pub(crate) fn put(&self, id: u64, session: StateSession) {
+        self.sessions.lock().unwrap().insert(id, session);
+    }
+
+    pub(crate) fn remove(&self, id: u64) -> Option<StateSession> {
+        self.sessions.lock().unwrap().remove(&id)
+    }
+
+    pub(crate) fn len(&self) -> usize {
+        self.sessions.lock().unwrap().len()
+    }
+}
@@ -0,0 +1,58 @@
+use crate::{
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    tensor::Tensor,
+};
+use cuda_rs::stream::CuStream;
+
+// A static-shape engine with its I inputs and O outputs fixed at compile time. Inputs and
+// outputs are positional, so a call builds no feed dict and looks nothing up by name: it is
+// the input copies plus enqueueV3 (or the captured graph).
+pub struct StaticEngine<const I: usize, const O: usize> {
+    engine: TRTEngine,
+    inputs: [String; I],
+    outputs: [String; O],
+}
+
+impl<const I: usize, const O: usize> StaticEngine<I, O> {
+    // `engine` must be activated with its IO tensors allocated, and every IO shape static.
+    pub fn new(engine: TRTEngine, inputs: [&str; I], outputs: [&str; O]) -> TRTResult<Self> {
+        if !engine.is_static() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        for name in inputs.iter() {
+            if !engine.input_names().iter().any(|input| input == name) {
+                return Err(TRTError::TensorNotFound(name.to_string()));
+            }
+        }
+        for name in outputs.iter() {
+            if !engine.output_names().iter().any(|output| output == name) {
+                return Err(TRTError::TensorNotFound(name.to_string()));
+            }
+        }
+        Ok(Self {
+            engine,
+            inputs: inputs.map(str::to_string),
+            outputs: outputs.map(str::to_string),
+        })
+    }
+
+    pub fn infer(&mut self, inputs: [&Tensor; I], stream: Option<&CuStream>) -> TRTResult<[&Tensor; O]> {
+        let feed = self.inputs.iter().map(String::as_str).zip(inputs);
+        let tensors = self.engine.inference_static(feed, stream)?;
+        let outputs = &self.outputs;
+        Ok(std::array::from_fn(|i| &tensors[&outputs[i]]))
+    }
+
+    pub fn engine(&self) -> &TRTEngine {
+        &self.engine
+    }
+
+    pub fn engine_mut(&mut self) -> &mut TRTEngine {
+        &mut self.engine
+    }
+
+    pub fn into_inner(self) -> TRTEngine {
+        self.engine
+    }
+}
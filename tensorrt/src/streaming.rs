@@ -0,0 +1,548 @@
+use crate::{
+    batcher::{BatchInput, BatchOutput},
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    nvtx::{self, Category},
+    pipeline::StagedTensor,
+    staging::event,
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::{BTreeMap, HashMap, VecDeque},
+    sync::{Arc, Condvar, Mutex},
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::{
+    memory::{memcpy_async, MemcpyKind},
+    stream::CudaEvent,
+};
+
+// Which frame gives way when a frame arrives at a full queue.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum OverflowPolicy {
+    // The oldest queued frame, so the stream stays as close to live as possible.
+    DropOldest,
+    // The arriving frame.
+    DropNewest,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct StreamingOptions {
+    // Frames waiting for the pipeline; beyond it frames are dropped.
+    pub queue_depth: usize,
+    // Frames in flight on the device, each with its own input and output buffers.
+    pub ring_size: usize,
+    pub overflow: OverflowPolicy,
+    // Frames that waited longer than this are dropped instead of run.
+    pub max_age: Option<Duration>,
+    // Replays every frame from a CUDA graph captured once per ring slot.
+    pub cuda_graphs: bool,
+}
+
+impl Default for StreamingOptions {
+    fn default() -> Self {
+        Self { queue_depth: 4, ring_size: 3, overflow: OverflowPolicy::DropOldest, max_age: None, cuda_graphs: true }
+    }
+}
+
+#[derive(Debug, Copy, Clone, Default, PartialEq, Eq)]
+pub struct StreamStats {
+    pub pushed: u64,
+    pub completed: u64,
+    pub dropped: u64,
+}
+
+// The outputs of one frame, or TRTError::FrameDropped.
+pub struct FrameResult {
+    pub sequence: u64,
+    pub outputs: TRTResult<Vec<BatchOutput>>,
+}
+
+struct Frame {
+    sequence: u64,
+    inputs: Vec<BatchInput>,
+    arrival: Instant,
+}
+
+#[derive(Default)]
+struct State {
+    queue: VecDeque<Frame>,
+    // finished or dropped frames not yet pulled, by sequence
+    results: BTreeMap<u64, TRTResult<Vec<BatchOutput>>>,
+    next_sequence: u64,
+    next_result: u64,
+    closed: bool,
+    // no more results will be published
+    finished: bool,
+    stats: StreamStats,
+}
+
+impl State {
+    fn publish(&mut self, sequence: u64, outputs: TRTResult<Vec<BatchOutput>>) {
+        match outputs.is_ok() {
+            true => self.stats.completed += 1,
+            false => self.stats.dropped += 1,
+        }
+        self.results.insert(sequence, outputs);
+    }
+
+    fn drop_frame(&mut self, sequence: u64) {
+        self.publish(sequence, Err(TRTError::FrameDropped));
+    }
+
+    // Drops the frames at the front that waited longer than `max_age`.
+    fn expire(&mut self, max_age: Option<Duration>, now: Instant) {
+        let max_age = match max_age {
+            Some(max_age) => max_age,
+            None => return,
+        };
+        while let Some(frame) = self.queue.front() {
+            if now.duration_since(frame.arrival) <= max_age {
+                break;
+            }
+            let sequence = frame.sequence;
+            self.queue.pop_front();
+            self.drop_frame(sequence);
+        }
+    }
+
+    // Queues a frame, dropping one if the queue is full. Returns its sequence number.
+    fn push(&mut self, inputs: Vec<BatchInput>, depth: usize, overflow: OverflowPolicy) -> u64 {
+        let sequence = self.next_sequence;
+        self.next_sequence += 1;
+        self.stats.pushed += 1;
+        if self.queue.len() >= depth.max(1) {
+            match overflow {
+                OverflowPolicy::DropOldest => {
+                    let oldest = self.queue.pop_front().unwrap();
+                    self.drop_frame(oldest.sequence);
+                }
+                OverflowPolicy::DropNewest => {
+                    self.drop_frame(sequence);
+                    return sequence;
+                }
+            }
+        }
+        self.queue.push_back(Frame { sequence, inputs, arrival: Instant::now() });
+        sequence
+    }
+
+    // The result of the next frame in order, if it is there.
+    fn pull(&mut self) -> Option<FrameResult> {
+        let outputs = self.results.remove(&self.next_result)?;
+        let sequence = self.next_result;
+        self.next_result += 1;
+        Some(FrameResult { sequence, outputs })
+    }
+}
+
+type Shared = Arc<(Mutex<State>, Condvar)>;
+
+// Cloneable handle used by capture threads to push frames into a FrameStream. Pushing never
+// blocks: a full queue drops a frame instead.
+#[derive(Clone)]
+pub struct FrameSender {
+    shared: Shared,
+    queue_depth: usize,
+    overflow: OverflowPolicy,
+}
+
+impl FrameSender {
+    // The frame's sequence number; its result is pulled in that order, dropped or not.
+    pub fn push(&self, inputs: Vec<BatchInput>) -> TRTResult<u64> {
+        let (state, cond) = &*self.shared;
+        let mut state = state.lock().unwrap();
+        if state.closed {
+            return Err(TRTError::QueueClosed);
+        }
+        let sequence = state.push(inputs, self.queue_depth, self.overflow);
+        cond.notify_all();
+        Ok(sequence)
+    }
+
+    // Stops accepting frames; the stream finishes what is queued and returns.
+    pub fn close(&self) {
+        let (state, cond) = &*self.shared;
+        state.lock().unwrap().closed = true;
+        cond.notify_all();
+    }
+
+    pub fn stats(&self) -> StreamStats {
+        self.shared.0.lock().unwrap().stats
+    }
+}
+
+// Pulls frame results in frame order.
+#[derive(Clone)]
+pub struct FrameReceiver {
+    shared: Shared,
+}
+
+impl FrameReceiver {
+    // Blocks for the next frame's result. None once the stream has finished and every
+    // result was pulled.
+    pub fn next(&self) -> Option<FrameResult> {
+        let (state, cond) = &*self.shared;
+        let mut state = state.lock().unwrap();
+        loop {
+            if let Some(result) = state.pull() {
+                return Some(result);
+            }
+            if state.finished {
+                // a stream that failed may leave gaps
+                state.next_result = *state.results.keys().next()?;
+                continue;
+            }
+            state = cond.wait(state).unwrap();
+        }
+    }
+
+    pub fn try_next(&self) -> Option<FrameResult> {
+        self.shared.0.lock().unwrap().pull()
+    }
+}
+
+struct RingSlot {
+    inputs: HashMap<String, StagedTensor>,
+    outputs: HashMap<String, StagedTensor>,
+    output_shapes: Vec<(String, Shape)>,
+    // recorded on the D2H stream; the slot is free once it completes
+    downloaded: CudaEvent,
+    uploaded: CudaEvent,
+    computed: CudaEvent,
+    // frame in flight in the slot
+    sequence: Option<u64>,
+}
+
+// Continuous inference on a stream of frames, e.g. video. Frames are pushed into a bounded
+// queue through FrameSenders and run by a persistent pipeline driven by `run`: every frame
+// takes the next slot of a ring of pinned host and device buffers, is uploaded on an H2D
+// stream, replayed from the CUDA graph of its slot on the engine's stream, copied out of the
+// engine's buffers into the slot and downloaded on a D2H stream, so consecutive frames
+// overlap. Results are pulled from FrameReceivers in frame order. Under overload frames are
+// dropped (see OverflowPolicy and max_age) rather than queued without bound.
+//
+// Engines with data-dependent output shapes are not supported.
+pub struct FrameStream {
+    shared: Shared,
+    options: StreamingOptions,
+    h2d: CuStream,
+    d2h: CuStream,
+    slots: Vec<RingSlot>,
+    next: usize,
+}
+
+impl FrameStream {
+    // `engine` must already have its IO tensors allocated; slot buffers are sized to match.
+    pub fn new(engine: &mut TRTEngine, options: &StreamingOptions) -> TRTResult<Self> {
+        let h2d = CuStream::new()?;
+        let d2h = CuStream::new()?;
+        let staged = |names: &[String], stream: &CuStream| -> TRTResult<HashMap<String, StagedTensor>> {
+            let mut staged = HashMap::new();
+            for name in names {
+                let tensor = match engine.get_tensor(name) {
+                    Some(tensor) => tensor,
+                    None => return Err(TRTError::TensorNotFound(name.clone())),
+                };
+                staged.insert(name.clone(), StagedTensor::new(tensor, stream)?);
+            }
+            Ok(staged)
+        };
+
+        let mut slots = Vec::with_capacity(options.ring_size.max(1));
+        for _ in 0..options.ring_size.max(1) {
+            slots.push(RingSlot {
+                inputs: staged(engine.input_names(), &h2d)?,
+                outputs: staged(engine.output_names(), &d2h)?,
+                output_shapes: Vec::new(),
+                downloaded: event()?,
+                uploaded: event()?,
+                computed: event()?,
+                sequence: None,
+            });
+        }
+        h2d.synchronize()?;
+        d2h.synchronize()?;
+        if options.cuda_graphs {
+            engine.enable_cuda_graphs(true);
+        }
+
+        Ok(Self {
+            shared: Arc::new((Mutex::new(State::default()), Condvar::new())),
+            options: *options,
+            h2d,
+            d2h,
+            slots,
+            next: 0,
+        })
+    }
+
+    pub fn sender(&self) -> FrameSender {
+        FrameSender {
+            shared: self.shared.clone(),
+            queue_depth: self.options.queue_depth,
+            overflow: self.options.overflow,
+        }
+    }
+
+    pub fn receiver(&self) -> FrameReceiver {
+        FrameReceiver { shared: self.shared.clone() }
+    }
+
+    pub fn options(&self) -> &StreamingOptions {
+        &self.options
+    }
+
+    pub fn num_in_flight(&self) -> usize {
+        self.slots.iter().filter(|slot| slot.sequence.is_some()).count()
+    }
+
+    // Runs frames until every sender closed the stream and the queue is drained. On an error
+    // the frames queued and in flight fail with BatchExecutionError, and it is returned.
+    pub fn run(&mut self, engine: &mut TRTEngine) -> TRTResult<()> {
+        let res = self.serve(engine);
+        self.finish();
+        res
+    }
+
+    fn serve(&mut self, engine: &mut TRTEngine) -> TRTResult<()> {
+        while let Some(frame) = self.next_frame()? {
+            self.submit(engine, frame)?;
+        }
+        self.drain()
+    }
+
+    // Blocks for the next frame to run. Frames in flight are completed first whenever the
+    // queue runs dry, so a frame's result never waits for the next frame to arrive.
+    fn next_frame(&mut self) -> TRTResult<Option<Frame>> {
+        let shared = self.shared.clone();
+        let (state, cond) = &*shared;
+        let mut state = state.lock().unwrap();
+        loop {
+            state.expire(self.options.max_age, Instant::now());
+            if let Some(frame) = state.queue.pop_front() {
+                return Ok(Some(frame));
+            }
+            if state.closed {
+                return Ok(None);
+            }
+            if self.num_in_flight() > 0 {
+                drop(state);
+                self.drain()?;
+                state = shared.0.lock().unwrap();
+                continue;
+            }
+            let _wait = nvtx::range!(Category::Wait, "wait for frame");
+            state = cond.wait(state).unwrap();
+        }
+    }
+
+    fn submit(&mut self, engine: &mut TRTEngine, frame: Frame) -> TRTResult<()> {
+        let _range = nvtx::range!(Category::Pipeline, "stream frame");
+        let index = self.next;
+        if self.slots[index].sequence.is_some() {
+            self.complete(index)?;
+        }
+        let compute = engine.get_stream().clone();
+        let slot = &mut self.slots[index];
+
+        // the slot's previous frame has been downloaded, so all of its buffers are free
+        let upload = nvtx::range!(Category::Copy, "upload frame");
+        for input in &frame.inputs {
+            let staged = match slot.inputs.get_mut(&input.name) {
+                Some(staged) => staged,
+                None => return Err(TRTError::TensorNotFound(input.name.clone())),
+            };
+            let size = input.shape.size() * staged.device.dtype().get_elem_size();
+            if input.data.len() != size || size > staged.host.len() {
+                return Err(TRTError::ShapeMismatch);
+            }
+            unsafe {
+                staged.device.reset_shape(&input.shape)?;
+                staged.host.as_mut_slice()[..size].copy_from_slice(&input.data);
+                if !memcpy_async(
+                    staged.device.get_raw_ptr(),
+                    staged.host.get_raw(),
+                    size,
+                    MemcpyKind::HostToDevice,
+                    &self.h2d,
+                ) {
+                    return Err(TRTError::MemcpyError);
+                }
+            }
+        }
+        if !slot.uploaded.record(&self.h2d) || !slot.uploaded.wait(&compute) {
+            return Err(TRTError::EventError);
+        }
+        drop(upload);
+
+        // the slot's input addresses are part of the graph key, so every slot replays its own
+        let feed_dict: HashMap<&str, &Tensor> =
+            slot.inputs.iter().map(|(name, staged)| (name.as_str(), &staged.device)).collect();
+        engine.inference(&feed_dict, Some(&compute))?;
+
+        // out of the engine's buffers before the next frame's enqueue overwrites them
+        slot.output_shapes.clear();
+        for (name, staged) in slot.outputs.iter() {
+            let shape = engine.get_tensor_shape(name)?;
+            let tensor = match engine.get_tensor(name) {
+                Some(tensor) => tensor,
+                None => return Err(TRTError::TensorNotFound(name.clone())),
+            };
+            let size = shape.size() * tensor.dtype().get_elem_size();
+            if size > staged.host.len() {
+                return Err(TRTError::ShapeMismatch);
+            }
+            let copied = unsafe {
+                memcpy_async(
+                    staged.device.get_raw_ptr(),
+                    tensor.get_raw_ptr(),
+                    size,
+                    MemcpyKind::DeviceToDevice,
+                    &compute,
+                )
+            };
+            if !copied {
+                return Err(TRTError::MemcpyError);
+            }
+            slot.output_shapes.push((name.clone(), shape));
+        }
+        if !slot.computed.record(&compute) || !slot.computed.wait(&self.d2h) {
+            return Err(TRTError::EventError);
+        }
+
+        for (name, shape) in slot.output_shapes.iter() {
+            let staged = &slot.outputs[name];
+            let size = shape.size() * staged.device.dtype().get_elem_size();
+            let copied = unsafe {
+                memcpy_async(
+                    staged.host.get_raw(),
+                    staged.device.get_raw_ptr(),
+                    size,
+                    MemcpyKind::DeviceToHost,
+                    &self.d2h,
+                )
+            };
+            if !copied {
+                return Err(TRTError::MemcpyError);
+            }
+        }
+        if !slot.downloaded.record(&self.d2h) {
+            return Err(TRTError::EventError);
+        }
+
+        slot.sequence = Some(frame.sequence);
+        self.next = (index + 1) % self.slots.len();
+        Ok(())
+    }
+
+    // Completes every frame in flight, oldest first.
+    fn drain(&mut self) -> TRTResult<()> {
+        for i in 0..self.slots.len() {
+            let index = (self.next + i) % self.slots.len();
+            if self.slots[index].sequence.is_some() {
+                self.complete(index)?;
+            }
+        }
+        Ok(())
+    }
+
+    fn complete(&mut self, index: usize) -> TRTResult<()> {
+        let slot = &mut self.slots[index];
+        let wait = nvtx::range!(Category::Wait, "wait for frame outputs");
+        if !slot.downloaded.synchronize() {
+            return Err(TRTError::EventError);
+        }
+        drop(wait);
+
+        let mut outputs = Vec::with_capacity(slot.output_shapes.len());
+        for (name, shape) in slot.output_shapes.iter() {
+            let staged = &slot.outputs[name];
+            let size = shape.size() * staged.device.dtype().get_elem_size();
+            let data = unsafe { staged.host.as_slice()[..size].to_vec() };
+            outputs.push(BatchOutput { name: name.clone(), shape: *shape, data });
+        }
+        let sequence = slot.sequence.take().unwrap();
+
+        let (state, cond) = &*self.shared;
+        state.lock().unwrap().publish(sequence, Ok(outputs));
+        cond.notify_all();
+        Ok(())
+    }
+
+    // Fails whatever is left and wakes the receivers for the last time.
+    fn finish(&mut self) {
+        let in_flight: Vec<u64> = self.slots.iter_mut().filter_map(|slot| slot.sequence.take()).collect();
+        let (state, cond) = &*self.shared;
+        let mut state = state.lock().unwrap();
+        for sequence in in_flight {
+            state.publish(sequence, Err(TRTError::BatchExecutionError));
+        }
+        while let Some(frame) = state.queue.pop_front() {
+            state.publish(frame.sequence, Err(TRTError::BatchExecutionError));
+        }
+        state.closed = true;
+        state.finished = true;
+        cond.notify_all();
+    }
+}
+
+impl Drop for FrameStream {
+    fn drop(&mut self) {
+        // pinned and device buffers must outlive the copies still queued on them
+        self.h2d.synchronize().ok();
+        for slot in self.slots.iter() {
+            slot.downloaded.synchronize();
+        }
+        self.finish();
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn frame() -> Vec<BatchInput> {
+        Vec::new()
+    }
+
+    #[test]
+    fn full_queue_drops_oldest() {
+        let mut state = State::default();
+        for _ in 0..3 {
+            state.push(frame(), 2, OverflowPolicy::DropOldest);
+        }
+        let queued: Vec<u64> = state.queue.iter().map(|frame| frame.sequence).collect();
+        assert_eq!(queued, vec![1, 2]);
+        assert!(matches!(state.pull(), Some(FrameResult { sequence: 0, outputs: Err(TRTError::FrameDropped) })));
+        assert_eq!(state.stats.dropped, 1);
+    }
+
+    #[test]
+    fn full_queue_drops_newest() {
+        let mut state = State::default();
+        for _ in 0..3 {
+            state.push(frame(), 2, OverflowPolicy::DropNewest);
+        }
+        let queued: Vec<u64> = state.queue.iter().map(|frame| frame.sequence).collect();
+        assert_eq!(queued, vec![0, 1]);
+        // frame 2 was dropped, but comes after 0 and 1
+        assert!(state.pull().is_none());
+        state.publish(0, Ok(Vec::new()));
+        state.publish(1, Ok(Vec::new()));
+        let order: Vec<u64> = std::iter::from_fn(|| state.pull()).map(|result| result.sequence).collect();
+        assert_eq!(order, vec![0, 1, 2]);
+    }
+
+    #[test]
+    fn stale_frames_expire() {
+        let mut state = State::default();
+        state.push(frame(), 4, OverflowPolicy::DropOldest);
+        state.push(frame(), 4, OverflowPolicy::DropOldest);
+        let later = state.queue[1].arrival + Duration::from_millis(10);
+        state.expire(Some(Duration::from_millis(5)), later);
+        assert!(state.queue.is_empty());
+        assert_eq!(state.stats.dropped, 2);
+    }
+}
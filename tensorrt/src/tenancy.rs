@@ -0,0 +1,358 @@
+use crate::error::{TRTError, TRTResult};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::VecDeque,
+    sync::{Arc, Condvar, Mutex},
+    time::Duration,
+};
+use tensorrt_rs_sys::stream::CudaEvent;
+
+// Weight of the latest measurement in a tenant's GPU time estimate.
+const ESTIMATE_SMOOTHING: f64 = 0.2;
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct GpuSchedulerOptions {
+    // Runs on the GPU at once over all tenants; a few keep it busy between one run's end and
+    // the next one's launch.
+    pub max_in_flight: usize,
+}
+
+impl Default for GpuSchedulerOptions {
+    fn default() -> Self {
+        Self { max_in_flight: 2 }
+    }
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub struct TenantOptions {
+    // Share of the GPU time among the busy tenants of its tier.
+    pub weight: u32,
+    // Runs of the tenant on the GPU at once; 0 means no cap but the scheduler's.
+    pub max_in_flight: usize,
+    // Lower tiers are served first: a tenant only runs while no tenant of a lower tier waits
+    // and may start, so a busy lower tier starves the higher ones.
+    pub tier: u8,
+    // GPU time a run is charged before the tenant's first one is measured.
+    pub initial_estimate: Duration,
+}
+
+impl Default for TenantOptions {
+    fn default() -> Self {
+        Self { weight: 1, max_in_flight: 1, tier: 0, initial_estimate: Duration::from_millis(1) }
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct TenantUsage {
+    pub name: String,
+    pub weight: u32,
+    pub tier: u8,
+    pub runs: u64,
+    // device time measured over all runs
+    pub gpu_time: Duration,
+    // current per-run estimate
+    pub estimate: Duration,
+    pub in_flight: usize,
+    pub waiting: usize,
+}
+
+struct TenantState {
+    name: String,
+    options: TenantOptions,
+    in_flight: usize,
+    // virtual time the tenant's next run starts at, at the earliest
+    finish: f64,
+    // microseconds of GPU time per run
+    estimate: f64,
+    waiting: VecDeque<u64>,
+    runs: u64,
+    gpu_time: Duration,
+}
+
+impl TenantState {
+    fn cost(&self, micros: f64) -> f64 {
+        micros / self.options.weight.max(1) as f64
+    }
+
+    fn may_start(&self) -> bool {
+        !self.waiting.is_empty() && (self.options.max_in_flight == 0 || self.in_flight < self.options.max_in_flight)
+    }
+}
+
+#[derive(Default)]
+struct State {
+    tenants: Vec<TenantState>,
+    in_flight: usize,
+    // start tag of the latest run started
+    vtime: f64,
+    next_ticket: u64,
+}
+
+impl State {
+    // The tenant whose oldest waiting run starts next: start-time fair queuing within the
+    // lowest tier that can start, where a run's start tag is the later of the virtual time
+    // and the end of its tenant's previous runs, each advancing it by GPU time / weight.
+    fn next(&self) -> Option<usize> {
+        self.tenants
+            .iter()
+            .enumerate()
+            .filter(|(_, tenant)| tenant.may_start())
+            .min_by(|(_, a), (_, b)| {
+                let (start_a, start_b) = (a.finish.max(self.vtime), b.finish.max(self.vtime));
+                let by_start = start_a.total_cmp(&start_b).then(a.waiting[0].cmp(&b.waiting[0]));
+                a.options.tier.cmp(&b.options.tier).then(by_start)
+            })
+            .map(|(index, _)| index)
+    }
+
+    fn start(&mut self, index: usize) -> f64 {
+        let vtime = self.vtime;
+        let tenant = &mut self.tenants[index];
+        let start = tenant.finish.max(vtime);
+        let estimate = tenant.estimate;
+        tenant.finish = start + tenant.cost(estimate);
+        tenant.waiting.pop_front();
+        tenant.in_flight += 1;
+        self.in_flight += 1;
+        self.vtime = start;
+        estimate
+    }
+
+    // Charges the run that was started at `estimate` its measured `gpu_time`, if any.
+    fn complete(&mut self, index: usize, estimate: f64, gpu_time: Option<Duration>) {
+        let tenant = &mut self.tenants[index];
+        if let Some(gpu_time) = gpu_time {
+            let micros = gpu_time.as_secs_f64() * 1e6;
+            tenant.finish += tenant.cost(micros - estimate);
+            tenant.estimate += ESTIMATE_SMOOTHING * (micros - tenant.estimate);
+            tenant.gpu_time += gpu_time;
+        }
+        tenant.runs += 1;
+        tenant.in_flight -= 1;
+        self.in_flight -= 1;
+    }
+}
+
+// Shares one GPU between the engines of several tenants, e.g. models of different customers
+// each with their own TRTEngines, which would otherwise contend freely and let the busiest
+// take the device. Cooperative: tenants enqueue their work through Tenant::run, which waits
+// for the scheduler's turn, so work enqueued around it is not scheduled. Busy tenants of a
+// tier share the GPU time in proportion to their weights, measured with timing events around
+// each run; idle tenants bank no credit, and an idle tenant's share goes to the busy ones.
+pub struct GpuScheduler {
+    options: GpuSchedulerOptions,
+    state: Mutex<State>,
+    changed: Condvar,
+    events: Mutex<Vec<(CudaEvent, CudaEvent)>>,
+}
+
+impl GpuScheduler {
+    pub fn new(options: GpuSchedulerOptions) -> Arc<Self> {
+        Arc::new(Self {
+            options,
+            state: Mutex::new(State::default()),
+            changed: Condvar::new(),
+            events: Mutex::new(Vec::new()),
+        })
+    }
+
+    // Adds a tenant; tenants are kept for the scheduler's lifetime, with their usage.
+    pub fn register(self: &Arc<Self>, name: &str, options: TenantOptions) -> Tenant {
+        let mut state = self.state.lock().unwrap();
+        let vtime = state.vtime;
+        state.tenants.push(TenantState {
+            name: name.to_string(),
+            options,
+            in_flight: 0,
+            finish: vtime,
+            estimate: options.initial_estimate.as_secs_f64() * 1e6,
+            waiting: VecDeque::new(),
+            runs: 0,
+            gpu_time: Duration::ZERO,
+        });
+        Tenant { scheduler: self.clone(), index: state.tenants.len() - 1 }
+    }
+
+    pub fn usage(&self) -> Vec<TenantUsage> {
+        let state = self.state.lock().unwrap();
+        state
+            .tenants
+            .iter()
+            .map(|tenant| TenantUsage {
+                name: tenant.name.clone(),
+                weight: tenant.options.weight,
+                tier: tenant.options.tier,
+                runs: tenant.runs,
+                gpu_time: tenant.gpu_time,
+                estimate: Duration::from_secs_f64(tenant.estimate.max(0.0) / 1e6),
+                in_flight: tenant.in_flight,
+                waiting: tenant.waiting.len(),
+            })
+            .collect()
+    }
+
+    pub fn options(&self) -> &GpuSchedulerOptions {
+        &self.options
+    }
+
+    // Blocks until the tenant's run is the next to start and returns its estimate.
+    fn acquire(&self, index: usize) -> f64 {
+        let mut state = self.state.lock().unwrap();
+        let ticket = state.next_ticket;
+        state.next_ticket += 1;
+        state.tenants[index].waiting.push_back(ticket);
+        loop {
+            let turn = state.in_flight < self.options.max_in_flight.max(1)
+                && state.next() == Some(index)
+                && state.tenants[index].waiting.front() == Some(&ticket);
+            if turn {
+                let estimate = state.start(index);
+                // the next tenant in line may start as well
+                self.changed.notify_all();
+                return estimate;
+            }
+            state = self.changed.wait(state).unwrap();
+        }
+    }
+
+    fn release(&self, index: usize, estimate: f64, gpu_time: Option<Duration>) {
+        self.state.lock().unwrap().complete(index, estimate, gpu_time);
+        self.changed.notify_all();
+    }
+}
+
+// The handle a tenant's engines run through; clones are the same tenant.
+#[derive(Clone)]
+pub struct Tenant {
+    scheduler: Arc<GpuScheduler>,
+    index: usize,
+}
+
+impl Tenant {
+    // Waits for the tenant's turn, runs `enqueue`, which enqueues the tenant's work on
+    // `stream` (e.g. TRTEngine::execute), and waits for that work, so the run holds its slot
+    // for as long as it occupies the GPU and is charged the device time it took.
+    pub fn run<T, F: FnOnce() -> TRTResult<T>>(&self, stream: &CuStream, enqueue: F) -> TRTResult<T> {
+        let scheduler = &self.scheduler;
+        let events = scheduler.events.lock().unwrap().pop();
+        let (start, end) = match events {
+            Some(events) => events,
+            None => match (CudaEvent::with_timing(), CudaEvent::with_timing()) {
+                (Some(start), Some(end)) => (start, end),
+                _ => return Err(TRTError::EventError),
+            },
+        };
+        let mut slot = Slot { tenant: self, estimate: scheduler.acquire(self.index), gpu_time: None };
+
+        let mut result = match start.record(stream) {
+            true => enqueue(),
+            false => Err(TRTError::EventError),
+        };
+        match (&result, end.record(stream) && end.synchronize()) {
+            (Ok(_), true) => {
+                slot.gpu_time = end.elapsed_ms_since(&start).map(|ms| Duration::from_secs_f32(ms.max(0.0) / 1e3))
+            }
+            (Ok(_), false) => result = Err(TRTError::EventError),
+            _ => {}
+        }
+        drop(slot);
+        scheduler.events.lock().unwrap().push((start, end));
+        result
+    }
+
+    pub fn usage(&self) -> TenantUsage {
+        self.scheduler.usage().swap_remove(self.index)
+    }
+
+    pub fn scheduler(&self) -> &Arc<GpuScheduler> {
+        &self.scheduler
+    }
+}
+
+// A started run, released on every path out of Tenant::run; unmeasured runs are charged
+// their estimate.
+struct Slot<'a> {
+    tenant: &'a Tenant,
+    estimate: f64,
+    gpu_time: Option<Duration>,
+}
+
+impl Drop for Slot<'_> {
+    fn drop(&mut self) {
+        self.tenant.scheduler.release(self.tenant.index, self.estimate, self.gpu_time);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn state(tenants: &[(u32, u8)]) -> State {
+        let mut state = State::default();
+        for (i, &(weight, tier)) in tenants.iter().enumerate() {
+            state.tenants.push(TenantState {
+                name: i.to_string(),
+                options: TenantOptions { weight, tier, max_in_flight: 0, ..TenantOptions::default() },
+                in_flight: 0,
+                finish: 0.0,
+                estimate: 1000.0,
+                waiting: VecDeque::new(),
+                runs: 0,
+                gpu_time: Duration::ZERO,
+            });
+        }
+        state
+    }
+
+    // Starts and completes `runs` runs one at a time with every tenant always waiting.
+    fn serve(state: &mut State, runs: usize) -> Vec<usize> {
+        let mut served = vec![0; state.tenants.len()];
+        for _ in 0..runs {
+            for tenant in state.tenants.iter_mut() {
+                if tenant.waiting.is_empty() {
+                    tenant.waiting.push_back(0);
+                }
+            }
+            let index = state.next().unwrap();
+            let estimate = state.start(index);
+            state.complete(index, estimate, Some(Duration::from_millis(1)));
+            served[index] += 1;
+        }
+        served
+    }
+
+    #[test]
+    fn gpu_time_follows_weights() {
+        let mut state = state(&[(1, 0), (3, 0)]);
+        assert_eq!(serve(&mut state, 400), vec![100, 300]);
+    }
+
+    #[test]
+    fn lower_tiers_go_first() {
+        let mut state = state(&[(1, 1), (1, 0)]);
+        assert_eq!(serve(&mut state, 10), vec![0, 10]);
+    }
+
+    #[test]
+    fn expensive_runs_are_charged() {
+        let mut state = state(&[(1, 0), (1, 0)]);
+        state.tenants[0].waiting.push_back(0);
+        let estimate = state.start(0);
+        // a 9ms run where 1ms was estimated
+        state.complete(0, estimate, Some(Duration::from_millis(9)));
+        state.tenants[0].waiting.push_back(1);
+        state.tenants[1].waiting.push_back(2);
+        assert_eq!(state.next(), Some(1));
+        assert_eq!(state.tenants[0].estimate, 2600.0);
+    }
+
+    #[test]
+    fn caps_leave_the_slot_to_others() {
+        let mut state = state(&[(1, 0), (1, 1)]);
+        state.tenants[0].options.max_in_flight = 1;
+        state.tenants[0].waiting.extend([0, 1]);
+        state.tenants[1].waiting.push_back(2);
+        state.start(0);
+        assert_eq!(state.next(), Some(1));
+    }
+}
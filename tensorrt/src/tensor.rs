@@ -1,34 +1,261 @@
-use crate::error::{TRTError, TRTResult};
+use crate::{
+    accounting::{MemoryCategory, MemoryReservation},
+    dlpack::{self, DLManagedTensor},
+    error::{TRTError, TRTResult},
+    mempool::DeviceMemoryPool,
+    region,
+    view::TensorView,
+};
 use cuda_rs::{memory::DeviceMemory, stream::CuStream};
-use tensorrt_rs_sys::runtime::DataType;
+use tensorrt_rs_sys::{
+    device,
+    kernels::{fill_tensor, random_tensor},
+    memory::{memcpy_2d_async, memset_async, HostMemoryKind, MappedMemory, MemcpyKind},
+    runtime::{DataType, TensorDims, MAX_DIMS},
+    vmm::VirtualMemory,
+};
+use std::{fmt, mem::ManuallyDrop, ops::Deref, sync::Arc};
 
-#[derive(Clone, Debug, PartialEq, Eq)]
-pub struct Shape(pub Vec<i32>);
+// Inline-storage shape (up to MAX_DIMS dims), so comparing and copying shapes on the
+// request path never touches the allocator.
+#[derive(Copy, Clone, PartialEq, Eq, Hash)]
+pub struct Shape {
+    dims: [i32; MAX_DIMS],
+    nb_dims: usize,
+}
 
 impl Shape {
+    pub fn new(dims: &[i32]) -> Self {
+        assert!(dims.len() <= MAX_DIMS, "Too many dimensions: {}", dims.len());
+        let mut inline = [0; MAX_DIMS];
+        inline[..dims.len()].copy_from_slice(dims);
+        Self { dims: inline, nb_dims: dims.len() }
+    }
+
+    pub fn as_slice(&self) -> &[i32] {
+        &self.dims[..self.nb_dims]
+    }
+
+    pub fn nb_dims(&self) -> usize {
+        self.nb_dims
+    }
+
     pub fn size(&self) -> usize {
-        self.0
+        self.as_slice()
             .iter()
             .map(|x| *x as usize)
             .product::<usize>()
     }
+
+    pub fn to_dims(&self) -> TensorDims {
+        TensorDims::new(self.as_slice())
+    }
+}
+
+impl Deref for Shape {
+    type Target = [i32];
+
+    fn deref(&self) -> &[i32] {
+        self.as_slice()
+    }
+}
+
+impl fmt::Debug for Shape {
+    fn fmt(&self, f: &mut fmt::Formatter<'_>) -> fmt::Result {
+        f.debug_tuple("Shape").field(&self.as_slice()).finish()
+    }
+}
+
+impl From<&[i32]> for Shape {
+    fn from(dims: &[i32]) -> Self {
+        Self::new(dims)
+    }
+}
+
+impl From<Vec<i32>> for Shape {
+    fn from(dims: Vec<i32>) -> Self {
+        Self::new(dims.as_slice())
+    }
+}
+
+impl From<TensorDims> for Shape {
+    fn from(dims: TensorDims) -> Self {
+        Self::new(dims.as_slice())
+    }
+}
+
+// Where TRTEngine allocates its IO buffers.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum IoMemory {
+    Device,
+    // pinned host memory mapped into the device: zero-copy where the GPU shares DRAM
+    Mapped,
+    // unified memory
+    Managed,
+    // device memory in a virtual range of `reserve` bytes per tensor, sized for the shapes
+    // given to allocate_io_tensors and grown in place for larger ones (see Tensor::growable)
+    Growable { reserve: usize },
+}
+
+impl IoMemory {
+    // Mapped on integrated GPUs (Jetson), whose device memory is the host's DRAM anyway, so
+    // host IO goes straight to the bindings; Device otherwise.
+    pub fn for_current_device() -> Self {
+        match device::get_device() {
+            Some(device) if device::is_integrated(device) => IoMemory::Mapped,
+            _ => IoMemory::Device,
+        }
+    }
 }
 
 pub struct Tensor {
-    mem: DeviceMemory,
+    // taken out on drop, to either free it or hand it back to its pool
+    mem: ManuallyDrop<DeviceMemory>,
     shape: Shape,
     dtype: DataType,
+    // number of elements the memory can hold, which may exceed the current shape
+    capacity: usize,
+    pooled: Option<PooledBlock>,
+    // released after the memory, by the drop of the tensor
+    reservation: MemoryReservation,
+    // backing of mapped and managed tensors, of which `mem` is a non-owning view
+    host: Option<MappedMemory>,
+    // likewise for growable tensors
+    growable: Option<GrowableBlock>,
+}
+
+struct GrowableBlock {
+    memory: VirtualMemory,
+    // one per growth step
+    reservations: Vec<MemoryReservation>,
+    stream: CuStream,
+}
+
+struct PooledBlock {
+    pool: Arc<DeviceMemoryPool>,
+    class: usize,
+    stream: CuStream,
+    reservation: MemoryReservation,
 }
 
 impl Tensor {
     pub fn empty(shape: &Shape, dtype: DataType, stream: &CuStream) -> TRTResult<Self> {
         let mem_size = shape.size() * dtype.get_elem_size();
+        let reservation = MemoryReservation::new(MemoryCategory::Tensors, mem_size)?;
         let mem = DeviceMemory::new(mem_size, stream)?;
-        Ok(Self { mem, shape: shape.clone(), dtype })
+        let mut tensor = Self::from_memory(mem, shape, dtype);
+        tensor.reservation = reservation;
+        Ok(tensor)
+    }
+
+    // Like empty, with room for `capacity` elements, e.g. for a padded vectorized layout.
+    pub fn with_capacity(shape: &Shape, capacity: usize, dtype: DataType, stream: &CuStream) -> TRTResult<Self> {
+        let capacity = capacity.max(shape.size());
+        let reservation = MemoryReservation::new(MemoryCategory::Tensors, capacity * dtype.get_elem_size())?;
+        let mem = DeviceMemory::new(capacity * dtype.get_elem_size(), stream)?;
+        let mut tensor = Self::from_memory(mem, shape, dtype);
+        tensor.capacity = capacity;
+        tensor.reservation = reservation;
+        Ok(tensor)
+    }
+
+    // Like with_capacity, in host memory the device accesses in place. The host reads and
+    // writes it through host_slice, with no copies on integrated GPUs.
+    pub fn host_mapped(
+        shape: &Shape,
+        capacity: usize,
+        dtype: DataType,
+        kind: HostMemoryKind,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        let capacity = capacity.max(shape.size());
+        let host = match MappedMemory::new(capacity * dtype.get_elem_size(), kind) {
+            Some(host) => host,
+            None => return Err(TRTError::AllocatorError),
+        };
+        let mem = unsafe { DeviceMemory::from_raw(host.get_device_ptr() as _, host.len(), stream) };
+        let mut tensor = Self::from_memory(mem, shape, dtype);
+        tensor.capacity = capacity;
+        tensor.host = Some(host);
+        Ok(tensor)
+    }
+
+    // Device memory at an address that never changes: `reserve` bytes of address space of
+    // which only what `capacity` elements need is mapped, more being mapped by reserve (and
+    // so by reset_shape) when a larger shape arrives. Bindings and captured CUDA graphs
+    // referencing the tensor stay valid as it grows.
+    pub fn growable(
+        shape: &Shape,
+        capacity: usize,
+        reserve: usize,
+        dtype: DataType,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        let capacity = capacity.max(shape.size());
+        let device = match device::get_device() {
+            Some(device) => device,
+            None => return Err(TRTError::AllocatorError),
+        };
+        let memory = match VirtualMemory::new(reserve.max(capacity * dtype.get_elem_size()), device) {
+            Some(memory) => memory,
+            None => return Err(TRTError::AllocatorError),
+        };
+        let mem = unsafe { DeviceMemory::from_raw(memory.get_raw() as _, 0, stream) };
+        let mut tensor = Self::from_memory(mem, shape, dtype);
+        tensor.capacity = 0;
+        tensor.growable = Some(GrowableBlock { memory, reservations: Vec::new(), stream: stream.clone() });
+        tensor.reserve(capacity)?;
+        Ok(tensor)
+    }
+
+    pub fn with_memory(
+        shape: &Shape,
+        capacity: usize,
+        dtype: DataType,
+        memory: IoMemory,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        match memory {
+            IoMemory::Device => Self::with_capacity(shape, capacity, dtype, stream),
+            IoMemory::Mapped => Self::host_mapped(shape, capacity, dtype, HostMemoryKind::Mapped, stream),
+            IoMemory::Managed => Self::host_mapped(shape, capacity, dtype, HostMemoryKind::Managed, stream),
+            IoMemory::Growable { reserve } => Self::growable(shape, capacity, reserve, dtype, stream),
+        }
+    }
+
+    // Like empty, but the memory comes from (and on drop returns to) `pool`, ordered on
+    // `stream`. Work using the tensor on other streams must be synchronized before the drop.
+    pub fn empty_pooled(
+        shape: &Shape,
+        dtype: DataType,
+        pool: &Arc<DeviceMemoryPool>,
+        stream: &CuStream,
+    ) -> TRTResult<Self> {
+        let (mem, class, reservation) = pool.allocate(shape.size() * dtype.get_elem_size(), stream)?;
+        let block = PooledBlock { pool: pool.clone(), class, stream: stream.clone(), reservation };
+        Ok(Self {
+            mem: ManuallyDrop::new(mem),
+            shape: *shape,
+            dtype,
+            capacity: class / dtype.get_elem_size(),
+            pooled: Some(block),
+            reservation: MemoryReservation::none(MemoryCategory::Tensors),
+            host: None,
+            growable: None,
+        })
     }
 
     pub fn from_memory(mem: DeviceMemory, shape: &Shape, dtype: DataType) -> Self {
-        Self { mem, shape: shape.clone(), dtype }
+        Self {
+            mem: ManuallyDrop::new(mem),
+            shape: *shape,
+            dtype,
+            capacity: shape.size(),
+            pooled: None,
+            reservation: MemoryReservation::none(MemoryCategory::Tensors),
+            host: None,
+            growable: None,
+        }
     }
 
     pub fn get_memory(&self) -> &DeviceMemory {
@@ -42,13 +269,46 @@ impl Tensor {
         let mem = unsafe {
             DeviceMemory::from_raw(ptr as _, mem_size, stream)
         };
-        Self { mem, shape: shape.clone(), dtype }
+        Self::from_memory(mem, shape, dtype)
     }
 
     pub unsafe fn get_raw_ptr(&self) -> usize {
         self.mem.get_raw() as usize
     }
 
+    // Rows [start, start + count) along the first dim, as a non-owning tensor.
+    pub(crate) fn rows(&self, start: usize, count: usize, stream: &CuStream) -> Tensor {
+        let mut dims = self.shape.to_vec();
+        let row_size = self.shape.size() / (dims[0].max(1) as usize) * self.dtype.get_elem_size();
+        dims[0] = count as i32;
+        let ptr = unsafe { self.get_raw_ptr() } + start * row_size;
+        Tensor::from_raw_ptr(ptr, &Shape::new(&dims), self.dtype, stream)
+    }
+
+    // The host address of tensors from host_mapped, e.g. to bind a shape tensor, whose
+    // values TensorRT reads and writes on the host.
+    pub fn host_ptr(&self) -> Option<usize> {
+        self.host.as_ref().map(|host| host.get_raw())
+    }
+
+    // Mapped or managed, for tensors from host_mapped.
+    pub fn host_memory(&self) -> Option<HostMemoryKind> {
+        self.host.as_ref().map(|host| host.kind())
+    }
+
+    // The current shape's bytes as seen from the host, for tensors from host_mapped.
+    // Safety: no device work writing the tensor may be in flight.
+    pub unsafe fn host_slice(&self) -> Option<&[u8]> {
+        let size = self.size_in_bytes();
+        self.host.as_ref().map(|host| &host.as_slice()[..size])
+    }
+
+    // Safety: no device work reading or writing the tensor may be in flight.
+    pub unsafe fn host_slice_mut(&mut self) -> Option<&mut [u8]> {
+        let size = self.size_in_bytes();
+        self.host.as_mut().map(|host| &mut host.as_mut_slice()[..size])
+    }
+
     pub fn shape(&self) -> &Shape {
         &self.shape
     }
@@ -57,14 +317,160 @@ impl Tensor {
         self.dtype
     }
 
+    pub fn capacity(&self) -> usize {
+        self.capacity
+    }
+
+    pub fn size_in_bytes(&self) -> usize {
+        self.shape.size() * self.dtype.get_elem_size()
+    }
+
     pub unsafe fn reset_shape(&mut self, shape: &Shape) -> TRTResult<()> {
-        if self.shape.size() < shape.size() {
+        self.reserve(shape.size())?;
+        self.shape = *shape;
+        Ok(())
+    }
+
+    pub fn is_growable(&self) -> bool {
+        self.growable.is_some()
+    }
+
+    // Whether reserve(elements) can succeed, memory permitting.
+    pub fn can_hold(&self, elements: usize) -> bool {
+        match self.growable.as_ref() {
+            _ if elements <= self.capacity => true,
+            Some(block) => elements * self.dtype.get_elem_size() <= block.memory.reserved(),
+            None => false,
+        }
+    }
+
+    // Room for `elements` elements. Growable tensors map more memory behind the current
+    // pages, which work in flight may keep using; others fail with ResetShapesError when
+    // they are too small.
+    pub fn reserve(&mut self, elements: usize) -> TRTResult<()> {
+        if elements <= self.capacity {
+            return Ok(());
+        }
+        let block = match self.growable.as_mut() {
+            Some(block) => block,
+            None => return Err(TRTError::ResetShapesError),
+        };
+        let elem_size = self.dtype.get_elem_size();
+        let granularity = block.memory.granularity().max(1);
+        let target = (elements * elem_size + granularity - 1) / granularity * granularity;
+        if target > block.memory.reserved() {
             return Err(TRTError::ResetShapesError);
         }
-        self.shape = shape.clone();
+        let reservation = MemoryReservation::new(MemoryCategory::Tensors, target - block.memory.len())?;
+        if !block.memory.grow(target) {
+            return Err(TRTError::AllocatorError);
+        }
+        block.reservations.push(reservation);
+        let len = block.memory.len();
+        // the old view aliases the same pages and owns nothing
+        let mem = unsafe { DeviceMemory::from_raw(block.memory.get_raw() as _, len, &block.stream) };
+        self.mem = ManuallyDrop::new(mem);
+        self.capacity = len / elem_size;
+        Ok(())
+    }
+
+    // Copies the `extent` box at `src_offset` in `src` to `dst_offset` in this tensor, e.g.
+    // one request into row k of a batch, as a single 2D/3D DMA where the layout allows.
+    pub fn copy_region_from(
+        &mut self,
+        src: &Self,
+        src_offset: &[usize],
+        dst_offset: &[usize],
+        extent: &Shape,
+        stream: &CuStream,
+    ) -> TRTResult<()> {
+        region::copy_region(self, dst_offset, src, src_offset, extent, stream)
+    }
+
+    // Copies `src` into the origin corner of this (larger or equal) tensor and zeroes the rest.
+    pub fn copy_padded_from(&mut self, src: &Self, stream: &CuStream) -> TRTResult<()> {
+        region::copy_padded(self, src, stream)
+    }
+
+    // Concatenates `sources` along their leading dim into this tensor, reshaped to their total
+    // rows, e.g. requests in device buffers of their own into a batch. One launch copies them
+    // all, rather than one cudaMemcpyAsync each.
+    pub fn gather_rows(&mut self, sources: &[&Tensor], stream: &CuStream) -> TRTResult<()> {
+        let rows = region::copy_rows(self, sources, false, stream)?;
+        let mut dims = self.shape.to_vec();
+        dims[0] = rows as i32;
+        unsafe { self.reset_shape(&Shape::new(&dims)) }
+    }
+
+    // The reverse of gather_rows: splits this tensor's leading rows into `outputs`, each taking
+    // as many rows as it has, in one launch.
+    pub fn scatter_rows(&self, outputs: &[&Tensor], stream: &CuStream) -> TRTResult<()> {
+        region::copy_rows(self, outputs, true, stream).map(|_| ())
+    }
+
+    // Fills this tensor, split into `rows` equal rows, from a pitched source such as an image
+    // with padded rows. `kind` tells whether `src` is host or device memory.
+    // Safety: `src` must be valid for `rows * src_pitch` bytes until the copy has completed.
+    pub unsafe fn copy_from_pitched(
+        &mut self,
+        src: usize,
+        src_pitch: usize,
+        rows: usize,
+        kind: MemcpyKind,
+        stream: &CuStream,
+    ) -> TRTResult<()> {
+        let size = self.size_in_bytes();
+        if rows == 0 || size % rows != 0 || size / rows > src_pitch {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let width = size / rows;
+        if !memcpy_2d_async(self.get_raw_ptr(), width, src, src_pitch, width, rows, kind, stream) {
+            return Err(TRTError::MemcpyError);
+        }
         Ok(())
     }
 
+    // Zeroes the tensor's elements on `stream`, e.g. padding or a synthetic input, without
+    // a host buffer or a copy; zero bits are zero in every data type.
+    pub fn zero(&self, stream: &CuStream) -> TRTResult<()> {
+        match unsafe { memset_async(self.get_raw_ptr(), 0, self.size_in_bytes(), stream) } {
+            true => Ok(()),
+            false => Err(TRTError::MemcpyError),
+        }
+    }
+
+    // Sets every element to `value` on `stream`, rounded and saturated for the integer types.
+    pub fn fill(&self, value: f32, stream: &CuStream) -> TRTResult<()> {
+        if value == 0.0 {
+            return self.zero(stream);
+        }
+        match unsafe { fill_tensor(self.get_raw_ptr(), self.dtype, self.shape.size(), value, stream) } {
+            true => Ok(()),
+            false => Err(TRTError::KernelLaunchError),
+        }
+    }
+
+    // Sets the elements to uniform random values in [low, high) generated on `stream`:
+    // integers for the integer types (e.g. token ids in [0, vocab)), 24 random bits for the
+    // floating-point ones. The same seed gives the same values, so runs are reproducible.
+    pub fn fill_random(&self, low: f32, high: f32, seed: u64, stream: &CuStream) -> TRTResult<()> {
+        let ptr = unsafe { self.get_raw_ptr() };
+        match unsafe { random_tensor(ptr, self.dtype, self.shape.size(), low, high, seed, stream) } {
+            true => Ok(()),
+            false => Err(TRTError::KernelLaunchError),
+        }
+    }
+
+    // Hands the tensor to a DLPack consumer (tch, PyTorch, CuPy) without a copy.
+    pub fn into_dlpack(self) -> TRTResult<*mut DLManagedTensor> {
+        dlpack::to_dlpack(self)
+    }
+
+    // A borrowed, copy-free view of the whole tensor; see TensorView.
+    pub fn view(&self, stream: &CuStream) -> TensorView<'_> {
+        TensorView::new(self, stream)
+    }
+
     pub fn copy_from(&mut self, src: &Self, stream: Option<&CuStream>) -> TRTResult<()> {
         if self.shape != src.shape {
             return Err(TRTError::ShapeMismatch);
@@ -72,8 +478,22 @@ impl Tensor {
         if self.dtype != src.dtype {
             return Err(TRTError::DTypeMismatch);
         }
+        // an input written in place, e.g. through the host view of a mapped binding
+        if unsafe { self.get_raw_ptr() == src.get_raw_ptr() } {
+            return Ok(());
+        }
         self.mem.copy_from(&src.mem, stream)?;
 
         Ok(())
     }
 }
+
+impl Drop for Tensor {
+    fn drop(&mut self) {
+        let mem = unsafe { ManuallyDrop::take(&mut self.mem) };
+        match self.pooled.take() {
+            Some(block) => block.pool.release(mem, block.class, block.reservation, &block.stream),
+            None => std::mem::drop(mem),
+        }
+    }
+}
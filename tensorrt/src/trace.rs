@@ -0,0 +1,617 @@
+use crate::{
+    error::TRTResult,
+    ring::{submission_ring, RingReceiver, RingSender},
+    staging::{event, pinned},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    collections::HashMap,
+    fs::File,
+    io::{self, BufReader, BufWriter, ErrorKind, Read, Write},
+    path::Path,
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Arc, Mutex,
+    },
+    thread::{self, JoinHandle},
+    time::{Duration, Instant, SystemTime, UNIX_EPOCH},
+};
+use tensorrt_rs_sys::{
+    device,
+    memory::{memcpy_async, MemcpyKind, PinnedMemory},
+    runtime::{DataType, MAX_DIMS},
+    stream::CudaEvent,
+};
+
+const MAGIC: &[u8; 8] = b"TRTTRACE";
+const VERSION: u32 = 1;
+const REQUEST: u8 = 1;
+const BATCH: u8 = 2;
+
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub struct TraceOptions {
+    // Records in flight to the writer thread; records beyond it are dropped and counted
+    // rather than blocking the request.
+    pub capacity: usize,
+    // Records the input bytes of every n-th request; 0 records shapes only.
+    pub sample_every: u64,
+    // Bytes recorded per sampled input, the rest are left out.
+    pub max_sample_bytes: usize,
+}
+
+impl Default for TraceOptions {
+    fn default() -> Self {
+        Self { capacity: 4096, sample_every: 0, max_sample_bytes: 1 << 20 }
+    }
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct TraceInput {
+    pub name: String,
+    pub dtype: DataType,
+    pub shape: Shape,
+    // the leading bytes of the input for sampled requests, empty otherwise
+    pub data: Vec<u8>,
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct RequestRecord {
+    pub id: u64,
+    // since the start of the trace
+    pub arrival: Duration,
+    // until the result was handed back: the enqueue for TRTEngine, the batch's completion
+    // for DynamicBatcher
+    pub duration: Duration,
+    pub inputs: Vec<TraceInput>,
+}
+
+// The requests a DynamicBatcher executed together.
+#[derive(Debug, Clone, PartialEq)]
+pub struct BatchRecord {
+    pub id: u64,
+    pub start: Duration,
+    pub duration: Duration,
+    pub rows: u32,
+    pub requests: Vec<u64>,
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub enum TraceRecord {
+    Request(RequestRecord),
+    Batch(BatchRecord),
+}
+
+// Input bytes copied off the device for a sampled request, one after the other in `memory`.
+struct DeviceSample {
+    memory: PinnedMemory,
+    lens: Vec<usize>,
+    copied: CudaEvent,
+}
+
+// Pinned buffers and events of the samples the writer thread is done with, so sampling costs
+// no cudaHostAlloc or cudaEventCreate once warm. Buffers are kept in power-of-two sizes.
+#[derive(Default)]
+struct SamplePool {
+    buffers: Mutex<Vec<PinnedMemory>>,
+    events: Mutex<Vec<CudaEvent>>,
+}
+
+impl SamplePool {
+    // free buffers kept past a burst of samples
+    const MAX_FREE: usize = 16;
+
+    fn take_buffer(&self, size: usize) -> TRTResult<PinnedMemory> {
+        let mut buffers = self.buffers.lock().unwrap();
+        let best = buffers
+            .iter()
+            .enumerate()
+            .filter(|(_, buffer)| buffer.len() >= size)
+            .min_by_key(|(_, buffer)| buffer.len())
+            .map(|(index, _)| index);
+        match best {
+            Some(index) => Ok(buffers.swap_remove(index)),
+            None => {
+                drop(buffers);
+                pinned(size.max(1).next_power_of_two())
+            }
+        }
+    }
+
+    fn take_event(&self) -> TRTResult<CudaEvent> {
+        match self.events.lock().unwrap().pop() {
+            Some(event) => Ok(event),
+            None => event(),
+        }
+    }
+
+    // Only once no copy into `memory` is pending.
+    fn put_buffer(&self, memory: PinnedMemory) {
+        let mut buffers = self.buffers.lock().unwrap();
+        if buffers.len() < Self::MAX_FREE {
+            buffers.push(memory);
+        }
+    }
+
+    fn put(&self, sample: DeviceSample) {
+        self.put_buffer(sample.memory);
+        let mut events = self.events.lock().unwrap();
+        if events.len() < Self::MAX_FREE {
+            events.push(sample.copied);
+        }
+    }
+}
+
+enum Entry {
+    Record(TraceRecord),
+    Sampled(RequestRecord, DeviceSample),
+}
+
+// A request traced by TRTEngine between its arrival and its enqueue.
+pub(crate) struct TracedRequest {
+    id: u64,
+    arrival: Instant,
+    inputs: Vec<TraceInput>,
+    sample: Option<DeviceSample>,
+}
+
+// Records requests and batches to a compact binary file for replay, e.g. by the trtreplay
+// example. Recording takes no lock and no IO on the request path: records are pushed to a
+// writer thread through a submission ring, and sampled device inputs are copied into pinned
+// memory asynchronously, on the request's stream. The file is complete once the last
+// handle is dropped.
+pub struct TraceRecorder {
+    sender: RingSender<Entry>,
+    start: Instant,
+    options: TraceOptions,
+    requests: AtomicU64,
+    batches: AtomicU64,
+    dropped: Arc<AtomicU64>,
+    samples: Arc<SamplePool>,
+    writer: Mutex<Option<JoinHandle<()>>>,
+}
+
+impl TraceRecorder {
+    pub fn create<P: AsRef<Path>>(path: &P, options: TraceOptions) -> TRTResult<Arc<Self>> {
+        let mut out = BufWriter::new(File::create(path)?);
+        let start_unix = SystemTime::now().duration_since(UNIX_EPOCH).unwrap_or_default();
+        out.write_all(MAGIC)?;
+        out.write_all(&VERSION.to_le_bytes())?;
+        out.write_all(&(start_unix.as_nanos() as u64).to_le_bytes())?;
+
+        let (sender, receiver) = submission_ring(options.capacity);
+        let dropped = Arc::new(AtomicU64::new(0));
+        let samples = Arc::new(SamplePool::default());
+        let writer = {
+            let dropped = dropped.clone();
+            let samples = samples.clone();
+            // sampled copies are waited for on the device they were made on
+            let device = device::get_device();
+            thread::spawn(move || {
+                if let Some(device) = device {
+                    device::set_device(device);
+                }
+                write_entries(receiver, out, &dropped, &samples);
+            })
+        };
+        Ok(Arc::new(Self {
+            sender,
+            start: Instant::now(),
+            options,
+            requests: AtomicU64::new(0),
+            batches: AtomicU64::new(0),
+            dropped,
+            samples,
+            writer: Mutex::new(Some(writer)),
+        }))
+    }
+
+    pub fn options(&self) -> &TraceOptions {
+        &self.options
+    }
+
+    // Records lost to a full ring or a failed write.
+    pub fn dropped(&self) -> u64 {
+        self.dropped.load(Ordering::Relaxed)
+    }
+
+    fn offset(&self, instant: Instant) -> Duration {
+        instant.saturating_duration_since(self.start)
+    }
+
+    fn is_sampled(&self, id: u64) -> bool {
+        self.options.sample_every > 0 && id % self.options.sample_every == 0
+    }
+
+    fn push(&self, entry: Entry) {
+        if self.sender.push(entry).is_err() {
+            self.dropped.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    // Records a request whose inputs are in host memory. `inputs` is told whether the request
+    // is sampled, so their bytes are only copied when they are kept. Returns the request's id,
+    // for record_batch.
+    pub fn record_request<F>(&self, arrival: Instant, duration: Duration, inputs: F) -> u64
+    where
+        F: FnOnce(bool) -> Vec<TraceInput>,
+    {
+        let id = self.requests.fetch_add(1, Ordering::Relaxed);
+        let sampled = self.is_sampled(id);
+        let mut inputs = inputs(sampled);
+        for input in &mut inputs {
+            match sampled {
+                true => input.data.truncate(self.options.max_sample_bytes),
+                false => input.data = Vec::new(),
+            }
+        }
+        let arrival = self.offset(arrival);
+        self.push(Entry::Record(TraceRecord::Request(RequestRecord { id, arrival, duration, inputs })));
+        id
+    }
+
+    pub fn record_batch(&self, start: Instant, duration: Duration, rows: u32, requests: Vec<u64>) -> u64 {
+        let id = self.batches.fetch_add(1, Ordering::Relaxed);
+        let start = self.offset(start);
+        self.push(Entry::Record(TraceRecord::Batch(BatchRecord { id, start, duration, rows, requests })));
+        id
+    }
+
+    // Called before the request's work is enqueued on `stream`, so a sample copies the inputs
+    // as the request sees them. A sample that cannot be taken is left out of the record.
+    pub(crate) fn begin(&self, feed_dict: &HashMap<&str, &Tensor>, stream: &CuStream) -> TracedRequest {
+        let arrival = Instant::now();
+        let id = self.requests.fetch_add(1, Ordering::Relaxed);
+        let inputs = feed_dict
+            .iter()
+            .map(|(name, tensor)| TraceInput {
+                name: name.to_string(),
+                dtype: tensor.dtype(),
+                shape: *tensor.shape(),
+                data: Vec::new(),
+            })
+            .collect();
+        let sample = match self.is_sampled(id) {
+            true => self.sample(feed_dict, stream),
+            false => None,
+        };
+        TracedRequest { id, arrival, inputs, sample }
+    }
+
+    fn sample(&self, feed_dict: &HashMap<&str, &Tensor>, stream: &CuStream) -> Option<DeviceSample> {
+        let lens: Vec<_> =
+            feed_dict.values().map(|tensor| tensor.size_in_bytes().min(self.options.max_sample_bytes)).collect();
+        let memory = self.samples.take_buffer(lens.iter().sum()).ok()?;
+        let mut offset = 0;
+        for (tensor, &len) in feed_dict.values().zip(&lens) {
+            let src = unsafe { tensor.get_raw_ptr() };
+            if !unsafe { memcpy_async(memory.get_raw() + offset, src, len, MemcpyKind::DeviceToHost, stream) } {
+                // the pinned buffer may not be reused or freed under a copy already issued
+                stream.synchronize().ok()?;
+                self.samples.put_buffer(memory);
+                return None;
+            }
+            offset += len;
+        }
+        let copied = match self.samples.take_event() {
+            Ok(copied) => copied,
+            Err(_) => {
+                stream.synchronize().ok()?;
+                self.samples.put_buffer(memory);
+                return None;
+            }
+        };
+        match copied.record(stream) {
+            true => Some(DeviceSample { memory, lens, copied }),
+            false => {
+                stream.synchronize().ok()?;
+                self.samples.put_buffer(memory);
+                None
+            }
+        }
+    }
+
+    // Called once the request's work is enqueued.
+    pub(crate) fn finish(&self, request: TracedRequest) {
+        let TracedRequest { id, arrival, inputs, sample } = request;
+        let record = RequestRecord { id, arrival: self.offset(arrival), duration: arrival.elapsed(), inputs };
+        match sample {
+            Some(sample) => self.push(Entry::Sampled(record, sample)),
+            None => self.push(Entry::Record(TraceRecord::Request(record))),
+        }
+    }
+}
+
+impl Drop for TraceRecorder {
+    fn drop(&mut self) {
+        self.sender.close();
+        if let Some(writer) = self.writer.lock().unwrap().take() {
+            writer.join().ok();
+        }
+    }
+}
+
+fn write_entries(
+    mut receiver: RingReceiver<Entry>,
+    mut out: BufWriter<File>,
+    dropped: &AtomicU64,
+    samples: &SamplePool,
+) {
+    let mut entries = Vec::new();
+    let mut buf = Vec::new();
+    let mut failed = false;
+    loop {
+        // read first, so everything pushed before the close is written below
+        let closed = receiver.is_closed();
+        if receiver.pop_batch(&mut entries, 64) == 0 {
+            if closed {
+                break;
+            }
+            // flushed while idle, so a trace cut short by a crash loses little
+            failed = failed || out.flush().is_err();
+            receiver.wait(None);
+            continue;
+        }
+        for entry in entries.drain(..) {
+            let record = match entry {
+                Entry::Record(record) => record,
+                Entry::Sampled(mut record, sample) => {
+                    if sample.copied.synchronize() {
+                        let mut data = unsafe { sample.memory.as_slice() };
+                        for (input, &len) in record.inputs.iter_mut().zip(&sample.lens) {
+                            input.data = data[..len].to_vec();
+                            data = &data[len..];
+                        }
+                        samples.put(sample);
+                    }
+                    TraceRecord::Request(record)
+                }
+            };
+            buf.clear();
+            encode(&record, &mut buf);
+            failed = failed || out.write_all(&buf).is_err();
+            if failed {
+                dropped.fetch_add(1, Ordering::Relaxed);
+            }
+        }
+    }
+    out.flush().ok();
+}
+
+fn put_u16(out: &mut Vec<u8>, value: usize) {
+    out.extend_from_slice(&(value.min(u16::MAX as usize) as u16).to_le_bytes());
+}
+
+fn put_u32(out: &mut Vec<u8>, value: usize) {
+    out.extend_from_slice(&(value.min(u32::MAX as usize) as u32).to_le_bytes());
+}
+
+fn put_u64(out: &mut Vec<u8>, value: u64) {
+    out.extend_from_slice(&value.to_le_bytes());
+}
+
+fn put_duration(out: &mut Vec<u8>, value: Duration) {
+    put_u64(out, value.as_nanos().min(u64::MAX as u128) as u64);
+}
+
+// Little-endian throughout; counts are clamped to their field, which no real trace reaches.
+fn encode(record: &TraceRecord, out: &mut Vec<u8>) {
+    match record {
+        TraceRecord::Request(request) => {
+            out.push(REQUEST);
+            put_u64(out, request.id);
+            put_duration(out, request.arrival);
+            put_duration(out, request.duration);
+            put_u16(out, request.inputs.len());
+            for input in request.inputs.iter().take(u16::MAX as usize) {
+                let name = &input.name.as_bytes()[..input.name.len().min(u16::MAX as usize)];
+                put_u16(out, name.len());
+                out.extend_from_slice(name);
+                out.push(input.dtype as u8);
+                out.push(input.shape.nb_dims() as u8);
+                for &dim in input.shape.as_slice() {
+                    out.extend_from_slice(&dim.to_le_bytes());
+                }
+                let data = &input.data[..input.data.len().min(u32::MAX as usize)];
+                put_u32(out, data.len());
+                out.extend_from_slice(data);
+            }
+        }
+        TraceRecord::Batch(batch) => {
+            out.push(BATCH);
+            put_u64(out, batch.id);
+            put_duration(out, batch.start);
+            put_duration(out, batch.duration);
+            put_u32(out, batch.rows as usize);
+            put_u32(out, batch.requests.len());
+            for &request in batch.requests.iter().take(u32::MAX as usize) {
+                put_u64(out, request);
+            }
+        }
+    }
+}
+
+fn invalid(what: &str) -> io::Error {
+    io::Error::new(ErrorKind::InvalidData, format!("invalid trace: {}", what))
+}
+
+fn read_array<const N: usize>(reader: &mut impl Read) -> io::Result<[u8; N]> {
+    let mut bytes = [0; N];
+    reader.read_exact(&mut bytes)?;
+    Ok(bytes)
+}
+
+fn read_u8(reader: &mut impl Read) -> io::Result<u8> {
+    Ok(read_array::<1>(reader)?[0])
+}
+
+fn read_u16(reader: &mut impl Read) -> io::Result<usize> {
+    Ok(u16::from_le_bytes(read_array(reader)?) as usize)
+}
+
+fn read_u32(reader: &mut impl Read) -> io::Result<usize> {
+    Ok(u32::from_le_bytes(read_array(reader)?) as usize)
+}
+
+fn read_u64(reader: &mut impl Read) -> io::Result<u64> {
+    Ok(u64::from_le_bytes(read_array(reader)?))
+}
+
+fn read_duration(reader: &mut impl Read) -> io::Result<Duration> {
+    Ok(Duration::from_nanos(read_u64(reader)?))
+}
+
+fn read_bytes(reader: &mut impl Read, len: usize) -> io::Result<Vec<u8>> {
+    let mut bytes = Vec::new();
+    reader.take(len as u64).read_to_end(&mut bytes)?;
+    match bytes.len() == len {
+        true => Ok(bytes),
+        false => Err(ErrorKind::UnexpectedEof.into()),
+    }
+}
+
+// None at a clean end of the stream.
+fn decode(reader: &mut impl Read) -> io::Result<Option<TraceRecord>> {
+    let kind = match read_u8(reader) {
+        Ok(kind) => kind,
+        Err(err) if err.kind() == ErrorKind::UnexpectedEof => return Ok(None),
+        Err(err) => return Err(err),
+    };
+    let record = match kind {
+        REQUEST => {
+            let (id, arrival, duration) = (read_u64(reader)?, read_duration(reader)?, read_duration(reader)?);
+            let num_inputs = read_u16(reader)?;
+            let mut inputs = Vec::with_capacity(num_inputs);
+            for _ in 0..num_inputs {
+                let len = read_u16(reader)?;
+                let name = String::from_utf8(read_bytes(reader, len)?).map_err(|_| invalid("input name"))?;
+                let dtype = match DataType::from_i32(read_u8(reader)? as i32) {
+                    Some(dtype) => dtype,
+                    None => return Err(invalid("data type")),
+                };
+                let nb_dims = read_u8(reader)? as usize;
+                if nb_dims > MAX_DIMS {
+                    return Err(invalid("shape"));
+                }
+                let mut dims = Vec::with_capacity(nb_dims);
+                for _ in 0..nb_dims {
+                    dims.push(i32::from_le_bytes(read_array(reader)?));
+                }
+                let len = read_u32(reader)?;
+                inputs.push(TraceInput { name, dtype, shape: Shape::new(&dims), data: read_bytes(reader, len)? });
+            }
+            TraceRecord::Request(RequestRecord { id, arrival, duration, inputs })
+        }
+        BATCH => {
+            let (id, start, duration) = (read_u64(reader)?, read_duration(reader)?, read_duration(reader)?);
+            let rows = read_u32(reader)? as u32;
+            let num_requests = read_u32(reader)?;
+            let mut requests = Vec::new();
+            for _ in 0..num_requests {
+                requests.push(read_u64(reader)?);
+            }
+            TraceRecord::Batch(BatchRecord { id, start, duration, rows, requests })
+        }
+        _ => return Err(invalid("record kind")),
+    };
+    Ok(Some(record))
+}
+
+// The records of a trace file, in the order they were recorded. A trace cut short (e.g. by
+// a crash) reads up to its last complete record and ends with an error.
+pub struct TraceReader<R: Read = BufReader<File>> {
+    reader: R,
+    start_unix: Duration,
+    done: bool,
+}
+
+impl TraceReader {
+    pub fn open<P: AsRef<Path>>(path: &P) -> TRTResult<Self> {
+        Ok(Self::new(BufReader::new(File::open(path)?))?)
+    }
+}
+
+impl<R: Read> TraceReader<R> {
+    pub fn new(mut reader: R) -> io::Result<Self> {
+        if &read_array::<8>(&mut reader)? != MAGIC {
+            return Err(invalid("magic"));
+        }
+        if u32::from_le_bytes(read_array(&mut reader)?) != VERSION {
+            return Err(invalid("version"));
+        }
+        let start_unix = Duration::from_nanos(read_u64(&mut reader)?);
+        Ok(Self { reader, start_unix, done: false })
+    }
+
+    // Wall-clock start of the trace, since the Unix epoch.
+    pub fn start_unix(&self) -> Duration {
+        self.start_unix
+    }
+}
+
+impl<R: Read> Iterator for TraceReader<R> {
+    type Item = io::Result<TraceRecord>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.done {
+            return None;
+        }
+        let record = decode(&mut self.reader).transpose();
+        self.done = !matches!(record, Some(Ok(_)));
+        record
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn records_round_trip() {
+        let records = vec![
+            TraceRecord::Request(RequestRecord {
+                id: 7,
+                arrival: Duration::from_micros(1500),
+                duration: Duration::from_nanos(42_000),
+                inputs: vec![
+                    TraceInput {
+                        name: "input_ids".to_string(),
+                        dtype: DataType::INT32,
+                        shape: Shape::new(&[2, 128]),
+                        data: vec![1, 2, 3],
+                    },
+                    TraceInput {
+                        name: "x".to_string(),
+                        dtype: DataType::HALF,
+                        shape: Shape::new(&[1, 3, 224, 224]),
+                        data: Vec::new(),
+                    },
+                ],
+            }),
+            TraceRecord::Batch(BatchRecord {
+                id: 0,
+                start: Duration::from_millis(3),
+                duration: Duration::from_millis(1),
+                rows: 5,
+                requests: vec![7, 8],
+            }),
+        ];
+        let mut file = Vec::new();
+        file.extend_from_slice(MAGIC);
+        file.extend_from_slice(&VERSION.to_le_bytes());
+        file.extend_from_slice(&123u64.to_le_bytes());
+        for record in &records {
+            encode(record, &mut file);
+        }
+
+        let reader = TraceReader::new(io::Cursor::new(&file)).unwrap();
+        assert_eq!(reader.start_unix(), Duration::from_nanos(123));
+        assert_eq!(reader.collect::<io::Result<Vec<_>>>().unwrap(), records);
+
+        // a record cut short ends the trace with an error
+        let mut reader = TraceReader::new(io::Cursor::new(&file[..file.len() - 3])).unwrap();
+        assert!(matches!(reader.next(), Some(Ok(_))));
+        assert!(matches!(reader.next(), Some(Err(_))));
+        assert!(reader.next().is_none());
+    }
+}
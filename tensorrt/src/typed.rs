@@ -0,0 +1,319 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    slot::IoSlot,
+    tensor::{IoMemory, Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::{marker::PhantomData, mem::size_of, ops::Deref, slice};
+use tensorrt_rs_sys::{
+    memory::{memcpy_async, MemcpyKind},
+    runtime::DataType,
+};
+
+// IEEE half precision, as its bits; Rust has no f16 yet.
+#[derive(Debug, Copy, Clone, Default, PartialEq, Eq, Hash)]
+#[repr(transparent)]
+pub struct Half(pub u16);
+
+impl Half {
+    // Rounds to nearest, ties to even.
+    pub fn from_f32(value: f32) -> Self {
+        let bits = value.to_bits();
+        let sign = ((bits >> 16) & 0x8000) as u16;
+        let exp = ((bits >> 23) & 0xff) as i32;
+        let mant = bits & 0x7f_ffff;
+        if exp == 0xff {
+            let nan = if mant != 0 { 0x200 | (mant >> 13) as u16 } else { 0 };
+            return Half(sign | 0x7c00 | nan);
+        }
+        let exp = exp - 127 + 15;
+        if exp >= 0x1f {
+            return Half(sign | 0x7c00);
+        }
+        if exp <= 0 {
+            if exp < -10 {
+                return Half(sign);
+            }
+            // subnormal: the implicit bit becomes explicit
+            let mant = mant | 0x80_0000;
+            let shift = (14 - exp) as u32;
+            let rounded = mant + (1 << (shift - 1)) - 1 + ((mant >> shift) & 1);
+            return Half(sign | (rounded >> shift) as u16);
+        }
+        // a carry out of the mantissa bumps the exponent, up to infinity
+        let rounded = mant + 0xfff + ((mant >> 13) & 1);
+        Half(sign | (((exp as u32) << 10) + (rounded >> 13)) as u16)
+    }
+
+    pub fn to_f32(self) -> f32 {
+        let half = self.0 as u32;
+        let sign = (half & 0x8000) << 16;
+        let exp = (half >> 10) & 0x1f;
+        let mant = half & 0x3ff;
+        let bits = match exp {
+            0 if mant == 0 => sign,
+            0 => {
+                let shift = mant.leading_zeros() - 21;
+                sign | ((113 - shift) << 23) | (((mant << shift) & 0x3ff) << 13)
+            }
+            0x1f => sign | 0x7f80_0000 | (mant << 13),
+            _ => sign | ((exp + 127 - 15) << 23) | (mant << 13),
+        };
+        f32::from_bits(bits)
+    }
+}
+
+// Host types laid out as a TensorRT data type.
+// Safety: values of DTYPE must be valid bit patterns of the type, of its size.
+pub unsafe trait TrtElement: Copy + Send + Sync + 'static {
+    const DTYPE: DataType;
+}
+
+unsafe impl TrtElement for f32 {
+    const DTYPE: DataType = DataType::FLOAT;
+}
+
+unsafe impl TrtElement for Half {
+    const DTYPE: DataType = DataType::HALF;
+}
+
+unsafe impl TrtElement for i8 {
+    const DTYPE: DataType = DataType::INT8;
+}
+
+unsafe impl TrtElement for i32 {
+    const DTYPE: DataType = DataType::INT32;
+}
+
+unsafe impl TrtElement for u8 {
+    const DTYPE: DataType = DataType::UINT8;
+}
+
+// TensorRT only produces 0 and 1 for BOOL tensors.
+unsafe impl TrtElement for bool {
+    const DTYPE: DataType = DataType::BOOL;
+}
+
+// A Tensor whose element type is known at compile time, checked once when it is made, so
+// sizes come from size_of::<T> and copies between typed tensors and slices need neither a
+// dtype match nor a cast. It derefs to &Tensor only: mutable access is limited to the
+// operations below, none of which can change the dtype, which inference_typed relies on.
+#[repr(transparent)]
+pub struct TypedTensor<T: TrtElement> {
+    tensor: Tensor,
+    _element: PhantomData<T>,
+}
+
+impl<T: TrtElement> TypedTensor<T> {
+    pub fn empty(shape: &Shape, stream: &CuStream) -> TRTResult<Self> {
+        Tensor::empty(shape, T::DTYPE, stream).map(Self::wrap)
+    }
+
+    pub fn with_memory(shape: &Shape, capacity: usize, memory: IoMemory, stream: &CuStream) -> TRTResult<Self> {
+        Tensor::with_memory(shape, capacity, T::DTYPE, memory, stream).map(Self::wrap)
+    }
+
+    pub fn from_tensor(tensor: Tensor) -> TRTResult<Self> {
+        match tensor.dtype() == T::DTYPE {
+            true => Ok(Self::wrap(tensor)),
+            false => Err(TRTError::DTypeMismatch),
+        }
+    }
+
+    // A typed view of `tensor`, e.g. an engine-owned buffer from TRTEngine::get_tensor.
+    pub fn from_ref(tensor: &Tensor) -> TRTResult<&Self> {
+        match tensor.dtype() == T::DTYPE {
+            true => Ok(unsafe { &*(tensor as *const Tensor as *const Self) }),
+            false => Err(TRTError::DTypeMismatch),
+        }
+    }
+
+    pub fn into_inner(self) -> Tensor {
+        self.tensor
+    }
+
+    fn wrap(tensor: Tensor) -> Self {
+        Self { tensor, _element: PhantomData }
+    }
+
+    // Elements of the current shape.
+    pub fn len(&self) -> usize {
+        self.tensor.shape().size()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    pub fn size_in_bytes(&self) -> usize {
+        self.len() * size_of::<T>()
+    }
+
+    pub fn copy_from(&mut self, src: &Self, stream: Option<&CuStream>) -> TRTResult<()> {
+        self.tensor.copy_from(&src.tensor, stream)
+    }
+
+    // As Tensor::copy_region_from.
+    pub fn copy_region_from(
+        &mut self,
+        src: &Self,
+        src_offset: &[usize],
+        dst_offset: &[usize],
+        extent: &Shape,
+        stream: &CuStream,
+    ) -> TRTResult<()> {
+        self.tensor.copy_region_from(&src.tensor, src_offset, dst_offset, extent, stream)
+    }
+
+    // As Tensor::copy_padded_from.
+    pub fn copy_padded_from(&mut self, src: &Self, stream: &CuStream) -> TRTResult<()> {
+        self.tensor.copy_padded_from(&src.tensor, stream)
+    }
+
+    // As Tensor::reserve.
+    pub fn reserve(&mut self, elements: usize) -> TRTResult<()> {
+        self.tensor.reserve(elements)
+    }
+
+    // As Tensor::reset_shape.
+    pub unsafe fn reset_shape(&mut self, shape: &Shape) -> TRTResult<()> {
+        self.tensor.reset_shape(shape)
+    }
+
+    // Copies `src`, one element per element of the current shape.
+    // Safety: `src` must stay alive and unchanged until the copy on `stream` has completed.
+    pub unsafe fn copy_from_host_async(&mut self, src: &[T], stream: &CuStream) -> TRTResult<()> {
+        if src.len() != self.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let dst = self.tensor.get_raw_ptr();
+        match memcpy_async(dst, src.as_ptr() as usize, self.size_in_bytes(), MemcpyKind::HostToDevice, stream) {
+            true => Ok(()),
+            false => Err(TRTError::MemcpyError),
+        }
+    }
+
+    // Safety: `dst` must stay alive, and not be read, until the copy on `stream` has
+    // completed.
+    pub unsafe fn copy_to_host_async(&self, dst: &mut [T], stream: &CuStream) -> TRTResult<()> {
+        if dst.len() != self.len() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let src = self.tensor.get_raw_ptr();
+        match memcpy_async(dst.as_mut_ptr() as usize, src, self.size_in_bytes(), MemcpyKind::DeviceToHost, stream) {
+            true => Ok(()),
+            false => Err(TRTError::MemcpyError),
+        }
+    }
+
+    // Reads the tensor back, synchronizing `stream`.
+    pub fn to_vec(&self, stream: &CuStream) -> TRTResult<Vec<T>> {
+        let mut data = Vec::with_capacity(self.len());
+        let copied = unsafe {
+            memcpy_async(
+                data.as_mut_ptr() as usize,
+                self.tensor.get_raw_ptr(),
+                self.size_in_bytes(),
+                MemcpyKind::DeviceToHost,
+                stream,
+            )
+        };
+        if !copied {
+            stream.synchronize()?;
+            return Err(TRTError::MemcpyError);
+        }
+        stream.synchronize()?;
+        unsafe { data.set_len(self.len()) };
+        Ok(data)
+    }
+
+    // The elements as seen from the host, for mapped and managed tensors.
+    // Safety: as Tensor::host_slice.
+    pub unsafe fn host_slice(&self) -> Option<&[T]> {
+        let bytes = self.tensor.host_slice()?;
+        Some(slice::from_raw_parts(bytes.as_ptr() as *const T, self.len()))
+    }
+
+    // Safety: as Tensor::host_slice_mut.
+    pub unsafe fn host_slice_mut(&mut self) -> Option<&mut [T]> {
+        let len = self.len();
+        let bytes = self.tensor.host_slice_mut()?;
+        Some(slice::from_raw_parts_mut(bytes.as_mut_ptr() as *mut T, len))
+    }
+}
+
+impl<T: TrtElement> Deref for TypedTensor<T> {
+    type Target = Tensor;
+
+    fn deref(&self) -> &Tensor {
+        &self.tensor
+    }
+}
+
+// An IoSlot whose binding was checked to be of T once, by TRTEngine::typed_slot.
+#[derive(Debug, PartialEq)]
+pub struct TypedSlot<T: TrtElement> {
+    pub(crate) slot: IoSlot,
+    _element: PhantomData<T>,
+}
+
+impl<T: TrtElement> Clone for TypedSlot<T> {
+    fn clone(&self) -> Self {
+        *self
+    }
+}
+
+impl<T: TrtElement> Copy for TypedSlot<T> {}
+
+impl<T: TrtElement> TypedSlot<T> {
+    pub(crate) fn new(slot: IoSlot) -> Self {
+        Self { slot, _element: PhantomData }
+    }
+
+    pub fn slot(&self) -> IoSlot {
+        self.slot
+    }
+
+    pub fn bind<'a>(&self, tensor: &'a TypedTensor<T>) -> TypedBinding<'a> {
+        TypedBinding { slot: self.slot, tensor }
+    }
+}
+
+// A tensor bound to a slot of its own element type, for TRTEngine::inference_typed. Slots of
+// different element types bind into the same list.
+#[derive(Copy, Clone)]
+pub struct TypedBinding<'a> {
+    pub(crate) slot: IoSlot,
+    pub(crate) tensor: &'a Tensor,
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn half_conversions() {
+        let cases = [
+            (1.0, 0x3c00),
+            (-2.0, 0xc000),
+            (0.1, 0x2e66),
+            (65504.0, 0x7bff),
+            (65520.0, 0x7c00),
+            (f32::INFINITY, 0x7c00),
+            (5.960_464_5e-8, 0x0001),
+            (2.0e-8, 0x0000),
+            (6.097_555e-5, 0x03ff),
+        ];
+        for (value, bits) in cases {
+            assert_eq!(Half::from_f32(value), Half(bits), "{}", value);
+        }
+        // ties to even: 1 + 2^-11 lies halfway between 1 and the next half
+        assert_eq!(Half::from_f32(1.0 + 1.0 / 2048.0), Half(0x3c00));
+        assert_eq!(Half::from_f32(1.0 + 3.0 / 2048.0), Half(0x3c02));
+        assert!(Half::from_f32(f32::NAN).to_f32().is_nan());
+        for bits in 0..0x7c00u16 {
+            assert_eq!(Half::from_f32(Half(bits).to_f32()), Half(bits));
+            assert_eq!(Half::from_f32(Half(bits | 0x8000).to_f32()), Half(bits | 0x8000));
+        }
+    }
+}
@@ -0,0 +1,352 @@
+use crate::{
+    arena::DeviceMemoryArena,
+    engine::TRTEngine,
+    error::{TRTError, TRTResult},
+    pool::{EnginePool, EnginePoolOptions, PooledEngine},
+    schema::IoSchema,
+    staging::event,
+};
+use cuda_rs::stream::CuStream;
+use std::{
+    ops::{Deref, DerefMut},
+    path::PathBuf,
+    sync::{
+        atomic::{AtomicU64, AtomicUsize, Ordering},
+        Arc, Mutex, MutexGuard,
+    },
+    time::{Duration, Instant},
+};
+use tensorrt_rs_sys::{runtime::OptProfileSelector, stream::CudaEvent};
+
+// One plan of a logical model, e.g. an FP16 build tuned for small batches.
+#[derive(Debug, Clone, PartialEq)]
+pub struct VariantSpec {
+    pub name: String,
+    pub path: PathBuf,
+    // Largest batch routed to the variant; None for the largest leading dim its profiles
+    // accept.
+    pub max_batch: Option<usize>,
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+pub enum VariantRouting {
+    // The variant with the smallest max_batch holding the request, so small requests go to
+    // the latency build and large ones to the throughput build.
+    BatchSize,
+    // Of the variants holding the request, the one with the largest max_batch whose observed
+    // latency meets the target, or the fastest when none does. Variants not measured yet
+    // count as meeting it.
+    LatencyTarget(Duration),
+    // Of the variants holding the request, the one with the fewest requests outstanding
+    // relative to its contexts.
+    Load,
+}
+
+#[derive(Debug, Clone, PartialEq)]
+pub struct VariantOptions {
+    // Contexts, profiles and plan loading per variant.
+    pub pool: EnginePoolOptions,
+    pub routing: VariantRouting,
+    // Every variant runs a single context out of one scratch arena sized for the largest,
+    // so the variants together take the activation memory of one. Requests are then served
+    // one at a time, each enqueued on its context's stream (TRTEngine::get_stream), which
+    // waits for the previous request's work on the arena.
+    pub shared_scratch: bool,
+}
+
+impl Default for VariantOptions {
+    fn default() -> Self {
+        Self { pool: EnginePoolOptions::default(), routing: VariantRouting::BatchSize, shared_scratch: false }
+    }
+}
+
+struct Variant {
+    name: String,
+    pool: EnginePool,
+    max_batch: usize,
+    // checked out or waiting for a checkout
+    outstanding: AtomicUsize,
+    // moving average of checkout-to-return time in ns, 0 before the first sample
+    latency: AtomicU64,
+}
+
+impl Variant {
+    fn observe(&self, elapsed: Duration) {
+        let sample = (elapsed.as_nanos() as u64).max(1);
+        self.latency
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |average| match average {
+                0 => Some(sample),
+                average => Some(average - average / 8 + sample / 8),
+            })
+            .ok();
+    }
+}
+
+// The builds of one logical model (precision and batch-size tiers) behind one handle. The
+// plans are checked to share their IO when loaded, and each request is routed to a variant
+// by VariantRouting, so picking a build is no longer application code.
+pub struct EngineVariants {
+    variants: Vec<Variant>,
+    schema: IoSchema,
+    routing: VariantRouting,
+    // held by the checkout while the variants share their scratch arena, with the event
+    // recorded after the work of the last checkout on it
+    scratch: Option<(Arc<DeviceMemoryArena>, Mutex<CudaEvent>)>,
+}
+
+impl EngineVariants {
+    // `setup` runs once per context with its variant's name and index, like EnginePool::new's.
+    pub fn new<F>(specs: &[VariantSpec], options: &VariantOptions, setup: F) -> TRTResult<Self>
+    where
+        F: Fn(&str, usize, &mut TRTEngine) -> TRTResult<()>,
+    {
+        if specs.is_empty() {
+            return Err(TRTError::NoEngines);
+        }
+        let mut pool_options = options.pool.clone();
+        if options.shared_scratch {
+            pool_options.num_contexts = 1;
+        }
+
+        let mut variants = Vec::with_capacity(specs.len());
+        let mut schema: Option<IoSchema> = None;
+        for spec in specs {
+            let pool = match options.shared_scratch {
+                // set up once bound to the arena, which replaces the context
+                true => EnginePool::new(&spec.path, &pool_options, |_, _| Ok(()))?,
+                false => EnginePool::new(&spec.path, &pool_options, |i, engine| setup(&spec.name, i, engine))?,
+            };
+            let variant_schema = pool.checkout().io_schema()?.clone();
+            match schema.as_ref() {
+                Some(schema) if !same_io(schema, &variant_schema) => {
+                    return Err(TRTError::VariantMismatch(spec.name.clone()))
+                }
+                Some(_) => {}
+                None => schema = Some(variant_schema.clone()),
+            }
+            let max_batch = spec.max_batch.unwrap_or_else(|| max_leading_dim(&variant_schema));
+            variants.push(Variant {
+                name: spec.name.clone(),
+                pool,
+                max_batch,
+                outstanding: AtomicUsize::new(0),
+                latency: AtomicU64::new(0),
+            });
+        }
+
+        let scratch = match options.shared_scratch {
+            true => {
+                let mut engines = variants.iter().map(|variant| variant.pool.checkout()).collect::<Vec<_>>();
+                let refs = engines.iter().map(|engine| &**engine).collect::<Vec<_>>();
+                let arena = Arc::new(DeviceMemoryArena::for_engines(&refs, &CuStream::new()?)?);
+                for (variant, engine) in variants.iter().zip(engines.iter_mut()) {
+                    engine.activate_with_arena(&arena)?;
+                    setup(&variant.name, 0, engine)?;
+                }
+                Some((arena, Mutex::new(event()?)))
+            }
+            false => None,
+        };
+
+        Ok(Self { variants, schema: schema.unwrap(), routing: options.routing, scratch })
+    }
+
+    // The IO every variant shares, as the first one reports it.
+    pub fn io_schema(&self) -> &IoSchema {
+        &self.schema
+    }
+
+    pub fn names(&self) -> Vec<&str> {
+        self.variants.iter().map(|variant| variant.name.as_str()).collect()
+    }
+
+    pub fn pool(&self, name: &str) -> Option<&EnginePool> {
+        self.variant(name).map(|variant| &variant.pool)
+    }
+
+    pub fn max_batch(&self, name: &str) -> Option<usize> {
+        self.variant(name).map(|variant| variant.max_batch)
+    }
+
+    // Moving average of the time between checkout and return, None until measured.
+    pub fn latency(&self, name: &str) -> Option<Duration> {
+        match self.variant(name)?.latency.load(Ordering::Relaxed) {
+            0 => None,
+            nanos => Some(Duration::from_nanos(nanos)),
+        }
+    }
+
+    pub fn outstanding(&self, name: &str) -> usize {
+        self.variant(name).map_or(0, |variant| variant.outstanding.load(Ordering::Relaxed))
+    }
+
+    // Size of the arena the variants share, with shared_scratch.
+    pub fn scratch_size(&self) -> Option<usize> {
+        self.scratch.as_ref().map(|(arena, _)| arena.size())
+    }
+
+    fn variant(&self, name: &str) -> Option<&Variant> {
+        self.variants.iter().find(|variant| variant.name == name)
+    }
+
+    // Blocks until a context of the variant routed for a request of `batch` rows is
+    // available. Return it once the request's results are in: the time it is held is what
+    // LatencyTarget routes by.
+    pub fn checkout(&self, batch: usize) -> TRTResult<VariantEngine<'_>> {
+        let loads = self
+            .variants
+            .iter()
+            .map(|variant| VariantLoad {
+                max_batch: variant.max_batch,
+                latency: variant.latency.load(Ordering::Relaxed),
+                outstanding: variant.outstanding.load(Ordering::Relaxed),
+                capacity: variant.pool.capacity(),
+            })
+            .collect::<Vec<_>>();
+        match select_variant(&loads, batch, self.routing) {
+            Some(index) => Ok(self.checkout_variant(&self.variants[index])),
+            None => Err(TRTError::NoVariant(batch)),
+        }
+    }
+
+    // Bypasses routing, e.g. to warm up or measure one variant.
+    pub fn checkout_named(&self, name: &str) -> TRTResult<VariantEngine<'_>> {
+        match self.variant(name) {
+            Some(variant) => Ok(self.checkout_variant(variant)),
+            None => Err(TRTError::UnknownVariant(name.to_string())),
+        }
+    }
+
+    fn checkout_variant<'a>(&'a self, variant: &'a Variant) -> VariantEngine<'a> {
+        variant.outstanding.fetch_add(1, Ordering::Relaxed);
+        let scratch = self.scratch.as_ref().map(|(_, lock)| lock.lock().unwrap());
+        let engine = variant.pool.checkout();
+        // the arena is free for this context's work once the previous holder's is done
+        if let Some(released) = scratch.as_ref() {
+            if !released.wait(engine.get_stream()) {
+                released.synchronize();
+            }
+        }
+        VariantEngine { engine: Some(engine), variant, start: Instant::now(), scratch }
+    }
+}
+
+// The same IO tensors, by name, direction and rank; dtypes and shapes may differ between
+// builds, e.g. an INT8 variant with FP16 IO.
+fn same_io(a: &IoSchema, b: &IoSchema) -> bool {
+    a.len() == b.len()
+        && a.tensors().iter().all(|tensor| match b.get(&tensor.name) {
+            Some(other) => other.io_mode == tensor.io_mode && other.shape.nb_dims() == tensor.shape.nb_dims(),
+            None => false,
+        })
+}
+
+// Of the first input, over every profile; 1 for engines without inputs.
+fn max_leading_dim(schema: &IoSchema) -> usize {
+    let input = match schema.inputs().next() {
+        Some(input) => input,
+        None => return 1,
+    };
+    let from_profiles = (0..schema.num_profiles())
+        .filter_map(|profile| input.profile_shape(profile, OptProfileSelector::MAX)?.first().copied())
+        .max();
+    let dim = from_profiles.or_else(|| input.shape.first().copied()).unwrap_or(1);
+    dim.max(1) as usize
+}
+
+#[derive(Debug, Copy, Clone, PartialEq)]
+struct VariantLoad {
+    max_batch: usize,
+    latency: u64,
+    outstanding: usize,
+    capacity: usize,
+}
+
+fn select_variant(loads: &[VariantLoad], batch: usize, routing: VariantRouting) -> Option<usize> {
+    let fits = || loads.iter().enumerate().filter(|(_, load)| load.max_batch >= batch);
+    let selected = match routing {
+        VariantRouting::BatchSize => fits().min_by_key(|(_, load)| load.max_batch),
+        VariantRouting::LatencyTarget(target) => {
+            let target = target.as_nanos() as u64;
+            fits()
+                .filter(|(_, load)| load.latency <= target)
+                .max_by_key(|(_, load)| load.max_batch)
+                .or_else(|| fits().min_by_key(|(_, load)| load.latency))
+        }
+        // outstanding / capacity, compared without dividing
+        VariantRouting::Load => fits().min_by(|(_, a), (_, b)| {
+            (a.outstanding * b.capacity.max(1)).cmp(&(b.outstanding * a.capacity.max(1)))
+        }),
+    };
+    selected.map(|(index, _)| index)
+}
+
+// A checked-out context of one variant of EngineVariants, returned on drop.
+pub struct VariantEngine<'a> {
+    engine: Option<PooledEngine<'a>>,
+    variant: &'a Variant,
+    start: Instant,
+    scratch: Option<MutexGuard<'a, CudaEvent>>,
+}
+
+impl VariantEngine<'_> {
+    pub fn variant(&self) -> &str {
+        &self.variant.name
+    }
+}
+
+impl Deref for VariantEngine<'_> {
+    type Target = TRTEngine;
+
+    fn deref(&self) -> &TRTEngine {
+        self.engine.as_ref().unwrap()
+    }
+}
+
+impl DerefMut for VariantEngine<'_> {
+    fn deref_mut(&mut self) -> &mut TRTEngine {
+        self.engine.as_mut().unwrap()
+    }
+}
+
+impl Drop for VariantEngine<'_> {
+    fn drop(&mut self) {
+        if let (Some(released), Some(engine)) = (self.scratch.as_ref(), self.engine.as_ref()) {
+            if !released.record(engine.get_stream()) {
+                engine.get_stream().synchronize().ok();
+            }
+        }
+        self.engine.take();
+        self.variant.observe(self.start.elapsed());
+        self.variant.outstanding.fetch_sub(1, Ordering::Relaxed);
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn load(max_batch: usize, latency_ms: u64, outstanding: usize) -> VariantLoad {
+        VariantLoad { max_batch, latency: latency_ms * 1_000_000, outstanding, capacity: 2 }
+    }
+
+    #[test]
+    fn routes_by_batch_latency_and_load() {
+        // FP16 up to 4 rows, INT8 up to 32
+        let loads = [load(4, 2, 2), load(32, 6, 0)];
+        assert_eq!(select_variant(&loads, 1, VariantRouting::BatchSize), Some(0));
+        assert_eq!(select_variant(&loads, 8, VariantRouting::BatchSize), Some(1));
+        assert_eq!(select_variant(&loads, 64, VariantRouting::BatchSize), None);
+
+        let target = |ms| VariantRouting::LatencyTarget(Duration::from_millis(ms));
+        assert_eq!(select_variant(&loads, 1, target(10)), Some(1));
+        assert_eq!(select_variant(&loads, 1, target(3)), Some(0));
+        // nothing meets it: the fastest
+        assert_eq!(select_variant(&loads, 1, target(1)), Some(0));
+        // unmeasured variants are tried
+        assert_eq!(select_variant(&[load(4, 2, 0), load(32, 0, 0)], 1, target(1)), Some(1));
+
+        assert_eq!(select_variant(&loads, 1, VariantRouting::Load), Some(1));
+        assert_eq!(select_variant(&loads, 8, VariantRouting::Load), Some(1));
+    }
+}
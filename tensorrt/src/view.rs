@@ -0,0 +1,190 @@
+use crate::{
+    error::{TRTError, TRTResult},
+    tensor::{Shape, Tensor},
+};
+use cuda_rs::stream::CuStream;
+use std::marker::PhantomData;
+use tensorrt_rs_sys::{
+    memory::{memcpy_2d_async, memcpy_async, MemcpyKind},
+    runtime::{DataType, MAX_DIMS},
+};
+
+// A borrowed window into a Tensor's memory: byte offset, shape and strides (in elements),
+// without copying. Contiguous views can be bound as inference inputs and outputs through
+// as_tensor; any view can be a copy source or destination (copy_view), e.g. to write one
+// request into row k of a batch or to split a batched output per request.
+pub struct TensorView<'a> {
+    ptr: usize,
+    shape: Shape,
+    strides: [usize; MAX_DIMS],
+    dtype: DataType,
+    // non-owning alias for contiguous views, so they can be passed where a &Tensor is expected
+    alias: Option<Tensor>,
+    _tensor: PhantomData<&'a Tensor>,
+}
+
+fn contiguous_strides(shape: &Shape) -> [usize; MAX_DIMS] {
+    let mut strides = [0; MAX_DIMS];
+    let mut stride = 1;
+    for dim in (0..shape.nb_dims()).rev() {
+        strides[dim] = stride;
+        stride *= shape[dim] as usize;
+    }
+    strides
+}
+
+impl<'a> TensorView<'a> {
+    // The whole tensor, at its current shape.
+    pub fn new(tensor: &'a Tensor, stream: &CuStream) -> Self {
+        let shape = *tensor.shape();
+        Self::from_parts(unsafe { tensor.get_raw_ptr() }, shape, contiguous_strides(&shape), tensor.dtype(), stream)
+    }
+
+    // A contiguous view of `shape` starting `offset` elements into the tensor's memory.
+    pub fn at(tensor: &'a Tensor, offset: usize, shape: &Shape, stream: &CuStream) -> TRTResult<Self> {
+        if offset + shape.size() > tensor.capacity() {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let ptr = unsafe { tensor.get_raw_ptr() } + offset * tensor.dtype().get_elem_size();
+        Ok(Self::from_parts(ptr, *shape, contiguous_strides(shape), tensor.dtype(), stream))
+    }
+
+    fn from_parts(
+        ptr: usize,
+        shape: Shape,
+        strides: [usize; MAX_DIMS],
+        dtype: DataType,
+        stream: &CuStream,
+    ) -> Self {
+        let contiguous = strides[..shape.nb_dims()] == contiguous_strides(&shape)[..shape.nb_dims()];
+        let alias = match contiguous {
+            true => Some(Tensor::from_raw_ptr(ptr, &shape, dtype, stream)),
+            false => None,
+        };
+        Self { ptr, shape, strides, dtype, alias, _tensor: PhantomData }
+    }
+
+    pub fn shape(&self) -> &Shape {
+        &self.shape
+    }
+
+    pub fn strides(&self) -> &[usize] {
+        &self.strides[..self.shape.nb_dims()]
+    }
+
+    pub fn dtype(&self) -> DataType {
+        self.dtype
+    }
+
+    pub fn is_contiguous(&self) -> bool {
+        self.alias.is_some()
+    }
+
+    pub unsafe fn get_raw_ptr(&self) -> usize {
+        self.ptr
+    }
+
+    // `len` entries of `dim` from `start`. Narrowing the outermost dim (e.g. rows of a batch)
+    // keeps a view contiguous; inner dims make it strided.
+    pub fn narrow(&self, dim: usize, start: usize, len: usize, stream: &CuStream) -> TRTResult<TensorView<'a>> {
+        if dim >= self.shape.nb_dims() || start + len > self.shape[dim] as usize {
+            return Err(TRTError::ShapeMismatch);
+        }
+        let mut dims = self.shape.to_vec();
+        dims[dim] = len as i32;
+        let ptr = self.ptr + start * self.strides[dim] * self.dtype.get_elem_size();
+        Ok(TensorView::from_parts(ptr, Shape::new(&dims), self.strides, self.dtype, stream))
+    }
+
+    // Row `index` of the outermost dim, keeping that dim with size 1.
+    pub fn row(&self, index: usize, stream: &CuStream) -> TRTResult<TensorView<'a>> {
+        self.narrow(0, index, 1, stream)
+    }
+
+    // The view as a Tensor, for feed/output dicts; only for contiguous views. The Tensor does
+    // not own the memory and must not outlive the view.
+    pub fn as_tensor(&self) -> TRTResult<&Tensor> {
+        match self.alias.as_ref() {
+            Some(tensor) => Ok(tensor),
+            None => Err(TRTError::ShapeMismatch),
+        }
+    }
+}
+
+// Copies `src` into `dst` on `stream`. Both views need the same shape and dtype, and an
+// innermost stride of 1; every innermost 2D plane is one cudaMemcpy2DAsync.
+pub fn copy_view(dst: &TensorView, src: &TensorView, stream: &CuStream) -> TRTResult<()> {
+    if dst.dtype != src.dtype {
+        return Err(TRTError::DTypeMismatch);
+    }
+    if dst.shape != src.shape {
+        return Err(TRTError::ShapeMismatch);
+    }
+    let elem_size = src.dtype.get_elem_size();
+    if src.is_contiguous() && dst.is_contiguous() {
+        let size = src.shape.size() * elem_size;
+        if !unsafe { memcpy_async(dst.ptr, src.ptr, size, MemcpyKind::DeviceToDevice, stream) } {
+            return Err(TRTError::MemcpyError);
+        }
+        return Ok(());
+    }
+
+    let nb_dims = src.shape.nb_dims();
+    if nb_dims == 0 || src.strides[nb_dims - 1] != 1 || dst.strides[nb_dims - 1] != 1 {
+        return Err(TRTError::ShapeMismatch);
+    }
+    if src.shape.size() == 0 {
+        return Ok(());
+    }
+    let cols = src.shape[nb_dims - 1] as usize;
+    let (rows, src_pitch, dst_pitch) = match nb_dims {
+        1 => (1, cols, cols),
+        _ => (src.shape[nb_dims - 2] as usize, src.strides[nb_dims - 2], dst.strides[nb_dims - 2]),
+    };
+    let outer = &src.shape[..nb_dims.saturating_sub(2)];
+
+    let mut index = vec![0usize; outer.len()];
+    loop {
+        let src_offset: usize = index.iter().zip(src.strides.iter()).map(|(i, s)| i * s).sum();
+        let dst_offset: usize = index.iter().zip(dst.strides.iter()).map(|(i, s)| i * s).sum();
+        let copied = unsafe {
+            memcpy_2d_async(
+                dst.ptr + dst_offset * elem_size,
+                dst_pitch * elem_size,
+                src.ptr + src_offset * elem_size,
+                src_pitch * elem_size,
+                cols * elem_size,
+                rows,
+                MemcpyKind::DeviceToDevice,
+                stream,
+            )
+        };
+        if !copied {
+            return Err(TRTError::MemcpyError);
+        }
+
+        let mut dim = index.len();
+        loop {
+            if dim == 0 {
+                return Ok(());
+            }
+            dim -= 1;
+            index[dim] += 1;
+            if index[dim] < outer[dim] as usize {
+                break;
+            }
+            index[dim] = 0;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn strides_of_contiguous_shape() {
+        let strides = contiguous_strides(&Shape::new(&[2, 3, 4]));
+        assert_eq!(&strides[..3], &[12, 4, 1]);
+    }
+}
@@ -0,0 +1,43 @@
+use crate::tensor::Shape;
+
+// Timings of the synthetic enqueues run by TRTEngine::warmup for one set of input shapes.
+#[derive(Debug, Clone, PartialEq)]
+pub struct WarmupRun {
+    pub profile: i32,
+    pub shapes: Vec<(String, Shape)>,
+    // Host-measured enqueue-to-completion time of every iteration, in milliseconds.
+    pub timings_ms: Vec<f32>,
+}
+
+impl WarmupRun {
+    // The first iteration, which pays the lazy initialization.
+    pub fn first_ms(&self) -> Option<f32> {
+        self.timings_ms.first().copied()
+    }
+
+    // The last iteration, i.e. what steady state is expected to look like.
+    pub fn last_ms(&self) -> Option<f32> {
+        self.timings_ms.last().copied()
+    }
+
+    pub fn max_ms(&self) -> Option<f32> {
+        self.timings_ms.iter().copied().reduce(f32::max)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn warmup_run_stats() {
+        let run = WarmupRun {
+            profile: 0,
+            shapes: vec![("x".to_string(), Shape::new(&[1, 3, 224, 224]))],
+            timings_ms: vec![120.0, 2.5, 2.0],
+        };
+        assert_eq!(run.first_ms(), Some(120.0));
+        assert_eq!(run.last_ms(), Some(2.0));
+        assert_eq!(run.max_ms(), Some(120.0));
+    }
+}
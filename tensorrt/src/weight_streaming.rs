@@ -0,0 +1,66 @@
+use crate::error::{TRTError, TRTResult};
+use tensorrt_rs_sys::{device, runtime::CudaEngine};
+
+// How many bytes of an engine's streamable weights stay resident on the device; the rest
+// are streamed over PCIe on every enqueue. Only engines built with
+// BuildOptions::weight_streaming have streamable weights.
+#[derive(Debug, Copy, Clone, PartialEq, Eq)]
+pub enum WeightStreamingBudget {
+    // Every weight resident, as without weight streaming.
+    Disabled,
+    // TensorRT's own estimate from the free device memory.
+    Automatic,
+    Bytes(usize),
+    // The device memory free before activation, less `reserve` bytes kept for other models
+    // and less the memory of the engine's execution contexts.
+    FreeMemory { reserve: usize },
+}
+
+pub(crate) fn budget_from_free(free: usize, reserve: usize, context_memory: usize, streamable: usize) -> usize {
+    free.saturating_sub(reserve).saturating_sub(context_memory).min(streamable)
+}
+
+// Applies `budget` to an engine that `contexts` execution contexts will run, before any of
+// them is created. Returns the bytes kept resident.
+pub(crate) fn apply(engine: &mut CudaEngine, budget: WeightStreamingBudget, contexts: usize) -> TRTResult<usize> {
+    let streamable = engine.get_streamable_weights_size();
+    if streamable == 0 {
+        return match budget {
+            WeightStreamingBudget::Disabled => Ok(0),
+            _ => Err(TRTError::WeightStreamingUnsupported),
+        };
+    }
+    let bytes = match budget {
+        WeightStreamingBudget::Disabled => streamable,
+        WeightStreamingBudget::Automatic => engine.get_weight_streaming_automatic_budget(),
+        WeightStreamingBudget::Bytes(bytes) => bytes.min(streamable),
+        WeightStreamingBudget::FreeMemory { reserve } => {
+            let (free, _) = match device::get_mem_info() {
+                Some(info) => info,
+                None => return Err(TRTError::DeviceQueryError),
+            };
+            // the scratch size at the current budget bounds the one at a smaller budget
+            let per_context = engine.get_device_memory_size() + engine.get_weight_streaming_scratch_memory_size();
+            budget_from_free(free, reserve, per_context * contexts.max(1), streamable)
+        }
+    };
+    if !engine.set_weight_streaming_budget(bytes) {
+        return Err(TRTError::WeightStreamingBudgetError(bytes));
+    }
+    Ok(bytes)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn budget_leaves_room_for_reserve_and_contexts() {
+        let gib = 1 << 30;
+        assert_eq!(budget_from_free(10 * gib, 2 * gib, gib, 20 * gib), 7 * gib);
+        // never more than the streamable weights
+        assert_eq!(budget_from_free(10 * gib, 0, 0, 4 * gib), 4 * gib);
+        // nothing fits: the minimum budget
+        assert_eq!(budget_from_free(gib, 2 * gib, gib, 4 * gib), 0);
+    }
+}
@@ -0,0 +1,105 @@
+use cuda_rs::{device::CuDevice, stream::CuStream};
+use std::collections::HashMap;
+use tensorrt::{DataType, OptProfileSelector, TRTEngine, TRTResult, Tensor};
+use tensorrt_rs_sys::memory::{memcpy_async, MemcpyKind};
+
+fn random_inputs(
+    engine: &TRTEngine,
+    profile: i32,
+    select: OptProfileSelector,
+    stream: &CuStream,
+) -> Vec<(String, Tensor)> {
+    engine
+        .input_names()
+        .iter()
+        .enumerate()
+        .map(|(seed, name)| {
+            let shape = engine.get_profile_shape(name, profile, select).unwrap();
+            let dtype = engine.get_tensor(name).unwrap().dtype();
+            let tensor = Tensor::empty(&shape, dtype, stream).unwrap();
+            match dtype {
+                DataType::FLOAT | DataType::HALF => tensor.fill_random(-1.0, 1.0, seed as u64, stream).unwrap(),
+                _ => tensor.zero(stream).unwrap(),
+            }
+            (name.clone(), tensor)
+        })
+        .collect()
+}
+
+fn run(engine: &mut TRTEngine, inputs: &[(String, Tensor)], stream: &CuStream) -> TRTResult<Vec<Vec<u8>>> {
+    let feed_dict: HashMap<&str, &Tensor> = inputs.iter().map(|(name, tensor)| (name.as_str(), tensor)).collect();
+    engine.inference(&feed_dict, Some(stream))?;
+    let mut outputs = Vec::new();
+    for name in engine.output_names().to_vec() {
+        let shape = engine.get_tensor_shape(&name)?;
+        let tensor = engine.get_tensor(&name).unwrap();
+        let mut host = vec![0u8; shape.size() * tensor.dtype().get_elem_size()];
+        let size = host.len();
+        assert!(unsafe {
+            memcpy_async(host.as_mut_ptr() as usize, tensor.get_raw_ptr(), size, MemcpyKind::DeviceToHost, stream)
+        });
+        outputs.push(host);
+    }
+    stream.synchronize()?;
+    Ok(outputs)
+}
+
+// Needs a plan to run: TRT_TEST_PLAN=model.plan cargo test, with two optimization profiles
+// of which profile 1 accepts larger inputs (and needs more scratch) than profile 0.
+#[test]
+fn profile_switches_drop_graphs_of_the_old_scratch() {
+    let plan = match std::env::var("TRT_TEST_PLAN") {
+        Ok(plan) => plan,
+        Err(_) => {
+            eprintln!("TRT_TEST_PLAN is not set, skipping");
+            return;
+        }
+    };
+
+    cuda_rs::init().unwrap();
+    let ctx = CuDevice::new(0).unwrap().retain_primary_context().unwrap();
+    let _guard = ctx.guard().unwrap();
+    let stream = CuStream::new().unwrap();
+
+    // IO buffers for profile 1's max shapes, on a context whose scratch holds profile 0's
+    let mut engine = TRTEngine::new(&plan, &stream).unwrap();
+    engine.activate_for_profile(1).unwrap();
+    engine.allocate_io_tensors(&HashMap::new(), None).unwrap();
+    engine.set_optimization_profile(0).unwrap();
+    engine.recover().unwrap();
+    engine.enable_cuda_graphs(true);
+    engine.enable_auto_profile(true).unwrap();
+
+    let mut reference = TRTEngine::new(&plan, &stream).unwrap();
+    reference.activate().unwrap();
+    reference.allocate_io_tensors(&HashMap::new(), None).unwrap();
+
+    let small = random_inputs(&engine, 0, OptProfileSelector::MIN, &stream);
+    let large = random_inputs(&engine, 1, OptProfileSelector::MAX, &stream);
+
+    run(&mut engine, &small, &stream).unwrap();
+    assert_eq!(engine.get_optimization_profile().unwrap(), 0);
+    assert_eq!(engine.num_cuda_graphs(), 1);
+    // grows the scratch the graph of `small` was captured with
+    run(&mut engine, &large, &stream).unwrap();
+    assert_eq!(engine.get_optimization_profile().unwrap(), 1);
+    assert_eq!(engine.num_cuda_graphs(), 1);
+
+    let outputs = run(&mut engine, &small, &stream).unwrap();
+    assert_eq!(engine.get_optimization_profile().unwrap(), 0);
+    let expected = run(&mut reference, &small, &stream).unwrap();
+    assert_eq!(outputs.len(), expected.len());
+    for (name, (output, expected)) in reference.output_names().iter().zip(outputs.iter().zip(&expected)) {
+        let dtype = reference.get_tensor(name).unwrap().dtype();
+        if dtype != DataType::FLOAT {
+            assert_eq!(output, expected, "{}", name);
+            continue;
+        }
+        let decode = |bytes: &[u8]| -> Vec<f32> {
+            bytes.chunks_exact(4).map(|chunk| f32::from_le_bytes(chunk.try_into().unwrap())).collect()
+        };
+        for (value, expected) in decode(output).into_iter().zip(decode(expected)) {
+            assert!((value - expected).abs() <= 1e-3 * (1.0 + expected.abs()), "{}: {} != {}", name, value, expected);
+        }
+    }
+}